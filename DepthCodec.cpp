@@ -0,0 +1,691 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthCodec.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Row-delta prediction followed by run-length / variable-length nibble coding (RVL).
+// Each pixel is predicted from the one above it (the first row from its left
+// neighbour), which leaves small residuals on smooth surfaces and long runs of
+// zeros in holes and on the background.  Residuals are zigzagged, zero runs are
+// stored as counts, and everything else is written as 3 bit groups with a
+// continuation bit.  Prediction, reconstruction and run scanning are SSE2.
+
+#include "stdafx.h"
+#include "DepthCodec.h"
+#include <new>
+#include <emmintrin.h>
+
+// Bit 3 of every nibble marks that more 3 bit groups follow
+static const UINT g_NibbleContinue = 0x8;
+static const UINT g_NibblesPerWord = 8;
+
+/// <summary>
+/// Packs variable length values into 32-bit words, most significant nibble first
+/// </summary>
+struct NibbleWriter
+{
+    DWORD * pWord;
+    DWORD   word;
+    UINT    nibbles;
+
+    void Put( UINT value )
+    {
+        do
+        {
+            UINT nibble = value & 0x7;
+            value >>= 3;
+            if ( value )
+            {
+                nibble |= g_NibbleContinue;
+            }
+
+            word = (word << 4) | nibble;
+            if ( ++nibbles == g_NibblesPerWord )
+            {
+                *(pWord++) = word;
+                word = 0;
+                nibbles = 0;
+            }
+        } while ( value );
+    }
+
+    void Flush( )
+    {
+        if ( nibbles > 0 )
+        {
+            *(pWord++) = word << (4 * (g_NibblesPerWord - nibbles));
+            word = 0;
+            nibbles = 0;
+        }
+    }
+};
+
+/// <summary>
+/// Reads back values written by NibbleWriter, failing on truncated input
+/// </summary>
+struct NibbleReader
+{
+    const DWORD * pWord;
+    const DWORD * pEnd;
+    DWORD         word;
+    UINT          nibbles;
+
+    bool Get( UINT & value )
+    {
+        value = 0;
+        for ( UINT shift = 0; shift < 32; shift += 3 )
+        {
+            if ( 0 == nibbles )
+            {
+                if ( pWord == pEnd )
+                {
+                    return false;
+                }
+                word = *(pWord++);
+                nibbles = g_NibblesPerWord;
+            }
+
+            UINT nibble = word >> 28;
+            word <<= 4;
+            --nibbles;
+
+            value |= (nibble & 0x7) << shift;
+            if ( 0 == (nibble & g_NibbleContinue) )
+            {
+                return true;
+            }
+        }
+
+        // more groups than any 32-bit value needs
+        return false;
+    }
+};
+
+/// <summary>
+/// Zigzag a residual so small negative and positive values both become small
+/// </summary>
+inline USHORT ZigZag( USHORT residual )
+{
+    short d = static_cast<short>(residual);
+    return static_cast<USHORT>((d << 1) ^ (d >> 15));
+}
+
+/// <summary>
+/// Inverse of ZigZag
+/// </summary>
+inline USHORT UnZigZag( USHORT value )
+{
+    return static_cast<USHORT>((value >> 1) ^ (0 - (value & 1)));
+}
+
+/// <summary>
+/// Find the end of a run of zero values
+/// </summary>
+static const USHORT * SkipZeros( const USHORT * p, const USHORT * pEnd )
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    while ( pEnd - p >= 8 )
+    {
+        __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i *>(p) );
+        if ( 0xFFFF != _mm_movemask_epi8( _mm_cmpeq_epi16( v, zero ) ) )
+        {
+            break;
+        }
+        p += 8;
+    }
+
+    while ( p < pEnd && 0 == *p )
+    {
+        ++p;
+    }
+
+    return p;
+}
+
+/// <summary>
+/// Find the end of a run of non-zero values
+/// </summary>
+static const USHORT * SkipNonZeros( const USHORT * p, const USHORT * pEnd )
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    while ( pEnd - p >= 8 )
+    {
+        __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i *>(p) );
+        if ( 0 != _mm_movemask_epi8( _mm_cmpeq_epi16( v, zero ) ) )
+        {
+            break;
+        }
+        p += 8;
+    }
+
+    while ( p < pEnd && 0 != *p )
+    {
+        ++p;
+    }
+
+    return p;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+DepthCodec::DepthCodec() :
+    m_width(0),
+    m_height(0),
+    m_pResiduals(NULL)
+{
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+DepthCodec::~DepthCodec()
+{
+    delete [] m_pResiduals;
+}
+
+/// <summary>
+/// Set the frame size to be encoded and allocate scratch space
+/// </summary>
+/// <param name="width">width (in pixels) of depth frames</param>
+/// <param name="height">height (in pixels) of depth frames</param>
+/// <returns>true if successful, false otherwise</returns>
+bool DepthCodec::Initialize( UINT width, UINT height )
+{
+    // sizes must fit in the header, and the worst case encoded size in a ULONG
+    if ( 0 == width || 0 == height || width > 0xFFFF || height > 0xFFFF ||
+         width * height > (MAXDWORD - sizeof(DEPTH_CODEC_HEADER) - 2 * sizeof(DWORD)) / 4 )
+    {
+        return false;
+    }
+
+    if ( width * height != m_width * m_height )
+    {
+        delete [] m_pResiduals;
+        m_pResiduals = new (std::nothrow) USHORT[width * height];
+        if ( NULL == m_pResiduals )
+        {
+            m_width = 0;
+            m_height = 0;
+            return false;
+        }
+    }
+
+    m_width = width;
+    m_height = height;
+
+    return true;
+}
+
+/// <summary>
+/// Worst case size of an encoded frame, including the header
+/// </summary>
+/// <returns>size (in bytes) an output buffer must have to be passed to Encode</returns>
+ULONG DepthCodec::GetMaxEncodedSize( ) const
+{
+    // Every pixel costs at most 6 nibbles of value plus 2 nibbles of run counts
+    // amortized over the shortest possible runs, and each run pair adds at most
+    // one partially filled word at the end
+    return sizeof(DEPTH_CODEC_HEADER) + m_width * m_height * 4 + 2 * sizeof(DWORD);
+}
+
+/// <summary>
+/// Compress a depth frame, keeping the player index bits intact
+/// </summary>
+/// <param name="pDepth">packed depth pixels, width * height of them</param>
+/// <param name="pEncoded">buffer to receive the encoded frame</param>
+/// <param name="cbEncoded">size (in bytes) of pEncoded, at least GetMaxEncodedSize</param>
+/// <returns>size (in bytes) of the encoded frame, 0 on failure</returns>
+ULONG DepthCodec::Encode( const USHORT * pDepth, BYTE * pEncoded, ULONG cbEncoded )
+{
+    if ( NULL == m_pResiduals || NULL == pDepth || NULL == pEncoded || cbEncoded < GetMaxEncodedSize() )
+    {
+        return 0;
+    }
+
+    // First row is predicted from the left neighbour
+    USHORT previous = 0;
+    for ( UINT x = 0; x < m_width; ++x )
+    {
+        m_pResiduals[x] = ZigZag( static_cast<USHORT>(pDepth[x] - previous) );
+        previous = pDepth[x];
+    }
+
+    // Remaining rows are predicted from the row above, eight pixels at a time
+    for ( UINT y = 1; y < m_height; ++y )
+    {
+        const USHORT * pRow = pDepth + y * m_width;
+        const USHORT * pAbove = pRow - m_width;
+        USHORT * pOut = m_pResiduals + y * m_width;
+
+        UINT x = 0;
+        for ( ; x + 8 <= m_width; x += 8 )
+        {
+            __m128i current = _mm_loadu_si128( reinterpret_cast<const __m128i *>(pRow + x) );
+            __m128i above   = _mm_loadu_si128( reinterpret_cast<const __m128i *>(pAbove + x) );
+            __m128i delta   = _mm_sub_epi16( current, above );
+            __m128i zigzag  = _mm_xor_si128( _mm_slli_epi16( delta, 1 ), _mm_srai_epi16( delta, 15 ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(pOut + x), zigzag );
+        }
+
+        for ( ; x < m_width; ++x )
+        {
+            pOut[x] = ZigZag( static_cast<USHORT>(pRow[x] - pAbove[x]) );
+        }
+    }
+
+    // Alternate zero run length, non-zero run length, then the non-zero values
+    NibbleWriter writer = { reinterpret_cast<DWORD *>(pEncoded + sizeof(DEPTH_CODEC_HEADER)), 0, 0 };
+
+    const USHORT * pRun = m_pResiduals;
+    const USHORT * pEnd = m_pResiduals + m_width * m_height;
+
+    while ( pRun < pEnd )
+    {
+        const USHORT * pZerosEnd = SkipZeros( pRun, pEnd );
+        const USHORT * pNonZerosEnd = SkipNonZeros( pZerosEnd, pEnd );
+
+        writer.Put( static_cast<UINT>(pZerosEnd - pRun) );
+        writer.Put( static_cast<UINT>(pNonZerosEnd - pZerosEnd) );
+
+        // values are known to be non-zero, so store one less
+        for ( pRun = pZerosEnd; pRun < pNonZerosEnd; ++pRun )
+        {
+            writer.Put( *pRun - 1u );
+        }
+    }
+
+    writer.Flush( );
+
+    DEPTH_CODEC_HEADER * pHeader = reinterpret_cast<DEPTH_CODEC_HEADER *>(pEncoded);
+    pHeader->dwMagic   = DEPTH_CODEC_MAGIC;
+    pHeader->usWidth   = static_cast<USHORT>(m_width);
+    pHeader->usHeight  = static_cast<USHORT>(m_height);
+    pHeader->cbPayload = static_cast<DWORD>(reinterpret_cast<BYTE *>(writer.pWord) - pEncoded) - sizeof(DEPTH_CODEC_HEADER);
+
+    return sizeof(DEPTH_CODEC_HEADER) + pHeader->cbPayload;
+}
+
+/// <summary>
+/// Decompress a frame produced by Encode
+/// </summary>
+/// <param name="pEncoded">encoded frame</param>
+/// <param name="cbEncoded">size (in bytes) of the encoded frame</param>
+/// <param name="pDepth">receives width * height packed depth pixels</param>
+/// <returns>true if successful, false if the data is corrupt or of another size</returns>
+bool DepthCodec::Decode( const BYTE * pEncoded, ULONG cbEncoded, USHORT * pDepth )
+{
+    if ( NULL == pEncoded || NULL == pDepth || cbEncoded < sizeof(DEPTH_CODEC_HEADER) )
+    {
+        return false;
+    }
+
+    const DEPTH_CODEC_HEADER * pHeader = reinterpret_cast<const DEPTH_CODEC_HEADER *>(pEncoded);
+    if ( DEPTH_CODEC_MAGIC != pHeader->dwMagic ||
+         m_width != pHeader->usWidth ||
+         m_height != pHeader->usHeight ||
+         pHeader->cbPayload > cbEncoded - sizeof(DEPTH_CODEC_HEADER) ||
+         0 != pHeader->cbPayload % sizeof(DWORD) )
+    {
+        return false;
+    }
+
+    const DWORD * pPayload = reinterpret_cast<const DWORD *>(pEncoded + sizeof(DEPTH_CODEC_HEADER));
+    NibbleReader reader = { pPayload, pPayload + pHeader->cbPayload / sizeof(DWORD), 0, 0 };
+
+    // Expand the runs back into zigzagged residuals, directly in the output
+    USHORT * pRun = pDepth;
+    USHORT * pEnd = pDepth + m_width * m_height;
+
+    while ( pRun < pEnd )
+    {
+        UINT zeros, nonZeros;
+        if ( !reader.Get( zeros ) || !reader.Get( nonZeros ) )
+        {
+            return false;
+        }
+
+        if ( (0 == zeros && 0 == nonZeros) || zeros > static_cast<UINT>(pEnd - pRun) )
+        {
+            return false;
+        }
+
+        ZeroMemory( pRun, zeros * sizeof(USHORT) );
+        pRun += zeros;
+
+        if ( nonZeros > static_cast<UINT>(pEnd - pRun) )
+        {
+            return false;
+        }
+
+        for ( USHORT * pNonZerosEnd = pRun + nonZeros; pRun < pNonZerosEnd; ++pRun )
+        {
+            UINT value;
+            if ( !reader.Get( value ) || value >= 0xFFFF )
+            {
+                return false;
+            }
+            *pRun = static_cast<USHORT>(value + 1);
+        }
+    }
+
+    // Undo the prediction in place, the row above is already reconstructed
+    USHORT previous = 0;
+    for ( UINT x = 0; x < m_width; ++x )
+    {
+        previous = static_cast<USHORT>(previous + UnZigZag( pDepth[x] ));
+        pDepth[x] = previous;
+    }
+
+    const __m128i one = _mm_set1_epi16( 1 );
+    const __m128i zero = _mm_setzero_si128();
+
+    for ( UINT y = 1; y < m_height; ++y )
+    {
+        USHORT * pRow = pDepth + y * m_width;
+        const USHORT * pAbove = pRow - m_width;
+
+        UINT x = 0;
+        for ( ; x + 8 <= m_width; x += 8 )
+        {
+            __m128i zigzag = _mm_loadu_si128( reinterpret_cast<const __m128i *>(pRow + x) );
+            __m128i above  = _mm_loadu_si128( reinterpret_cast<const __m128i *>(pAbove + x) );
+            __m128i delta  = _mm_xor_si128( _mm_srli_epi16( zigzag, 1 ), _mm_sub_epi16( zero, _mm_and_si128( zigzag, one ) ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(pRow + x), _mm_add_epi16( above, delta ) );
+        }
+
+        for ( ; x < m_width; ++x )
+        {
+            pRow[x] = static_cast<USHORT>(pAbove[x] + UnZigZag( pRow[x] ));
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+DepthRecorder::DepthRecorder() :
+    m_hFile(INVALID_HANDLE_VALUE),
+    m_pBuffer(NULL),
+    m_cbBuffer(0)
+{
+    ZeroMemory( &m_statistics, sizeof(m_statistics) );
+}
+
+/// <summary>
+/// Destructor, closes the file
+/// </summary>
+DepthRecorder::~DepthRecorder()
+{
+    Close();
+    delete [] m_pBuffer;
+}
+
+/// <summary>
+/// Create the recording file, replacing any file of that name
+/// </summary>
+/// <param name="szFileName">file to record to</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT DepthRecorder::Create( LPCWSTR szFileName )
+{
+    Close();
+
+    m_hFile = CreateFileW( szFileName, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if ( INVALID_HANDLE_VALUE == m_hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    ZeroMemory( &m_statistics, sizeof(m_statistics) );
+
+    DEPTH_RECORDING_HEADER header;
+    header.dwMagic = DEPTH_RECORDING_MAGIC;
+    header.dwVersion = DEPTH_RECORDING_VERSION;
+
+    DWORD cbWritten = 0;
+    if ( !WriteFile( m_hFile, &header, sizeof(header), &cbWritten, NULL ) || sizeof(header) != cbWritten )
+    {
+        HRESULT hr = HRESULT_FROM_WIN32( GetLastError() );
+        Close();
+        return FAILED(hr) ? hr : E_FAIL;
+    }
+
+    m_statistics.cbWritten = cbWritten;
+
+    return S_OK;
+}
+
+/// <summary>
+/// Compress a depth frame and append it to the file
+/// </summary>
+/// <param name="pDepth">packed depth pixels, width * height of them with no padding between rows</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="frameNumber">sensor frame number</param>
+/// <param name="timeStamp">sensor timestamp</param>
+/// <returns>true if the frame was written, false otherwise</returns>
+bool DepthRecorder::Write( const USHORT * pDepth, UINT width, UINT height, DWORD frameNumber, LONGLONG timeStamp )
+{
+    return WriteFrame( DEPTH_RECORDING_STREAM_DEPTH, pDepth, width, height, frameNumber, timeStamp );
+}
+
+/// <summary>
+/// Compress an infrared frame and append it to the file
+/// </summary>
+/// <param name="pInfrared">infrared samples, width * height of them with no padding between rows</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="frameNumber">sensor frame number</param>
+/// <param name="timeStamp">sensor timestamp</param>
+/// <returns>true if the frame was written, false otherwise</returns>
+bool DepthRecorder::WriteInfrared( const USHORT * pInfrared, UINT width, UINT height, DWORD frameNumber, LONGLONG timeStamp )
+{
+    // The codec works on any 16-bit samples, the row-above prediction suits infrared as well
+    return WriteFrame( DEPTH_RECORDING_STREAM_INFRARED, pInfrared, width, height, frameNumber, timeStamp );
+}
+
+/// <summary>
+/// Compress a frame of either stream and append it to the file
+/// </summary>
+/// <param name="dwStream">DEPTH_RECORDING_STREAM_ value</param>
+/// <param name="pPixels">16-bit pixels, width * height of them with no padding between rows</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="frameNumber">sensor frame number</param>
+/// <param name="timeStamp">sensor timestamp</param>
+/// <returns>true if the frame was written, false otherwise</returns>
+bool DepthRecorder::WriteFrame( DWORD dwStream, const USHORT * pPixels, UINT width, UINT height, DWORD frameNumber, LONGLONG timeStamp )
+{
+    if ( INVALID_HANDLE_VALUE == m_hFile || !m_codec.Initialize( width, height ) )
+    {
+        return false;
+    }
+
+    // Grows only when the resolution does
+    ULONG cbNeeded = sizeof(DEPTH_RECORDING_FRAME) + m_codec.GetMaxEncodedSize( );
+    if ( cbNeeded > m_cbBuffer )
+    {
+        delete [] m_pBuffer;
+        m_pBuffer = new BYTE[cbNeeded];
+        m_cbBuffer = cbNeeded;
+    }
+
+    LARGE_INTEGER start, end, frequency;
+    QueryPerformanceCounter( &start );
+    ULONG cbEncoded = m_codec.Encode( pPixels, m_pBuffer + sizeof(DEPTH_RECORDING_FRAME), m_cbBuffer - sizeof(DEPTH_RECORDING_FRAME) );
+    QueryPerformanceCounter( &end );
+    QueryPerformanceFrequency( &frequency );
+
+    if ( 0 == cbEncoded )
+    {
+        return false;
+    }
+
+    // Cleared first so the padding at the end of the header is written as zeros
+    DEPTH_RECORDING_FRAME * pFrame = reinterpret_cast<DEPTH_RECORDING_FRAME *>(m_pBuffer);
+    ZeroMemory( pFrame, sizeof(DEPTH_RECORDING_FRAME) );
+    pFrame->liTimeStamp = timeStamp;
+    pFrame->dwFrameNumber = frameNumber;
+    pFrame->cbEncoded = cbEncoded;
+    pFrame->dwStream = dwStream;
+
+    // One write per frame, so a recording cut short ends on a whole frame more often than not
+    DWORD cbToWrite = sizeof(DEPTH_RECORDING_FRAME) + cbEncoded;
+    DWORD cbWritten = 0;
+    if ( !WriteFile( m_hFile, m_pBuffer, cbToWrite, &cbWritten, NULL ) || cbWritten != cbToWrite )
+    {
+        return false;
+    }
+
+    ++m_statistics.cFrames;
+    m_statistics.cbRaw += width * height * sizeof(USHORT);
+    m_statistics.cbWritten += cbWritten;
+    m_statistics.encodeMilliseconds += (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+
+    return true;
+}
+
+/// <summary>
+/// Close the file
+/// </summary>
+void DepthRecorder::Close( )
+{
+    if ( INVALID_HANDLE_VALUE != m_hFile )
+    {
+        CloseHandle( m_hFile );
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+DepthPlayer::DepthPlayer() :
+    m_hFile(INVALID_HANDLE_VALUE),
+    m_pEncoded(NULL),
+    m_cbEncoded(0),
+    m_pDepth(NULL),
+    m_cDepth(0)
+{
+}
+
+/// <summary>
+/// Destructor, closes the file
+/// </summary>
+DepthPlayer::~DepthPlayer()
+{
+    Close();
+    delete [] m_pEncoded;
+    delete [] m_pDepth;
+}
+
+/// <summary>
+/// Open a recording
+/// </summary>
+/// <param name="szFileName">file written by DepthRecorder</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT DepthPlayer::Open( LPCWSTR szFileName )
+{
+    Close();
+
+    m_hFile = CreateFileW( szFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if ( INVALID_HANDLE_VALUE == m_hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Frames of another layout would be misread, so anything else is refused up front
+    DEPTH_RECORDING_HEADER header;
+    DWORD cbRead = 0;
+    if ( !ReadFile( m_hFile, &header, sizeof(header), &cbRead, NULL ) || sizeof(header) != cbRead ||
+         DEPTH_RECORDING_MAGIC != header.dwMagic || DEPTH_RECORDING_VERSION != header.dwVersion )
+    {
+        Close();
+        return HRESULT_FROM_WIN32( ERROR_BAD_FORMAT );
+    }
+
+    return S_OK;
+}
+
+/// <summary>
+/// Read and decompress the next frame
+/// </summary>
+/// <param name="frame">receives the timestamp, frame number, encoded size and stream of the frame</param>
+/// <param name="width">receives the width (in pixels) of the frame</param>
+/// <param name="height">receives the height (in pixels) of the frame</param>
+/// <returns>packed depth pixels or infrared samples valid until the next call, NULL at the end of the file or if it is corrupt</returns>
+const USHORT * DepthPlayer::ReadFrame( DEPTH_RECORDING_FRAME & frame, UINT & width, UINT & height )
+{
+    DWORD cbRead = 0;
+    DEPTH_CODEC_HEADER header;
+    if ( INVALID_HANDLE_VALUE == m_hFile ||
+         !ReadFile( m_hFile, &frame, sizeof(frame), &cbRead, NULL ) || sizeof(frame) != cbRead ||
+         frame.cbEncoded < sizeof(header) ||
+         !ReadFile( m_hFile, &header, sizeof(header), &cbRead, NULL ) || sizeof(header) != cbRead )
+    {
+        return NULL;
+    }
+
+    // Frames carry their own size, so a recording can change resolution part way.  No
+    // more is read than the codec can write for that size, so a corrupt frame can't ask
+    // for an allocation of any size
+    if ( DEPTH_CODEC_MAGIC != header.dwMagic || !m_codec.Initialize( header.usWidth, header.usHeight ) ||
+         frame.cbEncoded > m_codec.GetMaxEncodedSize( ) )
+    {
+        return NULL;
+    }
+
+    if ( frame.cbEncoded > m_cbEncoded )
+    {
+        delete [] m_pEncoded;
+        m_pEncoded = new (std::nothrow) BYTE[frame.cbEncoded];
+        m_cbEncoded = ( NULL != m_pEncoded ) ? frame.cbEncoded : 0;
+    }
+
+    UINT cDepth = header.usWidth * header.usHeight;
+    if ( cDepth > m_cDepth )
+    {
+        delete [] m_pDepth;
+        m_pDepth = new (std::nothrow) USHORT[cDepth];
+        m_cDepth = ( NULL != m_pDepth ) ? cDepth : 0;
+    }
+
+    if ( NULL == m_pEncoded || NULL == m_pDepth )
+    {
+        return NULL;
+    }
+
+    CopyMemory( m_pEncoded, &header, sizeof(header) );
+    DWORD cbPayload = frame.cbEncoded - sizeof(header);
+    if ( !ReadFile( m_hFile, m_pEncoded + sizeof(header), cbPayload, &cbRead, NULL ) || cbPayload != cbRead )
+    {
+        return NULL;
+    }
+
+    if ( !m_codec.Decode( m_pEncoded, frame.cbEncoded, m_pDepth ) )
+    {
+        return NULL;
+    }
+
+    width = header.usWidth;
+    height = header.usHeight;
+
+    return m_pDepth;
+}
+
+/// <summary>
+/// Close the file
+/// </summary>
+void DepthPlayer::Close( )
+{
+    if ( INVALID_HANDLE_VALUE != m_hFile )
+    {
+        CloseHandle( m_hFile );
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+}
@@ -0,0 +1,232 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthCodec.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Lossless compression of packed 16-bit depth frames for recording and IPC,
+// and recording files of compressed frames.  A recording is a
+// DEPTH_RECORDING_HEADER followed by a sequence of frames, each a
+// DEPTH_RECORDING_FRAME followed by cbEncoded bytes produced by
+// DepthCodec::Encode.  Infrared frames are 16 bits a pixel as well, and are
+// recorded the same way, interleaved with the depth.
+
+#pragma once
+
+// Identifies an encoded depth frame ('DRV1')
+#define DEPTH_CODEC_MAGIC   0x31565244
+
+// Precedes the compressed payload of every encoded frame
+struct DEPTH_CODEC_HEADER
+{
+    DWORD   dwMagic;
+    USHORT  usWidth;
+    USHORT  usHeight;
+    DWORD   cbPayload;
+};
+
+// Identifies a recording ('DRF1'), and the layout of its frames
+#define DEPTH_RECORDING_MAGIC               0x31465244
+#define DEPTH_RECORDING_VERSION             2
+
+// Starts every recording
+struct DEPTH_RECORDING_HEADER
+{
+    DWORD       dwMagic;
+    DWORD       dwVersion;          // DEPTH_RECORDING_VERSION; frames gained dwStream in version 2
+};
+
+// Streams a recorded frame can come from
+#define DEPTH_RECORDING_STREAM_DEPTH        0
+#define DEPTH_RECORDING_STREAM_INFRARED     1
+
+// Precedes every frame of a recording
+struct DEPTH_RECORDING_FRAME
+{
+    LONGLONG    liTimeStamp;        // sensor timestamp of the frame
+    DWORD       dwFrameNumber;
+    DWORD       cbEncoded;          // size (in bytes) of the encoded frame that follows
+    DWORD       dwStream;           // DEPTH_RECORDING_STREAM_ value
+};
+
+// What a recorder has written so far
+struct DEPTH_RECORDING_STATISTICS
+{
+    DWORD       cFrames;
+    ULONGLONG   cbRaw;              // bytes of depth and infrared recorded
+    ULONGLONG   cbWritten;          // bytes written to the file
+    double      encodeMilliseconds; // time spent compressing
+};
+
+class DepthCodec
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    DepthCodec();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~DepthCodec();
+
+    /// <summary>
+    /// Set the frame size to be encoded and allocate scratch space
+    /// </summary>
+    /// <param name="width">width (in pixels) of depth frames</param>
+    /// <param name="height">height (in pixels) of depth frames</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Initialize( UINT width, UINT height );
+
+    /// <summary>
+    /// Worst case size of an encoded frame, including the header
+    /// </summary>
+    /// <returns>size (in bytes) an output buffer must have to be passed to Encode</returns>
+    ULONG GetMaxEncodedSize( ) const;
+
+    /// <summary>
+    /// Compress a depth frame, keeping the player index bits intact
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels, width * height of them</param>
+    /// <param name="pEncoded">buffer to receive the encoded frame</param>
+    /// <param name="cbEncoded">size (in bytes) of pEncoded, at least GetMaxEncodedSize</param>
+    /// <returns>size (in bytes) of the encoded frame, 0 on failure</returns>
+    ULONG Encode( const USHORT * pDepth, BYTE * pEncoded, ULONG cbEncoded );
+
+    /// <summary>
+    /// Decompress a frame produced by Encode
+    /// </summary>
+    /// <param name="pEncoded">encoded frame</param>
+    /// <param name="cbEncoded">size (in bytes) of the encoded frame</param>
+    /// <param name="pDepth">receives width * height packed depth pixels</param>
+    /// <returns>true if successful, false if the data is corrupt or of another size</returns>
+    bool Decode( const BYTE * pEncoded, ULONG cbEncoded, USHORT * pDepth );
+
+private:
+    UINT                     m_width;
+    UINT                     m_height;
+
+    // Zigzagged prediction residuals of the frame being encoded
+    USHORT *                 m_pResiduals;
+};
+
+class DepthRecorder
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    DepthRecorder();
+
+    /// <summary>
+    /// Destructor, closes the file
+    /// </summary>
+    ~DepthRecorder();
+
+    /// <summary>
+    /// Create the recording file, replacing any file of that name
+    /// </summary>
+    /// <param name="szFileName">file to record to</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Create( LPCWSTR szFileName );
+
+    /// <summary>
+    /// Compress a depth frame and append it to the file
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels, width * height of them with no padding between rows</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="frameNumber">sensor frame number</param>
+    /// <param name="timeStamp">sensor timestamp</param>
+    /// <returns>true if the frame was written, false otherwise</returns>
+    bool Write( const USHORT * pDepth, UINT width, UINT height, DWORD frameNumber, LONGLONG timeStamp );
+
+    /// <summary>
+    /// Compress an infrared frame and append it to the file
+    /// </summary>
+    /// <param name="pInfrared">infrared samples, width * height of them with no padding between rows</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="frameNumber">sensor frame number</param>
+    /// <param name="timeStamp">sensor timestamp</param>
+    /// <returns>true if the frame was written, false otherwise</returns>
+    bool WriteInfrared( const USHORT * pInfrared, UINT width, UINT height, DWORD frameNumber, LONGLONG timeStamp );
+
+    /// <summary>
+    /// Close the file
+    /// </summary>
+    void Close( );
+
+    /// <summary>
+    /// What has been written since the file was created
+    /// </summary>
+    /// <returns>frame and byte counts</returns>
+    const DEPTH_RECORDING_STATISTICS & GetStatistics( ) const { return m_statistics; }
+
+private:
+    /// <summary>
+    /// Compress a frame of either stream and append it to the file
+    /// </summary>
+    /// <param name="dwStream">DEPTH_RECORDING_STREAM_ value</param>
+    /// <param name="pPixels">16-bit pixels, width * height of them with no padding between rows</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="frameNumber">sensor frame number</param>
+    /// <param name="timeStamp">sensor timestamp</param>
+    /// <returns>true if the frame was written, false otherwise</returns>
+    bool WriteFrame( DWORD dwStream, const USHORT * pPixels, UINT width, UINT height, DWORD frameNumber, LONGLONG timeStamp );
+
+    HANDLE                   m_hFile;
+    DepthCodec               m_codec;
+
+    // Encoded frame, after room for its DEPTH_RECORDING_FRAME
+    BYTE *                   m_pBuffer;
+    ULONG                    m_cbBuffer;
+
+    DEPTH_RECORDING_STATISTICS m_statistics;
+};
+
+class DepthPlayer
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    DepthPlayer();
+
+    /// <summary>
+    /// Destructor, closes the file
+    /// </summary>
+    ~DepthPlayer();
+
+    /// <summary>
+    /// Open a recording
+    /// </summary>
+    /// <param name="szFileName">file written by DepthRecorder</param>
+    /// <returns>S_OK if successful, HRESULT_FROM_WIN32(ERROR_BAD_FORMAT) if it isn't a recording of this version, otherwise an error code</returns>
+    HRESULT Open( LPCWSTR szFileName );
+
+    /// <summary>
+    /// Read and decompress the next frame
+    /// </summary>
+    /// <param name="frame">receives the timestamp, frame number, encoded size and stream of the frame</param>
+    /// <param name="width">receives the width (in pixels) of the frame</param>
+    /// <param name="height">receives the height (in pixels) of the frame</param>
+    /// <returns>packed depth pixels or infrared samples valid until the next call, NULL at the end of the file or if it is corrupt</returns>
+    const USHORT * ReadFrame( DEPTH_RECORDING_FRAME & frame, UINT & width, UINT & height );
+
+    /// <summary>
+    /// Close the file
+    /// </summary>
+    void Close( );
+
+private:
+    HANDLE                   m_hFile;
+    DepthCodec               m_codec;
+
+    BYTE *                   m_pEncoded;
+    ULONG                    m_cbEncoded;
+    USHORT *                 m_pDepth;
+    UINT                     m_cDepth;
+};
@@ -0,0 +1,128 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthHistogram.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "DepthHistogram.h"
+
+/// <summary>
+/// Constructor
+/// </summary>
+DepthHistogram::DepthHistogram() :
+    m_total(0),
+    m_tableTotal(0)
+{
+    ZeroMemory( m_counts, sizeof(m_counts) );
+    ZeroMemory( m_tableCounts, sizeof(m_tableCounts) );
+    ZeroMemory( m_intensity, sizeof(m_intensity) );
+}
+
+/// <summary>
+/// Count a depth frame and rebuild the intensity table if the histogram moved
+/// </summary>
+/// <param name="pDepth">packed depth and player index of the frame</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <returns>true if the intensity table was rebuilt, false otherwise</returns>
+bool DepthHistogram::Update( const USHORT * pDepth, UINT width, UINT height )
+{
+    BeginCount( );
+
+    // A sparse grid is plenty to find where the scene is
+    for ( UINT y = DEPTH_HISTOGRAM_GRID / 2; y < height; y += DEPTH_HISTOGRAM_GRID )
+    {
+        const USHORT * pRow = pDepth + y * width;
+        for ( UINT x = DEPTH_HISTOGRAM_GRID / 2; x < width; x += DEPTH_HISTOGRAM_GRID )
+        {
+            ++m_counts[pRow[x] >> (NUI_IMAGE_PLAYER_INDEX_SHIFT + DEPTH_HISTOGRAM_BIN_SHIFT)];
+        }
+    }
+
+    return EndCount( );
+}
+
+/// <summary>
+/// Start a histogram counted by another pass over the depth, for passes
+/// that count alongside other work
+/// </summary>
+/// <returns>DEPTH_HISTOGRAM_BINS zeroed counts to add pixels to</returns>
+DWORD * DepthHistogram::BeginCount( )
+{
+    ZeroMemory( m_counts, sizeof(m_counts) );
+
+    return m_counts;
+}
+
+/// <summary>
+/// Finish a histogram started with BeginCount and rebuild the intensity
+/// table if the histogram moved
+/// </summary>
+/// <returns>true if the intensity table was rebuilt, false otherwise</returns>
+bool DepthHistogram::EndCount( )
+{
+    // The first bin also holds pixels with no depth, which don't take part
+    m_counts[0] = 0;
+
+    m_total = 0;
+    for ( UINT bin = 0; bin < DEPTH_HISTOGRAM_BINS; ++bin )
+    {
+        m_total += m_counts[bin];
+    }
+
+    if ( 0 == m_total )
+    {
+        return false;
+    }
+
+    // How much of the histogram moved, comparing the two as fractions of their totals
+    if ( 0 != m_tableTotal )
+    {
+        ULONGLONG moved = 0;
+        for ( UINT bin = 0; bin < DEPTH_HISTOGRAM_BINS; ++bin )
+        {
+            LONGLONG difference = static_cast<LONGLONG>(m_counts[bin]) * m_tableTotal - static_cast<LONGLONG>(m_tableCounts[bin]) * m_total;
+            moved += ( difference < 0 ) ? -difference : difference;
+        }
+
+        // Each moved sample is counted once where it left and once where it arrived
+        if ( moved * 100 <= 2ULL * DEPTH_HISTOGRAM_REBUILD_PERCENT * m_total * m_tableTotal )
+        {
+            return false;
+        }
+    }
+
+    BuildTable( );
+
+    CopyMemory( m_tableCounts, m_counts, sizeof(m_tableCounts) );
+    m_tableTotal = m_total;
+
+    return true;
+}
+
+/// <summary>
+/// Rebuild the intensity table from the cumulative distribution of m_counts
+/// </summary>
+void DepthHistogram::BuildTable( )
+{
+    const UINT binWidth = 1 << DEPTH_HISTOGRAM_BIN_SHIFT;
+    const UINT range = 255 - DEPTH_HISTOGRAM_FAR_INTENSITY;
+    const UINT scale = m_total * binWidth;
+
+    m_intensity[0] = 0;
+
+    // Nearest is brightest; within a bin the distribution is taken to be even
+    DWORD below = 0;
+    UINT depth = 1;
+    for ( UINT bin = 0; bin < DEPTH_HISTOGRAM_BINS; ++bin )
+    {
+        for ( ; depth < (bin + 1) * binWidth; ++depth )
+        {
+            UINT cumulative = below * binWidth + m_counts[bin] * (depth - bin * binWidth);
+            m_intensity[depth] = static_cast<BYTE>(255 - (cumulative * range + scale / 2) / scale);
+        }
+
+        below += m_counts[bin];
+    }
+}
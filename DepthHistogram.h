@@ -0,0 +1,88 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthHistogram.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Auto-contrast for the depth view.  A histogram of depth, sampled on a sparse
+// grid, is turned into a table that spreads the display intensities over the
+// distances actually in the scene.  The table is only rebuilt when the
+// histogram has changed enough to be seen.  A pass that already visits every
+// pixel can count the grid alongside its other work, through BeginCount.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Depth values are 13 bits, histogram bins are 1 << shift millimeters wide
+#define DEPTH_HISTOGRAM_DEPTHS          (1 << (16 - NUI_IMAGE_PLAYER_INDEX_SHIFT))
+#define DEPTH_HISTOGRAM_BIN_SHIFT       4
+#define DEPTH_HISTOGRAM_BINS            (DEPTH_HISTOGRAM_DEPTHS >> DEPTH_HISTOGRAM_BIN_SHIFT)
+
+// Every GRID-th pixel of every GRID-th row is counted
+#define DEPTH_HISTOGRAM_GRID            4
+
+// The table is rebuilt once this percentage of the histogram has moved
+#define DEPTH_HISTOGRAM_REBUILD_PERCENT 5
+
+// Intensity of the farthest depth; the nearest is 255 and no depth is 0
+#define DEPTH_HISTOGRAM_FAR_INTENSITY   32
+
+class DepthHistogram
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    DepthHistogram();
+
+    /// <summary>
+    /// Count a depth frame and rebuild the intensity table if the histogram moved
+    /// </summary>
+    /// <param name="pDepth">packed depth and player index of the frame</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <returns>true if the intensity table was rebuilt, false otherwise</returns>
+    bool Update( const USHORT * pDepth, UINT width, UINT height );
+
+    /// <summary>
+    /// Start a histogram counted by another pass over the depth, for passes
+    /// that count alongside other work
+    /// </summary>
+    /// <returns>DEPTH_HISTOGRAM_BINS zeroed counts to add pixels to</returns>
+    DWORD * BeginCount( );
+
+    /// <summary>
+    /// Finish a histogram started with BeginCount and rebuild the intensity
+    /// table if the histogram moved
+    /// </summary>
+    /// <returns>true if the intensity table was rebuilt, false otherwise</returns>
+    bool EndCount( );
+
+    /// <summary>
+    /// Whether the intensity table has been built from any frame yet
+    /// </summary>
+    /// <returns>true if the table is usable, false while it is still all black</returns>
+    bool HasTable( ) const { return 0 != m_tableTotal; }
+
+    /// <summary>
+    /// Display intensity of each depth in millimeters
+    /// </summary>
+    /// <returns>table of DEPTH_HISTOGRAM_DEPTHS intensities</returns>
+    const BYTE * GetIntensityTable( ) const { return m_intensity; }
+
+private:
+    /// <summary>
+    /// Rebuild the intensity table from the cumulative distribution of m_counts
+    /// </summary>
+    void BuildTable( );
+
+    DWORD                   m_counts[DEPTH_HISTOGRAM_BINS];
+    DWORD                   m_total;
+
+    // The histogram the table was built from
+    DWORD                   m_tableCounts[DEPTH_HISTOGRAM_BINS];
+    DWORD                   m_tableTotal;
+
+    BYTE                    m_intensity[DEPTH_HISTOGRAM_DEPTHS];
+};
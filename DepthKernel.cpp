@@ -0,0 +1,266 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthKernel.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "DepthKernel.h"
+#include <emmintrin.h>
+
+//lookups for color tinting based on player index
+static const int g_IntensityShiftByPlayerR[] = { 1, 2, 0, 2, 0, 0, 2, 0 };
+static const int g_IntensityShiftByPlayerG[] = { 1, 2, 2, 0, 2, 0, 0, 1 };
+static const int g_IntensityShiftByPlayerB[] = { 1, 0, 2, 2, 0, 2, 0, 2 };
+
+// Marks pixels without depth when looking for the nearest depth
+static const USHORT g_NoDepth = 0x7FFF;
+
+// Every instantiation of RunOutputs, in the order Select and Run index them
+const DepthKernel::KERNEL_PROC DepthKernel::s_pfnKernels[2][DEPTH_KERNEL_COMBINATIONS] =
+{
+    {
+        &DepthKernel::RunOutputs<0x00, false>, &DepthKernel::RunOutputs<0x01, false>, &DepthKernel::RunOutputs<0x02, false>, &DepthKernel::RunOutputs<0x03, false>,
+        &DepthKernel::RunOutputs<0x04, false>, &DepthKernel::RunOutputs<0x05, false>, &DepthKernel::RunOutputs<0x06, false>, &DepthKernel::RunOutputs<0x07, false>,
+        &DepthKernel::RunOutputs<0x08, false>, &DepthKernel::RunOutputs<0x09, false>, &DepthKernel::RunOutputs<0x0A, false>, &DepthKernel::RunOutputs<0x0B, false>,
+        &DepthKernel::RunOutputs<0x0C, false>, &DepthKernel::RunOutputs<0x0D, false>, &DepthKernel::RunOutputs<0x0E, false>, &DepthKernel::RunOutputs<0x0F, false>,
+        &DepthKernel::RunOutputs<0x10, false>, &DepthKernel::RunOutputs<0x11, false>, &DepthKernel::RunOutputs<0x12, false>, &DepthKernel::RunOutputs<0x13, false>,
+        &DepthKernel::RunOutputs<0x14, false>, &DepthKernel::RunOutputs<0x15, false>, &DepthKernel::RunOutputs<0x16, false>, &DepthKernel::RunOutputs<0x17, false>,
+        &DepthKernel::RunOutputs<0x18, false>, &DepthKernel::RunOutputs<0x19, false>, &DepthKernel::RunOutputs<0x1A, false>, &DepthKernel::RunOutputs<0x1B, false>,
+        &DepthKernel::RunOutputs<0x1C, false>, &DepthKernel::RunOutputs<0x1D, false>, &DepthKernel::RunOutputs<0x1E, false>, &DepthKernel::RunOutputs<0x1F, false>,
+    },
+    {
+        &DepthKernel::RunOutputs<0x00, true>, &DepthKernel::RunOutputs<0x01, true>, &DepthKernel::RunOutputs<0x02, true>, &DepthKernel::RunOutputs<0x03, true>,
+        &DepthKernel::RunOutputs<0x04, true>, &DepthKernel::RunOutputs<0x05, true>, &DepthKernel::RunOutputs<0x06, true>, &DepthKernel::RunOutputs<0x07, true>,
+        &DepthKernel::RunOutputs<0x08, true>, &DepthKernel::RunOutputs<0x09, true>, &DepthKernel::RunOutputs<0x0A, true>, &DepthKernel::RunOutputs<0x0B, true>,
+        &DepthKernel::RunOutputs<0x0C, true>, &DepthKernel::RunOutputs<0x0D, true>, &DepthKernel::RunOutputs<0x0E, true>, &DepthKernel::RunOutputs<0x0F, true>,
+        &DepthKernel::RunOutputs<0x10, true>, &DepthKernel::RunOutputs<0x11, true>, &DepthKernel::RunOutputs<0x12, true>, &DepthKernel::RunOutputs<0x13, true>,
+        &DepthKernel::RunOutputs<0x14, true>, &DepthKernel::RunOutputs<0x15, true>, &DepthKernel::RunOutputs<0x16, true>, &DepthKernel::RunOutputs<0x17, true>,
+        &DepthKernel::RunOutputs<0x18, true>, &DepthKernel::RunOutputs<0x19, true>, &DepthKernel::RunOutputs<0x1A, true>, &DepthKernel::RunOutputs<0x1B, true>,
+        &DepthKernel::RunOutputs<0x1C, true>, &DepthKernel::RunOutputs<0x1D, true>, &DepthKernel::RunOutputs<0x1E, true>, &DepthKernel::RunOutputs<0x1F, true>,
+    },
+};
+
+/// <summary>
+/// Constructor
+/// </summary>
+DepthKernel::DepthKernel() :
+    m_imageType(NUI_IMAGE_TYPE_DEPTH),
+    m_resolution(NUI_IMAGE_RESOLUTION_INVALID),
+    m_width(0),
+    m_height(0),
+    m_pfnKernels(NULL)
+{
+    // transform 13-bit depth information into an 8-bit intensity appropriate
+    // for display (we disregard information in most significant bit)
+    for ( UINT depth = 0; depth < DEPTH_HISTOGRAM_DEPTHS; ++depth )
+    {
+        m_fixedIntensity[depth] = static_cast<BYTE>(~(depth >> 4));
+    }
+
+    // tint the intensity by dividing by per-player values; no alpha information
+    for ( UINT player = 0; player <= NUI_IMAGE_PLAYER_INDEX_MASK; ++player )
+    {
+        for ( UINT intensity = 0; intensity < 256; ++intensity )
+        {
+            m_tint[player][intensity] =
+                (intensity >> g_IntensityShiftByPlayerB[player]) |
+                ((intensity >> g_IntensityShiftByPlayerG[player]) << 8) |
+                ((intensity >> g_IntensityShiftByPlayerR[player]) << 16);
+        }
+    }
+}
+
+/// <summary>
+/// Pick the kernels for frames of a depth stream, keeping them if nothing changed
+/// </summary>
+/// <param name="imageType">NUI_IMAGE_TYPE_DEPTH or NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX</param>
+/// <param name="resolution">resolution of the depth stream</param>
+/// <returns>true if successful, false if the stream isn't depth or its width isn't a multiple of 8</returns>
+bool DepthKernel::Select( NUI_IMAGE_TYPE imageType, NUI_IMAGE_RESOLUTION resolution )
+{
+    if ( m_pfnKernels && imageType == m_imageType && resolution == m_resolution )
+    {
+        return true;
+    }
+
+    m_pfnKernels = NULL;
+
+    if ( NUI_IMAGE_TYPE_DEPTH != imageType && NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX != imageType )
+    {
+        return false;
+    }
+
+    DWORD width, height;
+    NuiImageResolutionToSize( resolution, width, height );
+    if ( 0 == width || 0 != width % 8 )
+    {
+        return false;
+    }
+
+    // Near mode only moves the range of the depth, the packing is the same
+    m_imageType = imageType;
+    m_resolution = resolution;
+    m_width = width;
+    m_height = height;
+    m_pfnKernels = s_pfnKernels[HasPlayerIndex( ) ? 1 : 0];
+
+    return true;
+}
+
+/// <summary>
+/// Run one pass over a depth frame of the selected stream
+/// </summary>
+/// <param name="outputs">DEPTH_KERNEL_ flags of the outputs to produce</param>
+/// <param name="pDepth">packed depth and player index, width * height of them</param>
+/// <param name="targets">where each requested output goes</param>
+void DepthKernel::Run( DWORD outputs, const USHORT * pDepth, DEPTH_KERNEL_TARGETS & targets )
+{
+    (this->*m_pfnKernels[outputs & (DEPTH_KERNEL_COMBINATIONS - 1)])( pDepth, m_width, m_height, targets );
+}
+
+/// <summary>
+/// The pass for one combination of outputs
+/// </summary>
+/// <param name="pDepth">packed depth and player index, width * height of them</param>
+/// <param name="width">width (in pixels) of the frame, a multiple of 8</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="targets">where each output goes</param>
+template <DWORD Outputs, bool bPlayerIndex>
+void DepthKernel::RunOutputs( const USHORT * pDepth, UINT width, UINT height, DEPTH_KERNEL_TARGETS & targets )
+{
+    const bool bColorize = 0 != (Outputs & DEPTH_KERNEL_COLORIZE);
+    const bool bStatistics = 0 != (Outputs & DEPTH_KERNEL_STATISTICS);
+    const bool bPlayerMasks = 0 != (Outputs & DEPTH_KERNEL_PLAYER_MASKS);
+    const bool bHistogram = 0 != (Outputs & DEPTH_KERNEL_HISTOGRAM);
+    const bool bPointCloud = 0 != (Outputs & DEPTH_KERNEL_POINT_CLOUD);
+
+    // Statistics and points take eight pixels at a time, the rest one at a time
+    const bool bVector = bStatistics || bPointCloud;
+    const bool bScalar = bColorize || bPlayerMasks;
+
+    DWORD * pRGBX = reinterpret_cast<DWORD *>(targets.pRGBX);
+    const BYTE * pIntensity = targets.pIntensity ? targets.pIntensity : m_fixedIntensity;
+    PlayerSegmentation * pSegmentation = targets.pSegmentation;
+    DWORD * pHistogram = targets.pHistogram;
+    const POINT_CLOUD_TARGET & cloud = targets.pointCloud;
+
+    const __m128i zero = _mm_setzero_si128( );
+    const __m128i ones = _mm_set1_epi16( 1 );
+    const __m128i noDepth = _mm_set1_epi16( g_NoDepth );
+    const __m128i playerMask = _mm_set1_epi16( NUI_IMAGE_PLAYER_INDEX_MASK );
+    const __m128 millimetersToMeters = _mm_set1_ps( 0.001f );
+
+    __m128i nearest = noDepth;
+    __m128i farthest = zero;
+    __m128i sum = zero;
+    UINT holes = 0;
+
+    UINT i = 0;
+    for ( UINT y = 0; y < height; ++y )
+    {
+        for ( UINT x = 0; x < width; x += 8, i += 8 )
+        {
+            if ( bVector )
+            {
+                __m128i packed = _mm_loadu_si128( reinterpret_cast<const __m128i *>(pDepth + i) );
+                __m128i depth = _mm_srli_epi16( packed, NUI_IMAGE_PLAYER_INDEX_SHIFT );
+                __m128i hole = _mm_cmpeq_epi16( depth, zero );
+
+                // One bit per pixel without depth
+                holes += CountBits( _mm_movemask_epi8( hole ) & 0x5555 );
+
+                if ( bStatistics )
+                {
+                    // Depth is 13 bits, so signed 16-bit compares are safe and
+                    // pairs of depths sum without overflow
+                    nearest = _mm_min_epi16( nearest, _mm_or_si128( depth, _mm_and_si128( hole, noDepth ) ) );
+                    farthest = _mm_max_epi16( farthest, depth );
+                    sum = _mm_add_epi32( sum, _mm_madd_epi16( depth, ones ) );
+                }
+
+                if ( bPointCloud )
+                {
+                    __m128 zLow  = _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( depth, zero ) ), millimetersToMeters );
+                    __m128 zHigh = _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( depth, zero ) ), millimetersToMeters );
+
+                    _mm_store_ps( cloud.pX + i,     _mm_mul_ps( _mm_load_ps( cloud.pRayX + i ),     zLow ) );
+                    _mm_store_ps( cloud.pX + i + 4, _mm_mul_ps( _mm_load_ps( cloud.pRayX + i + 4 ), zHigh ) );
+                    _mm_store_ps( cloud.pY + i,     _mm_mul_ps( _mm_load_ps( cloud.pRayY + i ),     zLow ) );
+                    _mm_store_ps( cloud.pY + i + 4, _mm_mul_ps( _mm_load_ps( cloud.pRayY + i + 4 ), zHigh ) );
+                    _mm_store_ps( cloud.pZ + i,     zLow );
+                    _mm_store_ps( cloud.pZ + i + 4, zHigh );
+
+                    if ( bPlayerIndex && cloud.pPlayer )
+                    {
+                        __m128i player = _mm_and_si128( packed, playerMask );
+                        _mm_storel_epi64( reinterpret_cast<__m128i *>(cloud.pPlayer + i), _mm_packus_epi16( player, player ) );
+                    }
+                }
+            }
+
+            if ( bScalar )
+            {
+                // Still in L1 from the vector loads
+                for ( UINT k = 0; k < 8; ++k )
+                {
+                    // Without a player index every pixel is the background, which
+                    // leaves a single row of tints and no player spans to track
+                    USHORT depth     = pDepth[i + k];
+                    USHORT realDepth = NuiDepthPixelToDepth(depth);
+                    USHORT player    = bPlayerIndex ? NuiDepthPixelToPlayerIndex(depth) : 0;
+
+                    if ( bColorize )
+                    {
+                        pRGBX[i + k] = m_tint[player][pIntensity[realDepth]];
+                    }
+
+                    if ( bPlayerMasks )
+                    {
+                        pSegmentation->AddPixel( x + k, player );
+                    }
+                }
+            }
+        }
+
+        if ( bPlayerMasks )
+        {
+            pSegmentation->EndRow( y );
+        }
+
+        // The histogram samples the grid DepthHistogram::Update does, from the
+        // row just read, so the pixel loop above stays as it is without it
+        if ( bHistogram && DEPTH_HISTOGRAM_GRID / 2 == y % DEPTH_HISTOGRAM_GRID )
+        {
+            const USHORT * pRow = pDepth + y * width;
+            for ( UINT x = DEPTH_HISTOGRAM_GRID / 2; x < width; x += DEPTH_HISTOGRAM_GRID )
+            {
+                ++pHistogram[pRow[x] >> (NUI_IMAGE_PLAYER_INDEX_SHIFT + DEPTH_HISTOGRAM_BIN_SHIFT)];
+            }
+        }
+    }
+
+    if ( bVector )
+    {
+        targets.statistics.cValid = width * height - holes;
+    }
+
+    if ( bStatistics )
+    {
+        // Fold the eight lanes down to one
+        nearest = _mm_min_epi16( nearest, _mm_srli_si128( nearest, 8 ) );
+        nearest = _mm_min_epi16( nearest, _mm_srli_si128( nearest, 4 ) );
+        nearest = _mm_min_epi16( nearest, _mm_srli_si128( nearest, 2 ) );
+        farthest = _mm_max_epi16( farthest, _mm_srli_si128( farthest, 8 ) );
+        farthest = _mm_max_epi16( farthest, _mm_srli_si128( farthest, 4 ) );
+        farthest = _mm_max_epi16( farthest, _mm_srli_si128( farthest, 2 ) );
+        sum = _mm_add_epi32( sum, _mm_srli_si128( sum, 8 ) );
+        sum = _mm_add_epi32( sum, _mm_srli_si128( sum, 4 ) );
+
+        DEPTH_STATISTICS & statistics = targets.statistics;
+        USHORT minDepth = static_cast<USHORT>(_mm_cvtsi128_si32( nearest ));
+        statistics.minDepth = ( g_NoDepth == minDepth ) ? 0 : minDepth;
+        statistics.maxDepth = static_cast<USHORT>(_mm_cvtsi128_si32( farthest ));
+        statistics.meanDepth = statistics.cValid ? static_cast<float>(static_cast<DWORD>(_mm_cvtsi128_si32( sum ))) / statistics.cValid : 0.0f;
+    }
+}
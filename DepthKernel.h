@@ -0,0 +1,120 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthKernel.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// One pass over a depth frame that produces every output the frame is needed
+// for: the colorized view, depth statistics, player masks, a depth histogram
+// and a point cloud.  Each combination of outputs is its own instantiation of
+// one template, so outputs nobody asked for are compiled out of the loop
+// instead of tested per pixel, and the frame is read once however many
+// outputs there are.  The kernels are also specialized on whether the stream
+// carries a player index, and are picked once for each stream.
+
+#pragma once
+
+#include "NuiApi.h"
+#include "DepthHistogram.h"
+#include "PlayerSegmentation.h"
+#include "PointCloud.h"
+
+// Outputs of a pass, any combination of them
+#define DEPTH_KERNEL_COLORIZE           0x01
+#define DEPTH_KERNEL_STATISTICS         0x02
+#define DEPTH_KERNEL_PLAYER_MASKS       0x04
+#define DEPTH_KERNEL_HISTOGRAM          0x08
+#define DEPTH_KERNEL_POINT_CLOUD        0x10
+#define DEPTH_KERNEL_COMBINATIONS       0x20
+
+/// <summary>
+/// Count the bits set in a 16-bit mask, such as the byte mask of a compare of
+/// eight depths
+/// </summary>
+inline UINT CountBits( UINT mask )
+{
+    mask = mask - ((mask >> 1) & 0x5555);
+    mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+    mask = (mask + (mask >> 4)) & 0x0F0F;
+    return (mask + (mask >> 8)) & 0x1F;
+}
+
+// Depth of the pixels of one frame that have depth
+struct DEPTH_STATISTICS
+{
+    DWORD   cValid;         // pixels with depth
+    USHORT  minDepth;       // millimeters, 0 if no pixel has depth
+    USHORT  maxDepth;
+    float   meanDepth;
+};
+
+// Where a pass writes each output; only the members of requested outputs are read
+struct DEPTH_KERNEL_TARGETS
+{
+    BYTE *                  pRGBX;          // DEPTH_KERNEL_COLORIZE: BGRX of each pixel
+    const BYTE *            pIntensity;     //   intensity of each depth, NULL for the fixed shading
+    PlayerSegmentation *    pSegmentation;  // DEPTH_KERNEL_PLAYER_MASKS: after its BeginFrame
+    DWORD *                 pHistogram;     // DEPTH_KERNEL_HISTOGRAM: DEPTH_HISTOGRAM_BINS counts of the DEPTH_HISTOGRAM_GRID, added to
+    POINT_CLOUD_TARGET      pointCloud;     // DEPTH_KERNEL_POINT_CLOUD: from PointCloud::BeginFrame
+    DEPTH_STATISTICS        statistics;     // DEPTH_KERNEL_STATISTICS: filled in, cValid also with DEPTH_KERNEL_POINT_CLOUD
+};
+
+class DepthKernel
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    DepthKernel();
+
+    /// <summary>
+    /// Pick the kernels for frames of a depth stream, keeping them if nothing changed
+    /// </summary>
+    /// <param name="imageType">NUI_IMAGE_TYPE_DEPTH or NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX</param>
+    /// <param name="resolution">resolution of the depth stream</param>
+    /// <returns>true if successful, false if the stream isn't depth or its width isn't a multiple of 8</returns>
+    bool Select( NUI_IMAGE_TYPE imageType, NUI_IMAGE_RESOLUTION resolution );
+
+    /// <summary>
+    /// Run one pass over a depth frame of the selected stream
+    /// </summary>
+    /// <param name="outputs">DEPTH_KERNEL_ flags of the outputs to produce</param>
+    /// <param name="pDepth">packed depth and player index, width * height of them</param>
+    /// <param name="targets">where each requested output goes</param>
+    void Run( DWORD outputs, const USHORT * pDepth, DEPTH_KERNEL_TARGETS & targets );
+
+    /// <summary>
+    /// Whether frames of the selected stream carry a player index
+    /// </summary>
+    /// <returns>true for NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, false otherwise</returns>
+    bool HasPlayerIndex( ) const { return NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX == m_imageType; }
+
+private:
+    typedef void (DepthKernel::*KERNEL_PROC)( const USHORT * pDepth, UINT width, UINT height, DEPTH_KERNEL_TARGETS & targets );
+
+    /// <summary>
+    /// The pass for one combination of outputs
+    /// </summary>
+    /// <param name="pDepth">packed depth and player index, width * height of them</param>
+    /// <param name="width">width (in pixels) of the frame, a multiple of 8</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="targets">where each output goes</param>
+    template <DWORD Outputs, bool bPlayerIndex>
+    void                    RunOutputs( const USHORT * pDepth, UINT width, UINT height, DEPTH_KERNEL_TARGETS & targets );
+
+    // One instantiation per combination, indexed by player index then outputs
+    static const KERNEL_PROC s_pfnKernels[2][DEPTH_KERNEL_COMBINATIONS];
+
+    // The selected stream and its row of kernels
+    NUI_IMAGE_TYPE          m_imageType;
+    NUI_IMAGE_RESOLUTION    m_resolution;
+    UINT                    m_width;
+    UINT                    m_height;
+    const KERNEL_PROC *     m_pfnKernels;
+
+    // The fixed shading, so colorizing always looks intensity up
+    BYTE                    m_fixedIntensity[DEPTH_HISTOGRAM_DEPTHS];
+
+    // BGRX of each intensity tinted for each player index
+    DWORD                   m_tint[NUI_IMAGE_PLAYER_INDEX_MASK + 1][256];
+};
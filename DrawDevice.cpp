@@ -113,6 +113,10 @@ bool DrawDevice::Initialize( HWND hWnd, ID2D1Factory * pD2DFactory, int sourceWi
     m_sourceHeight = sourceHeight;
     m_sourceStride = sourceStride;
 
+    // Create the render target and bitmap now so the first frame doesn't pay for it;
+    // on failure they are created again from Draw
+    EnsureResources( );
+
     return true;
 }
 
@@ -122,7 +126,7 @@ bool DrawDevice::Initialize( HWND hWnd, ID2D1Factory * pD2DFactory, int sourceWi
 /// <param name="pImage">image data in RGBX format</param>
 /// <param name="cbImage">size of image data in bytes</param>
 /// <returns>true if successful, false otherwise</returns>
-bool DrawDevice::Draw( BYTE * pImage, unsigned long cbImage )
+bool DrawDevice::Draw( const BYTE * pImage, unsigned long cbImage )
 {
     // incorrectly sized image data passed in
     if ( cbImage < ((m_sourceHeight - 1) * m_sourceStride) + (m_sourceWidth * 4) )
@@ -41,7 +41,7 @@ public:
     /// <param name="pImage">image data in RGBX format</param>
     /// <param name="cbImage">size of image data in bytes</param>
     /// <returns>true if successful, false otherwise</returns>
-    bool Draw( BYTE * pImage, unsigned long cbImage );
+    bool Draw( const BYTE * pImage, unsigned long cbImage );
 
 private:
     HWND                     m_hWnd;
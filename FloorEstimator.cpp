@@ -0,0 +1,538 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FloorEstimator.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "FloorEstimator.h"
+#include <math.h>
+
+static const float g_DegreesToRadians = 3.14159265f / 180.0f;
+
+/// <summary>
+/// Constructor
+/// </summary>
+FloorEstimator::FloorEstimator() :
+    m_bSearching(FALSE),
+    m_searchMinLevel(1.0f),
+    m_cSamples(0),
+    m_random(0x9E3779B9),
+    m_bGravity(false),
+    m_bMoved(false),
+    m_lastSearchTime(0),
+    m_bFound(false),
+    m_bUnread(false)
+{
+    // Level until the accelerometer says otherwise
+    m_up[0] = m_searchUp[0] = 0.0f;
+    m_up[1] = m_searchUp[1] = 1.0f;
+    m_up[2] = m_searchUp[2] = 0.0f;
+
+    ZeroMemory( m_parts, sizeof(m_parts) );
+    for ( UINT i = 0; i < FLOOR_SEARCH_TASKS; ++i )
+    {
+        m_parts[i].pOwner = this;
+    }
+
+    ZeroMemory( &m_estimate, sizeof(m_estimate) );
+    InitializeCriticalSection( &m_csPlane );
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+FloorEstimator::~FloorEstimator()
+{
+    DeleteCriticalSection( &m_csPlane );
+}
+
+/// <summary>
+/// Give the accelerometer reading, to level the search and to search again when the sensor is moved
+/// </summary>
+/// <param name="gravity">reading of NuiAccelerometerGetCurrentReading</param>
+void FloorEstimator::SetGravity( const Vector4 & gravity )
+{
+    // The reading is in g, anything far from 1 is the sensor being handled
+    float length = sqrtf( gravity.x * gravity.x + gravity.y * gravity.y + gravity.z * gravity.z );
+    if ( length < 0.5f || length > 1.5f )
+    {
+        return;
+    }
+
+    EnterCriticalSection( &m_csPlane );
+
+    m_up[0] = -gravity.x / length;
+    m_up[1] = -gravity.y / length;
+    m_up[2] = -gravity.z / length;
+
+    // The first reading levels a search that had to guess
+    float turn = m_up[0] * m_searchUp[0] + m_up[1] * m_searchUp[1] + m_up[2] * m_searchUp[2];
+    if ( !m_bGravity || turn < cosf( FLOOR_MOVED_ANGLE * g_DegreesToRadians ) )
+    {
+        m_bMoved = true;
+    }
+    m_bGravity = true;
+
+    LeaveCriticalSection( &m_csPlane );
+}
+
+/// <summary>
+/// Sample a depth frame and start a search, if one is due and the last has finished
+/// </summary>
+/// <param name="pDepth">packed depth pixels, width * height of them</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="bPlayerIndex">whether the depth carries a player index, so players can be skipped</param>
+/// <param name="time">current time in milliseconds, from timeGetTime</param>
+/// <returns>true if a search was started, false otherwise</returns>
+bool FloorEstimator::Submit( const USHORT * pDepth, UINT width, UINT height, bool bPlayerIndex, DWORD time )
+{
+    if ( m_bSearching )
+    {
+        return false;
+    }
+
+    EnterCriticalSection( &m_csPlane );
+    DWORD interval = m_bFound ? FLOOR_REFRESH_INTERVAL : FLOOR_RETRY_INTERVAL;
+    bool bDue = m_bMoved || 0 == m_lastSearchTime || (time - m_lastSearchTime) >= interval;
+    LeaveCriticalSection( &m_csPlane );
+
+    if ( !bDue )
+    {
+        return false;
+    }
+
+    // Same projection as NuiTransformDepthImageToSkeleton, on an even grid of pixels
+    UINT stepX = max( 1, width / FLOOR_SAMPLE_COLUMNS );
+    UINT stepY = max( 1, height / FLOOR_SAMPLE_ROWS );
+    float scale = NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width;
+
+    UINT cSamples = 0;
+    for ( UINT y = stepY / 2; y < height && cSamples < _countof(m_sampleX); y += stepY )
+    {
+        const USHORT * pRow = pDepth + y * width;
+        float rayY = -(static_cast<float>(y) - height / 2.0f) * scale;
+
+        for ( UINT x = stepX / 2; x < width && cSamples < _countof(m_sampleX); x += stepX )
+        {
+            USHORT packed = pRow[x];
+
+            // Players aren't the floor, and their feet would pull it up
+            if ( bPlayerIndex && 0 != (packed & NUI_IMAGE_PLAYER_INDEX_MASK) )
+            {
+                continue;
+            }
+
+            USHORT depth = packed >> NUI_IMAGE_PLAYER_INDEX_SHIFT;
+            if ( 0 == depth )
+            {
+                continue;
+            }
+
+            float z = depth * 0.001f;
+            m_sampleX[cSamples] = (static_cast<float>(x) - width / 2.0f) * scale * z;
+            m_sampleY[cSamples] = rayY * z;
+            m_sampleZ[cSamples] = z;
+            ++cSamples;
+        }
+    }
+
+    // A frame too empty to search leaves the search due for the next one
+    if ( cSamples < FLOOR_MIN_INLIERS )
+    {
+        return false;
+    }
+
+    // The search levels with the newest reading, so a move reported while sampling is covered by it
+    EnterCriticalSection( &m_csPlane );
+    m_lastSearchTime = time;
+    m_bMoved = false;
+    m_searchUp[0] = m_up[0];
+    m_searchUp[1] = m_up[1];
+    m_searchUp[2] = m_up[2];
+    m_searchMinLevel = cosf( (m_bGravity ? FLOOR_MAX_TILT_GRAVITY : FLOOR_MAX_TILT) * g_DegreesToRadians );
+    LeaveCriticalSection( &m_csPlane );
+
+    // Each part picks its points from its own sequence, so the floor found doesn't depend on which thread runs which
+    for ( UINT i = 0; i < FLOOR_SEARCH_TASKS; ++i )
+    {
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 17;
+        m_random ^= m_random << 5;
+        m_parts[i].random = m_random;
+    }
+
+    m_cSamples = cSamples;
+    InterlockedExchange( &m_bSearching, TRUE );
+
+    return true;
+}
+
+/// <summary>
+/// Add the tasks that run a search started by Submit to a graph; they do nothing if none was started
+/// </summary>
+/// <param name="graph">graph to add the tasks to</param>
+/// <param name="after">task that calls Submit, -1 if Submit is called before the graph runs</param>
+/// <returns>index of the task that finishes the search, -1 if the graph is full</returns>
+int FloorEstimator::AddSearch( TaskGraph & graph, int after )
+{
+    int parts[FLOOR_SEARCH_TASKS];
+    for ( UINT i = 0; i < FLOOR_SEARCH_TASKS; ++i )
+    {
+        parts[i] = graph.AddTask( SearchPartTask, &m_parts[i] );
+        if ( parts[i] < 0 || (after >= 0 && !graph.AddDependency( after, parts[i] )) )
+        {
+            return -1;
+        }
+    }
+
+    int finish = graph.AddTask( FinishSearchTask, this );
+    for ( UINT i = 0; i < FLOOR_SEARCH_TASKS && finish >= 0; ++i )
+    {
+        if ( !graph.AddDependency( parts[i], finish ) )
+        {
+            return -1;
+        }
+    }
+
+    return finish;
+}
+
+/// <summary>
+/// The floor found
+/// </summary>
+/// <param name="plane">receives the plane, as in FLOOR_ESTIMATE</param>
+/// <returns>true if a floor has been found, false otherwise</returns>
+bool FloorEstimator::GetPlane( Vector4 & plane )
+{
+    EnterCriticalSection( &m_csPlane );
+    plane = m_estimate.plane;
+    bool bFound = m_bFound;
+    LeaveCriticalSection( &m_csPlane );
+
+    return bFound;
+}
+
+/// <summary>
+/// Read the floor found by the last search, if there has been one since the last read
+/// </summary>
+/// <param name="estimate">receives the search result</param>
+/// <returns>true if a floor was found since the last read, false otherwise</returns>
+bool FloorEstimator::ReadEstimate( FLOOR_ESTIMATE & estimate )
+{
+    EnterCriticalSection( &m_csPlane );
+    estimate = m_estimate;
+    bool bUnread = m_bUnread;
+    m_bUnread = false;
+    LeaveCriticalSection( &m_csPlane );
+
+    return bUnread;
+}
+
+/// <summary>
+/// Measure how high the skeletons of a frame are above the floor
+/// </summary>
+/// <param name="frame">skeleton frame</param>
+/// <param name="pHeights">receives a height for each tracked skeleton, room for NUI_SKELETON_COUNT</param>
+/// <returns>number of skeletons measured, 0 if no floor has been found</returns>
+UINT FloorEstimator::MeasureSkeletons( const NUI_SKELETON_FRAME & frame, FLOOR_SKELETON_HEIGHT * pHeights )
+{
+    Vector4 plane;
+    if ( !GetPlane( plane ) )
+    {
+        return 0;
+    }
+
+    UINT cHeights = 0;
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        const NUI_SKELETON_DATA & skeleton = frame.SkeletonData[i];
+        if ( NUI_SKELETON_TRACKED != skeleton.eTrackingState )
+        {
+            continue;
+        }
+
+        const Vector4 & head = skeleton.SkeletonPositions[NUI_SKELETON_POSITION_HEAD];
+        const Vector4 & hip = skeleton.SkeletonPositions[NUI_SKELETON_POSITION_HIP_CENTER];
+        const Vector4 & footLeft = skeleton.SkeletonPositions[NUI_SKELETON_POSITION_FOOT_LEFT];
+        const Vector4 & footRight = skeleton.SkeletonPositions[NUI_SKELETON_POSITION_FOOT_RIGHT];
+
+        FLOOR_SKELETON_HEIGHT & height = pHeights[cHeights++];
+        height.dwTrackingID = skeleton.dwTrackingID;
+        height.head = plane.x * head.x + plane.y * head.y + plane.z * head.z + plane.w;
+        height.hip = plane.x * hip.x + plane.y * hip.y + plane.z * hip.z + plane.w;
+        height.feet = min( plane.x * footLeft.x + plane.y * footLeft.y + plane.z * footLeft.z,
+                           plane.x * footRight.x + plane.y * footRight.y + plane.z * footRight.z ) + plane.w;
+    }
+
+    return cHeights;
+}
+
+/// <summary>
+/// Task to try a share of the planes, calls class instance processor
+/// </summary>
+/// <param name="pContext">SEARCH_PART to run</param>
+void FloorEstimator::SearchPartTask( void * pContext )
+{
+    SEARCH_PART * pPart = static_cast<SEARCH_PART *>(pContext);
+    if ( pPart->pOwner->m_bSearching )
+    {
+        pPart->pOwner->SearchPart( *pPart );
+    }
+}
+
+/// <summary>
+/// Task to finish the search, calls class instance processor
+/// </summary>
+/// <param name="pContext">instance pointer</param>
+void FloorEstimator::FinishSearchTask( void * pContext )
+{
+    FloorEstimator * pThis = static_cast<FloorEstimator *>(pContext);
+    if ( pThis->m_bSearching )
+    {
+        pThis->FinishSearch( );
+        InterlockedExchange( &pThis->m_bSearching, FALSE );
+    }
+}
+
+/// <summary>
+/// Try a share of the planes through random points
+/// </summary>
+/// <param name="part">receives the best plane tried and its score</param>
+void FloorEstimator::SearchPart( SEARCH_PART & part ) const
+{
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency( &frequency );
+    QueryPerformanceCounter( &start );
+
+    const float * up = m_searchUp;
+    float minLevel = m_searchMinLevel;
+    float best[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    int bestScore = 0;
+
+    UINT random = part.random;
+
+    for ( UINT iteration = 0; iteration < FLOOR_RANSAC_ITERATIONS / FLOOR_SEARCH_TASKS; ++iteration )
+    {
+        UINT index[3];
+        for ( UINT i = 0; i < 3; ++i )
+        {
+            // xorshift, good enough to pick points
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            index[i] = random % m_cSamples;
+        }
+
+        float ax = m_sampleX[index[1]] - m_sampleX[index[0]];
+        float ay = m_sampleY[index[1]] - m_sampleY[index[0]];
+        float az = m_sampleZ[index[1]] - m_sampleZ[index[0]];
+        float bx = m_sampleX[index[2]] - m_sampleX[index[0]];
+        float by = m_sampleY[index[2]] - m_sampleY[index[0]];
+        float bz = m_sampleZ[index[2]] - m_sampleZ[index[0]];
+
+        float plane[4];
+        plane[0] = ay * bz - az * by;
+        plane[1] = az * bx - ax * bz;
+        plane[2] = ax * by - ay * bx;
+
+        // Points in a line, or the same point twice, fix no plane
+        float length = sqrtf( plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2] );
+        if ( length < 1e-6f )
+        {
+            continue;
+        }
+
+        float level = (plane[0] * up[0] + plane[1] * up[1] + plane[2] * up[2]) / length;
+        if ( level < 0.0f )
+        {
+            length = -length;
+            level = -level;
+        }
+
+        if ( level < minLevel )
+        {
+            continue;
+        }
+
+        plane[0] /= length;
+        plane[1] /= length;
+        plane[2] /= length;
+        plane[3] = -(plane[0] * m_sampleX[index[0]] + plane[1] * m_sampleY[index[0]] + plane[2] * m_sampleZ[index[0]]);
+
+        // The sensor stands above the floor
+        if ( plane[3] <= 0.0f )
+        {
+            continue;
+        }
+
+        UINT cBelow = 0;
+        int score = static_cast<int>(CountInliers( plane, &cBelow )) - static_cast<int>(cBelow);
+        if ( score > bestScore )
+        {
+            bestScore = score;
+            CopyMemory( best, plane, sizeof(best) );
+        }
+    }
+
+    CopyMemory( part.best, best, sizeof(best) );
+    part.bestScore = bestScore;
+
+    QueryPerformanceCounter( &end );
+    part.seconds = static_cast<double>(end.QuadPart - start.QuadPart) / static_cast<double>(frequency.QuadPart);
+}
+
+/// <summary>
+/// Refine the best plane of all the parts and make it the floor found
+/// </summary>
+void FloorEstimator::FinishSearch( )
+{
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency( &frequency );
+    QueryPerformanceCounter( &start );
+
+    // The first part wins a tie, so the floor found doesn't depend on the order the parts ran in
+    const SEARCH_PART * pBest = &m_parts[0];
+    double seconds = 0.0;
+    for ( UINT i = 0; i < FLOOR_SEARCH_TASKS; ++i )
+    {
+        if ( m_parts[i].bestScore > pBest->bestScore )
+        {
+            pBest = &m_parts[i];
+        }
+        seconds += m_parts[i].seconds;
+    }
+
+    if ( pBest->bestScore < FLOOR_MIN_INLIERS )
+    {
+        return;
+    }
+
+    float best[4];
+    CopyMemory( best, pBest->best, sizeof(best) );
+
+    // Twice, since the refined plane can take in points the sampled one missed
+    for ( UINT pass = 0; pass < 2; ++pass )
+    {
+        if ( !Refine( best ) )
+        {
+            break;
+        }
+    }
+
+    UINT cInliers = CountInliers( best, NULL );
+
+    QueryPerformanceCounter( &end );
+
+    EnterCriticalSection( &m_csPlane );
+    m_estimate.plane.x = best[0];
+    m_estimate.plane.y = best[1];
+    m_estimate.plane.z = best[2];
+    m_estimate.plane.w = best[3];
+    m_estimate.cInliers = cInliers;
+    m_estimate.cSamples = m_cSamples;
+    m_estimate.milliseconds = static_cast<float>((seconds + static_cast<double>(end.QuadPart - start.QuadPart) / static_cast<double>(frequency.QuadPart)) * 1000.0);
+    m_bFound = true;
+    m_bUnread = true;
+    LeaveCriticalSection( &m_csPlane );
+}
+
+/// <summary>
+/// Count the points on a plane and the points under it
+/// </summary>
+/// <param name="plane">plane, normal pointing up</param>
+/// <param name="pcBelow">receives the points more than FLOOR_INLIER_DISTANCE under it</param>
+/// <returns>points within FLOOR_INLIER_DISTANCE of it</returns>
+UINT FloorEstimator::CountInliers( const float plane[4], UINT * pcBelow ) const
+{
+    UINT cInliers = 0;
+    UINT cBelow = 0;
+
+    for ( UINT i = 0; i < m_cSamples; ++i )
+    {
+        float distance = plane[0] * m_sampleX[i] + plane[1] * m_sampleY[i] + plane[2] * m_sampleZ[i] + plane[3];
+        if ( fabsf( distance ) <= FLOOR_INLIER_DISTANCE )
+        {
+            ++cInliers;
+        }
+        else if ( distance < 0.0f )
+        {
+            ++cBelow;
+        }
+    }
+
+    if ( pcBelow )
+    {
+        *pcBelow = cBelow;
+    }
+
+    return cInliers;
+}
+
+/// <summary>
+/// Fit a plane by least squares to the points near another
+/// </summary>
+/// <param name="plane">plane to refine, normal pointing up; receives the refined plane</param>
+/// <returns>true if successful, false if the points don't fix a plane</returns>
+bool FloorEstimator::Refine( float plane[4] ) const
+{
+    // The floor is never steep, so fit its height y = a x + b z + c, about the mean point
+    double cInliers = 0.0;
+    double meanX = 0.0, meanY = 0.0, meanZ = 0.0;
+    for ( UINT i = 0; i < m_cSamples; ++i )
+    {
+        float distance = plane[0] * m_sampleX[i] + plane[1] * m_sampleY[i] + plane[2] * m_sampleZ[i] + plane[3];
+        if ( fabsf( distance ) <= FLOOR_INLIER_DISTANCE )
+        {
+            meanX += m_sampleX[i];
+            meanY += m_sampleY[i];
+            meanZ += m_sampleZ[i];
+            cInliers += 1.0;
+        }
+    }
+
+    if ( cInliers < 3.0 )
+    {
+        return false;
+    }
+
+    meanX /= cInliers;
+    meanY /= cInliers;
+    meanZ /= cInliers;
+
+    double xx = 0.0, xz = 0.0, zz = 0.0, xy = 0.0, zy = 0.0;
+    for ( UINT i = 0; i < m_cSamples; ++i )
+    {
+        float distance = plane[0] * m_sampleX[i] + plane[1] * m_sampleY[i] + plane[2] * m_sampleZ[i] + plane[3];
+        if ( fabsf( distance ) <= FLOOR_INLIER_DISTANCE )
+        {
+            double x = m_sampleX[i] - meanX;
+            double y = m_sampleY[i] - meanY;
+            double z = m_sampleZ[i] - meanZ;
+            xx += x * x;
+            xz += x * z;
+            zz += z * z;
+            xy += x * y;
+            zy += z * y;
+        }
+    }
+
+    double determinant = xx * zz - xz * xz;
+    if ( fabs( determinant ) < 1e-9 )
+    {
+        return false;
+    }
+
+    double a = (xy * zz - zy * xz) / determinant;
+    double b = (zy * xx - xy * xz) / determinant;
+
+    // y - a x - b z = c, scaled to a unit normal
+    double length = sqrt( a * a + 1.0 + b * b );
+    plane[0] = static_cast<float>(-a / length);
+    plane[1] = static_cast<float>(1.0 / length);
+    plane[2] = static_cast<float>(-b / length);
+    plane[3] = static_cast<float>(-(meanY - a * meanX - b * meanZ) / length);
+
+    return true;
+}
@@ -0,0 +1,204 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FloorEstimator.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Finds the floor in the depth stream, for when the floor clip plane of the
+// skeleton frames is missing or wanders.  A few thousand points are sampled
+// from a depth frame, skipping players, and tasks on the scheduler the depth
+// stages run on fit a plane to them with RANSAC, each trying its share of the
+// planes: planes through three random points, tilted no further
+// from level than gravity allows, score the points near them less the points
+// under them, so a table top loses to the floor it stands on.  The best plane
+// is refined by least squares over the points near it.  The floor is only
+// searched for again every few seconds, or sooner once the accelerometer
+// shows the sensor has been moved, so the cost spreads over many frames.
+
+#pragma once
+
+#include "NuiApi.h"
+#include "TaskScheduler.h"
+
+// Points sampled from a depth frame, at most
+#define FLOOR_SAMPLE_COLUMNS            80
+#define FLOOR_SAMPLE_ROWS               60
+
+#define FLOOR_RANSAC_ITERATIONS         128
+
+// Tasks the RANSAC iterations are split over
+#define FLOOR_SEARCH_TASKS              4
+
+// Distance (in meters) from the plane a point may be and still be on the floor
+#define FLOOR_INLIER_DISTANCE           0.03f
+
+// Fewest points on a floor
+#define FLOOR_MIN_INLIERS               100
+
+// Time between searches (in milliseconds) while the sensor stays put
+#define FLOOR_REFRESH_INTERVAL          5000
+
+// Time between searches (in milliseconds) until a floor is found
+#define FLOOR_RETRY_INTERVAL            500
+
+// Change of gravity (in degrees) that means the sensor has been moved
+#define FLOOR_MOVED_ANGLE               2.0f
+
+// Furthest the floor may be tilted from level (in degrees), with and without a gravity reading
+#define FLOOR_MAX_TILT_GRAVITY          15.0f
+#define FLOOR_MAX_TILT                  40.0f
+
+// The last floor found
+struct FLOOR_ESTIMATE
+{
+    Vector4 plane;              // x, y, z normal pointing up, w the height (in meters) of the sensor above the floor
+    UINT    cInliers;           // points on the plane
+    UINT    cSamples;           // points searched
+    float   milliseconds;       // time the search took, over all its tasks
+};
+
+// How high a skeleton is above the floor
+struct FLOOR_SKELETON_HEIGHT
+{
+    DWORD   dwTrackingID;
+    float   head;               // meters
+    float   hip;
+    float   feet;               // the lower foot
+};
+
+class FloorEstimator
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    FloorEstimator();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~FloorEstimator();
+
+    /// <summary>
+    /// Give the accelerometer reading, to level the search and to search again when the sensor is moved
+    /// </summary>
+    /// <param name="gravity">reading of NuiAccelerometerGetCurrentReading</param>
+    void SetGravity( const Vector4 & gravity );
+
+    /// <summary>
+    /// Sample a depth frame and start a search, if one is due and the last has finished
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels, width * height of them</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="bPlayerIndex">whether the depth carries a player index, so players can be skipped</param>
+    /// <param name="time">current time in milliseconds, from timeGetTime</param>
+    /// <returns>true if a search was started, false otherwise</returns>
+    bool Submit( const USHORT * pDepth, UINT width, UINT height, bool bPlayerIndex, DWORD time );
+
+    /// <summary>
+    /// Add the tasks that run a search started by Submit to a graph; they do nothing if none was started
+    /// </summary>
+    /// <param name="graph">graph to add the tasks to</param>
+    /// <param name="after">task that calls Submit, -1 if Submit is called before the graph runs</param>
+    /// <returns>index of the task that finishes the search, -1 if the graph is full</returns>
+    int AddSearch( TaskGraph & graph, int after );
+
+    /// <summary>
+    /// The floor found
+    /// </summary>
+    /// <param name="plane">receives the plane, as in FLOOR_ESTIMATE</param>
+    /// <returns>true if a floor has been found, false otherwise</returns>
+    bool GetPlane( Vector4 & plane );
+
+    /// <summary>
+    /// Read the floor found by the last search, if there has been one since the last read
+    /// </summary>
+    /// <param name="estimate">receives the search result</param>
+    /// <returns>true if a floor was found since the last read, false otherwise</returns>
+    bool ReadEstimate( FLOOR_ESTIMATE & estimate );
+
+    /// <summary>
+    /// Measure how high the skeletons of a frame are above the floor
+    /// </summary>
+    /// <param name="frame">skeleton frame</param>
+    /// <param name="pHeights">receives a height for each tracked skeleton, room for NUI_SKELETON_COUNT</param>
+    /// <returns>number of skeletons measured, 0 if no floor has been found</returns>
+    UINT MeasureSkeletons( const NUI_SKELETON_FRAME & frame, FLOOR_SKELETON_HEIGHT * pHeights );
+
+private:
+    // One share of the RANSAC iterations, and the best plane it found
+    struct SEARCH_PART
+    {
+        FloorEstimator *    pOwner;
+        UINT                random;
+        float               best[4];
+        int                 bestScore;
+        double              seconds;
+    };
+
+    /// <summary>
+    /// Task to try a share of the planes, calls class instance processor
+    /// </summary>
+    /// <param name="pContext">SEARCH_PART to run</param>
+    static void             SearchPartTask( void * pContext );
+
+    /// <summary>
+    /// Task to finish the search, calls class instance processor
+    /// </summary>
+    /// <param name="pContext">instance pointer</param>
+    static void             FinishSearchTask( void * pContext );
+
+    /// <summary>
+    /// Try a share of the planes through random points
+    /// </summary>
+    /// <param name="part">receives the best plane tried and its score</param>
+    void                    SearchPart( SEARCH_PART & part ) const;
+
+    /// <summary>
+    /// Refine the best plane of all the parts and make it the floor found
+    /// </summary>
+    void                    FinishSearch( );
+
+    /// <summary>
+    /// Count the points on a plane and the points under it
+    /// </summary>
+    /// <param name="plane">plane, normal pointing up</param>
+    /// <param name="pcBelow">receives the points more than FLOOR_INLIER_DISTANCE under it</param>
+    /// <returns>points within FLOOR_INLIER_DISTANCE of it</returns>
+    UINT                    CountInliers( const float plane[4], UINT * pcBelow ) const;
+
+    /// <summary>
+    /// Fit a plane by least squares to the points near another
+    /// </summary>
+    /// <param name="plane">plane to refine, normal pointing up; receives the refined plane</param>
+    /// <returns>true if successful, false if the points don't fix a plane</returns>
+    bool                    Refine( float plane[4] ) const;
+
+    // Set while a search runs; the samples and the level it searches at belong to its
+    // tasks until it clears.  SetGravity compares with the up it levels with, so that
+    // is only written under m_csPlane
+    volatile LONG           m_bSearching;
+    SEARCH_PART             m_parts[FLOOR_SEARCH_TASKS];
+    float                   m_searchUp[3];
+    float                   m_searchMinLevel;
+    float                   m_sampleX[FLOOR_SAMPLE_COLUMNS * FLOOR_SAMPLE_ROWS];
+    float                   m_sampleY[FLOOR_SAMPLE_COLUMNS * FLOOR_SAMPLE_ROWS];
+    float                   m_sampleZ[FLOOR_SAMPLE_COLUMNS * FLOOR_SAMPLE_ROWS];
+    UINT                    m_cSamples;
+    UINT                    m_random;
+
+    // Direction of up from gravity, guarded by m_csPlane
+    CRITICAL_SECTION        m_csPlane;
+    float                   m_up[3];
+    bool                    m_bGravity;
+
+    // Whether gravity has turned since the last search, so the sensor has been moved, guarded by m_csPlane
+    bool                    m_bMoved;
+    DWORD                   m_lastSearchTime;
+
+    // The floor found, guarded by m_csPlane
+    FLOOR_ESTIMATE          m_estimate;
+    bool                    m_bFound;
+    bool                    m_bUnread;
+};
@@ -0,0 +1,472 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FrameSource.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "FrameSource.h"
+
+/// <summary>
+/// Constructor
+/// </summary>
+FrameSource::FrameSource() :
+    m_hThread(NULL),
+    m_hPosted(NULL),
+    m_bStop(false),
+    m_cConsumers(0),
+    m_pDispatcher(NULL),
+    m_pRunning(NULL)
+{
+    ZeroMemory( m_posted, sizeof(m_posted) );
+    ZeroMemory( m_current, sizeof(m_current) );
+    ZeroMemory( &m_postedSkeleton, sizeof(m_postedSkeleton) );
+    ZeroMemory( &m_currentSkeleton, sizeof(m_currentSkeleton) );
+    ZeroMemory( m_postedSequence, sizeof(m_postedSequence) );
+    ZeroMemory( m_sequence, sizeof(m_sequence) );
+    ZeroMemory( m_consumers, sizeof(m_consumers) );
+
+    InitializeCriticalSection( &m_csPosted );
+}
+
+/// <summary>
+/// Destructor, lets every consumer finish and stops the consumer thread
+/// </summary>
+FrameSource::~FrameSource()
+{
+    if ( m_hThread )
+    {
+        m_bStop = true;
+        SetEvent( m_hPosted );
+        WaitForSingleObject( m_hThread, INFINITE );
+        CloseHandle( m_hThread );
+    }
+
+    if ( m_hPosted )
+    {
+        CloseHandle( m_hPosted );
+    }
+
+    for ( int i = 0; i < FRAME_KIND_SKELETON; ++i )
+    {
+        delete [] m_posted[i].pBuffer;
+        delete [] m_current[i].pBuffer;
+    }
+
+    DeleteCriticalSection( &m_csPosted );
+}
+
+/// <summary>
+/// Start the consumer thread
+/// </summary>
+/// <returns>true if successful, false otherwise</returns>
+bool FrameSource::Start( )
+{
+    if ( m_hThread )
+    {
+        return true;
+    }
+
+    m_hPosted = CreateEvent( NULL, FALSE, FALSE, NULL );
+    if ( NULL == m_hPosted )
+    {
+        return false;
+    }
+
+    m_hThread = CreateThread( NULL, 0, ConsumerThread, this, 0, NULL );
+
+    return NULL != m_hThread;
+}
+
+/// <summary>
+/// Add a consumer; it starts on the consumer thread and runs until it first waits for a frame
+/// </summary>
+/// <param name="pfnProc">body of the consumer</param>
+/// <param name="pContext">passed through to pfnProc</param>
+/// <returns>true if successful, false if there are too many consumers</returns>
+bool FrameSource::AddConsumer( FRAME_CONSUMER_PROC pfnProc, void * pContext )
+{
+    bool bAdded = false;
+
+    EnterCriticalSection( &m_csPosted );
+    if ( m_cConsumers < FRAME_MAX_CONSUMERS )
+    {
+        CONSUMER & consumer = m_consumers[m_cConsumers++];
+        consumer.pOwner = this;
+        consumer.pfnProc = pfnProc;
+        consumer.pContext = pContext;
+        bAdded = true;
+    }
+    LeaveCriticalSection( &m_csPosted );
+
+    // The fiber is made on the consumer thread, the next round
+    if ( bAdded && m_hPosted )
+    {
+        SetEvent( m_hPosted );
+    }
+
+    return bAdded;
+}
+
+/// <summary>
+/// Post a depth frame from the pipeline
+/// </summary>
+/// <param name="pDepth">packed depth pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="pitch">bytes from one row to the next</param>
+/// <param name="dwFrameNumber">frame number</param>
+/// <param name="timeStamp">time stamp in milliseconds</param>
+void FrameSource::PostDepth( const USHORT * pDepth, UINT width, UINT height, UINT pitch, DWORD dwFrameNumber, LONGLONG timeStamp )
+{
+    PostImage( FRAME_KIND_DEPTH, reinterpret_cast<const BYTE *>(pDepth), width, height, pitch, sizeof(USHORT), dwFrameNumber, timeStamp );
+}
+
+/// <summary>
+/// Post a color frame from the pipeline
+/// </summary>
+/// <param name="pColor">BGRX pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="pitch">bytes from one row to the next</param>
+/// <param name="dwFrameNumber">frame number</param>
+/// <param name="timeStamp">time stamp in milliseconds</param>
+void FrameSource::PostColor( const BYTE * pColor, UINT width, UINT height, UINT pitch, DWORD dwFrameNumber, LONGLONG timeStamp )
+{
+    PostImage( FRAME_KIND_COLOR, pColor, width, height, pitch, 4, dwFrameNumber, timeStamp );
+}
+
+/// <summary>
+/// Post an infrared frame from the pipeline, which comes instead of color while the infrared view is on
+/// </summary>
+/// <param name="pInfrared">16-bit infrared samples</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="pitch">bytes from one row to the next</param>
+/// <param name="dwFrameNumber">frame number</param>
+/// <param name="timeStamp">time stamp in milliseconds</param>
+void FrameSource::PostInfrared( const USHORT * pInfrared, UINT width, UINT height, UINT pitch, DWORD dwFrameNumber, LONGLONG timeStamp )
+{
+    PostImage( FRAME_KIND_INFRARED, reinterpret_cast<const BYTE *>(pInfrared), width, height, pitch, sizeof(USHORT), dwFrameNumber, timeStamp );
+}
+
+/// <summary>
+/// Post a skeleton frame from the pipeline
+/// </summary>
+/// <param name="frame">skeleton frame</param>
+void FrameSource::PostSkeleton( const NUI_SKELETON_FRAME & frame )
+{
+    EnterCriticalSection( &m_csPosted );
+    m_postedSkeleton = frame;
+    ++m_postedSequence[FRAME_KIND_SKELETON];
+    LeaveCriticalSection( &m_csPosted );
+
+    SetEvent( m_hPosted );
+}
+
+/// <summary>
+/// Copy an image frame into a slot, growing it if needed
+/// </summary>
+/// <param name="kind">FRAME_KIND_DEPTH, FRAME_KIND_COLOR or FRAME_KIND_INFRARED</param>
+/// <param name="pBits">first row of the frame</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="pitch">bytes from one row to the next</param>
+/// <param name="bytesPerPixel">bytes in a pixel</param>
+/// <param name="dwFrameNumber">frame number</param>
+/// <param name="timeStamp">time stamp in milliseconds</param>
+void FrameSource::PostImage( int kind, const BYTE * pBits, UINT width, UINT height, UINT pitch, UINT bytesPerPixel,
+    DWORD dwFrameNumber, LONGLONG timeStamp )
+{
+    UINT rowSize = width * bytesPerPixel;
+    UINT size = rowSize * height;
+
+    EnterCriticalSection( &m_csPosted );
+
+    IMAGE_SLOT & slot = m_posted[kind];
+    if ( slot.capacity < size )
+    {
+        delete [] slot.pBuffer;
+        slot.pBuffer = new BYTE[size];
+        slot.capacity = size;
+    }
+
+    for ( UINT y = 0; y < height; ++y )
+    {
+        CopyMemory( slot.pBuffer + y * rowSize, pBits + y * pitch, rowSize );
+    }
+
+    slot.image.pBits = slot.pBuffer;
+    slot.image.width = width;
+    slot.image.height = height;
+    slot.image.bytesPerPixel = bytesPerPixel;
+    slot.image.dwFrameNumber = dwFrameNumber;
+    slot.image.timeStamp = timeStamp;
+    ++m_postedSequence[kind];
+
+    LeaveCriticalSection( &m_csPosted );
+
+    SetEvent( m_hPosted );
+}
+
+/// <summary>
+/// Wait for the next depth frame; only for consumers
+/// </summary>
+/// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+const FRAME_IMAGE * FrameSource::NextDepth( )
+{
+    CONSUMER * pConsumer = Await( FRAME_KIND_DEPTH );
+    if ( NULL == pConsumer )
+    {
+        return NULL;
+    }
+
+    pConsumer->seen[FRAME_KIND_DEPTH] = m_sequence[FRAME_KIND_DEPTH];
+    return &m_current[FRAME_KIND_DEPTH].image;
+}
+
+/// <summary>
+/// Wait for the next color frame; only for consumers
+/// </summary>
+/// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+const FRAME_IMAGE * FrameSource::NextColor( )
+{
+    CONSUMER * pConsumer = Await( FRAME_KIND_COLOR );
+    if ( NULL == pConsumer )
+    {
+        return NULL;
+    }
+
+    pConsumer->seen[FRAME_KIND_COLOR] = m_sequence[FRAME_KIND_COLOR];
+    return &m_current[FRAME_KIND_COLOR].image;
+}
+
+/// <summary>
+/// Wait for the next infrared frame; only for consumers
+/// </summary>
+/// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+const FRAME_IMAGE * FrameSource::NextInfrared( )
+{
+    CONSUMER * pConsumer = Await( FRAME_KIND_INFRARED );
+    if ( NULL == pConsumer )
+    {
+        return NULL;
+    }
+
+    pConsumer->seen[FRAME_KIND_INFRARED] = m_sequence[FRAME_KIND_INFRARED];
+    return &m_current[FRAME_KIND_INFRARED].image;
+}
+
+/// <summary>
+/// Wait for the next skeleton frame; only for consumers
+/// </summary>
+/// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+const NUI_SKELETON_FRAME * FrameSource::NextSkeleton( )
+{
+    CONSUMER * pConsumer = Await( FRAME_KIND_SKELETON );
+    if ( NULL == pConsumer )
+    {
+        return NULL;
+    }
+
+    pConsumer->seen[FRAME_KIND_SKELETON] = m_sequence[FRAME_KIND_SKELETON];
+    return &m_currentSkeleton;
+}
+
+/// <summary>
+/// Wait for the next depth frame with color and skeleton frames taken within FRAME_SYNC_TOLERANCE of it; only for consumers
+/// </summary>
+/// <param name="set">receives the frames, valid until the next Next call</param>
+/// <returns>true if successful, false once the source stops</returns>
+bool FrameSource::NextSyncedSet( FRAME_SET & set )
+{
+    CONSUMER * pConsumer = Await( FRAME_WAIT_SET );
+    if ( NULL == pConsumer )
+    {
+        return false;
+    }
+
+    pConsumer->seenSet = m_sequence[FRAME_KIND_DEPTH];
+    set.pDepth = &m_current[FRAME_KIND_DEPTH].image;
+    set.pColor = &m_current[FRAME_KIND_COLOR].image;
+    set.pSkeleton = &m_currentSkeleton;
+
+    return true;
+}
+
+/// <summary>
+/// Thread to run the consumers, calls class instance thread processor
+/// </summary>
+/// <param name="pParam">instance pointer</param>
+/// <returns>always 0</returns>
+DWORD WINAPI FrameSource::ConsumerThread( LPVOID pParam )
+{
+    FrameSource * pThis = static_cast<FrameSource *>(pParam);
+
+    // Consumers may use floating point, which a plain fiber switch leaves to chance on x86
+    pThis->m_pDispatcher = ConvertThreadToFiberEx( NULL, FIBER_FLAG_FLOAT_SWITCH );
+    if ( NULL == pThis->m_pDispatcher )
+    {
+        return 0;
+    }
+
+    UINT cConsumers = 0;
+    while ( !pThis->m_bStop )
+    {
+        WaitForSingleObject( pThis->m_hPosted, INFINITE );
+
+        cConsumers = pThis->TakeFrames( );
+        pThis->Dispatch( cConsumers );
+    }
+
+    // Every Next call fails from here on, so each consumer returns the next time it runs
+    pThis->Dispatch( cConsumers );
+
+    for ( UINT i = 0; i < cConsumers; ++i )
+    {
+        if ( pThis->m_consumers[i].pFiber )
+        {
+            DeleteFiber( pThis->m_consumers[i].pFiber );
+        }
+    }
+
+    ConvertFiberToThread( );
+
+    return 0;
+}
+
+/// <summary>
+/// Fiber of a consumer, runs its body and returns to the dispatcher for good
+/// </summary>
+/// <param name="pParam">consumer the fiber belongs to</param>
+VOID CALLBACK FrameSource::ConsumerFiber( LPVOID pParam )
+{
+    CONSUMER * pConsumer = static_cast<CONSUMER *>(pParam);
+
+    pConsumer->pfnProc( *pConsumer->pOwner, pConsumer->pContext );
+    pConsumer->bDone = true;
+
+    // Returning from a fiber would end the thread
+    SwitchToFiber( pConsumer->pOwner->m_pDispatcher );
+}
+
+/// <summary>
+/// Swap the frames posted since the last round in for the consumers to see
+/// </summary>
+/// <returns>number of consumers added so far</returns>
+UINT FrameSource::TakeFrames( )
+{
+    EnterCriticalSection( &m_csPosted );
+
+    // Swapping a slot that hasn't been posted to again would bring back an older frame
+    for ( int i = 0; i < FRAME_KIND_SKELETON; ++i )
+    {
+        if ( m_postedSequence[i] != m_sequence[i] )
+        {
+            IMAGE_SLOT slot = m_current[i];
+            m_current[i] = m_posted[i];
+            m_posted[i] = slot;
+            m_sequence[i] = m_postedSequence[i];
+        }
+    }
+
+    if ( m_postedSequence[FRAME_KIND_SKELETON] != m_sequence[FRAME_KIND_SKELETON] )
+    {
+        m_currentSkeleton = m_postedSkeleton;
+        m_sequence[FRAME_KIND_SKELETON] = m_postedSequence[FRAME_KIND_SKELETON];
+    }
+
+    UINT cConsumers = m_cConsumers;
+
+    LeaveCriticalSection( &m_csPosted );
+
+    return cConsumers;
+}
+
+/// <summary>
+/// Resume every consumer whose frame has come, and start the new ones
+/// </summary>
+/// <param name="cConsumers">number of consumers</param>
+void FrameSource::Dispatch( UINT cConsumers )
+{
+    for ( UINT i = 0; i < cConsumers; ++i )
+    {
+        CONSUMER & consumer = m_consumers[i];
+        if ( consumer.bDone )
+        {
+            continue;
+        }
+
+        if ( NULL == consumer.pFiber )
+        {
+            // Not worth starting a consumer only to stop it
+            if ( m_bStop )
+            {
+                continue;
+            }
+
+            consumer.pFiber = CreateFiberEx( 0, FRAME_CONSUMER_STACK_SIZE, FIBER_FLAG_FLOAT_SWITCH, ConsumerFiber, &consumer );
+            if ( NULL == consumer.pFiber )
+            {
+                consumer.bDone = true;
+                continue;
+            }
+        }
+        else if ( !m_bStop && !IsReady( consumer ) )
+        {
+            continue;
+        }
+
+        m_pRunning = &consumer;
+        SwitchToFiber( consumer.pFiber );
+        m_pRunning = NULL;
+    }
+}
+
+/// <summary>
+/// Whether what a consumer waits for has come
+/// </summary>
+/// <param name="consumer">consumer to check</param>
+/// <returns>true if it can be resumed, false otherwise</returns>
+bool FrameSource::IsReady( const CONSUMER & consumer ) const
+{
+    if ( FRAME_WAIT_SET != consumer.wait )
+    {
+        return m_sequence[consumer.wait] != consumer.seen[consumer.wait];
+    }
+
+    // A set is built around each new depth frame, once the color and skeletons of its moment are in
+    if ( 0 == m_sequence[FRAME_KIND_COLOR] || 0 == m_sequence[FRAME_KIND_SKELETON] || m_sequence[FRAME_KIND_DEPTH] == consumer.seenSet )
+    {
+        return false;
+    }
+
+    LONGLONG depthTime = m_current[FRAME_KIND_DEPTH].image.timeStamp;
+    LONGLONG colorApart = m_current[FRAME_KIND_COLOR].image.timeStamp - depthTime;
+    LONGLONG skeletonApart = m_currentSkeleton.liTimeStamp.QuadPart - depthTime;
+
+    return colorApart >= -FRAME_SYNC_TOLERANCE && colorApart <= FRAME_SYNC_TOLERANCE &&
+        skeletonApart >= -FRAME_SYNC_TOLERANCE && skeletonApart <= FRAME_SYNC_TOLERANCE;
+}
+
+/// <summary>
+/// Switch back to the dispatcher until what the running consumer waits for has come
+/// </summary>
+/// <param name="wait">FRAME_KIND or FRAME_WAIT_SET to wait for</param>
+/// <returns>the running consumer, NULL if the source stopped or no consumer is running</returns>
+FrameSource::CONSUMER * FrameSource::Await( int wait )
+{
+    CONSUMER * pConsumer = m_pRunning;
+    if ( NULL == pConsumer || GetCurrentFiber( ) != pConsumer->pFiber )
+    {
+        return NULL;
+    }
+
+    pConsumer->wait = wait;
+    while ( !m_bStop && !IsReady( *pConsumer ) )
+    {
+        SwitchToFiber( m_pDispatcher );
+    }
+
+    return m_bStop ? NULL : pConsumer;
+}
@@ -0,0 +1,253 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FrameSource.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Hands the frames of the pipeline to any number of consumers, each written
+// as a plain loop that asks for its next frame, without a thread of its own.
+// Every consumer is a fiber on a single consumer thread.  Asking for a frame
+// that hasn't come yet switches back to the thread's dispatcher, which resumes
+// the consumer once the pipeline posts one.  The pipeline copies each frame in
+// once; the dispatcher swaps the newest frames in before every round, so all
+// consumers of a round see the same frames, and a consumer that falls behind
+// gets the newest frame rather than a backlog.  Consumers take turns on one
+// thread, so they should be quick, and must not block.
+
+#pragma once
+
+#include "NuiApi.h"
+
+#define FRAME_MAX_CONSUMERS         256
+
+// Stack of each consumer; a thread would reserve a megabyte
+#define FRAME_CONSUMER_STACK_SIZE   (64 * 1024)
+
+// Furthest apart (in milliseconds) the depth, color and skeleton frames of a synced set may be
+#define FRAME_SYNC_TOLERANCE        20
+
+enum FRAME_KIND
+{
+    FRAME_KIND_DEPTH = 0,
+    FRAME_KIND_COLOR,
+    FRAME_KIND_INFRARED,
+    FRAME_KIND_SKELETON,
+    FRAME_KIND_COUNT
+};
+
+// An image frame; rows are packed, width * bytesPerPixel apart
+struct FRAME_IMAGE
+{
+    const BYTE *    pBits;
+    UINT            width;
+    UINT            height;
+    UINT            bytesPerPixel;
+    DWORD           dwFrameNumber;
+    LONGLONG        timeStamp;          // milliseconds, as in NUI_IMAGE_FRAME
+};
+
+// Depth, color and skeleton frames taken close enough together to be used as one
+struct FRAME_SET
+{
+    const FRAME_IMAGE *         pDepth;
+    const FRAME_IMAGE *         pColor;
+    const NUI_SKELETON_FRAME *  pSkeleton;
+};
+
+class FrameSource;
+
+// Body of a consumer, returns when it is done or a Next call fails
+typedef void (*FRAME_CONSUMER_PROC)( FrameSource & source, void * pContext );
+
+class FrameSource
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    FrameSource();
+
+    /// <summary>
+    /// Destructor, lets every consumer finish and stops the consumer thread
+    /// </summary>
+    ~FrameSource();
+
+    /// <summary>
+    /// Start the consumer thread
+    /// </summary>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Start( );
+
+    /// <summary>
+    /// Add a consumer; it starts on the consumer thread and runs until it first waits for a frame
+    /// </summary>
+    /// <param name="pfnProc">body of the consumer</param>
+    /// <param name="pContext">passed through to pfnProc</param>
+    /// <returns>true if successful, false if there are too many consumers</returns>
+    bool AddConsumer( FRAME_CONSUMER_PROC pfnProc, void * pContext );
+
+    /// <summary>
+    /// Post a depth frame from the pipeline
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="pitch">bytes from one row to the next</param>
+    /// <param name="dwFrameNumber">frame number</param>
+    /// <param name="timeStamp">time stamp in milliseconds</param>
+    void PostDepth( const USHORT * pDepth, UINT width, UINT height, UINT pitch, DWORD dwFrameNumber, LONGLONG timeStamp );
+
+    /// <summary>
+    /// Post a color frame from the pipeline
+    /// </summary>
+    /// <param name="pColor">BGRX pixels</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="pitch">bytes from one row to the next</param>
+    /// <param name="dwFrameNumber">frame number</param>
+    /// <param name="timeStamp">time stamp in milliseconds</param>
+    void PostColor( const BYTE * pColor, UINT width, UINT height, UINT pitch, DWORD dwFrameNumber, LONGLONG timeStamp );
+
+    /// <summary>
+    /// Post an infrared frame from the pipeline, which comes instead of color while the infrared view is on
+    /// </summary>
+    /// <param name="pInfrared">16-bit infrared samples</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="pitch">bytes from one row to the next</param>
+    /// <param name="dwFrameNumber">frame number</param>
+    /// <param name="timeStamp">time stamp in milliseconds</param>
+    void PostInfrared( const USHORT * pInfrared, UINT width, UINT height, UINT pitch, DWORD dwFrameNumber, LONGLONG timeStamp );
+
+    /// <summary>
+    /// Post a skeleton frame from the pipeline
+    /// </summary>
+    /// <param name="frame">skeleton frame</param>
+    void PostSkeleton( const NUI_SKELETON_FRAME & frame );
+
+    /// <summary>
+    /// Wait for the next depth frame; only for consumers
+    /// </summary>
+    /// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+    const FRAME_IMAGE * NextDepth( );
+
+    /// <summary>
+    /// Wait for the next color frame; only for consumers
+    /// </summary>
+    /// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+    const FRAME_IMAGE * NextColor( );
+
+    /// <summary>
+    /// Wait for the next infrared frame; only for consumers
+    /// </summary>
+    /// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+    const FRAME_IMAGE * NextInfrared( );
+
+    /// <summary>
+    /// Wait for the next skeleton frame; only for consumers
+    /// </summary>
+    /// <returns>the frame, valid until the next Next call; NULL once the source stops</returns>
+    const NUI_SKELETON_FRAME * NextSkeleton( );
+
+    /// <summary>
+    /// Wait for the next depth frame with color and skeleton frames taken within FRAME_SYNC_TOLERANCE of it; only for consumers
+    /// </summary>
+    /// <param name="set">receives the frames, valid until the next Next call</param>
+    /// <returns>true if successful, false once the source stops</returns>
+    bool NextSyncedSet( FRAME_SET & set );
+
+private:
+    // What a consumer waits for, a FRAME_KIND or a whole set
+    static const int FRAME_WAIT_SET = FRAME_KIND_COUNT;
+
+    struct CONSUMER
+    {
+        FrameSource *       pOwner;
+        FRAME_CONSUMER_PROC pfnProc;
+        void *              pContext;
+        LPVOID              pFiber;
+        bool                bDone;
+        int                 wait;
+        DWORD               seen[FRAME_KIND_COUNT];     // sequence of the last frame of each kind handed out
+        DWORD               seenSet;                    // depth sequence of the last set handed out
+    };
+
+    struct IMAGE_SLOT
+    {
+        BYTE *          pBuffer;
+        UINT            capacity;
+        FRAME_IMAGE     image;
+    };
+
+    /// <summary>
+    /// Thread to run the consumers, calls class instance thread processor
+    /// </summary>
+    /// <param name="pParam">instance pointer</param>
+    /// <returns>always 0</returns>
+    static DWORD WINAPI     ConsumerThread( LPVOID pParam );
+
+    /// <summary>
+    /// Fiber of a consumer, runs its body and returns to the dispatcher for good
+    /// </summary>
+    /// <param name="pParam">consumer the fiber belongs to</param>
+    static VOID CALLBACK    ConsumerFiber( LPVOID pParam );
+
+    /// <summary>
+    /// Copy an image frame into a slot, growing it if needed
+    /// </summary>
+    /// <param name="kind">FRAME_KIND_DEPTH, FRAME_KIND_COLOR or FRAME_KIND_INFRARED</param>
+    /// <param name="pBits">first row of the frame</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="pitch">bytes from one row to the next</param>
+    /// <param name="bytesPerPixel">bytes in a pixel</param>
+    /// <param name="dwFrameNumber">frame number</param>
+    /// <param name="timeStamp">time stamp in milliseconds</param>
+    void                    PostImage( int kind, const BYTE * pBits, UINT width, UINT height, UINT pitch, UINT bytesPerPixel,
+                                DWORD dwFrameNumber, LONGLONG timeStamp );
+
+    /// <summary>
+    /// Swap the frames posted since the last round in for the consumers to see
+    /// </summary>
+    /// <returns>number of consumers added so far</returns>
+    UINT                    TakeFrames( );
+
+    /// <summary>
+    /// Resume every consumer whose frame has come, and start the new ones
+    /// </summary>
+    /// <param name="cConsumers">number of consumers</param>
+    void                    Dispatch( UINT cConsumers );
+
+    /// <summary>
+    /// Whether what a consumer waits for has come
+    /// </summary>
+    /// <param name="consumer">consumer to check</param>
+    /// <returns>true if it can be resumed, false otherwise</returns>
+    bool                    IsReady( const CONSUMER & consumer ) const;
+
+    /// <summary>
+    /// Switch back to the dispatcher until what the running consumer waits for has come
+    /// </summary>
+    /// <param name="wait">FRAME_KIND or FRAME_WAIT_SET to wait for</param>
+    /// <returns>the running consumer, NULL if the source stopped or no consumer is running</returns>
+    CONSUMER *              Await( int wait );
+
+    HANDLE                  m_hThread;
+    HANDLE                  m_hPosted;
+    volatile bool           m_bStop;
+
+    // Frames posted by the pipeline and the consumers added, guarded by m_csPosted
+    CRITICAL_SECTION        m_csPosted;
+    IMAGE_SLOT              m_posted[FRAME_KIND_SKELETON];
+    NUI_SKELETON_FRAME      m_postedSkeleton;
+    DWORD                   m_postedSequence[FRAME_KIND_COUNT];
+    CONSUMER                m_consumers[FRAME_MAX_CONSUMERS];
+    UINT                    m_cConsumers;
+
+    // Frames of the current round, only touched on the consumer thread
+    IMAGE_SLOT              m_current[FRAME_KIND_SKELETON];
+    NUI_SKELETON_FRAME      m_currentSkeleton;
+    DWORD                   m_sequence[FRAME_KIND_COUNT];
+    LPVOID                  m_pDispatcher;
+    CONSUMER *              m_pRunning;
+};
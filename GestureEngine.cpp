@@ -0,0 +1,359 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="GestureEngine.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "GestureEngine.h"
+#include <math.h>
+#include <strsafe.h>
+
+// Cost of a cell no path has reached
+static const float g_Unreached = 1e30f;
+
+// Built-in gestures, each a straight path for one hand eased in and out
+struct GESTURE_DEFAULT
+{
+    LPCWSTR                     szName;
+    NUI_SKELETON_POSITION_INDEX joint;
+    float                       from[3];
+    float                       to[3];
+    UINT                        cPoints;
+};
+
+// Skeleton space looks back at the user, so their right is +x and towards the sensor is -z
+static const GESTURE_DEFAULT g_DefaultGestures[] =
+{
+    { L"Swipe left",        NUI_SKELETON_POSITION_HAND_RIGHT, {  0.60f, -0.15f, -0.45f }, { -0.30f, -0.15f, -0.45f }, 16 },
+    { L"Swipe right",       NUI_SKELETON_POSITION_HAND_LEFT,  { -0.60f, -0.15f, -0.45f }, {  0.30f, -0.15f, -0.45f }, 16 },
+    { L"Push right hand",   NUI_SKELETON_POSITION_HAND_RIGHT, {  0.30f, -0.10f, -0.20f }, {  0.30f, -0.10f, -1.00f }, 16 },
+    { L"Push left hand",    NUI_SKELETON_POSITION_HAND_LEFT,  { -0.30f, -0.10f, -0.20f }, { -0.30f, -0.10f, -1.00f }, 16 },
+    { L"Raise right hand",  NUI_SKELETON_POSITION_HAND_RIGHT, {  0.45f, -1.00f, -0.10f }, {  0.40f,  0.80f, -0.10f }, 20 },
+    { L"Raise left hand",   NUI_SKELETON_POSITION_HAND_LEFT,  { -0.45f, -1.00f, -0.10f }, { -0.40f,  0.80f, -0.10f }, 20 },
+};
+
+/// <summary>
+/// Constructor
+/// </summary>
+GestureEngine::GestureEngine() :
+    m_cTemplates(0),
+    m_frame(0)
+{
+    ZeroMemory( m_templates, sizeof(m_templates) );
+    Reset( );
+}
+
+/// <summary>
+/// Add the built-in swipes, pushes and raised hands for either hand
+/// </summary>
+void GestureEngine::AddDefaultTemplates( )
+{
+    for ( UINT i = 0; i < _countof(g_DefaultGestures); ++i )
+    {
+        const GESTURE_DEFAULT & gesture = g_DefaultGestures[i];
+        Vector4 points[GESTURE_MAX_POINTS];
+
+        for ( UINT point = 0; point < gesture.cPoints; ++point )
+        {
+            float t = static_cast<float>(point) / (gesture.cPoints - 1);
+            float eased = t * t * (3.0f - 2.0f * t);
+
+            points[point].x = gesture.from[0] + (gesture.to[0] - gesture.from[0]) * eased;
+            points[point].y = gesture.from[1] + (gesture.to[1] - gesture.from[1]) * eased;
+            points[point].z = gesture.from[2] + (gesture.to[2] - gesture.from[2]) * eased;
+            points[point].w = 1.0f;
+        }
+
+        AddTemplate( gesture.szName, gesture.joint, points, gesture.cPoints, GESTURE_DEFAULT_THRESHOLD );
+    }
+}
+
+/// <summary>
+/// Add a template
+/// </summary>
+/// <param name="szName">name to report the gesture by</param>
+/// <param name="joint">joint that makes the gesture</param>
+/// <param name="pPoints">path of the joint relative to the shoulder center, in torso lengths, one point per frame</param>
+/// <param name="cPoints">number of points, 2 to GESTURE_MAX_POINTS</param>
+/// <param name="threshold">largest mean distance from the path that still counts</param>
+/// <returns>index of the template, -1 if there are too many or the path is too short or too long</returns>
+int GestureEngine::AddTemplate( LPCWSTR szName, NUI_SKELETON_POSITION_INDEX joint, const Vector4 * pPoints, UINT cPoints, float threshold )
+{
+    if ( m_cTemplates >= GESTURE_MAX_TEMPLATES || cPoints < 2 || cPoints > GESTURE_MAX_POINTS )
+    {
+        return -1;
+    }
+
+    GESTURE_TEMPLATE & gesture = m_templates[m_cTemplates];
+    StringCchCopyW( gesture.szName, _countof(gesture.szName), szName );
+    gesture.joint = joint;
+    gesture.cPoints = cPoints;
+    gesture.threshold = threshold;
+
+    for ( UINT point = 0; point < cPoints; ++point )
+    {
+        gesture.x[point] = pPoints[point].x;
+        gesture.y[point] = pPoints[point].y;
+        gesture.z[point] = pPoints[point].z;
+    }
+
+    // No skeleton has warped the new template yet
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        for ( UINT point = 0; point < GESTURE_MAX_POINTS; ++point )
+        {
+            m_slots[i].cost[m_cTemplates][point] = g_Unreached;
+            m_slots[i].start[m_cTemplates][point] = 0;
+        }
+        m_slots[i].cooldownEnd[m_cTemplates] = 0;
+    }
+
+    return static_cast<int>(m_cTemplates++);
+}
+
+/// <summary>
+/// Forget every skeleton
+/// </summary>
+void GestureEngine::Reset( )
+{
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        ClearSlot( m_slots[i] );
+        m_slots[i].dwTrackingID = 0;
+        m_slots[i].lastFrame = 0;
+    }
+}
+
+/// <summary>
+/// Start every warping of a slot over
+/// </summary>
+/// <param name="slot">slot to clear</param>
+void GestureEngine::ClearSlot( GESTURE_SLOT & slot )
+{
+    for ( UINT gesture = 0; gesture < GESTURE_MAX_TEMPLATES; ++gesture )
+    {
+        for ( UINT point = 0; point < GESTURE_MAX_POINTS; ++point )
+        {
+            slot.cost[gesture][point] = g_Unreached;
+            slot.start[gesture][point] = 0;
+        }
+        slot.cooldownEnd[gesture] = 0;
+    }
+}
+
+/// <summary>
+/// Find the slot of a skeleton, taking over a free or stale one for a new skeleton
+/// </summary>
+/// <param name="dwTrackingID">tracking ID of the skeleton</param>
+/// <returns>slot of the skeleton</returns>
+GestureEngine::GESTURE_SLOT * GestureEngine::FindSlot( DWORD dwTrackingID )
+{
+    GESTURE_SLOT * pOldest = NULL;
+
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        GESTURE_SLOT & slot = m_slots[i];
+        if ( slot.dwTrackingID == dwTrackingID )
+        {
+            // A skeleton that went missing starts its paths over
+            if ( slot.lastFrame + 1 != m_frame )
+            {
+                ClearSlot( slot );
+            }
+            return &slot;
+        }
+
+        // Slots not seen this frame belong to skeletons that have left
+        if ( slot.lastFrame != m_frame && (NULL == pOldest || slot.lastFrame < pOldest->lastFrame) )
+        {
+            pOldest = &slot;
+        }
+    }
+
+    // There are as many slots as skeletons in a frame, so one is always free
+    ClearSlot( *pOldest );
+    pOldest->dwTrackingID = dwTrackingID;
+
+    return pOldest;
+}
+
+/// <summary>
+/// Advance every skeleton of a frame by one frame and report the gestures that just ended
+/// </summary>
+/// <param name="frame">smoothed skeleton frame</param>
+/// <param name="pEvents">receives the gestures found</param>
+/// <param name="cMaxEvents">room in pEvents</param>
+/// <returns>number of gestures found</returns>
+UINT GestureEngine::Update( const NUI_SKELETON_FRAME & frame, GESTURE_EVENT * pEvents, UINT cMaxEvents )
+{
+    ++m_frame;
+
+    UINT cEvents = 0;
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        const NUI_SKELETON_DATA & skeleton = frame.SkeletonData[i];
+        if ( NUI_SKELETON_TRACKED != skeleton.eTrackingState )
+        {
+            continue;
+        }
+
+        GESTURE_SLOT * pSlot = FindSlot( skeleton.dwTrackingID );
+        pSlot->lastFrame = m_frame;
+
+        cEvents += UpdateSkeleton( skeleton, *pSlot, pEvents + cEvents, cMaxEvents - cEvents );
+    }
+
+    return cEvents;
+}
+
+/// <summary>
+/// Advance one skeleton by one frame
+/// </summary>
+/// <param name="skeleton">tracked skeleton</param>
+/// <param name="slot">its slot</param>
+/// <param name="pEvents">receives the gestures found</param>
+/// <param name="cMaxEvents">room in pEvents</param>
+/// <returns>number of gestures found</returns>
+UINT GestureEngine::UpdateSkeleton( const NUI_SKELETON_DATA & skeleton, GESTURE_SLOT & slot, GESTURE_EVENT * pEvents, UINT cMaxEvents )
+{
+    const Vector4 & shoulders = skeleton.SkeletonPositions[NUI_SKELETON_POSITION_SHOULDER_CENTER];
+    const Vector4 & hips = skeleton.SkeletonPositions[NUI_SKELETON_POSITION_HIP_CENTER];
+
+    float torsoX = shoulders.x - hips.x;
+    float torsoY = shoulders.y - hips.y;
+    float torsoZ = shoulders.z - hips.z;
+    float torso = sqrtf( torsoX * torsoX + torsoY * torsoY + torsoZ * torsoZ );
+
+    // Without a body to measure against nothing can be compared, so every path is broken
+    if ( NUI_SKELETON_POSITION_NOT_TRACKED == skeleton.eSkeletonPositionTrackingState[NUI_SKELETON_POSITION_SHOULDER_CENTER] ||
+         NUI_SKELETON_POSITION_NOT_TRACKED == skeleton.eSkeletonPositionTrackingState[NUI_SKELETON_POSITION_HIP_CENTER] ||
+         torso < 0.1f )
+    {
+        ClearSlot( slot );
+        return 0;
+    }
+
+    // Every joint relative to the shoulders, in torso lengths
+    float scale = 1.0f / torso;
+    float jointX[NUI_SKELETON_POSITION_COUNT];
+    float jointY[NUI_SKELETON_POSITION_COUNT];
+    float jointZ[NUI_SKELETON_POSITION_COUNT];
+    for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+    {
+        jointX[joint] = (skeleton.SkeletonPositions[joint].x - shoulders.x) * scale;
+        jointY[joint] = (skeleton.SkeletonPositions[joint].y - shoulders.y) * scale;
+        jointZ[joint] = (skeleton.SkeletonPositions[joint].z - shoulders.z) * scale;
+    }
+
+    UINT cEvents = 0;
+    for ( UINT gesture = 0; gesture < m_cTemplates; ++gesture )
+    {
+        const GESTURE_TEMPLATE & pattern = m_templates[gesture];
+        float * pCost = slot.cost[gesture];
+        DWORD * pStart = slot.start[gesture];
+        const UINT cPoints = pattern.cPoints;
+
+        if ( NUI_SKELETON_POSITION_NOT_TRACKED == skeleton.eSkeletonPositionTrackingState[pattern.joint] )
+        {
+            for ( UINT point = 0; point < cPoints; ++point )
+            {
+                pCost[point] = g_Unreached;
+            }
+            continue;
+        }
+
+        const float x = jointX[pattern.joint];
+        const float y = jointY[pattern.joint];
+        const float z = jointZ[pattern.joint];
+
+        // Paths that began longer ago than this are too slow to be the gesture
+        const DWORD oldestStart = m_frame - min( m_frame - 1, 2 * cPoints - 1 );
+
+        // A path may begin at any frame, so the first point always starts afresh
+        float diagonal = pCost[0];
+        DWORD diagonalStart = pStart[0];
+        {
+            float dx = x - pattern.x[0], dy = y - pattern.y[0], dz = z - pattern.z[0];
+            pCost[0] = sqrtf( dx * dx + dy * dy + dz * dz );
+            pStart[0] = m_frame;
+        }
+
+        // One column of the warping: each point is reached from the previous frame at this
+        // point, the previous frame at the point before, or this frame at the point before
+        float distance = 0.0f;
+        for ( UINT point = 1; point < cPoints; ++point )
+        {
+            float dx = x - pattern.x[point], dy = y - pattern.y[point], dz = z - pattern.z[point];
+            distance = sqrtf( dx * dx + dy * dy + dz * dz );
+
+            float best = pCost[point];
+            DWORD bestStart = pStart[point];
+            if ( diagonal <= best )
+            {
+                best = diagonal;
+                bestStart = diagonalStart;
+            }
+            if ( pCost[point - 1] < best )
+            {
+                best = pCost[point - 1];
+                bestStart = pStart[point - 1];
+            }
+
+            diagonal = pCost[point];
+            diagonalStart = pStart[point];
+
+            if ( bestStart < oldestStart || best >= g_Unreached )
+            {
+                pCost[point] = g_Unreached;
+                pStart[point] = 0;
+            }
+            else
+            {
+                pCost[point] = best + distance;
+                pStart[point] = bestStart;
+            }
+        }
+
+        // A path through the last point is a whole gesture, if the joint got to where the
+        // gesture ends rather than running the last points together, and it wasn't over too quickly
+        float total = pCost[cPoints - 1];
+        if ( total >= g_Unreached || distance > pattern.threshold )
+        {
+            continue;
+        }
+
+        UINT cFrames = m_frame - pStart[cPoints - 1] + 1;
+        if ( 2 * cFrames < cPoints )
+        {
+            continue;
+        }
+
+        float cost = total / max( cFrames, cPoints );
+        if ( cost > pattern.threshold || cEvents >= cMaxEvents )
+        {
+            continue;
+        }
+
+        // The same movement isn't reported twice, and one made during the cooldown isn't held back until it ends
+        for ( UINT point = 0; point < cPoints; ++point )
+        {
+            pCost[point] = g_Unreached;
+        }
+
+        if ( m_frame < slot.cooldownEnd[gesture] )
+        {
+            continue;
+        }
+
+        pEvents[cEvents].dwTrackingID = skeleton.dwTrackingID;
+        pEvents[cEvents].gesture = gesture;
+        pEvents[cEvents].cost = cost;
+        pEvents[cEvents].cFrames = cFrames;
+        ++cEvents;
+
+        slot.cooldownEnd[gesture] = m_frame + GESTURE_COOLDOWN_FRAMES;
+    }
+
+    return cEvents;
+}
@@ -0,0 +1,143 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="GestureEngine.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Recognizes gestures such as swipes, pushes and raised hands in the smoothed
+// skeleton stream.  Each gesture is a template: the path of one joint relative
+// to the shoulders, in torso lengths.  Every frame, each tracked skeleton's
+// joints extend an open-ended dynamic time warping of every template by one
+// column, so a gesture is found the frame it ends without ever searching the
+// skeleton's history.  Paths that have run longer than twice their template are
+// dropped, which bounds both the work of a frame and how slow a gesture may be.
+// All state lives in one fixed slot per skeleton, found by tracking ID.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Fixed limits, so every slot is allocated with the engine
+#define GESTURE_MAX_TEMPLATES           64
+#define GESTURE_MAX_POINTS              32
+#define GESTURE_MAX_NAME                32
+
+// Frames a skeleton must wait before the same gesture is reported again
+#define GESTURE_COOLDOWN_FRAMES         15
+
+// Mean distance (in torso lengths) between a path and its template for the built-in gestures
+#define GESTURE_DEFAULT_THRESHOLD       0.15f
+
+// One gesture found
+struct GESTURE_EVENT
+{
+    DWORD   dwTrackingID;       // skeleton that made it
+    UINT    gesture;            // template index, from AddTemplate
+    float   cost;               // mean distance from the template, in torso lengths
+    UINT    cFrames;            // frames the gesture took
+};
+
+class GestureEngine
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    GestureEngine();
+
+    /// <summary>
+    /// Add the built-in swipes, pushes and raised hands for either hand
+    /// </summary>
+    void AddDefaultTemplates( );
+
+    /// <summary>
+    /// Add a template
+    /// </summary>
+    /// <param name="szName">name to report the gesture by</param>
+    /// <param name="joint">joint that makes the gesture</param>
+    /// <param name="pPoints">path of the joint relative to the shoulder center, in torso lengths, one point per frame</param>
+    /// <param name="cPoints">number of points, 2 to GESTURE_MAX_POINTS</param>
+    /// <param name="threshold">largest mean distance from the path that still counts</param>
+    /// <returns>index of the template, -1 if there are too many or the path is too short or too long</returns>
+    int AddTemplate( LPCWSTR szName, NUI_SKELETON_POSITION_INDEX joint, const Vector4 * pPoints, UINT cPoints, float threshold );
+
+    /// <summary>
+    /// Name of a template
+    /// </summary>
+    /// <param name="gesture">template index</param>
+    /// <returns>name given to AddTemplate</returns>
+    LPCWSTR GetName( UINT gesture ) const { return m_templates[gesture].szName; }
+
+    /// <summary>
+    /// Number of templates
+    /// </summary>
+    /// <returns>templates added so far</returns>
+    UINT GetTemplateCount( ) const { return m_cTemplates; }
+
+    /// <summary>
+    /// Advance every skeleton of a frame by one frame and report the gestures that just ended
+    /// </summary>
+    /// <param name="frame">smoothed skeleton frame</param>
+    /// <param name="pEvents">receives the gestures found</param>
+    /// <param name="cMaxEvents">room in pEvents</param>
+    /// <returns>number of gestures found</returns>
+    UINT Update( const NUI_SKELETON_FRAME & frame, GESTURE_EVENT * pEvents, UINT cMaxEvents );
+
+    /// <summary>
+    /// Forget every skeleton
+    /// </summary>
+    void Reset( );
+
+private:
+    struct GESTURE_TEMPLATE
+    {
+        WCHAR                       szName[GESTURE_MAX_NAME];
+        NUI_SKELETON_POSITION_INDEX joint;
+        UINT                        cPoints;
+        float                       threshold;
+        float                       x[GESTURE_MAX_POINTS];
+        float                       y[GESTURE_MAX_POINTS];
+        float                       z[GESTURE_MAX_POINTS];
+    };
+
+    // The warping of every template for one skeleton
+    struct GESTURE_SLOT
+    {
+        DWORD   dwTrackingID;       // 0 when free
+        DWORD   lastFrame;          // engine frame the skeleton was last seen in
+        float   cost[GESTURE_MAX_TEMPLATES][GESTURE_MAX_POINTS];
+        DWORD   start[GESTURE_MAX_TEMPLATES][GESTURE_MAX_POINTS];
+        DWORD   cooldownEnd[GESTURE_MAX_TEMPLATES];
+    };
+
+    /// <summary>
+    /// Find the slot of a skeleton, taking over a free or stale one for a new skeleton
+    /// </summary>
+    /// <param name="dwTrackingID">tracking ID of the skeleton</param>
+    /// <returns>slot of the skeleton</returns>
+    GESTURE_SLOT * FindSlot( DWORD dwTrackingID );
+
+    /// <summary>
+    /// Start every warping of a slot over
+    /// </summary>
+    /// <param name="slot">slot to clear</param>
+    void ClearSlot( GESTURE_SLOT & slot );
+
+    /// <summary>
+    /// Advance one skeleton by one frame
+    /// </summary>
+    /// <param name="skeleton">tracked skeleton</param>
+    /// <param name="slot">its slot</param>
+    /// <param name="pEvents">receives the gestures found</param>
+    /// <param name="cMaxEvents">room in pEvents</param>
+    /// <returns>number of gestures found</returns>
+    UINT UpdateSkeleton( const NUI_SKELETON_DATA & skeleton, GESTURE_SLOT & slot, GESTURE_EVENT * pEvents, UINT cMaxEvents );
+
+    GESTURE_TEMPLATE        m_templates[GESTURE_MAX_TEMPLATES];
+    UINT                    m_cTemplates;
+
+    GESTURE_SLOT            m_slots[NUI_SKELETON_COUNT];
+
+    // Frames seen, so the first one is 1 and a start of 0 never matches
+    DWORD                   m_frame;
+};
@@ -0,0 +1,347 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="GreenScreen.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "GreenScreen.h"
+#include <emmintrin.h>
+
+static const int g_BytesPerPixel = 4;
+
+/// <summary>
+/// Constructor
+/// </summary>
+GreenScreen::GreenScreen() :
+    m_width(0),
+    m_height(0),
+    m_featherRadius(GREEN_SCREEN_DEFAULT_FEATHER),
+    m_maskTop(0),
+    m_maskBottom(-1),
+    m_pMask(NULL),
+    m_pScratch(NULL),
+    m_pBackground(NULL),
+    m_pOutput(NULL)
+{
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+GreenScreen::~GreenScreen()
+{
+    _aligned_free( m_pMask );
+    _aligned_free( m_pScratch );
+    _aligned_free( m_pBackground );
+    _aligned_free( m_pOutput );
+}
+
+/// <summary>
+/// Allocate all buffers for color frames of the given size, with a default background
+/// </summary>
+/// <param name="width">width (in pixels) of color frames</param>
+/// <param name="height">height (in pixels) of color frames</param>
+/// <returns>true if successful, false otherwise</returns>
+bool GreenScreen::Initialize( DWORD width, DWORD height )
+{
+    // Frames are blended 4 pixels and feathered 16 mask bytes at a time
+    if ( 0 == width || 0 == height || 0 != width % 16 )
+    {
+        return false;
+    }
+
+    m_pMask = static_cast<BYTE *>(_aligned_malloc( width * height, 16 ));
+    m_pScratch = static_cast<BYTE *>(_aligned_malloc( width * height, 16 ));
+    m_pBackground = static_cast<BYTE *>(_aligned_malloc( width * height * g_BytesPerPixel, 16 ));
+    m_pOutput = static_cast<BYTE *>(_aligned_malloc( width * height * g_BytesPerPixel, 16 ));
+    if ( NULL == m_pMask || NULL == m_pScratch || NULL == m_pBackground || NULL == m_pOutput )
+    {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+
+    ZeroMemory( m_pMask, width * height );
+    m_maskTop = 0;
+    m_maskBottom = -1;
+
+    // Until a bitmap is loaded, fade from dark to light blue
+    BYTE * pPixel = m_pBackground;
+    for ( DWORD y = 0; y < height; ++y )
+    {
+        BYTE shade = static_cast<BYTE>(y * 160 / height);
+        for ( DWORD x = 0; x < width; ++x )
+        {
+            *(pPixel++) = 96 + shade;
+            *(pPixel++) = 32 + shade / 2;
+            *(pPixel++) = shade / 4;
+            *(pPixel++) = 0;
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Replace the background with a bitmap file, stretched to the color frame size
+/// </summary>
+/// <param name="szFileName">.bmp file to load</param>
+/// <returns>true if successful, false if the background was left unchanged</returns>
+bool GreenScreen::LoadBackground( LPCWSTR szFileName )
+{
+    if ( NULL == m_pBackground )
+    {
+        return false;
+    }
+
+    HBITMAP hBitmap = static_cast<HBITMAP>(LoadImageW( NULL, szFileName, IMAGE_BITMAP, m_width, m_height, LR_LOADFROMFILE | LR_CREATEDIBSECTION ));
+    if ( NULL == hBitmap )
+    {
+        return false;
+    }
+
+    // Top down 32 bits per pixel, the same layout as color frames
+    BITMAPINFO bmi;
+    ZeroMemory( &bmi, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = m_width;
+    bmi.bmiHeader.biHeight = -static_cast<LONG>(m_height);
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    HDC hdc = GetDC( NULL );
+    int lines = GetDIBits( hdc, hBitmap, 0, m_height, m_pBackground, &bmi, DIB_RGB_COLORS );
+    ReleaseDC( NULL, hdc );
+    DeleteObject( hBitmap );
+
+    return static_cast<DWORD>(lines) == m_height;
+}
+
+/// <summary>
+/// Set how far (in color pixels) the mask edges are blurred, 0 for hard edges
+/// </summary>
+/// <param name="radius">blur radius, at most 127</param>
+void GreenScreen::SetFeatherRadius( UINT radius )
+{
+    // Column sums of the blur must fit in 16 bits
+    m_featherRadius = min( radius, 127 );
+}
+
+/// <summary>
+/// Build the color space player mask from a depth frame
+/// </summary>
+/// <param name="pColorCoordinates">x, y color coordinates of each depth pixel, from RegistrationMap</param>
+/// <param name="pLabels">player index of each depth pixel, from PlayerSegmentation</param>
+/// <param name="depthWidth">width (in pixels) of the depth frame</param>
+/// <param name="depthHeight">height (in pixels) of the depth frame</param>
+void GreenScreen::BuildMask( const LONG * pColorCoordinates, const BYTE * pLabels, DWORD depthWidth, DWORD depthHeight )
+{
+    if ( NULL == m_pMask )
+    {
+        return;
+    }
+
+    // Only the rows touched last time need clearing
+    if ( m_maskTop <= m_maskBottom )
+    {
+        ZeroMemory( m_pMask + m_maskTop * m_width, (m_maskBottom - m_maskTop + 1) * m_width );
+    }
+    m_maskTop = m_height;
+    m_maskBottom = -1;
+
+    // Each depth pixel covers a block of color pixels
+    DWORD scale = max( m_width / depthWidth, 1 );
+    DWORD pixelCount = depthWidth * depthHeight;
+
+    for ( DWORD i = 0; i < pixelCount; ++i )
+    {
+        if ( 0 == pLabels[i] )
+        {
+            continue;
+        }
+
+        // Negative coordinates wrap around to large unsigned values
+        DWORD colorX = static_cast<DWORD>(pColorCoordinates[2 * i]);
+        DWORD colorY = static_cast<DWORD>(pColorCoordinates[2 * i + 1]);
+        if ( colorX >= m_width || colorY >= m_height )
+        {
+            continue;
+        }
+
+        DWORD right = min( colorX + scale, m_width );
+        DWORD bottom = min( colorY + scale, m_height );
+        for ( DWORD y = colorY; y < bottom; ++y )
+        {
+            FillMemory( m_pMask + y * m_width + colorX, right - colorX, 0xFF );
+        }
+
+        m_maskTop = min( m_maskTop, static_cast<LONG>(colorY) );
+        m_maskBottom = max( m_maskBottom, static_cast<LONG>(bottom) - 1 );
+    }
+
+    if ( m_featherRadius > 0 && m_maskTop <= m_maskBottom )
+    {
+        FeatherMask( );
+    }
+}
+
+/// <summary>
+/// Box blur the rows of the mask that can have foreground
+/// </summary>
+void GreenScreen::FeatherMask( )
+{
+    LONG radius = m_featherRadius;
+    LONG width = m_width;
+    LONG top = max( m_maskTop - radius, 0L );
+    LONG bottom = min( m_maskBottom + radius, static_cast<LONG>(m_height) - 1 );
+
+    // Dividing by the window size, as a 16 bit fixed point multiply rounded up
+    // so that a full window still comes out as 255
+    USHORT reciprocal = static_cast<USHORT>((65536 + 2 * radius) / (2 * radius + 1));
+
+    // Horizontal pass into the scratch buffer, a running sum along each row
+    for ( LONG y = top; y <= bottom; ++y )
+    {
+        const BYTE * pRow = m_pMask + y * width;
+        BYTE * pOut = m_pScratch + y * width;
+
+        UINT sum = 0;
+        for ( LONG x = 0; x < radius && x < width; ++x )
+        {
+            sum += pRow[x];
+        }
+
+        for ( LONG x = 0; x < width; ++x )
+        {
+            if ( x + radius < width )
+            {
+                sum += pRow[x + radius];
+            }
+            pOut[x] = static_cast<BYTE>((sum * reciprocal) >> 16);
+            if ( x - radius >= 0 )
+            {
+                sum -= pRow[x - radius];
+            }
+        }
+    }
+
+    // Vertical pass back into the mask, running sums for 16 columns at a time.
+    // Rows outside the band are empty, so the sums only cover the band
+    const __m128i zero = _mm_setzero_si128( );
+    const __m128i scale = _mm_set1_epi16( static_cast<short>(reciprocal) );
+
+    for ( LONG x = 0; x < width; x += 16 )
+    {
+        __m128i sumLow = zero;
+        __m128i sumHigh = zero;
+
+        for ( LONG y = top; y < top + radius && y <= bottom; ++y )
+        {
+            __m128i row = _mm_load_si128( reinterpret_cast<const __m128i *>(m_pScratch + y * width + x) );
+            sumLow = _mm_add_epi16( sumLow, _mm_unpacklo_epi8( row, zero ) );
+            sumHigh = _mm_add_epi16( sumHigh, _mm_unpackhi_epi8( row, zero ) );
+        }
+
+        for ( LONG y = top; y <= bottom; ++y )
+        {
+            if ( y + radius <= bottom )
+            {
+                __m128i row = _mm_load_si128( reinterpret_cast<const __m128i *>(m_pScratch + (y + radius) * width + x) );
+                sumLow = _mm_add_epi16( sumLow, _mm_unpacklo_epi8( row, zero ) );
+                sumHigh = _mm_add_epi16( sumHigh, _mm_unpackhi_epi8( row, zero ) );
+            }
+
+            __m128i blurred = _mm_packus_epi16( _mm_mulhi_epu16( sumLow, scale ), _mm_mulhi_epu16( sumHigh, scale ) );
+            _mm_store_si128( reinterpret_cast<__m128i *>(m_pMask + y * width + x), blurred );
+
+            if ( y - radius >= top )
+            {
+                __m128i row = _mm_load_si128( reinterpret_cast<const __m128i *>(m_pScratch + (y - radius) * width + x) );
+                sumLow = _mm_sub_epi16( sumLow, _mm_unpacklo_epi8( row, zero ) );
+                sumHigh = _mm_sub_epi16( sumHigh, _mm_unpackhi_epi8( row, zero ) );
+            }
+        }
+    }
+
+    m_maskTop = top;
+    m_maskBottom = bottom;
+}
+
+/// <summary>
+/// Composite a color frame over the background through the current mask
+/// </summary>
+/// <param name="pColor">BGRX color frame</param>
+/// <returns>composited BGRX frame, valid until the next call</returns>
+const BYTE * GreenScreen::Composite( const BYTE * pColor )
+{
+    if ( NULL == m_pOutput )
+    {
+        return pColor;
+    }
+
+    DWORD frameSize = m_width * m_height * g_BytesPerPixel;
+
+    // Outside the masked rows it is all background
+    DWORD first = 0, last = 0;
+    if ( m_maskTop <= m_maskBottom )
+    {
+        first = m_maskTop * m_width;
+        last = (m_maskBottom + 1) * m_width;
+    }
+    CopyMemory( m_pOutput, m_pBackground, first * g_BytesPerPixel );
+    CopyMemory( m_pOutput + last * g_BytesPerPixel, m_pBackground + last * g_BytesPerPixel, frameSize - last * g_BytesPerPixel );
+
+    const __m128i zero = _mm_setzero_si128( );
+    const __m128i opaque = _mm_set1_epi16( 255 );
+    const __m128i half = _mm_set1_epi16( 128 );
+
+    // 4 pixels at a time
+    for ( DWORD i = first; i < last; i += 4 )
+    {
+        DWORD alpha4 = *reinterpret_cast<const DWORD *>(m_pMask + i);
+        __m128i * pOut = reinterpret_cast<__m128i *>(m_pOutput + i * g_BytesPerPixel);
+
+        if ( 0 == alpha4 )
+        {
+            _mm_store_si128( pOut, _mm_load_si128( reinterpret_cast<const __m128i *>(m_pBackground + i * g_BytesPerPixel) ) );
+            continue;
+        }
+
+        __m128i foreground = _mm_loadu_si128( reinterpret_cast<const __m128i *>(pColor + i * g_BytesPerPixel) );
+        if ( 0xFFFFFFFF == alpha4 )
+        {
+            _mm_store_si128( pOut, foreground );
+            continue;
+        }
+
+        __m128i background = _mm_load_si128( reinterpret_cast<const __m128i *>(m_pBackground + i * g_BytesPerPixel) );
+
+        // Spread each pixel's alpha over its 4 channels
+        __m128i alpha = _mm_cvtsi32_si128( static_cast<int>(alpha4) );
+        alpha = _mm_unpacklo_epi8( alpha, alpha );
+        alpha = _mm_unpacklo_epi16( alpha, alpha );
+
+        __m128i alphaLow = _mm_unpacklo_epi8( alpha, zero );
+        __m128i alphaHigh = _mm_unpackhi_epi8( alpha, zero );
+
+        // fg * a + bg * (255 - a), then an exact rounded divide by 255
+        __m128i blendLow = _mm_add_epi16(
+            _mm_mullo_epi16( _mm_unpacklo_epi8( foreground, zero ), alphaLow ),
+            _mm_mullo_epi16( _mm_unpacklo_epi8( background, zero ), _mm_sub_epi16( opaque, alphaLow ) ) );
+        __m128i blendHigh = _mm_add_epi16(
+            _mm_mullo_epi16( _mm_unpackhi_epi8( foreground, zero ), alphaHigh ),
+            _mm_mullo_epi16( _mm_unpackhi_epi8( background, zero ), _mm_sub_epi16( opaque, alphaHigh ) ) );
+
+        blendLow = _mm_add_epi16( blendLow, half );
+        blendHigh = _mm_add_epi16( blendHigh, half );
+        blendLow = _mm_srli_epi16( _mm_add_epi16( blendLow, _mm_srli_epi16( blendLow, 8 ) ), 8 );
+        blendHigh = _mm_srli_epi16( _mm_add_epi16( blendHigh, _mm_srli_epi16( blendHigh, 8 ) ), 8 );
+
+        _mm_store_si128( pOut, _mm_packus_epi16( blendLow, blendHigh ) );
+    }
+
+    return m_pOutput;
+}
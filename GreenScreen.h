@@ -0,0 +1,84 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="GreenScreen.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Cuts players out of the color image and composites them over a background.
+// The player mask comes from the depth frame's player index, moved into color
+// space with a RegistrationMap, and can be feathered to soften its edges.
+
+#pragma once
+
+// Feathering applied unless changed, in color pixels
+#define GREEN_SCREEN_DEFAULT_FEATHER    2
+
+class GreenScreen
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    GreenScreen();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~GreenScreen();
+
+    /// <summary>
+    /// Allocate all buffers for color frames of the given size, with a default background
+    /// </summary>
+    /// <param name="width">width (in pixels) of color frames</param>
+    /// <param name="height">height (in pixels) of color frames</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Initialize( DWORD width, DWORD height );
+
+    /// <summary>
+    /// Replace the background with a bitmap file, stretched to the color frame size
+    /// </summary>
+    /// <param name="szFileName">.bmp file to load</param>
+    /// <returns>true if successful, false if the background was left unchanged</returns>
+    bool LoadBackground( LPCWSTR szFileName );
+
+    /// <summary>
+    /// Set how far (in color pixels) the mask edges are blurred, 0 for hard edges
+    /// </summary>
+    /// <param name="radius">blur radius, at most 127</param>
+    void SetFeatherRadius( UINT radius );
+
+    /// <summary>
+    /// Build the color space player mask from a depth frame
+    /// </summary>
+    /// <param name="pColorCoordinates">x, y color coordinates of each depth pixel, from RegistrationMap</param>
+    /// <param name="pLabels">player index of each depth pixel, from PlayerSegmentation</param>
+    /// <param name="depthWidth">width (in pixels) of the depth frame</param>
+    /// <param name="depthHeight">height (in pixels) of the depth frame</param>
+    void BuildMask( const LONG * pColorCoordinates, const BYTE * pLabels, DWORD depthWidth, DWORD depthHeight );
+
+    /// <summary>
+    /// Composite a color frame over the background through the current mask
+    /// </summary>
+    /// <param name="pColor">BGRX color frame</param>
+    /// <returns>composited BGRX frame, valid until the next call</returns>
+    const BYTE * Composite( const BYTE * pColor );
+
+private:
+    /// <summary>
+    /// Box blur the rows of the mask that can have foreground
+    /// </summary>
+    void FeatherMask( );
+
+    DWORD                    m_width;
+    DWORD                    m_height;
+    UINT                     m_featherRadius;
+
+    // Rows of the mask that have foreground, m_maskTop > m_maskBottom if none
+    LONG                     m_maskTop;
+    LONG                     m_maskBottom;
+
+    BYTE *                   m_pMask;
+    BYTE *                   m_pScratch;
+    BYTE *                   m_pBackground;
+    BYTE *                   m_pOutput;
+};
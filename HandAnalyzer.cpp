@@ -0,0 +1,548 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="HandAnalyzer.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "HandAnalyzer.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Moore neighborhood, clockwise from west with y down
+static const int g_NeighborX[8] = { -1, -1,  0,  1,  1,  1,  0, -1 };
+static const int g_NeighborY[8] = {  0, -1, -1, -1,  0,  1,  1,  1 };
+
+// Furthest (in pixels) from the projected hand joint to look for the hand
+static const int g_SeedRadius = 3;
+
+// Fewest pixels in a hand
+static const UINT g_MinHandArea = 16;
+
+// Outline index bits of a hull sort key
+static const UINT g_IndexMask = 0x7FF;
+
+// Mask values
+static const BYTE g_MaskBand = 1;
+static const BYTE g_MaskHand = 2;
+
+/// <summary>
+/// Compare sort keys for qsort
+/// </summary>
+static int __cdecl CompareKeys( const void * pLeft, const void * pRight )
+{
+    UINT left = *static_cast<const UINT *>(pLeft);
+    UINT right = *static_cast<const UINT *>(pRight);
+
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+HandAnalyzer::HandAnalyzer() :
+    m_cTargets(0),
+    m_cLast(0),
+    m_roiWidth(0),
+    m_roiHeight(0)
+{
+}
+
+/// <summary>
+/// Take the hands to look for from a skeleton frame
+/// </summary>
+/// <param name="frame">skeleton frame</param>
+void HandAnalyzer::SetSkeletons( const NUI_SKELETON_FRAME & frame )
+{
+    static const NUI_SKELETON_POSITION_INDEX hands[2] = { NUI_SKELETON_POSITION_HAND_LEFT, NUI_SKELETON_POSITION_HAND_RIGHT };
+    static const NUI_SKELETON_POSITION_INDEX wrists[2] = { NUI_SKELETON_POSITION_WRIST_LEFT, NUI_SKELETON_POSITION_WRIST_RIGHT };
+
+    m_cTargets = 0;
+
+    for ( int i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        const NUI_SKELETON_DATA & skeleton = frame.SkeletonData[i];
+        if ( NUI_SKELETON_TRACKED != skeleton.eTrackingState )
+        {
+            continue;
+        }
+
+        for ( int j = 0; j < 2 && m_cTargets < HAND_MAX_HANDS; ++j )
+        {
+            // An inferred hand is a guess at where the hand is, not where its pixels are
+            if ( NUI_SKELETON_POSITION_TRACKED != skeleton.eSkeletonPositionTrackingState[hands[j]] )
+            {
+                continue;
+            }
+
+            HAND_TARGET & target = m_targets[m_cTargets++];
+            target.dwTrackingID = skeleton.dwTrackingID;
+            target.joint = hands[j];
+            target.hand = skeleton.SkeletonPositions[hands[j]];
+
+            // Without a wrist nothing is cut off as forearm
+            target.wrist = NUI_SKELETON_POSITION_NOT_TRACKED != skeleton.eSkeletonPositionTrackingState[wrists[j]] ?
+                skeleton.SkeletonPositions[wrists[j]] : target.hand;
+        }
+    }
+}
+
+/// <summary>
+/// Analyze the hands taken from the last skeleton frame in a depth frame
+/// </summary>
+/// <param name="pDepth">packed depth pixels</param>
+/// <param name="resolution">resolution of the depth frame</param>
+/// <param name="pResults">receives a result for each hand found</param>
+/// <param name="cMaxResults">room in pResults</param>
+/// <returns>number of hands found</returns>
+UINT HandAnalyzer::Analyze( const USHORT * pDepth, NUI_IMAGE_RESOLUTION resolution, HAND_RESULT * pResults, UINT cMaxResults )
+{
+    DWORD width = 0, height = 0;
+    NuiImageResolutionToSize( resolution, width, height );
+    if ( 0 == width || 0 == height )
+    {
+        return 0;
+    }
+
+    // Same projection as NuiTransformSkeletonToDepthImage and back, at the resolution of the frame
+    float scale = NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width;
+
+    UINT cResults = 0;
+    for ( UINT i = 0; i < m_cTargets && cResults < cMaxResults; ++i )
+    {
+        const HAND_TARGET & target = m_targets[i];
+        if ( target.hand.z <= 0.0f || target.wrist.z <= 0.0f )
+        {
+            continue;
+        }
+
+        LONG handX = static_cast<LONG>(width / 2.0f + target.hand.x / (target.hand.z * scale) + 0.5f);
+        LONG handY = static_cast<LONG>(height / 2.0f - target.hand.y / (target.hand.z * scale) + 0.5f);
+        LONG wristX = static_cast<LONG>(width / 2.0f + target.wrist.x / (target.wrist.z * scale) + 0.5f);
+        LONG wristY = static_cast<LONG>(height / 2.0f - target.wrist.y / (target.wrist.z * scale) + 0.5f);
+        USHORT handDepth = static_cast<USHORT>(target.hand.z * 1000.0f + 0.5f);
+
+        HAND_RESULT & result = pResults[cResults];
+        if ( !AnalyzeHand( pDepth, width, height, handX, handY, handDepth, wristX, wristY, result ) )
+        {
+            continue;
+        }
+
+        result.dwTrackingID = target.dwTrackingID;
+        result.joint = target.joint;
+
+        // Fingertips come back in pixels and millimeters
+        for ( UINT j = 0; j < result.cFingertips; ++j )
+        {
+            Vector4 & tip = result.fingertips[j];
+            float z = tip.z / 1000.0f;
+
+            tip.x = (tip.x - width / 2.0f) * scale * z;
+            tip.y = -(tip.y - height / 2.0f) * scale * z;
+            tip.z = z;
+            tip.w = 1.0f;
+        }
+
+        // Only a change of what the hand is doing is news
+        result.bChanged = true;
+        for ( UINT j = 0; j < m_cLast; ++j )
+        {
+            if ( m_last[j].dwTrackingID == result.dwTrackingID && m_last[j].joint == result.joint )
+            {
+                result.bChanged = m_last[j].state != result.state || m_last[j].cFingertips != result.cFingertips;
+                break;
+            }
+        }
+
+        ++cResults;
+    }
+
+    m_cLast = min( cResults, HAND_MAX_HANDS );
+    memcpy( m_last, pResults, m_cLast * sizeof(HAND_RESULT) );
+
+    return cResults;
+}
+
+/// <summary>
+/// Analyze one hand at a known place in a depth frame
+/// </summary>
+/// <param name="pDepth">packed depth pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="handX">x (in pixels) of the hand joint</param>
+/// <param name="handY">y (in pixels) of the hand joint</param>
+/// <param name="handDepth">depth (in millimeters) of the hand joint</param>
+/// <param name="wristX">x (in pixels) of the wrist joint</param>
+/// <param name="wristY">y (in pixels) of the wrist joint</param>
+/// <param name="result">receives the state, fingertips in pixels and depth, area and solidity</param>
+/// <returns>true if a hand was found, false otherwise</returns>
+bool HandAnalyzer::AnalyzeHand( const USHORT * pDepth, UINT width, UINT height, LONG handX, LONG handY, USHORT handDepth,
+    LONG wristX, LONG wristY, HAND_RESULT & result )
+{
+    result.dwTrackingID = 0;
+    result.joint = NUI_SKELETON_POSITION_HAND_RIGHT;
+    result.state = HAND_STATE_UNKNOWN;
+    result.bChanged = false;
+    result.cFingertips = 0;
+    result.area = 0;
+    result.solidity = 0.0f;
+
+    if ( 0 == handDepth || handX < 0 || handY < 0 || handX >= static_cast<LONG>(width) || handY >= static_cast<LONG>(height) )
+    {
+        return false;
+    }
+
+    // Pixels a meter spans at the depth of the hand
+    float pixelsPerMeter = 1000.0f / (NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width * handDepth);
+
+    int radius = static_cast<int>(HAND_ROI_RADIUS * pixelsPerMeter + 0.5f);
+    radius = max( g_SeedRadius, min( radius, HAND_MAX_ROI_RADIUS ) );
+
+    int left = max( 0, static_cast<int>(handX) - radius );
+    int top = max( 0, static_cast<int>(handY) - radius );
+    int right = min( static_cast<int>(width) - 1, static_cast<int>(handX) + radius );
+    int bottom = min( static_cast<int>(height) - 1, static_cast<int>(handY) + radius );
+    m_roiWidth = right - left + 1;
+    m_roiHeight = bottom - top + 1;
+
+    // Pixels past the middle of the way from the hand to the wrist are forearm
+    float armX = static_cast<float>(wristX - handX);
+    float armY = static_cast<float>(wristY - handY);
+    float armCut = 0.5f * (armX * armX + armY * armY);
+
+    int nearest = static_cast<int>(handDepth) - HAND_DEPTH_BAND;
+    int farthest = static_cast<int>(handDepth) + HAND_DEPTH_BAND;
+
+    for ( int y = 0; y < m_roiHeight; ++y )
+    {
+        const USHORT * pRow = pDepth + (top + y) * width + left;
+        BYTE * pMask = m_mask + y * m_roiWidth;
+        float dy = static_cast<float>(top + y - handY);
+
+        for ( int x = 0; x < m_roiWidth; ++x )
+        {
+            int depth = pRow[x] >> NUI_IMAGE_PLAYER_INDEX_SHIFT;
+            float dx = static_cast<float>(left + x - handX);
+
+            pMask[x] = (0 != depth && depth >= nearest && depth <= farthest && dx * armX + dy * armY <= armCut) ? g_MaskBand : 0;
+        }
+    }
+
+    // The joint may fall in a gap between fingers, start from the nearest pixel of the band
+    int seed = -1;
+    int seedDistance = 2 * (g_SeedRadius + 1) * (g_SeedRadius + 1);
+    for ( int y = max( 0, handY - top - g_SeedRadius ); y <= min( m_roiHeight - 1, handY - top + g_SeedRadius ); ++y )
+    {
+        for ( int x = max( 0, handX - left - g_SeedRadius ); x <= min( m_roiWidth - 1, handX - left + g_SeedRadius ); ++x )
+        {
+            int dx = x - (handX - left);
+            int dy = y - (handY - top);
+            if ( g_MaskBand == m_mask[y * m_roiWidth + x] && dx * dx + dy * dy < seedDistance )
+            {
+                seed = y * m_roiWidth + x;
+                seedDistance = dx * dx + dy * dy;
+            }
+        }
+    }
+
+    if ( seed < 0 )
+    {
+        return false;
+    }
+
+    // The hand is what touches the seed; remember its first pixel in raster order to start the outline
+    UINT area = 0;
+    UINT first = seed;
+    UINT cStack = 0;
+    m_mask[seed] = g_MaskHand;
+    m_stack[cStack++] = seed;
+
+    while ( cStack > 0 )
+    {
+        UINT index = m_stack[--cStack];
+        int x = index % m_roiWidth;
+        int y = index / m_roiWidth;
+
+        ++area;
+        if ( index < first )
+        {
+            first = index;
+        }
+
+        for ( int i = 0; i < 8; ++i )
+        {
+            int nx = x + g_NeighborX[i];
+            int ny = y + g_NeighborY[i];
+            if ( nx < 0 || ny < 0 || nx >= m_roiWidth || ny >= m_roiHeight )
+            {
+                continue;
+            }
+
+            UINT neighbor = ny * m_roiWidth + nx;
+            if ( g_MaskBand == m_mask[neighbor] )
+            {
+                m_mask[neighbor] = g_MaskHand;
+                m_stack[cStack++] = neighbor;
+            }
+        }
+    }
+
+    if ( area < g_MinHandArea )
+    {
+        return false;
+    }
+
+    UINT cContour = TraceContour( first % m_roiWidth, first / m_roiWidth );
+    if ( cContour < 3 )
+    {
+        return false;
+    }
+
+    UINT cHull = FindHull( cContour );
+    if ( cHull < 3 )
+    {
+        return false;
+    }
+
+    // Areas of the outline and of its hull, by the shoelace formula, so both are measured alike
+    float contourArea = 0.0f;
+    for ( UINT i = 0, j = cContour - 1; i < cContour; j = i++ )
+    {
+        contourArea += static_cast<float>(m_contourX[j]) * m_contourY[i] - static_cast<float>(m_contourX[i]) * m_contourY[j];
+    }
+
+    float hullArea = 0.0f;
+    for ( UINT i = 0, j = cHull - 1; i < cHull; j = i++ )
+    {
+        UINT a = m_hull[j];
+        UINT b = m_hull[i];
+        hullArea += static_cast<float>(m_contourX[a]) * m_contourY[b] - static_cast<float>(m_contourX[b]) * m_contourY[a];
+    }
+
+    contourArea = fabsf( contourArea ) * 0.5f;
+    hullArea = fabsf( hullArea ) * 0.5f;
+
+    // Gaps between fingers are where the outline dips deep under the hull between two of its points
+    float minDefectDepth = HAND_MIN_DEFECT_DEPTH * pixelsPerMeter;
+    float minTipDistance = HAND_MIN_FINGERTIP_DISTANCE * pixelsPerMeter;
+    UINT cDefects = 0;
+
+    for ( UINT i = 0; i < cHull; ++i )
+    {
+        UINT start = m_hull[i];
+        UINT end = m_hull[(i + 1) % cHull];
+
+        float startX = m_contourX[start];
+        float startY = m_contourY[start];
+        float edgeX = m_contourX[end] - startX;
+        float edgeY = m_contourY[end] - startY;
+        float edgeLength = sqrtf( edgeX * edgeX + edgeY * edgeY );
+        if ( edgeLength < 1.0f )
+        {
+            continue;
+        }
+
+        float deepest = 0.0f;
+        UINT deepestPoint = start;
+        for ( UINT j = (start + 1) % cContour; j != end; j = (j + 1) % cContour )
+        {
+            float distance = fabsf( edgeX * (m_contourY[j] - startY) - edgeY * (m_contourX[j] - startX) ) / edgeLength;
+            if ( distance > deepest )
+            {
+                deepest = distance;
+                deepestPoint = j;
+            }
+        }
+
+        if ( deepest < minDefectDepth )
+        {
+            continue;
+        }
+
+        // A gap between fingers is narrower than a right angle, the dip between thumb and wrist isn't
+        float toStartX = startX - m_contourX[deepestPoint];
+        float toStartY = startY - m_contourY[deepestPoint];
+        float toEndX = m_contourX[end] - m_contourX[deepestPoint];
+        float toEndY = m_contourY[end] - m_contourY[deepestPoint];
+        if ( toStartX * toEndX + toStartY * toEndY <= 0.0f )
+        {
+            continue;
+        }
+
+        ++cDefects;
+
+        // Both sides of a gap are fingertips, unless they point back toward the wrist
+        UINT sides[2] = { start, end };
+        for ( int k = 0; k < 2; ++k )
+        {
+            float tipX = m_contourX[sides[k]];
+            float tipY = m_contourY[sides[k]];
+            float dx = left + tipX - handX;
+            float dy = top + tipY - handY;
+            if ( dx * armX + dy * armY > 0.0f )
+            {
+                continue;
+            }
+
+            bool bDuplicate = false;
+            for ( UINT t = 0; t < result.cFingertips && !bDuplicate; ++t )
+            {
+                float ex = result.fingertips[t].x - (left + tipX);
+                float ey = result.fingertips[t].y - (top + tipY);
+                bDuplicate = ex * ex + ey * ey < minTipDistance * minTipDistance;
+            }
+
+            if ( !bDuplicate && result.cFingertips < HAND_MAX_FINGERTIPS )
+            {
+                Vector4 & tip = result.fingertips[result.cFingertips++];
+                tip.x = left + tipX;
+                tip.y = top + tipY;
+                tip.z = static_cast<float>(pDepth[(top + m_contourY[sides[k]]) * width + left + m_contourX[sides[k]]] >> NUI_IMAGE_PLAYER_INDEX_SHIFT);
+                tip.w = 1.0f;
+            }
+        }
+    }
+
+    result.area = area;
+    result.solidity = hullArea > 0.0f ? contourArea / hullArea : 0.0f;
+
+    // Two gaps take three spread fingers; a fist has neither gaps nor dents
+    if ( cDefects >= 2 )
+    {
+        result.state = HAND_STATE_OPEN;
+    }
+    else if ( 0 == cDefects && result.solidity >= HAND_CLOSED_SOLIDITY )
+    {
+        result.state = HAND_STATE_CLOSED;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Trace the outline of the hand in the mask, clockwise
+/// </summary>
+/// <param name="startX">x of the first hand pixel in raster order</param>
+/// <param name="startY">y of the first hand pixel in raster order</param>
+/// <returns>number of outline points</returns>
+UINT HandAnalyzer::TraceContour( int startX, int startY )
+{
+    UINT cContour = 0;
+    int x = startX;
+    int y = startY;
+
+    // Nothing of the hand is west of its first pixel, so the search starts just past west
+    int from = 0;
+    int firstDirection = -1;
+
+    for ( ;; )
+    {
+        int direction = -1;
+        for ( int i = 1; i <= 8; ++i )
+        {
+            int d = (from + i) % 8;
+            int nx = x + g_NeighborX[d];
+            int ny = y + g_NeighborY[d];
+            if ( nx >= 0 && ny >= 0 && nx < m_roiWidth && ny < m_roiHeight && g_MaskHand == m_mask[ny * m_roiWidth + nx] )
+            {
+                direction = d;
+                break;
+            }
+        }
+
+        // Back at the start, about to take the first step again
+        if ( x == startX && y == startY && direction == firstDirection && cContour > 0 )
+        {
+            break;
+        }
+
+        if ( cContour >= HAND_MAX_CONTOUR )
+        {
+            return 0;
+        }
+
+        m_contourX[cContour] = static_cast<SHORT>(x);
+        m_contourY[cContour] = static_cast<SHORT>(y);
+        ++cContour;
+
+        // A lone pixel
+        if ( direction < 0 )
+        {
+            break;
+        }
+
+        if ( firstDirection < 0 )
+        {
+            firstDirection = direction;
+        }
+
+        x += g_NeighborX[direction];
+        y += g_NeighborY[direction];
+
+        // Pick up the search from the background pixel checked before the step, as seen from the new pixel
+        from = (direction + ((direction & 1) ? 5 : 6)) % 8;
+    }
+
+    return cContour;
+}
+
+/// <summary>
+/// Find the convex hull of the outline, in outline order
+/// </summary>
+/// <param name="cContour">number of outline points</param>
+/// <returns>number of hull points</returns>
+UINT HandAnalyzer::FindHull( UINT cContour )
+{
+    // Sort by x then y, with the outline index in the low bits; the ROI is under 256 pixels a side
+    for ( UINT i = 0; i < cContour; ++i )
+    {
+        m_sortKeys[i] = (static_cast<UINT>(m_contourX[i]) << 20) | (static_cast<UINT>(m_contourY[i]) << 11) | i;
+    }
+
+    qsort( m_sortKeys, cContour, sizeof(UINT), CompareKeys );
+
+    // Monotone chain, one half of the hull left to right and the other back
+    UINT cHull = 0;
+    for ( UINT i = 0; i < cContour; ++i )
+    {
+        UINT index = m_sortKeys[i] & g_IndexMask;
+        while ( cHull >= 2 && Turn( m_hull[cHull - 2], m_hull[cHull - 1], index ) <= 0 )
+        {
+            --cHull;
+        }
+
+        m_hull[cHull++] = index;
+    }
+
+    for ( UINT i = cContour - 1, lower = cHull + 1; i-- > 0; )
+    {
+        UINT index = m_sortKeys[i] & g_IndexMask;
+        while ( cHull >= lower && Turn( m_hull[cHull - 2], m_hull[cHull - 1], index ) <= 0 )
+        {
+            --cHull;
+        }
+
+        m_hull[cHull++] = index;
+    }
+
+    // The last point closes the hull on the first
+    --cHull;
+
+    // Along the outline the hull points come in the same turn as around the hull
+    qsort( m_hull, cHull, sizeof(UINT), CompareKeys );
+
+    return cHull;
+}
+
+/// <summary>
+/// Which way three outline points turn
+/// </summary>
+/// <param name="a">first outline index</param>
+/// <param name="b">second outline index</param>
+/// <param name="c">third outline index</param>
+/// <returns>positive for one way, negative for the other, 0 if they are in line</returns>
+int HandAnalyzer::Turn( UINT a, UINT b, UINT c ) const
+{
+    return (m_contourX[b] - m_contourX[a]) * (m_contourY[c] - m_contourY[a]) -
+        (m_contourY[b] - m_contourY[a]) * (m_contourX[c] - m_contourX[a]);
+}
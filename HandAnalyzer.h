@@ -0,0 +1,155 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="HandAnalyzer.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Finds whether each tracked hand is open or closed, and where its fingertips
+// are, from the depth around the hand joint.  Each hand joint is projected into
+// the depth frame and only a square about as large as a hand around it is
+// read.  Pixels within a band of the hand's depth, on the far side of the hand
+// from the wrist, and connected to the hand joint make up the hand.  Its
+// outline is traced and wrapped in a convex hull; the deep, narrow dents
+// between the hull and the outline are the gaps between spread fingers, and
+// the hull points on either side of them are fingertips.  A hand with no such
+// gaps that fills most of its hull is a fist.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Both hands of every skeleton with joints
+#define HAND_MAX_HANDS                  (NUI_SKELETON_MAX_TRACKED_COUNT * 2)
+#define HAND_MAX_FINGERTIPS             5
+
+// Half the side of the square read around a hand, in meters, and at most in pixels
+#define HAND_ROI_RADIUS                 0.13f
+#define HAND_MAX_ROI_RADIUS             96
+#define HAND_MAX_ROI_SIDE               (HAND_MAX_ROI_RADIUS * 2 + 1)
+
+// Longest outline traced, in pixels; at most 2048 to fit the hull sort keys
+#define HAND_MAX_CONTOUR                2048
+
+// Distance (in millimeters) in front of or behind the hand joint a pixel of the hand may be
+#define HAND_DEPTH_BAND                 80
+
+// Shallowest gap between two fingers, and closest two fingertips, in meters
+#define HAND_MIN_DEFECT_DEPTH           0.025f
+#define HAND_MIN_FINGERTIP_DISTANCE     0.015f
+
+// Share of its hull a closed hand fills, at least
+#define HAND_CLOSED_SOLIDITY            0.85f
+
+enum HAND_STATE
+{
+    HAND_STATE_UNKNOWN = 0,
+    HAND_STATE_OPEN,
+    HAND_STATE_CLOSED
+};
+
+// What was found for one hand
+struct HAND_RESULT
+{
+    DWORD                       dwTrackingID;
+    NUI_SKELETON_POSITION_INDEX joint;              // NUI_SKELETON_POSITION_HAND_LEFT or _RIGHT
+    HAND_STATE                  state;
+    bool                        bChanged;           // state or fingertip count differs from the last frame
+    UINT                        cFingertips;
+    Vector4                     fingertips[HAND_MAX_FINGERTIPS];    // skeleton space
+    UINT                        area;               // pixels of the hand
+    float                       solidity;           // share of its hull the hand fills
+};
+
+class HandAnalyzer
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    HandAnalyzer();
+
+    /// <summary>
+    /// Take the hands to look for from a skeleton frame
+    /// </summary>
+    /// <param name="frame">skeleton frame</param>
+    void SetSkeletons( const NUI_SKELETON_FRAME & frame );
+
+    /// <summary>
+    /// Analyze the hands taken from the last skeleton frame in a depth frame
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels</param>
+    /// <param name="resolution">resolution of the depth frame</param>
+    /// <param name="pResults">receives a result for each hand found</param>
+    /// <param name="cMaxResults">room in pResults</param>
+    /// <returns>number of hands found</returns>
+    UINT Analyze( const USHORT * pDepth, NUI_IMAGE_RESOLUTION resolution, HAND_RESULT * pResults, UINT cMaxResults );
+
+    /// <summary>
+    /// Analyze one hand at a known place in a depth frame
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="handX">x (in pixels) of the hand joint</param>
+    /// <param name="handY">y (in pixels) of the hand joint</param>
+    /// <param name="handDepth">depth (in millimeters) of the hand joint</param>
+    /// <param name="wristX">x (in pixels) of the wrist joint</param>
+    /// <param name="wristY">y (in pixels) of the wrist joint</param>
+    /// <param name="result">receives the state, fingertips in pixels and depth, area and solidity</param>
+    /// <returns>true if a hand was found, false otherwise</returns>
+    bool AnalyzeHand( const USHORT * pDepth, UINT width, UINT height, LONG handX, LONG handY, USHORT handDepth,
+        LONG wristX, LONG wristY, HAND_RESULT & result );
+
+private:
+    // A hand joint of the last skeleton frame
+    struct HAND_TARGET
+    {
+        DWORD                       dwTrackingID;
+        NUI_SKELETON_POSITION_INDEX joint;
+        Vector4                     hand;
+        Vector4                     wrist;
+    };
+
+    /// <summary>
+    /// Trace the outline of the hand in the mask, clockwise
+    /// </summary>
+    /// <param name="startX">x of the first hand pixel in raster order</param>
+    /// <param name="startY">y of the first hand pixel in raster order</param>
+    /// <returns>number of outline points</returns>
+    UINT TraceContour( int startX, int startY );
+
+    /// <summary>
+    /// Find the convex hull of the outline, in outline order
+    /// </summary>
+    /// <param name="cContour">number of outline points</param>
+    /// <returns>number of hull points</returns>
+    UINT FindHull( UINT cContour );
+
+    /// <summary>
+    /// Which way three outline points turn
+    /// </summary>
+    /// <param name="a">first outline index</param>
+    /// <param name="b">second outline index</param>
+    /// <param name="c">third outline index</param>
+    /// <returns>positive for one way, negative for the other, 0 if they are in line</returns>
+    int Turn( UINT a, UINT b, UINT c ) const;
+
+    HAND_TARGET             m_targets[HAND_MAX_HANDS];
+    UINT                    m_cTargets;
+
+    // Last state of each hand, to report changes
+    HAND_RESULT             m_last[HAND_MAX_HANDS];
+    UINT                    m_cLast;
+
+    // Working buffers of a single hand, ROI sized
+    BYTE                    m_mask[HAND_MAX_ROI_SIDE * HAND_MAX_ROI_SIDE];
+    UINT                    m_stack[HAND_MAX_ROI_SIDE * HAND_MAX_ROI_SIDE];
+    int                     m_roiWidth;
+    int                     m_roiHeight;
+
+    // Outline points, and the hull as indices into them
+    SHORT                   m_contourX[HAND_MAX_CONTOUR];
+    SHORT                   m_contourY[HAND_MAX_CONTOUR];
+    UINT                    m_hull[HAND_MAX_CONTOUR + 1];
+    UINT                    m_sortKeys[HAND_MAX_CONTOUR];
+};
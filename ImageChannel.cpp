@@ -0,0 +1,218 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ImageChannel.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "ImageChannel.h"
+
+/// <summary>
+/// Size of one pixel of a shared frame format
+/// </summary>
+/// <param name="format">one of the IMAGE_CHANNEL_FORMAT_ values</param>
+/// <returns>size (in bytes) of one pixel, 0 if the format is unknown</returns>
+static DWORD GetBytesPerPixel( DWORD format )
+{
+    switch ( format )
+    {
+    case IMAGE_CHANNEL_FORMAT_DEPTH16:
+    case IMAGE_CHANNEL_FORMAT_INFRARED16:
+        return sizeof(USHORT);
+
+    case IMAGE_CHANNEL_FORMAT_BGRX32:
+        return 4;
+
+    case IMAGE_CHANNEL_FORMAT_PLAYER_MASKS:
+        return 1;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Check that a frame header describes pixels a reader can trust
+/// </summary>
+/// <param name="header">header, copied out of the slot</param>
+/// <param name="cbSlot">size (in bytes) of the slot</param>
+/// <returns>true if the format is known, a row holds the width, and the rows fit in the slot, false otherwise</returns>
+static bool IsFrameHeaderValid( const IMAGE_CHANNEL_FRAME & header, DWORD cbSlot )
+{
+    DWORD bytesPerPixel = GetBytesPerPixel( header.dwFormat );
+
+    // Divided rather than multiplied, so a corrupt header can't overflow
+    return 0 != bytesPerPixel && 0 != header.dwWidth && 0 != header.dwHeight &&
+           header.dwStride / bytesPerPixel >= header.dwWidth &&
+           header.dwHeight <= (cbSlot - sizeof(IMAGE_CHANNEL_FRAME)) / header.dwStride;
+}
+
+/// <summary>
+/// Create the named channel
+/// </summary>
+/// <param name="szName">name of the channel</param>
+/// <param name="cbMaxFrame">size (in bytes) of the largest frame that will be published</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT ImageChannelWriter::Create( LPCWSTR szName, DWORD cbMaxFrame )
+{
+    return m_ring.Create( szName, sizeof(IMAGE_CHANNEL_FRAME) + cbMaxFrame, IMAGE_CHANNEL_SLOTS );
+}
+
+/// <summary>
+/// Copy a frame into the next slot and publish it
+/// </summary>
+/// <param name="pBits">first row of the image</param>
+/// <param name="width">width (in pixels) of the image</param>
+/// <param name="height">height (in pixels) of the image</param>
+/// <param name="sourcePitch">length (in bytes) between the starts of two rows in pBits</param>
+/// <param name="bytesPerPixel">size (in bytes) of one pixel</param>
+/// <param name="format">one of the IMAGE_CHANNEL_FORMAT_ values</param>
+/// <param name="frameNumber">sensor frame number</param>
+/// <param name="timeStamp">sensor timestamp</param>
+/// <returns>true if published, false if the frame doesn't fit the channel</returns>
+bool ImageChannelWriter::Publish( const BYTE * pBits, DWORD width, DWORD height, DWORD sourcePitch, DWORD bytesPerPixel, DWORD format, DWORD frameNumber, LONGLONG timeStamp )
+{
+    DWORD stride = width * bytesPerPixel;
+    if ( sizeof(IMAGE_CHANNEL_FRAME) + stride * height > m_ring.GetSlotSize() )
+    {
+        return false;
+    }
+
+    BYTE * pSlot = m_ring.BeginWrite( );
+    if ( NULL == pSlot )
+    {
+        return false;
+    }
+
+    IMAGE_CHANNEL_FRAME * pFrame = reinterpret_cast<IMAGE_CHANNEL_FRAME *>(pSlot);
+    pFrame->liTimeStamp = timeStamp;
+    pFrame->dwFrameNumber = frameNumber;
+    pFrame->dwWidth = width;
+    pFrame->dwHeight = height;
+    pFrame->dwStride = stride;
+    pFrame->dwFormat = format;
+
+    BYTE * pPixels = pSlot + sizeof(IMAGE_CHANNEL_FRAME);
+    if ( sourcePitch == stride )
+    {
+        CopyMemory( pPixels, pBits, stride * height );
+    }
+    else
+    {
+        for ( DWORD y = 0; y < height; ++y )
+        {
+            CopyMemory( pPixels + y * stride, pBits + y * sourcePitch, stride );
+        }
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter( &now );
+    pFrame->liPublishTime = now.QuadPart;
+
+    m_ring.EndWrite( );
+
+    return true;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+ImageChannelReader::ImageChannelReader() :
+    m_bReading(false),
+    m_readIndex(0),
+    m_lastCount(0),
+    m_droppedFrames(0)
+{
+}
+
+/// <summary>
+/// Map the named channel read-only
+/// </summary>
+/// <param name="szName">name of the channel</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT ImageChannelReader::Open( LPCWSTR szName )
+{
+    HRESULT hr = m_ring.Open( szName );
+    if ( SUCCEEDED(hr) && m_ring.GetSlotSize() < sizeof(IMAGE_CHANNEL_FRAME) )
+    {
+        m_ring.Close( );
+        hr = E_FAIL;
+    }
+
+    // Frames published before we showed up don't count as dropped
+    m_bReading = false;
+    m_lastCount = m_ring.GetWriteCount();
+    m_droppedFrames = 0;
+
+    return hr;
+}
+
+/// <summary>
+/// Get the newest frame in place, without copying.  The frame must be
+/// checked with EndRead before any of it is trusted
+/// </summary>
+/// <returns>newest frame, NULL if there is no new frame</returns>
+const IMAGE_CHANNEL_FRAME * ImageChannelReader::BeginRead( )
+{
+    // Always jump to the newest frame; the writer doesn't wait for us
+    DWORD count = m_ring.GetWriteCount();
+    if ( count == m_lastCount )
+    {
+        return NULL;
+    }
+
+    const BYTE * pSlot = m_ring.Peek( count - 1 );
+    if ( NULL == pSlot )
+    {
+        return NULL;
+    }
+
+    m_bReading = true;
+    m_readIndex = count - 1;
+
+    return reinterpret_cast<const IMAGE_CHANNEL_FRAME *>(pSlot);
+}
+
+/// <summary>
+/// Finish reading the frame returned by BeginRead
+/// </summary>
+/// <returns>true if the frame wasn't overwritten while it was read and its header describes pixels within the slot, false otherwise</returns>
+bool ImageChannelReader::EndRead( )
+{
+    if ( !m_bReading )
+    {
+        return false;
+    }
+
+    DWORD index = m_readIndex;
+    m_bReading = false;
+
+    // Copied before the sequence is checked, so a frame that validates was read with this header
+    IMAGE_CHANNEL_FRAME header;
+    const BYTE * pSlot = m_ring.Peek( index );
+    if ( NULL != pSlot )
+    {
+        CopyMemory( &header, pSlot, sizeof(header) );
+    }
+
+    if ( NULL == pSlot || !m_ring.Validate( index ) || !IsFrameHeaderValid( header, m_ring.GetSlotSize( ) ) )
+    {
+        // Skipped frames plus the one that was torn or malformed
+        m_droppedFrames += index + 1 - m_lastCount;
+        m_lastCount = index + 1;
+        return false;
+    }
+
+    m_droppedFrames += index - m_lastCount;
+    m_lastCount = index + 1;
+
+    return true;
+}
+
+/// <summary>
+/// Number of frames that were published but never successfully read
+/// </summary>
+/// <returns>dropped frame count</returns>
+DWORD ImageChannelReader::GetDroppedFrames( ) const
+{
+    return m_droppedFrames;
+}
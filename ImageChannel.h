@@ -0,0 +1,114 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ImageChannel.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Shares depth and color frames with other processes through a shared memory
+// ring.  The capture thread never waits on readers; a reader that falls behind
+// finds its slot overwritten and skips ahead to the newest frame.
+
+#pragma once
+
+#include "SharedMemoryRing.h"
+
+#define IMAGE_CHANNEL_DEPTH_NAME        L"Local\\SkeletalViewerDepth"
+#define IMAGE_CHANNEL_COLOR_NAME        L"Local\\SkeletalViewerColor"
+#define IMAGE_CHANNEL_DEPTH_RGBX_NAME   L"Local\\SkeletalViewerDepthRGBX"
+#define IMAGE_CHANNEL_PLAYER_MASKS_NAME L"Local\\SkeletalViewerPlayerMasks"
+#define IMAGE_CHANNEL_SLOTS             4
+
+// Pixel formats of shared frames
+enum _IMAGE_CHANNEL_FORMAT
+{
+    IMAGE_CHANNEL_FORMAT_DEPTH16 = 0,   // packed depth and player index, 16 bits per pixel
+    IMAGE_CHANNEL_FORMAT_BGRX32,        // 8 bits each of blue, green, red and unused
+    IMAGE_CHANNEL_FORMAT_PLAYER_MASKS,  // PLAYER_MASK_HEADER and its runs, dwWidth bytes in one row
+    IMAGE_CHANNEL_FORMAT_INFRARED16,    // infrared intensity in the top 10 of 16 bits, on the color channel
+};
+
+// Start of each slot, followed by the pixels
+struct IMAGE_CHANNEL_FRAME
+{
+    LONGLONG    liTimeStamp;        // sensor timestamp of the frame
+    LONGLONG    liPublishTime;      // QueryPerformanceCounter when published
+    DWORD       dwFrameNumber;
+    DWORD       dwWidth;
+    DWORD       dwHeight;
+    DWORD       dwStride;           // bytes per row
+    DWORD       dwFormat;           // one of the IMAGE_CHANNEL_FORMAT_ values
+    DWORD       dwReserved[3];      // keeps the pixels 16 byte aligned
+};
+
+class ImageChannelWriter
+{
+public:
+    /// <summary>
+    /// Create the named channel
+    /// </summary>
+    /// <param name="szName">name of the channel</param>
+    /// <param name="cbMaxFrame">size (in bytes) of the largest frame that will be published</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Create( LPCWSTR szName, DWORD cbMaxFrame );
+
+    /// <summary>
+    /// Copy a frame into the next slot and publish it
+    /// </summary>
+    /// <param name="pBits">first row of the image</param>
+    /// <param name="width">width (in pixels) of the image</param>
+    /// <param name="height">height (in pixels) of the image</param>
+    /// <param name="sourcePitch">length (in bytes) between the starts of two rows in pBits</param>
+    /// <param name="bytesPerPixel">size (in bytes) of one pixel</param>
+    /// <param name="format">one of the IMAGE_CHANNEL_FORMAT_ values</param>
+    /// <param name="frameNumber">sensor frame number</param>
+    /// <param name="timeStamp">sensor timestamp</param>
+    /// <returns>true if published, false if the frame doesn't fit the channel</returns>
+    bool Publish( const BYTE * pBits, DWORD width, DWORD height, DWORD sourcePitch, DWORD bytesPerPixel, DWORD format, DWORD frameNumber, LONGLONG timeStamp );
+
+private:
+    SharedMemoryRing         m_ring;
+};
+
+class ImageChannelReader
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    ImageChannelReader();
+
+    /// <summary>
+    /// Map the named channel read-only
+    /// </summary>
+    /// <param name="szName">name of the channel</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Open( LPCWSTR szName );
+
+    /// <summary>
+    /// Get the newest frame in place, without copying.  The frame must be
+    /// checked with EndRead before any of it is trusted
+    /// </summary>
+    /// <returns>newest frame, NULL if there is no new frame</returns>
+    const IMAGE_CHANNEL_FRAME * BeginRead( );
+
+    /// <summary>
+    /// Finish reading the frame returned by BeginRead
+    /// </summary>
+    /// <returns>true if the frame wasn't overwritten while it was read and its header describes pixels within the slot, false otherwise</returns>
+    bool EndRead( );
+
+    /// <summary>
+    /// Number of frames that were published but never successfully read
+    /// </summary>
+    /// <returns>dropped frame count</returns>
+    DWORD GetDroppedFrames( ) const;
+
+private:
+    SharedMemoryRing         m_ring;
+    bool                     m_bReading;
+    DWORD                    m_readIndex;
+
+    // Write count when the last frame was read or dropped; frames below it are done with
+    DWORD                    m_lastCount;
+    DWORD                    m_droppedFrames;
+};
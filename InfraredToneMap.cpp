@@ -0,0 +1,124 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="InfraredToneMap.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "InfraredToneMap.h"
+#include <math.h>
+#include <emmintrin.h>
+
+/// <summary>
+/// Constructor
+/// </summary>
+InfraredToneMap::InfraredToneMap() :
+    m_resolution(NUI_IMAGE_RESOLUTION_INVALID),
+    m_width(0),
+    m_height(0),
+    m_pOutput(NULL)
+{
+    SetCurve( INFRARED_DEFAULT_BLACK, INFRARED_DEFAULT_WHITE, INFRARED_DEFAULT_GAMMA );
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+InfraredToneMap::~InfraredToneMap()
+{
+    _aligned_free( m_pOutput );
+}
+
+/// <summary>
+/// Allocate the output for frames of the given resolution, keeping it if nothing changed
+/// </summary>
+/// <param name="resolution">resolution of infrared frames</param>
+/// <returns>true if successful, false otherwise</returns>
+bool InfraredToneMap::Initialize( NUI_IMAGE_RESOLUTION resolution )
+{
+    if ( resolution == m_resolution )
+    {
+        return true;
+    }
+
+    DWORD width, height;
+    NuiImageResolutionToSize( resolution, width, height );
+
+    // Frames are converted 8 pixels at a time
+    if ( 0 == width || 0 == height || 0 != width % 8 )
+    {
+        return false;
+    }
+
+    _aligned_free( m_pOutput );
+    m_resolution = NUI_IMAGE_RESOLUTION_INVALID;
+
+    m_pOutput = static_cast<BYTE *>(_aligned_malloc( width * height * 4, 16 ));
+    if ( NULL == m_pOutput )
+    {
+        return false;
+    }
+
+    m_resolution = resolution;
+    m_width = width;
+    m_height = height;
+
+    return true;
+}
+
+/// <summary>
+/// Rebuild the tone curve
+/// </summary>
+/// <param name="black">samples at or below this are black</param>
+/// <param name="white">samples at or above this are white</param>
+/// <param name="gamma">exponent applied between black and white, below 1 to brighten</param>
+void InfraredToneMap::SetCurve( USHORT black, USHORT white, float gamma )
+{
+    float range = static_cast<float>(max( white - black, 1 ));
+
+    for ( UINT entry = 0; entry < INFRARED_TONE_MAP_ENTRIES; ++entry )
+    {
+        int sample = static_cast<int>(entry << INFRARED_TONE_MAP_SHIFT);
+        float level = min( max( (sample - black) / range, 0.0f ), 1.0f );
+        BYTE gray = static_cast<BYTE>(255.0f * powf( level, gamma ) + 0.5f);
+
+        m_gray[entry] = static_cast<USHORT>(gray * 0x0101);
+    }
+}
+
+/// <summary>
+/// Convert an infrared frame for display
+/// </summary>
+/// <param name="pInfrared">16-bit infrared samples of the frame</param>
+/// <param name="pitch">length (in bytes) between the starts of two rows in pInfrared</param>
+/// <returns>BGRX gray frame, valid until the next call</returns>
+const BYTE * InfraredToneMap::Convert( const USHORT * pInfrared, UINT pitch )
+{
+    __m128i * pOut = reinterpret_cast<__m128i *>(m_pOutput);
+
+    for ( UINT y = 0; y < m_height; ++y )
+    {
+        const USHORT * pRow = reinterpret_cast<const USHORT *>(reinterpret_cast<const BYTE *>(pInfrared) + y * pitch);
+
+        for ( UINT x = 0; x < m_width; x += 8 )
+        {
+            __m128i index = _mm_srli_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i *>(pRow + x) ), INFRARED_TONE_MAP_SHIFT );
+
+            // SSE2 has no gather, the table is small enough that eight lookups stay in L1
+            __m128i gray = _mm_cvtsi32_si128( m_gray[_mm_extract_epi16( index, 0 )] );
+            gray = _mm_insert_epi16( gray, m_gray[_mm_extract_epi16( index, 1 )], 1 );
+            gray = _mm_insert_epi16( gray, m_gray[_mm_extract_epi16( index, 2 )], 2 );
+            gray = _mm_insert_epi16( gray, m_gray[_mm_extract_epi16( index, 3 )], 3 );
+            gray = _mm_insert_epi16( gray, m_gray[_mm_extract_epi16( index, 4 )], 4 );
+            gray = _mm_insert_epi16( gray, m_gray[_mm_extract_epi16( index, 5 )], 5 );
+            gray = _mm_insert_epi16( gray, m_gray[_mm_extract_epi16( index, 6 )], 6 );
+            gray = _mm_insert_epi16( gray, m_gray[_mm_extract_epi16( index, 7 )], 7 );
+
+            // Each gray is already in two bytes, doubling it again fills B, G, R and X
+            _mm_store_si128( pOut++, _mm_unpacklo_epi16( gray, gray ) );
+            _mm_store_si128( pOut++, _mm_unpackhi_epi16( gray, gray ) );
+        }
+    }
+
+    return m_pOutput;
+}
@@ -0,0 +1,77 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="InfraredToneMap.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Turns 16-bit infrared frames into BGRX gray for display.  Only the top 10
+// bits of each sample carry data, so a 1024 entry table holds the whole
+// contrast and gamma curve, and eight pixels at a time are shifted, looked up
+// and spread out to BGRX with SSE2.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Samples are looked up by their top bits
+#define INFRARED_TONE_MAP_SHIFT         6
+#define INFRARED_TONE_MAP_ENTRIES       (1 << (16 - INFRARED_TONE_MAP_SHIFT))
+
+// Default curve: infrared falls off quickly with distance, so most of the
+// scene is in the bottom quarter of the range and is lifted by the gamma
+#define INFRARED_DEFAULT_BLACK          0x0100
+#define INFRARED_DEFAULT_WHITE          0x4000
+#define INFRARED_DEFAULT_GAMMA          0.5f
+
+class InfraredToneMap
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    InfraredToneMap();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~InfraredToneMap();
+
+    /// <summary>
+    /// Allocate the output for frames of the given resolution, keeping it if nothing changed
+    /// </summary>
+    /// <param name="resolution">resolution of infrared frames</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Initialize( NUI_IMAGE_RESOLUTION resolution );
+
+    /// <summary>
+    /// Rebuild the tone curve
+    /// </summary>
+    /// <param name="black">samples at or below this are black</param>
+    /// <param name="white">samples at or above this are white</param>
+    /// <param name="gamma">exponent applied between black and white, below 1 to brighten</param>
+    void SetCurve( USHORT black, USHORT white, float gamma );
+
+    /// <summary>
+    /// Convert an infrared frame for display
+    /// </summary>
+    /// <param name="pInfrared">16-bit infrared samples of the frame</param>
+    /// <param name="pitch">length (in bytes) between the starts of two rows in pInfrared</param>
+    /// <returns>BGRX gray frame, valid until the next call</returns>
+    const BYTE * Convert( const USHORT * pInfrared, UINT pitch );
+
+    /// <summary>
+    /// Size (in bytes) of the converted frame
+    /// </summary>
+    /// <returns>width * height * 4 of the current resolution</returns>
+    ULONG GetOutputSize( ) const { return m_width * m_height * 4; }
+
+private:
+    NUI_IMAGE_RESOLUTION    m_resolution;
+    UINT                    m_width;
+    UINT                    m_height;
+
+    // Gray of each sample, in both bytes so it spreads to BGRX with two unpacks
+    USHORT                  m_gray[INFRARED_TONE_MAP_ENTRIES];
+
+    BYTE *                  m_pOutput;
+};
@@ -0,0 +1,300 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="JointPredictor.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "JointPredictor.h"
+#include <math.h>
+#include <emmintrin.h>
+
+/// <summary>
+/// Scale four vectors down to a length limit
+/// </summary>
+/// <param name="x">x of each vector, scaled in place</param>
+/// <param name="y">y of each vector, scaled in place</param>
+/// <param name="z">z of each vector, scaled in place</param>
+/// <param name="limit">longest length allowed</param>
+static inline void ClampLength( __m128 & x, __m128 & y, __m128 & z, __m128 limit )
+{
+    __m128 lengthSquared = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_mul_ps( z, z ) );
+    __m128 length = _mm_sqrt_ps( _mm_max_ps( lengthSquared, _mm_set1_ps( 1e-12f ) ) );
+    __m128 scale = _mm_min_ps( _mm_set1_ps( 1.0f ), _mm_div_ps( limit, length ) );
+
+    x = _mm_mul_ps( x, scale );
+    y = _mm_mul_ps( y, scale );
+    z = _mm_mul_ps( z, scale );
+}
+
+/// <summary>
+/// Weights that fit a least squares polynomial through the newest frames
+/// </summary>
+/// <param name="count">frames to fit through, 1 to JOINT_PREDICTOR_HISTORY</param>
+/// <param name="weights">receives the weight of each frame, newest first, in the constant, linear and square terms</param>
+static void FitWeights( UINT count, float weights[3][JOINT_PREDICTOR_HISTORY] )
+{
+    // A parabola needs 3 frames, a line 2
+    const UINT terms = min( count, 3 );
+
+    // Frame i is at time -i, in frames; the normal equations are the sums of the powers of time
+    double normal[3][6] = { 0 };
+    for ( UINT row = 0; row < terms; ++row )
+    {
+        for ( UINT column = 0; column < terms; ++column )
+        {
+            for ( UINT i = 0; i < count; ++i )
+            {
+                normal[row][column] += pow( -static_cast<double>(i), static_cast<int>(row + column) );
+            }
+        }
+        normal[row][terms + row] = 1.0;
+    }
+
+    // Invert them by Gauss-Jordan elimination; they are positive definite, so no pivoting
+    for ( UINT pivot = 0; pivot < terms; ++pivot )
+    {
+        double scale = 1.0 / normal[pivot][pivot];
+        for ( UINT column = 0; column < 2 * terms; ++column )
+        {
+            normal[pivot][column] *= scale;
+        }
+
+        for ( UINT row = 0; row < terms; ++row )
+        {
+            if ( row != pivot )
+            {
+                double factor = normal[row][pivot];
+                for ( UINT column = 0; column < 2 * terms; ++column )
+                {
+                    normal[row][column] -= factor * normal[pivot][column];
+                }
+            }
+        }
+    }
+
+    ZeroMemory( weights, 3 * JOINT_PREDICTOR_HISTORY * sizeof(float) );
+    for ( UINT term = 0; term < terms; ++term )
+    {
+        for ( UINT i = 0; i < count; ++i )
+        {
+            double weight = 0.0;
+            for ( UINT power = 0; power < terms; ++power )
+            {
+                weight += normal[term][terms + power] * pow( -static_cast<double>(i), static_cast<int>(power) );
+            }
+            weights[term][i] = static_cast<float>(weight);
+        }
+    }
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+JointPredictor::JointPredictor() :
+    m_horizon(JOINT_PREDICTOR_DEFAULT_HORIZON),
+    m_newest(0),
+    m_cErrorJoints(0),
+    m_errorSum(0.0),
+    m_lagSum(0.0),
+    m_maxError(0.0f)
+{
+    ZeroMemory( m_historyX, sizeof(m_historyX) );
+    ZeroMemory( m_historyY, sizeof(m_historyY) );
+    ZeroMemory( m_historyZ, sizeof(m_historyZ) );
+    ZeroMemory( m_nextX, sizeof(m_nextX) );
+    ZeroMemory( m_nextY, sizeof(m_nextY) );
+    ZeroMemory( m_nextZ, sizeof(m_nextZ) );
+    ZeroMemory( m_nextTrackingID, sizeof(m_nextTrackingID) );
+
+    // Lanes with no skeleton fit through no frames, and all their weights are 0
+    ZeroMemory( m_fitWeights[0], sizeof(m_fitWeights[0]) );
+    for ( UINT count = 1; count <= JOINT_PREDICTOR_HISTORY; ++count )
+    {
+        FitWeights( count, m_fitWeights[count] );
+    }
+}
+
+/// <summary>
+/// Set how far ahead to predict
+/// </summary>
+/// <param name="milliseconds">horizon, up to JOINT_PREDICTOR_MAX_HORIZON</param>
+void JointPredictor::SetHorizon( UINT milliseconds )
+{
+    m_horizon = min( milliseconds, JOINT_PREDICTOR_MAX_HORIZON );
+}
+
+/// <summary>
+/// Extrapolate every joint of four lanes
+/// </summary>
+/// <param name="kinematics">kinematics of the frame</param>
+/// <param name="lane">first of the four lanes</param>
+/// <param name="ahead">frames ahead</param>
+/// <param name="pX">receives the x of each joint, [joint][lane]</param>
+/// <param name="pY">receives the y of each joint, [joint][lane]</param>
+/// <param name="pZ">receives the z of each joint, [joint][lane]</param>
+void JointPredictor::Extrapolate( const SKELETON_KINEMATICS_FRAME & kinematics, UINT lane, float ahead,
+    float (*pX)[SKELETON_KINEMATICS_LANES], float (*pY)[SKELETON_KINEMATICS_LANES], float (*pZ)[SKELETON_KINEMATICS_LANES] )
+{
+    // Each lane fits through as many frames as its skeleton has been followed for
+    UINT count[4];
+    for ( UINT i = 0; i < 4; ++i )
+    {
+        count[i] = min( kinematics.cFrames[lane + i], JOINT_PREDICTOR_HISTORY );
+    }
+
+    __m128 weights[3][JOINT_PREDICTOR_HISTORY];
+    const float (*pHistoryX[JOINT_PREDICTOR_HISTORY])[SKELETON_KINEMATICS_LANES];
+    const float (*pHistoryY[JOINT_PREDICTOR_HISTORY])[SKELETON_KINEMATICS_LANES];
+    const float (*pHistoryZ[JOINT_PREDICTOR_HISTORY])[SKELETON_KINEMATICS_LANES];
+    for ( UINT i = 0; i < JOINT_PREDICTOR_HISTORY; ++i )
+    {
+        for ( UINT term = 0; term < 3; ++term )
+        {
+            weights[term][i] = _mm_setr_ps( m_fitWeights[count[0]][term][i], m_fitWeights[count[1]][term][i],
+                                            m_fitWeights[count[2]][term][i], m_fitWeights[count[3]][term][i] );
+        }
+
+        UINT frame = (m_newest + JOINT_PREDICTOR_HISTORY - i) % JOINT_PREDICTOR_HISTORY;
+        pHistoryX[i] = m_historyX[frame];
+        pHistoryY[i] = m_historyY[frame];
+        pHistoryZ[i] = m_historyZ[frame];
+    }
+
+    // The limits, per frame rather than per second
+    const float frameTime = kinematics.deltaTime;
+    const __m128 maxSlope = _mm_set1_ps( JOINT_PREDICTOR_MAX_SPEED * frameTime );
+    const __m128 maxCurvature = _mm_set1_ps( 0.5f * JOINT_PREDICTOR_MAX_ACCELERATION * frameTime * frameTime );
+    const __m128 maxOffset = _mm_set1_ps( JOINT_PREDICTOR_MAX_OFFSET );
+    const __m128 time = _mm_set1_ps( ahead );
+    const __m128 timeSquared = _mm_set1_ps( ahead * ahead );
+
+    for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+    {
+        __m128 fit[3][3];
+        for ( UINT term = 0; term < 3; ++term )
+        {
+            fit[term][0] = fit[term][1] = fit[term][2] = _mm_setzero_ps( );
+            for ( UINT i = 0; i < JOINT_PREDICTOR_HISTORY; ++i )
+            {
+                fit[term][0] = _mm_add_ps( fit[term][0], _mm_mul_ps( weights[term][i], _mm_loadu_ps( pHistoryX[i][joint] + lane ) ) );
+                fit[term][1] = _mm_add_ps( fit[term][1], _mm_mul_ps( weights[term][i], _mm_loadu_ps( pHistoryY[i][joint] + lane ) ) );
+                fit[term][2] = _mm_add_ps( fit[term][2], _mm_mul_ps( weights[term][i], _mm_loadu_ps( pHistoryZ[i][joint] + lane ) ) );
+            }
+        }
+
+        ClampLength( fit[1][0], fit[1][1], fit[1][2], maxSlope );
+        ClampLength( fit[2][0], fit[2][1], fit[2][2], maxCurvature );
+
+        // From where the joint is to where the parabola will be
+        __m128 x = _mm_loadu_ps( kinematics.x[joint] + lane );
+        __m128 y = _mm_loadu_ps( kinematics.y[joint] + lane );
+        __m128 z = _mm_loadu_ps( kinematics.z[joint] + lane );
+        __m128 dx = _mm_add_ps( _mm_sub_ps( fit[0][0], x ), _mm_add_ps( _mm_mul_ps( fit[1][0], time ), _mm_mul_ps( fit[2][0], timeSquared ) ) );
+        __m128 dy = _mm_add_ps( _mm_sub_ps( fit[0][1], y ), _mm_add_ps( _mm_mul_ps( fit[1][1], time ), _mm_mul_ps( fit[2][1], timeSquared ) ) );
+        __m128 dz = _mm_add_ps( _mm_sub_ps( fit[0][2], z ), _mm_add_ps( _mm_mul_ps( fit[1][2], time ), _mm_mul_ps( fit[2][2], timeSquared ) ) );
+        ClampLength( dx, dy, dz, maxOffset );
+
+        _mm_storeu_ps( pX[joint] + lane, _mm_add_ps( x, dx ) );
+        _mm_storeu_ps( pY[joint] + lane, _mm_add_ps( y, dy ) );
+        _mm_storeu_ps( pZ[joint] + lane, _mm_add_ps( z, dz ) );
+    }
+}
+
+/// <summary>
+/// Predict where the skeletons of a frame will be a horizon from now
+/// </summary>
+/// <param name="frame">smoothed skeleton frame</param>
+/// <param name="kinematics">kinematics of the same frame, for its positions and history</param>
+/// <param name="predicted">receives a copy of the frame with predicted joints</param>
+void JointPredictor::Predict( const NUI_SKELETON_FRAME & frame, const SKELETON_KINEMATICS_FRAME & kinematics, NUI_SKELETON_FRAME & predicted )
+{
+    // First, how good the guess at this frame was, for skeletons followed since it was made
+    for ( UINT lane = 0; lane < NUI_SKELETON_COUNT; ++lane )
+    {
+        if ( kinematics.cFrames[lane] < 2 || kinematics.dwTrackingID[lane] != m_nextTrackingID[lane] )
+        {
+            continue;
+        }
+
+        for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+        {
+            float dx = kinematics.x[joint][lane] - m_nextX[joint][lane];
+            float dy = kinematics.y[joint][lane] - m_nextY[joint][lane];
+            float dz = kinematics.z[joint][lane] - m_nextZ[joint][lane];
+            float error = sqrtf( dx * dx + dy * dy + dz * dz );
+
+            // What not predicting would have cost is the distance moved since the last frame
+            float vx = kinematics.velocityX[joint][lane];
+            float vy = kinematics.velocityY[joint][lane];
+            float vz = kinematics.velocityZ[joint][lane];
+            float lag = sqrtf( vx * vx + vy * vy + vz * vz ) * kinematics.deltaTime;
+
+            m_errorSum += error;
+            m_lagSum += lag;
+            m_maxError = max( m_maxError, error );
+            ++m_cErrorJoints;
+        }
+    }
+
+    m_newest = (m_newest + 1) % JOINT_PREDICTOR_HISTORY;
+    CopyMemory( m_historyX[m_newest], kinematics.x, sizeof(kinematics.x) );
+    CopyMemory( m_historyY[m_newest], kinematics.y, sizeof(kinematics.y) );
+    CopyMemory( m_historyZ[m_newest], kinematics.z, sizeof(kinematics.z) );
+
+    float x[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float y[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float z[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+
+    // Frames come at a steady rate, so the horizon is a steady number of them
+    float horizonFrames = ( kinematics.deltaTime > 0.0f ) ? m_horizon / (1000.0f * kinematics.deltaTime) : 0.0f;
+    for ( UINT lane = 0; lane < SKELETON_KINEMATICS_LANES; lane += 4 )
+    {
+        Extrapolate( kinematics, lane, 1.0f, m_nextX, m_nextY, m_nextZ );
+        Extrapolate( kinematics, lane, horizonFrames, x, y, z );
+    }
+    CopyMemory( m_nextTrackingID, kinematics.dwTrackingID, sizeof(m_nextTrackingID) );
+
+    predicted = frame;
+    for ( UINT lane = 0; lane < NUI_SKELETON_COUNT; ++lane )
+    {
+        if ( 0 == kinematics.dwTrackingID[lane] )
+        {
+            continue;
+        }
+
+        NUI_SKELETON_DATA & skeleton = predicted.SkeletonData[lane];
+        for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+        {
+            skeleton.SkeletonPositions[joint].x = x[joint][lane];
+            skeleton.SkeletonPositions[joint].y = y[joint][lane];
+            skeleton.SkeletonPositions[joint].z = z[joint][lane];
+        }
+    }
+}
+
+/// <summary>
+/// Read the prediction error of the frames since the last read, and start over
+/// </summary>
+/// <param name="error">receives the error</param>
+/// <returns>true if any joint was compared, false otherwise</returns>
+bool JointPredictor::ReadError( JOINT_PREDICTION_ERROR & error )
+{
+    ZeroMemory( &error, sizeof(error) );
+    if ( 0 == m_cErrorJoints )
+    {
+        return false;
+    }
+
+    error.cJoints = m_cErrorJoints;
+    error.meanError = static_cast<float>(m_errorSum / m_cErrorJoints);
+    error.meanLag = static_cast<float>(m_lagSum / m_cErrorJoints);
+    error.maxError = m_maxError;
+
+    m_cErrorJoints = 0;
+    m_errorSum = 0.0;
+    m_lagSum = 0.0;
+    m_maxError = 0.0f;
+
+    return true;
+}
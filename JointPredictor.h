@@ -0,0 +1,115 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="JointPredictor.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Moves each joint forward in time by a fixed horizon, from the velocity and
+// acceleration of the last frames, to hide the latency between the sensor and
+// the screen.  Both come from a least squares parabola through the last few
+// positions of the joint, since differencing single frames turns a few
+// millimeters of jitter into a shaking prediction.  Velocities, accelerations
+// and the distance moved are clamped, so a tracking glitch isn't thrown across
+// the view.  The predictor also guesses
+// every next frame and keeps how far off it was, next to how far off the frame
+// before would have been, as a live measure of how well prediction is doing.
+
+#pragma once
+
+#include "NuiApi.h"
+#include "SkeletonKinematics.h"
+
+#define JOINT_PREDICTOR_DEFAULT_HORIZON     50      // milliseconds
+#define JOINT_PREDICTOR_MAX_HORIZON         200
+
+// Frames the parabola is fitted through
+#define JOINT_PREDICTOR_HISTORY             5
+
+// Anything faster is a tracking glitch, not a movement
+#define JOINT_PREDICTOR_MAX_SPEED           4.0f    // meters per second
+#define JOINT_PREDICTOR_MAX_ACCELERATION    30.0f   // meters per second squared
+
+// Furthest a joint is ever moved
+#define JOINT_PREDICTOR_MAX_OFFSET          0.2f    // meters
+
+// Prediction error since it was last read
+struct JOINT_PREDICTION_ERROR
+{
+    DWORD   cJoints;            // joints compared
+    float   meanError;          // meters between each joint and where it was predicted a frame earlier
+    float   meanLag;            // meters between each joint and where it was a frame earlier
+    float   maxError;
+};
+
+class JointPredictor
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    JointPredictor();
+
+    /// <summary>
+    /// Set how far ahead to predict
+    /// </summary>
+    /// <param name="milliseconds">horizon, up to JOINT_PREDICTOR_MAX_HORIZON</param>
+    void SetHorizon( UINT milliseconds );
+
+    /// <summary>
+    /// How far ahead joints are predicted
+    /// </summary>
+    /// <returns>horizon in milliseconds</returns>
+    UINT GetHorizon( ) const { return m_horizon; }
+
+    /// <summary>
+    /// Predict where the skeletons of a frame will be a horizon from now
+    /// </summary>
+    /// <param name="frame">smoothed skeleton frame</param>
+    /// <param name="kinematics">kinematics of the same frame, for its positions and history</param>
+    /// <param name="predicted">receives a copy of the frame with predicted joints</param>
+    void Predict( const NUI_SKELETON_FRAME & frame, const SKELETON_KINEMATICS_FRAME & kinematics, NUI_SKELETON_FRAME & predicted );
+
+    /// <summary>
+    /// Read the prediction error of the frames since the last read, and start over
+    /// </summary>
+    /// <param name="error">receives the error</param>
+    /// <returns>true if any joint was compared, false otherwise</returns>
+    bool ReadError( JOINT_PREDICTION_ERROR & error );
+
+private:
+    /// <summary>
+    /// Extrapolate every joint of four lanes
+    /// </summary>
+    /// <param name="kinematics">kinematics of the frame</param>
+    /// <param name="lane">first of the four lanes</param>
+    /// <param name="ahead">frames ahead</param>
+    /// <param name="pX">receives the x of each joint, [joint][lane]</param>
+    /// <param name="pY">receives the y of each joint, [joint][lane]</param>
+    /// <param name="pZ">receives the z of each joint, [joint][lane]</param>
+    void Extrapolate( const SKELETON_KINEMATICS_FRAME & kinematics, UINT lane, float ahead,
+        float (*pX)[SKELETON_KINEMATICS_LANES], float (*pY)[SKELETON_KINEMATICS_LANES], float (*pZ)[SKELETON_KINEMATICS_LANES] );
+
+    UINT                    m_horizon;
+
+    // The last positions of every joint, [frame][joint][lane], the newest at m_newest
+    float                   m_historyX[JOINT_PREDICTOR_HISTORY][NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float                   m_historyY[JOINT_PREDICTOR_HISTORY][NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float                   m_historyZ[JOINT_PREDICTOR_HISTORY][NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    UINT                    m_newest;
+
+    // Weights of the frames, newest first, in the position, slope and curvature of the parabola
+    // through that many frames; fewer than 3 frames fit a line or a point
+    float                   m_fitWeights[JOINT_PREDICTOR_HISTORY + 1][3][JOINT_PREDICTOR_HISTORY];
+
+    // Where each joint was guessed to be in the next frame, and which skeletons were guessed for
+    float                   m_nextX[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float                   m_nextY[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float                   m_nextZ[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    DWORD                   m_nextTrackingID[SKELETON_KINEMATICS_LANES];
+
+    // Error sums since the last read
+    DWORD                   m_cErrorJoints;
+    double                  m_errorSum;
+    double                  m_lagSum;
+    float                   m_maxError;
+};
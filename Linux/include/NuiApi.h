@@ -0,0 +1,255 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="NuiApi.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Stand-in for the Kinect for Windows SDK header, with the types, constants
+// and values of the SDK for what the processing modules and their tests use.
+// There is no runtime behind it: no sensor is ever found, so code that opens
+// one takes its not-connected path, and INuiSensor is only the interface.
+
+#pragma once
+
+#include <windows.h>
+
+//------------------------------------------------------------------------------
+// Errors
+
+#define E_NUI_DEVICE_NOT_CONNECTED  ((HRESULT)0x8007048F)
+#define E_NUI_FRAME_NO_DATA         ((HRESULT)0x83010001)
+
+//------------------------------------------------------------------------------
+// Images
+
+typedef enum _NUI_IMAGE_TYPE
+{
+    NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX = 0,
+    NUI_IMAGE_TYPE_COLOR,
+    NUI_IMAGE_TYPE_COLOR_YUV,
+    NUI_IMAGE_TYPE_COLOR_RAW_YUV,
+    NUI_IMAGE_TYPE_DEPTH,
+    NUI_IMAGE_TYPE_COLOR_INFRARED,
+    NUI_IMAGE_TYPE_COLOR_RAW_BAYER,
+} NUI_IMAGE_TYPE;
+
+typedef enum _NUI_IMAGE_RESOLUTION
+{
+    NUI_IMAGE_RESOLUTION_INVALID = -1,
+    NUI_IMAGE_RESOLUTION_80x60 = 0,
+    NUI_IMAGE_RESOLUTION_320x240,
+    NUI_IMAGE_RESOLUTION_640x480,
+    NUI_IMAGE_RESOLUTION_1280x960,
+} NUI_IMAGE_RESOLUTION;
+
+#define NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX     0x00000001
+#define NUI_INITIALIZE_FLAG_USES_COLOR                      0x00000002
+#define NUI_INITIALIZE_FLAG_USES_SKELETON                   0x00000008
+#define NUI_INITIALIZE_FLAG_USES_DEPTH                      0x00000020
+
+#define NUI_IMAGE_STREAM_FRAME_LIMIT_MAXIMUM                4
+
+#define NUI_IMAGE_PLAYER_INDEX_SHIFT                        3
+#define NUI_IMAGE_PLAYER_INDEX_MASK                         ((1 << NUI_IMAGE_PLAYER_INDEX_SHIFT) - 1)
+#define NUI_IMAGE_DEPTH_MAXIMUM                             ((4000 << NUI_IMAGE_PLAYER_INDEX_SHIFT) | NUI_IMAGE_PLAYER_INDEX_MASK)
+#define NUI_IMAGE_DEPTH_MINIMUM                             (800 << NUI_IMAGE_PLAYER_INDEX_SHIFT)
+#define NUI_IMAGE_DEPTH_NO_VALUE                            0
+
+#define NUI_CAMERA_DEPTH_NOMINAL_FOCAL_LENGTH_IN_PIXELS         (285.63f)
+#define NUI_CAMERA_DEPTH_NOMINAL_INVERSE_FOCAL_LENGTH_IN_PIXELS (3.501e-3f)
+#define NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240   (NUI_CAMERA_DEPTH_NOMINAL_INVERSE_FOCAL_LENGTH_IN_PIXELS)
+#define NUI_CAMERA_SKELETON_TO_DEPTH_IMAGE_MULTIPLIER_320x240   (NUI_CAMERA_DEPTH_NOMINAL_FOCAL_LENGTH_IN_PIXELS)
+
+inline void NuiImageResolutionToSize( NUI_IMAGE_RESOLUTION resolution, DWORD & refWidth, DWORD & refHeight )
+{
+    switch ( resolution )
+    {
+    case NUI_IMAGE_RESOLUTION_80x60:    refWidth = 80;   refHeight = 60;  break;
+    case NUI_IMAGE_RESOLUTION_320x240:  refWidth = 320;  refHeight = 240; break;
+    case NUI_IMAGE_RESOLUTION_640x480:  refWidth = 640;  refHeight = 480; break;
+    case NUI_IMAGE_RESOLUTION_1280x960: refWidth = 1280; refHeight = 960; break;
+    default:                            refWidth = 0;    refHeight = 0;   break;
+    }
+}
+
+inline USHORT NuiDepthPixelToDepth( USHORT packedPixel )
+{
+    return packedPixel >> NUI_IMAGE_PLAYER_INDEX_SHIFT;
+}
+
+inline USHORT NuiDepthPixelToPlayerIndex( USHORT packedPixel )
+{
+    return packedPixel & NUI_IMAGE_PLAYER_INDEX_MASK;
+}
+
+typedef struct _NUI_LOCKED_RECT
+{
+    INT         Pitch;
+    int         size;
+    BYTE *      pBits;
+} NUI_LOCKED_RECT;
+
+typedef struct _NUI_IMAGE_VIEW_AREA
+{
+    int         eDigitalZoom;
+    LONG        lCenterX;
+    LONG        lCenterY;
+} NUI_IMAGE_VIEW_AREA;
+
+class INuiFrameTexture
+{
+public:
+    virtual ULONG   AddRef( ) = 0;
+    virtual ULONG   Release( ) = 0;
+    virtual int     BufferLen( ) = 0;
+    virtual int     Pitch( ) = 0;
+    virtual HRESULT LockRect( UINT Level, NUI_LOCKED_RECT * pLockedRect, RECT * pRect, DWORD Flags ) = 0;
+    virtual HRESULT UnlockRect( UINT Level ) = 0;
+
+protected:
+    virtual ~INuiFrameTexture( ) { }
+};
+
+typedef struct _NUI_IMAGE_FRAME
+{
+    LARGE_INTEGER           liTimeStamp;
+    DWORD                   dwFrameNumber;
+    NUI_IMAGE_TYPE          eImageType;
+    NUI_IMAGE_RESOLUTION    eResolution;
+    INuiFrameTexture *      pFrameTexture;
+    DWORD                   dwFrameFlags;
+    NUI_IMAGE_VIEW_AREA     ViewArea;
+} NUI_IMAGE_FRAME;
+
+//------------------------------------------------------------------------------
+// Skeletons
+
+typedef struct _Vector4
+{
+    FLOAT   x;
+    FLOAT   y;
+    FLOAT   z;
+    FLOAT   w;
+} Vector4;
+
+typedef enum _NUI_SKELETON_POSITION_INDEX
+{
+    NUI_SKELETON_POSITION_HIP_CENTER = 0,
+    NUI_SKELETON_POSITION_SPINE,
+    NUI_SKELETON_POSITION_SHOULDER_CENTER,
+    NUI_SKELETON_POSITION_HEAD,
+    NUI_SKELETON_POSITION_SHOULDER_LEFT,
+    NUI_SKELETON_POSITION_ELBOW_LEFT,
+    NUI_SKELETON_POSITION_WRIST_LEFT,
+    NUI_SKELETON_POSITION_HAND_LEFT,
+    NUI_SKELETON_POSITION_SHOULDER_RIGHT,
+    NUI_SKELETON_POSITION_ELBOW_RIGHT,
+    NUI_SKELETON_POSITION_WRIST_RIGHT,
+    NUI_SKELETON_POSITION_HAND_RIGHT,
+    NUI_SKELETON_POSITION_HIP_LEFT,
+    NUI_SKELETON_POSITION_KNEE_LEFT,
+    NUI_SKELETON_POSITION_ANKLE_LEFT,
+    NUI_SKELETON_POSITION_FOOT_LEFT,
+    NUI_SKELETON_POSITION_HIP_RIGHT,
+    NUI_SKELETON_POSITION_KNEE_RIGHT,
+    NUI_SKELETON_POSITION_ANKLE_RIGHT,
+    NUI_SKELETON_POSITION_FOOT_RIGHT,
+    NUI_SKELETON_POSITION_COUNT
+} NUI_SKELETON_POSITION_INDEX;
+
+typedef enum _NUI_SKELETON_POSITION_TRACKING_STATE
+{
+    NUI_SKELETON_POSITION_NOT_TRACKED = 0,
+    NUI_SKELETON_POSITION_INFERRED,
+    NUI_SKELETON_POSITION_TRACKED
+} NUI_SKELETON_POSITION_TRACKING_STATE;
+
+typedef enum _NUI_SKELETON_TRACKING_STATE
+{
+    NUI_SKELETON_NOT_TRACKED = 0,
+    NUI_SKELETON_POSITION_ONLY,
+    NUI_SKELETON_TRACKED
+} NUI_SKELETON_TRACKING_STATE;
+
+#define NUI_SKELETON_COUNT                  6
+#define NUI_SKELETON_MAX_TRACKED_COUNT      2
+
+typedef struct _NUI_SKELETON_DATA
+{
+    NUI_SKELETON_TRACKING_STATE             eTrackingState;
+    DWORD                                   dwTrackingID;
+    DWORD                                   dwEnrollmentIndex;
+    DWORD                                   dwUserIndex;
+    Vector4                                 Position;
+    Vector4                                 SkeletonPositions[NUI_SKELETON_POSITION_COUNT];
+    NUI_SKELETON_POSITION_TRACKING_STATE    eSkeletonPositionTrackingState[NUI_SKELETON_POSITION_COUNT];
+    DWORD                                   dwQualityFlags;
+} NUI_SKELETON_DATA;
+
+typedef struct _NUI_SKELETON_FRAME
+{
+    LARGE_INTEGER       liTimeStamp;
+    DWORD               dwFrameNumber;
+    DWORD               dwFlags;
+    Vector4             vFloorClipPlane;
+    Vector4             vNormalToGravity;
+    NUI_SKELETON_DATA   SkeletonData[NUI_SKELETON_COUNT];
+} NUI_SKELETON_FRAME;
+
+typedef struct _NUI_TRANSFORM_SMOOTH_PARAMETERS
+{
+    FLOAT   fSmoothing;
+    FLOAT   fCorrection;
+    FLOAT   fPrediction;
+    FLOAT   fJitterRadius;
+    FLOAT   fMaxDeviationRadius;
+} NUI_TRANSFORM_SMOOTH_PARAMETERS;
+
+//------------------------------------------------------------------------------
+// Sensors
+
+class INuiSensor
+{
+public:
+    virtual ULONG   AddRef( ) = 0;
+    virtual ULONG   Release( ) = 0;
+    virtual HRESULT NuiInitialize( DWORD dwFlags ) = 0;
+    virtual void    NuiShutdown( ) = 0;
+    virtual HRESULT NuiImageStreamOpen( NUI_IMAGE_TYPE eImageType, NUI_IMAGE_RESOLUTION eResolution, DWORD dwImageFrameFlags,
+                        DWORD dwFrameLimit, HANDLE hNextFrameEvent, HANDLE * phStreamHandle ) = 0;
+    virtual HRESULT NuiImageStreamGetNextFrame( HANDLE hStream, DWORD dwMillisecondsToWait, NUI_IMAGE_FRAME * pImageFrame ) = 0;
+    virtual HRESULT NuiImageStreamReleaseFrame( HANDLE hStream, NUI_IMAGE_FRAME * pImageFrame ) = 0;
+    virtual HRESULT NuiImageGetColorPixelCoordinatesFromDepthPixelAtResolution( NUI_IMAGE_RESOLUTION eColorResolution,
+                        NUI_IMAGE_RESOLUTION eDepthResolution, const NUI_IMAGE_VIEW_AREA * pcViewArea, LONG lDepthX, LONG lDepthY,
+                        USHORT usDepthValue, LONG * plColorX, LONG * plColorY ) = 0;
+    virtual HRESULT NuiSkeletonTrackingEnable( HANDLE hNextFrameEvent, DWORD dwFlags ) = 0;
+    virtual HRESULT NuiSkeletonGetNextFrame( DWORD dwMillisecondsToWait, NUI_SKELETON_FRAME * pSkeletonFrame ) = 0;
+    virtual HRESULT NuiTransformSmooth( NUI_SKELETON_FRAME * pSkeletonFrame, const NUI_TRANSFORM_SMOOTH_PARAMETERS * pSmoothingParams ) = 0;
+    virtual HRESULT NuiAccelerometerGetCurrentReading( Vector4 * pReading ) = 0;
+
+protected:
+    virtual ~INuiSensor( ) { }
+};
+
+// No sensor is ever connected
+inline HRESULT NuiGetSensorCount( int * pCount )
+{
+    if ( NULL == pCount )
+    {
+        return E_POINTER;
+    }
+
+    *pCount = 0;
+    return S_OK;
+}
+
+inline HRESULT NuiCreateSensorByIndex( int, INuiSensor ** ppNuiSensor )
+{
+    if ( NULL == ppNuiSensor )
+    {
+        return E_POINTER;
+    }
+
+    *ppNuiSensor = NULL;
+    return E_NUI_DEVICE_NOT_CONNECTED;
+}
@@ -0,0 +1,10 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="dwrite.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Stand-in for a Direct2D header the viewer's precompiled header includes;
+// nothing the headless build compiles draws.
+
+#pragma once
@@ -0,0 +1,115 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="strsafe.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Stand-in for the safe string functions the tree uses.  Each always ends the
+// destination in a null, and reports a string cut short as the real ones do.
+
+#pragma once
+
+#include <windows.h>
+
+#define STRSAFE_E_INSUFFICIENT_BUFFER   ((HRESULT)0x8007007A)
+
+inline HRESULT StringCchVPrintfA( char * pszDest, size_t cchDest, const char * pszFormat, va_list arguments )
+{
+    if ( 0 == cchDest )
+    {
+        return E_INVALIDARG;
+    }
+
+    int cch = vsnprintf( pszDest, cchDest, pszFormat, arguments );
+    return ( cch >= 0 && static_cast<size_t>(cch) < cchDest ) ? S_OK : STRSAFE_E_INSUFFICIENT_BUFFER;
+}
+
+inline HRESULT StringCchPrintfA( char * pszDest, size_t cchDest, const char * pszFormat, ... )
+{
+    va_list arguments;
+    va_start( arguments, pszFormat );
+    HRESULT hr = StringCchVPrintfA( pszDest, cchDest, pszFormat, arguments );
+    va_end( arguments );
+    return hr;
+}
+
+inline HRESULT StringCchVPrintfW( wchar_t * pszDest, size_t cchDest, const wchar_t * pszFormat, va_list arguments )
+{
+    if ( 0 == cchDest )
+    {
+        return E_INVALIDARG;
+    }
+
+    // %s of a wide format is a wide string on Windows, and %ls here
+    wchar_t szFormat[512];
+    size_t cchFormat = 0;
+    for ( const wchar_t * p = pszFormat; *p && cchFormat + 2 < _countof(szFormat); ++p )
+    {
+        szFormat[cchFormat++] = *p;
+        if ( L'%' == *p && L'%' == p[1] )
+        {
+            szFormat[cchFormat++] = *++p;
+            continue;
+        }
+        if ( L'%' == *p )
+        {
+            while ( p[1] && wcschr( L"-+ #0123456789.", p[1] ) && cchFormat + 3 < _countof(szFormat) )
+            {
+                szFormat[cchFormat++] = *++p;
+            }
+            if ( L's' == p[1] || L'c' == p[1] )
+            {
+                szFormat[cchFormat++] = L'l';
+            }
+        }
+    }
+    szFormat[cchFormat] = 0;
+
+    int cch = vswprintf( pszDest, cchDest, szFormat, arguments );
+    if ( cch < 0 )
+    {
+        pszDest[cchDest - 1] = 0;
+        return STRSAFE_E_INSUFFICIENT_BUFFER;
+    }
+    return S_OK;
+}
+
+inline HRESULT StringCchPrintfW( wchar_t * pszDest, size_t cchDest, const wchar_t * pszFormat, ... )
+{
+    va_list arguments;
+    va_start( arguments, pszFormat );
+    HRESULT hr = StringCchVPrintfW( pszDest, cchDest, pszFormat, arguments );
+    va_end( arguments );
+    return hr;
+}
+
+inline HRESULT StringCchCopyA( char * pszDest, size_t cchDest, const char * pszSrc )
+{
+    return StringCchPrintfA( pszDest, cchDest, "%s", pszSrc );
+}
+
+inline HRESULT StringCchCopyW( wchar_t * pszDest, size_t cchDest, const wchar_t * pszSrc )
+{
+    if ( 0 == cchDest )
+    {
+        return E_INVALIDARG;
+    }
+
+    size_t cch = wcslen( pszSrc );
+    size_t cchCopy = min( cch, cchDest - 1 );
+    wmemcpy( pszDest, pszSrc, cchCopy );
+    pszDest[cchCopy] = 0;
+    return ( cchCopy == cch ) ? S_OK : STRSAFE_E_INSUFFICIENT_BUFFER;
+}
+
+inline HRESULT StringCchCatA( char * pszDest, size_t cchDest, const char * pszSrc )
+{
+    size_t cch = strnlen( pszDest, cchDest );
+    return ( cch < cchDest ) ? StringCchCopyA( pszDest + cch, cchDest - cch, pszSrc ) : E_INVALIDARG;
+}
+
+inline HRESULT StringCchCatW( wchar_t * pszDest, size_t cchDest, const wchar_t * pszSrc )
+{
+    size_t cch = wcsnlen( pszDest, cchDest );
+    return ( cch < cchDest ) ? StringCchCopyW( pszDest + cch, cchDest - cch, pszSrc ) : E_INVALIDARG;
+}
@@ -0,0 +1,10 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="tchar.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Stand-in for a Windows header the sources include for nothing the
+// headless build uses.
+
+#pragma once
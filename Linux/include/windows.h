@@ -0,0 +1,1443 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="windows.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Stand-in for the parts of the Windows headers the processing modules and
+// their tests use, on POSIX threads, files and shared memory, so the headless
+// tests and benchmarks build and run on Linux.  Waits honor their timeouts and
+// wake on any of several objects as WaitForMultipleObjects does; fibers are
+// ucontext switches; GDI has no bitmaps to load.  Only what the tree calls is
+// here, with the Win32 signatures and return conventions.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <emmintrin.h>
+
+//------------------------------------------------------------------------------
+// Types and constants
+
+typedef int                 BOOL;
+typedef int                 INT;
+typedef unsigned char       BYTE;
+typedef unsigned short      USHORT;
+typedef unsigned short      WORD;
+typedef short               SHORT;
+typedef unsigned int        UINT;
+typedef int32_t             LONG;
+typedef uint32_t            ULONG;
+typedef uint32_t            DWORD;
+typedef int64_t             LONGLONG;
+typedef uint64_t            ULONGLONG;
+typedef uintptr_t           ULONG_PTR;
+typedef uintptr_t           DWORD_PTR;
+typedef size_t              SIZE_T;
+typedef float               FLOAT;
+typedef char                CHAR;
+typedef wchar_t             WCHAR;
+typedef const char *        LPCSTR;
+typedef char *              LPSTR;
+typedef const wchar_t *     LPCWSTR;
+typedef wchar_t *           LPWSTR;
+typedef void                VOID;
+typedef void *              LPVOID;
+typedef const void *        LPCVOID;
+typedef void *              HANDLE;
+typedef void *              HWND;
+typedef void *              HINSTANCE;
+typedef void *              LPSECURITY_ATTRIBUTES;
+typedef int32_t             HRESULT;
+
+typedef struct tagRECT
+{
+    LONG    left;
+    LONG    top;
+    LONG    right;
+    LONG    bottom;
+} RECT;
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        DWORD   LowPart;
+        LONG    HighPart;
+    };
+    LONGLONG    QuadPart;
+} LARGE_INTEGER;
+
+#define TRUE                        1
+#define FALSE                       0
+#define CONST                       const
+#define MAX_PATH                    260
+#define MAXWORD                     0xFFFF
+#define MAXLONG                     0x7FFFFFFF
+#define MAXDWORD                    0xFFFFFFFF
+#define INFINITE                    0xFFFFFFFF
+
+#define WINAPI
+#define CALLBACK
+#define __stdcall
+#define __cdecl
+#define __forceinline               inline __attribute__((always_inline))
+
+// __declspec(align(n)), dllimport and dllexport
+#define __declspec(x)               LINUX_DECLSPEC_##x
+#define LINUX_DECLSPEC_align(n)     __attribute__((aligned(n)))
+#define LINUX_DECLSPEC_dllimport
+#define LINUX_DECLSPEC_dllexport    __attribute__((visibility("default")))
+
+#define UNREFERENCED_PARAMETER(P)   (void)(P)
+#define LOWORD(l)                   ((WORD)(((DWORD_PTR)(l)) & 0xFFFF))
+#define HIWORD(l)                   ((WORD)((((DWORD_PTR)(l)) >> 16) & 0xFFFF))
+#define MAKEWORD(a, b)              ((WORD)(((BYTE)(a)) | (((WORD)((BYTE)(b))) << 8)))
+#define UInt32x32To64(a, b)         ((ULONGLONG)(DWORD)(a) * (ULONGLONG)(DWORD)(b))
+#define FIELD_OFFSET(type, field)   ((LONG)offsetof(type, field))
+#define _countof(a)                 (sizeof(a) / sizeof((a)[0]))
+
+#ifndef min
+#define min(a, b)                   (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b)                   (((a) > (b)) ? (a) : (b))
+#endif
+
+#define ZeroMemory(p, n)            memset((p), 0, (n))
+#define FillMemory(p, n, v)         memset((p), (v), (n))
+#define CopyMemory(d, s, n)         memcpy((d), (s), (n))
+#define MoveMemory(d, s, n)         memmove((d), (s), (n))
+
+#define _stricmp                    strcasecmp
+#define _strnicmp                   strncasecmp
+#define _wcsicmp                    wcscasecmp
+
+//------------------------------------------------------------------------------
+// Errors
+
+#define S_OK                        ((HRESULT)0)
+#define S_FALSE                     ((HRESULT)1)
+#define E_FAIL                      ((HRESULT)0x80004005)
+#define E_POINTER                   ((HRESULT)0x80004003)
+#define E_ABORT                     ((HRESULT)0x80004004)
+#define E_NOTIMPL                   ((HRESULT)0x80004001)
+#define E_OUTOFMEMORY               ((HRESULT)0x8007000E)
+#define E_INVALIDARG                ((HRESULT)0x80070057)
+#define SUCCEEDED(hr)               (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)                  (((HRESULT)(hr)) < 0)
+#define HRESULT_FROM_WIN32(e)       ((HRESULT)(e) <= 0 ? ((HRESULT)(e)) : ((HRESULT)(((e) & 0x0000FFFF) | 0x80070000)))
+
+#define ERROR_SUCCESS               0
+#define ERROR_FILE_NOT_FOUND        2
+#define ERROR_ACCESS_DENIED         5
+#define ERROR_INVALID_HANDLE        6
+#define ERROR_NOT_ENOUGH_MEMORY     8
+#define ERROR_BAD_FORMAT            11
+#define ERROR_INVALID_PARAMETER     87
+#define ERROR_ALREADY_EXISTS        183
+#define ERROR_TIMEOUT               1460
+
+inline DWORD & LinuxLastError( )
+{
+    static thread_local DWORD error = ERROR_SUCCESS;
+    return error;
+}
+
+inline DWORD GetLastError( )
+{
+    return LinuxLastError( );
+}
+
+inline void SetLastError( DWORD error )
+{
+    LinuxLastError( ) = error;
+}
+
+// Win32 error closest to an errno
+inline DWORD LinuxErrorFromErrno( int error )
+{
+    switch ( error )
+    {
+    case ENOENT:    return ERROR_FILE_NOT_FOUND;
+    case EACCES:    return ERROR_ACCESS_DENIED;
+    case EEXIST:    return ERROR_ALREADY_EXISTS;
+    case ENOMEM:    return ERROR_NOT_ENOUGH_MEMORY;
+    case EBADF:     return ERROR_INVALID_HANDLE;
+    default:        return ERROR_INVALID_PARAMETER;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Time
+
+inline BOOL QueryPerformanceCounter( LARGE_INTEGER * pCount )
+{
+    timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    pCount->QuadPart = static_cast<LONGLONG>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    return TRUE;
+}
+
+inline BOOL QueryPerformanceFrequency( LARGE_INTEGER * pFrequency )
+{
+    pFrequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+inline DWORD GetTickCount( )
+{
+    timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return static_cast<DWORD>(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+inline DWORD timeGetTime( )
+{
+    return GetTickCount( );
+}
+
+inline void Sleep( DWORD milliseconds )
+{
+    usleep( milliseconds * 1000 );
+}
+
+//------------------------------------------------------------------------------
+// System
+
+typedef struct _SYSTEM_INFO
+{
+    DWORD   dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+inline void GetSystemInfo( SYSTEM_INFO * pInfo )
+{
+    pInfo->dwNumberOfProcessors = static_cast<DWORD>(sysconf( _SC_NPROCESSORS_ONLN ));
+}
+
+inline void OutputDebugStringW( LPCWSTR )
+{
+}
+
+inline void OutputDebugStringA( LPCSTR )
+{
+}
+
+#define OutputDebugString           OutputDebugStringW
+
+//------------------------------------------------------------------------------
+// Memory
+
+inline void * _aligned_malloc( size_t size, size_t alignment )
+{
+    void * p = NULL;
+    return ( 0 == posix_memalign( &p, max( alignment, sizeof(void *) ), size ) ) ? p : NULL;
+}
+
+inline void _aligned_free( void * p )
+{
+    free( p );
+}
+
+//------------------------------------------------------------------------------
+// Interlocked operations and barriers
+
+inline LONG InterlockedExchange( volatile LONG * pTarget, LONG value )
+{
+    return __atomic_exchange_n( pTarget, value, __ATOMIC_SEQ_CST );
+}
+
+inline LONG InterlockedCompareExchange( volatile LONG * pTarget, LONG exchange, LONG comparand )
+{
+    __atomic_compare_exchange_n( pTarget, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+    return comparand;
+}
+
+inline LONG InterlockedExchangeAdd( volatile LONG * pTarget, LONG value )
+{
+    return __atomic_fetch_add( pTarget, value, __ATOMIC_SEQ_CST );
+}
+
+inline LONG InterlockedIncrement( volatile LONG * pTarget )
+{
+    return __atomic_add_fetch( pTarget, 1, __ATOMIC_SEQ_CST );
+}
+
+inline LONG InterlockedDecrement( volatile LONG * pTarget )
+{
+    return __atomic_sub_fetch( pTarget, 1, __ATOMIC_SEQ_CST );
+}
+
+#define MemoryBarrier( )            __atomic_thread_fence( __ATOMIC_SEQ_CST )
+#define YieldProcessor( )           _mm_pause( )
+
+//------------------------------------------------------------------------------
+// Handles
+//
+// Every handle points at an object starting with its kind and how to close
+// it.  Events,
+// semaphores and threads are waitable, and their states are guarded by one
+// lock; each has a condition its own waiters sleep on, and waits on several
+// objects sleep on a shared condition that any signal wakes while they wait.
+
+enum LINUX_HANDLE_KIND
+{
+    LINUX_HANDLE_EVENT = 1,
+    LINUX_HANDLE_SEMAPHORE,
+    LINUX_HANDLE_THREAD,
+    LINUX_HANDLE_FILE,
+    LINUX_HANDLE_MAPPING,
+};
+
+struct LINUX_HANDLE
+{
+    LINUX_HANDLE_KIND   kind;
+    LONG                cReferences;
+    void                (*pfnClose)( LINUX_HANDLE * pHandle );
+};
+
+struct LINUX_WAITABLE : LINUX_HANDLE
+{
+    pthread_cond_t      wake;
+    LONG                count;          // events and threads: 1 signaled, 0 not; semaphores: the count
+    LONG                maximum;        // semaphores: the largest count
+    bool                bManualReset;   // events that stay signaled, and threads once they end
+};
+
+struct LINUX_WAIT_STATE
+{
+    pthread_mutex_t     lock;
+    pthread_cond_t      anyWake;
+    UINT                cMultipleWaiters;
+};
+
+#define WAIT_OBJECT_0               0x00000000
+#define WAIT_TIMEOUT                0x00000102
+#define WAIT_FAILED                 0xFFFFFFFF
+#define MAXIMUM_WAIT_OBJECTS        64
+#define INVALID_HANDLE_VALUE        ((HANDLE)(intptr_t)-1)
+
+inline LINUX_WAIT_STATE & LinuxWaitState( )
+{
+    static LINUX_WAIT_STATE state = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 };
+    return state;
+}
+
+inline void LinuxReleaseWaitable( LINUX_WAITABLE * pObject )
+{
+    if ( 0 == InterlockedDecrement( &pObject->cReferences ) )
+    {
+        pthread_cond_destroy( &pObject->wake );
+        delete pObject;
+    }
+}
+
+inline void LinuxCloseWaitable( LINUX_HANDLE * pHandle )
+{
+    LinuxReleaseWaitable( static_cast<LINUX_WAITABLE *>(pHandle) );
+}
+
+inline LINUX_WAITABLE * LinuxCreateWaitable( LINUX_HANDLE_KIND kind, LONG count, LONG maximum, bool bManualReset, LONG cReferences )
+{
+    LINUX_WAITABLE * pObject = new LINUX_WAITABLE;
+    pObject->kind = kind;
+    pObject->cReferences = cReferences;
+    pObject->pfnClose = LinuxCloseWaitable;
+    pthread_cond_init( &pObject->wake, NULL );
+    pObject->count = count;
+    pObject->maximum = maximum;
+    pObject->bManualReset = bManualReset;
+    return pObject;
+}
+
+// Raise the count of an object and wake its waiters, with the lock held
+inline void LinuxSignal( LINUX_WAITABLE * pObject, LONG count )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+
+    pObject->count = count;
+    if ( pObject->bManualReset || count > 1 )
+    {
+        pthread_cond_broadcast( &pObject->wake );
+    }
+    else
+    {
+        pthread_cond_signal( &pObject->wake );
+    }
+
+    if ( state.cMultipleWaiters > 0 )
+    {
+        pthread_cond_broadcast( &state.anyWake );
+    }
+}
+
+// Take a signal from an object if it has one, with the lock held
+inline bool LinuxTryAcquire( LINUX_WAITABLE * pObject )
+{
+    if ( pObject->count <= 0 )
+    {
+        return false;
+    }
+
+    if ( !pObject->bManualReset )
+    {
+        --pObject->count;
+    }
+    return true;
+}
+
+// Sleep on a condition until the deadline, false once it has passed
+inline bool LinuxSleepUntil( pthread_cond_t * pCondition, const timespec * pDeadline )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+
+    if ( NULL == pDeadline )
+    {
+        pthread_cond_wait( pCondition, &state.lock );
+        return true;
+    }
+
+    return ETIMEDOUT != pthread_cond_timedwait( pCondition, &state.lock, pDeadline );
+}
+
+inline void LinuxDeadline( DWORD milliseconds, timespec & deadline )
+{
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+    if ( deadline.tv_nsec >= 1000000000L )
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+}
+
+inline DWORD WaitForMultipleObjects( DWORD cHandles, const HANDLE * pHandles, BOOL bWaitAll, DWORD milliseconds )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+    LINUX_WAITABLE * pObjects[MAXIMUM_WAIT_OBJECTS];
+
+    if ( 0 == cHandles || cHandles > MAXIMUM_WAIT_OBJECTS )
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return WAIT_FAILED;
+    }
+
+    for ( DWORD i = 0; i < cHandles; ++i )
+    {
+        pObjects[i] = static_cast<LINUX_WAITABLE *>(pHandles[i]);
+        if ( NULL == pObjects[i] || INVALID_HANDLE_VALUE == pHandles[i] ||
+             (LINUX_HANDLE_EVENT != pObjects[i]->kind && LINUX_HANDLE_SEMAPHORE != pObjects[i]->kind && LINUX_HANDLE_THREAD != pObjects[i]->kind) )
+        {
+            SetLastError( ERROR_INVALID_HANDLE );
+            return WAIT_FAILED;
+        }
+    }
+
+    timespec deadline;
+    timespec * pDeadline = NULL;
+    if ( INFINITE != milliseconds )
+    {
+        LinuxDeadline( milliseconds, deadline );
+        pDeadline = &deadline;
+    }
+
+    pthread_mutex_lock( &state.lock );
+
+    DWORD result = WAIT_TIMEOUT;
+    for ( ;; )
+    {
+        if ( bWaitAll )
+        {
+            DWORD cSignaled = 0;
+            while ( cSignaled < cHandles && pObjects[cSignaled]->count > 0 )
+            {
+                ++cSignaled;
+            }
+
+            if ( cSignaled == cHandles )
+            {
+                for ( DWORD i = 0; i < cHandles; ++i )
+                {
+                    LinuxTryAcquire( pObjects[i] );
+                }
+                result = WAIT_OBJECT_0;
+                break;
+            }
+        }
+        else
+        {
+            DWORD i = 0;
+            while ( i < cHandles && !LinuxTryAcquire( pObjects[i] ) )
+            {
+                ++i;
+            }
+
+            if ( i < cHandles )
+            {
+                result = WAIT_OBJECT_0 + i;
+                break;
+            }
+        }
+
+        bool bAwake;
+        if ( 1 == cHandles )
+        {
+            bAwake = LinuxSleepUntil( &pObjects[0]->wake, pDeadline );
+        }
+        else
+        {
+            ++state.cMultipleWaiters;
+            bAwake = LinuxSleepUntil( &state.anyWake, pDeadline );
+            --state.cMultipleWaiters;
+        }
+
+        if ( !bAwake )
+        {
+            // Signaled as the time ran out is still signaled
+            if ( 1 == cHandles && LinuxTryAcquire( pObjects[0] ) )
+            {
+                result = WAIT_OBJECT_0;
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock( &state.lock );
+
+    return result;
+}
+
+inline DWORD WaitForSingleObject( HANDLE hHandle, DWORD milliseconds )
+{
+    return WaitForMultipleObjects( 1, &hHandle, TRUE, milliseconds );
+}
+
+//------------------------------------------------------------------------------
+// Events and semaphores
+
+inline HANDLE CreateEventW( LPSECURITY_ATTRIBUTES, BOOL bManualReset, BOOL bInitialState, LPCWSTR )
+{
+    return LinuxCreateWaitable( LINUX_HANDLE_EVENT, bInitialState ? 1 : 0, 1, 0 != bManualReset, 1 );
+}
+
+#define CreateEvent                 CreateEventW
+
+inline BOOL SetEvent( HANDLE hEvent )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+
+    pthread_mutex_lock( &state.lock );
+    LinuxSignal( static_cast<LINUX_WAITABLE *>(hEvent), 1 );
+    pthread_mutex_unlock( &state.lock );
+
+    return TRUE;
+}
+
+inline BOOL ResetEvent( HANDLE hEvent )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+
+    pthread_mutex_lock( &state.lock );
+    static_cast<LINUX_WAITABLE *>(hEvent)->count = 0;
+    pthread_mutex_unlock( &state.lock );
+
+    return TRUE;
+}
+
+inline HANDLE CreateSemaphoreW( LPSECURITY_ATTRIBUTES, LONG initialCount, LONG maximumCount, LPCWSTR )
+{
+    if ( initialCount < 0 || maximumCount <= 0 || initialCount > maximumCount )
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return NULL;
+    }
+
+    return LinuxCreateWaitable( LINUX_HANDLE_SEMAPHORE, initialCount, maximumCount, false, 1 );
+}
+
+#define CreateSemaphore             CreateSemaphoreW
+
+inline BOOL ReleaseSemaphore( HANDLE hSemaphore, LONG releaseCount, LONG * pPreviousCount )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+    LINUX_WAITABLE * pSemaphore = static_cast<LINUX_WAITABLE *>(hSemaphore);
+    BOOL bReleased = FALSE;
+
+    pthread_mutex_lock( &state.lock );
+    if ( releaseCount > 0 && pSemaphore->count + releaseCount <= pSemaphore->maximum )
+    {
+        if ( pPreviousCount )
+        {
+            *pPreviousCount = pSemaphore->count;
+        }
+        LinuxSignal( pSemaphore, pSemaphore->count + releaseCount );
+        bReleased = TRUE;
+    }
+    pthread_mutex_unlock( &state.lock );
+
+    if ( !bReleased )
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+    }
+    return bReleased;
+}
+
+//------------------------------------------------------------------------------
+// Threads
+//
+// The thread holds a reference to its handle object, and signals it when its
+// routine returns.
+
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)( LPVOID pParameter );
+
+struct LINUX_THREAD_START
+{
+    LINUX_WAITABLE *        pObject;
+    LPTHREAD_START_ROUTINE  pfnStart;
+    LPVOID                  pParameter;
+};
+
+inline void * LinuxThreadMain( void * pStart )
+{
+    LINUX_THREAD_START start = *static_cast<LINUX_THREAD_START *>(pStart);
+    delete static_cast<LINUX_THREAD_START *>(pStart);
+
+    start.pfnStart( start.pParameter );
+
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+    pthread_mutex_lock( &state.lock );
+    LinuxSignal( start.pObject, 1 );
+    pthread_mutex_unlock( &state.lock );
+
+    LinuxReleaseWaitable( start.pObject );
+    return NULL;
+}
+
+inline HANDLE CreateThread( LPSECURITY_ATTRIBUTES, SIZE_T cbStack, LPTHREAD_START_ROUTINE pfnStart, LPVOID pParameter, DWORD, DWORD * pThreadId )
+{
+    LINUX_WAITABLE * pObject = LinuxCreateWaitable( LINUX_HANDLE_THREAD, 0, 1, true, 2 );
+
+    LINUX_THREAD_START * pStart = new LINUX_THREAD_START;
+    pStart->pObject = pObject;
+    pStart->pfnStart = pfnStart;
+    pStart->pParameter = pParameter;
+
+    pthread_attr_t attributes;
+    pthread_attr_init( &attributes );
+    pthread_attr_setdetachstate( &attributes, PTHREAD_CREATE_DETACHED );
+    if ( cbStack > 0 )
+    {
+        pthread_attr_setstacksize( &attributes, max( cbStack, static_cast<SIZE_T>(PTHREAD_STACK_MIN) ) );
+    }
+
+    pthread_t thread;
+    int error = pthread_create( &thread, &attributes, LinuxThreadMain, pStart );
+    pthread_attr_destroy( &attributes );
+
+    if ( 0 != error )
+    {
+        delete pStart;
+        delete pObject;
+        SetLastError( LinuxErrorFromErrno( error ) );
+        return NULL;
+    }
+
+    if ( pThreadId )
+    {
+        *pThreadId = static_cast<DWORD>(reinterpret_cast<uintptr_t>(pObject));
+    }
+    return pObject;
+}
+
+#define THREAD_PRIORITY_NORMAL          0
+#define THREAD_PRIORITY_ABOVE_NORMAL    1
+#define THREAD_PRIORITY_HIGHEST         2
+
+inline HANDLE GetCurrentThread( )
+{
+    return NULL;
+}
+
+inline BOOL SetThreadPriority( HANDLE, int )
+{
+    return TRUE;
+}
+
+//------------------------------------------------------------------------------
+// Critical sections
+
+typedef pthread_mutex_t CRITICAL_SECTION;
+
+inline void InitializeCriticalSection( CRITICAL_SECTION * pSection )
+{
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init( &attributes );
+    pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( pSection, &attributes );
+    pthread_mutexattr_destroy( &attributes );
+}
+
+inline void DeleteCriticalSection( CRITICAL_SECTION * pSection )
+{
+    pthread_mutex_destroy( pSection );
+}
+
+inline void EnterCriticalSection( CRITICAL_SECTION * pSection )
+{
+    pthread_mutex_lock( pSection );
+}
+
+inline BOOL TryEnterCriticalSection( CRITICAL_SECTION * pSection )
+{
+    return 0 == pthread_mutex_trylock( pSection );
+}
+
+inline void LeaveCriticalSection( CRITICAL_SECTION * pSection )
+{
+    pthread_mutex_unlock( pSection );
+}
+
+//------------------------------------------------------------------------------
+// Fibers
+//
+// A fiber is a ucontext and its stack; the thread converted to a fiber keeps
+// the context it was running on.
+
+#define FIBER_FLAG_FLOAT_SWITCH     0x1
+
+typedef void (WINAPI *LPFIBER_START_ROUTINE)( LPVOID pParameter );
+
+struct LINUX_FIBER
+{
+    ucontext_t              context;
+    void *                  pStack;
+    LPFIBER_START_ROUTINE   pfnStart;
+    LPVOID                  pParameter;
+};
+
+inline LINUX_FIBER *& LinuxCurrentFiber( )
+{
+    static thread_local LINUX_FIBER * pFiber = NULL;
+    return pFiber;
+}
+
+inline LPVOID GetCurrentFiber( )
+{
+    return LinuxCurrentFiber( );
+}
+
+inline LPVOID ConvertThreadToFiberEx( LPVOID, DWORD )
+{
+    LINUX_FIBER * pFiber = new LINUX_FIBER( );
+    LinuxCurrentFiber( ) = pFiber;
+    return pFiber;
+}
+
+inline BOOL ConvertFiberToThread( )
+{
+    delete LinuxCurrentFiber( );
+    LinuxCurrentFiber( ) = NULL;
+    return TRUE;
+}
+
+// makecontext passes ints, so the fiber comes in two halves
+inline void LinuxFiberMain( unsigned int low, unsigned int high )
+{
+    LINUX_FIBER * pFiber = reinterpret_cast<LINUX_FIBER *>((static_cast<uintptr_t>(high) << 16 << 16) | low);
+    pFiber->pfnStart( pFiber->pParameter );
+}
+
+inline LPVOID CreateFiberEx( SIZE_T, SIZE_T cbStack, DWORD, LPFIBER_START_ROUTINE pfnStart, LPVOID pParameter )
+{
+    cbStack = max( cbStack, static_cast<SIZE_T>(64 * 1024) );
+
+    LINUX_FIBER * pFiber = new LINUX_FIBER( );
+    pFiber->pfnStart = pfnStart;
+    pFiber->pParameter = pParameter;
+    pFiber->pStack = malloc( cbStack );
+    if ( NULL == pFiber->pStack )
+    {
+        delete pFiber;
+        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+        return NULL;
+    }
+
+    getcontext( &pFiber->context );
+    pFiber->context.uc_stack.ss_sp = pFiber->pStack;
+    pFiber->context.uc_stack.ss_size = cbStack;
+    pFiber->context.uc_link = NULL;
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(pFiber);
+    makecontext( &pFiber->context, reinterpret_cast<void (*)( )>(LinuxFiberMain), 2,
+        static_cast<unsigned int>(address & 0xFFFFFFFF), static_cast<unsigned int>(address >> 16 >> 16) );
+
+    return pFiber;
+}
+
+inline void SwitchToFiber( LPVOID pFiber )
+{
+    LINUX_FIBER * pFrom = LinuxCurrentFiber( );
+    LinuxCurrentFiber( ) = static_cast<LINUX_FIBER *>(pFiber);
+    swapcontext( &pFrom->context, &static_cast<LINUX_FIBER *>(pFiber)->context );
+}
+
+inline void DeleteFiber( LPVOID pFiber )
+{
+    free( static_cast<LINUX_FIBER *>(pFiber)->pStack );
+    delete static_cast<LINUX_FIBER *>(pFiber);
+}
+
+//------------------------------------------------------------------------------
+// Strings
+
+#define CP_ACP                      0
+#define CP_UTF8                     65001
+
+// Only whole strings ending in a null, in the locale's encoding, are converted
+inline int MultiByteToWideChar( UINT, DWORD, LPCSTR pMultiByte, int cbMultiByte, LPWSTR pWide, int cchWide )
+{
+    size_t cchNeeded = ( -1 == cbMultiByte ) ? mbstowcs( NULL, pMultiByte, 0 ) : static_cast<size_t>(-1);
+    if ( static_cast<size_t>(-1) == cchNeeded || (0 != cchWide && cchNeeded + 1 > static_cast<size_t>(cchWide)) )
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return 0;
+    }
+
+    if ( 0 != cchWide )
+    {
+        mbstowcs( pWide, pMultiByte, cchWide );
+    }
+    return static_cast<int>(cchNeeded + 1);
+}
+
+inline size_t LinuxPath( LPCWSTR szPath, char * szNarrow, size_t cbNarrow )
+{
+    size_t cb = wcstombs( szNarrow, szPath, cbNarrow );
+    if ( static_cast<size_t>(-1) == cb || cb >= cbNarrow )
+    {
+        return 0;
+    }
+    return cb;
+}
+
+// sscanf_s reads a buffer size after each string; %s, %c, %d, %u, %x and %f are understood
+inline int sscanf_s( const char * szInput, const char * szFormat, ... )
+{
+    va_list arguments;
+    va_start( arguments, szFormat );
+
+    int cAssigned = 0;
+    const char * pInput = szInput;
+    for ( const char * pFormat = szFormat; *pFormat; ++pFormat )
+    {
+        if ( isspace( static_cast<unsigned char>(*pFormat) ) )
+        {
+            while ( isspace( static_cast<unsigned char>(*pInput) ) )
+            {
+                ++pInput;
+            }
+            continue;
+        }
+
+        if ( '%' != *pFormat || '%' == pFormat[1] )
+        {
+            pFormat += ( '%' == *pFormat ) ? 1 : 0;
+            if ( *pInput != *pFormat )
+            {
+                break;
+            }
+            ++pInput;
+            continue;
+        }
+
+        ++pFormat;
+        unsigned width = 0;
+        while ( *pFormat >= '0' && *pFormat <= '9' )
+        {
+            width = width * 10 + (*pFormat++ - '0');
+        }
+
+        char conversion = *pFormat;
+        if ( 'c' != conversion )
+        {
+            while ( isspace( static_cast<unsigned char>(*pInput) ) )
+            {
+                ++pInput;
+            }
+        }
+        if ( 0 == *pInput )
+        {
+            cAssigned = ( 0 == cAssigned ) ? EOF : cAssigned;
+            break;
+        }
+
+        char * pEnd = const_cast<char *>(pInput);
+        if ( 's' == conversion || 'c' == conversion )
+        {
+            char * pOut = va_arg( arguments, char * );
+            unsigned cbOut = va_arg( arguments, unsigned );
+            unsigned limit = ( 'c' == conversion ) ? max( width, 1u ) : ( width ? width : ~0u );
+            unsigned cch = 0;
+            while ( pInput[cch] && cch < limit && ('c' == conversion || !isspace( static_cast<unsigned char>(pInput[cch]) )) )
+            {
+                ++cch;
+            }
+            if ( cch + ('s' == conversion ? 1 : 0) > cbOut )
+            {
+                break;
+            }
+            memcpy( pOut, pInput, cch );
+            if ( 's' == conversion )
+            {
+                pOut[cch] = 0;
+            }
+            pEnd += cch;
+        }
+        else if ( 'd' == conversion )
+        {
+            *va_arg( arguments, int * ) = static_cast<int>(strtol( pInput, &pEnd, 10 ));
+        }
+        else if ( 'u' == conversion || 'x' == conversion )
+        {
+            *va_arg( arguments, unsigned * ) = static_cast<unsigned>(strtoul( pInput, &pEnd, ( 'x' == conversion ) ? 16 : 10 ));
+        }
+        else if ( 'f' == conversion )
+        {
+            *va_arg( arguments, float * ) = strtof( pInput, &pEnd );
+        }
+        else
+        {
+            break;
+        }
+
+        if ( pEnd == pInput )
+        {
+            break;
+        }
+        pInput = pEnd;
+        ++cAssigned;
+    }
+
+    va_end( arguments );
+    return cAssigned;
+}
+
+//------------------------------------------------------------------------------
+// Files
+
+#define GENERIC_READ                0x80000000
+#define GENERIC_WRITE               0x40000000
+#define FILE_SHARE_READ             0x00000001
+#define FILE_SHARE_WRITE            0x00000002
+#define CREATE_NEW                  1
+#define CREATE_ALWAYS               2
+#define OPEN_EXISTING               3
+#define OPEN_ALWAYS                 4
+#define FILE_ATTRIBUTE_NORMAL       0x00000080
+#define FILE_FLAG_SEQUENTIAL_SCAN   0x08000000
+#define INVALID_FILE_SIZE           ((DWORD)0xFFFFFFFF)
+
+struct LINUX_FILE : LINUX_HANDLE
+{
+    int     fd;
+};
+
+inline void LinuxCloseFile( LINUX_HANDLE * pHandle )
+{
+    close( static_cast<LINUX_FILE *>(pHandle)->fd );
+    delete static_cast<LINUX_FILE *>(pHandle);
+}
+
+inline HANDLE CreateFileW( LPCWSTR szFileName, DWORD dwAccess, DWORD, LPSECURITY_ATTRIBUTES, DWORD dwDisposition, DWORD, HANDLE )
+{
+    char szPath[4 * MAX_PATH];
+    if ( 0 == LinuxPath( szFileName, szPath, sizeof(szPath) ) )
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return INVALID_HANDLE_VALUE;
+    }
+
+    int flags = ( (dwAccess & GENERIC_READ) && (dwAccess & GENERIC_WRITE) ) ? O_RDWR : ( (dwAccess & GENERIC_WRITE) ? O_WRONLY : O_RDONLY );
+    switch ( dwDisposition )
+    {
+    case CREATE_NEW:    flags |= O_CREAT | O_EXCL; break;
+    case CREATE_ALWAYS: flags |= O_CREAT | O_TRUNC; break;
+    case OPEN_ALWAYS:   flags |= O_CREAT; break;
+    default:            break;
+    }
+
+    int fd = open( szPath, flags | O_CLOEXEC, 0644 );
+    if ( fd < 0 )
+    {
+        SetLastError( LinuxErrorFromErrno( errno ) );
+        return INVALID_HANDLE_VALUE;
+    }
+
+    LINUX_FILE * pFile = new LINUX_FILE;
+    pFile->kind = LINUX_HANDLE_FILE;
+    pFile->cReferences = 1;
+    pFile->pfnClose = LinuxCloseFile;
+    pFile->fd = fd;
+    return pFile;
+}
+
+inline BOOL ReadFile( HANDLE hFile, LPVOID pBuffer, DWORD cbToRead, DWORD * pcbRead, LPVOID )
+{
+    DWORD cbRead = 0;
+    while ( cbRead < cbToRead )
+    {
+        ssize_t cb = read( static_cast<LINUX_FILE *>(hFile)->fd, static_cast<BYTE *>(pBuffer) + cbRead, cbToRead - cbRead );
+        if ( cb < 0 && EINTR == errno )
+        {
+            continue;
+        }
+        if ( cb < 0 )
+        {
+            SetLastError( LinuxErrorFromErrno( errno ) );
+            return FALSE;
+        }
+        if ( 0 == cb )
+        {
+            break;
+        }
+        cbRead += static_cast<DWORD>(cb);
+    }
+
+    if ( pcbRead )
+    {
+        *pcbRead = cbRead;
+    }
+    return TRUE;
+}
+
+inline BOOL WriteFile( HANDLE hFile, LPCVOID pBuffer, DWORD cbToWrite, DWORD * pcbWritten, LPVOID )
+{
+    DWORD cbWritten = 0;
+    while ( cbWritten < cbToWrite )
+    {
+        ssize_t cb = write( static_cast<LINUX_FILE *>(hFile)->fd, static_cast<const BYTE *>(pBuffer) + cbWritten, cbToWrite - cbWritten );
+        if ( cb < 0 && EINTR == errno )
+        {
+            continue;
+        }
+        if ( cb <= 0 )
+        {
+            SetLastError( LinuxErrorFromErrno( errno ) );
+            break;
+        }
+        cbWritten += static_cast<DWORD>(cb);
+    }
+
+    if ( pcbWritten )
+    {
+        *pcbWritten = cbWritten;
+    }
+    return cbWritten == cbToWrite;
+}
+
+inline DWORD GetFileSize( HANDLE hFile, DWORD * pSizeHigh )
+{
+    struct stat status;
+    if ( 0 != fstat( static_cast<LINUX_FILE *>(hFile)->fd, &status ) )
+    {
+        SetLastError( LinuxErrorFromErrno( errno ) );
+        return INVALID_FILE_SIZE;
+    }
+
+    if ( pSizeHigh )
+    {
+        *pSizeHigh = static_cast<DWORD>(static_cast<ULONGLONG>(status.st_size) >> 32);
+    }
+    return static_cast<DWORD>(status.st_size);
+}
+
+inline BOOL DeleteFileW( LPCWSTR szFileName )
+{
+    char szPath[4 * MAX_PATH];
+    if ( 0 == LinuxPath( szFileName, szPath, sizeof(szPath) ) || 0 != unlink( szPath ) )
+    {
+        SetLastError( LinuxErrorFromErrno( errno ) );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// The temporary directory, ending in a slash
+inline DWORD GetTempPathW( DWORD cchBuffer, LPWSTR szBuffer )
+{
+    const char * szDirectory = getenv( "TMPDIR" );
+    if ( NULL == szDirectory || 0 == *szDirectory )
+    {
+        szDirectory = "/tmp";
+    }
+
+    size_t cch = mbstowcs( NULL, szDirectory, 0 );
+    bool bSlash = '/' == szDirectory[strlen( szDirectory ) - 1];
+    DWORD cchNeeded = static_cast<DWORD>(cch + ( bSlash ? 0 : 1 ));
+    if ( static_cast<size_t>(-1) == cch || cchNeeded + 1 > cchBuffer )
+    {
+        return ( static_cast<size_t>(-1) == cch ) ? 0 : cchNeeded + 1;
+    }
+
+    mbstowcs( szBuffer, szDirectory, cchBuffer );
+    if ( !bSlash )
+    {
+        szBuffer[cch] = L'/';
+        szBuffer[cch + 1] = 0;
+    }
+    return cchNeeded;
+}
+
+//------------------------------------------------------------------------------
+// Shared memory
+//
+// A named mapping is a POSIX shared memory object of the same name, removed
+// when the handle that created it is closed; views stay mapped until unmapped.
+
+#define PAGE_READONLY               0x02
+#define PAGE_READWRITE              0x04
+#define FILE_MAP_WRITE              0x0002
+#define FILE_MAP_READ               0x0004
+#define FILE_MAP_ALL_ACCESS         0x000F001F
+
+struct LINUX_MAPPING : LINUX_HANDLE
+{
+    int         fd;
+    bool        bCreated;
+    char        szName[MAX_PATH];
+};
+
+struct LINUX_VIEW
+{
+    void *          pView;
+    size_t          cbView;
+    LINUX_VIEW *    pNext;
+};
+
+inline LINUX_VIEW *& LinuxViews( )
+{
+    static LINUX_VIEW * pViews = NULL;
+    return pViews;
+}
+
+inline bool LinuxMappingName( LPCWSTR szName, char * szShared, size_t cbShared )
+{
+    szShared[0] = '/';
+    if ( 0 == LinuxPath( szName, szShared + 1, cbShared - 1 ) )
+    {
+        return false;
+    }
+
+    // Global\ and Local\ namespaces and backslashes aren't in POSIX names
+    for ( char * p = szShared + 1; *p; ++p )
+    {
+        if ( '\\' == *p || '/' == *p )
+        {
+            *p = '_';
+        }
+    }
+    return true;
+}
+
+inline void LinuxCloseMapping( LINUX_HANDLE * pHandle )
+{
+    LINUX_MAPPING * pMapping = static_cast<LINUX_MAPPING *>(pHandle);
+
+    close( pMapping->fd );
+    if ( pMapping->bCreated && pMapping->szName[0] )
+    {
+        shm_unlink( pMapping->szName );
+    }
+    delete pMapping;
+}
+
+inline LINUX_MAPPING * LinuxCreateMapping( bool bCreated )
+{
+    LINUX_MAPPING * pMapping = new LINUX_MAPPING;
+    pMapping->kind = LINUX_HANDLE_MAPPING;
+    pMapping->cReferences = 1;
+    pMapping->pfnClose = LinuxCloseMapping;
+    pMapping->fd = -1;
+    pMapping->bCreated = bCreated;
+    pMapping->szName[0] = 0;
+    return pMapping;
+}
+
+inline HANDLE CreateFileMappingW( HANDLE hFile, LPSECURITY_ATTRIBUTES, DWORD, DWORD dwSizeHigh, DWORD dwSizeLow, LPCWSTR szName )
+{
+    LINUX_MAPPING * pMapping = LinuxCreateMapping( true );
+
+    if ( INVALID_HANDLE_VALUE != hFile || (NULL != szName && !LinuxMappingName( szName, pMapping->szName, sizeof(pMapping->szName) )) )
+    {
+        delete pMapping;
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return NULL;
+    }
+
+    DWORD error = ERROR_SUCCESS;
+    if ( 0 == pMapping->szName[0] )
+    {
+        pMapping->fd = memfd_create( "mapping", MFD_CLOEXEC );
+    }
+    else
+    {
+        pMapping->fd = shm_open( pMapping->szName, O_RDWR | O_CREAT | O_EXCL, 0600 );
+        if ( pMapping->fd < 0 && EEXIST == errno )
+        {
+            // An existing mapping is opened, and reported as already there
+            pMapping->fd = shm_open( pMapping->szName, O_RDWR, 0600 );
+            pMapping->bCreated = false;
+            error = ERROR_ALREADY_EXISTS;
+        }
+    }
+
+    off_t cbMapping = static_cast<off_t>((static_cast<ULONGLONG>(dwSizeHigh) << 32) | dwSizeLow);
+    if ( pMapping->fd < 0 || (pMapping->bCreated && 0 != ftruncate( pMapping->fd, cbMapping )) )
+    {
+        error = LinuxErrorFromErrno( errno );
+        if ( pMapping->fd >= 0 )
+        {
+            close( pMapping->fd );
+            shm_unlink( pMapping->szName );
+        }
+        delete pMapping;
+        SetLastError( error );
+        return NULL;
+    }
+
+    SetLastError( error );
+    return pMapping;
+}
+
+inline HANDLE OpenFileMappingW( DWORD dwAccess, BOOL, LPCWSTR szName )
+{
+    LINUX_MAPPING * pMapping = LinuxCreateMapping( false );
+
+    if ( NULL == szName || !LinuxMappingName( szName, pMapping->szName, sizeof(pMapping->szName) ) )
+    {
+        delete pMapping;
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return NULL;
+    }
+
+    pMapping->fd = shm_open( pMapping->szName, (dwAccess & FILE_MAP_WRITE) ? O_RDWR : O_RDONLY, 0600 );
+    if ( pMapping->fd < 0 )
+    {
+        delete pMapping;
+        SetLastError( LinuxErrorFromErrno( errno ) );
+        return NULL;
+    }
+
+    return pMapping;
+}
+
+inline LPVOID MapViewOfFile( HANDLE hMapping, DWORD dwAccess, DWORD dwOffsetHigh, DWORD dwOffsetLow, SIZE_T cbView )
+{
+    LINUX_MAPPING * pMapping = static_cast<LINUX_MAPPING *>(hMapping);
+    off_t offset = static_cast<off_t>((static_cast<ULONGLONG>(dwOffsetHigh) << 32) | dwOffsetLow);
+
+    if ( 0 == cbView )
+    {
+        struct stat status;
+        if ( 0 != fstat( pMapping->fd, &status ) )
+        {
+            SetLastError( LinuxErrorFromErrno( errno ) );
+            return NULL;
+        }
+        cbView = static_cast<SIZE_T>(status.st_size - offset);
+    }
+
+    int protection = (dwAccess & FILE_MAP_WRITE) ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void * pView = mmap( NULL, cbView, protection, MAP_SHARED, pMapping->fd, offset );
+    if ( MAP_FAILED == pView )
+    {
+        SetLastError( LinuxErrorFromErrno( errno ) );
+        return NULL;
+    }
+
+    LINUX_VIEW * pEntry = new LINUX_VIEW;
+    pEntry->pView = pView;
+    pEntry->cbView = cbView;
+
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+    pthread_mutex_lock( &state.lock );
+    pEntry->pNext = LinuxViews( );
+    LinuxViews( ) = pEntry;
+    pthread_mutex_unlock( &state.lock );
+
+    return pView;
+}
+
+inline BOOL UnmapViewOfFile( LPCVOID pView )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+    LINUX_VIEW * pEntry = NULL;
+
+    pthread_mutex_lock( &state.lock );
+    for ( LINUX_VIEW ** ppEntry = &LinuxViews( ); *ppEntry; ppEntry = &(*ppEntry)->pNext )
+    {
+        if ( (*ppEntry)->pView == pView )
+        {
+            pEntry = *ppEntry;
+            *ppEntry = pEntry->pNext;
+            break;
+        }
+    }
+    pthread_mutex_unlock( &state.lock );
+
+    if ( NULL == pEntry )
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+        return FALSE;
+    }
+
+    munmap( pEntry->pView, pEntry->cbView );
+    delete pEntry;
+    return TRUE;
+}
+
+// Only views are known to it; the region runs from the address to the end of the view's pages
+typedef struct _MEMORY_BASIC_INFORMATION
+{
+    LPVOID      BaseAddress;
+    LPVOID      AllocationBase;
+    DWORD       AllocationProtect;
+    SIZE_T      RegionSize;
+    DWORD       State;
+    DWORD       Protect;
+    DWORD       Type;
+} MEMORY_BASIC_INFORMATION;
+
+#define MEM_COMMIT                  0x00001000
+#define MEM_MAPPED                  0x00040000
+
+inline SIZE_T VirtualQuery( LPCVOID pAddress, MEMORY_BASIC_INFORMATION * pInfo, SIZE_T cbInfo )
+{
+    LINUX_WAIT_STATE & state = LinuxWaitState( );
+    SIZE_T cbPage = static_cast<SIZE_T>(sysconf( _SC_PAGESIZE ));
+    const BYTE * p = static_cast<const BYTE *>(pAddress);
+    SIZE_T cbReturned = 0;
+
+    pthread_mutex_lock( &state.lock );
+    for ( LINUX_VIEW * pEntry = LinuxViews( ); pEntry && cbInfo >= sizeof(*pInfo); pEntry = pEntry->pNext )
+    {
+        BYTE * pBase = static_cast<BYTE *>(pEntry->pView);
+        SIZE_T cbPages = (pEntry->cbView + cbPage - 1) / cbPage * cbPage;
+        if ( p >= pBase && p < pBase + cbPages )
+        {
+            ZeroMemory( pInfo, sizeof(*pInfo) );
+            pInfo->BaseAddress = pBase + (p - pBase) / cbPage * cbPage;
+            pInfo->AllocationBase = pBase;
+            pInfo->RegionSize = pBase + cbPages - static_cast<BYTE *>(pInfo->BaseAddress);
+            pInfo->State = MEM_COMMIT;
+            pInfo->Type = MEM_MAPPED;
+            cbReturned = sizeof(*pInfo);
+            break;
+        }
+    }
+    pthread_mutex_unlock( &state.lock );
+
+    if ( 0 == cbReturned )
+    {
+        SetLastError( ERROR_INVALID_PARAMETER );
+    }
+    return cbReturned;
+}
+
+//------------------------------------------------------------------------------
+// Closing handles
+
+inline BOOL CloseHandle( HANDLE hObject )
+{
+    if ( NULL == hObject || INVALID_HANDLE_VALUE == hObject )
+    {
+        SetLastError( ERROR_INVALID_HANDLE );
+        return FALSE;
+    }
+
+    LINUX_HANDLE * pHandle = static_cast<LINUX_HANDLE *>(hObject);
+    pHandle->pfnClose( pHandle );
+
+    return TRUE;
+}
+
+//------------------------------------------------------------------------------
+// GDI
+//
+// There are no bitmaps to load, so callers take their fallback.
+
+typedef void * HBITMAP;
+typedef void * HDC;
+typedef void * HGDIOBJ;
+
+typedef struct tagBITMAPINFOHEADER
+{
+    DWORD   biSize;
+    LONG    biWidth;
+    LONG    biHeight;
+    WORD    biPlanes;
+    WORD    biBitCount;
+    DWORD   biCompression;
+    DWORD   biSizeImage;
+    LONG    biXPelsPerMeter;
+    LONG    biYPelsPerMeter;
+    DWORD   biClrUsed;
+    DWORD   biClrImportant;
+} BITMAPINFOHEADER;
+
+typedef struct tagBITMAPINFO
+{
+    BITMAPINFOHEADER    bmiHeader;
+    DWORD               bmiColors[1];
+} BITMAPINFO;
+
+#define BI_RGB                      0
+#define DIB_RGB_COLORS              0
+#define IMAGE_BITMAP                0
+#define LR_LOADFROMFILE             0x00000010
+#define LR_CREATEDIBSECTION         0x00002000
+
+inline HANDLE LoadImageW( HINSTANCE, LPCWSTR, UINT, int, int, UINT )
+{
+    SetLastError( ERROR_FILE_NOT_FOUND );
+    return NULL;
+}
+
+inline HDC GetDC( HWND )
+{
+    return NULL;
+}
+
+inline int ReleaseDC( HWND, HDC )
+{
+    return 1;
+}
+
+inline int GetDIBits( HDC, HBITMAP, UINT, UINT, LPVOID, BITMAPINFO *, UINT )
+{
+    return 0;
+}
+
+inline BOOL DeleteObject( HGDIOBJ )
+{
+    return TRUE;
+}
@@ -0,0 +1,62 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="winsock2.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Stand-in for Winsock on BSD sockets.  A SOCKET is a descriptor, startup and
+// cleanup have nothing to do, and the last error is errno.
+
+#pragma once
+
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef int                 SOCKET;
+
+#define INVALID_SOCKET      (-1)
+#define SOCKET_ERROR        (-1)
+
+typedef struct WSAData
+{
+    WORD    wVersion;
+    WORD    wHighVersion;
+} WSADATA;
+
+inline int WSAStartup( WORD wVersionRequested, WSADATA * pData )
+{
+    pData->wVersion = wVersionRequested;
+    pData->wHighVersion = wVersionRequested;
+    return 0;
+}
+
+inline int WSACleanup( )
+{
+    return 0;
+}
+
+inline int WSAGetLastError( )
+{
+    return errno;
+}
+
+inline int closesocket( SOCKET s )
+{
+    return close( s );
+}
+
+// Winsock takes an int for the length of an address
+inline int LinuxGetSockName( SOCKET s, sockaddr * pAddress, int * pcbAddress )
+{
+    socklen_t cbAddress = static_cast<socklen_t>(*pcbAddress);
+    int result = getsockname( s, pAddress, &cbAddress );
+    *pcbAddress = static_cast<int>(cbAddress);
+    return result;
+}
+
+#define getsockname         LinuxGetSockName
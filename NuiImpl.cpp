@@ -13,11 +13,6 @@
 #include <assert.h>
 #include <strsafe.h>
 
-//lookups for color tinting based on player index
-static const int g_IntensityShiftByPlayerR[] = { 1, 2, 0, 2, 0, 0, 2, 0 };
-static const int g_IntensityShiftByPlayerG[] = { 1, 2, 2, 0, 2, 0, 0, 1 };
-static const int g_IntensityShiftByPlayerB[] = { 1, 0, 2, 2, 0, 2, 0, 2 };
-
 static const float g_JointThickness = 3.0f;
 static const float g_TrackedBoneThickness = 6.0f;
 static const float g_InferredBoneThickness = 1.0f;
@@ -34,9 +29,36 @@ enum _SV_TRACKED_SKELETONS
     SV_TRACKED_SKELETONS_NEAREST1,
     SV_TRACKED_SKELETONS_NEAREST2,
     SV_TRACKED_SKELETONS_STICKY1,
-    SV_TRACKED_SKELETONS_STICKY2
+    SV_TRACKED_SKELETONS_STICKY2,
+    SV_TRACKED_SKELETONS_ZONE1,
+    SV_TRACKED_SKELETONS_ZONE2,
+    SV_TRACKED_SKELETONS_ACTIVE1,
+    SV_TRACKED_SKELETONS_ACTIVE2,
+    SV_TRACKED_SKELETONS_LONGEST1,
+    SV_TRACKED_SKELETONS_LONGEST2,
+    SV_TRACKED_SKELETONS_COUNT
 } SV_TRACKED_SKELETONS;
 
+// Selection policy and number of skeletons of each tracked skeletons choice
+static const struct
+{
+    SKELETON_SELECTION_POLICY   policy;
+    UINT                        count;
+} g_TrackedSkeletonsPolicies[SV_TRACKED_SKELETONS_COUNT] =
+{
+    { SKELETON_SELECT_NEAREST,          0 },    // default, the sensor picks
+    { SKELETON_SELECT_NEAREST,          1 },
+    { SKELETON_SELECT_NEAREST,          2 },
+    { SKELETON_SELECT_STICKY,           1 },
+    { SKELETON_SELECT_STICKY,           2 },
+    { SKELETON_SELECT_ZONE_CENTER,      1 },
+    { SKELETON_SELECT_ZONE_CENTER,      2 },
+    { SKELETON_SELECT_MOST_ACTIVE,      1 },
+    { SKELETON_SELECT_MOST_ACTIVE,      2 },
+    { SKELETON_SELECT_LONGEST_PRESENT,  1 },
+    { SKELETON_SELECT_LONGEST_PRESENT,  2 },
+};
+
 enum _SV_TRACKING_MODE
 {
     SV_TRACKING_MODE_DEFAULT = 0,
@@ -48,6 +70,20 @@ enum _SV_RANGE
     SV_RANGE_DEFAULT = 0,
     SV_RANGE_NEAR,
 } SV_RANGE;
+
+enum _SV_COLOR_VIEW
+{
+    SV_COLOR_VIEW_COLOR = 0,
+    SV_COLOR_VIEW_GREEN_SCREEN,
+    SV_COLOR_VIEW_INFRARED,
+} SV_COLOR_VIEW;
+
+enum _SV_DEPTH_VIEW
+{
+    SV_DEPTH_VIEW_DEPTH = 0,
+    SV_DEPTH_VIEW_AUTO_CONTRAST,
+} SV_DEPTH_VIEW;
+
 /// <summary>
 /// Zero out member variables
 /// </summary>
@@ -76,10 +112,45 @@ void CSkeletalViewerApp::Nui_Zero()
     m_LastDepthFramesTotal = 0;
     m_pDrawDepth = NULL;
     m_pDrawColor = NULL;
+    m_pSkeletonPublisher = NULL;
+    m_pDepthChannel = NULL;
+    m_pColorChannel = NULL;
+    m_pDepthRGBXChannel = NULL;
+    m_pPlayerMaskChannel = NULL;
+    m_pPointCloud = NULL;
+    m_pRegistration = NULL;
+    m_pLatestColor = NULL;
+    m_pSegmentation = NULL;
+    m_ColorView = SV_COLOR_VIEW_COLOR;
+    m_pGreenScreen = NULL;
+    m_pTemporalFilter = NULL;
+    m_pSpatialFilter = NULL;
+    m_pParallelRows = NULL;
+    m_DepthView = SV_DEPTH_VIEW_DEPTH;
+    m_pDepthHistogram = NULL;
+    m_pDepthKernel = NULL;
+    m_pInfraredToneMap = NULL;
+    m_pGestureEngine = NULL;
+    m_pSkeletonKinematics = NULL;
+    m_pJointPredictor = NULL;
+    m_pSkeletonSelector = NULL;
+    m_pZoneEngine = NULL;
+    m_pFloorEstimator = NULL;
+    m_cFloorHeights = 0;
+    m_pHandAnalyzer = NULL;
+    m_pTaskScheduler = NULL;
+    m_pFrameSource = NULL;
+    m_pDepthRecorder = NULL;
+    for ( int i = 0; i < SV_DEPTH_STAGE_COUNT; ++i )
+    {
+        m_DepthTasks[i].pApp = this;
+        m_DepthTasks[i].stage = i;
+    }
     m_TrackedSkeletons = 0;
+    m_SelectedTrackedSkeletons = 0;
+    m_SelectedTrackingFlags = 0;
     m_SkeletonTrackingFlags = NUI_SKELETON_TRACKING_FLAG_ENABLE_IN_NEAR_RANGE;
     m_DepthStreamFlags = 0;
-    ZeroMemory(m_StickySkeletonIds,sizeof(m_StickySkeletonIds));
 }
 
 /// <summary>
@@ -102,29 +173,46 @@ void CALLBACK CSkeletalViewerApp::Nui_StatusProcThunk( HRESULT hrStatus, const O
 /// <param name="uniqueDeviceName">unique device name of Kinect the status change is for</param>
 void CALLBACK CSkeletalViewerApp::Nui_StatusProc( HRESULT hrStatus, const OLECHAR* instanceName, const OLECHAR* uniqueDeviceName )
 {
-    // Update UI
-    PostMessageW( m_hWnd, WM_USER_UPDATE_COMBO, 0, 0 );
+    // Invalidate the cached sensor list; a burst of status changes only needs one refresh
+    if ( 0 == InterlockedExchange( &m_SensorListStale, TRUE ) )
+    {
+        PostMessageW( m_hWnd, WM_USER_UPDATE_COMBO, 0, 0 );
+    }
+
+    // This is the status callback thread, so the sensor is only looked at under the
+    // sensor lock, and anything that needs the UI thread, errors included, is posted to it
+    EnterCriticalSection( &m_csNuiSensor );
+    bool bOurSensor = m_instanceId && 0 == wcscmp(instanceName, m_instanceId);
+    bool bNoSensor = ( NULL == m_pNuiSensor );
+    bool bPipelineRunning = ( NULL != m_hThNuiProcess );
+    LeaveCriticalSection( &m_csNuiSensor );
 
     if( SUCCEEDED(hrStatus) )
     {
-        if ( S_OK == hrStatus )
+        if ( S_OK == hrStatus && (bOurSensor || bNoSensor) )
         {
-            if ( m_instanceId && 0 == wcscmp(instanceName, m_instanceId) )
+            // If the pipeline survived the disconnect, our sensor coming back or
+            // another arriving only needs the sensor acquired and its streams opened
+            if ( bPipelineRunning )
             {
-                Nui_Init(m_instanceId);
+                UINT errorId;
+                if ( FAILED(m_pSensorConnection->Reconnect( instanceName, errorId )) && 0 != errorId )
+                {
+                    PostMessageW( m_hWnd, WM_USER_SHOW_ERROR, errorId, 0 );
+                }
             }
-            else if ( !m_pNuiSensor )
+            else
             {
-                Nui_Init();
+                // Building the pipeline creates the Direct2D resources, which belong to the UI thread
+                PostMessageW( m_hWnd, WM_USER_NUI_INIT, bOurSensor, 0 );
             }
         }
     }
     else
     {
-        if ( m_instanceId && 0 == wcscmp(instanceName, m_instanceId) )
+        if ( bOurSensor )
         {
-            Nui_UnInit();
-            Nui_Zero();
+            m_pSensorConnection->Disconnect();
         }
     }
 }
@@ -143,7 +231,9 @@ HRESULT CSkeletalViewerApp::Nui_Init( OLECHAR *instanceName )
         return E_FAIL;
     }
 
-    HRESULT hr = NuiCreateSensorById( instanceName, &m_pNuiSensor );
+    EnterCriticalSection( &m_csNuiSensor );
+    HRESULT hr = AcquireSensor( instanceName );
+    LeaveCriticalSection( &m_csNuiSensor );
     
     // Generic creation failure
     if ( FAILED(hr) )
@@ -152,10 +242,6 @@ HRESULT CSkeletalViewerApp::Nui_Init( OLECHAR *instanceName )
         return hr;
     }
 
-    SysFreeString(m_instanceId);
-
-    m_instanceId = m_pNuiSensor->NuiDeviceConnectionId();
-
     return Nui_Init();
 }
 
@@ -165,31 +251,136 @@ HRESULT CSkeletalViewerApp::Nui_Init( OLECHAR *instanceName )
 /// <returns>S_OK if successful, otherwise an error code</returns>
 HRESULT CSkeletalViewerApp::Nui_Init( )
 {
-    HRESULT  hr;
-    bool     result;
+    HRESULT  hr = S_OK;
 
+    // The status callback may be acquiring a sensor at the same time
+    EnterCriticalSection( &m_csNuiSensor );
     if ( !m_pNuiSensor )
     {
-        hr = NuiCreateSensorByIndex(0, &m_pNuiSensor);
+        INuiSensor * pNuiSensor = NULL;
+        hr = NuiCreateSensorByIndex(0, &pNuiSensor);
 
-        if ( FAILED(hr) )
+        if ( SUCCEEDED(hr) )
         {
-            return hr;
-        }
+            m_pNuiSensor = pNuiSensor;
 
-        SysFreeString(m_instanceId);
+            SysFreeString(m_instanceId);
 
-        m_instanceId = m_pNuiSensor->NuiDeviceConnectionId();
+            m_instanceId = m_pNuiSensor->NuiDeviceConnectionId();
+        }
     }
+    LeaveCriticalSection( &m_csNuiSensor );
 
-    m_hNextDepthFrameEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
-    m_hNextColorFrameEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
-    m_hNextSkeletonEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
 
     // reset the tracked skeletons, range, and tracking mode
     SendDlgItemMessage(m_hWnd, IDC_TRACKEDSKELETONS, CB_SETCURSEL, 0, 0);
     SendDlgItemMessage(m_hWnd, IDC_TRACKINGMODE, CB_SETCURSEL, 0, 0);
     SendDlgItemMessage(m_hWnd, IDC_RANGE, CB_SETCURSEL, 0, 0);
+    SendDlgItemMessage(m_hWnd, IDC_COLORVIEW, CB_SETCURSEL, 0, 0);
+    SendDlgItemMessage(m_hWnd, IDC_DEPTHVIEW, CB_SETCURSEL, 0, 0);
+
+    // The stream opens signal these, so they must exist before the sensor starts
+    Nui_CreateEvents();
+
+    // Sensor bring-up is dominated by USB round trips, overlap it with
+    // creating the draw devices and render targets on this thread
+    m_hrOpenStreams = E_PENDING;
+    m_OpenStreamsErrorId = 0;
+    HANDLE hThOpenStreams = CreateThread( NULL, 0, Nui_OpenStreamsThread, this, 0, NULL );
+    if ( NULL == hThOpenStreams )
+    {
+        Nui_OpenStreamsThread( );
+    }
+
+    hr = Nui_CreatePipeline();
+
+    if ( NULL != hThOpenStreams )
+    {
+        WaitForSingleObject( hThOpenStreams, INFINITE );
+        CloseHandle( hThOpenStreams );
+    }
+
+    if ( FAILED( hr ) )
+    {
+        return hr;
+    }
+
+    if ( FAILED( m_hrOpenStreams ) )
+    {
+        MessageBoxResource( m_OpenStreamsErrorId, MB_OK | MB_ICONHAND );
+    }
+
+    return m_hrOpenStreams;
+}
+
+/// <summary>
+/// Thread to open sensor streams during startup, calls class instance thread processor
+/// </summary>
+/// <param name="pParam">instance pointer</param>
+/// <returns>always 0</returns>
+DWORD WINAPI CSkeletalViewerApp::Nui_OpenStreamsThread( LPVOID pParam )
+{
+    CSkeletalViewerApp *pthis = (CSkeletalViewerApp *)pParam;
+    return pthis->Nui_OpenStreamsThread( );
+}
+
+/// <summary>
+/// Thread to open sensor streams during startup
+/// Result is left in m_hrOpenStreams and m_OpenStreamsErrorId
+/// </summary>
+/// <returns>always 0</returns>
+DWORD WINAPI CSkeletalViewerApp::Nui_OpenStreamsThread( )
+{
+    UINT errorId;
+
+    EnterCriticalSection( &m_csNuiSensor );
+    HRESULT hr = Nui_OpenStreams( errorId );
+    LeaveCriticalSection( &m_csNuiSensor );
+
+    m_OpenStreamsErrorId = errorId;
+    m_hrOpenStreams = hr;
+
+    return 0;
+}
+
+/// <summary>
+/// Create the frame events signalled by the sensor, if not already created
+/// </summary>
+void CSkeletalViewerApp::Nui_CreateEvents( )
+{
+    if ( NULL == m_hNextDepthFrameEvent )
+    {
+        m_hNextDepthFrameEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+    }
+    if ( NULL == m_hNextColorFrameEvent )
+    {
+        m_hNextColorFrameEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+    }
+    if ( NULL == m_hNextSkeletonEvent )
+    {
+        m_hNextSkeletonEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+    }
+}
+
+/// <summary>
+/// Create draw devices, Direct2D resources and the processing thread, if not already created
+/// </summary>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT CSkeletalViewerApp::Nui_CreatePipeline( )
+{
+    bool result;
+
+    // The pipeline outlives the sensor across hot-plug, nothing to do if it is running
+    if ( NULL != m_hThNuiProcess )
+    {
+        return S_OK;
+    }
+
+    Nui_CreateEvents();
 
     EnsureDirect2DResources();
 
@@ -208,7 +399,524 @@ HRESULT CSkeletalViewerApp::Nui_Init( )
         MessageBoxResource( IDS_ERROR_DRAWDEVICE, MB_OK | MB_ICONHAND );
         return E_FAIL;
     }
-    
+
+    // Publishing is optional, carry on without it if the ring can't be created
+    if ( m_PipelineFlags & SV_PIPELINE_PUBLISH_SKELETONS )
+    {
+        m_pSkeletonPublisher = new SkeletonPublisher( );
+        if ( FAILED( m_pSkeletonPublisher->Initialize( ) ) )
+        {
+            MessageBoxResource( IDS_ERROR_PUBLISH, MB_OK | MB_ICONHAND );
+            delete m_pSkeletonPublisher;
+            m_pSkeletonPublisher = NULL;
+        }
+        else
+        {
+            // A port that can't be sent to only loses its datagrams
+            for ( UINT i = 0; i < m_cSkeletonUdpSubscribers; ++i )
+            {
+                m_pSkeletonPublisher->AddUdpSubscriber( m_SkeletonUdpSubscribers[i] );
+            }
+        }
+    }
+
+    // Image sharing is optional as well
+    if ( m_PipelineFlags & SV_PIPELINE_SHARE_IMAGES )
+    {
+        HRESULT hr;
+
+        m_pDepthChannel = new ImageChannelWriter( );
+        hr = m_pDepthChannel->Create( IMAGE_CHANNEL_DEPTH_NAME, 640 * 480 * sizeof(USHORT) );
+
+        if ( SUCCEEDED( hr ) )
+        {
+            m_pColorChannel = new ImageChannelWriter( );
+            hr = m_pColorChannel->Create( IMAGE_CHANNEL_COLOR_NAME, 640 * 480 * g_BytesPerPixel );
+        }
+
+        if ( SUCCEEDED( hr ) && (m_PipelineFlags & SV_PIPELINE_SHARE_DEPTH_RGBX) )
+        {
+            m_pDepthRGBXChannel = new ImageChannelWriter( );
+            hr = m_pDepthRGBXChannel->Create( IMAGE_CHANNEL_DEPTH_RGBX_NAME, sizeof(m_depthRGBX) );
+        }
+
+        if ( SUCCEEDED( hr ) && (m_PipelineFlags & SV_PIPELINE_SEGMENT_PLAYERS) )
+        {
+            m_pPlayerMaskChannel = new ImageChannelWriter( );
+            hr = m_pPlayerMaskChannel->Create( IMAGE_CHANNEL_PLAYER_MASKS_NAME, PlayerSegmentation::GetMaxPackedSize( 640, 480 ) );
+        }
+
+        if ( FAILED( hr ) )
+        {
+            MessageBoxResource( IDS_ERROR_IMAGECHANNEL, MB_OK | MB_ICONHAND );
+            Nui_DeleteImageChannels( );
+        }
+    }
+
+    // Point buffers and registration tables are allocated once the depth resolution is known
+    if ( m_PipelineFlags & SV_PIPELINE_POINT_CLOUD )
+    {
+        m_pPointCloud = new PointCloud( );
+        m_pRegistration = new RegistrationMap( );
+        m_pLatestColor = new BYTE[640 * 480 * g_BytesPerPixel];
+        ZeroMemory( m_pLatestColor, 640 * 480 * g_BytesPerPixel );
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_SEGMENT_PLAYERS )
+    {
+        m_pSegmentation = new PlayerSegmentation( );
+    }
+
+    // The history is allocated once the depth resolution is known
+    if ( m_PipelineFlags & SV_PIPELINE_TEMPORAL_FILTER )
+    {
+        m_pTemporalFilter = new TemporalDepthFilter( );
+        m_pTemporalFilter->SetMode( m_TemporalFilterMode, true );
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_SPATIAL_FILTER )
+    {
+        m_pSpatialFilter = new SpatialDepthFilter( );
+
+        // The color guide is the newest color frame, registered to depth
+        if ( m_bSpatialFilterGuided )
+        {
+            if ( NULL == m_pRegistration )
+            {
+                m_pRegistration = new RegistrationMap( );
+            }
+
+            if ( NULL == m_pLatestColor )
+            {
+                m_pLatestColor = new BYTE[640 * 480 * g_BytesPerPixel];
+                ZeroMemory( m_pLatestColor, 640 * 480 * g_BytesPerPixel );
+            }
+        }
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_GESTURES )
+    {
+        m_pGestureEngine = new GestureEngine( );
+        m_pGestureEngine->AddDefaultTemplates( );
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_KINEMATICS )
+    {
+        m_pSkeletonKinematics = new SkeletonKinematics( );
+    }
+
+    // Prediction works from the positions and history the kinematics keep
+    if ( m_PipelineFlags & (SV_PIPELINE_PREDICT_VIEW | SV_PIPELINE_PREDICT_PUBLISHED) )
+    {
+        m_pJointPredictor = new JointPredictor( );
+        m_pJointPredictor->SetHorizon( m_PredictionHorizon );
+
+        if ( NULL == m_pSkeletonKinematics )
+        {
+            m_pSkeletonKinematics = new SkeletonKinematics( );
+        }
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_ZONES )
+    {
+        m_pZoneEngine = new ZoneEngine( );
+
+        WCHAR szReport[MAX_PATH + 64];
+        int cZones = m_pZoneEngine->LoadZones( m_szZoneFile );
+        if ( cZones < 0 )
+        {
+            StringCchPrintfW( szReport, _countof(szReport), L"Zones: could not read %s\r\n", m_szZoneFile );
+        }
+        else
+        {
+            StringCchPrintfW( szReport, _countof(szReport), L"Zones: %d zones from %s\r\n", cZones, m_szZoneFile );
+        }
+        OutputDebugString( szReport );
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_FLOOR )
+    {
+        m_pFloorEstimator = new FloorEstimator( );
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_HANDS )
+    {
+        m_pHandAnalyzer = new HandAnalyzer( );
+    }
+
+    if ( m_PipelineFlags & SV_PIPELINE_SYNC )
+    {
+        m_pFrameSource = new FrameSource( );
+        if ( m_pFrameSource->Start( ) )
+        {
+            m_pFrameSource->AddConsumer( Nui_SyncConsumer, NULL );
+        }
+    }
+
+    // Recording is optional as well, carry on without it if the file can't be created
+    if ( m_PipelineFlags & SV_PIPELINE_RECORD_DEPTH )
+    {
+        m_pDepthRecorder = new DepthRecorder( );
+        if ( FAILED( m_pDepthRecorder->Create( m_szRecordFile ) ) )
+        {
+            WCHAR szReport[MAX_PATH + 64];
+            StringCchPrintfW( szReport, _countof(szReport), L"Recording: could not create %s\r\n", m_szRecordFile );
+            OutputDebugString( szReport );
+
+            delete m_pDepthRecorder;
+            m_pDepthRecorder = NULL;
+        }
+    }
+
+    // Threads only pay off with stages that can run alongside the depth kernel, or filters
+    // split into bands, otherwise the graph runs inline.  Fewer threads than asked for is
+    // fine, the processing thread always works
+    if ( m_PipelineFlags & (SV_PIPELINE_SHARE_IMAGES | SV_PIPELINE_FLOOR | SV_PIPELINE_HANDS | SV_PIPELINE_SYNC | SV_PIPELINE_RECORD_DEPTH |
+                            SV_PIPELINE_TEMPORAL_FILTER | SV_PIPELINE_SPATIAL_FILTER) )
+    {
+        m_pTaskScheduler = new TaskScheduler( );
+        m_pTaskScheduler->Start( 0 );
+    }
+
+    // Small enough to always have, the depth view can be switched at any time
+    m_pDepthHistogram = new DepthHistogram( );
+    m_pDepthKernel = new DepthKernel( );
+    m_pInfraredToneMap = new InfraredToneMap( );
+    m_pSkeletonSelector = new SkeletonSelector( );
+    m_SelectedTrackedSkeletons = SV_TRACKED_SKELETONS_DEFAULT;
+
+    // The filters run on the processing thread before the depth stages, so their bands share the scheduler
+    if ( m_PipelineFlags & (SV_PIPELINE_TEMPORAL_FILTER | SV_PIPELINE_SPATIAL_FILTER) )
+    {
+        m_pParallelRows = new ParallelRows( *m_pTaskScheduler );
+    }
+
+    // Start the Nui processing thread; the status callback reconnects once it is running
+    m_hEvNuiProcessStop = CreateEvent( NULL, FALSE, FALSE, NULL );
+    HANDLE hThNuiProcess = CreateThread( NULL, 0, Nui_ProcessThread, this, 0, NULL );
+
+    EnterCriticalSection( &m_csNuiSensor );
+    m_hThNuiProcess = hThNuiProcess;
+    LeaveCriticalSection( &m_csNuiSensor );
+
+    return S_OK;
+}
+
+/// <summary>
+/// Stop sharing images with other processes
+/// </summary>
+void CSkeletalViewerApp::Nui_DeleteImageChannels( )
+{
+    delete m_pDepthChannel;
+    m_pDepthChannel = NULL;
+
+    delete m_pColorChannel;
+    m_pColorChannel = NULL;
+
+    delete m_pDepthRGBXChannel;
+    m_pDepthRGBXChannel = NULL;
+
+    delete m_pPlayerMaskChannel;
+    m_pPlayerMaskChannel = NULL;
+}
+
+/// <summary>
+/// Create the stages the green screen color view needs, on the processing thread
+/// </summary>
+/// <returns>true if the green screen can be shown, false otherwise</returns>
+bool CSkeletalViewerApp::Nui_EnsureGreenScreen( )
+{
+    if ( m_pGreenScreen )
+    {
+        return true;
+    }
+
+    // Created on first use, the view can be picked at any time
+    if ( NULL == m_pSegmentation )
+    {
+        m_pSegmentation = new PlayerSegmentation( );
+    }
+
+    if ( NULL == m_pRegistration )
+    {
+        m_pRegistration = new RegistrationMap( );
+    }
+
+    m_pGreenScreen = new GreenScreen( );
+    if ( !m_pGreenScreen->Initialize( 640, 480 ) )
+    {
+        delete m_pGreenScreen;
+        m_pGreenScreen = NULL;
+        return false;
+    }
+
+    if ( 0 != m_szBackgroundFile[0] && !m_pGreenScreen->LoadBackground( m_szBackgroundFile ) )
+    {
+        OutputDebugString( L"Green screen: could not load the background, using the default\r\n" );
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Move every joint of a frame through the zones and report the ones entered and left
+/// </summary>
+/// <param name="frame">skeleton frame, with no skeletons when everyone has left</param>
+void CSkeletalViewerApp::Nui_UpdateZones( const NUI_SKELETON_FRAME & frame )
+{
+    // Room for every joint of every skeleton to cross a few zones at once
+    ZONE_EVENT events[NUI_SKELETON_MAX_TRACKED_COUNT * NUI_SKELETON_POSITION_COUNT * 4];
+    UINT cEvents = m_pZoneEngine->Update( frame, events, _countof(events) );
+
+    for ( UINT i = 0; i < cEvents; ++i )
+    {
+        WCHAR szReport[128];
+        StringCchPrintfW( szReport, _countof(szReport), L"Zone: joint %u of skeleton %u %s %s\r\n",
+            events[i].joint, events[i].dwTrackingID, events[i].bEnter ? L"entered" : L"left", m_pZoneEngine->GetName( events[i].zone ) );
+        OutputDebugString( szReport );
+    }
+}
+
+/// <summary>
+/// Give the floor estimator the accelerometer reading, and report the floor and the heights above it
+/// </summary>
+void CSkeletalViewerApp::Nui_ReportFloor( )
+{
+    Vector4 gravity;
+    HRESULT hr = E_FAIL;
+
+    EnterCriticalSection( &m_csNuiSensor );
+    if ( NULL != m_pNuiSensor )
+    {
+        hr = m_pNuiSensor->NuiAccelerometerGetCurrentReading( &gravity );
+    }
+    LeaveCriticalSection( &m_csNuiSensor );
+
+    if ( SUCCEEDED( hr ) )
+    {
+        m_pFloorEstimator->SetGravity( gravity );
+    }
+
+    WCHAR szReport[160];
+    FLOOR_ESTIMATE estimate;
+    if ( m_pFloorEstimator->ReadEstimate( estimate ) )
+    {
+        StringCchPrintfW( szReport, _countof(szReport), L"Floor: sensor %.3f m above (%.3f, %.3f, %.3f), %u of %u points, found in %.2f ms\r\n",
+            estimate.plane.w, estimate.plane.x, estimate.plane.y, estimate.plane.z, estimate.cInliers, estimate.cSamples, estimate.milliseconds );
+        OutputDebugString( szReport );
+    }
+
+    for ( UINT i = 0; i < m_cFloorHeights; ++i )
+    {
+        StringCchPrintfW( szReport, _countof(szReport), L"Floor: skeleton %u head %.2f m, hip %.2f m, feet %.2f m above\r\n",
+            m_FloorHeights[i].dwTrackingID, m_FloorHeights[i].head, m_FloorHeights[i].hip, m_FloorHeights[i].feet );
+        OutputDebugString( szReport );
+    }
+}
+
+/// <summary>
+/// Analyze the hands of the last skeleton frame in a depth frame, and report the ones that changed
+/// </summary>
+/// <param name="pDepth">packed depth pixels</param>
+/// <param name="resolution">resolution of the depth frame</param>
+void CSkeletalViewerApp::Nui_AnalyzeHands( const USHORT * pDepth, NUI_IMAGE_RESOLUTION resolution )
+{
+    static const LPCWSTR szStates[] = { L"unknown", L"open", L"closed" };
+
+    HAND_RESULT results[HAND_MAX_HANDS];
+    UINT cResults = m_pHandAnalyzer->Analyze( pDepth, resolution, results, _countof(results) );
+
+    for ( UINT i = 0; i < cResults; ++i )
+    {
+        if ( !results[i].bChanged )
+        {
+            continue;
+        }
+
+        WCHAR szReport[128];
+        StringCchPrintfW( szReport, _countof(szReport), L"Hand: %s hand of skeleton %u %s, %u fingertips (%u pixels, solidity %.2f)\r\n",
+            NUI_SKELETON_POSITION_HAND_LEFT == results[i].joint ? L"left" : L"right", results[i].dwTrackingID,
+            szStates[results[i].state], results[i].cFingertips, results[i].area, results[i].solidity );
+        OutputDebugString( szReport );
+    }
+}
+
+/// <summary>
+/// Consumer of synced frame sets, reports how many came each second and how far apart their frames were
+/// </summary>
+/// <param name="source">frame source the consumer runs on</param>
+/// <param name="pContext">unused</param>
+void CSkeletalViewerApp::Nui_SyncConsumer( FrameSource & source, void * pContext )
+{
+    UNREFERENCED_PARAMETER( pContext );
+
+    // Kept on the fiber's stack from one set to the next, as a loop on a thread would
+    FRAME_SET set;
+    UINT cSets = 0;
+    LONGLONG maxColorApart = 0;
+    LONGLONG maxSkeletonApart = 0;
+    LONGLONG reportTime = 0;
+
+    while ( source.NextSyncedSet( set ) )
+    {
+        LONGLONG colorApart = set.pColor->timeStamp - set.pDepth->timeStamp;
+        LONGLONG skeletonApart = set.pSkeleton->liTimeStamp.QuadPart - set.pDepth->timeStamp;
+        maxColorApart = max( maxColorApart, colorApart < 0 ? -colorApart : colorApart );
+        maxSkeletonApart = max( maxSkeletonApart, skeletonApart < 0 ? -skeletonApart : skeletonApart );
+        ++cSets;
+
+        if ( 0 == reportTime )
+        {
+            reportTime = set.pDepth->timeStamp;
+        }
+        else if ( set.pDepth->timeStamp - reportTime >= 1000 )
+        {
+            WCHAR szReport[128];
+            StringCchPrintfW( szReport, _countof(szReport), L"Sync: %u sets in %I64d ms, color up to %I64d ms and skeletons up to %I64d ms from depth\r\n",
+                cSets, set.pDepth->timeStamp - reportTime, maxColorApart, maxSkeletonApart );
+            OutputDebugString( szReport );
+
+            cSets = 0;
+            maxColorApart = 0;
+            maxSkeletonApart = 0;
+            reportTime = set.pDepth->timeStamp;
+        }
+    }
+}
+
+/// <summary>
+/// Add a stage to the graph of the depth frame being processed
+/// </summary>
+/// <param name="stage">SV_DEPTH_STAGE_ value</param>
+/// <returns>index of the task</returns>
+int CSkeletalViewerApp::Nui_AddDepthStage( int stage )
+{
+    return m_DepthGraph.AddTask( Nui_DepthStageProc, &m_DepthTasks[stage] );
+}
+
+/// <summary>
+/// Run one stage of the depth frame being processed, calls class instance stage processor
+/// </summary>
+/// <param name="pContext">DEPTH_TASK of the stage</param>
+void CSkeletalViewerApp::Nui_DepthStageProc( void * pContext )
+{
+    DEPTH_TASK * pTask = static_cast<DEPTH_TASK *>(pContext);
+    pTask->pApp->Nui_RunDepthStage( pTask->stage );
+}
+
+/// <summary>
+/// Run one stage of the depth frame being processed
+/// </summary>
+/// <param name="stage">SV_DEPTH_STAGE_ value</param>
+void CSkeletalViewerApp::Nui_RunDepthStage( int stage )
+{
+    SV_DEPTH_FRAME & frame = m_DepthFrame;
+
+    switch ( stage )
+    {
+    case SV_DEPTH_STAGE_KERNEL:
+        m_pDepthKernel->Run( frame.outputs, frame.pDepth, frame.targets );
+
+        if ( frame.outputs & DEPTH_KERNEL_HISTOGRAM )
+        {
+            m_pDepthHistogram->EndCount( );
+        }
+        break;
+
+    case SV_DEPTH_STAGE_PUBLISH_DEPTH:
+        m_pDepthChannel->Publish( reinterpret_cast<const BYTE *>(frame.pDepth), frame.width, frame.height, frame.pitch,
+            sizeof(USHORT), IMAGE_CHANNEL_FORMAT_DEPTH16, frame.dwFrameNumber, frame.timeStamp );
+        break;
+
+    case SV_DEPTH_STAGE_FLOOR:
+        // Only every few seconds does this sample the frame for a new search
+        m_pFloorEstimator->Submit( frame.pDepth, frame.width, frame.height, m_pDepthKernel->HasPlayerIndex( ), timeGetTime( ) );
+        break;
+
+    case SV_DEPTH_STAGE_HANDS:
+        // Only the pixels around the hands of the last skeleton frame are read
+        Nui_AnalyzeHands( frame.pDepth, frame.resolution );
+        break;
+
+    case SV_DEPTH_STAGE_FRAME_SOURCE:
+        m_pFrameSource->PostDepth( frame.pDepth, frame.width, frame.height, frame.pitch, frame.dwFrameNumber, frame.timeStamp );
+        break;
+
+    case SV_DEPTH_STAGE_RECORD:
+        // The codec takes whole frames, which sensor and filtered depth both are
+        if ( frame.pitch == frame.width * sizeof(USHORT) )
+        {
+            m_pDepthRecorder->Write( frame.pDepth, frame.width, frame.height, frame.dwFrameNumber, frame.timeStamp );
+        }
+        break;
+
+    case SV_DEPTH_STAGE_OUTPUTS:
+        if ( frame.bPointCloud )
+        {
+            m_pPointCloud->EndFrame( frame.targets.statistics.cValid );
+        }
+
+        if ( frame.bExportPointCloud )
+        {
+            WCHAR szFileName[MAX_PATH];
+            StringCchPrintfW( szFileName, _countof(szFileName), L"SkeletalViewer_%u.ply", frame.dwFrameNumber );
+
+            // Color the points from the newest color frame if the mapping is available
+            const BYTE * pPointColors = NULL;
+            if ( frame.bRegistered )
+            {
+                m_pRegistration->MapFrame( frame.pDepth );
+                m_pRegistration->RegisterColor( m_pLatestColor );
+                pPointColors = m_pRegistration->GetRegisteredColor( );
+            }
+
+            WCHAR szReport[MAX_PATH + 128];
+            HRESULT hrExport = m_pPointCloud->ExportPly( szFileName, pPointColors );
+            StringCchPrintfW( szReport, _countof(szReport), L"Point cloud: %u points from %u to %u mm (mean %u) %s %s\r\n",
+                m_pPointCloud->GetValidPointCount( ), frame.targets.statistics.minDepth, frame.targets.statistics.maxDepth,
+                static_cast<UINT>(frame.targets.statistics.meanDepth + 0.5f),
+                SUCCEEDED(hrExport) ? L"written to" : L"could not be written to", szFileName );
+            OutputDebugString( szReport );
+        }
+
+        if ( frame.pSegmentation )
+        {
+            frame.pSegmentation->EndFrame( );
+
+            if ( m_pPlayerMaskChannel )
+            {
+                m_pPlayerMaskChannel->Publish( frame.pSegmentation->GetPackedMasks( ), frame.pSegmentation->GetPackedSize( ), 1, frame.pSegmentation->GetPackedSize( ),
+                    1, IMAGE_CHANNEL_FORMAT_PLAYER_MASKS, frame.dwFrameNumber, frame.timeStamp );
+            }
+
+            // The next color frames are composited through this mask
+            if ( frame.bGreenScreen && frame.bRegistered )
+            {
+                m_pRegistration->MapFrame( frame.pDepth );
+                m_pGreenScreen->BuildMask( m_pRegistration->GetColorCoordinates( ), frame.pSegmentation->GetLabels( ), frame.width, frame.height );
+            }
+        }
+        break;
+
+    case SV_DEPTH_STAGE_PUBLISH_RGBX:
+        m_pDepthRGBXChannel->Publish( m_depthRGBX, frame.width, frame.height, frame.width * g_BytesPerPixel,
+            g_BytesPerPixel, IMAGE_CHANNEL_FORMAT_BGRX32, frame.dwFrameNumber, frame.timeStamp );
+        break;
+    }
+}
+
+/// <summary>
+/// Initialize the current sensor and open its color, depth and skeleton streams
+/// Caller must hold m_csNuiSensor.  No UI is shown so this may run on any thread
+/// </summary>
+/// <param name="errorId">receives the error string resource to report on failure</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT CSkeletalViewerApp::Nui_OpenStreams( UINT & errorId )
+{
+    HRESULT hr;
+
+    errorId = 0;
+
     DWORD nuiFlags = NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX | NUI_INITIALIZE_FLAG_USES_SKELETON |  NUI_INITIALIZE_FLAG_USES_COLOR;
 
     hr = m_pNuiSensor->NuiInitialize(nuiFlags);
@@ -222,11 +930,11 @@ HRESULT CSkeletalViewerApp::Nui_Init( )
     {
         if ( E_NUI_DEVICE_IN_USE == hr )
         {
-            MessageBoxResource( IDS_ERROR_IN_USE, MB_OK | MB_ICONHAND );
+            errorId = IDS_ERROR_IN_USE;
         }
         else
         {
-            MessageBoxResource( IDS_ERROR_NUIINIT, MB_OK | MB_ICONHAND );
+            errorId = IDS_ERROR_NUIINIT;
         }
         return hr;
     }
@@ -236,22 +944,16 @@ HRESULT CSkeletalViewerApp::Nui_Init( )
         hr = m_pNuiSensor->NuiSkeletonTrackingEnable( m_hNextSkeletonEvent, m_SkeletonTrackingFlags );
         if( FAILED( hr ) )
         {
-            MessageBoxResource( IDS_ERROR_SKELETONTRACKING, MB_OK | MB_ICONHAND );
+            errorId = IDS_ERROR_SKELETONTRACKING;
             return hr;
         }
     }
 
-    hr = m_pNuiSensor->NuiImageStreamOpen(
-        NUI_IMAGE_TYPE_COLOR,
-        NUI_IMAGE_RESOLUTION_640x480,
-        0,
-        2,
-        m_hNextColorFrameEvent,
-        &m_pVideoStreamHandle );
+    hr = Nui_OpenColorStream( );
 
     if ( FAILED( hr ) )
     {
-        MessageBoxResource( IDS_ERROR_VIDEOSTREAM, MB_OK | MB_ICONHAND );
+        errorId = IDS_ERROR_VIDEOSTREAM;
         return hr;
     }
 
@@ -265,17 +967,103 @@ HRESULT CSkeletalViewerApp::Nui_Init( )
 
     if ( FAILED( hr ) )
     {
-        MessageBoxResource(IDS_ERROR_DEPTHSTREAM, MB_OK | MB_ICONHAND);
+        errorId = IDS_ERROR_DEPTHSTREAM;
         return hr;
     }
 
-    // Start the Nui processing thread
-    m_hEvNuiProcessStop = CreateEvent( NULL, FALSE, FALSE, NULL );
-    m_hThNuiProcess = CreateThread( NULL, 0, Nui_ProcessThread, this, 0, NULL );
+    return hr;
+}
+
+/// <summary>
+/// Open the color stream as color or infrared, whichever the color view shows
+/// Caller must hold m_csNuiSensor
+/// </summary>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT CSkeletalViewerApp::Nui_OpenColorStream( )
+{
+    // Infrared comes through the color stream, opening it again switches the type
+    return m_pNuiSensor->NuiImageStreamOpen(
+        ( SV_COLOR_VIEW_INFRARED == m_ColorView ) ? NUI_IMAGE_TYPE_COLOR_INFRARED : NUI_IMAGE_TYPE_COLOR,
+        NUI_IMAGE_RESOLUTION_640x480,
+        0,
+        2,
+        m_hNextColorFrameEvent,
+        &m_pVideoStreamHandle );
+}
+
+/// <summary>
+/// Shut down the current sensor's streams, leaving the pipeline untouched
+/// Caller must hold m_csNuiSensor
+/// </summary>
+void CSkeletalViewerApp::Nui_CloseStreams( )
+{
+    if ( m_pNuiSensor )
+    {
+        m_pNuiSensor->NuiShutdown( );
+    }
+
+    m_pDepthStreamHandle = NULL;
+    m_pVideoStreamHandle = NULL;
+
+    // Don't let the processing thread wake up for frames that will never arrive
+    if ( m_hNextSkeletonEvent && ( m_hNextSkeletonEvent != INVALID_HANDLE_VALUE ) )
+    {
+        ResetEvent( m_hNextSkeletonEvent );
+    }
+    if ( m_hNextDepthFrameEvent && ( m_hNextDepthFrameEvent != INVALID_HANDLE_VALUE ) )
+    {
+        ResetEvent( m_hNextDepthFrameEvent );
+    }
+    if ( m_hNextColorFrameEvent && ( m_hNextColorFrameEvent != INVALID_HANDLE_VALUE ) )
+    {
+        ResetEvent( m_hNextColorFrameEvent );
+    }
+}
+
+/// <summary>
+/// Acquire the sensor with an instance name, in place of any held before,
+/// and remember its instance name.  Caller must hold m_csNuiSensor
+/// </summary>
+/// <param name="instanceName">instance name of the sensor</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT CSkeletalViewerApp::AcquireSensor( const WCHAR * instanceName )
+{
+    INuiSensor * pNuiSensor = NULL;
+    HRESULT hr = NuiCreateSensorById( instanceName, &pNuiSensor );
+    if ( SUCCEEDED(hr) )
+    {
+        SafeRelease( m_pNuiSensor );
+        m_pNuiSensor = pNuiSensor;
+
+        // instanceName may be the one being replaced, so it isn't used past here
+        SysFreeString( m_instanceId );
+        m_instanceId = m_pNuiSensor->NuiDeviceConnectionId( );
+    }
 
     return hr;
 }
 
+/// <summary>
+/// Open the streams of the sensor acquired
+/// Caller must hold m_csNuiSensor
+/// </summary>
+/// <param name="errorId">receives the error string resource to report on failure</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT CSkeletalViewerApp::OpenSensorStreams( UINT & errorId )
+{
+    return Nui_OpenStreams( errorId );
+}
+
+/// <summary>
+/// Close the streams and let go of a sensor that has been unplugged, keeping
+/// the processing pipeline alive.  Caller must hold m_csNuiSensor
+/// </summary>
+void CSkeletalViewerApp::ReleaseSensor( )
+{
+    Nui_CloseStreams( );
+    SafeRelease( m_pNuiSensor );
+}
+
 /// <summary>
 /// Uninitialize Kinect
 /// </summary>
@@ -295,11 +1083,16 @@ void CSkeletalViewerApp::Nui_UnInit( )
         }
         CloseHandle( m_hEvNuiProcessStop );
     }
+    m_hEvNuiProcessStop = NULL;
+
+    // The status callback only reconnects while the pipeline runs, so the pipeline
+    // is marked stopped and the sensor let go of together under the sensor lock
+    EnterCriticalSection( &m_csNuiSensor );
+    m_hThNuiProcess = NULL;
+    Nui_CloseStreams( );
+    SafeRelease( m_pNuiSensor );
+    LeaveCriticalSection( &m_csNuiSensor );
 
-    if ( m_pNuiSensor )
-    {
-        m_pNuiSensor->NuiShutdown( );
-    }
     if ( m_hNextSkeletonEvent && ( m_hNextSkeletonEvent != INVALID_HANDLE_VALUE ) )
     {
         CloseHandle( m_hNextSkeletonEvent );
@@ -316,8 +1109,6 @@ void CSkeletalViewerApp::Nui_UnInit( )
         m_hNextColorFrameEvent = NULL;
     }
 
-    SafeRelease( m_pNuiSensor );
-    
     // clean up Direct2D graphics
     delete m_pDrawDepth;
     m_pDrawDepth = NULL;
@@ -325,6 +1116,87 @@ void CSkeletalViewerApp::Nui_UnInit( )
     delete m_pDrawColor;
     m_pDrawColor = NULL;
 
+    delete m_pSkeletonPublisher;
+    m_pSkeletonPublisher = NULL;
+
+    Nui_DeleteImageChannels();
+
+    delete m_pPointCloud;
+    m_pPointCloud = NULL;
+
+    delete m_pRegistration;
+    m_pRegistration = NULL;
+
+    delete [] m_pLatestColor;
+    m_pLatestColor = NULL;
+
+    delete m_pSegmentation;
+    m_pSegmentation = NULL;
+
+    delete m_pGreenScreen;
+    m_pGreenScreen = NULL;
+
+    delete m_pTemporalFilter;
+    m_pTemporalFilter = NULL;
+
+    delete m_pSpatialFilter;
+    m_pSpatialFilter = NULL;
+
+    delete m_pParallelRows;
+    m_pParallelRows = NULL;
+
+    delete m_pDepthHistogram;
+    m_pDepthHistogram = NULL;
+
+    delete m_pDepthKernel;
+    m_pDepthKernel = NULL;
+
+    delete m_pInfraredToneMap;
+    m_pInfraredToneMap = NULL;
+
+    delete m_pGestureEngine;
+    m_pGestureEngine = NULL;
+
+    delete m_pSkeletonKinematics;
+    m_pSkeletonKinematics = NULL;
+
+    delete m_pJointPredictor;
+    m_pJointPredictor = NULL;
+
+    delete m_pSkeletonSelector;
+    m_pSkeletonSelector = NULL;
+
+    delete m_pZoneEngine;
+    m_pZoneEngine = NULL;
+
+    delete m_pFloorEstimator;
+    m_pFloorEstimator = NULL;
+
+    delete m_pHandAnalyzer;
+    m_pHandAnalyzer = NULL;
+
+    delete m_pTaskScheduler;
+    m_pTaskScheduler = NULL;
+
+    delete m_pFrameSource;
+    m_pFrameSource = NULL;
+
+    if ( m_pDepthRecorder )
+    {
+        const DEPTH_RECORDING_STATISTICS & statistics = m_pDepthRecorder->GetStatistics( );
+        if ( statistics.cFrames > 0 )
+        {
+            WCHAR szReport[MAX_PATH + 128];
+            StringCchPrintfW( szReport, _countof(szReport), L"Recording: %u frames, %I64u bytes of depth and infrared in %I64u (%.1f:1), %.2f ms to compress each, to %s\r\n",
+                statistics.cFrames, statistics.cbRaw, statistics.cbWritten, static_cast<double>(statistics.cbRaw) / statistics.cbWritten,
+                statistics.encodeMilliseconds / statistics.cFrames, m_szRecordFile );
+            OutputDebugString( szReport );
+        }
+
+        delete m_pDepthRecorder;
+        m_pDepthRecorder = NULL;
+    }
+
     DiscardDirect2DResources();
 }
 
@@ -383,23 +1255,44 @@ DWORD WINAPI CSkeletalViewerApp::Nui_ProcessThread( )
         // is essential, a priority queue should be used to service the item
         // which has been updated the longest ago
 
+        // The sensor may be unplugged and re-acquired underneath us, so the handlers
+        // only hold the sensor lock while they call it, never while they process or draw
         if ( WAIT_OBJECT_0 == WaitForSingleObject( m_hNextDepthFrameEvent, 0 ) )
         {
             //only increment frame count if a frame was successfully drawn
             if ( Nui_GotDepthAlert() )
             {
                 ++m_DepthFramesTotal;
+                MarkStartup( SV_STARTUP_FIRST_DEPTH );
+
+                DWORD reconnectTime;
+                EnterCriticalSection( &m_csNuiSensor );
+                bool bReconnected = m_pSensorConnection->FrameTaken( reconnectTime );
+                LeaveCriticalSection( &m_csNuiSensor );
+
+                if ( bReconnected )
+                {
+                    WCHAR szReport[128];
+                    StringCchPrintfW( szReport, _countof(szReport), L"Reconnect: first depth frame after %u ms\r\n", reconnectTime );
+                    OutputDebugString( szReport );
+                }
             }
         }
 
         if ( WAIT_OBJECT_0 == WaitForSingleObject( m_hNextColorFrameEvent, 0 ) )
         {
-            Nui_GotColorAlert();
+            if ( Nui_GotColorAlert() )
+            {
+                MarkStartup( SV_STARTUP_FIRST_COLOR );
+            }
         }
 
         if (  WAIT_OBJECT_0 == WaitForSingleObject( m_hNextSkeletonEvent, 0 ) )
         {
-            Nui_GotSkeletonAlert( );
+            if ( Nui_GotSkeletonAlert( ) )
+            {
+                MarkStartup( SV_STARTUP_FIRST_SKELETON );
+            }
         }
 
         // Once per second, display the depth FPS
@@ -410,6 +1303,22 @@ DWORD WINAPI CSkeletalViewerApp::Nui_ProcessThread( )
             PostMessageW( m_hWnd, WM_USER_UPDATE_FPS, IDC_FPS, fps );
             m_LastDepthFramesTotal = m_DepthFramesTotal;
             m_LastDepthFPStime = t;
+
+            // and how far off predicting the next skeleton frame was
+            JOINT_PREDICTION_ERROR predictionError;
+            if ( m_pJointPredictor && m_pJointPredictor->ReadError( predictionError ) )
+            {
+                WCHAR szReport[160];
+                StringCchPrintfW( szReport, _countof(szReport), L"Prediction: next frame off by %.1f mm (worst %.1f mm), %.1f mm unpredicted, over %u joints\r\n",
+                    predictionError.meanError * 1000.0f, predictionError.maxError * 1000.0f, predictionError.meanLag * 1000.0f, predictionError.cJoints );
+                OutputDebugString( szReport );
+            }
+
+            // and the floor, searching again if the accelerometer shows the sensor has been moved
+            if ( m_pFloorEstimator )
+            {
+                Nui_ReportFloor( );
+            }
         }
 
         // Blank the skeleton panel if we haven't found a skeleton recently
@@ -426,40 +1335,156 @@ DWORD WINAPI CSkeletalViewerApp::Nui_ProcessThread( )
     return 0;
 }
 
+/// <summary>
+/// Take the next frame of an image stream, holding the sensor lock only while it is taken
+/// </summary>
+/// <param name="hStream">handle of the stream, read with the lock held since a reconnect opens it again</param>
+/// <param name="frame">receives the locked frame</param>
+/// <param name="ppNuiSensor">receives the sensor the frame came from, with a reference given back with the frame</param>
+/// <returns>S_OK if successful, E_NUI_DEVICE_NOT_CONNECTED without a sensor, otherwise as SensorTakeImageFrame</returns>
+HRESULT CSkeletalViewerApp::Nui_TakeImageFrame( const HANDLE & hStream, SENSOR_IMAGE_FRAME & frame, INuiSensor ** ppNuiSensor )
+{
+    HRESULT hr = E_NUI_DEVICE_NOT_CONNECTED;
+    *ppNuiSensor = NULL;
+
+    EnterCriticalSection( &m_csNuiSensor );
+    if ( NULL != m_pNuiSensor )
+    {
+        hr = SensorTakeImageFrame( m_pNuiSensor, hStream, frame );
+    }
+
+    // The reference keeps the sensor and the frame's buffer alive if it is unplugged while the frame is processed
+    if ( SUCCEEDED( hr ) )
+    {
+        m_pNuiSensor->AddRef( );
+        *ppNuiSensor = m_pNuiSensor;
+    }
+    LeaveCriticalSection( &m_csNuiSensor );
+
+    return hr;
+}
+
+/// <summary>
+/// Give an image frame back to the sensor it came from, holding the sensor lock only while it is given back
+/// </summary>
+/// <param name="pNuiSensor">sensor from Nui_TakeImageFrame, whose reference is released</param>
+/// <param name="frame">frame from Nui_TakeImageFrame</param>
+void CSkeletalViewerApp::Nui_ReleaseImageFrame( INuiSensor * pNuiSensor, SENSOR_IMAGE_FRAME & frame )
+{
+    EnterCriticalSection( &m_csNuiSensor );
+    SensorReleaseImageFrame( pNuiSensor, frame );
+    LeaveCriticalSection( &m_csNuiSensor );
+
+    pNuiSensor->Release( );
+}
+
+/// <summary>
+/// Bring the registration table up to date for a depth resolution, holding the sensor lock while the sensor is asked
+/// </summary>
+/// <param name="depthResolution">resolution of the depth stream</param>
+/// <returns>true if the table is up to date, false without a sensor or its calibration</returns>
+bool CSkeletalViewerApp::Nui_UpdateRegistration( NUI_IMAGE_RESOLUTION depthResolution )
+{
+    bool bUpdated = false;
+
+    EnterCriticalSection( &m_csNuiSensor );
+    if ( NULL != m_pNuiSensor )
+    {
+        bUpdated = m_pRegistration->Update( m_pNuiSensor, depthResolution, NUI_IMAGE_RESOLUTION_640x480 );
+    }
+    LeaveCriticalSection( &m_csNuiSensor );
+
+    return bUpdated;
+}
+
 /// <summary>
 /// Handle new color data
 /// </summary>
 /// <returns>true if a frame was processed, false otherwise</returns>
 bool CSkeletalViewerApp::Nui_GotColorAlert( )
 {
-    NUI_IMAGE_FRAME imageFrame;
-    bool processedFrame = true;
+    SENSOR_IMAGE_FRAME sensorFrame;
+    INuiSensor * pNuiSensor;
 
-    HRESULT hr = m_pNuiSensor->NuiImageStreamGetNextFrame( m_pVideoStreamHandle, 0, &imageFrame );
+    HRESULT hr = Nui_TakeImageFrame( m_pVideoStreamHandle, sensorFrame, &pNuiSensor );
+    if ( E_FAIL == hr )
+    {
+        OutputDebugString( L"Buffer length of received texture is bogus\r\n" );
+    }
 
     if ( FAILED( hr ) )
     {
         return false;
     }
 
-    INuiFrameTexture * pTexture = imageFrame.pFrameTexture;
-    NUI_LOCKED_RECT LockedRect;
-    pTexture->LockRect( 0, &LockedRect, NULL, 0 );
-    if ( LockedRect.Pitch != 0 )
+    const NUI_IMAGE_FRAME & imageFrame = sensorFrame.imageFrame;
+    const NUI_LOCKED_RECT & LockedRect = sensorFrame.lockedRect;
+    DWORD frameWidth = sensorFrame.width;
+    DWORD frameHeight = sensorFrame.height;
+
+    // Frames of the old type can still arrive just after the stream is switched
+    if ( NUI_IMAGE_TYPE_COLOR_INFRARED == imageFrame.eImageType )
     {
-        m_pDrawColor->Draw( static_cast<BYTE *>(LockedRect.pBits), LockedRect.size );
+        if ( m_pInfraredToneMap->Initialize( imageFrame.eResolution ) )
+        {
+            m_pDrawColor->Draw( m_pInfraredToneMap->Convert( reinterpret_cast<const USHORT *>(LockedRect.pBits), LockedRect.Pitch ),
+                m_pInfraredToneMap->GetOutputSize( ) );
+        }
+
+        // Infrared is seen by the depth camera, so it isn't kept as the latest color
+        // for registration; other processes get the samples as they came
+        if ( m_pColorChannel )
+        {
+            m_pColorChannel->Publish( static_cast<BYTE *>(LockedRect.pBits), frameWidth, frameHeight, LockedRect.Pitch,
+                sizeof(USHORT), IMAGE_CHANNEL_FORMAT_INFRARED16, imageFrame.dwFrameNumber, imageFrame.liTimeStamp.QuadPart );
+        }
+
+        if ( m_pFrameSource )
+        {
+            m_pFrameSource->PostInfrared( reinterpret_cast<const USHORT *>(LockedRect.pBits), frameWidth, frameHeight, LockedRect.Pitch,
+                imageFrame.dwFrameNumber, imageFrame.liTimeStamp.QuadPart );
+        }
+
+        // Recorded raw, between the depth frames; this thread waits for the depth
+        // stages, so the recorder is only ever written by one thread at a time
+        if ( m_pDepthRecorder && static_cast<UINT>(LockedRect.Pitch) == frameWidth * sizeof(USHORT) )
+        {
+            m_pDepthRecorder->WriteInfrared( reinterpret_cast<const USHORT *>(LockedRect.pBits), frameWidth, frameHeight,
+                imageFrame.dwFrameNumber, imageFrame.liTimeStamp.QuadPart );
+        }
     }
     else
     {
-        OutputDebugString( L"Buffer length of received texture is bogus\r\n" );
-        processedFrame = false;
-    }
+        if ( SV_COLOR_VIEW_GREEN_SCREEN == m_ColorView && m_pGreenScreen )
+        {
+            m_pDrawColor->Draw( m_pGreenScreen->Composite( static_cast<BYTE *>(LockedRect.pBits) ), LockedRect.size );
+        }
+        else
+        {
+            m_pDrawColor->Draw( static_cast<BYTE *>(LockedRect.pBits), LockedRect.size );
+        }
+
+        if ( m_pLatestColor )
+        {
+            CopyMemory( m_pLatestColor, LockedRect.pBits, min( LockedRect.size, 640 * 480 * g_BytesPerPixel ) );
+        }
+
+        if ( m_pColorChannel )
+        {
+            m_pColorChannel->Publish( static_cast<BYTE *>(LockedRect.pBits), frameWidth, frameHeight, LockedRect.Pitch,
+                g_BytesPerPixel, IMAGE_CHANNEL_FORMAT_BGRX32, imageFrame.dwFrameNumber, imageFrame.liTimeStamp.QuadPart );
+        }
 
-    pTexture->UnlockRect( 0 );
+        if ( m_pFrameSource )
+        {
+            m_pFrameSource->PostColor( static_cast<BYTE *>(LockedRect.pBits), frameWidth, frameHeight, LockedRect.Pitch,
+                imageFrame.dwFrameNumber, imageFrame.liTimeStamp.QuadPart );
+        }
+    }
 
-    m_pNuiSensor->NuiImageStreamReleaseFrame( m_pVideoStreamHandle, &imageFrame );
+    Nui_ReleaseImageFrame( pNuiSensor, sensorFrame );
 
-    return processedFrame;
+    return true;
 }
 
 /// <summary>
@@ -468,69 +1493,169 @@ bool CSkeletalViewerApp::Nui_GotColorAlert( )
 /// <returns>true if a frame was processed, false otherwise</returns>
 bool CSkeletalViewerApp::Nui_GotDepthAlert( )
 {
-    NUI_IMAGE_FRAME imageFrame;
+    SENSOR_IMAGE_FRAME sensorFrame;
+    INuiSensor * pNuiSensor;
     bool processedFrame = true;
 
-    HRESULT hr = m_pNuiSensor->NuiImageStreamGetNextFrame(
-        m_pDepthStreamHandle,
-        0,
-        &imageFrame );
+    HRESULT hr = Nui_TakeImageFrame( m_pDepthStreamHandle, sensorFrame, &pNuiSensor );
+    if ( E_FAIL == hr )
+    {
+        OutputDebugString( L"Buffer length of received texture is bogus\r\n" );
+    }
 
     if ( FAILED( hr ) )
     {
         return false;
     }
 
-    INuiFrameTexture * pTexture = imageFrame.pFrameTexture;
-    NUI_LOCKED_RECT LockedRect;
-    pTexture->LockRect( 0, &LockedRect, NULL, 0 );
-    if ( 0 != LockedRect.Pitch )
+    const NUI_IMAGE_FRAME & imageFrame = sensorFrame.imageFrame;
+    const NUI_LOCKED_RECT & LockedRect = sensorFrame.lockedRect;
+
+    // The kernels are picked on the first frame of a stream and kept after that
+    if ( m_pDepthKernel->Select( imageFrame.eImageType, imageFrame.eResolution ) )
     {
-        DWORD frameWidth, frameHeight;
-        
-        NuiImageResolutionToSize( imageFrame.eResolution, frameWidth, frameHeight );
-        
-        // draw the bits to the bitmap
-        BYTE * rgbrun = m_depthRGBX;
-        const USHORT * pBufferRun = (const USHORT *)LockedRect.pBits;
+        DWORD frameWidth = sensorFrame.width;
+        DWORD frameHeight = sensorFrame.height;
+
+        // Everything downstream sees the filtered depth, the player index is left as it was
+        const USHORT * pDepth = reinterpret_cast<const USHORT *>(LockedRect.pBits);
+        DWORD depthPitch = LockedRect.Pitch;
+        if ( m_pTemporalFilter && m_pTemporalFilter->Initialize( imageFrame.eResolution, TEMPORAL_FILTER_DEFAULT_FRAMES ) )
+        {
+            pDepth = m_pTemporalFilter->Filter( pDepth, depthPitch, m_pParallelRows );
+            depthPitch = frameWidth * sizeof(USHORT);
+        }
+
+        if ( m_pSpatialFilter && m_pSpatialFilter->Initialize( imageFrame.eResolution ) )
+        {
+            const BYTE * pGuide = NULL;
+            if ( m_bSpatialFilterGuided && Nui_UpdateRegistration( imageFrame.eResolution ) )
+            {
+                m_pRegistration->MapFrame( pDepth );
+                m_pRegistration->RegisterColor( m_pLatestColor );
+                pGuide = m_pRegistration->GetRegisteredColor( );
+            }
 
-        // end pixel is start + width*height - 1
-        const USHORT * pBufferEnd = pBufferRun + (frameWidth * frameHeight);
+            pDepth = m_pSpatialFilter->Filter( pDepth, depthPitch, pGuide, m_pParallelRows );
+            depthPitch = frameWidth * sizeof(USHORT);
+        }
 
         assert( frameWidth * frameHeight * g_BytesPerPixel <= ARRAYSIZE(m_depthRGBX) );
 
-        while ( pBufferRun < pBufferEnd )
+        bool bGreenScreen = ( SV_COLOR_VIEW_GREEN_SCREEN == m_ColorView ) && Nui_EnsureGreenScreen( );
+
+        SV_DEPTH_FRAME & frame = m_DepthFrame;
+        ZeroMemory( &frame, sizeof(frame) );
+        frame.pDepth = pDepth;
+        frame.pitch = depthPitch;
+        frame.width = frameWidth;
+        frame.height = frameHeight;
+        frame.resolution = imageFrame.eResolution;
+        frame.dwFrameNumber = imageFrame.dwFrameNumber;
+        frame.timeStamp = imageFrame.liTimeStamp.QuadPart;
+        frame.bGreenScreen = bGreenScreen;
+
+        // One pass over the frame colorizes it and produces everything else it is needed for
+        frame.outputs = DEPTH_KERNEL_COLORIZE;
+        frame.targets.pRGBX = m_depthRGBX;
+
+        // Auto-contrast looks intensities up in a table spread over the depths in the scene.
+        // The histogram counted in this pass shapes the table of the next frame
+        if ( SV_DEPTH_VIEW_AUTO_CONTRAST == m_DepthView )
+        {
+            if ( !m_pDepthHistogram->HasTable( ) )
+            {
+                m_pDepthHistogram->Update( pDepth, frameWidth, frameHeight );
+            }
+
+            frame.targets.pIntensity = m_pDepthHistogram->GetIntensityTable( );
+            frame.targets.pHistogram = m_pDepthHistogram->BeginCount( );
+            frame.outputs |= DEPTH_KERNEL_HISTOGRAM;
+        }
+
+        if ( m_pSegmentation && m_pSegmentation->BeginFrame( frameWidth, frameHeight, imageFrame.dwFrameNumber ) )
+        {
+            frame.pSegmentation = m_pSegmentation;
+            frame.targets.pSegmentation = m_pSegmentation;
+            frame.outputs |= DEPTH_KERNEL_PLAYER_MASKS;
+        }
+
+        // Points, with the depth range of the frame when they are exported
+        frame.bPointCloud = m_pPointCloud && m_pPointCloud->Initialize( imageFrame.eResolution ) &&
+            m_pPointCloud->BeginFrame( m_pDepthKernel->HasPlayerIndex( ), frame.targets.pointCloud );
+        frame.bExportPointCloud = frame.bPointCloud && InterlockedExchange( &m_PointCloudExportPending, FALSE );
+        if ( frame.bPointCloud )
+        {
+            frame.outputs |= DEPTH_KERNEL_POINT_CLOUD;
+        }
+
+        if ( frame.bExportPointCloud )
+        {
+            frame.outputs |= DEPTH_KERNEL_STATISTICS;
+        }
+
+        // The table asks the sensor for calibration, so it is brought up to date here rather than on a worker
+        frame.bRegistered = ( frame.bExportPointCloud || frame.bGreenScreen ) &&
+            Nui_UpdateRegistration( imageFrame.eResolution );
+
+        // Stages that only read the depth run alongside the kernel, the ones that use what it produces after it
+        m_DepthGraph.Clear( );
+        int kernel = Nui_AddDepthStage( SV_DEPTH_STAGE_KERNEL );
+
+        if ( m_pDepthChannel )
+        {
+            Nui_AddDepthStage( SV_DEPTH_STAGE_PUBLISH_DEPTH );
+        }
+
+        // A search, every few seconds, runs on the samples alongside the other stages
+        if ( m_pFloorEstimator )
+        {
+            m_pFloorEstimator->AddSearch( m_DepthGraph, Nui_AddDepthStage( SV_DEPTH_STAGE_FLOOR ) );
+        }
+
+        if ( m_pHandAnalyzer )
+        {
+            Nui_AddDepthStage( SV_DEPTH_STAGE_HANDS );
+        }
+
+        if ( m_pFrameSource )
         {
-            USHORT depth     = *pBufferRun;
-            USHORT realDepth = NuiDepthPixelToDepth(depth);
-            USHORT player    = NuiDepthPixelToPlayerIndex(depth);
+            Nui_AddDepthStage( SV_DEPTH_STAGE_FRAME_SOURCE );
+        }
 
-            // transform 13-bit depth information into an 8-bit intensity appropriate
-            // for display (we disregard information in most significant bit)
-            BYTE intensity = static_cast<BYTE>(~(realDepth >> 4));
+        if ( m_pDepthRecorder )
+        {
+            Nui_AddDepthStage( SV_DEPTH_STAGE_RECORD );
+        }
 
-            // tint the intensity by dividing by per-player values
-            *(rgbrun++) = intensity >> g_IntensityShiftByPlayerB[player];
-            *(rgbrun++) = intensity >> g_IntensityShiftByPlayerG[player];
-            *(rgbrun++) = intensity >> g_IntensityShiftByPlayerR[player];
+        m_DepthGraph.AddDependency( kernel, Nui_AddDepthStage( SV_DEPTH_STAGE_OUTPUTS ) );
 
-            // no alpha information, skip the last byte
-            ++rgbrun;
+        if ( m_pDepthRGBXChannel )
+        {
+            m_DepthGraph.AddDependency( kernel, Nui_AddDepthStage( SV_DEPTH_STAGE_PUBLISH_RGBX ) );
+        }
 
-            ++pBufferRun;
+        // The frame stays locked until every stage is done with it
+        if ( m_pTaskScheduler )
+        {
+            m_pTaskScheduler->Submit( m_DepthGraph );
+            m_pTaskScheduler->Wait( m_DepthGraph );
+        }
+        else
+        {
+            m_DepthGraph.Run( );
         }
 
+        // Direct2D is only drawn to from this thread
         m_pDrawDepth->Draw( m_depthRGBX, frameWidth * frameHeight * g_BytesPerPixel );
     }
     else
     {
         processedFrame = false;
-        OutputDebugString( L"Buffer length of received texture is bogus\r\n" );
+        OutputDebugString( L"Format of received depth is unknown\r\n" );
     }
 
-    pTexture->UnlockRect( 0 );
-
-    m_pNuiSensor->NuiImageStreamReleaseFrame( m_pDepthStreamHandle, &imageFrame );
+    Nui_ReleaseImageFrame( pNuiSensor, sensorFrame );
 
     return processedFrame;
 }
@@ -594,35 +1719,12 @@ void CSkeletalViewerApp::Nui_DrawSkeleton( const NUI_SKELETON_DATA & skel, int w
         m_Points[i] = SkeletonToScreen( skel.SkeletonPositions[i], windowWidth, windowHeight );
     }
 
-    // Render Torso
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_HEAD, NUI_SKELETON_POSITION_SHOULDER_CENTER );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SHOULDER_LEFT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SHOULDER_RIGHT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SPINE );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_SPINE, NUI_SKELETON_POSITION_HIP_CENTER );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_HIP_CENTER, NUI_SKELETON_POSITION_HIP_LEFT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_HIP_CENTER, NUI_SKELETON_POSITION_HIP_RIGHT );
-
-    // Left Arm
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_SHOULDER_LEFT, NUI_SKELETON_POSITION_ELBOW_LEFT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_ELBOW_LEFT, NUI_SKELETON_POSITION_WRIST_LEFT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_WRIST_LEFT, NUI_SKELETON_POSITION_HAND_LEFT );
-
-    // Right Arm
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_SHOULDER_RIGHT, NUI_SKELETON_POSITION_ELBOW_RIGHT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_ELBOW_RIGHT, NUI_SKELETON_POSITION_WRIST_RIGHT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_WRIST_RIGHT, NUI_SKELETON_POSITION_HAND_RIGHT );
-
-    // Left Leg
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_HIP_LEFT, NUI_SKELETON_POSITION_KNEE_LEFT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_KNEE_LEFT, NUI_SKELETON_POSITION_ANKLE_LEFT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_ANKLE_LEFT, NUI_SKELETON_POSITION_FOOT_LEFT );
-
-    // Right Leg
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_HIP_RIGHT, NUI_SKELETON_POSITION_KNEE_RIGHT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_KNEE_RIGHT, NUI_SKELETON_POSITION_ANKLE_RIGHT );
-    Nui_DrawBone( skel, NUI_SKELETON_POSITION_ANKLE_RIGHT, NUI_SKELETON_POSITION_FOOT_RIGHT );
-    
+    // Render the bones, the same ones the kinematics are worked out for
+    for ( i = 0; i < SKELETON_BONE_COUNT; i++ )
+    {
+        Nui_DrawBone( skel, g_SkeletonBones[i].from, g_SkeletonBones[i].to );
+    }
+
     // Draw the joints in a different color
     for ( i = 0; i < NUI_SKELETON_POSITION_COUNT; i++ )
     {
@@ -645,103 +1747,51 @@ void CSkeletalViewerApp::Nui_DrawSkeleton( const NUI_SKELETON_DATA & skel, int w
 /// <param name="skel">skeleton frame information</param>
 void CSkeletalViewerApp::UpdateTrackedSkeletons( const NUI_SKELETON_FRAME & skel )
 {
-    DWORD nearestIDs[2] = { 0, 0 };
-    USHORT nearestDepths[2] = { NUI_IMAGE_DEPTH_MAXIMUM, NUI_IMAGE_DEPTH_MAXIMUM };
-
-    // Purge old sticky skeleton IDs, if the user has left the frame, etc
-    bool stickyID0Found = false;
-    bool stickyID1Found = false;
-    for ( int i = 0 ; i < NUI_SKELETON_COUNT; i++ )
+    int mode = m_TrackedSkeletons;
+    if ( SV_TRACKED_SKELETONS_DEFAULT == mode || mode >= SV_TRACKED_SKELETONS_COUNT || NULL == m_pSkeletonSelector )
     {
-        NUI_SKELETON_TRACKING_STATE trackingState = skel.SkeletonData[i].eTrackingState;
-
-        if ( trackingState == NUI_SKELETON_TRACKED || trackingState == NUI_SKELETON_POSITION_ONLY )
-        {
-            if ( skel.SkeletonData[i].dwTrackingID == m_StickySkeletonIds[0] )
-            {
-                stickyID0Found = true;
-            }
-            else if ( skel.SkeletonData[i].dwTrackingID == m_StickySkeletonIds[1] )
-            {
-                stickyID1Found = true;
-            }
-        }
+        m_SelectedTrackedSkeletons = SV_TRACKED_SKELETONS_DEFAULT;
+        return;
     }
 
-    if ( !stickyID0Found && stickyID1Found )
-    {
-        m_StickySkeletonIds[0] = m_StickySkeletonIds[1];
-        m_StickySkeletonIds[1] = 0;
-    }
-    else if ( !stickyID0Found )
+    if ( mode != m_SelectedTrackedSkeletons )
     {
-        m_StickySkeletonIds[0] = 0;
+        m_pSkeletonSelector->SetPolicy( g_TrackedSkeletonsPolicies[mode].policy, g_TrackedSkeletonsPolicies[mode].count );
+        m_SelectedTrackedSkeletons = mode;
     }
-    else if ( !stickyID1Found )
+
+    // Enabling tracking again, for seated mode or near range, forgets the skeletons picked
+    if ( m_SkeletonTrackingFlags != m_SelectedTrackingFlags )
     {
-        m_StickySkeletonIds[1] = 0;
+        m_pSkeletonSelector->Invalidate( );
+        m_SelectedTrackingFlags = m_SkeletonTrackingFlags;
     }
 
-    // Calculate nearest and sticky skeletons
-    for ( int i = 0 ; i < NUI_SKELETON_COUNT; i++ )
+    // The sensor keeps tracking the skeletons it was given, so it is only told when they change
+    DWORD trackedIDs[NUI_SKELETON_MAX_TRACKED_COUNT];
+    if ( !m_pSkeletonSelector->Select( skel, trackedIDs ) )
     {
-        NUI_SKELETON_TRACKING_STATE trackingState = skel.SkeletonData[i].eTrackingState;
-
-        if ( trackingState == NUI_SKELETON_TRACKED || trackingState == NUI_SKELETON_POSITION_ONLY )
-        {
-            // Save SkeletonIds for sticky mode if there's none already saved
-            if ( 0 == m_StickySkeletonIds[0] && m_StickySkeletonIds[1] != skel.SkeletonData[i].dwTrackingID )
-            {
-                m_StickySkeletonIds[0] = skel.SkeletonData[i].dwTrackingID;
-            }
-            else if ( 0 == m_StickySkeletonIds[1] && m_StickySkeletonIds[0] != skel.SkeletonData[i].dwTrackingID )
-            {
-                m_StickySkeletonIds[1] = skel.SkeletonData[i].dwTrackingID;
-            }
-
-            LONG x, y;
-            USHORT depth;
-
-            // calculate the skeleton's position on the screen
-            NuiTransformSkeletonToDepthImage( skel.SkeletonData[i].Position, &x, &y, &depth );
-
-            if ( depth < nearestDepths[0] )
-            {
-                nearestDepths[1] = nearestDepths[0];
-                nearestIDs[1] = nearestIDs[0];
-
-                nearestDepths[0] = depth;
-                nearestIDs[0] = skel.SkeletonData[i].dwTrackingID;
-            }
-            else if ( depth < nearestDepths[1] )
-            {
-                nearestDepths[1] = depth;
-                nearestIDs[1] = skel.SkeletonData[i].dwTrackingID;
-            }
-        }
+        return;
     }
 
-    if ( SV_TRACKED_SKELETONS_NEAREST1 == m_TrackedSkeletons || SV_TRACKED_SKELETONS_NEAREST2 == m_TrackedSkeletons )
+    HRESULT hr = E_NUI_DEVICE_NOT_CONNECTED;
+    EnterCriticalSection( &m_csNuiSensor );
+    if ( NULL != m_pNuiSensor )
     {
-        // Only track the closest single skeleton in nearest 1 mode
-        if ( SV_TRACKED_SKELETONS_NEAREST1 == m_TrackedSkeletons )
-        {
-            nearestIDs[1] = 0;
-        }
-        m_pNuiSensor->NuiSkeletonSetTrackedSkeletons(nearestIDs);
+        hr = m_pNuiSensor->NuiSkeletonSetTrackedSkeletons( trackedIDs );
     }
+    LeaveCriticalSection( &m_csNuiSensor );
 
-    if ( SV_TRACKED_SKELETONS_STICKY1 == m_TrackedSkeletons || SV_TRACKED_SKELETONS_STICKY2 == m_TrackedSkeletons )
+    if ( FAILED( hr ) )
     {
-        DWORD stickyIDs[2] = { m_StickySkeletonIds[0], m_StickySkeletonIds[1] };
-
-        // Only track a single skeleton in sticky 1 mode
-        if ( SV_TRACKED_SKELETONS_STICKY1 == m_TrackedSkeletons )
-        {
-            stickyIDs[1] = 0;
-        }
-        m_pNuiSensor->NuiSkeletonSetTrackedSkeletons(stickyIDs);
+        m_pSkeletonSelector->Invalidate( );
+        return;
     }
+
+    WCHAR szReport[128];
+    StringCchPrintfW( szReport, _countof(szReport), L"Tracked skeletons: %u and %u, %u calls made, %u avoided\r\n",
+        trackedIDs[0], trackedIDs[1], m_pSkeletonSelector->GetCallsMade( ), m_pSkeletonSelector->GetCallsAvoided( ) );
+    OutputDebugString( szReport );
 }
 
 /// <summary>
@@ -773,32 +1823,134 @@ bool CSkeletalViewerApp::Nui_GotSkeletonAlert( )
 {
     NUI_SKELETON_FRAME SkeletonFrame = {0};
 
+    // smoothed when anyone is in it; a frame that couldn't be taken is left empty.
+    // The frame is a copy, so the sensor lock is only held while it is taken
     bool foundSkeleton = false;
+    HRESULT hr = E_NUI_DEVICE_NOT_CONNECTED;
 
-    if ( SUCCEEDED(m_pNuiSensor->NuiSkeletonGetNextFrame( 0, &SkeletonFrame )) )
+    EnterCriticalSection( &m_csNuiSensor );
+    if ( NULL != m_pNuiSensor )
     {
-        for ( int i = 0 ; i < NUI_SKELETON_COUNT ; i++ )
-        {
-            NUI_SKELETON_TRACKING_STATE trackingState = SkeletonFrame.SkeletonData[i].eTrackingState;
+        hr = SensorTakeSkeletonFrame( m_pNuiSensor, SkeletonFrame, foundSkeleton );
+    }
+    LeaveCriticalSection( &m_csNuiSensor );
 
-            if ( trackingState == NUI_SKELETON_TRACKED || trackingState == NUI_SKELETON_POSITION_ONLY )
-            {
-                foundSkeleton = true;
-            }
-        }
+    // Without a sensor there's no frame at all, not even an empty one
+    if ( E_NUI_DEVICE_NOT_CONNECTED == hr || (foundSkeleton && FAILED(hr)) )
+    {
+        return false;
     }
 
+    // the floor found in depth is steadier than the one the frame carries
+    Vector4 floorPlane;
+    if ( m_pFloorEstimator && 0 != SkeletonFrame.dwFrameNumber && m_pFloorEstimator->GetPlane( floorPlane ) )
+    {
+        SkeletonFrame.vFloorClipPlane = floorPlane;
+    }
+    m_cFloorHeights = 0;
+
     // no skeletons!
     if( !foundSkeleton )
     {
+        // let subscribers know everyone has left
+        if ( m_pSkeletonPublisher && 0 != SkeletonFrame.dwFrameNumber )
+        {
+            m_pSkeletonPublisher->Publish( SkeletonFrame );
+        }
+
+        // so a skeleton that comes back starts its gestures and velocities over
+        if ( m_pGestureEngine && 0 != SkeletonFrame.dwFrameNumber )
+        {
+            m_pGestureEngine->Update( SkeletonFrame, NULL, 0 );
+        }
+
+        if ( m_pSkeletonKinematics && 0 != SkeletonFrame.dwFrameNumber )
+        {
+            m_pSkeletonKinematics->Update( SkeletonFrame );
+        }
+
+        if ( m_pZoneEngine && 0 != SkeletonFrame.dwFrameNumber )
+        {
+            Nui_UpdateZones( SkeletonFrame );
+        }
+
+        // so hands stop being looked for
+        if ( m_pHandAnalyzer && 0 != SkeletonFrame.dwFrameNumber )
+        {
+            m_pHandAnalyzer->SetSkeletons( SkeletonFrame );
+        }
+
+        // an empty frame still completes the synced sets of its moment
+        if ( m_pFrameSource && 0 != SkeletonFrame.dwFrameNumber )
+        {
+            m_pFrameSource->PostSkeleton( SkeletonFrame );
+        }
         return true;
     }
 
-    // smooth out the skeleton data
-    HRESULT hr = m_pNuiSensor->NuiTransformSmooth(&SkeletonFrame,NULL);
-    if ( FAILED(hr) )
+    if ( m_pSkeletonKinematics )
     {
-        return false;
+        m_pSkeletonKinematics->Update( SkeletonFrame );
+    }
+
+    if ( m_pFloorEstimator )
+    {
+        m_cFloorHeights = m_pFloorEstimator->MeasureSkeletons( SkeletonFrame, m_FloorHeights );
+    }
+
+    // where the skeletons will be by the time they are seen, for the outputs that opt in
+    NUI_SKELETON_FRAME PredictedFrame;
+    const NUI_SKELETON_FRAME * pDrawnFrame = &SkeletonFrame;
+    const NUI_SKELETON_FRAME * pPublishedFrame = &SkeletonFrame;
+    if ( m_pJointPredictor )
+    {
+        m_pJointPredictor->Predict( SkeletonFrame, m_pSkeletonKinematics->GetFrame( ), PredictedFrame );
+
+        if ( m_PipelineFlags & SV_PIPELINE_PREDICT_VIEW )
+        {
+            pDrawnFrame = &PredictedFrame;
+        }
+
+        if ( m_PipelineFlags & SV_PIPELINE_PREDICT_PUBLISHED )
+        {
+            pPublishedFrame = &PredictedFrame;
+        }
+    }
+
+    if ( m_pSkeletonPublisher )
+    {
+        m_pSkeletonPublisher->Publish( *pPublishedFrame );
+    }
+
+    if ( m_pGestureEngine )
+    {
+        GESTURE_EVENT events[NUI_SKELETON_COUNT];
+        UINT cEvents = m_pGestureEngine->Update( SkeletonFrame, events, _countof(events) );
+
+        for ( UINT i = 0; i < cEvents; ++i )
+        {
+            WCHAR szReport[128];
+            StringCchPrintfW( szReport, _countof(szReport), L"Gesture: %s by skeleton %u in %u frames (cost %.3f)\r\n",
+                m_pGestureEngine->GetName( events[i].gesture ), events[i].dwTrackingID, events[i].cFrames, events[i].cost );
+            OutputDebugString( szReport );
+        }
+    }
+
+    if ( m_pZoneEngine )
+    {
+        Nui_UpdateZones( SkeletonFrame );
+    }
+
+    // the next depth frame looks for the hands where they are now
+    if ( m_pHandAnalyzer )
+    {
+        m_pHandAnalyzer->SetSkeletons( SkeletonFrame );
+    }
+
+    // consumers get the skeletons as they were measured, not predicted
+    if ( m_pFrameSource )
+    {
+        m_pFrameSource->PostSkeleton( SkeletonFrame );
     }
 
     // we found a skeleton, re-start the skeletal timer
@@ -827,7 +1979,7 @@ bool CSkeletalViewerApp::Nui_GotSkeletonAlert( )
         if ( trackingState == NUI_SKELETON_TRACKED )
         {
             // We're tracking the skeleton, draw it
-            Nui_DrawSkeleton( SkeletonFrame.SkeletonData[i], width, height );
+            Nui_DrawSkeleton( pDrawnFrame->SkeletonData[i], width, height );
         }
         else if ( trackingState == NUI_SKELETON_POSITION_ONLY )
         {
@@ -893,6 +2045,43 @@ void CSkeletalViewerApp::UpdateRange( int mode )
         (mode != SV_RANGE_DEFAULT) );
 }
 
+/// <summary>
+/// Invoked when the user changes what the color view shows
+/// </summary>
+/// <param name="mode">color view to switch to</param>
+void CSkeletalViewerApp::UpdateColorView( int mode )
+{
+    bool bSwitchStream = ( SV_COLOR_VIEW_INFRARED == mode ) != ( SV_COLOR_VIEW_INFRARED == m_ColorView );
+    m_ColorView = mode;
+
+    // Without a sensor, the stream is opened to match once one is back
+    if ( bSwitchStream )
+    {
+        HRESULT hr = S_OK;
+
+        EnterCriticalSection( &m_csNuiSensor );
+        if ( NULL != m_pNuiSensor )
+        {
+            hr = Nui_OpenColorStream( );
+        }
+        LeaveCriticalSection( &m_csNuiSensor );
+
+        if ( FAILED( hr ) )
+        {
+            MessageBoxResource( IDS_ERROR_VIDEOSTREAM, MB_OK | MB_ICONHAND );
+        }
+    }
+}
+
+/// <summary>
+/// Invoked when the user changes how the depth view is shaded
+/// </summary>
+/// <param name="mode">depth view to switch to</param>
+void CSkeletalViewerApp::UpdateDepthView( int mode )
+{
+    m_DepthView = mode;
+}
+
 /// <summary>
 /// Sets or clears the specified skeleton tracking flag
 /// </summary>
@@ -911,22 +2100,33 @@ void CSkeletalViewerApp::UpdateSkeletonTrackingFlag( DWORD flag, bool value )
         newFlags &= ~flag;
     }
 
-    if (NULL != m_pNuiSensor && newFlags != m_SkeletonTrackingFlags)
-    {
-        if ( !HasSkeletalEngine(m_pNuiSensor) )
-        {
-            MessageBoxResource(IDS_ERROR_SKELETONTRACKING, MB_OK | MB_ICONHAND);
-        }
+    // The sensor may be unplugged and re-acquired underneath us; the flags are kept
+    // either way, so a reconnect enables tracking with them
+    bool bEngine = true;
+    HRESULT hr = S_OK;
 
+    EnterCriticalSection( &m_csNuiSensor );
+    if (newFlags != m_SkeletonTrackingFlags)
+    {
         m_SkeletonTrackingFlags = newFlags;
 
-        HRESULT hr = m_pNuiSensor->NuiSkeletonTrackingEnable( m_hNextSkeletonEvent, m_SkeletonTrackingFlags );
-
-        if ( FAILED( hr ) )
+        if (NULL != m_pNuiSensor)
         {
-            MessageBoxResource(IDS_ERROR_SKELETONTRACKING, MB_OK | MB_ICONHAND);
+            bEngine = HasSkeletalEngine(m_pNuiSensor);
+            hr = m_pNuiSensor->NuiSkeletonTrackingEnable( m_hNextSkeletonEvent, m_SkeletonTrackingFlags );
         }
     }
+    LeaveCriticalSection( &m_csNuiSensor );
+
+    if ( !bEngine )
+    {
+        MessageBoxResource(IDS_ERROR_SKELETONTRACKING, MB_OK | MB_ICONHAND);
+    }
+
+    if ( FAILED( hr ) )
+    {
+        MessageBoxResource(IDS_ERROR_SKELETONTRACKING, MB_OK | MB_ICONHAND);
+    }
 }
 
 /// <summary>
@@ -947,11 +2147,25 @@ void CSkeletalViewerApp::UpdateDepthStreamFlag( DWORD flag, bool value )
         newFlags &= ~flag;
     }
 
-    if (NULL != m_pNuiSensor && newFlags != m_DepthStreamFlags)
+    // The sensor may be unplugged and re-acquired underneath us; the flags are kept
+    // either way, so a reconnect opens the depth stream with them
+    EnterCriticalSection( &m_csNuiSensor );
+    if (newFlags != m_DepthStreamFlags)
     {
         m_DepthStreamFlags = newFlags;
-        m_pNuiSensor->NuiImageStreamSetImageFrameFlags( m_pDepthStreamHandle, m_DepthStreamFlags );
+
+        if (NULL != m_pNuiSensor)
+        {
+            m_pNuiSensor->NuiImageStreamSetImageFrameFlags( m_pDepthStreamHandle, m_DepthStreamFlags );
+        }
+
+        // Near mode changes how depth lines up with color
+        if ( m_pRegistration )
+        {
+            m_pRegistration->Invalidate( );
+        }
     }
+    LeaveCriticalSection( &m_csNuiSensor );
 }
 
 /// <summary>
@@ -0,0 +1,92 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ParallelRows.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "ParallelRows.h"
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="scheduler">scheduler to run the bands on, from the thread that submits to it</param>
+ParallelRows::ParallelRows( TaskScheduler & scheduler ) :
+    m_scheduler(scheduler),
+    m_pfnProc(NULL),
+    m_pContext(NULL),
+    m_cRows(0),
+    m_cBands(1)
+{
+    for ( UINT i = 0; i < PARALLEL_ROWS_MAX_BANDS; ++i )
+    {
+        m_bands[i].pOwner = this;
+        m_bands[i].index = i;
+    }
+}
+
+/// <summary>
+/// Process all rows, split into one band per thread of the scheduler
+/// </summary>
+/// <param name="pfnProc">called once for each band</param>
+/// <param name="pContext">passed through to pfnProc</param>
+/// <param name="cRows">number of rows</param>
+void ParallelRows::Run( PARALLEL_ROWS_PROC pfnProc, void * pContext, UINT cRows )
+{
+    // Not worth a task for a handful of rows
+    UINT cBands = min( GetThreadCount( ), cRows / 16 + 1 );
+
+    m_pfnProc = pfnProc;
+    m_pContext = pContext;
+    m_cRows = cRows;
+    m_cBands = cBands;
+
+    if ( 1 == cBands )
+    {
+        RunBand( 0 );
+        return;
+    }
+
+    m_graph.Clear( );
+    for ( UINT i = 0; i < cBands; ++i )
+    {
+        m_graph.AddTask( RunBandTask, &m_bands[i] );
+    }
+
+    m_scheduler.Submit( m_graph );
+    m_scheduler.Wait( m_graph );
+}
+
+/// <summary>
+/// Number of threads rows are split over, including the caller's
+/// </summary>
+/// <returns>thread count</returns>
+UINT ParallelRows::GetThreadCount( ) const
+{
+    return min( m_scheduler.GetThreadCount( ), PARALLEL_ROWS_MAX_BANDS );
+}
+
+/// <summary>
+/// Task to process a band, calls class instance band processor
+/// </summary>
+/// <param name="pContext">band to process</param>
+void ParallelRows::RunBandTask( void * pContext )
+{
+    BAND * pBand = static_cast<BAND *>(pContext);
+    pBand->pOwner->RunBand( pBand->index );
+}
+
+/// <summary>
+/// Process one band of the current Run
+/// </summary>
+/// <param name="band">band to process</param>
+void ParallelRows::RunBand( UINT band )
+{
+    UINT firstRow = m_cRows * band / m_cBands;
+    UINT endRow = m_cRows * (band + 1) / m_cBands;
+
+    if ( firstRow < endRow )
+    {
+        m_pfnProc( m_pContext, firstRow, endRow );
+    }
+}
@@ -0,0 +1,72 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ParallelRows.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Splits the rows of an image into bands and runs them as tasks on the
+// scheduler the depth stages run on, one band per thread it has.  The calling
+// thread submits the bands and works on them too, and returns once every band
+// is done, so the caller never sees a partly processed frame.
+
+#pragma once
+
+#include "TaskScheduler.h"
+
+#define PARALLEL_ROWS_MAX_BANDS     TASK_MAX_THREADS
+
+// Processes rows firstRow up to, but not including, endRow
+typedef void (*PARALLEL_ROWS_PROC)( void * pContext, UINT firstRow, UINT endRow );
+
+class ParallelRows
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    /// <param name="scheduler">scheduler to run the bands on, from the thread that submits to it</param>
+    ParallelRows( TaskScheduler & scheduler );
+
+    /// <summary>
+    /// Process all rows, split into one band per thread of the scheduler
+    /// </summary>
+    /// <param name="pfnProc">called once for each band</param>
+    /// <param name="pContext">passed through to pfnProc</param>
+    /// <param name="cRows">number of rows</param>
+    void Run( PARALLEL_ROWS_PROC pfnProc, void * pContext, UINT cRows );
+
+    /// <summary>
+    /// Number of threads rows are split over, including the caller's
+    /// </summary>
+    /// <returns>thread count</returns>
+    UINT GetThreadCount( ) const;
+
+private:
+    struct BAND
+    {
+        ParallelRows *  pOwner;
+        UINT            index;
+    };
+
+    /// <summary>
+    /// Task to process a band, calls class instance band processor
+    /// </summary>
+    /// <param name="pContext">band to process</param>
+    static void             RunBandTask( void * pContext );
+
+    /// <summary>
+    /// Process one band of the current Run
+    /// </summary>
+    /// <param name="band">band to process</param>
+    void                    RunBand( UINT band );
+
+    TaskScheduler &         m_scheduler;
+    TaskGraph               m_graph;
+    BAND                    m_bands[PARALLEL_ROWS_MAX_BANDS];
+
+    // The current Run, read by the band tasks
+    PARALLEL_ROWS_PROC      m_pfnProc;
+    void *                  m_pContext;
+    UINT                    m_cRows;
+    UINT                    m_cBands;
+};
@@ -0,0 +1,168 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="PlayerSegmentation.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "PlayerSegmentation.h"
+#include <new>
+
+// Masks reported before the first frame
+static PLAYER_MASK_HEADER g_EmptyMasks = { PLAYER_MASK_MAGIC };
+
+/// <summary>
+/// Constructor
+/// </summary>
+PlayerSegmentation::PlayerSegmentation() :
+    m_width(0),
+    m_height(0),
+    m_pLabels(NULL),
+    m_pLabelRun(NULL),
+    m_pHeader(&g_EmptyMasks),
+    m_pRunEnd(NULL),
+    m_runPlayer(0),
+    m_runLength(0)
+{
+    ZeroMemory(m_rowSpans, sizeof(m_rowSpans));
+    ZeroMemory(m_sumX, sizeof(m_sumX));
+    ZeroMemory(m_sumY, sizeof(m_sumY));
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+PlayerSegmentation::~PlayerSegmentation()
+{
+    delete [] m_pLabels;
+
+    if ( &g_EmptyMasks != m_pHeader )
+    {
+        delete [] reinterpret_cast<BYTE *>(m_pHeader);
+    }
+}
+
+/// <summary>
+/// Start a frame; pixels must then be added in row major order
+/// </summary>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="frameNumber">sensor frame number</param>
+/// <returns>true if successful, false otherwise</returns>
+bool PlayerSegmentation::BeginFrame( DWORD width, DWORD height, DWORD frameNumber )
+{
+    if ( width != m_width || height != m_height )
+    {
+        if ( 0 == width || 0 == height || width > MAXWORD || height > MAXWORD )
+        {
+            return false;
+        }
+
+        delete [] m_pLabels;
+        if ( &g_EmptyMasks != m_pHeader )
+        {
+            delete [] reinterpret_cast<BYTE *>(m_pHeader);
+        }
+
+        // Header and runs share one buffer so they can be handed off in one copy;
+        // every pixel could start a run
+        m_pLabels = new (std::nothrow) BYTE[width * height];
+        BYTE * pPacked = new (std::nothrow) BYTE[GetMaxPackedSize( width, height )];
+        if ( NULL == m_pLabels || NULL == pPacked )
+        {
+            // Back to the state before the first frame, so the next frame tries again
+            delete [] m_pLabels;
+            delete [] pPacked;
+            m_pLabels = NULL;
+            m_pHeader = &g_EmptyMasks;
+            m_width = 0;
+            m_height = 0;
+            return false;
+        }
+
+        m_pHeader = reinterpret_cast<PLAYER_MASK_HEADER *>(pPacked);
+        m_width = width;
+        m_height = height;
+    }
+
+    ZeroMemory( m_pHeader, sizeof(PLAYER_MASK_HEADER) );
+    m_pHeader->dwMagic = PLAYER_MASK_MAGIC;
+    m_pHeader->dwFrameNumber = frameNumber;
+    m_pHeader->usWidth = static_cast<USHORT>(width);
+    m_pHeader->usHeight = static_cast<USHORT>(height);
+
+    for ( int i = 0; i < PLAYER_SEGMENT_COUNT; ++i )
+    {
+        m_pHeader->Players[i].left = MAXLONG;
+        m_pHeader->Players[i].top = MAXLONG;
+        m_pHeader->Players[i].right = -1;
+        m_pHeader->Players[i].bottom = -1;
+    }
+
+    m_pLabelRun = m_pLabels;
+    m_pRunEnd = reinterpret_cast<USHORT *>(m_pHeader + 1);
+    m_runPlayer = 0;
+    m_runLength = 0;
+
+    ZeroMemory( m_rowSpans, sizeof(m_rowSpans) );
+    ZeroMemory( m_sumX, sizeof(m_sumX) );
+    ZeroMemory( m_sumY, sizeof(m_sumY) );
+
+    return true;
+}
+
+/// <summary>
+/// Finish a row of pixels
+/// </summary>
+/// <param name="y">row that was just added</param>
+void PlayerSegmentation::EndRow( DWORD y )
+{
+    for ( int i = 0; i < PLAYER_SEGMENT_COUNT; ++i )
+    {
+        ROW_SPAN & span = m_rowSpans[i];
+        if ( 0 == span.cPixels )
+        {
+            continue;
+        }
+
+        PLAYER_SEGMENT & player = m_pHeader->Players[i];
+        player.cPixels += span.cPixels;
+        player.left = min( player.left, static_cast<LONG>(span.first) );
+        player.right = max( player.right, static_cast<LONG>(span.last) );
+        player.top = min( player.top, static_cast<LONG>(y) );
+        player.bottom = static_cast<LONG>(y);
+
+        m_sumX[i] += span.sumX;
+        m_sumY[i] += static_cast<ULONGLONG>(span.cPixels) * y;
+
+        span.cPixels = 0;
+        span.sumX = 0;
+    }
+}
+
+/// <summary>
+/// Finish the frame and compute its statistics
+/// </summary>
+void PlayerSegmentation::EndFrame( )
+{
+    if ( m_runLength )
+    {
+        *(m_pRunEnd++) = static_cast<USHORT>((m_runPlayer << PLAYER_MASK_RUN_SHIFT) | m_runLength);
+        m_runLength = 0;
+    }
+
+    m_pHeader->cRuns = static_cast<DWORD>(m_pRunEnd - reinterpret_cast<USHORT *>(m_pHeader + 1));
+
+    for ( int i = 0; i < PLAYER_SEGMENT_COUNT; ++i )
+    {
+        PLAYER_SEGMENT & player = m_pHeader->Players[i];
+        if ( 0 == player.cPixels )
+        {
+            ZeroMemory( &player, sizeof(player) );
+            continue;
+        }
+
+        player.centroidX = static_cast<float>(m_sumX[i]) / player.cPixels;
+        player.centroidY = static_cast<float>(m_sumY[i]) / player.cPixels;
+    }
+}
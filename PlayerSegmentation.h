@@ -0,0 +1,164 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="PlayerSegmentation.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Per-player masks and statistics from the player index of depth frames.  The
+// caller feeds pixels from the loop it already runs over the depth buffer, so
+// segmentation costs no extra pass over the frame.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Player indices 1 to 7; 0 is no player
+#define PLAYER_SEGMENT_COUNT        NUI_IMAGE_PLAYER_INDEX_MASK
+
+// Identifies packed player masks ('SVPM')
+#define PLAYER_MASK_MAGIC           0x4D505653
+
+// Each run is a USHORT with the player index in the top bits and the length below
+#define PLAYER_MASK_RUN_SHIFT       13
+#define PLAYER_MASK_MAX_RUN         ((1 << PLAYER_MASK_RUN_SHIFT) - 1)
+
+// Statistics of one player in one frame
+struct PLAYER_SEGMENT
+{
+    DWORD   cPixels;            // 0 if the player isn't in the frame
+    LONG    left;               // bounding box, inclusive
+    LONG    top;
+    LONG    right;
+    LONG    bottom;
+    float   centroidX;
+    float   centroidY;
+};
+
+// Start of the packed masks, followed by cRuns runs covering the frame in row
+// major order.  The mask of player p is every run whose index is p
+struct PLAYER_MASK_HEADER
+{
+    DWORD           dwMagic;
+    DWORD           dwFrameNumber;
+    USHORT          usWidth;
+    USHORT          usHeight;
+    DWORD           cRuns;
+    PLAYER_SEGMENT  Players[PLAYER_SEGMENT_COUNT];  // player index p is at p - 1
+};
+
+class PlayerSegmentation
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    PlayerSegmentation();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~PlayerSegmentation();
+
+    /// <summary>
+    /// Start a frame; pixels must then be added in row major order
+    /// </summary>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    /// <param name="frameNumber">sensor frame number</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool BeginFrame( DWORD width, DWORD height, DWORD frameNumber );
+
+    /// <summary>
+    /// Add the next pixel of the current row
+    /// </summary>
+    /// <param name="x">column of the pixel</param>
+    /// <param name="player">player index of the pixel</param>
+    void AddPixel( DWORD x, USHORT player )
+    {
+        *(m_pLabelRun++) = static_cast<BYTE>(player);
+
+        if ( player != m_runPlayer || PLAYER_MASK_MAX_RUN == m_runLength )
+        {
+            if ( m_runLength )
+            {
+                *(m_pRunEnd++) = static_cast<USHORT>((m_runPlayer << PLAYER_MASK_RUN_SHIFT) | m_runLength);
+            }
+            m_runPlayer = player;
+            m_runLength = 0;
+        }
+        ++m_runLength;
+
+        if ( player )
+        {
+            ROW_SPAN & span = m_rowSpans[player - 1];
+            if ( 0 == span.cPixels )
+            {
+                span.first = x;
+            }
+            span.last = x;
+            span.sumX += x;
+            ++span.cPixels;
+        }
+    }
+
+    /// <summary>
+    /// Finish a row of pixels
+    /// </summary>
+    /// <param name="y">row that was just added</param>
+    void EndRow( DWORD y );
+
+    /// <summary>
+    /// Finish the frame and compute its statistics
+    /// </summary>
+    void EndFrame( );
+
+    /// <summary>
+    /// Statistics of the last frame, player index p is at p - 1
+    /// </summary>
+    const PLAYER_SEGMENT * GetPlayers( ) const { return m_pHeader->Players; }
+
+    /// <summary>
+    /// Player index of every pixel of the last frame
+    /// </summary>
+    const BYTE * GetLabels( ) const { return m_pLabels; }
+
+    /// <summary>
+    /// Masks of the last frame packed for other processes, a PLAYER_MASK_HEADER then its runs
+    /// </summary>
+    const BYTE * GetPackedMasks( ) const { return reinterpret_cast<const BYTE *>(m_pHeader); }
+
+    /// <summary>
+    /// Size (in bytes) of the packed masks of the last frame
+    /// </summary>
+    ULONG GetPackedSize( ) const { return sizeof(PLAYER_MASK_HEADER) + m_pHeader->cRuns * sizeof(USHORT); }
+
+    /// <summary>
+    /// Largest packed size for a frame of the given size
+    /// </summary>
+    static ULONG GetMaxPackedSize( DWORD width, DWORD height ) { return sizeof(PLAYER_MASK_HEADER) + width * height * sizeof(USHORT); }
+
+private:
+    // Pixels of one player in the current row
+    struct ROW_SPAN
+    {
+        DWORD   cPixels;
+        DWORD   first;
+        DWORD   last;
+        DWORD   sumX;
+    };
+
+    DWORD                    m_width;
+    DWORD                    m_height;
+
+    BYTE *                   m_pLabels;
+    BYTE *                   m_pLabelRun;
+
+    PLAYER_MASK_HEADER *     m_pHeader;
+    USHORT *                 m_pRunEnd;
+    USHORT                   m_runPlayer;
+    USHORT                   m_runLength;
+
+    ROW_SPAN                 m_rowSpans[PLAYER_SEGMENT_COUNT];
+    ULONGLONG                m_sumX[PLAYER_SEGMENT_COUNT];
+    ULONGLONG                m_sumY[PLAYER_SEGMENT_COUNT];
+};
@@ -0,0 +1,284 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="PointCloud.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "PointCloud.h"
+#include "DepthKernel.h"
+#include <strsafe.h>
+
+// SIMD loads and stores of the tables and points need 16 byte alignment
+static const size_t g_PointAlignment = 16;
+
+// Size of the buffer PLY vertices are gathered into before each write
+static const UINT g_PlyWriteBufferSize = 64 * 1024;
+
+/// <summary>
+/// Constructor
+/// </summary>
+PointCloud::PointCloud() :
+    m_resolution(NUI_IMAGE_RESOLUTION_INVALID),
+    m_pointCount(0),
+    m_validPointCount(0),
+    m_bPlayerIndex(false),
+    m_pX(NULL),
+    m_pY(NULL),
+    m_pZ(NULL),
+    m_pPlayer(NULL),
+    m_pKernel(NULL)
+{
+    ZeroMemory(m_pRayX, sizeof(m_pRayX));
+    ZeroMemory(m_pRayY, sizeof(m_pRayY));
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+PointCloud::~PointCloud()
+{
+    FreePoints();
+
+    for ( UINT i = 0; i < _countof(m_pRayX); ++i )
+    {
+        _aligned_free( m_pRayX[i] );
+        _aligned_free( m_pRayY[i] );
+    }
+
+    delete m_pKernel;
+}
+
+/// <summary>
+/// Free the point buffers
+/// </summary>
+void PointCloud::FreePoints( )
+{
+    _aligned_free( m_pX );
+    _aligned_free( m_pY );
+    _aligned_free( m_pZ );
+    _aligned_free( m_pPlayer );
+
+    m_pX = NULL;
+    m_pY = NULL;
+    m_pZ = NULL;
+    m_pPlayer = NULL;
+    m_pointCount = 0;
+    m_validPointCount = 0;
+}
+
+/// <summary>
+/// Select the depth resolution of the frames to convert, building its ray
+/// table the first time the resolution is seen
+/// </summary>
+/// <param name="resolution">resolution of the depth stream</param>
+/// <returns>true if successful, false otherwise</returns>
+bool PointCloud::Initialize( NUI_IMAGE_RESOLUTION resolution )
+{
+    if ( resolution == m_resolution )
+    {
+        return true;
+    }
+
+    if ( resolution < 0 || static_cast<UINT>(resolution) >= _countof(m_pRayX) )
+    {
+        return false;
+    }
+
+    DWORD width, height;
+    NuiImageResolutionToSize( resolution, width, height );
+    UINT pointCount = width * height;
+
+    FreePoints( );
+    m_resolution = NUI_IMAGE_RESOLUTION_INVALID;
+
+    // Generate runs the points-only pass of the kernel
+    if ( NULL == m_pKernel )
+    {
+        m_pKernel = new DepthKernel( );
+    }
+
+    // Near mode and the player index don't change the optics, one table per resolution is enough
+    if ( NULL == m_pRayX[resolution] )
+    {
+        float * pRayX = static_cast<float *>(_aligned_malloc( pointCount * sizeof(float), g_PointAlignment ));
+        float * pRayY = static_cast<float *>(_aligned_malloc( pointCount * sizeof(float), g_PointAlignment ));
+        if ( NULL == pRayX || NULL == pRayY )
+        {
+            _aligned_free( pRayX );
+            _aligned_free( pRayY );
+            return false;
+        }
+
+        // Same projection as NuiTransformDepthImageToSkeleton, with depth factored out
+        float scale = NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width;
+        for ( UINT y = 0; y < height; ++y )
+        {
+            float rayY = -(static_cast<float>(y) - height / 2.0f) * scale;
+            for ( UINT x = 0; x < width; ++x )
+            {
+                pRayX[y * width + x] = (static_cast<float>(x) - width / 2.0f) * scale;
+                pRayY[y * width + x] = rayY;
+            }
+        }
+
+        m_pRayX[resolution] = pRayX;
+        m_pRayY[resolution] = pRayY;
+    }
+
+    m_pX = static_cast<float *>(_aligned_malloc( pointCount * sizeof(float), g_PointAlignment ));
+    m_pY = static_cast<float *>(_aligned_malloc( pointCount * sizeof(float), g_PointAlignment ));
+    m_pZ = static_cast<float *>(_aligned_malloc( pointCount * sizeof(float), g_PointAlignment ));
+    m_pPlayer = static_cast<BYTE *>(_aligned_malloc( pointCount, g_PointAlignment ));
+    if ( NULL == m_pX || NULL == m_pY || NULL == m_pZ || NULL == m_pPlayer )
+    {
+        FreePoints( );
+        return false;
+    }
+
+    ZeroMemory( m_pPlayer, pointCount );
+
+    m_resolution = resolution;
+    m_pointCount = pointCount;
+
+    return true;
+}
+
+/// <summary>
+/// Convert a depth frame to points, one per pixel.  Pixels with no depth
+/// become points at the origin
+/// </summary>
+/// <param name="pDepth">packed depth pixels, width * height of them</param>
+/// <param name="bPlayerIndex">also extract the player index of each point</param>
+void PointCloud::Generate( const USHORT * pDepth, bool bPlayerIndex )
+{
+    // The same pass the depth kernel runs alongside its other outputs, on its own
+    DEPTH_KERNEL_TARGETS targets;
+    ZeroMemory( &targets, sizeof(targets) );
+    if ( !BeginFrame( bPlayerIndex, targets.pointCloud ) ||
+         !m_pKernel->Select( bPlayerIndex ? NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX : NUI_IMAGE_TYPE_DEPTH, m_resolution ) )
+    {
+        return;
+    }
+
+    m_pKernel->Run( DEPTH_KERNEL_POINT_CLOUD, pDepth, targets );
+    EndFrame( targets.statistics.cValid );
+}
+
+/// <summary>
+/// Start a frame that another pass over the depth converts, the same way
+/// Generate does
+/// </summary>
+/// <param name="bPlayerIndex">the pass also extracts the player index of each point</param>
+/// <param name="target">receives the ray tables and point buffers to write</param>
+/// <returns>true if successful, false if no resolution is selected</returns>
+bool PointCloud::BeginFrame( bool bPlayerIndex, POINT_CLOUD_TARGET & target )
+{
+    if ( NUI_IMAGE_RESOLUTION_INVALID == m_resolution )
+    {
+        return false;
+    }
+
+    target.pRayX = m_pRayX[m_resolution];
+    target.pRayY = m_pRayY[m_resolution];
+    target.pX = m_pX;
+    target.pY = m_pY;
+    target.pZ = m_pZ;
+    target.pPlayer = bPlayerIndex ? m_pPlayer : NULL;
+
+    m_validPointCount = 0;
+    m_bPlayerIndex = bPlayerIndex;
+
+    return true;
+}
+
+/// <summary>
+/// Write the points that have depth to a binary PLY file
+/// </summary>
+/// <param name="szFileName">file to create or overwrite</param>
+/// <param name="pColors">BGRX color of each point, NULL for none</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT PointCloud::ExportPly( LPCWSTR szFileName, const BYTE * pColors ) const
+{
+    if ( 0 == m_pointCount )
+    {
+        return E_FAIL;
+    }
+
+    char szHeader[256];
+    HRESULT hr = StringCchPrintfA( szHeader, _countof(szHeader),
+        "ply\nformat binary_little_endian 1.0\nelement vertex %u\n"
+        "property float x\nproperty float y\nproperty float z\n%s%s"
+        "end_header\n",
+        m_validPointCount,
+        pColors ? "property uchar red\nproperty uchar green\nproperty uchar blue\n" : "",
+        m_bPlayerIndex ? "property uchar player\n" : "" );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    HANDLE hFile = CreateFileW( szFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( INVALID_HANDLE_VALUE == hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    BYTE * pBuffer = new BYTE[g_PlyWriteBufferSize];
+    UINT cbVertex = 3 * sizeof(float) + (pColors ? 3 : 0) + (m_bPlayerIndex ? 1 : 0);
+    UINT cbBuffered = static_cast<UINT>(strlen( szHeader ));
+    CopyMemory( pBuffer, szHeader, cbBuffered );
+
+    // Vertices are gathered from the arrays and written a buffer at a time
+    for ( UINT i = 0; i < m_pointCount && SUCCEEDED(hr); ++i )
+    {
+        if ( 0.0f == m_pZ[i] )
+        {
+            continue;
+        }
+
+        if ( cbBuffered + cbVertex > g_PlyWriteBufferSize )
+        {
+            DWORD cbWritten;
+            if ( !WriteFile( hFile, pBuffer, cbBuffered, &cbWritten, NULL ) )
+            {
+                hr = HRESULT_FROM_WIN32( GetLastError() );
+            }
+            cbBuffered = 0;
+        }
+
+        BYTE * pVertex = pBuffer + cbBuffered;
+        CopyMemory( pVertex, m_pX + i, sizeof(float) );
+        CopyMemory( pVertex + sizeof(float), m_pY + i, sizeof(float) );
+        CopyMemory( pVertex + 2 * sizeof(float), m_pZ + i, sizeof(float) );
+        pVertex += 3 * sizeof(float);
+
+        if ( pColors )
+        {
+            const BYTE * pColor = pColors + i * sizeof(DWORD);
+            *(pVertex++) = pColor[2];
+            *(pVertex++) = pColor[1];
+            *(pVertex++) = pColor[0];
+        }
+
+        if ( m_bPlayerIndex )
+        {
+            *pVertex = m_pPlayer[i];
+        }
+        cbBuffered += cbVertex;
+    }
+
+    if ( SUCCEEDED(hr) && cbBuffered > 0 )
+    {
+        DWORD cbWritten;
+        if ( !WriteFile( hFile, pBuffer, cbBuffered, &cbWritten, NULL ) )
+        {
+            hr = HRESULT_FROM_WIN32( GetLastError() );
+        }
+    }
+
+    delete [] pBuffer;
+    CloseHandle( hFile );
+
+    return hr;
+}
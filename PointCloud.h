@@ -0,0 +1,129 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="PointCloud.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Converts depth frames to points in skeleton space.  The direction through
+// each depth pixel is computed once per resolution, so a frame costs one
+// multiply per coordinate instead of a NuiTransformDepthImageToSkeleton call
+// per pixel.
+
+#pragma once
+
+#include "NuiApi.h"
+
+class DepthKernel;
+
+// Ray tables and point buffers of the current resolution, for passes over the
+// depth that produce points alongside other outputs.  All are 16 byte aligned
+struct POINT_CLOUD_TARGET
+{
+    const float *   pRayX;
+    const float *   pRayY;
+    float *         pX;
+    float *         pY;
+    float *         pZ;
+    BYTE *          pPlayer;        // NULL unless the player index is wanted
+};
+
+class PointCloud
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    PointCloud();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~PointCloud();
+
+    /// <summary>
+    /// Select the depth resolution of the frames to convert, building its ray
+    /// table the first time the resolution is seen
+    /// </summary>
+    /// <param name="resolution">resolution of the depth stream</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Initialize( NUI_IMAGE_RESOLUTION resolution );
+
+    /// <summary>
+    /// Convert a depth frame to points, one per pixel.  Pixels with no depth
+    /// become points at the origin
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels, width * height of them</param>
+    /// <param name="bPlayerIndex">also extract the player index of each point</param>
+    void Generate( const USHORT * pDepth, bool bPlayerIndex );
+
+    /// <summary>
+    /// Start a frame that another pass over the depth converts, the same way
+    /// Generate does
+    /// </summary>
+    /// <param name="bPlayerIndex">the pass also extracts the player index of each point</param>
+    /// <param name="target">receives the ray tables and point buffers to write</param>
+    /// <returns>true if successful, false if no resolution is selected</returns>
+    bool BeginFrame( bool bPlayerIndex, POINT_CLOUD_TARGET & target );
+
+    /// <summary>
+    /// Finish a frame started with BeginFrame
+    /// </summary>
+    /// <param name="validPointCount">number of pixels that had depth</param>
+    void EndFrame( UINT validPointCount ) { m_validPointCount = validPointCount; }
+
+    /// <summary>
+    /// Write the points that have depth to a binary PLY file
+    /// </summary>
+    /// <param name="szFileName">file to create or overwrite</param>
+    /// <param name="pColors">BGRX color of each point, NULL for none</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT ExportPly( LPCWSTR szFileName, const BYTE * pColors ) const;
+
+    /// <summary>
+    /// Number of points, including those without depth
+    /// </summary>
+    /// <returns>width * height of the current resolution</returns>
+    UINT GetPointCount( ) const { return m_pointCount; }
+
+    /// <summary>
+    /// Number of points that had depth in the last generated frame
+    /// </summary>
+    /// <returns>valid point count</returns>
+    UINT GetValidPointCount( ) const { return m_validPointCount; }
+
+    /// <summary>
+    /// Coordinates (in meters) of the last generated frame, GetPointCount of each
+    /// </summary>
+    const float * GetX( ) const { return m_pX; }
+    const float * GetY( ) const { return m_pY; }
+    const float * GetZ( ) const { return m_pZ; }
+
+    /// <summary>
+    /// Player index of each point, NULL unless requested from Generate
+    /// </summary>
+    const BYTE * GetPlayerIndex( ) const { return m_bPlayerIndex ? m_pPlayer : NULL; }
+
+private:
+    /// <summary>
+    /// Free the point buffers
+    /// </summary>
+    void FreePoints( );
+
+    // Ray tables for each resolution, x and y at a depth of one meter
+    float *                  m_pRayX[NUI_IMAGE_RESOLUTION_640x480 + 1];
+    float *                  m_pRayY[NUI_IMAGE_RESOLUTION_640x480 + 1];
+
+    NUI_IMAGE_RESOLUTION     m_resolution;
+    UINT                     m_pointCount;
+    UINT                     m_validPointCount;
+    bool                     m_bPlayerIndex;
+
+    // Structure of arrays output
+    float *                  m_pX;
+    float *                  m_pY;
+    float *                  m_pZ;
+    BYTE *                   m_pPlayer;
+
+    // Runs the conversion for Generate
+    DepthKernel *            m_pKernel;
+};
@@ -0,0 +1,364 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="RegistrationMap.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "RegistrationMap.h"
+#include <strsafe.h>
+#include <limits.h>
+#include <math.h>
+#include <emmintrin.h>
+
+/// <summary>
+/// Pack a pair of color offsets into the low and high words of a table entry
+/// </summary>
+static inline DWORD PackOffset( LONG x, LONG y )
+{
+    x = max( min( x, SHRT_MAX ), SHRT_MIN );
+    y = max( min( y, SHRT_MAX ), SHRT_MIN );
+
+    return static_cast<USHORT>(x) | (static_cast<DWORD>(static_cast<USHORT>(y)) << 16);
+}
+
+// The calibration of a sensor
+class SensorCalibration : public IRegistrationCalibration
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    /// <param name="pNuiSensor">sensor to ask</param>
+    SensorCalibration( INuiSensor * pNuiSensor ) : m_pNuiSensor(pNuiSensor) { }
+
+    HRESULT GetColorPixelCoordinates( NUI_IMAGE_RESOLUTION colorResolution, NUI_IMAGE_RESOLUTION depthResolution,
+        LONG depthX, LONG depthY, USHORT packedDepth, LONG * pColorX, LONG * pColorY )
+    {
+        return m_pNuiSensor->NuiImageGetColorPixelCoordinatesFromDepthPixelAtResolution(
+            colorResolution, depthResolution, NULL, depthX, depthY, packedDepth, pColorX, pColorY );
+    }
+
+private:
+    INuiSensor *    m_pNuiSensor;
+};
+
+/// <summary>
+/// Constructor
+/// </summary>
+RegistrationMap::RegistrationMap() :
+    m_lInvalid(TRUE),
+    m_depthResolution(NUI_IMAGE_RESOLUTION_INVALID),
+    m_colorResolution(NUI_IMAGE_RESOLUTION_INVALID),
+    m_depthWidth(0),
+    m_depthHeight(0),
+    m_colorWidth(0),
+    m_colorHeight(0),
+    m_blockSize(0),
+    m_blocksDown(0),
+    m_pBase(NULL),
+    m_pTable(NULL),
+    m_pColorCoordinates(NULL),
+    m_pRegisteredColor(NULL)
+{
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+RegistrationMap::~RegistrationMap()
+{
+    Free();
+}
+
+/// <summary>
+/// Free the table and frame buffers
+/// </summary>
+void RegistrationMap::Free( )
+{
+    _aligned_free( m_pTable );
+    m_pTable = NULL;
+
+    _aligned_free( m_pBase );
+    m_pBase = NULL;
+
+    _aligned_free( m_pColorCoordinates );
+    m_pColorCoordinates = NULL;
+
+    _aligned_free( m_pRegisteredColor );
+    m_pRegisteredColor = NULL;
+
+    m_depthResolution = NUI_IMAGE_RESOLUTION_INVALID;
+    m_colorResolution = NUI_IMAGE_RESOLUTION_INVALID;
+}
+
+/// <summary>
+/// Force the table to be rebuilt by the next Update, may be called from any thread
+/// </summary>
+void RegistrationMap::Invalidate( )
+{
+    InterlockedExchange( &m_lInvalid, TRUE );
+}
+
+/// <summary>
+/// Size (in bytes) of the lookup tables
+/// </summary>
+/// <returns>table size, 0 if there is no table</returns>
+ULONG RegistrationMap::GetTableSize( ) const
+{
+    if ( NULL == m_pTable )
+    {
+        return 0;
+    }
+
+    return (REGISTRATION_BLOCKS_ACROSS * m_blocksDown * REGISTRATION_BIN_COUNT + m_depthWidth * m_depthHeight) * sizeof(DWORD);
+}
+
+/// <summary>
+/// Rebuild the table if the resolutions changed or it was invalidated
+/// Must be called on the thread that owns the sensor, with it open, and not
+/// while a frame is being mapped on another thread
+/// </summary>
+/// <param name="pNuiSensor">sensor whose calibration is used</param>
+/// <param name="depthResolution">resolution of the depth frames to map</param>
+/// <param name="colorResolution">resolution of the color frames mapped to</param>
+/// <returns>true if the table is ready, false otherwise</returns>
+bool RegistrationMap::Update( INuiSensor * pNuiSensor, NUI_IMAGE_RESOLUTION depthResolution, NUI_IMAGE_RESOLUTION colorResolution )
+{
+    if ( NULL == pNuiSensor )
+    {
+        Free( );
+        return false;
+    }
+
+    SensorCalibration calibration( pNuiSensor );
+    return Update( calibration, depthResolution, colorResolution );
+}
+
+/// <summary>
+/// Rebuild the table from a calibration if the resolutions changed or it was invalidated
+/// Not to be called while a frame is being mapped on another thread
+/// </summary>
+/// <param name="calibration">color coordinates of depth pixels</param>
+/// <param name="depthResolution">resolution of the depth frames to map</param>
+/// <param name="colorResolution">resolution of the color frames mapped to</param>
+/// <returns>true if the table is ready, false otherwise</returns>
+bool RegistrationMap::Update( IRegistrationCalibration & calibration, NUI_IMAGE_RESOLUTION depthResolution, NUI_IMAGE_RESOLUTION colorResolution )
+{
+    bool bInvalid = ( 0 != InterlockedExchange( &m_lInvalid, FALSE ) );
+
+    if ( !bInvalid && NULL != m_pTable && depthResolution == m_depthResolution && colorResolution == m_colorResolution )
+    {
+        return true;
+    }
+
+    DWORD depthWidth, depthHeight, colorWidth, colorHeight;
+    NuiImageResolutionToSize( depthResolution, depthWidth, depthHeight );
+    NuiImageResolutionToSize( colorResolution, colorWidth, colorHeight );
+
+    // Frames are mapped 8 pixels at a time, and every block must hold whole groups of 8
+    if ( 0 == depthWidth || 0 == colorWidth || 0 != depthWidth % (8 * REGISTRATION_BLOCKS_ACROSS) )
+    {
+        Free( );
+        return false;
+    }
+
+    DWORD startTime = GetTickCount( );
+
+    if ( depthResolution != m_depthResolution || colorResolution != m_colorResolution )
+    {
+        Free( );
+
+        m_depthWidth = depthWidth;
+        m_depthHeight = depthHeight;
+        m_colorWidth = colorWidth;
+        m_colorHeight = colorHeight;
+        m_blockSize = depthWidth / REGISTRATION_BLOCKS_ACROSS;
+        m_blocksDown = (depthHeight + m_blockSize - 1) / m_blockSize;
+
+        m_pTable = static_cast<DWORD *>(_aligned_malloc( REGISTRATION_BLOCKS_ACROSS * m_blocksDown * REGISTRATION_BIN_COUNT * sizeof(DWORD), 16 ));
+        m_pBase = static_cast<DWORD *>(_aligned_malloc( depthWidth * depthHeight * sizeof(DWORD), 16 ));
+        m_pColorCoordinates = static_cast<LONG *>(_aligned_malloc( 2 * depthWidth * depthHeight * sizeof(LONG), 16 ));
+        m_pRegisteredColor = static_cast<BYTE *>(_aligned_malloc( depthWidth * depthHeight * sizeof(DWORD), 16 ));
+        if ( NULL == m_pTable || NULL == m_pBase || NULL == m_pColorCoordinates || NULL == m_pRegisteredColor )
+        {
+            Free( );
+            return false;
+        }
+    }
+
+    // Color coordinates at the reference depth on a grid of block corners
+    DWORD gridWidth = REGISTRATION_BLOCKS_ACROSS + 1;
+    DWORD gridHeight = m_blocksDown + 1;
+    LONG * pGrid = static_cast<LONG *>(_aligned_malloc( 2 * gridWidth * gridHeight * sizeof(LONG), 16 ));
+    if ( NULL == pGrid )
+    {
+        Free( );
+        return false;
+    }
+
+    HRESULT hr = S_OK;
+
+    for ( DWORD gy = 0; gy < gridHeight && SUCCEEDED(hr); ++gy )
+    {
+        for ( DWORD gx = 0; gx < gridWidth && SUCCEEDED(hr); ++gx )
+        {
+            LONG * pSample = pGrid + 2 * (gy * gridWidth + gx);
+            hr = calibration.GetColorPixelCoordinates(
+                colorResolution, depthResolution,
+                min( gx * m_blockSize, m_depthWidth - 1 ), min( gy * m_blockSize, m_depthHeight - 1 ),
+                REGISTRATION_REFERENCE_DEPTH << NUI_IMAGE_PLAYER_INDEX_SHIFT, pSample, pSample + 1 );
+        }
+    }
+
+    // Interpolate the grid to every pixel; the lens makes this smooth
+    for ( DWORD y = 0; y < m_depthHeight && SUCCEEDED(hr); ++y )
+    {
+        DWORD by = y / m_blockSize;
+        DWORD y0 = by * m_blockSize;
+        DWORD y1 = min( y0 + m_blockSize, m_depthHeight - 1 );
+        float fy = static_cast<float>(y - y0) / (y1 - y0);
+
+        for ( DWORD x = 0; x < m_depthWidth; ++x )
+        {
+            DWORD bx = x / m_blockSize;
+            DWORD x0 = bx * m_blockSize;
+            DWORD x1 = min( x0 + m_blockSize, m_depthWidth - 1 );
+            float fx = static_cast<float>(x - x0) / (x1 - x0);
+
+            const LONG * pTop = pGrid + 2 * (by * gridWidth + bx);
+            const LONG * pBottom = pTop + 2 * gridWidth;
+
+            float colorX = (1 - fy) * ((1 - fx) * pTop[0] + fx * pTop[2]) + fy * ((1 - fx) * pBottom[0] + fx * pBottom[2]);
+            float colorY = (1 - fy) * ((1 - fx) * pTop[1] + fx * pTop[3]) + fy * ((1 - fx) * pBottom[1] + fx * pBottom[3]);
+
+            m_pBase[y * m_depthWidth + x] = PackOffset( static_cast<LONG>(floor( colorX + 0.5f )), static_cast<LONG>(floor( colorY + 0.5f )) );
+        }
+    }
+
+    _aligned_free( pGrid );
+
+    // Parallax from the reference depth to the middle of each bin, at the center of each block
+    DWORD * pEntry = m_pTable;
+    for ( DWORD by = 0; by < m_blocksDown && SUCCEEDED(hr); ++by )
+    {
+        LONG depthY = min( by * m_blockSize + m_blockSize / 2, m_depthHeight - 1 );
+
+        for ( DWORD bx = 0; bx < REGISTRATION_BLOCKS_ACROSS && SUCCEEDED(hr); ++bx )
+        {
+            LONG depthX = bx * m_blockSize + m_blockSize / 2;
+            DWORD base = m_pBase[depthY * m_depthWidth + depthX];
+
+            for ( DWORD bin = 0; bin < REGISTRATION_BIN_COUNT && SUCCEEDED(hr); ++bin )
+            {
+                USHORT depth = static_cast<USHORT>(((bin << REGISTRATION_BIN_SHIFT) + (1 << (REGISTRATION_BIN_SHIFT - 1))) << NUI_IMAGE_PLAYER_INDEX_SHIFT);
+                LONG colorX = 0, colorY = 0;
+
+                hr = calibration.GetColorPixelCoordinates(
+                    colorResolution, depthResolution, depthX, depthY, depth, &colorX, &colorY );
+
+                *(pEntry++) = PackOffset( colorX - static_cast<SHORT>(LOWORD(base)), colorY - static_cast<SHORT>(HIWORD(base)) );
+            }
+        }
+    }
+
+    if ( FAILED(hr) )
+    {
+        // Leave the table unusable, the next Update tries again
+        Free( );
+        return false;
+    }
+
+    m_depthResolution = depthResolution;
+    m_colorResolution = colorResolution;
+
+    WCHAR szReport[128];
+    StringCchPrintfW( szReport, _countof(szReport), L"Registration: %u byte table built in %u ms\r\n", GetTableSize( ), GetTickCount( ) - startTime );
+    OutputDebugString( szReport );
+
+    return true;
+}
+
+/// <summary>
+/// Compute the color coordinates of every pixel of a depth frame
+/// </summary>
+/// <param name="pDepth">packed depth pixels at the resolution passed to Update</param>
+void RegistrationMap::MapFrame( const USHORT * pDepth )
+{
+    if ( NULL == m_pTable )
+    {
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128( );
+
+    __declspec(align(16)) USHORT bins[8];
+    const DWORD * pBase = m_pBase;
+    LONG * pOut = m_pColorCoordinates;
+
+    for ( DWORD y = 0; y < m_depthHeight; ++y )
+    {
+        const DWORD * pRowTable = m_pTable + (y / m_blockSize) * REGISTRATION_BLOCKS_ACROSS * REGISTRATION_BIN_COUNT;
+        const USHORT * pRow = pDepth + y * m_depthWidth;
+
+        for ( DWORD x = 0; x < m_depthWidth; x += 8 )
+        {
+            const DWORD * pBlock = pRowTable + (x / m_blockSize) * REGISTRATION_BIN_COUNT;
+
+            __m128i depth = _mm_srli_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i *>(pRow + x) ), NUI_IMAGE_PLAYER_INDEX_SHIFT );
+            _mm_store_si128( reinterpret_cast<__m128i *>(bins), _mm_srli_epi16( depth, REGISTRATION_BIN_SHIFT ) );
+
+            // SSE2 has no gather, the table lookups are the only scalar step
+            __m128i parallaxLow  = _mm_set_epi32( pBlock[bins[3]], pBlock[bins[2]], pBlock[bins[1]], pBlock[bins[0]] );
+            __m128i parallaxHigh = _mm_set_epi32( pBlock[bins[7]], pBlock[bins[6]], pBlock[bins[5]], pBlock[bins[4]] );
+
+            // x and y are added in their own words
+            __m128i packedLow  = _mm_add_epi16( _mm_load_si128( reinterpret_cast<const __m128i *>(pBase) ), parallaxLow );
+            __m128i packedHigh = _mm_add_epi16( _mm_load_si128( reinterpret_cast<const __m128i *>(pBase + 4) ), parallaxHigh );
+            pBase += 8;
+
+            // Pixels without depth map to -1
+            __m128i holes = _mm_cmpeq_epi16( depth, zero );
+            __m128i holesLow = _mm_unpacklo_epi16( holes, holes );
+            __m128i holesHigh = _mm_unpackhi_epi16( holes, holes );
+
+            // Sign extend the coordinates out of the low and high words
+            __m128i xLow  = _mm_or_si128( _mm_srai_epi32( _mm_slli_epi32( packedLow, 16 ), 16 ), holesLow );
+            __m128i xHigh = _mm_or_si128( _mm_srai_epi32( _mm_slli_epi32( packedHigh, 16 ), 16 ), holesHigh );
+            __m128i yLow  = _mm_or_si128( _mm_srai_epi32( packedLow, 16 ), holesLow );
+            __m128i yHigh = _mm_or_si128( _mm_srai_epi32( packedHigh, 16 ), holesHigh );
+
+            _mm_store_si128( reinterpret_cast<__m128i *>(pOut),      _mm_unpacklo_epi32( xLow, yLow ) );
+            _mm_store_si128( reinterpret_cast<__m128i *>(pOut + 4),  _mm_unpackhi_epi32( xLow, yLow ) );
+            _mm_store_si128( reinterpret_cast<__m128i *>(pOut + 8),  _mm_unpacklo_epi32( xHigh, yHigh ) );
+            _mm_store_si128( reinterpret_cast<__m128i *>(pOut + 12), _mm_unpackhi_epi32( xHigh, yHigh ) );
+            pOut += 16;
+        }
+    }
+}
+
+/// <summary>
+/// Sample a color frame at the coordinates from the last MapFrame
+/// </summary>
+/// <param name="pColor">BGRX pixels at the color resolution passed to Update</param>
+void RegistrationMap::RegisterColor( const BYTE * pColor )
+{
+    if ( NULL == m_pTable )
+    {
+        return;
+    }
+
+    const DWORD * pColorPixels = reinterpret_cast<const DWORD *>(pColor);
+    DWORD * pOut = reinterpret_cast<DWORD *>(m_pRegisteredColor);
+    const LONG * pCoordinates = m_pColorCoordinates;
+    DWORD pixelCount = m_depthWidth * m_depthHeight;
+
+    for ( DWORD i = 0; i < pixelCount; ++i, pCoordinates += 2 )
+    {
+        // Negative coordinates wrap around to large unsigned values
+        DWORD colorX = static_cast<DWORD>(pCoordinates[0]);
+        DWORD colorY = static_cast<DWORD>(pCoordinates[1]);
+
+        pOut[i] = ( colorX < m_colorWidth && colorY < m_colorHeight ) ? pColorPixels[colorY * m_colorWidth + colorX] : 0;
+    }
+}
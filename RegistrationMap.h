@@ -0,0 +1,141 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="RegistrationMap.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Maps whole depth frames to color image coordinates.  Each pixel's color
+// coordinate at a reference depth is kept in a base map interpolated from a
+// coarse grid, and the parallax between the two cameras, which depends mostly
+// on depth and only slowly on position, is kept per image block and depth bin.
+// The sensor is only asked when the tables are built, through
+// IRegistrationCalibration, so the tables can be built without one.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Depth frames are split into this many blocks across; blocks are square
+#define REGISTRATION_BLOCKS_ACROSS  10
+
+// Millimeters of depth per table entry, as a shift
+#define REGISTRATION_BIN_SHIFT      4
+#define REGISTRATION_BIN_COUNT      (1 << (16 - NUI_IMAGE_PLAYER_INDEX_SHIFT - REGISTRATION_BIN_SHIFT))
+
+// Depth (in millimeters) the base map is sampled at
+#define REGISTRATION_REFERENCE_DEPTH 2000
+
+// Color coordinates of depth pixels, as the sensor's calibration gives them
+class IRegistrationCalibration
+{
+public:
+    virtual ~IRegistrationCalibration() { }
+
+    /// <summary>
+    /// Color coordinates of one depth pixel
+    /// </summary>
+    /// <param name="colorResolution">resolution of the color image</param>
+    /// <param name="depthResolution">resolution of the depth image</param>
+    /// <param name="depthX">column of the depth pixel</param>
+    /// <param name="depthY">row of the depth pixel</param>
+    /// <param name="packedDepth">depth of the pixel, shifted as in a depth frame</param>
+    /// <param name="pColorX">receives the column in the color image</param>
+    /// <param name="pColorY">receives the row in the color image</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    virtual HRESULT GetColorPixelCoordinates( NUI_IMAGE_RESOLUTION colorResolution, NUI_IMAGE_RESOLUTION depthResolution,
+        LONG depthX, LONG depthY, USHORT packedDepth, LONG * pColorX, LONG * pColorY ) = 0;
+};
+
+class RegistrationMap
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    RegistrationMap();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~RegistrationMap();
+
+    /// <summary>
+    /// Rebuild the table if the resolutions changed or it was invalidated
+    /// Must be called on the thread that owns the sensor, with it open, and not
+    /// while a frame is being mapped on another thread
+    /// </summary>
+    /// <param name="pNuiSensor">sensor whose calibration is used</param>
+    /// <param name="depthResolution">resolution of the depth frames to map</param>
+    /// <param name="colorResolution">resolution of the color frames mapped to</param>
+    /// <returns>true if the table is ready, false otherwise</returns>
+    bool Update( INuiSensor * pNuiSensor, NUI_IMAGE_RESOLUTION depthResolution, NUI_IMAGE_RESOLUTION colorResolution );
+
+    /// <summary>
+    /// Rebuild the table from a calibration if the resolutions changed or it was invalidated
+    /// Not to be called while a frame is being mapped on another thread
+    /// </summary>
+    /// <param name="calibration">color coordinates of depth pixels</param>
+    /// <param name="depthResolution">resolution of the depth frames to map</param>
+    /// <param name="colorResolution">resolution of the color frames mapped to</param>
+    /// <returns>true if the table is ready, false otherwise</returns>
+    bool Update( IRegistrationCalibration & calibration, NUI_IMAGE_RESOLUTION depthResolution, NUI_IMAGE_RESOLUTION colorResolution );
+
+    /// <summary>
+    /// Force the table to be rebuilt by the next Update, may be called from any thread
+    /// </summary>
+    void Invalidate( );
+
+    /// <summary>
+    /// Compute the color coordinates of every pixel of a depth frame
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels at the resolution passed to Update</param>
+    void MapFrame( const USHORT * pDepth );
+
+    /// <summary>
+    /// Sample a color frame at the coordinates from the last MapFrame
+    /// </summary>
+    /// <param name="pColor">BGRX pixels at the color resolution passed to Update</param>
+    void RegisterColor( const BYTE * pColor );
+
+    /// <summary>
+    /// x, y pairs of color coordinates from the last MapFrame, -1 where there was no depth
+    /// </summary>
+    const LONG * GetColorCoordinates( ) const { return m_pColorCoordinates; }
+
+    /// <summary>
+    /// BGRX color of each depth pixel from the last RegisterColor, black where unknown
+    /// </summary>
+    const BYTE * GetRegisteredColor( ) const { return m_pRegisteredColor; }
+
+    /// <summary>
+    /// Size (in bytes) of the lookup tables
+    /// </summary>
+    /// <returns>table size, 0 if there is no table</returns>
+    ULONG GetTableSize( ) const;
+
+private:
+    /// <summary>
+    /// Free the table and frame buffers
+    /// </summary>
+    void Free( );
+
+    volatile LONG            m_lInvalid;
+    NUI_IMAGE_RESOLUTION     m_depthResolution;
+    NUI_IMAGE_RESOLUTION     m_colorResolution;
+
+    DWORD                    m_depthWidth;
+    DWORD                    m_depthHeight;
+    DWORD                    m_colorWidth;
+    DWORD                    m_colorHeight;
+    DWORD                    m_blockSize;
+    DWORD                    m_blocksDown;
+
+    // Color x in the low word and y in the high word at the reference depth, per pixel
+    DWORD *                  m_pBase;
+
+    // Offset from the base map, same packing, per block and depth bin
+    DWORD *                  m_pTable;
+
+    LONG *                   m_pColorCoordinates;
+    BYTE *                   m_pRegisteredColor;
+};
@@ -0,0 +1,91 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SensorConnection.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "SensorConnection.h"
+
+/// <summary>
+/// Constructor
+/// </summary>
+/// <param name="device">sensor to drive</param>
+/// <param name="csSensor">lock held by everything that uses the sensor</param>
+SensorConnection::SensorConnection( ISensorDevice & device, CRITICAL_SECTION & csSensor ) :
+    m_device(device),
+    m_csSensor(csSensor),
+    m_reconnectStartTime(0),
+    m_bReconnectPending(false),
+    m_cReconnects(0)
+{
+}
+
+/// <summary>
+/// Release a sensor that has been unplugged
+/// </summary>
+void SensorConnection::Disconnect( )
+{
+    EnterCriticalSection( &m_csSensor );
+
+    m_device.ReleaseSensor( );
+    m_bReconnectPending = false;
+
+    LeaveCriticalSection( &m_csSensor );
+}
+
+/// <summary>
+/// Re-acquire the sensor after a disconnect and re-open its streams.  No UI
+/// is shown, so this may run on the status callback thread
+/// </summary>
+/// <param name="instanceName">instance name of the sensor</param>
+/// <param name="errorId">receives the error string resource to report on failure, 0 if there's nothing to report</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT SensorConnection::Reconnect( const WCHAR * instanceName, UINT & errorId )
+{
+    DWORD startTime = GetTickCount( );
+    errorId = 0;
+
+    EnterCriticalSection( &m_csSensor );
+
+    // A sensor that isn't ready yet reports again once it is, so a failure here isn't shown
+    HRESULT hr = m_device.AcquireSensor( instanceName );
+    if ( SUCCEEDED(hr) )
+    {
+        hr = m_device.OpenSensorStreams( errorId );
+    }
+
+    if ( SUCCEEDED(hr) )
+    {
+        m_reconnectStartTime = startTime;
+        m_bReconnectPending = true;
+    }
+    else
+    {
+        m_device.ReleaseSensor( );
+        m_bReconnectPending = false;
+    }
+
+    LeaveCriticalSection( &m_csSensor );
+
+    return hr;
+}
+
+/// <summary>
+/// Note a frame taken from the sensor.  Caller must hold the sensor lock
+/// </summary>
+/// <param name="milliseconds">receives the time from the start of the reconnect to this frame</param>
+/// <returns>true if this is the first frame after a reconnect, false otherwise</returns>
+bool SensorConnection::FrameTaken( DWORD & milliseconds )
+{
+    if ( !m_bReconnectPending )
+    {
+        return false;
+    }
+
+    milliseconds = GetTickCount( ) - m_reconnectStartTime;
+    m_bReconnectPending = false;
+    InterlockedIncrement( &m_cReconnects );
+
+    return true;
+}
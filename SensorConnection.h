@@ -0,0 +1,88 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SensorConnection.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Carries the pipeline across the sensor being unplugged and plugged back in.
+// A disconnect only closes the streams and lets go of the sensor; a reconnect
+// only acquires it again and re-opens the streams, so events, buffers, render
+// resources, threads and skeleton history all survive, and the first frame
+// after it reports how long the reconnect took.  The sensor is only reached
+// through ISensorDevice, so the hot-plug path runs without one.
+
+#pragma once
+
+// The sensor, as the connection drives it; all are called with the sensor lock held
+class ISensorDevice
+{
+public:
+    virtual ~ISensorDevice() { }
+
+    /// <summary>
+    /// Acquire the sensor with an instance name, in place of any held before
+    /// </summary>
+    /// <param name="instanceName">instance name of the sensor</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    virtual HRESULT AcquireSensor( const WCHAR * instanceName ) = 0;
+
+    /// <summary>
+    /// Open the streams of the sensor acquired
+    /// </summary>
+    /// <param name="errorId">receives the error string resource to report on failure</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    virtual HRESULT OpenSensorStreams( UINT & errorId ) = 0;
+
+    /// <summary>
+    /// Close the streams, if open, and let go of the sensor, if held
+    /// </summary>
+    virtual void ReleaseSensor( ) = 0;
+};
+
+class SensorConnection
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    /// <param name="device">sensor to drive</param>
+    /// <param name="csSensor">lock held by everything that uses the sensor</param>
+    SensorConnection( ISensorDevice & device, CRITICAL_SECTION & csSensor );
+
+    /// <summary>
+    /// Release a sensor that has been unplugged
+    /// </summary>
+    void Disconnect( );
+
+    /// <summary>
+    /// Re-acquire the sensor after a disconnect and re-open its streams.  No UI
+    /// is shown, so this may run on the status callback thread
+    /// </summary>
+    /// <param name="instanceName">instance name of the sensor</param>
+    /// <param name="errorId">receives the error string resource to report on failure, 0 if there's nothing to report</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Reconnect( const WCHAR * instanceName, UINT & errorId );
+
+    /// <summary>
+    /// Note a frame taken from the sensor.  Caller must hold the sensor lock
+    /// </summary>
+    /// <param name="milliseconds">receives the time from the start of the reconnect to this frame</param>
+    /// <returns>true if this is the first frame after a reconnect, false otherwise</returns>
+    bool FrameTaken( DWORD & milliseconds );
+
+    /// <summary>
+    /// Reconnects that have been completed by a frame
+    /// </summary>
+    /// <returns>number of reconnects</returns>
+    UINT GetReconnectCount( ) const { return m_cReconnects; }
+
+private:
+    ISensorDevice &     m_device;
+    CRITICAL_SECTION &  m_csSensor;
+
+    // GetTickCount() when the reconnect awaiting its first frame started
+    DWORD               m_reconnectStartTime;
+    bool                m_bReconnectPending;
+
+    volatile LONG       m_cReconnects;
+};
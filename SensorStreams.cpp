@@ -0,0 +1,93 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SensorStreams.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "SensorStreams.h"
+
+/// <summary>
+/// Take the next frame of an image stream and lock it
+/// </summary>
+/// <param name="pNuiSensor">sensor the stream belongs to</param>
+/// <param name="hStream">stream from NuiImageStreamOpen</param>
+/// <param name="frame">receives the locked frame, to be given back with SensorReleaseImageFrame</param>
+/// <returns>S_OK if successful, E_FAIL if the buffer was bogus and the frame has been given back, otherwise the sensor's error</returns>
+HRESULT SensorTakeImageFrame( INuiSensor * pNuiSensor, HANDLE hStream, SENSOR_IMAGE_FRAME & frame )
+{
+    ZeroMemory( &frame, sizeof(frame) );
+
+    HRESULT hr = pNuiSensor->NuiImageStreamGetNextFrame( hStream, 0, &frame.imageFrame );
+    if ( FAILED(hr) )
+    {
+        frame.imageFrame.pFrameTexture = NULL;
+        return hr;
+    }
+
+    frame.hStream = hStream;
+    frame.imageFrame.pFrameTexture->LockRect( 0, &frame.lockedRect, NULL, 0 );
+    if ( 0 == frame.lockedRect.Pitch )
+    {
+        SensorReleaseImageFrame( pNuiSensor, frame );
+        return E_FAIL;
+    }
+
+    NuiImageResolutionToSize( frame.imageFrame.eResolution, frame.width, frame.height );
+
+    return S_OK;
+}
+
+/// <summary>
+/// Unlock an image frame and give it back to the sensor
+/// </summary>
+/// <param name="pNuiSensor">sensor the frame was taken from</param>
+/// <param name="frame">frame from SensorTakeImageFrame, whose texture is cleared</param>
+void SensorReleaseImageFrame( INuiSensor * pNuiSensor, SENSOR_IMAGE_FRAME & frame )
+{
+    if ( NULL == frame.imageFrame.pFrameTexture )
+    {
+        return;
+    }
+
+    frame.imageFrame.pFrameTexture->UnlockRect( 0 );
+    pNuiSensor->NuiImageStreamReleaseFrame( frame.hStream, &frame.imageFrame );
+    frame.imageFrame.pFrameTexture = NULL;
+}
+
+/// <summary>
+/// Take the next skeleton frame and smooth it if anyone is tracked in it
+/// </summary>
+/// <param name="pNuiSensor">sensor with skeleton tracking enabled</param>
+/// <param name="frame">receives the frame, zeroed if none could be taken</param>
+/// <param name="bFoundSkeleton">receives whether a skeleton is tracked or has its position</param>
+/// <returns>S_OK if successful, otherwise the error taking or smoothing the frame</returns>
+HRESULT SensorTakeSkeletonFrame( INuiSensor * pNuiSensor, NUI_SKELETON_FRAME & frame, bool & bFoundSkeleton )
+{
+    bFoundSkeleton = false;
+
+    HRESULT hr = pNuiSensor->NuiSkeletonGetNextFrame( 0, &frame );
+    if ( FAILED(hr) )
+    {
+        ZeroMemory( &frame, sizeof(frame) );
+        return hr;
+    }
+
+    for ( int i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        NUI_SKELETON_TRACKING_STATE trackingState = frame.SkeletonData[i].eTrackingState;
+
+        if ( NUI_SKELETON_TRACKED == trackingState || NUI_SKELETON_POSITION_ONLY == trackingState )
+        {
+            bFoundSkeleton = true;
+        }
+    }
+
+    // An empty frame has nothing to smooth
+    if ( !bFoundSkeleton )
+    {
+        return S_OK;
+    }
+
+    return pNuiSensor->NuiTransformSmooth( &frame, NULL );
+}
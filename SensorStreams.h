@@ -0,0 +1,49 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SensorStreams.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Taking frames from the streams of a sensor.  The viewer and SkeletalFrames.dll
+// both take their frames through these, so the two handle the sensor alike: an
+// image frame is taken locked in the sensor's buffer and given back with its
+// lock, and a skeleton frame is smoothed whenever anyone is in it.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// An image frame taken from the sensor, still in the sensor's buffer
+struct SENSOR_IMAGE_FRAME
+{
+    HANDLE              hStream;
+    NUI_IMAGE_FRAME     imageFrame;
+    NUI_LOCKED_RECT     lockedRect;     // pBits valid until the frame is given back
+    DWORD               width;
+    DWORD               height;
+};
+
+/// <summary>
+/// Take the next frame of an image stream and lock it
+/// </summary>
+/// <param name="pNuiSensor">sensor the stream belongs to</param>
+/// <param name="hStream">stream from NuiImageStreamOpen</param>
+/// <param name="frame">receives the locked frame, to be given back with SensorReleaseImageFrame</param>
+/// <returns>S_OK if successful, E_FAIL if the buffer was bogus and the frame has been given back, otherwise the sensor's error</returns>
+HRESULT SensorTakeImageFrame( INuiSensor * pNuiSensor, HANDLE hStream, SENSOR_IMAGE_FRAME & frame );
+
+/// <summary>
+/// Unlock an image frame and give it back to the sensor
+/// </summary>
+/// <param name="pNuiSensor">sensor the frame was taken from</param>
+/// <param name="frame">frame from SensorTakeImageFrame, whose texture is cleared</param>
+void SensorReleaseImageFrame( INuiSensor * pNuiSensor, SENSOR_IMAGE_FRAME & frame );
+
+/// <summary>
+/// Take the next skeleton frame and smooth it if anyone is tracked in it
+/// </summary>
+/// <param name="pNuiSensor">sensor with skeleton tracking enabled</param>
+/// <param name="frame">receives the frame, zeroed if none could be taken</param>
+/// <param name="bFoundSkeleton">receives whether a skeleton is tracked or has its position</param>
+/// <returns>S_OK if successful, otherwise the error taking or smoothing the frame</returns>
+HRESULT SensorTakeSkeletonFrame( INuiSensor * pNuiSensor, NUI_SKELETON_FRAME & frame, bool & bFoundSkeleton );
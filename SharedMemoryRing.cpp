@@ -0,0 +1,315 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SharedMemoryRing.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "SharedMemoryRing.h"
+
+// Keep slot payloads 16 byte aligned so readers can use SIMD loads on them
+static const DWORD g_SlotAlignment = 16;
+
+// Header size, rounded up so the first slot is aligned
+static const DWORD g_cbHeader = (sizeof(SHARED_RING_HEADER) + g_SlotAlignment - 1) & ~(g_SlotAlignment - 1);
+
+/// <summary>
+/// Constructor
+/// </summary>
+SharedMemoryRing::SharedMemoryRing() :
+    m_hMapping(NULL),
+    m_pView(NULL),
+    m_bWriter(false)
+{
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+SharedMemoryRing::~SharedMemoryRing()
+{
+    Close();
+}
+
+/// <summary>
+/// Create the named mapping for writing
+/// </summary>
+/// <param name="szName">name of the file mapping</param>
+/// <param name="cbSlot">size (in bytes) of the payload of each slot</param>
+/// <param name="cSlots">number of slots in the ring</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT SharedMemoryRing::Create( LPCWSTR szName, DWORD cbSlot, DWORD cSlots )
+{
+    Close();
+
+    if ( 0 == cbSlot || cSlots < 2 )
+    {
+        return E_INVALIDARG;
+    }
+
+    DWORD cbSlotStride = (g_SlotAlignment + cbSlot + g_SlotAlignment - 1) & ~(g_SlotAlignment - 1);
+    ULONGLONG cbMapping = g_cbHeader + static_cast<ULONGLONG>(cbSlotStride) * cSlots;
+
+    m_hMapping = CreateFileMappingW(
+        INVALID_HANDLE_VALUE,
+        NULL,
+        PAGE_READWRITE,
+        static_cast<DWORD>(cbMapping >> 32),
+        static_cast<DWORD>(cbMapping),
+        szName );
+
+    if ( NULL == m_hMapping )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Readers may be keeping a ring from a previous run of the writer alive
+    bool bExisting = ( ERROR_ALREADY_EXISTS == GetLastError() );
+
+    m_pView = static_cast<BYTE *>(MapViewOfFile( m_hMapping, FILE_MAP_WRITE, 0, 0, 0 ));
+    if ( NULL == m_pView )
+    {
+        HRESULT hr = HRESULT_FROM_WIN32( GetLastError() );
+        Close();
+        return hr;
+    }
+
+    SHARED_RING_HEADER * pHeader = reinterpret_cast<SHARED_RING_HEADER *>(m_pView);
+
+    if ( bExisting )
+    {
+        // Carry on from where the previous writer stopped if the layout is the same
+        if ( SHARED_RING_MAGIC != pHeader->dwMagic || cbSlot != pHeader->cbSlot || cSlots != pHeader->cSlots )
+        {
+            Close();
+            return HRESULT_FROM_WIN32( ERROR_ALREADY_EXISTS );
+        }
+
+        m_bWriter = true;
+        return S_OK;
+    }
+
+    // Pages of a new mapping are zero, so every slot starts at sequence 0
+    pHeader->cbSlot = cbSlot;
+    pHeader->cbSlotStride = cbSlotStride;
+    pHeader->cSlots = cSlots;
+    pHeader->dwWriteCount = 0;
+
+    // Readers check the magic last
+    InterlockedExchange( reinterpret_cast<volatile LONG *>(&pHeader->dwMagic), SHARED_RING_MAGIC );
+
+    m_bWriter = true;
+
+    return S_OK;
+}
+
+/// <summary>
+/// Map an existing ring read-only; a mapping too small for the slots its header describes is refused
+/// </summary>
+/// <param name="szName">name of the file mapping</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT SharedMemoryRing::Open( LPCWSTR szName )
+{
+    Close();
+
+    m_hMapping = OpenFileMappingW( FILE_MAP_READ, FALSE, szName );
+    if ( NULL == m_hMapping )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    m_pView = static_cast<BYTE *>(MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 ));
+    if ( NULL == m_pView )
+    {
+        HRESULT hr = HRESULT_FROM_WIN32( GetLastError() );
+        Close();
+        return hr;
+    }
+
+    // The view is as large as the mapping, whatever another process wrote in the header
+    MEMORY_BASIC_INFORMATION info;
+    if ( 0 == VirtualQuery( m_pView, &info, sizeof(info) ) || info.RegionSize < g_cbHeader )
+    {
+        Close();
+        return E_FAIL;
+    }
+
+    const SHARED_RING_HEADER * pHeader = reinterpret_cast<const SHARED_RING_HEADER *>(m_pView);
+    if ( SHARED_RING_MAGIC != pHeader->dwMagic ||
+         0 == pHeader->cbSlot || pHeader->cSlots < 2 ||
+         pHeader->cbSlotStride < g_SlotAlignment + static_cast<ULONGLONG>(pHeader->cbSlot) ||
+         info.RegionSize < g_cbHeader + static_cast<ULONGLONG>(pHeader->cbSlotStride) * pHeader->cSlots )
+    {
+        Close();
+        return E_FAIL;
+    }
+
+    m_bWriter = false;
+
+    return S_OK;
+}
+
+/// <summary>
+/// Unmap the ring
+/// </summary>
+void SharedMemoryRing::Close( )
+{
+    if ( NULL != m_pView )
+    {
+        UnmapViewOfFile( m_pView );
+        m_pView = NULL;
+    }
+
+    if ( NULL != m_hMapping )
+    {
+        CloseHandle( m_hMapping );
+        m_hMapping = NULL;
+    }
+
+    m_bWriter = false;
+}
+
+/// <summary>
+/// Slot that publication index lives in
+/// </summary>
+SHARED_RING_SLOT * SharedMemoryRing::GetSlot( DWORD index ) const
+{
+    const SHARED_RING_HEADER * pHeader = reinterpret_cast<const SHARED_RING_HEADER *>(m_pView);
+
+    return reinterpret_cast<SHARED_RING_SLOT *>(
+        m_pView + g_cbHeader + static_cast<SIZE_T>(index % pHeader->cSlots) * pHeader->cbSlotStride);
+}
+
+/// <summary>
+/// Claim the next slot for writing; must be followed by EndWrite
+/// </summary>
+/// <returns>payload of the slot, NULL if the ring is not open for writing</returns>
+BYTE * SharedMemoryRing::BeginWrite( )
+{
+    if ( !m_bWriter )
+    {
+        return NULL;
+    }
+
+    SHARED_RING_HEADER * pHeader = reinterpret_cast<SHARED_RING_HEADER *>(m_pView);
+    DWORD index = pHeader->dwWriteCount;
+    SHARED_RING_SLOT * pSlot = GetSlot( index );
+
+    // Odd sequence tells readers the slot is being rewritten
+    InterlockedExchange( reinterpret_cast<volatile LONG *>(&pSlot->dwSequence), static_cast<LONG>(2 * index + 1) );
+
+    return reinterpret_cast<BYTE *>(pSlot) + g_SlotAlignment;
+}
+
+/// <summary>
+/// Publish the slot claimed by BeginWrite
+/// </summary>
+void SharedMemoryRing::EndWrite( )
+{
+    if ( !m_bWriter )
+    {
+        return;
+    }
+
+    SHARED_RING_HEADER * pHeader = reinterpret_cast<SHARED_RING_HEADER *>(m_pView);
+    DWORD index = pHeader->dwWriteCount;
+
+    InterlockedExchange( reinterpret_cast<volatile LONG *>(&GetSlot( index )->dwSequence), static_cast<LONG>(2 * index + 2) );
+    InterlockedExchange( reinterpret_cast<volatile LONG *>(&pHeader->dwWriteCount), static_cast<LONG>(index + 1) );
+}
+
+/// <summary>
+/// Number of slots published so far
+/// </summary>
+/// <returns>publication count, the newest is at index count - 1</returns>
+DWORD SharedMemoryRing::GetWriteCount( ) const
+{
+    if ( NULL == m_pView )
+    {
+        return 0;
+    }
+
+    return reinterpret_cast<const SHARED_RING_HEADER *>(m_pView)->dwWriteCount;
+}
+
+/// <summary>
+/// Size (in bytes) of the payload of each slot
+/// </summary>
+/// <returns>payload size</returns>
+DWORD SharedMemoryRing::GetSlotSize( ) const
+{
+    if ( NULL == m_pView )
+    {
+        return 0;
+    }
+
+    return reinterpret_cast<const SHARED_RING_HEADER *>(m_pView)->cbSlot;
+}
+
+/// <summary>
+/// Get a pointer to a publication without copying it; the data must be
+/// checked with Validate once the reader is done with it
+/// </summary>
+/// <param name="index">publication index, less than GetWriteCount</param>
+/// <returns>payload of the publication, NULL if it has already been overwritten</returns>
+const BYTE * SharedMemoryRing::Peek( DWORD index ) const
+{
+    if ( NULL == m_pView )
+    {
+        return NULL;
+    }
+
+    const SHARED_RING_SLOT * pSlot = GetSlot( index );
+    if ( 2 * index + 2 != pSlot->dwSequence )
+    {
+        return NULL;
+    }
+
+    // Don't let the payload reads move ahead of the sequence check
+    MemoryBarrier();
+
+    return reinterpret_cast<const BYTE *>(pSlot) + g_SlotAlignment;
+}
+
+/// <summary>
+/// Check that a publication returned by Peek was not overwritten while it was being read
+/// </summary>
+/// <param name="index">publication index passed to Peek</param>
+/// <returns>true if the data read was consistent, false otherwise</returns>
+bool SharedMemoryRing::Validate( DWORD index ) const
+{
+    if ( NULL == m_pView )
+    {
+        return false;
+    }
+
+    // Payload reads must complete before the sequence is checked again
+    MemoryBarrier();
+
+    return 2 * index + 2 == GetSlot( index )->dwSequence;
+}
+
+/// <summary>
+/// Copy a publication out of the ring
+/// </summary>
+/// <param name="index">publication index, less than GetWriteCount</param>
+/// <param name="pDest">buffer to receive the payload</param>
+/// <param name="cbDest">number of bytes to copy, at most GetSlotSize</param>
+/// <returns>true if a consistent copy was made, false if the slot was overwritten</returns>
+bool SharedMemoryRing::Read( DWORD index, void * pDest, DWORD cbDest ) const
+{
+    if ( cbDest > GetSlotSize() )
+    {
+        return false;
+    }
+
+    const BYTE * pPayload = Peek( index );
+    if ( NULL == pPayload )
+    {
+        return false;
+    }
+
+    CopyMemory( pDest, pPayload, cbDest );
+
+    return Validate( index );
+}
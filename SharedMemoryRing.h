@@ -0,0 +1,127 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SharedMemoryRing.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Single writer, many reader ring of fixed size slots in a named file mapping.
+// The writer never waits for readers; each slot carries a sequence number so a
+// reader can tell when the slot it is looking at was overwritten underneath it.
+// Counts and sequences are unsigned and wrap; a reader would have to stall for
+// 2^31 publications to mistake one for another.
+
+#pragma once
+
+// Identifies a mapping created by SharedMemoryRing ('SVRG')
+#define SHARED_RING_MAGIC   0x47525653
+
+// Start of the mapping, followed by cSlots slots of cbSlotStride bytes each
+struct SHARED_RING_HEADER
+{
+    DWORD           dwMagic;
+    DWORD           cbSlot;
+    DWORD           cbSlotStride;
+    DWORD           cSlots;
+
+    // number of slots published so far; the newest is at index dwWriteCount - 1
+    volatile DWORD  dwWriteCount;
+};
+
+// Start of every slot, followed by cbSlot bytes of payload
+struct SHARED_RING_SLOT
+{
+    // 2 * n + 1 while publication n is being written, 2 * n + 2 once it is complete
+    volatile DWORD  dwSequence;
+};
+
+class SharedMemoryRing
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    SharedMemoryRing();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~SharedMemoryRing();
+
+    /// <summary>
+    /// Create the named mapping for writing
+    /// </summary>
+    /// <param name="szName">name of the file mapping</param>
+    /// <param name="cbSlot">size (in bytes) of the payload of each slot</param>
+    /// <param name="cSlots">number of slots in the ring</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Create( LPCWSTR szName, DWORD cbSlot, DWORD cSlots );
+
+    /// <summary>
+    /// Map an existing ring read-only; a mapping too small for the slots its header describes is refused
+    /// </summary>
+    /// <param name="szName">name of the file mapping</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Open( LPCWSTR szName );
+
+    /// <summary>
+    /// Unmap the ring
+    /// </summary>
+    void Close( );
+
+    /// <summary>
+    /// Claim the next slot for writing; must be followed by EndWrite
+    /// </summary>
+    /// <returns>payload of the slot, NULL if the ring is not open for writing</returns>
+    BYTE * BeginWrite( );
+
+    /// <summary>
+    /// Publish the slot claimed by BeginWrite
+    /// </summary>
+    void EndWrite( );
+
+    /// <summary>
+    /// Number of slots published so far
+    /// </summary>
+    /// <returns>publication count, the newest is at index count - 1</returns>
+    DWORD GetWriteCount( ) const;
+
+    /// <summary>
+    /// Size (in bytes) of the payload of each slot
+    /// </summary>
+    /// <returns>payload size</returns>
+    DWORD GetSlotSize( ) const;
+
+    /// <summary>
+    /// Get a pointer to a publication without copying it; the data must be
+    /// checked with Validate once the reader is done with it
+    /// </summary>
+    /// <param name="index">publication index, less than GetWriteCount</param>
+    /// <returns>payload of the publication, NULL if it has already been overwritten</returns>
+    const BYTE * Peek( DWORD index ) const;
+
+    /// <summary>
+    /// Check that a publication returned by Peek was not overwritten while it was being read
+    /// </summary>
+    /// <param name="index">publication index passed to Peek</param>
+    /// <returns>true if the data read was consistent, false otherwise</returns>
+    bool Validate( DWORD index ) const;
+
+    /// <summary>
+    /// Copy a publication out of the ring
+    /// </summary>
+    /// <param name="index">publication index, less than GetWriteCount</param>
+    /// <param name="pDest">buffer to receive the payload</param>
+    /// <param name="cbDest">number of bytes to copy, at most GetSlotSize</param>
+    /// <returns>true if a consistent copy was made, false if the slot was overwritten</returns>
+    bool Read( DWORD index, void * pDest, DWORD cbDest ) const;
+
+private:
+    HANDLE                   m_hMapping;
+    BYTE *                   m_pView;
+    bool                     m_bWriter;
+
+    /// <summary>
+    /// Slot that publication index lives in
+    /// </summary>
+    SHARED_RING_SLOT * GetSlot( DWORD index ) const;
+};
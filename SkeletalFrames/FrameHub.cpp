@@ -0,0 +1,704 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FrameHub.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "FrameHub.h"
+
+// Sizes of the frames a hub hands out
+static const DWORD g_DepthWidth = 320;
+static const DWORD g_DepthHeight = 240;
+static const DWORD g_ColorWidth = 640;
+static const DWORD g_ColorHeight = 480;
+
+/// <summary>
+/// Resolution of depth frames of a width
+/// </summary>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="resolution">receives the resolution</param>
+/// <returns>true if depth comes in frames of the width, false otherwise</returns>
+static bool DepthResolution( DWORD width, NUI_IMAGE_RESOLUTION & resolution )
+{
+    switch ( width )
+    {
+    case 80:
+        resolution = NUI_IMAGE_RESOLUTION_80x60;
+        return true;
+
+    case 320:
+        resolution = NUI_IMAGE_RESOLUTION_320x240;
+        return true;
+
+    case 640:
+        resolution = NUI_IMAGE_RESOLUTION_640x480;
+        return true;
+    }
+
+    return false;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+FrameHub::FrameHub() :
+    m_kind(FRAME_HUB_SENSOR),
+    m_streams(0),
+    m_cRefs(1),
+    m_hThread(NULL),
+    m_hStop(NULL),
+    m_pFree(NULL),
+    m_pPublisher(NULL),
+    m_pNuiSensor(NULL),
+    m_standInFrameNumber(0)
+{
+    ZeroMemory( m_pNewest, sizeof(m_pNewest) );
+    ZeroMemory( m_hFramePosted, sizeof(m_hFramePosted) );
+    ZeroMemory( m_hNextFrame, sizeof(m_hNextFrame) );
+    ZeroMemory( m_hImageStream, sizeof(m_hImageStream) );
+
+    InitializeCriticalSection( &m_csFrames );
+    InitializeCriticalSection( &m_csPublisher );
+    InitializeCriticalSection( &m_csKernel );
+}
+
+/// <summary>
+/// Destructor, only reached through Release
+/// </summary>
+FrameHub::~FrameHub()
+{
+    // Every frame has been released by now, so the sensor has all its buffers back
+    if ( m_pNuiSensor )
+    {
+        m_pNuiSensor->NuiShutdown( );
+        m_pNuiSensor->Release( );
+    }
+
+    while ( m_pFree )
+    {
+        SVF_FRAME * pFrame = m_pFree;
+        m_pFree = pFrame->pNextFree;
+
+        delete [] pFrame->pBuffer;
+        delete pFrame;
+    }
+
+    for ( int i = 0; i < SVF_STREAM_COUNT; ++i )
+    {
+        if ( m_hFramePosted[i] )
+        {
+            CloseHandle( m_hFramePosted[i] );
+        }
+
+        if ( m_hNextFrame[i] )
+        {
+            CloseHandle( m_hNextFrame[i] );
+        }
+    }
+
+    if ( m_hStop )
+    {
+        CloseHandle( m_hStop );
+    }
+
+    DeleteCriticalSection( &m_csFrames );
+    DeleteCriticalSection( &m_csPublisher );
+    DeleteCriticalSection( &m_csKernel );
+}
+
+/// <summary>
+/// Open a sensor and start taking its frames
+/// </summary>
+/// <param name="index">index of the sensor</param>
+/// <param name="streams">SVF_STREAM_FLAG_ values of the streams to open</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT FrameHub::OpenSensor( int index, DWORD streams )
+{
+    m_kind = FRAME_HUB_SENSOR;
+    m_streams = streams;
+
+    HRESULT hr = NuiCreateSensorByIndex( index, &m_pNuiSensor );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    // Skeleton tracking runs on depth, whether or not depth is handed out
+    DWORD nuiFlags = 0;
+    if ( streams & (SVF_STREAM_FLAG_DEPTH | SVF_STREAM_FLAG_SKELETON) )
+    {
+        nuiFlags |= NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX;
+    }
+    if ( streams & SVF_STREAM_FLAG_COLOR )
+    {
+        nuiFlags |= NUI_INITIALIZE_FLAG_USES_COLOR;
+    }
+    if ( streams & SVF_STREAM_FLAG_SKELETON )
+    {
+        nuiFlags |= NUI_INITIALIZE_FLAG_USES_SKELETON;
+    }
+
+    hr = m_pNuiSensor->NuiInitialize( nuiFlags );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    for ( int i = 0; i < SVF_STREAM_COUNT; ++i )
+    {
+        m_hNextFrame[i] = CreateEvent( NULL, TRUE, FALSE, NULL );
+        if ( NULL == m_hNextFrame[i] )
+        {
+            return HRESULT_FROM_WIN32( GetLastError( ) );
+        }
+    }
+
+    // The most frames the sensor keeps, so a caller holding one or two doesn't starve the stream
+    if ( streams & SVF_STREAM_FLAG_DEPTH )
+    {
+        hr = m_pNuiSensor->NuiImageStreamOpen( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, NUI_IMAGE_RESOLUTION_320x240, 0,
+            NUI_IMAGE_STREAM_FRAME_LIMIT_MAXIMUM, m_hNextFrame[SVF_STREAM_DEPTH], &m_hImageStream[SVF_STREAM_DEPTH] );
+        if ( FAILED(hr) )
+        {
+            return hr;
+        }
+    }
+
+    if ( streams & SVF_STREAM_FLAG_COLOR )
+    {
+        hr = m_pNuiSensor->NuiImageStreamOpen( NUI_IMAGE_TYPE_COLOR, NUI_IMAGE_RESOLUTION_640x480, 0,
+            NUI_IMAGE_STREAM_FRAME_LIMIT_MAXIMUM, m_hNextFrame[SVF_STREAM_COLOR], &m_hImageStream[SVF_STREAM_COLOR] );
+        if ( FAILED(hr) )
+        {
+            return hr;
+        }
+    }
+
+    if ( streams & SVF_STREAM_FLAG_SKELETON )
+    {
+        hr = m_pNuiSensor->NuiSkeletonTrackingEnable( m_hNextFrame[SVF_STREAM_SKELETON], 0 );
+        if ( FAILED(hr) )
+        {
+            return hr;
+        }
+    }
+
+    return Start( );
+}
+
+/// <summary>
+/// Start rendering the stand-in scene
+/// </summary>
+/// <param name="streams">SVF_STREAM_FLAG_ values of the streams to render</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT FrameHub::OpenStandIn( DWORD streams )
+{
+    m_kind = FRAME_HUB_STAND_IN;
+    m_streams = streams;
+
+    return Start( );
+}
+
+/// <summary>
+/// Create the events and start the thread
+/// </summary>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT FrameHub::Start( )
+{
+    m_hStop = CreateEvent( NULL, TRUE, FALSE, NULL );
+    if ( NULL == m_hStop )
+    {
+        return HRESULT_FROM_WIN32( GetLastError( ) );
+    }
+
+    for ( int i = 0; i < SVF_STREAM_COUNT; ++i )
+    {
+        m_hFramePosted[i] = CreateEvent( NULL, FALSE, FALSE, NULL );
+        if ( NULL == m_hFramePosted[i] )
+        {
+            return HRESULT_FROM_WIN32( GetLastError( ) );
+        }
+    }
+
+    m_hThread = CreateThread( NULL, 0, FrameThread, this, 0, NULL );
+    if ( NULL == m_hThread )
+    {
+        return HRESULT_FROM_WIN32( GetLastError( ) );
+    }
+
+    return S_OK;
+}
+
+/// <summary>
+/// Stop taking frames and drop the caller's reference; the hub is deleted once every frame is released
+/// </summary>
+void FrameHub::Close( )
+{
+    if ( m_hThread )
+    {
+        SetEvent( m_hStop );
+        WaitForSingleObject( m_hThread, INFINITE );
+        CloseHandle( m_hThread );
+        m_hThread = NULL;
+    }
+
+    // Nothing is published now, so other processes see the ring go with the source
+    delete m_pPublisher;
+    m_pPublisher = NULL;
+
+    // Nobody will take these now
+    for ( int i = 0; i < SVF_STREAM_COUNT; ++i )
+    {
+        if ( m_pNewest[i] )
+        {
+            ReleaseFrame( m_pNewest[i] );
+            m_pNewest[i] = NULL;
+        }
+    }
+
+    Release( );
+}
+
+/// <summary>
+/// Drop a reference, deleting the hub with the last one
+/// </summary>
+void FrameHub::Release( )
+{
+    if ( 0 == InterlockedDecrement( &m_cRefs ) )
+    {
+        delete this;
+    }
+}
+
+/// <summary>
+/// Wait for the newest frame of a stream that hasn't been handed out yet
+/// </summary>
+/// <param name="stream">SVF_STREAM_ value</param>
+/// <param name="timeout">milliseconds to wait, INFINITE to wait until a frame comes</param>
+/// <param name="ppFrame">receives the frame with a reference for the caller</param>
+/// <returns>S_OK if successful, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if no frame came in time, otherwise an error code</returns>
+HRESULT FrameHub::WaitFrame( DWORD stream, DWORD timeout, SVF_FRAME ** ppFrame )
+{
+    *ppFrame = NULL;
+
+    if ( stream >= SVF_STREAM_COUNT || 0 == (m_streams & (1 << stream)) )
+    {
+        return E_INVALIDARG;
+    }
+
+    HANDLE hWait[2] = { m_hFramePosted[stream], m_hStop };
+    DWORD startTime = GetTickCount( );
+
+    for ( ;; )
+    {
+        // The hub's reference passes to the caller
+        EnterCriticalSection( &m_csFrames );
+        SVF_FRAME * pFrame = m_pNewest[stream];
+        m_pNewest[stream] = NULL;
+        LeaveCriticalSection( &m_csFrames );
+
+        if ( pFrame )
+        {
+            *ppFrame = pFrame;
+            return S_OK;
+        }
+
+        DWORD remaining = INFINITE;
+        if ( INFINITE != timeout )
+        {
+            DWORD elapsed = GetTickCount( ) - startTime;
+            remaining = elapsed < timeout ? timeout - elapsed : 0;
+        }
+
+        // A frame taken by another caller after the event was set only costs another wait
+        DWORD result = WaitForMultipleObjects( _countof(hWait), hWait, FALSE, remaining );
+        if ( WAIT_TIMEOUT == result )
+        {
+            return HRESULT_FROM_WIN32( ERROR_TIMEOUT );
+        }
+
+        if ( WAIT_OBJECT_0 != result )
+        {
+            return E_ABORT;
+        }
+    }
+}
+
+/// <summary>
+/// Publish every skeleton frame from now on, as the viewer does with -publish
+/// </summary>
+/// <param name="udpPort">localhost port to send datagrams to as well, 0 for shared memory only</param>
+/// <returns>S_OK if successful, E_INVALIDARG without a skeleton stream, otherwise an error code</returns>
+HRESULT FrameHub::PublishSkeletons( USHORT udpPort )
+{
+    if ( 0 == (m_streams & SVF_STREAM_FLAG_SKELETON) )
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = S_OK;
+
+    EnterCriticalSection( &m_csPublisher );
+
+    // A second call only adds its port
+    if ( NULL == m_pPublisher )
+    {
+        SkeletonPublisher * pPublisher = new SkeletonPublisher( );
+        hr = pPublisher->Initialize( );
+        if ( SUCCEEDED(hr) )
+        {
+            m_pPublisher = pPublisher;
+        }
+        else
+        {
+            delete pPublisher;
+        }
+    }
+
+    if ( SUCCEEDED(hr) && 0 != udpPort )
+    {
+        SKELETON_UDP_SUBSCRIBER subscriber = { udpPort, 0, SKELETON_ALL_JOINTS };
+        hr = m_pPublisher->AddUdpSubscriber( subscriber );
+    }
+
+    LeaveCriticalSection( &m_csPublisher );
+
+    return hr;
+}
+
+/// <summary>
+/// Colorize a depth frame as the viewer's depth view shows it
+/// </summary>
+/// <param name="pFrame">packed depth frame of any hub</param>
+/// <param name="pBGRX">receives width * height BGRX pixels</param>
+/// <param name="cbBGRX">bytes at pBGRX</param>
+/// <returns>S_OK if successful, E_INVALIDARG if the frame isn't packed depth or the buffer is too small</returns>
+HRESULT FrameHub::ColorizeDepth( const SVF_FRAME * pFrame, BYTE * pBGRX, DWORD cbBGRX )
+{
+    const SVF_FRAME_INFO & info = pFrame->info;
+
+    NUI_IMAGE_RESOLUTION resolution;
+    if ( SVF_FORMAT_DEPTH16 != info.dwFormat || !DepthResolution( info.dwWidth, resolution ) ||
+         info.dwStride != info.dwWidth * sizeof(USHORT) || cbBGRX < info.dwWidth * info.dwHeight * 4 )
+    {
+        return E_INVALIDARG;
+    }
+
+    DEPTH_KERNEL_TARGETS targets;
+    ZeroMemory( &targets, sizeof(targets) );
+    targets.pRGBX = pBGRX;
+
+    // The fixed shading, with players tinted as in the viewer
+    FrameHub * pHub = pFrame->pHub;
+    HRESULT hr = S_OK;
+
+    EnterCriticalSection( &pHub->m_csKernel );
+    if ( pHub->m_depthKernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolution ) )
+    {
+        pHub->m_depthKernel.Run( DEPTH_KERNEL_COLORIZE, static_cast<const USHORT *>(info.pData), targets );
+    }
+    else
+    {
+        hr = E_INVALIDARG;
+    }
+    LeaveCriticalSection( &pHub->m_csKernel );
+
+    return hr;
+}
+
+/// <summary>
+/// Take another reference to a frame
+/// </summary>
+/// <param name="pFrame">frame to reference</param>
+void FrameHub::AddRefFrame( SVF_FRAME * pFrame )
+{
+    InterlockedIncrement( &pFrame->cRefs );
+}
+
+/// <summary>
+/// Release a reference to a frame, giving it back to its hub with the last one
+/// </summary>
+/// <param name="pFrame">frame to release</param>
+void FrameHub::ReleaseFrame( SVF_FRAME * pFrame )
+{
+    if ( 0 != InterlockedDecrement( &pFrame->cRefs ) )
+    {
+        return;
+    }
+
+    FrameHub * pHub = pFrame->pHub;
+    pHub->Recycle( pFrame );
+    pHub->Release( );
+}
+
+/// <summary>
+/// Thread to take or render frames, calls class instance thread processor
+/// </summary>
+/// <param name="pParam">instance pointer</param>
+/// <returns>always 0</returns>
+DWORD WINAPI FrameHub::FrameThread( LPVOID pParam )
+{
+    FrameHub * pThis = static_cast<FrameHub *>(pParam);
+
+    switch ( pThis->m_kind )
+    {
+    case FRAME_HUB_SENSOR:
+        pThis->TakeSensorFrames( );
+        break;
+
+    case FRAME_HUB_STAND_IN:
+        pThis->RenderStandInFrames( );
+        break;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Take frames from the sensor as they come, until the hub is closed
+/// </summary>
+void FrameHub::TakeSensorFrames( )
+{
+    HANDLE hEvents[1 + SVF_STREAM_COUNT] = { m_hStop, m_hNextFrame[SVF_STREAM_DEPTH], m_hNextFrame[SVF_STREAM_COLOR], m_hNextFrame[SVF_STREAM_SKELETON] };
+
+    for ( ;; )
+    {
+        DWORD result = WaitForMultipleObjects( _countof(hEvents), hEvents, FALSE, INFINITE );
+        if ( result <= WAIT_OBJECT_0 || result > WAIT_OBJECT_0 + SVF_STREAM_COUNT )
+        {
+            break;
+        }
+
+        DWORD stream = result - WAIT_OBJECT_0 - 1;
+        if ( SVF_STREAM_SKELETON == stream )
+        {
+            TakeSkeletonFrame( );
+        }
+        else
+        {
+            TakeImageFrame( stream );
+        }
+    }
+}
+
+/// <summary>
+/// Render the stand-in scene every FRAME_HUB_STAND_IN_INTERVAL, until the hub is closed
+/// </summary>
+void FrameHub::RenderStandInFrames( )
+{
+    DWORD startTime = GetTickCount( );
+    DWORD nextTime = startTime;
+
+    for ( ;; )
+    {
+        // Frames are due on a fixed schedule, however long the last took to render
+        DWORD now = GetTickCount( );
+        DWORD wait = static_cast<LONG>(nextTime - now) > 0 ? nextTime - now : 0;
+        if ( WAIT_TIMEOUT != WaitForSingleObject( m_hStop, wait ) )
+        {
+            break;
+        }
+
+        LONGLONG timeStamp = nextTime - startTime;
+        nextTime += FRAME_HUB_STAND_IN_INTERVAL;
+        ++m_standInFrameNumber;
+
+        m_scene.Update( timeStamp );
+
+        if ( m_streams & SVF_STREAM_FLAG_DEPTH )
+        {
+            SVF_FRAME * pFrame = AllocFrame( SVF_STREAM_DEPTH, g_DepthWidth * g_DepthHeight * sizeof(USHORT) );
+            m_scene.RenderDepth( reinterpret_cast<USHORT *>(pFrame->pBuffer), g_DepthWidth, g_DepthHeight );
+            pFrame->info.dwFormat = SVF_FORMAT_DEPTH16;
+            pFrame->info.dwWidth = g_DepthWidth;
+            pFrame->info.dwHeight = g_DepthHeight;
+            pFrame->info.dwStride = g_DepthWidth * sizeof(USHORT);
+            pFrame->info.dwBytesPerPixel = sizeof(USHORT);
+            pFrame->info.dwFrameNumber = m_standInFrameNumber;
+            pFrame->info.liTimeStamp = timeStamp;
+            Post( pFrame );
+        }
+
+        if ( m_streams & SVF_STREAM_FLAG_COLOR )
+        {
+            SVF_FRAME * pFrame = AllocFrame( SVF_STREAM_COLOR, g_ColorWidth * g_ColorHeight * 4 );
+            m_scene.RenderColor( pFrame->pBuffer, g_ColorWidth, g_ColorHeight );
+            pFrame->info.dwFormat = SVF_FORMAT_BGRX32;
+            pFrame->info.dwWidth = g_ColorWidth;
+            pFrame->info.dwHeight = g_ColorHeight;
+            pFrame->info.dwStride = g_ColorWidth * 4;
+            pFrame->info.dwBytesPerPixel = 4;
+            pFrame->info.dwFrameNumber = m_standInFrameNumber;
+            pFrame->info.liTimeStamp = timeStamp;
+            Post( pFrame );
+        }
+
+        if ( m_streams & SVF_STREAM_FLAG_SKELETON )
+        {
+            SVF_FRAME * pFrame = AllocFrame( SVF_STREAM_SKELETON, sizeof(NUI_SKELETON_FRAME) );
+            NUI_SKELETON_FRAME * pSkeletonFrame = reinterpret_cast<NUI_SKELETON_FRAME *>(pFrame->pBuffer);
+            m_scene.RenderSkeleton( *pSkeletonFrame );
+            pSkeletonFrame->dwFrameNumber = m_standInFrameNumber;
+            pSkeletonFrame->liTimeStamp.QuadPart = timeStamp;
+
+            pFrame->info.dwFormat = SVF_FORMAT_SKELETON_FRAME;
+            pFrame->info.dwWidth = 1;
+            pFrame->info.dwHeight = 1;
+            pFrame->info.dwStride = sizeof(NUI_SKELETON_FRAME);
+            pFrame->info.dwBytesPerPixel = sizeof(NUI_SKELETON_FRAME);
+            pFrame->info.dwFrameNumber = m_standInFrameNumber;
+            pFrame->info.liTimeStamp = timeStamp;
+            Post( pFrame );
+        }
+    }
+}
+
+/// <summary>
+/// Take the next frame of a sensor image stream, leaving it locked in the sensor's buffer
+/// </summary>
+/// <param name="stream">SVF_STREAM_DEPTH or SVF_STREAM_COLOR</param>
+void FrameHub::TakeImageFrame( DWORD stream )
+{
+    SVF_FRAME * pFrame = AllocFrame( stream, 0 );
+
+    // Fails when callers hold every frame the sensor keeps; this one is dropped
+    SENSOR_IMAGE_FRAME & sensorFrame = pFrame->sensorFrame;
+    if ( FAILED(SensorTakeImageFrame( m_pNuiSensor, m_hImageStream[stream], sensorFrame )) )
+    {
+        ReleaseFrame( pFrame );
+        return;
+    }
+
+    pFrame->info.dwFormat = ( SVF_STREAM_DEPTH == stream ) ? SVF_FORMAT_DEPTH16 : SVF_FORMAT_BGRX32;
+    pFrame->info.dwWidth = sensorFrame.width;
+    pFrame->info.dwHeight = sensorFrame.height;
+    pFrame->info.dwStride = sensorFrame.lockedRect.Pitch;
+    pFrame->info.dwBytesPerPixel = ( SVF_STREAM_DEPTH == stream ) ? sizeof(USHORT) : 4;
+    pFrame->info.dwFrameNumber = sensorFrame.imageFrame.dwFrameNumber;
+    pFrame->info.liTimeStamp = sensorFrame.imageFrame.liTimeStamp.QuadPart;
+    pFrame->info.pData = sensorFrame.lockedRect.pBits;
+    pFrame->info.cbData = sensorFrame.lockedRect.size;
+
+    Post( pFrame );
+}
+
+/// <summary>
+/// Take the next skeleton frame from the sensor, smoothed if anyone is in it
+/// </summary>
+void FrameHub::TakeSkeletonFrame( )
+{
+    SVF_FRAME * pFrame = AllocFrame( SVF_STREAM_SKELETON, sizeof(NUI_SKELETON_FRAME) );
+
+    NUI_SKELETON_FRAME * pSkeletonFrame = reinterpret_cast<NUI_SKELETON_FRAME *>(pFrame->pBuffer);
+    bool bFoundSkeleton;
+    if ( FAILED(SensorTakeSkeletonFrame( m_pNuiSensor, *pSkeletonFrame, bFoundSkeleton )) )
+    {
+        ReleaseFrame( pFrame );
+        return;
+    }
+
+    pFrame->info.dwFormat = SVF_FORMAT_SKELETON_FRAME;
+    pFrame->info.dwWidth = 1;
+    pFrame->info.dwHeight = 1;
+    pFrame->info.dwStride = sizeof(NUI_SKELETON_FRAME);
+    pFrame->info.dwBytesPerPixel = sizeof(NUI_SKELETON_FRAME);
+    pFrame->info.dwFrameNumber = pSkeletonFrame->dwFrameNumber;
+    pFrame->info.liTimeStamp = pSkeletonFrame->liTimeStamp.QuadPart;
+
+    Post( pFrame );
+}
+
+/// <summary>
+/// Get a frame, recycled if one is free, with room for a buffer
+/// </summary>
+/// <param name="stream">SVF_STREAM_ value the frame belongs to</param>
+/// <param name="cbBuffer">bytes the hub fills itself, 0 for a sensor image frame</param>
+/// <returns>frame with one reference</returns>
+SVF_FRAME * FrameHub::AllocFrame( DWORD stream, DWORD cbBuffer )
+{
+    EnterCriticalSection( &m_csFrames );
+    SVF_FRAME * pFrame = m_pFree;
+    if ( pFrame )
+    {
+        m_pFree = pFrame->pNextFree;
+    }
+    LeaveCriticalSection( &m_csFrames );
+
+    if ( NULL == pFrame )
+    {
+        pFrame = new SVF_FRAME;
+        pFrame->pBuffer = NULL;
+        pFrame->cbBuffer = 0;
+    }
+
+    // Frames of every stream share the free list, so a buffer only ever grows to the largest
+    if ( pFrame->cbBuffer < cbBuffer )
+    {
+        delete [] pFrame->pBuffer;
+        pFrame->pBuffer = new BYTE[cbBuffer];
+        pFrame->cbBuffer = cbBuffer;
+    }
+
+    pFrame->pHub = this;
+    pFrame->cRefs = 1;
+    ZeroMemory( &pFrame->info, sizeof(pFrame->info) );
+    pFrame->info.cbSize = sizeof(pFrame->info);
+    pFrame->info.dwStream = stream;
+    pFrame->info.pData = pFrame->pBuffer;
+    pFrame->info.cbData = cbBuffer;
+    ZeroMemory( &pFrame->sensorFrame, sizeof(pFrame->sensorFrame) );
+    pFrame->pNextFree = NULL;
+
+    InterlockedIncrement( &m_cRefs );
+
+    return pFrame;
+}
+
+/// <summary>
+/// Give a frame's sensor buffer back and put the frame on the free list
+/// </summary>
+/// <param name="pFrame">frame with no references left</param>
+void FrameHub::Recycle( SVF_FRAME * pFrame )
+{
+    SensorReleaseImageFrame( m_pNuiSensor, pFrame->sensorFrame );
+
+    EnterCriticalSection( &m_csFrames );
+    pFrame->pNextFree = m_pFree;
+    m_pFree = pFrame;
+    LeaveCriticalSection( &m_csFrames );
+}
+
+/// <summary>
+/// Make a frame the newest of its stream, dropping the one it replaces if nobody took it;
+/// skeleton frames are published first
+/// </summary>
+/// <param name="pFrame">frame, whose reference passes to the hub</param>
+void FrameHub::Post( SVF_FRAME * pFrame )
+{
+    DWORD stream = pFrame->info.dwStream;
+
+    // Frames nobody here takes are still published, as the viewer publishes every frame
+    if ( SVF_STREAM_SKELETON == stream )
+    {
+        EnterCriticalSection( &m_csPublisher );
+        if ( m_pPublisher )
+        {
+            m_pPublisher->Publish( *reinterpret_cast<const NUI_SKELETON_FRAME *>(pFrame->pBuffer) );
+        }
+        LeaveCriticalSection( &m_csPublisher );
+    }
+
+    EnterCriticalSection( &m_csFrames );
+    SVF_FRAME * pDropped = m_pNewest[stream];
+    m_pNewest[stream] = pFrame;
+    LeaveCriticalSection( &m_csFrames );
+
+    // Released outside the lock, a sensor frame goes back to the sensor
+    if ( pDropped )
+    {
+        ReleaseFrame( pDropped );
+    }
+
+    SetEvent( m_hFramePosted[stream] );
+}
@@ -0,0 +1,216 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FrameHub.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// The source behind an SVF_SOURCE handle.  A thread takes frames from the
+// sensor, or renders the stand-in scene, and keeps the newest frame of each
+// stream for the next caller to take.  Sensor image frames are handed out
+// still locked in the sensor's buffers and given back to the sensor when
+// their last reference goes; skeleton and stand-in frames live in buffers the
+// hub recycles.  Each frame holds a reference to its hub, so a closed hub
+// stays open until its last frame is released.  Frames are taken, smoothed,
+// colorized and published by the same modules the viewer uses.
+
+#pragma once
+
+#include "NuiApi.h"
+#include "SensorStreams.h"
+#include "DepthKernel.h"
+#include "SkeletonPublisher.h"
+#include "SkeletalFrames.h"
+#include "StandInScene.h"
+
+enum FRAME_HUB_KIND
+{
+    FRAME_HUB_SENSOR = 0,
+    FRAME_HUB_STAND_IN
+};
+
+// Milliseconds between stand-in frames
+#define FRAME_HUB_STAND_IN_INTERVAL     33
+
+class FrameHub;
+
+struct SVF_SOURCE
+{
+};
+
+struct SVF_FRAME
+{
+    FrameHub *          pHub;
+    volatile LONG       cRefs;
+    SVF_FRAME_INFO      info;
+
+    // Frame still in the sensor's buffers, NULL imageFrame.pFrameTexture otherwise
+    SENSOR_IMAGE_FRAME  sensorFrame;
+
+    // Buffer the hub fills itself
+    BYTE *              pBuffer;
+    DWORD               cbBuffer;
+
+    SVF_FRAME *         pNextFree;
+};
+
+class FrameHub : public SVF_SOURCE
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    FrameHub();
+
+    /// <summary>
+    /// Open a sensor and start taking its frames
+    /// </summary>
+    /// <param name="index">index of the sensor</param>
+    /// <param name="streams">SVF_STREAM_FLAG_ values of the streams to open</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT OpenSensor( int index, DWORD streams );
+
+    /// <summary>
+    /// Start rendering the stand-in scene
+    /// </summary>
+    /// <param name="streams">SVF_STREAM_FLAG_ values of the streams to render</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT OpenStandIn( DWORD streams );
+
+    /// <summary>
+    /// Stop taking frames and drop the caller's reference; the hub is deleted once every frame is released
+    /// </summary>
+    void Close( );
+
+    /// <summary>
+    /// Wait for the newest frame of a stream that hasn't been handed out yet
+    /// </summary>
+    /// <param name="stream">SVF_STREAM_ value</param>
+    /// <param name="timeout">milliseconds to wait, INFINITE to wait until a frame comes</param>
+    /// <param name="ppFrame">receives the frame with a reference for the caller</param>
+    /// <returns>S_OK if successful, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if no frame came in time, otherwise an error code</returns>
+    HRESULT WaitFrame( DWORD stream, DWORD timeout, SVF_FRAME ** ppFrame );
+
+    /// <summary>
+    /// Publish every skeleton frame from now on, as the viewer does with -publish
+    /// </summary>
+    /// <param name="udpPort">localhost port to send datagrams to as well, 0 for shared memory only</param>
+    /// <returns>S_OK if successful, E_INVALIDARG without a skeleton stream, otherwise an error code</returns>
+    HRESULT PublishSkeletons( USHORT udpPort );
+
+    /// <summary>
+    /// Colorize a depth frame as the viewer's depth view shows it
+    /// </summary>
+    /// <param name="pFrame">packed depth frame of any hub</param>
+    /// <param name="pBGRX">receives width * height BGRX pixels</param>
+    /// <param name="cbBGRX">bytes at pBGRX</param>
+    /// <returns>S_OK if successful, E_INVALIDARG if the frame isn't packed depth or the buffer is too small</returns>
+    static HRESULT ColorizeDepth( const SVF_FRAME * pFrame, BYTE * pBGRX, DWORD cbBGRX );
+
+    /// <summary>
+    /// Take another reference to a frame
+    /// </summary>
+    /// <param name="pFrame">frame to reference</param>
+    static void AddRefFrame( SVF_FRAME * pFrame );
+
+    /// <summary>
+    /// Release a reference to a frame, giving it back to its hub with the last one
+    /// </summary>
+    /// <param name="pFrame">frame to release</param>
+    static void ReleaseFrame( SVF_FRAME * pFrame );
+
+private:
+    /// <summary>
+    /// Destructor, only reached through Release
+    /// </summary>
+    ~FrameHub();
+
+    /// <summary>
+    /// Create the events and start the thread
+    /// </summary>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT                 Start( );
+
+    /// <summary>
+    /// Drop a reference, deleting the hub with the last one
+    /// </summary>
+    void                    Release( );
+
+    /// <summary>
+    /// Thread to take or render frames, calls class instance thread processor
+    /// </summary>
+    /// <param name="pParam">instance pointer</param>
+    /// <returns>always 0</returns>
+    static DWORD WINAPI     FrameThread( LPVOID pParam );
+
+    /// <summary>
+    /// Take frames from the sensor as they come, until the hub is closed
+    /// </summary>
+    void                    TakeSensorFrames( );
+
+    /// <summary>
+    /// Render the stand-in scene every FRAME_HUB_STAND_IN_INTERVAL, until the hub is closed
+    /// </summary>
+    void                    RenderStandInFrames( );
+
+    /// <summary>
+    /// Take the next frame of a sensor image stream, leaving it locked in the sensor's buffer
+    /// </summary>
+    /// <param name="stream">SVF_STREAM_DEPTH or SVF_STREAM_COLOR</param>
+    void                    TakeImageFrame( DWORD stream );
+
+    /// <summary>
+    /// Take the next skeleton frame from the sensor, smoothed if anyone is in it
+    /// </summary>
+    void                    TakeSkeletonFrame( );
+
+    /// <summary>
+    /// Get a frame, recycled if one is free, with room for a buffer
+    /// </summary>
+    /// <param name="stream">SVF_STREAM_ value the frame belongs to</param>
+    /// <param name="cbBuffer">bytes the hub fills itself, 0 for a sensor image frame</param>
+    /// <returns>frame with one reference, NULL if out of memory</returns>
+    SVF_FRAME *             AllocFrame( DWORD stream, DWORD cbBuffer );
+
+    /// <summary>
+    /// Give a frame's sensor buffer back and put the frame on the free list
+    /// </summary>
+    /// <param name="pFrame">frame with no references left</param>
+    void                    Recycle( SVF_FRAME * pFrame );
+
+    /// <summary>
+    /// Make a frame the newest of its stream, dropping the one it replaces if nobody took it;
+    /// skeleton frames are published first
+    /// </summary>
+    /// <param name="pFrame">frame, whose reference passes to the hub</param>
+    void                    Post( SVF_FRAME * pFrame );
+
+    FRAME_HUB_KIND          m_kind;
+    DWORD                   m_streams;
+    volatile LONG           m_cRefs;
+
+    HANDLE                  m_hThread;
+    HANDLE                  m_hStop;
+
+    // Newest frame of each stream not yet handed out, and an event set when one is posted
+    CRITICAL_SECTION        m_csFrames;
+    SVF_FRAME *             m_pNewest[SVF_STREAM_COUNT];
+    HANDLE                  m_hFramePosted[SVF_STREAM_COUNT];
+    SVF_FRAME *             m_pFree;
+
+    // Publisher of skeleton frames once asked for
+    CRITICAL_SECTION        m_csPublisher;
+    SkeletonPublisher *     m_pPublisher;
+
+    // Colorizes depth frames for callers on any thread, one at a time
+    CRITICAL_SECTION        m_csKernel;
+    DepthKernel             m_depthKernel;
+
+    // sensor
+    INuiSensor *            m_pNuiSensor;
+    HANDLE                  m_hNextFrame[SVF_STREAM_COUNT];
+    HANDLE                  m_hImageStream[SVF_STREAM_SKELETON];
+
+    // stand-in
+    StandInScene            m_scene;
+    DWORD                   m_standInFrameNumber;
+};
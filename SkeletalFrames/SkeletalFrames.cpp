@@ -0,0 +1,194 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletalFrames.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Exports of SkeletalFrames.dll; each checks its arguments and hands off to FrameHub
+
+#include "stdafx.h"
+#include "FrameHub.h"
+
+// Bytes of SVF_FRAME_INFO up to the last field of version 1, the least a caller may ask for
+static const DWORD g_FrameInfoSizeV1 = FIELD_OFFSET(SVF_FRAME_INFO, cbData) + sizeof(DWORD);
+
+/// <summary>
+/// Version of the interface the library implements
+/// </summary>
+/// <returns>SVF_VERSION the library was built with</returns>
+DWORD SVF_CALL SvfGetVersion( void )
+{
+    return SVF_VERSION;
+}
+
+/// <summary>
+/// Open a sensor; depth is 320x240 with player indices, color is 640x480
+/// </summary>
+/// <param name="index">index of the sensor, 0 for the first</param>
+/// <param name="dwStreams">SVF_STREAM_FLAG_ values of the streams to open</param>
+/// <param name="ppSource">receives the source, to be closed with SvfCloseSource</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT SVF_CALL SvfOpenSensor( int index, DWORD dwStreams, SVF_SOURCE ** ppSource )
+{
+    if ( NULL == ppSource || 0 == dwStreams || 0 != (dwStreams & ~SVF_STREAM_FLAG_ALL) )
+    {
+        return E_INVALIDARG;
+    }
+
+    *ppSource = NULL;
+
+    FrameHub * pHub = new FrameHub( );
+    HRESULT hr = pHub->OpenSensor( index, dwStreams );
+    if ( FAILED(hr) )
+    {
+        pHub->Close( );
+        return hr;
+    }
+
+    *ppSource = pHub;
+    return S_OK;
+}
+
+/// <summary>
+/// Open the stand-in source, a synthetic scene in the same formats as a sensor
+/// </summary>
+/// <param name="dwStreams">SVF_STREAM_FLAG_ values of the streams to open</param>
+/// <param name="ppSource">receives the source, to be closed with SvfCloseSource</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT SVF_CALL SvfOpenStandIn( DWORD dwStreams, SVF_SOURCE ** ppSource )
+{
+    if ( NULL == ppSource || 0 == dwStreams || 0 != (dwStreams & ~SVF_STREAM_FLAG_ALL) )
+    {
+        return E_INVALIDARG;
+    }
+
+    *ppSource = NULL;
+
+    FrameHub * pHub = new FrameHub( );
+    HRESULT hr = pHub->OpenStandIn( dwStreams );
+    if ( FAILED(hr) )
+    {
+        pHub->Close( );
+        return hr;
+    }
+
+    *ppSource = pHub;
+    return S_OK;
+}
+
+/// <summary>
+/// Close a source; frames still held stay valid until they are released.
+/// No other call on the source may be running or made afterwards
+/// </summary>
+/// <param name="pSource">source to close</param>
+void SVF_CALL SvfCloseSource( SVF_SOURCE * pSource )
+{
+    if ( pSource )
+    {
+        static_cast<FrameHub *>(pSource)->Close( );
+    }
+}
+
+/// <summary>
+/// Wait for the newest frame of a stream that hasn't been handed out yet.  Frames
+/// nobody takes before a newer one comes are dropped.  A sensor keeps only a few
+/// frames of each stream, so callers should hold no more than two at a time
+/// </summary>
+/// <param name="pSource">source to take the frame from</param>
+/// <param name="dwStream">SVF_STREAM_ value</param>
+/// <param name="dwTimeout">milliseconds to wait, INFINITE to wait until a frame comes</param>
+/// <param name="ppFrame">receives the frame, to be released with SvfReleaseFrame</param>
+/// <returns>S_OK if successful, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if no frame came in time, otherwise an error code</returns>
+HRESULT SVF_CALL SvfWaitFrame( SVF_SOURCE * pSource, DWORD dwStream, DWORD dwTimeout, SVF_FRAME ** ppFrame )
+{
+    if ( NULL == pSource || NULL == ppFrame )
+    {
+        return E_INVALIDARG;
+    }
+
+    return static_cast<FrameHub *>(pSource)->WaitFrame( dwStream, dwTimeout, ppFrame );
+}
+
+/// <summary>
+/// Describe a frame
+/// </summary>
+/// <param name="pFrame">frame to describe</param>
+/// <param name="pInfo">receives what the frame holds, cbSize set by the caller</param>
+/// <returns>S_OK if successful, E_INVALIDARG if cbSize is too small for the fields of version 1</returns>
+HRESULT SVF_CALL SvfGetFrameInfo( const SVF_FRAME * pFrame, SVF_FRAME_INFO * pInfo )
+{
+    if ( NULL == pFrame || NULL == pInfo || pInfo->cbSize < g_FrameInfoSizeV1 )
+    {
+        return E_INVALIDARG;
+    }
+
+    // A caller built against a later version gets the fields this one knows, the rest zeroed
+    DWORD cbSize = pInfo->cbSize;
+    ZeroMemory( pInfo, cbSize );
+    CopyMemory( pInfo, &pFrame->info, min( cbSize, sizeof(pFrame->info) ) );
+    pInfo->cbSize = cbSize;
+
+    return S_OK;
+}
+
+/// <summary>
+/// Colorize a depth frame as the viewer shows it, nearer depths brighter and each
+/// player tinted its own color
+/// </summary>
+/// <param name="pFrame">depth frame to colorize</param>
+/// <param name="pBGRX">receives dwWidth * dwHeight pixels in SVF_FORMAT_BGRX32, rows packed</param>
+/// <param name="cbBGRX">bytes at pBGRX</param>
+/// <returns>S_OK if successful, E_INVALIDARG if the frame isn't depth or cbBGRX is too small</returns>
+HRESULT SVF_CALL SvfColorizeDepth( const SVF_FRAME * pFrame, BYTE * pBGRX, DWORD cbBGRX )
+{
+    if ( NULL == pFrame || NULL == pBGRX )
+    {
+        return E_INVALIDARG;
+    }
+
+    return FrameHub::ColorizeDepth( pFrame, pBGRX, cbBGRX );
+}
+
+/// <summary>
+/// Publish every skeleton frame of a source to other processes until it is closed,
+/// as the viewer does with -publish: to the shared memory ring its subscribers
+/// read, and as datagrams to a localhost port if one is given.  Call again to
+/// send to another port
+/// </summary>
+/// <param name="pSource">source with a skeleton stream</param>
+/// <param name="udpPort">localhost port to send datagrams of every skeleton and joint to, 0 for none</param>
+/// <returns>S_OK if successful, E_INVALIDARG if the source has no skeleton stream, otherwise an error code</returns>
+HRESULT SVF_CALL SvfPublishSkeletons( SVF_SOURCE * pSource, USHORT udpPort )
+{
+    if ( NULL == pSource )
+    {
+        return E_INVALIDARG;
+    }
+
+    return static_cast<FrameHub *>(pSource)->PublishSkeletons( udpPort );
+}
+
+/// <summary>
+/// Take another reference to a frame, for a second owner of it
+/// </summary>
+/// <param name="pFrame">frame to reference</param>
+void SVF_CALL SvfAddRefFrame( SVF_FRAME * pFrame )
+{
+    if ( pFrame )
+    {
+        FrameHub::AddRefFrame( pFrame );
+    }
+}
+
+/// <summary>
+/// Release a reference to a frame; its buffer goes back to the source with the last one.
+/// May be called on any thread, and after the source is closed
+/// </summary>
+/// <param name="pFrame">frame to release</param>
+void SVF_CALL SvfReleaseFrame( SVF_FRAME * pFrame )
+{
+    if ( pFrame )
+    {
+        FrameHub::ReleaseFrame( pFrame );
+    }
+}
@@ -0,0 +1,168 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletalFrames.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// C interface of SkeletalFrames.dll, which opens a sensor and hands out its
+// depth, color and skeleton frames, so other runtimes can use them without
+// the viewer.  A frame is a handle to the sensor's own buffer: the caller gets
+// its pointer, stride, format and timestamp, and the buffer stays valid until
+// the handle is released, so a binding can wrap it without copying.  Only
+// plain C types cross the boundary, and the exports are listed by name in
+// SkeletalFrames.def; new functions and new fields at the end of
+// SVF_FRAME_INFO are the only changes a later version makes.
+//
+// The stand-in source produces a synthetic scene at 30 frames per second in
+// the same formats, for developing and testing bindings without a sensor.
+
+#pragma once
+
+#include <windows.h>
+
+#ifdef SKELETALFRAMES_EXPORTS
+#define SVF_API
+#else
+#define SVF_API __declspec(dllimport)
+#endif
+
+#define SVF_CALL                    __stdcall
+
+// Version of this interface, returned by SvfGetVersion; version 2 added
+// SvfColorizeDepth and SvfPublishSkeletons
+#define SVF_VERSION                 2
+
+// Streams of a source
+enum SVF_STREAM
+{
+    SVF_STREAM_DEPTH = 0,
+    SVF_STREAM_COLOR,
+    SVF_STREAM_SKELETON,
+    SVF_STREAM_COUNT
+};
+
+// Streams to open, combined with |
+#define SVF_STREAM_FLAG_DEPTH       (1 << SVF_STREAM_DEPTH)
+#define SVF_STREAM_FLAG_COLOR       (1 << SVF_STREAM_COLOR)
+#define SVF_STREAM_FLAG_SKELETON    (1 << SVF_STREAM_SKELETON)
+#define SVF_STREAM_FLAG_ALL         (SVF_STREAM_FLAG_DEPTH | SVF_STREAM_FLAG_COLOR | SVF_STREAM_FLAG_SKELETON)
+
+// Formats of frames, the same values as the viewer's shared image channels
+enum SVF_FORMAT
+{
+    SVF_FORMAT_DEPTH16 = 0,         // depth in millimeters in the top 13 bits, player index in the low 3
+    SVF_FORMAT_BGRX32 = 1,          // 8 bits each of blue, green, red and unused
+    SVF_FORMAT_SKELETON_FRAME = 16  // one NUI_SKELETON_FRAME, smoothed
+};
+
+// A source of frames, and one frame of it
+typedef struct SVF_SOURCE SVF_SOURCE;
+typedef struct SVF_FRAME SVF_FRAME;
+
+// What a frame holds; fields only ever get added at the end
+typedef struct SVF_FRAME_INFO
+{
+    DWORD           cbSize;         // set to sizeof(SVF_FRAME_INFO) by the caller
+    DWORD           dwStream;       // SVF_STREAM_ value
+    DWORD           dwFormat;       // SVF_FORMAT_ value
+    DWORD           dwWidth;        // pixels in a row, 1 for skeleton frames
+    DWORD           dwHeight;       // rows, 1 for skeleton frames
+    DWORD           dwStride;       // bytes from the start of one row to the next
+    DWORD           dwBytesPerPixel;
+    DWORD           dwFrameNumber;
+    LONGLONG        liTimeStamp;    // milliseconds, as in NUI_IMAGE_FRAME
+    const void *    pData;          // first row, valid until the frame is released
+    DWORD           cbData;         // bytes at pData
+} SVF_FRAME_INFO;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// <summary>
+/// Version of the interface the library implements
+/// </summary>
+/// <returns>SVF_VERSION the library was built with</returns>
+SVF_API DWORD SVF_CALL SvfGetVersion( void );
+
+/// <summary>
+/// Open a sensor; depth is 320x240 with player indices, color is 640x480
+/// </summary>
+/// <param name="index">index of the sensor, 0 for the first</param>
+/// <param name="dwStreams">SVF_STREAM_FLAG_ values of the streams to open</param>
+/// <param name="ppSource">receives the source, to be closed with SvfCloseSource</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+SVF_API HRESULT SVF_CALL SvfOpenSensor( int index, DWORD dwStreams, SVF_SOURCE ** ppSource );
+
+/// <summary>
+/// Open the stand-in source, a synthetic scene in the same formats as a sensor
+/// </summary>
+/// <param name="dwStreams">SVF_STREAM_FLAG_ values of the streams to open</param>
+/// <param name="ppSource">receives the source, to be closed with SvfCloseSource</param>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+SVF_API HRESULT SVF_CALL SvfOpenStandIn( DWORD dwStreams, SVF_SOURCE ** ppSource );
+
+/// <summary>
+/// Close a source; frames still held stay valid until they are released.
+/// No other call on the source may be running or made afterwards
+/// </summary>
+/// <param name="pSource">source to close</param>
+SVF_API void SVF_CALL SvfCloseSource( SVF_SOURCE * pSource );
+
+/// <summary>
+/// Wait for the newest frame of a stream that hasn't been handed out yet.  Frames
+/// nobody takes before a newer one comes are dropped.  A sensor keeps only a few
+/// frames of each stream, so callers should hold no more than two at a time
+/// </summary>
+/// <param name="pSource">source to take the frame from</param>
+/// <param name="dwStream">SVF_STREAM_ value</param>
+/// <param name="dwTimeout">milliseconds to wait, INFINITE to wait until a frame comes</param>
+/// <param name="ppFrame">receives the frame, to be released with SvfReleaseFrame</param>
+/// <returns>S_OK if successful, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if no frame came in time, otherwise an error code</returns>
+SVF_API HRESULT SVF_CALL SvfWaitFrame( SVF_SOURCE * pSource, DWORD dwStream, DWORD dwTimeout, SVF_FRAME ** ppFrame );
+
+/// <summary>
+/// Describe a frame
+/// </summary>
+/// <param name="pFrame">frame to describe</param>
+/// <param name="pInfo">receives what the frame holds, cbSize set by the caller</param>
+/// <returns>S_OK if successful, E_INVALIDARG if cbSize is too small for the fields of version 1</returns>
+SVF_API HRESULT SVF_CALL SvfGetFrameInfo( const SVF_FRAME * pFrame, SVF_FRAME_INFO * pInfo );
+
+/// <summary>
+/// Colorize a depth frame as the viewer shows it, nearer depths brighter and each
+/// player tinted its own color
+/// </summary>
+/// <param name="pFrame">depth frame to colorize</param>
+/// <param name="pBGRX">receives dwWidth * dwHeight pixels in SVF_FORMAT_BGRX32, rows packed</param>
+/// <param name="cbBGRX">bytes at pBGRX</param>
+/// <returns>S_OK if successful, E_INVALIDARG if the frame isn't depth or cbBGRX is too small</returns>
+SVF_API HRESULT SVF_CALL SvfColorizeDepth( const SVF_FRAME * pFrame, BYTE * pBGRX, DWORD cbBGRX );
+
+/// <summary>
+/// Publish every skeleton frame of a source to other processes until it is closed,
+/// as the viewer does with -publish: to the shared memory ring its subscribers
+/// read, and as datagrams to a localhost port if one is given.  Call again to
+/// send to another port
+/// </summary>
+/// <param name="pSource">source with a skeleton stream</param>
+/// <param name="udpPort">localhost port to send datagrams of every skeleton and joint to, 0 for none</param>
+/// <returns>S_OK if successful, E_INVALIDARG if the source has no skeleton stream, otherwise an error code</returns>
+SVF_API HRESULT SVF_CALL SvfPublishSkeletons( SVF_SOURCE * pSource, USHORT udpPort );
+
+/// <summary>
+/// Take another reference to a frame, for a second owner of it
+/// </summary>
+/// <param name="pFrame">frame to reference</param>
+SVF_API void SVF_CALL SvfAddRefFrame( SVF_FRAME * pFrame );
+
+/// <summary>
+/// Release a reference to a frame; its buffer goes back to the source with the last one.
+/// May be called on any thread, and after the source is closed
+/// </summary>
+/// <param name="pFrame">frame to release</param>
+SVF_API void SVF_CALL SvfReleaseFrame( SVF_FRAME * pFrame );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,167 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="StandInScene.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "StandInScene.h"
+#include <math.h>
+
+// Half the width and height (in meters) of the player
+static const float g_PlayerHalfWidth = 0.25f;
+static const float g_PlayerHalfHeight = 0.85f;
+
+// How far (in meters) the player sways to either side
+static const float g_SwayDistance = 0.6f;
+
+static const float g_Pi = 3.14159265f;
+
+// Joints relative to the center of the player, in NUI_SKELETON_POSITION_INDEX order
+static const float g_JointOffsets[NUI_SKELETON_POSITION_COUNT][2] =
+{
+    {  0.00f, -0.05f },     // hip center
+    {  0.00f,  0.10f },     // spine
+    {  0.00f,  0.45f },     // shoulder center
+    {  0.00f,  0.65f },     // head
+    { -0.18f,  0.42f },     // shoulder left
+    { -0.22f,  0.15f },     // elbow left
+    { -0.24f, -0.08f },     // wrist left
+    { -0.24f, -0.15f },     // hand left
+    {  0.18f,  0.42f },     // shoulder right
+    {  0.22f,  0.15f },     // elbow right
+    {  0.24f, -0.08f },     // wrist right
+    {  0.24f, -0.15f },     // hand right
+    { -0.10f, -0.10f },     // hip left
+    { -0.10f, -0.45f },     // knee left
+    { -0.10f, -0.78f },     // ankle left
+    { -0.10f, -0.83f },     // foot left
+    {  0.10f, -0.10f },     // hip right
+    {  0.10f, -0.45f },     // knee right
+    {  0.10f, -0.78f },     // ankle right
+    {  0.10f, -0.83f },     // foot right
+};
+
+/// <summary>
+/// Constructor
+/// </summary>
+StandInScene::StandInScene() :
+    m_playerX(0.0f),
+    m_playerY(-0.1f)
+{
+}
+
+/// <summary>
+/// Move the player to where it is at a time
+/// </summary>
+/// <param name="timeStamp">milliseconds since the scene started</param>
+void StandInScene::Update( LONGLONG timeStamp )
+{
+    float phase = static_cast<float>(timeStamp % STAND_IN_SWAY_PERIOD) / STAND_IN_SWAY_PERIOD;
+    m_playerX = g_SwayDistance * sinf( 2.0f * g_Pi * phase );
+}
+
+/// <summary>
+/// Render packed depth and player index
+/// </summary>
+/// <param name="pDepth">receives width * height pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+void StandInScene::RenderDepth( USHORT * pDepth, UINT width, UINT height ) const
+{
+    // The inverse of NuiTransformSkeletonToDepthImage, on the plane of the player
+    float scale = NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width * STAND_IN_PLAYER_DEPTH;
+
+    USHORT player = static_cast<USHORT>((static_cast<USHORT>(STAND_IN_PLAYER_DEPTH * 1000.0f) << NUI_IMAGE_PLAYER_INDEX_SHIFT) | 1);
+    USHORT wall = static_cast<USHORT>(static_cast<USHORT>(STAND_IN_WALL_DEPTH * 1000.0f) << NUI_IMAGE_PLAYER_INDEX_SHIFT);
+
+    for ( UINT y = 0; y < height; ++y )
+    {
+        float pointY = -(static_cast<float>(y) - height / 2.0f) * scale;
+        for ( UINT x = 0; x < width; ++x )
+        {
+            float pointX = (static_cast<float>(x) - width / 2.0f) * scale;
+            *pDepth++ = IsOnPlayer( pointX, pointY ) ? player : wall;
+        }
+    }
+}
+
+/// <summary>
+/// Render BGRX color
+/// </summary>
+/// <param name="pColor">receives width * height pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+void StandInScene::RenderColor( BYTE * pColor, UINT width, UINT height ) const
+{
+    // Same view as depth, the color camera's offset is left out
+    float scale = NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width * STAND_IN_PLAYER_DEPTH;
+
+    for ( UINT y = 0; y < height; ++y )
+    {
+        float pointY = -(static_cast<float>(y) - height / 2.0f) * scale;
+        for ( UINT x = 0; x < width; ++x )
+        {
+            float pointX = (static_cast<float>(x) - width / 2.0f) * scale;
+            if ( IsOnPlayer( pointX, pointY ) )
+            {
+                pColor[0] = 40;
+                pColor[1] = 40;
+                pColor[2] = 220;
+            }
+            else
+            {
+                pColor[0] = static_cast<BYTE>(x * 255 / width);
+                pColor[1] = static_cast<BYTE>(y * 255 / height);
+                pColor[2] = 64;
+            }
+            pColor[3] = 0;
+            pColor += 4;
+        }
+    }
+}
+
+/// <summary>
+/// Render a skeleton frame with the player tracked
+/// </summary>
+/// <param name="frame">receives the frame, without its number and time stamp</param>
+void StandInScene::RenderSkeleton( NUI_SKELETON_FRAME & frame ) const
+{
+    ZeroMemory( &frame, sizeof(frame) );
+
+    // Floor under the player's feet, the sensor level
+    frame.vFloorClipPlane.y = 1.0f;
+    frame.vFloorClipPlane.w = g_PlayerHalfHeight - m_playerY;
+    frame.vNormalToGravity.y = 1.0f;
+
+    NUI_SKELETON_DATA & skeleton = frame.SkeletonData[0];
+    skeleton.eTrackingState = NUI_SKELETON_TRACKED;
+    skeleton.dwTrackingID = 1;
+    skeleton.Position.x = m_playerX;
+    skeleton.Position.y = m_playerY;
+    skeleton.Position.z = STAND_IN_PLAYER_DEPTH;
+    skeleton.Position.w = 1.0f;
+
+    for ( int i = 0; i < NUI_SKELETON_POSITION_COUNT; ++i )
+    {
+        skeleton.SkeletonPositions[i].x = m_playerX + g_JointOffsets[i][0];
+        skeleton.SkeletonPositions[i].y = m_playerY + g_JointOffsets[i][1];
+        skeleton.SkeletonPositions[i].z = STAND_IN_PLAYER_DEPTH;
+        skeleton.SkeletonPositions[i].w = 1.0f;
+        skeleton.eSkeletonPositionTrackingState[i] = NUI_SKELETON_POSITION_TRACKED;
+    }
+}
+
+/// <summary>
+/// Whether a point on the plane of the player is on the player
+/// </summary>
+/// <param name="x">x (in meters) of the point</param>
+/// <param name="y">y (in meters) of the point</param>
+/// <returns>true if on the player, false otherwise</returns>
+bool StandInScene::IsOnPlayer( float x, float y ) const
+{
+    float u = (x - m_playerX) / g_PlayerHalfWidth;
+    float v = (y - m_playerY) / g_PlayerHalfHeight;
+
+    return u * u + v * v <= 1.0f;
+}
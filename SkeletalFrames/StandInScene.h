@@ -0,0 +1,73 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="StandInScene.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// A synthetic scene in place of a sensor: one player, an upright ellipse in
+// front of a wall, swaying from side to side every few seconds.  Depth marks
+// the player with player index 1, color draws the player over a gradient and
+// the skeleton frame tracks the player with every joint.  The three agree
+// with each other to within the simple projection used, so a binding can
+// check that a frame holds what its description says.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Distances (in meters) of the player and the wall from the sensor
+#define STAND_IN_PLAYER_DEPTH       2.5f
+#define STAND_IN_WALL_DEPTH         3.5f
+
+// Milliseconds to sway from one side and back
+#define STAND_IN_SWAY_PERIOD        4000
+
+class StandInScene
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    StandInScene();
+
+    /// <summary>
+    /// Move the player to where it is at a time
+    /// </summary>
+    /// <param name="timeStamp">milliseconds since the scene started</param>
+    void Update( LONGLONG timeStamp );
+
+    /// <summary>
+    /// Render packed depth and player index
+    /// </summary>
+    /// <param name="pDepth">receives width * height pixels</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    void RenderDepth( USHORT * pDepth, UINT width, UINT height ) const;
+
+    /// <summary>
+    /// Render BGRX color
+    /// </summary>
+    /// <param name="pColor">receives width * height pixels</param>
+    /// <param name="width">width (in pixels) of the frame</param>
+    /// <param name="height">height (in pixels) of the frame</param>
+    void RenderColor( BYTE * pColor, UINT width, UINT height ) const;
+
+    /// <summary>
+    /// Render a skeleton frame with the player tracked
+    /// </summary>
+    /// <param name="frame">receives the frame, without its number and time stamp</param>
+    void RenderSkeleton( NUI_SKELETON_FRAME & frame ) const;
+
+private:
+    /// <summary>
+    /// Whether a point on the plane of the player is on the player
+    /// </summary>
+    /// <param name="x">x (in meters) of the point</param>
+    /// <param name="y">y (in meters) of the point</param>
+    /// <returns>true if on the player, false otherwise</returns>
+    bool                    IsOnPlayer( float x, float y ) const;
+
+    // center of the player, in skeleton space
+    float                   m_playerX;
+    float                   m_playerY;
+};
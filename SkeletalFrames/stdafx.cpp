@@ -0,0 +1,11 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="stdafx.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Used to generate precompiled header for the library
+
+// stdafx.obj will contain the pre-compiled type information
+
+#include "stdafx.h"
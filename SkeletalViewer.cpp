@@ -12,6 +12,10 @@
 
 #include "stdafx.h"
 #include <strsafe.h>
+#include <errno.h>
+#include <wctype.h>
+#include <mmsystem.h>
+#include <shellapi.h>
 #include "SkeletalViewer.h"
 #include "resource.h"
 
@@ -36,6 +40,9 @@ int APIENTRY _tWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCm
     // Store the instance handle
     g_skeletalViewerApp.m_hInstance = hInstance;
 
+    // Pick up optional pipeline stages before the dialog starts the sensor
+    g_skeletalViewerApp.ParseCommandLine(lpCmdLine);
+
     // Dialog custom window class
     ZeroMemory(&wc,sizeof(wc));
     wc.style=CS_HREDRAW | CS_VREDRAW;
@@ -107,8 +114,31 @@ CSkeletalViewerApp::CSkeletalViewerApp() : m_hInstance(NULL)
     LoadStringW(m_hInstance, IDS_APPTITLE, m_szAppTitle, _countof(m_szAppTitle));
 
     m_fUpdatingUi = false;
+    m_SensorListStale = TRUE;
+    m_PointCloudExportPending = FALSE;
+    m_PipelineFlags = 0;
+    m_cSkeletonUdpSubscribers = 0;
+    m_szBackgroundFile[0] = 0;
+    m_szZoneFile[0] = 0;
+    m_szRecordFile[0] = 0;
+    m_TemporalFilterMode = TEMPORAL_FILTER_MEDIAN;
+    m_bSpatialFilterGuided = false;
+    m_PredictionHorizon = JOINT_PREDICTOR_DEFAULT_HORIZON;
+    InitializeCriticalSection(&m_csNuiSensor);
+    m_pSensorConnection = new SensorConnection(*this, m_csNuiSensor);
     Nui_Zero();
 
+    // Start the timeline when the process was created, not when we got control
+    ZeroMemory(m_StartupTimeline, sizeof(m_StartupTimeline));
+    FILETIME ftCreation, ftExit, ftKernel, ftUser, ftNow;
+    m_StartupTimeline[SV_STARTUP_PROCESS] = timeGetTime();
+    if ( GetProcessTimes(GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser) )
+    {
+        GetSystemTimeAsFileTime(&ftNow);
+        ULONGLONG sinceCreation = (reinterpret_cast<ULARGE_INTEGER *>(&ftNow)->QuadPart - reinterpret_cast<ULARGE_INTEGER *>(&ftCreation)->QuadPart) / 10000;
+        m_StartupTimeline[SV_STARTUP_PROCESS] -= static_cast<DWORD>(sinceCreation);
+    }
+
     // Init Direct2D
     D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &m_pD2DFactory);
 }
@@ -123,6 +153,224 @@ CSkeletalViewerApp::~CSkeletalViewerApp()
 
     Nui_Zero();
     SysFreeString(m_instanceId);
+    delete m_pSensorConnection;
+    DeleteCriticalSection(&m_csNuiSensor);
+}
+
+/// <summary>
+/// Parse a number given with a switch, reporting it as debug output if it is
+/// malformed or out of range
+/// </summary>
+/// <param name="szSwitch">whole switch, for the report</param>
+/// <param name="szValue">decimal or 0x hexadecimal number, ending the switch, or followed by ':' if pszEnd is given</param>
+/// <param name="minimum">smallest value accepted</param>
+/// <param name="maximum">largest value accepted</param>
+/// <param name="value">receives the number if it is accepted</param>
+/// <param name="pszEnd">receives where the number ends, NULL if nothing may follow it</param>
+/// <returns>true if the number was accepted, false otherwise</returns>
+static bool ParseSwitchNumber( LPCWSTR szSwitch, LPCWSTR szValue, DWORD minimum, DWORD maximum, DWORD & value, LPCWSTR * pszEnd )
+{
+    int radix = 10;
+    if ( L'0' == szValue[0] && (L'x' == szValue[1] || L'X' == szValue[1]) )
+    {
+        radix = 16;
+        szValue += 2;
+    }
+
+    // wcstoul would take signs and spaces, and saturates rather than failing
+    LPWSTR szEnd = NULL;
+    errno = 0;
+    unsigned long number = iswxdigit( szValue[0] ) ? wcstoul( szValue, &szEnd, radix ) : 0;
+
+    if ( NULL == szEnd || (0 != *szEnd && (NULL == pszEnd || L':' != *szEnd)) || ERANGE == errno || number < minimum || number > maximum )
+    {
+        WCHAR szReport[128];
+        StringCchPrintfW( szReport, _countof(szReport), L"Ignoring -%s, expected a number from %u to %u\r\n", szSwitch, minimum, maximum );
+        OutputDebugString( szReport );
+        return false;
+    }
+
+    value = number;
+    if ( pszEnd )
+    {
+        *pszEnd = szEnd;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Enable optional pipeline stages requested on the command line
+///   -publish[:predicted] publish skeletons to shared memory, optionally where they are predicted to be
+///   -udp[:port]       also send them as localhost datagrams, to each port given
+///   -udpfilter:joints[:id] limit the port given last to the joints in a NUI_SKELETON_POSITION_INDEX bit mask, of one skeleton if given
+///   -images[:rgbx]    share raw depth and color, and optionally colorized depth, in shared memory
+///   -pointcloud       convert depth to points, clicking the depth view saves them as PLY
+///   -segment          compute player masks and statistics, shared with -images
+///   -background:file  .bmp to composite players over in the green screen color view
+///   -temporal[:blend] steady depth with the median of the last frames, or a blend that snaps to motion
+///   -spatial[:joint]  smooth depth within the frame but not across edges, optionally color edges too
+///   -gestures         report swipes, pushes and raised hands as debug output
+///   -kinematics       work out joint angles, velocities and accelerations of every skeleton
+///   -predict[:ms]     draw skeletons where they will be ms from now, up to 200, to hide latency
+///   -zones:file       report joints entering and leaving the zones listed in a text file
+///   -floor            find the floor in depth, for the skeleton frames and heights above it
+///   -hands            report hands opening and closing and their fingertips as debug output
+///   -sync             report depth, color and skeleton frames taken together as debug output
+///   -record:file      record depth, after any filters, and infrared while it is shown, losslessly compressed to a file
+/// </summary>
+/// <param name="szCmdLine">command line arguments, without the program name</param>
+void CSkeletalViewerApp::ParseCommandLine( LPCWSTR szCmdLine )
+{
+    if ( NULL == szCmdLine || 0 == szCmdLine[0] )
+    {
+        return;
+    }
+
+    int argc = 0;
+    LPWSTR * argv = CommandLineToArgvW(szCmdLine, &argc);
+    if ( NULL == argv )
+    {
+        return;
+    }
+
+    for (int i = 0; i < argc; ++i)
+    {
+        // Accept both -switch and /switch
+        if ( L'-' != argv[i][0] && L'/' != argv[i][0] )
+        {
+            continue;
+        }
+
+        LPCWSTR szSwitch = argv[i] + 1;
+
+        if ( 0 == _wcsicmp(szSwitch, L"publish") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_PUBLISH_SKELETONS;
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"publish:predicted") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_PUBLISH_SKELETONS | SV_PIPELINE_PREDICT_PUBLISHED;
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"udpfilter:", 10) )
+        {
+            DWORD jointMask, trackingID = 0;
+            LPCWSTR szEnd;
+
+            // Filters the port given last, or the default port if none was
+            if ( ParseSwitchNumber(szSwitch, szSwitch + 10, 1, SKELETON_ALL_JOINTS, jointMask, &szEnd) &&
+                 (0 == *szEnd || ParseSwitchNumber(szSwitch, szEnd + 1, 1, MAXDWORD, trackingID, NULL)) &&
+                 (m_cSkeletonUdpSubscribers > 0 || AddSkeletonUdpSubscriber( SKELETON_PUBLISH_DEFAULT_PORT )) )
+            {
+                SKELETON_UDP_SUBSCRIBER & subscriber = m_SkeletonUdpSubscribers[m_cSkeletonUdpSubscribers - 1];
+                subscriber.jointMask = jointMask;
+                subscriber.trackingID = trackingID;
+            }
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"udp") || 0 == _wcsnicmp(szSwitch, L"udp:", 4) )
+        {
+            DWORD port = SKELETON_PUBLISH_DEFAULT_PORT;
+            if ( 0 == szSwitch[3] || ParseSwitchNumber(szSwitch, szSwitch + 4, 1, MAXWORD, port, NULL) )
+            {
+                AddSkeletonUdpSubscriber( static_cast<USHORT>(port) );
+            }
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"images", 6) )
+        {
+            m_PipelineFlags |= SV_PIPELINE_SHARE_IMAGES;
+            if ( 0 == _wcsicmp(szSwitch + 6, L":rgbx") )
+            {
+                m_PipelineFlags |= SV_PIPELINE_SHARE_DEPTH_RGBX;
+            }
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"pointcloud") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_POINT_CLOUD;
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"segment") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_SEGMENT_PLAYERS;
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"temporal", 8) )
+        {
+            m_PipelineFlags |= SV_PIPELINE_TEMPORAL_FILTER;
+            m_TemporalFilterMode = ( 0 == _wcsicmp(szSwitch + 8, L":blend") ) ? TEMPORAL_FILTER_BLEND : TEMPORAL_FILTER_MEDIAN;
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"spatial", 7) )
+        {
+            m_PipelineFlags |= SV_PIPELINE_SPATIAL_FILTER;
+            m_bSpatialFilterGuided = ( 0 == _wcsicmp(szSwitch + 7, L":joint") );
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"gestures") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_GESTURES;
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"kinematics") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_KINEMATICS;
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"predict", 7) )
+        {
+            m_PipelineFlags |= SV_PIPELINE_PREDICT_VIEW;
+            DWORD horizon = 0;
+            if ( L':' == szSwitch[7] && ParseSwitchNumber(szSwitch, szSwitch + 8, 1, JOINT_PREDICTOR_MAX_HORIZON, horizon, NULL) )
+            {
+                m_PredictionHorizon = horizon;
+            }
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"floor") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_FLOOR;
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"hands") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_HANDS;
+        }
+        else if ( 0 == _wcsicmp(szSwitch, L"sync") )
+        {
+            m_PipelineFlags |= SV_PIPELINE_SYNC;
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"background:", 11) )
+        {
+            StringCchCopyW(m_szBackgroundFile, _countof(m_szBackgroundFile), szSwitch + 11);
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"zones:", 6) )
+        {
+            m_PipelineFlags |= SV_PIPELINE_ZONES;
+            StringCchCopyW(m_szZoneFile, _countof(m_szZoneFile), szSwitch + 6);
+        }
+        else if ( 0 == _wcsnicmp(szSwitch, L"record:", 7) )
+        {
+            m_PipelineFlags |= SV_PIPELINE_RECORD_DEPTH;
+            StringCchCopyW(m_szRecordFile, _countof(m_szRecordFile), szSwitch + 7);
+        }
+    }
+
+    LocalFree(argv);
+}
+
+/// <summary>
+/// Add a localhost port to send skeleton datagrams to, sending every joint of every skeleton
+/// </summary>
+/// <param name="port">port to send to</param>
+/// <returns>true if the port was added, false if there are already as many as can be sent to</returns>
+bool CSkeletalViewerApp::AddSkeletonUdpSubscriber( USHORT port )
+{
+    if ( m_cSkeletonUdpSubscribers >= SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS )
+    {
+        WCHAR szReport[128];
+        StringCchPrintfW( szReport, _countof(szReport), L"Ignoring -udp:%u, at most %u ports are sent to\r\n", port, SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS );
+        OutputDebugString( szReport );
+        return false;
+    }
+
+    SKELETON_UDP_SUBSCRIBER & subscriber = m_SkeletonUdpSubscribers[m_cSkeletonUdpSubscribers++];
+    subscriber.port = port;
+    subscriber.trackingID = 0;
+    subscriber.jointMask = SKELETON_ALL_JOINTS;
+
+    m_PipelineFlags |= SV_PIPELINE_PUBLISH_SKELETONS;
+    return true;
 }
 
 /// <summary>
@@ -142,14 +390,24 @@ void CSkeletalViewerApp::ClearKinectComboBox()
 /// </summary>
 void CSkeletalViewerApp::UpdateKinectComboBox()
 {
+    // The combo box is the enumeration cache, only rebuild it after a status change.
+    // The flag is cleared first so a change during the enumeration asks for another
+    if ( 0 == InterlockedExchange(&m_SensorListStale, FALSE) )
+    {
+        return;
+    }
+
     m_fUpdatingUi = true;
     ClearKinectComboBox();
 
     int numDevices = 0;
     HRESULT hr = NuiGetSensorCount(&numDevices);
 
+    // Still stale, so the list is enumerated again when it is next dropped down
     if ( FAILED(hr) )
     {
+        InterlockedExchange(&m_SensorListStale, TRUE);
+        m_fUpdatingUi = false;
         return;
     }
 
@@ -263,6 +521,24 @@ LRESULT CALLBACK CSkeletalViewerApp::WndProc( HWND hWnd, UINT message, WPARAM wP
             LoadStringW(m_hInstance, IDS_TRACKEDSKELETONS_STICKY2, szComboText, _countof(szComboText));
             SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
 
+            LoadStringW(m_hInstance, IDS_TRACKEDSKELETONS_ZONE1, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_TRACKEDSKELETONS_ZONE2, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_TRACKEDSKELETONS_ACTIVE1, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_TRACKEDSKELETONS_ACTIVE2, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_TRACKEDSKELETONS_LONGEST1, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_TRACKEDSKELETONS_LONGEST2, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
             SendDlgItemMessageW(m_hWnd, IDC_TRACKEDSKELETONS, CB_SETCURSEL, 0, 0);
             // Fill combo box options for tracking mode
 
@@ -282,11 +558,36 @@ LRESULT CALLBACK CSkeletalViewerApp::WndProc( HWND hWnd, UINT message, WPARAM wP
             SendDlgItemMessageW(m_hWnd, IDC_RANGE, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
 
             SendDlgItemMessageW(m_hWnd, IDC_RANGE, CB_SETCURSEL, 0, 0);
+
+            // Fill combo box options for color view
+
+            LoadStringW(m_hInstance, IDS_COLORVIEW_COLOR, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_COLORVIEW, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_COLORVIEW_GREENSCREEN, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_COLORVIEW, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_COLORVIEW_INFRARED, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_COLORVIEW, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            SendDlgItemMessageW(m_hWnd, IDC_COLORVIEW, CB_SETCURSEL, 0, 0);
+
+            // Fill combo box options for depth view
+
+            LoadStringW(m_hInstance, IDS_DEPTHVIEW_DEPTH, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_DEPTHVIEW, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            LoadStringW(m_hInstance, IDS_DEPTHVIEW_AUTOCONTRAST, szComboText, _countof(szComboText));
+            SendDlgItemMessageW(m_hWnd, IDC_DEPTHVIEW, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(szComboText));
+
+            SendDlgItemMessageW(m_hWnd, IDC_DEPTHVIEW, CB_SETCURSEL, 0, 0);
         }
         break;
 
         case WM_SHOWWINDOW:
         {
+            MarkStartup( SV_STARTUP_WINDOW_SHOWN );
+
             // Initialize and start NUI processing
             Nui_Init();
         }
@@ -304,8 +605,45 @@ LRESULT CALLBACK CSkeletalViewerApp::WndProc( HWND hWnd, UINT message, WPARAM wP
         }
         break;
 
+        // Errors of threads that can't show UI themselves
+        case WM_USER_SHOW_ERROR:
+        {
+            MessageBoxResource( static_cast<UINT>(wParam), MB_OK | MB_ICONHAND );
+        }
+        break;
+
+        // A sensor arrived with no pipeline to take it; wParam is TRUE if it is the one we had
+        case WM_USER_NUI_INIT:
+        {
+            // The pipeline may have been built since this was posted
+            if ( NULL == m_hThNuiProcess )
+            {
+                if ( wParam )
+                {
+                    Nui_Init( m_instanceId );
+                }
+                else
+                {
+                    Nui_Init( );
+                }
+            }
+        }
+        break;
+
         case WM_COMMAND:
         {
+            // Saved by the processing thread with the next depth frame
+            if ( HIWORD(wParam) == STN_CLICKED && LOWORD(wParam) == IDC_DEPTHVIEWER )
+            {
+                InterlockedExchange( &m_PointCloudExportPending, TRUE );
+            }
+
+            // A list whose last enumeration failed is tried again when it is opened
+            if ( HIWORD(wParam) == CBN_DROPDOWN && LOWORD(wParam) == IDC_CAMERAS )
+            {
+                UpdateKinectComboBox();
+            }
+
             if ( HIWORD(wParam) == CBN_SELCHANGE )
             {
                 switch (LOWORD(wParam))
@@ -343,6 +681,20 @@ LRESULT CALLBACK CSkeletalViewerApp::WndProc( HWND hWnd, UINT message, WPARAM wP
                         UpdateRange( static_cast<int>(index) );
                     }
                     break;
+
+                    case IDC_COLORVIEW:
+                    {
+                        LRESULT index = ::SendDlgItemMessageW(m_hWnd, IDC_COLORVIEW, CB_GETCURSEL, 0, 0);
+                        UpdateColorView( static_cast<int>(index) );
+                    }
+                    break;
+
+                    case IDC_DEPTHVIEW:
+                    {
+                        LRESULT index = ::SendDlgItemMessageW(m_hWnd, IDC_DEPTHVIEW, CB_GETCURSEL, 0, 0);
+                        UpdateDepthView( static_cast<int>(index) );
+                    }
+                    break;
                 }
             }
         }
@@ -369,6 +721,30 @@ LRESULT CALLBACK CSkeletalViewerApp::WndProc( HWND hWnd, UINT message, WPARAM wP
     return FALSE;
 }
 
+/// <summary>
+/// Records the first time a startup milestone is reached and reports it
+/// </summary>
+/// <param name="startupEvent">milestone reached, one of the SV_STARTUP_ values</param>
+void CSkeletalViewerApp::MarkStartup( int startupEvent )
+{
+    static const WCHAR * s_StartupEventNames[SV_STARTUP_COUNT] =
+    {
+        L"process start", L"window shown", L"first depth frame", L"first color frame", L"first skeleton frame"
+    };
+
+    if ( 0 != m_StartupTimeline[startupEvent] )
+    {
+        return;
+    }
+
+    m_StartupTimeline[startupEvent] = timeGetTime();
+
+    WCHAR szReport[128];
+    StringCchPrintfW( szReport, _countof(szReport), L"Startup: %s at %u ms\r\n",
+        s_StartupEventNames[startupEvent], m_StartupTimeline[startupEvent] - m_StartupTimeline[SV_STARTUP_PROCESS] );
+    OutputDebugString( szReport );
+}
+
 /// <summary>
 /// Display a MessageBox with a string table table loaded string
 /// </summary>
@@ -11,13 +11,103 @@
 #include "resource.h"
 #include "NuiApi.h"
 #include "DrawDevice.h"
+#include "DepthCodec.h"
+#include "SkeletonPublisher.h"
+#include "ImageChannel.h"
+#include "PointCloud.h"
+#include "RegistrationMap.h"
+#include "PlayerSegmentation.h"
+#include "GreenScreen.h"
+#include "TemporalDepthFilter.h"
+#include "SpatialDepthFilter.h"
+#include "DepthHistogram.h"
+#include "DepthKernel.h"
+#include "InfraredToneMap.h"
+#include "GestureEngine.h"
+#include "SkeletonKinematics.h"
+#include "JointPredictor.h"
+#include "SkeletonSelector.h"
+#include "ZoneEngine.h"
+#include "FloorEstimator.h"
+#include "HandAnalyzer.h"
+#include "TaskScheduler.h"
+#include "FrameSource.h"
+#include "SensorConnection.h"
+#include "SensorStreams.h"
 
 #define SZ_APPDLG_WINDOW_CLASS          _T("SkeletalViewerAppDlgWndClass")
 #define WM_USER_UPDATE_FPS              WM_USER
 #define WM_USER_UPDATE_COMBO            WM_USER+1
 #define WM_USER_UPDATE_TRACKING_COMBO   WM_USER+2
+#define WM_USER_SHOW_ERROR              WM_USER+3
+#define WM_USER_NUI_INIT                WM_USER+4
 
-class CSkeletalViewerApp
+// Optional pipeline stages, enabled from the command line
+enum _SV_PIPELINE_FLAGS
+{
+    SV_PIPELINE_PUBLISH_SKELETONS   = 0x00000001,
+    SV_PIPELINE_SHARE_IMAGES        = 0x00000002,
+    SV_PIPELINE_SHARE_DEPTH_RGBX    = 0x00000004,
+    SV_PIPELINE_POINT_CLOUD         = 0x00000008,
+    SV_PIPELINE_SEGMENT_PLAYERS     = 0x00000010,
+    SV_PIPELINE_TEMPORAL_FILTER     = 0x00000020,
+    SV_PIPELINE_SPATIAL_FILTER      = 0x00000040,
+    SV_PIPELINE_GESTURES            = 0x00000080,
+    SV_PIPELINE_KINEMATICS          = 0x00000100,
+    SV_PIPELINE_PREDICT_VIEW        = 0x00000200,
+    SV_PIPELINE_PREDICT_PUBLISHED   = 0x00000400,
+    SV_PIPELINE_ZONES               = 0x00000800,
+    SV_PIPELINE_FLOOR               = 0x00001000,
+    SV_PIPELINE_HANDS               = 0x00002000,
+    SV_PIPELINE_SYNC                = 0x00004000,
+    SV_PIPELINE_RECORD_DEPTH        = 0x00008000,
+};
+
+// Milestones recorded in the startup timeline
+enum _SV_STARTUP_EVENT
+{
+    SV_STARTUP_PROCESS = 0,
+    SV_STARTUP_WINDOW_SHOWN,
+    SV_STARTUP_FIRST_DEPTH,
+    SV_STARTUP_FIRST_COLOR,
+    SV_STARTUP_FIRST_SKELETON,
+    SV_STARTUP_COUNT
+};
+
+// Stages of a depth frame, run as a graph of tasks
+enum _SV_DEPTH_STAGE
+{
+    SV_DEPTH_STAGE_KERNEL = 0,
+    SV_DEPTH_STAGE_PUBLISH_DEPTH,
+    SV_DEPTH_STAGE_FLOOR,
+    SV_DEPTH_STAGE_HANDS,
+    SV_DEPTH_STAGE_FRAME_SOURCE,
+    SV_DEPTH_STAGE_RECORD,
+    SV_DEPTH_STAGE_OUTPUTS,
+    SV_DEPTH_STAGE_PUBLISH_RGBX,
+    SV_DEPTH_STAGE_COUNT
+};
+
+// The depth frame being processed, shared by its stages
+struct SV_DEPTH_FRAME
+{
+    const USHORT *          pDepth;             // filtered depth
+    DWORD                   pitch;
+    DWORD                   width;
+    DWORD                   height;
+    NUI_IMAGE_RESOLUTION    resolution;
+    DWORD                   dwFrameNumber;
+    LONGLONG                timeStamp;
+    DWORD                   outputs;            // DEPTH_KERNEL_ flags
+    DEPTH_KERNEL_TARGETS    targets;
+    PlayerSegmentation *    pSegmentation;      // NULL when players aren't segmented this frame
+    bool                    bPointCloud;
+    bool                    bExportPointCloud;
+    bool                    bGreenScreen;
+    bool                    bRegistered;        // the registration table is ready for the stages to map this frame
+};
+
+class CSkeletalViewerApp : public ISensorDevice
 {
 public:
     /// <summary>
@@ -30,6 +120,19 @@ public:
     /// </summary>
     ~CSkeletalViewerApp();
 
+    /// <summary>
+    /// Enable optional pipeline stages requested on the command line
+    /// </summary>
+    /// <param name="szCmdLine">command line arguments, without the program name</param>
+    void                    ParseCommandLine( LPCWSTR szCmdLine );
+
+    /// <summary>
+    /// Add a localhost port to send skeleton datagrams to, sending every joint of every skeleton
+    /// </summary>
+    /// <param name="port">port to send to</param>
+    /// <returns>true if the port was added, false if there are already as many as can be sent to</returns>
+    bool                    AddSkeletonUdpSubscriber( USHORT port );
+
     /// <summary>
     /// Initialize Kinect
     /// </summary>
@@ -48,11 +151,53 @@ public:
     /// </summary>
     void                    Nui_UnInit( );
 
+    /// <summary>
+    /// Acquire the sensor with an instance name, in place of any held before
+    /// </summary>
+    /// <param name="instanceName">instance name of the sensor</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT                 AcquireSensor( const WCHAR * instanceName );
+
+    /// <summary>
+    /// Open the streams of the sensor acquired
+    /// </summary>
+    /// <param name="errorId">receives the error string resource to report on failure</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT                 OpenSensorStreams( UINT & errorId );
+
+    /// <summary>
+    /// Close the streams and let go of a sensor that has been unplugged, keeping the processing pipeline alive
+    /// </summary>
+    void                    ReleaseSensor( );
+
     /// <summary>
     /// Zero out member variables
     /// </summary>
     void                    Nui_Zero( );
 
+    /// <summary>
+    /// Take the next frame of an image stream, holding the sensor lock only while it is taken
+    /// </summary>
+    /// <param name="hStream">handle of the stream, read with the lock held since a reconnect opens it again</param>
+    /// <param name="frame">receives the locked frame</param>
+    /// <param name="ppNuiSensor">receives the sensor the frame came from, with a reference given back with the frame</param>
+    /// <returns>S_OK if successful, E_NUI_DEVICE_NOT_CONNECTED without a sensor, otherwise as SensorTakeImageFrame</returns>
+    HRESULT                 Nui_TakeImageFrame( const HANDLE & hStream, SENSOR_IMAGE_FRAME & frame, INuiSensor ** ppNuiSensor );
+
+    /// <summary>
+    /// Give an image frame back to the sensor it came from, holding the sensor lock only while it is given back
+    /// </summary>
+    /// <param name="pNuiSensor">sensor from Nui_TakeImageFrame, whose reference is released</param>
+    /// <param name="frame">frame from Nui_TakeImageFrame</param>
+    void                    Nui_ReleaseImageFrame( INuiSensor * pNuiSensor, SENSOR_IMAGE_FRAME & frame );
+
+    /// <summary>
+    /// Bring the registration table up to date for a depth resolution, holding the sensor lock while the sensor is asked
+    /// </summary>
+    /// <param name="depthResolution">resolution of the depth stream</param>
+    /// <returns>true if the table is up to date, false without a sensor or its calibration</returns>
+    bool                    Nui_UpdateRegistration( NUI_IMAGE_RESOLUTION depthResolution );
+
     /// <summary>
     /// Handle new color data
     /// </summary>
@@ -133,7 +278,20 @@ public:
 
     int MessageBoxResource(UINT nID, UINT nType);
 
+    /// <summary>
+    /// Records the first time a startup milestone is reached and reports it
+    /// </summary>
+    /// <param name="startupEvent">milestone reached, one of the SV_STARTUP_ values</param>
+    void                    MarkStartup( int startupEvent );
+
 private:
+    // A stage of the depth frame, as the context of its task
+    struct DEPTH_TASK
+    {
+        CSkeletalViewerApp *    pApp;
+        int                     stage;
+    };
+
     /// <summary>
     /// Updates the combo box that lists Kinects available
     /// </summary>
@@ -156,6 +314,18 @@ private:
     /// <param name="mode">range to switch to</param>
     void                    UpdateRange( int mode );
 
+    /// <summary>
+    /// Invoked when the user changes what the color view shows
+    /// </summary>
+    /// <param name="mode">color view to switch to</param>
+    void                    UpdateColorView( int mode );
+
+    /// <summary>
+    /// Invoked when the user changes how the depth view is shaded
+    /// </summary>
+    /// <param name="mode">depth view to switch to</param>
+    void                    UpdateDepthView( int mode );
+
     /// <summary>
     /// Invoked when the user changes the selection of tracked skeletons
     /// </summary>
@@ -182,6 +352,90 @@ private:
     /// <param name="skel">skeleton frame information</param>
     void                    UpdateTrackedSkeletons( const NUI_SKELETON_FRAME & skel );
 
+    /// <summary>
+    /// Create the frame events signalled by the sensor, if not already created
+    /// </summary>
+    void                    Nui_CreateEvents( );
+
+    /// <summary>
+    /// Create draw devices, Direct2D resources and the processing thread, if not already created
+    /// </summary>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT                 Nui_CreatePipeline( );
+
+    /// <summary>
+    /// Initialize the current sensor and open its color, depth and skeleton streams
+    /// </summary>
+    /// <param name="errorId">receives the error string resource to report on failure</param>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT                 Nui_OpenStreams( UINT & errorId );
+
+    /// <summary>
+    /// Open the color stream as color or infrared, whichever the color view shows
+    /// </summary>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT                 Nui_OpenColorStream( );
+
+    /// <summary>
+    /// Shut down the current sensor's streams, leaving the pipeline untouched
+    /// </summary>
+    void                    Nui_CloseStreams( );
+
+    /// <summary>
+    /// Stop sharing images with other processes
+    /// </summary>
+    void                    Nui_DeleteImageChannels( );
+
+    /// <summary>
+    /// Create the stages the green screen color view needs, on the processing thread
+    /// </summary>
+    /// <returns>true if the green screen can be shown, false otherwise</returns>
+    bool                    Nui_EnsureGreenScreen( );
+
+    /// <summary>
+    /// Move every joint of a frame through the zones and report the ones entered and left
+    /// </summary>
+    /// <param name="frame">skeleton frame, with no skeletons when everyone has left</param>
+    void                    Nui_UpdateZones( const NUI_SKELETON_FRAME & frame );
+
+    /// <summary>
+    /// Give the floor estimator the accelerometer reading, and report the floor and the heights above it
+    /// </summary>
+    void                    Nui_ReportFloor( );
+
+    /// <summary>
+    /// Analyze the hands of the last skeleton frame in a depth frame, and report the ones that changed
+    /// </summary>
+    /// <param name="pDepth">packed depth pixels</param>
+    /// <param name="resolution">resolution of the depth frame</param>
+    void                    Nui_AnalyzeHands( const USHORT * pDepth, NUI_IMAGE_RESOLUTION resolution );
+
+    /// <summary>
+    /// Consumer of synced frame sets, reports how many came each second and how far apart their frames were
+    /// </summary>
+    /// <param name="source">frame source the consumer runs on</param>
+    /// <param name="pContext">unused</param>
+    static void             Nui_SyncConsumer( FrameSource & source, void * pContext );
+
+    /// <summary>
+    /// Add a stage to the graph of the depth frame being processed
+    /// </summary>
+    /// <param name="stage">SV_DEPTH_STAGE_ value</param>
+    /// <returns>index of the task</returns>
+    int                     Nui_AddDepthStage( int stage );
+
+    /// <summary>
+    /// Run one stage of the depth frame being processed, calls class instance stage processor
+    /// </summary>
+    /// <param name="pContext">DEPTH_TASK of the stage</param>
+    static void             Nui_DepthStageProc( void * pContext );
+
+    /// <summary>
+    /// Run one stage of the depth frame being processed
+    /// </summary>
+    /// <param name="stage">SV_DEPTH_STAGE_ value</param>
+    void                    Nui_RunDepthStage( int stage );
+
     /// <summary>
     /// Ensure necessary Direct2d resources are created
     /// </summary>
@@ -218,6 +472,19 @@ private:
     /// <returns>always 0</returns>
     DWORD WINAPI            Nui_ProcessThread( );
 
+    /// <summary>
+    /// Thread to open sensor streams during startup, calls class instance thread processor
+    /// </summary>
+    /// <param name="pParam">instance pointer</param>
+    /// <returns>always 0</returns>
+    static DWORD WINAPI     Nui_OpenStreamsThread( LPVOID pParam );
+
+    /// <summary>
+    /// Thread to open sensor streams during startup
+    /// </summary>
+    /// <returns>always 0</returns>
+    DWORD WINAPI            Nui_OpenStreamsThread( );
+
     // Current kinect
     INuiSensor *            m_pNuiSensor;
     BSTR                    m_instanceId;
@@ -238,7 +505,23 @@ private:
     // thread handling
     HANDLE        m_hThNuiProcess;
     HANDLE        m_hEvNuiProcessStop;
-    
+
+    // guards m_pNuiSensor and the stream handles against hot-plug from the status callback
+    CRITICAL_SECTION m_csNuiSensor;
+
+    // carries the pipeline across the sensor being unplugged and plugged back in
+    SensorConnection * m_pSensorConnection;
+
+    // result of the stream opens overlapped with pipeline creation
+    HRESULT       m_hrOpenStreams;
+    UINT          m_OpenStreamsErrorId;
+
+    // set by the status callback when the cached sensor list in the combo box is out of date
+    volatile LONG m_SensorListStale;
+
+    // timeGetTime() at each startup milestone, 0 if not reached yet
+    DWORD         m_StartupTimeline[SV_STARTUP_COUNT];
+
     HANDLE        m_hNextDepthFrameEvent;
     HANDLE        m_hNextColorFrameEvent;
     HANDLE        m_hNextSkeletonEvent;
@@ -256,6 +539,93 @@ private:
     DWORD         m_SkeletonTrackingFlags;
     DWORD         m_DepthStreamFlags;
 
-    DWORD         m_StickySkeletonIds[NUI_SKELETON_MAX_TRACKED_COUNT];
+    // optional pipeline stages, SV_PIPELINE_ flags
+    DWORD         m_PipelineFlags;
+
+    // skeleton output to other processes
+    SkeletonPublisher * m_pSkeletonPublisher;
+    SKELETON_UDP_SUBSCRIBER m_SkeletonUdpSubscribers[SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS];
+    UINT          m_cSkeletonUdpSubscribers;
+
+    // image output to other processes
+    ImageChannelWriter * m_pDepthChannel;
+    ImageChannelWriter * m_pColorChannel;
+    ImageChannelWriter * m_pDepthRGBXChannel;
+    ImageChannelWriter * m_pPlayerMaskChannel;
+
+    // depth frames converted to points, exported when the depth view is clicked
+    PointCloud *  m_pPointCloud;
+    volatile LONG m_PointCloudExportPending;
+
+    // depth to color mapping, and the newest color frame to look colors up in
+    RegistrationMap * m_pRegistration;
+    BYTE *        m_pLatestColor;
+
+    // per-player masks and statistics, gathered while colorizing depth
+    PlayerSegmentation * m_pSegmentation;
+
+    // what the color view shows, and the compositor for the green screen view
+    int           m_ColorView;
+    GreenScreen * m_pGreenScreen;
+    WCHAR         m_szBackgroundFile[MAX_PATH];
+
+    // depth steadied over time, then smoothed within the frame, before anything else sees it
+    TemporalDepthFilter * m_pTemporalFilter;
+    int           m_TemporalFilterMode;
+    SpatialDepthFilter * m_pSpatialFilter;
+    bool          m_bSpatialFilterGuided;
+
+    // bands the depth filters split rows into, run on m_pTaskScheduler
+    ParallelRows * m_pParallelRows;
+
+    // how the depth view is shaded, and the histogram behind auto-contrast
+    int           m_DepthView;
+    DepthHistogram * m_pDepthHistogram;
+
+    // the single pass every depth frame goes through
+    DepthKernel * m_pDepthKernel;
+
+    // turns infrared frames into gray for the color view
+    InfraredToneMap * m_pInfraredToneMap;
+
+    // swipes, pushes and raised hands found in the smoothed skeletons
+    GestureEngine * m_pGestureEngine;
+
+    // bones, joint angles, velocities and accelerations of the smoothed skeletons
+    SkeletonKinematics * m_pSkeletonKinematics;
+
+    // skeletons moved ahead to hide latency, for the view and published skeletons that opt in
+    JointPredictor * m_pJointPredictor;
+    UINT          m_PredictionHorizon;
+
+    // picks the skeletons the sensor tracks, and the choice and tracking flags it picks for
+    SkeletonSelector * m_pSkeletonSelector;
+    int           m_SelectedTrackedSkeletons;
+    DWORD         m_SelectedTrackingFlags;
+
+    // joints entering and leaving the zones of an installation
+    ZoneEngine *  m_pZoneEngine;
+    WCHAR         m_szZoneFile[MAX_PATH];
+
+    // the floor found in depth, and how high the skeletons of the last frame were above it
+    FloorEstimator * m_pFloorEstimator;
+    FLOOR_SKELETON_HEIGHT m_FloorHeights[NUI_SKELETON_COUNT];
+    UINT          m_cFloorHeights;
+
+    // open and closed hands and fingertips, from the depth around the hand joints
+    HandAnalyzer * m_pHandAnalyzer;
+
+    // stages of the depth frame, the filter bands and floor searches, spread over threads when any can run alongside others
+    TaskScheduler * m_pTaskScheduler;
+    TaskGraph     m_DepthGraph;
+    DEPTH_TASK    m_DepthTasks[SV_DEPTH_STAGE_COUNT];
+    SV_DEPTH_FRAME m_DepthFrame;
+
+    // frames handed to consumers that wait for them on fibers rather than threads
+    FrameSource * m_pFrameSource;
+
+    // depth frames compressed losslessly into a recording file
+    DepthRecorder * m_pDepthRecorder;
+    WCHAR         m_szRecordFile[MAX_PATH];
 };
 
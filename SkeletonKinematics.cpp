@@ -0,0 +1,214 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonKinematics.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "SkeletonKinematics.h"
+#include <emmintrin.h>
+
+const SKELETON_BONE g_SkeletonBones[SKELETON_BONE_COUNT] =
+{
+    // Torso
+    { NUI_SKELETON_POSITION_HEAD,           NUI_SKELETON_POSITION_SHOULDER_CENTER },
+    { NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SHOULDER_LEFT },
+    { NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SHOULDER_RIGHT },
+    { NUI_SKELETON_POSITION_SHOULDER_CENTER, NUI_SKELETON_POSITION_SPINE },
+    { NUI_SKELETON_POSITION_SPINE,          NUI_SKELETON_POSITION_HIP_CENTER },
+    { NUI_SKELETON_POSITION_HIP_CENTER,     NUI_SKELETON_POSITION_HIP_LEFT },
+    { NUI_SKELETON_POSITION_HIP_CENTER,     NUI_SKELETON_POSITION_HIP_RIGHT },
+
+    // Left Arm
+    { NUI_SKELETON_POSITION_SHOULDER_LEFT,  NUI_SKELETON_POSITION_ELBOW_LEFT },
+    { NUI_SKELETON_POSITION_ELBOW_LEFT,     NUI_SKELETON_POSITION_WRIST_LEFT },
+    { NUI_SKELETON_POSITION_WRIST_LEFT,     NUI_SKELETON_POSITION_HAND_LEFT },
+
+    // Right Arm
+    { NUI_SKELETON_POSITION_SHOULDER_RIGHT, NUI_SKELETON_POSITION_ELBOW_RIGHT },
+    { NUI_SKELETON_POSITION_ELBOW_RIGHT,    NUI_SKELETON_POSITION_WRIST_RIGHT },
+    { NUI_SKELETON_POSITION_WRIST_RIGHT,    NUI_SKELETON_POSITION_HAND_RIGHT },
+
+    // Left Leg
+    { NUI_SKELETON_POSITION_HIP_LEFT,       NUI_SKELETON_POSITION_KNEE_LEFT },
+    { NUI_SKELETON_POSITION_KNEE_LEFT,      NUI_SKELETON_POSITION_ANKLE_LEFT },
+    { NUI_SKELETON_POSITION_ANKLE_LEFT,     NUI_SKELETON_POSITION_FOOT_LEFT },
+
+    // Right Leg
+    { NUI_SKELETON_POSITION_HIP_RIGHT,      NUI_SKELETON_POSITION_KNEE_RIGHT },
+    { NUI_SKELETON_POSITION_KNEE_RIGHT,     NUI_SKELETON_POSITION_ANKLE_RIGHT },
+    { NUI_SKELETON_POSITION_ANKLE_RIGHT,    NUI_SKELETON_POSITION_FOOT_RIGHT },
+};
+
+// Bones shorter than this (in meters) have no direction to measure an angle from
+static const float g_MinBoneLength = 1e-4f;
+
+/// <summary>
+/// Arc cosine of four values, to within 7e-5 radians
+/// </summary>
+/// <param name="c">cosines, from -1 to 1</param>
+/// <returns>angles from 0 to pi</returns>
+static inline __m128 ArcCos( __m128 c )
+{
+    const __m128 signBit = _mm_set1_ps( -0.0f );
+    __m128 t = _mm_andnot_ps( signBit, c );
+
+    // Abramowitz and Stegun 4.4.45, for 0 <= t <= 1
+    __m128 poly = _mm_set1_ps( -0.0187293f );
+    poly = _mm_add_ps( _mm_mul_ps( poly, t ), _mm_set1_ps( 0.0742610f ) );
+    poly = _mm_add_ps( _mm_mul_ps( poly, t ), _mm_set1_ps( -0.2121144f ) );
+    poly = _mm_add_ps( _mm_mul_ps( poly, t ), _mm_set1_ps( 1.5707288f ) );
+    __m128 angle = _mm_mul_ps( poly, _mm_sqrt_ps( _mm_sub_ps( _mm_set1_ps( 1.0f ), t ) ) );
+
+    // acos(-t) is pi - acos(t)
+    __m128 negative = _mm_cmplt_ps( c, _mm_setzero_ps( ) );
+    __m128 reflected = _mm_sub_ps( _mm_set1_ps( 3.14159265f ), angle );
+    return _mm_or_ps( _mm_and_ps( negative, reflected ), _mm_andnot_ps( negative, angle ) );
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+SkeletonKinematics::SkeletonKinematics() :
+    m_cAngles(0),
+    m_current(0),
+    m_liLastTimeStamp(0)
+{
+    ZeroMemory( m_angles, sizeof(m_angles) );
+    ZeroMemory( m_frames, sizeof(m_frames) );
+
+    // An angle wherever one bone ends and another begins
+    for ( UINT boneIn = 0; boneIn < SKELETON_BONE_COUNT; ++boneIn )
+    {
+        for ( UINT boneOut = 0; boneOut < SKELETON_BONE_COUNT; ++boneOut )
+        {
+            if ( g_SkeletonBones[boneIn].to == g_SkeletonBones[boneOut].from && m_cAngles < SKELETON_ANGLE_MAX_COUNT )
+            {
+                SKELETON_ANGLE & angle = m_angles[m_cAngles++];
+                angle.from = g_SkeletonBones[boneIn].from;
+                angle.joint = g_SkeletonBones[boneIn].to;
+                angle.to = g_SkeletonBones[boneOut].to;
+                angle.boneIn = boneIn;
+                angle.boneOut = boneOut;
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Work out everything for a smoothed skeleton frame
+/// </summary>
+/// <param name="frame">smoothed skeleton frame, with or without tracked skeletons</param>
+/// <returns>results of the frame, valid until the next call</returns>
+const SKELETON_KINEMATICS_FRAME & SkeletonKinematics::Update( const NUI_SKELETON_FRAME & frame )
+{
+    const SKELETON_KINEMATICS_FRAME & previous = m_frames[m_current];
+    m_current ^= 1;
+    SKELETON_KINEMATICS_FRAME & current = m_frames[m_current];
+
+    // Frame timestamps are in milliseconds; a late frame breaks every skeleton's history
+    LONGLONG gap = frame.liTimeStamp.QuadPart - m_liLastTimeStamp;
+    bool bDifferenced = 0 != m_liLastTimeStamp && gap > 0 && gap <= SKELETON_KINEMATICS_MAX_GAP;
+    m_liLastTimeStamp = frame.liTimeStamp.QuadPart;
+
+    current.dwFrameNumber = frame.dwFrameNumber;
+    current.deltaTime = bDifferenced ? static_cast<float>(gap) / 1000.0f : 0.0f;
+
+    // Gather each skeleton into its lane, and which lanes can be differenced
+    DWORD trackedMask[SKELETON_KINEMATICS_LANES];
+    DWORD velocityMask[SKELETON_KINEMATICS_LANES];
+    DWORD accelerationMask[SKELETON_KINEMATICS_LANES];
+    for ( UINT lane = 0; lane < SKELETON_KINEMATICS_LANES; ++lane )
+    {
+        const NUI_SKELETON_DATA * pSkeleton = ( lane < NUI_SKELETON_COUNT ) ? &frame.SkeletonData[lane] : NULL;
+        bool bTracked = pSkeleton && NUI_SKELETON_TRACKED == pSkeleton->eTrackingState;
+
+        current.dwTrackingID[lane] = bTracked ? pSkeleton->dwTrackingID : 0;
+        if ( !bTracked )
+        {
+            current.cFrames[lane] = 0;
+        }
+        else if ( bDifferenced && previous.dwTrackingID[lane] == pSkeleton->dwTrackingID && 0 != previous.cFrames[lane] )
+        {
+            current.cFrames[lane] = previous.cFrames[lane] + 1;
+        }
+        else
+        {
+            current.cFrames[lane] = 1;
+        }
+
+        for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+        {
+            current.x[joint][lane] = bTracked ? pSkeleton->SkeletonPositions[joint].x : 0.0f;
+            current.y[joint][lane] = bTracked ? pSkeleton->SkeletonPositions[joint].y : 0.0f;
+            current.z[joint][lane] = bTracked ? pSkeleton->SkeletonPositions[joint].z : 0.0f;
+        }
+
+        trackedMask[lane] = bTracked ? 0xFFFFFFFF : 0;
+        velocityMask[lane] = ( current.cFrames[lane] >= 2 ) ? 0xFFFFFFFF : 0;
+        accelerationMask[lane] = ( current.cFrames[lane] >= 3 ) ? 0xFFFFFFFF : 0;
+    }
+
+    const __m128 inverseTime = _mm_set1_ps( bDifferenced ? 1000.0f / static_cast<float>(gap) : 0.0f );
+    const __m128 minLength = _mm_set1_ps( g_MinBoneLength * g_MinBoneLength );
+    const __m128 one = _mm_set1_ps( 1.0f );
+
+    // Four skeletons at a time.  new only aligns to 8 bytes on x86, so loads and stores are unaligned
+    for ( UINT lane = 0; lane < SKELETON_KINEMATICS_LANES; lane += 4 )
+    {
+        const __m128 tracked = _mm_castsi128_ps( _mm_loadu_si128( reinterpret_cast<const __m128i *>(trackedMask + lane) ) );
+        const __m128 velocityValid = _mm_castsi128_ps( _mm_loadu_si128( reinterpret_cast<const __m128i *>(velocityMask + lane) ) );
+        const __m128 accelerationValid = _mm_castsi128_ps( _mm_loadu_si128( reinterpret_cast<const __m128i *>(accelerationMask + lane) ) );
+
+        // Backward differences of position, then of velocity
+        for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+        {
+            __m128 vx = _mm_and_ps( velocityValid, _mm_mul_ps( inverseTime, _mm_sub_ps( _mm_loadu_ps( current.x[joint] + lane ), _mm_loadu_ps( previous.x[joint] + lane ) ) ) );
+            __m128 vy = _mm_and_ps( velocityValid, _mm_mul_ps( inverseTime, _mm_sub_ps( _mm_loadu_ps( current.y[joint] + lane ), _mm_loadu_ps( previous.y[joint] + lane ) ) ) );
+            __m128 vz = _mm_and_ps( velocityValid, _mm_mul_ps( inverseTime, _mm_sub_ps( _mm_loadu_ps( current.z[joint] + lane ), _mm_loadu_ps( previous.z[joint] + lane ) ) ) );
+            _mm_storeu_ps( current.velocityX[joint] + lane, vx );
+            _mm_storeu_ps( current.velocityY[joint] + lane, vy );
+            _mm_storeu_ps( current.velocityZ[joint] + lane, vz );
+
+            _mm_storeu_ps( current.accelerationX[joint] + lane, _mm_and_ps( accelerationValid, _mm_mul_ps( inverseTime, _mm_sub_ps( vx, _mm_loadu_ps( previous.velocityX[joint] + lane ) ) ) ) );
+            _mm_storeu_ps( current.accelerationY[joint] + lane, _mm_and_ps( accelerationValid, _mm_mul_ps( inverseTime, _mm_sub_ps( vy, _mm_loadu_ps( previous.velocityY[joint] + lane ) ) ) ) );
+            _mm_storeu_ps( current.accelerationZ[joint] + lane, _mm_and_ps( accelerationValid, _mm_mul_ps( inverseTime, _mm_sub_ps( vz, _mm_loadu_ps( previous.velocityZ[joint] + lane ) ) ) ) );
+        }
+
+        for ( UINT bone = 0; bone < SKELETON_BONE_COUNT; ++bone )
+        {
+            UINT from = g_SkeletonBones[bone].from;
+            UINT to = g_SkeletonBones[bone].to;
+
+            __m128 bx = _mm_sub_ps( _mm_loadu_ps( current.x[to] + lane ), _mm_loadu_ps( current.x[from] + lane ) );
+            __m128 by = _mm_sub_ps( _mm_loadu_ps( current.y[to] + lane ), _mm_loadu_ps( current.y[from] + lane ) );
+            __m128 bz = _mm_sub_ps( _mm_loadu_ps( current.z[to] + lane ), _mm_loadu_ps( current.z[from] + lane ) );
+            _mm_storeu_ps( current.boneX[bone] + lane, bx );
+            _mm_storeu_ps( current.boneY[bone] + lane, by );
+            _mm_storeu_ps( current.boneZ[bone] + lane, bz );
+            _mm_storeu_ps( current.boneLength[bone] + lane, _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( bx, bx ), _mm_mul_ps( by, by ) ), _mm_mul_ps( bz, bz ) ) ) );
+        }
+
+        // The angle between the bone into the joint, reversed, and the bone out of it
+        for ( UINT angle = 0; angle < m_cAngles; ++angle )
+        {
+            UINT boneIn = m_angles[angle].boneIn;
+            UINT boneOut = m_angles[angle].boneOut;
+
+            __m128 dot = _mm_add_ps( _mm_add_ps(
+                _mm_mul_ps( _mm_loadu_ps( current.boneX[boneIn] + lane ), _mm_loadu_ps( current.boneX[boneOut] + lane ) ),
+                _mm_mul_ps( _mm_loadu_ps( current.boneY[boneIn] + lane ), _mm_loadu_ps( current.boneY[boneOut] + lane ) ) ),
+                _mm_mul_ps( _mm_loadu_ps( current.boneZ[boneIn] + lane ), _mm_loadu_ps( current.boneZ[boneOut] + lane ) ) );
+            __m128 lengths = _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( current.boneLength[boneIn] + lane ), _mm_loadu_ps( current.boneLength[boneOut] + lane ) ), minLength );
+
+            __m128 cosine = _mm_div_ps( _mm_sub_ps( _mm_setzero_ps( ), dot ), lengths );
+            cosine = _mm_min_ps( _mm_max_ps( cosine, _mm_sub_ps( _mm_setzero_ps( ), one ) ), one );
+
+            __m128 radians = _mm_and_ps( tracked, ArcCos( cosine ) );
+            _mm_storeu_ps( current.angle[angle] + lane, radians );
+            _mm_storeu_ps( current.angleVelocity[angle] + lane, _mm_and_ps( velocityValid, _mm_mul_ps( inverseTime, _mm_sub_ps( radians, _mm_loadu_ps( previous.angle[angle] + lane ) ) ) ) );
+        }
+    }
+
+    return current;
+}
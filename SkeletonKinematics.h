@@ -0,0 +1,118 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonKinematics.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Bone vectors and lengths, joint angles, and joint velocities and
+// accelerations of every skeleton in a smoothed frame, for consumers that
+// would otherwise each work them out from SkeletonPositions.  Results are kept
+// as arrays of one value per skeleton, so each quantity is computed for four
+// skeletons at a time.  Bones are the ones the skeleton view draws, and an
+// angle is measured wherever one bone ends and another begins.
+
+#pragma once
+
+#include "NuiApi.h"
+
+// Skeletons are lanes of the results, padded to two SIMD registers
+#define SKELETON_KINEMATICS_LANES       8
+
+#define SKELETON_BONE_COUNT             19
+#define SKELETON_ANGLE_MAX_COUNT        24
+
+// Frames further apart than this (in milliseconds) are not differenced
+#define SKELETON_KINEMATICS_MAX_GAP     200
+
+// A bone, drawn from one joint to the next
+struct SKELETON_BONE
+{
+    NUI_SKELETON_POSITION_INDEX     from;
+    NUI_SKELETON_POSITION_INDEX     to;
+};
+
+// The skeleton topology, shared with the skeleton view
+extern const SKELETON_BONE g_SkeletonBones[SKELETON_BONE_COUNT];
+
+// An angle at a joint, between the bone that ends there and a bone that begins there
+struct SKELETON_ANGLE
+{
+    NUI_SKELETON_POSITION_INDEX     from;       // other end of the bone into the joint
+    NUI_SKELETON_POSITION_INDEX     joint;
+    NUI_SKELETON_POSITION_INDEX     to;         // other end of the bone out of the joint
+    UINT                            boneIn;     // index into g_SkeletonBones
+    UINT                            boneOut;
+};
+
+// Results of one frame.  Every array is indexed by joint, bone or angle, then by
+// lane; lane i is SkeletonData[i] of the frame
+struct SKELETON_KINEMATICS_FRAME
+{
+    DWORD   dwFrameNumber;
+    float   deltaTime;                                                  // seconds since the previous frame, 0 if not differenced
+    DWORD   dwTrackingID[SKELETON_KINEMATICS_LANES];                    // 0 if the lane has no tracked skeleton
+    DWORD   cFrames[SKELETON_KINEMATICS_LANES];                         // frames in a row the skeleton was tracked;
+                                                                        // velocities need 2, accelerations 3
+
+    float   x[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];    // meters
+    float   y[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float   z[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float   velocityX[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];    // meters per second
+    float   velocityY[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float   velocityZ[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float   accelerationX[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];    // meters per second squared
+    float   accelerationY[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+    float   accelerationZ[NUI_SKELETON_POSITION_COUNT][SKELETON_KINEMATICS_LANES];
+
+    float   boneX[SKELETON_BONE_COUNT][SKELETON_KINEMATICS_LANES];        // from to to, meters
+    float   boneY[SKELETON_BONE_COUNT][SKELETON_KINEMATICS_LANES];
+    float   boneZ[SKELETON_BONE_COUNT][SKELETON_KINEMATICS_LANES];
+    float   boneLength[SKELETON_BONE_COUNT][SKELETON_KINEMATICS_LANES];
+
+    float   angle[SKELETON_ANGLE_MAX_COUNT][SKELETON_KINEMATICS_LANES];           // radians, pi when the bones are in line
+    float   angleVelocity[SKELETON_ANGLE_MAX_COUNT][SKELETON_KINEMATICS_LANES];   // radians per second
+};
+
+class SkeletonKinematics
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    SkeletonKinematics();
+
+    /// <summary>
+    /// Work out everything for a smoothed skeleton frame
+    /// </summary>
+    /// <param name="frame">smoothed skeleton frame, with or without tracked skeletons</param>
+    /// <returns>results of the frame, valid until the next call</returns>
+    const SKELETON_KINEMATICS_FRAME & Update( const NUI_SKELETON_FRAME & frame );
+
+    /// <summary>
+    /// Results of the newest frame
+    /// </summary>
+    /// <returns>results, valid until the next call to Update</returns>
+    const SKELETON_KINEMATICS_FRAME & GetFrame( ) const { return m_frames[m_current]; }
+
+    /// <summary>
+    /// Number of joint angles
+    /// </summary>
+    /// <returns>angles measured, at most SKELETON_ANGLE_MAX_COUNT</returns>
+    UINT GetAngleCount( ) const { return m_cAngles; }
+
+    /// <summary>
+    /// Where an angle is measured
+    /// </summary>
+    /// <param name="angle">angle index</param>
+    /// <returns>joints and bones of the angle</returns>
+    const SKELETON_ANGLE & GetAngle( UINT angle ) const { return m_angles[angle]; }
+
+private:
+    SKELETON_ANGLE              m_angles[SKELETON_ANGLE_MAX_COUNT];
+    UINT                        m_cAngles;
+
+    // The newest results and the frame before, which velocities are differenced against
+    SKELETON_KINEMATICS_FRAME   m_frames[2];
+    UINT                        m_current;
+    LONGLONG                    m_liLastTimeStamp;
+};
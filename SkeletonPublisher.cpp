@@ -0,0 +1,339 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonPublisher.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "SkeletonPublisher.h"
+
+// Largest datagram: header plus every body with every joint
+static const int g_MaxDatagramSize = sizeof(SKELETON_DATAGRAM_HEADER) +
+    NUI_SKELETON_COUNT * (2 * sizeof(DWORD) + NUI_SKELETON_POSITION_COUNT * (3 * sizeof(float) + 1));
+
+/// <summary>
+/// Constructor
+/// </summary>
+SkeletonPublisher::SkeletonPublisher() :
+    m_udpSocket(INVALID_SOCKET),
+    m_bWinsockStarted(false),
+    m_cUdpSubscribers(0)
+{
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+SkeletonPublisher::~SkeletonPublisher()
+{
+    if ( INVALID_SOCKET != m_udpSocket )
+    {
+        closesocket( m_udpSocket );
+    }
+
+    if ( m_bWinsockStarted )
+    {
+        WSACleanup( );
+    }
+}
+
+/// <summary>
+/// Create the shared memory ring
+/// </summary>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT SkeletonPublisher::Initialize( )
+{
+    return m_ring.Create( SKELETON_PUBLISH_RING_NAME, sizeof(SKELETON_PUBLISH_FRAME), SKELETON_PUBLISH_RING_SLOTS );
+}
+
+/// <summary>
+/// Send datagrams to a localhost port too, filtered for it; shared memory
+/// always has everything
+/// </summary>
+/// <param name="subscriber">port to send to, and the skeletons and joints to send it</param>
+/// <returns>S_OK if successful, E_INVALIDARG without a port, E_OUTOFMEMORY if there are too many subscribers, otherwise an error code</returns>
+HRESULT SkeletonPublisher::AddUdpSubscriber( const SKELETON_UDP_SUBSCRIBER & subscriber )
+{
+    if ( 0 == subscriber.port )
+    {
+        return E_INVALIDARG;
+    }
+
+    if ( m_cUdpSubscribers >= SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS )
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    // One socket sends to every subscriber
+    if ( !m_bWinsockStarted )
+    {
+        WSADATA wsaData;
+        int err = WSAStartup( MAKEWORD(2, 2), &wsaData );
+        if ( 0 != err )
+        {
+            return HRESULT_FROM_WIN32( err );
+        }
+        m_bWinsockStarted = true;
+    }
+
+    if ( INVALID_SOCKET == m_udpSocket )
+    {
+        m_udpSocket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+        if ( INVALID_SOCKET == m_udpSocket )
+        {
+            return HRESULT_FROM_WIN32( WSAGetLastError() );
+        }
+    }
+
+    SKELETON_UDP_SUBSCRIBER & added = m_udpSubscribers[m_cUdpSubscribers++];
+    added.port = subscriber.port;
+    added.trackingID = subscriber.trackingID;
+    added.jointMask = subscriber.jointMask & SKELETON_ALL_JOINTS;
+
+    return S_OK;
+}
+
+/// <summary>
+/// Publish a skeleton frame
+/// </summary>
+/// <param name="frame">smoothed skeleton frame</param>
+void SkeletonPublisher::Publish( const NUI_SKELETON_FRAME & frame )
+{
+    SKELETON_PUBLISH_FRAME * pOut = reinterpret_cast<SKELETON_PUBLISH_FRAME *>(m_ring.BeginWrite( ));
+    if ( NULL == pOut )
+    {
+        return;
+    }
+
+    pOut->liTimeStamp = frame.liTimeStamp.QuadPart;
+    pOut->dwFrameNumber = frame.dwFrameNumber;
+    pOut->FloorClipPlane[0] = frame.vFloorClipPlane.x;
+    pOut->FloorClipPlane[1] = frame.vFloorClipPlane.y;
+    pOut->FloorClipPlane[2] = frame.vFloorClipPlane.z;
+    pOut->FloorClipPlane[3] = frame.vFloorClipPlane.w;
+
+    // Written straight into the slot, only the skeletons actually present
+    DWORD cBodies = 0;
+    for ( int i = 0 ; i < NUI_SKELETON_COUNT; i++ )
+    {
+        const NUI_SKELETON_DATA & skel = frame.SkeletonData[i];
+
+        if ( skel.eTrackingState != NUI_SKELETON_TRACKED && skel.eTrackingState != NUI_SKELETON_POSITION_ONLY )
+        {
+            continue;
+        }
+
+        SKELETON_PUBLISH_BODY & body = pOut->Bodies[cBodies++];
+        body.dwTrackingID = skel.dwTrackingID;
+        body.eTrackingState = skel.eTrackingState;
+        body.Position[0] = skel.Position.x;
+        body.Position[1] = skel.Position.y;
+        body.Position[2] = skel.Position.z;
+
+        for ( int j = 0; j < NUI_SKELETON_POSITION_COUNT; j++ )
+        {
+            body.Joints[j][0] = skel.SkeletonPositions[j].x;
+            body.Joints[j][1] = skel.SkeletonPositions[j].y;
+            body.Joints[j][2] = skel.SkeletonPositions[j].z;
+            body.JointStates[j] = static_cast<BYTE>(skel.eSkeletonPositionTrackingState[j]);
+        }
+    }
+    pOut->cBodies = cBodies;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter( &now );
+    pOut->liPublishTime = now.QuadPart;
+
+    m_ring.EndWrite( );
+
+    for ( UINT i = 0; i < m_cUdpSubscribers; ++i )
+    {
+        SendDatagram( *pOut, m_udpSubscribers[i] );
+    }
+}
+
+/// <summary>
+/// Send the compact datagram form of a published frame to a subscriber
+/// </summary>
+/// <param name="frame">frame as written to shared memory</param>
+/// <param name="subscriber">subscriber to send it to, filtered for them</param>
+void SkeletonPublisher::SendDatagram( const SKELETON_PUBLISH_FRAME & frame, const SKELETON_UDP_SUBSCRIBER & subscriber )
+{
+    BYTE datagram[g_MaxDatagramSize];
+
+    SKELETON_DATAGRAM_HEADER * pHeader = reinterpret_cast<SKELETON_DATAGRAM_HEADER *>(datagram);
+    pHeader->dwMagic = SKELETON_DATAGRAM_MAGIC;
+    pHeader->dwFrameNumber = frame.dwFrameNumber;
+    pHeader->liPublishTime = frame.liPublishTime;
+    pHeader->dwJointMask = subscriber.jointMask;
+    pHeader->cBodies = 0;
+
+    BYTE * pOut = datagram + sizeof(SKELETON_DATAGRAM_HEADER);
+
+    for ( DWORD i = 0; i < frame.cBodies; i++ )
+    {
+        const SKELETON_PUBLISH_BODY & body = frame.Bodies[i];
+
+        if ( 0 != subscriber.trackingID && body.dwTrackingID != subscriber.trackingID )
+        {
+            continue;
+        }
+
+        CopyMemory( pOut, &body.dwTrackingID, sizeof(DWORD) );
+        pOut += sizeof(DWORD);
+        CopyMemory( pOut, &body.eTrackingState, sizeof(DWORD) );
+        pOut += sizeof(DWORD);
+
+        for ( int j = 0; j < NUI_SKELETON_POSITION_COUNT; j++ )
+        {
+            if ( subscriber.jointMask & (1 << j) )
+            {
+                CopyMemory( pOut, body.Joints[j], 3 * sizeof(float) );
+                pOut += 3 * sizeof(float);
+                *(pOut++) = body.JointStates[j];
+            }
+        }
+
+        ++pHeader->cBodies;
+    }
+
+    sockaddr_in address;
+    ZeroMemory( &address, sizeof(address) );
+    address.sin_family = AF_INET;
+    address.sin_port = htons( subscriber.port );
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    // Fire and forget, nobody may be listening
+    sendto( m_udpSocket, reinterpret_cast<const char *>(datagram), static_cast<int>(pOut - datagram), 0,
+        reinterpret_cast<const sockaddr *>(&address), sizeof(address) );
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+SkeletonSubscriber::SkeletonSubscriber() :
+    m_lastCount(0),
+    m_trackingID(0),
+    m_jointMask(SKELETON_ALL_JOINTS),
+    m_lastLatency(0)
+{
+}
+
+/// <summary>
+/// Map the publisher's shared memory ring read-only
+/// </summary>
+/// <returns>S_OK if successful, otherwise an error code</returns>
+HRESULT SkeletonSubscriber::Open( )
+{
+    HRESULT hr = m_ring.Open( SKELETON_PUBLISH_RING_NAME );
+    if ( SUCCEEDED(hr) && m_ring.GetSlotSize() != sizeof(SKELETON_PUBLISH_FRAME) )
+    {
+        m_ring.Close( );
+        hr = E_FAIL;
+    }
+
+    m_lastCount = 0;
+
+    return hr;
+}
+
+/// <summary>
+/// Restrict which skeletons and joints are copied out of shared memory
+/// </summary>
+/// <param name="trackingID">only read this skeleton, 0 for all</param>
+/// <param name="jointMask">bit per NUI_SKELETON_POSITION_INDEX of joints to read</param>
+void SkeletonSubscriber::SetFilter( DWORD trackingID, DWORD jointMask )
+{
+    m_trackingID = trackingID;
+    m_jointMask = jointMask & SKELETON_ALL_JOINTS;
+}
+
+/// <summary>
+/// Copy the newest frame, if it hasn't been read already
+/// Joints outside the filter are left untouched in pFrame
+/// </summary>
+/// <param name="pFrame">receives the filtered frame</param>
+/// <returns>true if a new frame was read, false otherwise</returns>
+bool SkeletonSubscriber::ReadLatest( SKELETON_PUBLISH_FRAME * pFrame )
+{
+    DWORD count = m_ring.GetWriteCount();
+    if ( count == m_lastCount )
+    {
+        return false;
+    }
+
+    DWORD index = count - 1;
+
+    // Read in place and only copy what passes the filter
+    const SKELETON_PUBLISH_FRAME * pShared = reinterpret_cast<const SKELETON_PUBLISH_FRAME *>(m_ring.Peek( index ));
+    if ( NULL == pShared )
+    {
+        return false;
+    }
+
+    pFrame->liPublishTime = pShared->liPublishTime;
+    pFrame->liTimeStamp = pShared->liTimeStamp;
+    pFrame->dwFrameNumber = pShared->dwFrameNumber;
+    CopyMemory( pFrame->FloorClipPlane, pShared->FloorClipPlane, sizeof(pFrame->FloorClipPlane) );
+
+    DWORD cBodies = 0;
+    DWORD cSharedBodies = min( pShared->cBodies, static_cast<DWORD>(NUI_SKELETON_COUNT) );
+    for ( DWORD i = 0; i < cSharedBodies; i++ )
+    {
+        const SKELETON_PUBLISH_BODY & body = pShared->Bodies[i];
+
+        if ( 0 != m_trackingID && body.dwTrackingID != m_trackingID )
+        {
+            continue;
+        }
+
+        SKELETON_PUBLISH_BODY & out = pFrame->Bodies[cBodies++];
+        out.dwTrackingID = body.dwTrackingID;
+        out.eTrackingState = body.eTrackingState;
+        CopyMemory( out.Position, body.Position, sizeof(out.Position) );
+
+        if ( SKELETON_ALL_JOINTS == m_jointMask )
+        {
+            CopyMemory( out.Joints, body.Joints, sizeof(out.Joints) );
+            CopyMemory( out.JointStates, body.JointStates, sizeof(out.JointStates) );
+        }
+        else
+        {
+            for ( int j = 0; j < NUI_SKELETON_POSITION_COUNT; j++ )
+            {
+                if ( m_jointMask & (1 << j) )
+                {
+                    out.Joints[j][0] = body.Joints[j][0];
+                    out.Joints[j][1] = body.Joints[j][1];
+                    out.Joints[j][2] = body.Joints[j][2];
+                    out.JointStates[j] = body.JointStates[j];
+                }
+            }
+        }
+    }
+    pFrame->cBodies = cBodies;
+
+    // The writer lapped us while we were copying
+    if ( !m_ring.Validate( index ) )
+    {
+        return false;
+    }
+
+    m_lastCount = count;
+
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter( &now );
+    QueryPerformanceFrequency( &frequency );
+    m_lastLatency = (now.QuadPart - pFrame->liPublishTime) * 1000000 / frequency.QuadPart;
+
+    return true;
+}
+
+/// <summary>
+/// Time from publish to the end of the last successful ReadLatest
+/// </summary>
+/// <returns>latency in microseconds</returns>
+LONGLONG SkeletonSubscriber::GetLastLatency( ) const
+{
+    return m_lastLatency;
+}
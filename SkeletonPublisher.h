@@ -0,0 +1,158 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonPublisher.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Publishes smoothed skeleton frames to other processes through a shared memory
+// ring and, optionally, localhost UDP datagrams.  Every UDP subscriber has its
+// own port and its own filter of skeletons and joints.
+
+#pragma once
+
+#include "NuiApi.h"
+#include "SharedMemoryRing.h"
+
+#define SKELETON_PUBLISH_RING_NAME      L"Local\\SkeletalViewerSkeletons"
+#define SKELETON_PUBLISH_RING_SLOTS     8
+#define SKELETON_PUBLISH_DEFAULT_PORT   9111
+#define SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS    8
+
+// Identifies a skeleton datagram ('SVSK')
+#define SKELETON_DATAGRAM_MAGIC         0x4B535653
+
+// Every joint, for use as a joint mask
+#define SKELETON_ALL_JOINTS             ((1 << NUI_SKELETON_POSITION_COUNT) - 1)
+
+// One tracked or position-only skeleton
+struct SKELETON_PUBLISH_BODY
+{
+    DWORD   dwTrackingID;
+    DWORD   eTrackingState;
+    float   Position[3];
+    float   Joints[NUI_SKELETON_POSITION_COUNT][3];
+    BYTE    JointStates[NUI_SKELETON_POSITION_COUNT];
+};
+
+// Payload of each shared memory slot
+struct SKELETON_PUBLISH_FRAME
+{
+    LONGLONG                liPublishTime;      // QueryPerformanceCounter when published
+    LONGLONG                liTimeStamp;        // sensor timestamp of the frame
+    DWORD                   dwFrameNumber;
+    DWORD                   cBodies;
+    float                   FloorClipPlane[4];
+    SKELETON_PUBLISH_BODY   Bodies[NUI_SKELETON_COUNT];
+};
+
+// Start of each UDP datagram.  It is followed, per body, by the tracking ID
+// (DWORD), tracking state (DWORD), then x, y, z (floats) and a state byte for
+// each joint set in dwJointMask, in joint order
+struct SKELETON_DATAGRAM_HEADER
+{
+    DWORD       dwMagic;
+    DWORD       dwFrameNumber;
+    LONGLONG    liPublishTime;
+    DWORD       dwJointMask;
+    DWORD       cBodies;
+};
+
+// A localhost port datagrams are sent to, and what is sent to it
+struct SKELETON_UDP_SUBSCRIBER
+{
+    USHORT  port;
+    DWORD   trackingID;         // only send this skeleton, 0 for all
+    DWORD   jointMask;          // bit per NUI_SKELETON_POSITION_INDEX of joints to send
+};
+
+class SkeletonPublisher
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    SkeletonPublisher();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~SkeletonPublisher();
+
+    /// <summary>
+    /// Create the shared memory ring
+    /// </summary>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Initialize( );
+
+    /// <summary>
+    /// Send datagrams to a localhost port too, filtered for it; shared memory
+    /// always has everything
+    /// </summary>
+    /// <param name="subscriber">port to send to, and the skeletons and joints to send it</param>
+    /// <returns>S_OK if successful, E_INVALIDARG without a port, E_OUTOFMEMORY if there are too many subscribers, otherwise an error code</returns>
+    HRESULT AddUdpSubscriber( const SKELETON_UDP_SUBSCRIBER & subscriber );
+
+    /// <summary>
+    /// Publish a skeleton frame
+    /// </summary>
+    /// <param name="frame">smoothed skeleton frame</param>
+    void Publish( const NUI_SKELETON_FRAME & frame );
+
+private:
+    SharedMemoryRing         m_ring;
+
+    SOCKET                   m_udpSocket;
+    bool                     m_bWinsockStarted;
+    SKELETON_UDP_SUBSCRIBER  m_udpSubscribers[SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS];
+    UINT                     m_cUdpSubscribers;
+
+    /// <summary>
+    /// Send the compact datagram form of a published frame to a subscriber
+    /// </summary>
+    /// <param name="frame">frame as written to shared memory</param>
+    /// <param name="subscriber">subscriber to send it to, filtered for them</param>
+    void SendDatagram( const SKELETON_PUBLISH_FRAME & frame, const SKELETON_UDP_SUBSCRIBER & subscriber );
+};
+
+class SkeletonSubscriber
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    SkeletonSubscriber();
+
+    /// <summary>
+    /// Map the publisher's shared memory ring read-only
+    /// </summary>
+    /// <returns>S_OK if successful, otherwise an error code</returns>
+    HRESULT Open( );
+
+    /// <summary>
+    /// Restrict which skeletons and joints are copied out of shared memory
+    /// </summary>
+    /// <param name="trackingID">only read this skeleton, 0 for all</param>
+    /// <param name="jointMask">bit per NUI_SKELETON_POSITION_INDEX of joints to read</param>
+    void SetFilter( DWORD trackingID, DWORD jointMask );
+
+    /// <summary>
+    /// Copy the newest frame, if it hasn't been read already
+    /// Joints outside the filter are left untouched in pFrame
+    /// </summary>
+    /// <param name="pFrame">receives the filtered frame</param>
+    /// <returns>true if a new frame was read, false otherwise</returns>
+    bool ReadLatest( SKELETON_PUBLISH_FRAME * pFrame );
+
+    /// <summary>
+    /// Time from publish to the end of the last successful ReadLatest
+    /// </summary>
+    /// <returns>latency in microseconds</returns>
+    LONGLONG GetLastLatency( ) const;
+
+private:
+    SharedMemoryRing         m_ring;
+    DWORD                    m_lastCount;       // write count when the last frame was read
+    DWORD                    m_trackingID;
+    DWORD                    m_jointMask;
+    LONGLONG                 m_lastLatency;
+};
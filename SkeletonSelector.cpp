@@ -0,0 +1,207 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonSelector.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "SkeletonSelector.h"
+#include <math.h>
+
+// Rank of a picked skeleton under the sticky policy, better than any other
+static const float g_StickyRank = -1e30f;
+
+/// <summary>
+/// Constructor
+/// </summary>
+SkeletonSelector::SkeletonSelector() :
+    m_policy(SKELETON_SELECT_NEAREST),
+    m_count(1),
+    m_zoneX(SKELETON_SELECT_DEFAULT_ZONE_X),
+    m_zoneZ(SKELETON_SELECT_DEFAULT_ZONE_Z),
+    m_frame(0),
+    m_liLastTimeStamp(0),
+    m_bSent(false),
+    m_cCallsMade(0),
+    m_cCallsAvoided(0)
+{
+    ZeroMemory( m_candidates, sizeof(m_candidates) );
+    ZeroMemory( m_picked, sizeof(m_picked) );
+}
+
+/// <summary>
+/// Set how skeletons are picked, forgetting the picked ones
+/// </summary>
+/// <param name="policy">how skeletons are ranked</param>
+/// <param name="count">how many to pick, 1 or 2</param>
+void SkeletonSelector::SetPolicy( SKELETON_SELECTION_POLICY policy, UINT count )
+{
+    m_policy = policy;
+    m_count = ( count >= NUI_SKELETON_MAX_TRACKED_COUNT ) ? NUI_SKELETON_MAX_TRACKED_COUNT : 1;
+
+    ZeroMemory( m_picked, sizeof(m_picked) );
+    m_bSent = false;
+}
+
+/// <summary>
+/// Set the point SKELETON_SELECT_ZONE_CENTER ranks skeletons by their distance from
+/// </summary>
+/// <param name="x">x (in meters) of the center</param>
+/// <param name="z">distance (in meters) of the center from the sensor</param>
+void SkeletonSelector::SetZoneCenter( float x, float z )
+{
+    m_zoneX = x;
+    m_zoneZ = z;
+}
+
+/// <summary>
+/// Find the candidate of a skeleton, taking over one that has left for a new skeleton
+/// </summary>
+/// <param name="dwTrackingID">tracking ID of the skeleton</param>
+/// <returns>candidate of the skeleton</returns>
+SkeletonSelector::SKELETON_CANDIDATE * SkeletonSelector::FindCandidate( DWORD dwTrackingID )
+{
+    SKELETON_CANDIDATE * pOldest = NULL;
+
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        SKELETON_CANDIDATE & candidate = m_candidates[i];
+        if ( candidate.dwTrackingID == dwTrackingID )
+        {
+            return &candidate;
+        }
+
+        // Candidates not seen this frame belong to skeletons that have left
+        if ( candidate.lastFrame != m_frame && (NULL == pOldest || candidate.lastFrame < pOldest->lastFrame) )
+        {
+            pOldest = &candidate;
+        }
+    }
+
+    // There are as many candidates as skeletons in a frame, so one is always free
+    ZeroMemory( pOldest, sizeof(*pOldest) );
+    pOldest->dwTrackingID = dwTrackingID;
+    pOldest->firstFrame = m_frame;
+
+    return pOldest;
+}
+
+/// <summary>
+/// How a candidate ranks under the policy, lower is better
+/// </summary>
+/// <param name="candidate">candidate to rank</param>
+/// <param name="index">index of the skeleton in the frame</param>
+/// <param name="bPicked">whether the candidate is picked now</param>
+/// <returns>rank of the candidate</returns>
+float SkeletonSelector::Rank( const SKELETON_CANDIDATE & candidate, UINT index, bool bPicked ) const
+{
+    switch ( m_policy )
+    {
+    case SKELETON_SELECT_NEAREST:
+        return candidate.z - ( bPicked ? SKELETON_SELECT_DISTANCE_MARGIN : 0.0f );
+
+    case SKELETON_SELECT_ZONE_CENTER:
+        {
+            float dx = candidate.x - m_zoneX;
+            float dz = candidate.z - m_zoneZ;
+            return sqrtf( dx * dx + dz * dz ) - ( bPicked ? SKELETON_SELECT_DISTANCE_MARGIN : 0.0f );
+        }
+
+    case SKELETON_SELECT_MOST_ACTIVE:
+        return -candidate.activity - ( bPicked ? SKELETON_SELECT_ACTIVITY_MARGIN : 0.0f );
+
+    case SKELETON_SELECT_LONGEST_PRESENT:
+        // Whoever is picked arrived first, so only leaving gives up the place
+        return static_cast<float>(candidate.firstFrame);
+
+    default:
+        // Sticky: picked skeletons stay until they leave, and the first in the frame fills a place
+        return bPicked ? g_StickyRank : static_cast<float>(index);
+    }
+}
+
+/// <summary>
+/// Pick skeletons from a frame
+/// </summary>
+/// <param name="frame">skeleton frame</param>
+/// <param name="trackedIDs">receives the tracking IDs picked, 0 for none</param>
+/// <returns>true if the sensor has to be told about a new pick, false if it already tracks these</returns>
+bool SkeletonSelector::Select( const NUI_SKELETON_FRAME & frame, DWORD trackedIDs[NUI_SKELETON_MAX_TRACKED_COUNT] )
+{
+    ++m_frame;
+
+    // Frame timestamps are in milliseconds; speeds aren't taken across dropped frames
+    LONGLONG gap = frame.liTimeStamp.QuadPart - m_liLastTimeStamp;
+    float inverseTime = ( 0 != m_liLastTimeStamp && gap > 0 && gap <= 200 ) ? 1000.0f / static_cast<float>(gap) : 0.0f;
+    m_liLastTimeStamp = frame.liTimeStamp.QuadPart;
+
+    // One pass keeps the candidates current and the two best ranked
+    DWORD bestIDs[NUI_SKELETON_MAX_TRACKED_COUNT] = { 0, 0 };
+    float bestRanks[NUI_SKELETON_MAX_TRACKED_COUNT] = { 0.0f, 0.0f };
+
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        const NUI_SKELETON_DATA & skeleton = frame.SkeletonData[i];
+        if ( NUI_SKELETON_TRACKED != skeleton.eTrackingState && NUI_SKELETON_POSITION_ONLY != skeleton.eTrackingState )
+        {
+            continue;
+        }
+
+        SKELETON_CANDIDATE * pCandidate = FindCandidate( skeleton.dwTrackingID );
+        if ( pCandidate->lastFrame + 1 == m_frame && inverseTime > 0.0f )
+        {
+            float dx = skeleton.Position.x - pCandidate->x;
+            float dz = skeleton.Position.z - pCandidate->z;
+            float speed = sqrtf( dx * dx + dz * dz ) * inverseTime;
+            pCandidate->activity += SKELETON_SELECT_ACTIVITY_WEIGHT * (speed - pCandidate->activity);
+        }
+        pCandidate->x = skeleton.Position.x;
+        pCandidate->z = skeleton.Position.z;
+        pCandidate->lastFrame = m_frame;
+
+        bool bPicked = m_bSent && (skeleton.dwTrackingID == m_picked[0] || skeleton.dwTrackingID == m_picked[1]);
+        float rank = Rank( *pCandidate, i, bPicked );
+
+        // Ties go to the skeleton found first
+        if ( 0 == bestIDs[0] || rank < bestRanks[0] )
+        {
+            bestIDs[1] = bestIDs[0];
+            bestRanks[1] = bestRanks[0];
+            bestIDs[0] = skeleton.dwTrackingID;
+            bestRanks[0] = rank;
+        }
+        else if ( 0 == bestIDs[1] || rank < bestRanks[1] )
+        {
+            bestIDs[1] = skeleton.dwTrackingID;
+            bestRanks[1] = rank;
+        }
+    }
+
+    if ( m_count < 2 )
+    {
+        bestIDs[1] = 0;
+    }
+
+    // The same two skeletons in the other order are the same pick
+    if ( bestIDs[0] == m_picked[1] && bestIDs[1] == m_picked[0] )
+    {
+        bestIDs[0] = m_picked[0];
+        bestIDs[1] = m_picked[1];
+    }
+
+    trackedIDs[0] = bestIDs[0];
+    trackedIDs[1] = bestIDs[1];
+
+    if ( m_bSent && bestIDs[0] == m_picked[0] && bestIDs[1] == m_picked[1] )
+    {
+        ++m_cCallsAvoided;
+        return false;
+    }
+
+    m_picked[0] = bestIDs[0];
+    m_picked[1] = bestIDs[1];
+    m_bSent = true;
+    ++m_cCallsMade;
+
+    return true;
+}
@@ -0,0 +1,132 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonSelector.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Picks which skeletons the sensor tracks fully when the application chooses
+// them.  Each policy ranks the skeletons in view, nearest first, closest to
+// the zone center first, most active first or longest present first, and the
+// sticky policy keeps whoever it picked until they leave.  Skeletons already
+// picked keep their place unless another ranks better by a margin, so two
+// people at about the same distance don't trade places every frame.  The
+// sensor only needs to be told when the picked skeletons change.
+
+#pragma once
+
+#include "NuiApi.h"
+
+enum SKELETON_SELECTION_POLICY
+{
+    SKELETON_SELECT_NEAREST = 0,
+    SKELETON_SELECT_STICKY,
+    SKELETON_SELECT_ZONE_CENTER,
+    SKELETON_SELECT_MOST_ACTIVE,
+    SKELETON_SELECT_LONGEST_PRESENT
+};
+
+// How much better (in meters) a skeleton must be placed to take over a picked one
+#define SKELETON_SELECT_DISTANCE_MARGIN     0.15f
+
+// How much more active (in meters per second) a skeleton must be to take over a picked one
+#define SKELETON_SELECT_ACTIVITY_MARGIN     0.20f
+
+// Weight of each new frame in the running average of how fast a skeleton moves
+#define SKELETON_SELECT_ACTIVITY_WEIGHT     0.1f
+
+// Where the zone center is until it is set, in skeleton space
+#define SKELETON_SELECT_DEFAULT_ZONE_X      0.0f
+#define SKELETON_SELECT_DEFAULT_ZONE_Z      2.0f
+
+class SkeletonSelector
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    SkeletonSelector();
+
+    /// <summary>
+    /// Set how skeletons are picked, forgetting the picked ones
+    /// </summary>
+    /// <param name="policy">how skeletons are ranked</param>
+    /// <param name="count">how many to pick, 1 or 2</param>
+    void SetPolicy( SKELETON_SELECTION_POLICY policy, UINT count );
+
+    /// <summary>
+    /// Set the point SKELETON_SELECT_ZONE_CENTER ranks skeletons by their distance from
+    /// </summary>
+    /// <param name="x">x (in meters) of the center</param>
+    /// <param name="z">distance (in meters) of the center from the sensor</param>
+    void SetZoneCenter( float x, float z );
+
+    /// <summary>
+    /// Pick skeletons from a frame
+    /// </summary>
+    /// <param name="frame">skeleton frame</param>
+    /// <param name="trackedIDs">receives the tracking IDs picked, 0 for none</param>
+    /// <returns>true if the sensor has to be told about a new pick, false if it already tracks these</returns>
+    bool Select( const NUI_SKELETON_FRAME & frame, DWORD trackedIDs[NUI_SKELETON_MAX_TRACKED_COUNT] );
+
+    /// <summary>
+    /// Have the next pick sent to the sensor whether or not it changed, after the sensor
+    /// failed to take one or stopped being told
+    /// </summary>
+    void Invalidate( ) { m_bSent = false; }
+
+    /// <summary>
+    /// Number of picks the sensor has been told about
+    /// </summary>
+    /// <returns>picks sent</returns>
+    DWORD GetCallsMade( ) const { return m_cCallsMade; }
+
+    /// <summary>
+    /// Number of frames whose pick was the one the sensor already had
+    /// </summary>
+    /// <returns>calls to the sensor not made</returns>
+    DWORD GetCallsAvoided( ) const { return m_cCallsAvoided; }
+
+private:
+    // What is known about each skeleton in view
+    struct SKELETON_CANDIDATE
+    {
+        DWORD   dwTrackingID;       // 0 when free
+        DWORD   firstFrame;         // selector frame the skeleton appeared in
+        DWORD   lastFrame;          // selector frame it was last seen in
+        float   x;                  // position (in meters) when last seen
+        float   z;
+        float   activity;           // running average of its speed (in meters per second)
+    };
+
+    /// <summary>
+    /// Find the candidate of a skeleton, taking over one that has left for a new skeleton
+    /// </summary>
+    /// <param name="dwTrackingID">tracking ID of the skeleton</param>
+    /// <returns>candidate of the skeleton</returns>
+    SKELETON_CANDIDATE * FindCandidate( DWORD dwTrackingID );
+
+    /// <summary>
+    /// How a candidate ranks under the policy, lower is better
+    /// </summary>
+    /// <param name="candidate">candidate to rank</param>
+    /// <param name="index">index of the skeleton in the frame</param>
+    /// <param name="bPicked">whether the candidate is picked now</param>
+    /// <returns>rank of the candidate</returns>
+    float Rank( const SKELETON_CANDIDATE & candidate, UINT index, bool bPicked ) const;
+
+    SKELETON_SELECTION_POLICY   m_policy;
+    UINT                        m_count;
+    float                       m_zoneX;
+    float                       m_zoneZ;
+
+    SKELETON_CANDIDATE          m_candidates[NUI_SKELETON_COUNT];
+    DWORD                       m_frame;
+    LONGLONG                    m_liLastTimeStamp;
+
+    // The pick the sensor was last told about
+    DWORD                       m_picked[NUI_SKELETON_MAX_TRACKED_COUNT];
+    bool                        m_bSent;
+
+    DWORD                       m_cCallsMade;
+    DWORD                       m_cCallsAvoided;
+};
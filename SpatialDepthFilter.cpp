@@ -0,0 +1,282 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SpatialDepthFilter.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "SpatialDepthFilter.h"
+#include <math.h>
+
+/// <summary>
+/// Constructor
+/// </summary>
+SpatialDepthFilter::SpatialDepthFilter() :
+    m_resolution(NUI_IMAGE_RESOLUTION_INVALID),
+    m_width(0),
+    m_height(0),
+    m_pOutput(NULL),
+    m_pSource(NULL),
+    m_sourcePitch(0),
+    m_pGuide(NULL)
+{
+    SetWeights( SPATIAL_FILTER_DEFAULT_SIGMA_SPACE, SPATIAL_FILTER_DEFAULT_SIGMA_DEPTH, SPATIAL_FILTER_DEFAULT_SIGMA_COLOR );
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+SpatialDepthFilter::~SpatialDepthFilter()
+{
+    _aligned_free( m_pOutput );
+}
+
+/// <summary>
+/// Allocate the output for frames of the given resolution, keeping it if nothing changed
+/// </summary>
+/// <param name="resolution">resolution of depth frames</param>
+/// <returns>true if successful, false otherwise</returns>
+bool SpatialDepthFilter::Initialize( NUI_IMAGE_RESOLUTION resolution )
+{
+    if ( resolution == m_resolution )
+    {
+        return true;
+    }
+
+    DWORD width, height;
+    NuiImageResolutionToSize( resolution, width, height );
+
+    // Tiles are sized for the widest depth frame
+    if ( 0 == width || 0 == height || width > SPATIAL_FILTER_MAX_WIDTH )
+    {
+        return false;
+    }
+
+    _aligned_free( m_pOutput );
+    m_resolution = NUI_IMAGE_RESOLUTION_INVALID;
+
+    m_pOutput = static_cast<USHORT *>(_aligned_malloc( width * height * sizeof(USHORT), 16 ));
+    if ( NULL == m_pOutput )
+    {
+        return false;
+    }
+
+    m_resolution = resolution;
+    m_width = width;
+    m_height = height;
+
+    return true;
+}
+
+/// <summary>
+/// Rebuild the weight tables
+/// </summary>
+/// <param name="sigmaSpace">spread (in pixels) of the distance weight</param>
+/// <param name="sigmaDepth">spread (in millimeters) of the depth difference weight</param>
+/// <param name="sigmaColor">spread (in brightness levels) of the color difference weight</param>
+void SpatialDepthFilter::SetWeights( float sigmaSpace, float sigmaDepth, float sigmaColor )
+{
+    for ( int tap = 0; tap < SPATIAL_FILTER_TAPS; ++tap )
+    {
+        float distance = static_cast<float>(tap - SPATIAL_FILTER_RADIUS);
+        float spaceWeight = expf( -distance * distance / (2.0f * sigmaSpace * sigmaSpace) );
+
+        for ( UINT step = 0; step < SPATIAL_FILTER_DEPTH_STEPS; ++step )
+        {
+            float difference = static_cast<float>(step << SPATIAL_FILTER_DEPTH_STEP_SHIFT);
+            float depthWeight = expf( -difference * difference / (2.0f * sigmaDepth * sigmaDepth) );
+            m_depthWeight[tap][step] = static_cast<BYTE>(255.0f * spaceWeight * depthWeight + 0.5f);
+        }
+
+        // Differences past the table are never the same surface
+        m_depthWeight[tap][SPATIAL_FILTER_DEPTH_STEPS - 1] = 0;
+    }
+
+    for ( UINT level = 0; level < _countof(m_colorWeight); ++level )
+    {
+        float difference = static_cast<float>(level);
+        m_colorWeight[level] = static_cast<BYTE>(255.0f * expf( -difference * difference / (2.0f * sigmaColor * sigmaColor) ) + 0.5f);
+    }
+
+    // Rounded up so a sum of equal depths divides back exactly
+    m_reciprocal[0] = 0;
+    for ( UINT sum = 1; sum < _countof(m_reciprocal); ++sum )
+    {
+        m_reciprocal[sum] = static_cast<DWORD>(min( (0x100000000ULL + sum - 1) / sum, 0xFFFFFFFFULL ));
+    }
+}
+
+/// <summary>
+/// Filter a depth frame
+/// </summary>
+/// <param name="pDepth">packed depth and player index of the frame</param>
+/// <param name="pitch">length (in bytes) between the starts of two rows in pDepth</param>
+/// <param name="pGuide">BGRX color of each depth pixel to guide the filter, NULL to use depth alone</param>
+/// <param name="pRows">threads to split the frame over, NULL to filter on the caller's thread</param>
+/// <returns>filtered frame with the player index of pDepth, valid until the next call</returns>
+const USHORT * SpatialDepthFilter::Filter( const USHORT * pDepth, UINT pitch, const BYTE * pGuide, ParallelRows * pRows )
+{
+    m_pSource = pDepth;
+    m_sourcePitch = pitch;
+    m_pGuide = pGuide;
+
+    if ( pRows )
+    {
+        pRows->Run( FilterRows, this, m_height );
+    }
+    else
+    {
+        FilterRows( this, 0, m_height );
+    }
+
+    return m_pOutput;
+}
+
+/// <summary>
+/// Filter a band of rows, one tile at a time, called through ParallelRows
+/// </summary>
+/// <param name="pContext">filter instance</param>
+/// <param name="firstRow">first row of the band</param>
+/// <param name="endRow">row after the band</param>
+void SpatialDepthFilter::FilterRows( void * pContext, UINT firstRow, UINT endRow )
+{
+    SpatialDepthFilter * pThis = static_cast<SpatialDepthFilter *>(pContext);
+
+    // Each thread has its own tile, on its stack
+    USHORT depthTile[(SPATIAL_FILTER_TILE_ROWS + 2 * SPATIAL_FILTER_RADIUS) * SPATIAL_FILTER_TILE_STRIDE];
+    BYTE lumaTile[(SPATIAL_FILTER_TILE_ROWS + 2 * SPATIAL_FILTER_RADIUS) * SPATIAL_FILTER_TILE_STRIDE];
+
+    for ( UINT y = firstRow; y < endRow; y += SPATIAL_FILTER_TILE_ROWS )
+    {
+        UINT tileEnd = min( y + SPATIAL_FILTER_TILE_ROWS, endRow );
+        if ( pThis->m_pGuide )
+        {
+            pThis->FilterTile<true>( y, tileEnd, depthTile, lumaTile );
+        }
+        else
+        {
+            pThis->FilterTile<false>( y, tileEnd, depthTile, lumaTile );
+        }
+    }
+}
+
+/// <summary>
+/// Weight of one tap
+/// </summary>
+/// <param name="depth">depth (in millimeters) of the tap, 0 for none</param>
+/// <param name="center">depth (in millimeters) of the pixel being filtered</param>
+/// <param name="pDepthWeight">depth difference weights of the tap</param>
+/// <returns>weight, 0 if the tap has no depth</returns>
+static inline UINT TapWeight( UINT depth, UINT center, const BYTE * pDepthWeight )
+{
+    UINT step = static_cast<UINT>(abs( static_cast<int>(depth - center) )) >> SPATIAL_FILTER_DEPTH_STEP_SHIFT;
+    UINT holeMask = 0 - static_cast<UINT>(0 != depth);
+
+    return pDepthWeight[min( step, SPATIAL_FILTER_DEPTH_STEPS - 1 )] & holeMask;
+}
+
+/// <summary>
+/// Filter rows firstRow to endRow through one tile
+/// </summary>
+/// <param name="firstRow">first row of the tile</param>
+/// <param name="endRow">row after the tile</param>
+/// <param name="pDepthTile">rows filtered across, SPATIAL_FILTER_TILE_STRIDE apart</param>
+/// <param name="pLumaTile">brightness of the guide, SPATIAL_FILTER_TILE_STRIDE apart</param>
+template <bool bGuided>
+void SpatialDepthFilter::FilterTile( UINT firstRow, UINT endRow, USHORT * pDepthTile, BYTE * pLumaTile )
+{
+    const int radius = SPATIAL_FILTER_RADIUS;
+    const int width = m_width;
+    const int rowCount = endRow - firstRow + 2 * radius;
+
+    // One source row as plain depth, with no depth past either end so the taps need no bounds checks
+    USHORT line[SPATIAL_FILTER_TILE_STRIDE];
+    ZeroMemory( line, sizeof(line) );
+
+    // Across: the tile's rows and the rows above and below that the filter down reaches
+    for ( int row = 0; row < rowCount; ++row )
+    {
+        int y = static_cast<int>(firstRow) - radius + row;
+        USHORT * pTileRow = pDepthTile + row * SPATIAL_FILTER_TILE_STRIDE;
+        BYTE * pLuma = pLumaTile + row * SPATIAL_FILTER_TILE_STRIDE + radius;
+
+        // Rows off the frame have no depth, so they get no weight going down
+        if ( y < 0 || y >= static_cast<int>(m_height) )
+        {
+            ZeroMemory( pTileRow, width * sizeof(USHORT) );
+            continue;
+        }
+
+        const USHORT * pSource = reinterpret_cast<const USHORT *>(reinterpret_cast<const BYTE *>(m_pSource) + y * m_sourcePitch);
+        for ( int x = 0; x < width; ++x )
+        {
+            line[radius + x] = pSource[x] >> NUI_IMAGE_PLAYER_INDEX_SHIFT;
+        }
+
+        if ( bGuided )
+        {
+            const BYTE * pColor = m_pGuide + y * width * 4;
+            for ( int x = 0; x < width; ++x, pColor += 4 )
+            {
+                pLuma[x] = static_cast<BYTE>((29 * pColor[0] + 150 * pColor[1] + 77 * pColor[2]) >> 8);
+            }
+        }
+
+        for ( int x = 0; x < width; ++x )
+        {
+            const USHORT * pTaps = line + x;
+            UINT center = pTaps[radius];
+            UINT sum = 0;
+            UINT weightSum = 0;
+
+            for ( int tap = 0; tap < SPATIAL_FILTER_TAPS; ++tap )
+            {
+                UINT depth = pTaps[tap];
+                UINT weight = TapWeight( depth, center, m_depthWeight[tap] );
+                if ( bGuided )
+                {
+                    weight = (weight * m_colorWeight[abs( pLuma[x + tap - radius] - pLuma[x] )]) >> 8;
+                }
+
+                sum += weight * depth;
+                weightSum += weight;
+            }
+
+            // Holes stay holes, their weight sum is 0 and so is the reciprocal
+            pTileRow[x] = static_cast<USHORT>(UInt32x32To64( sum + weightSum / 2, m_reciprocal[weightSum] ) >> 32);
+        }
+    }
+
+    // Down: tile into the output, with the player index put back
+    for ( int row = radius; row < rowCount - radius; ++row )
+    {
+        int y = static_cast<int>(firstRow) - radius + row;
+        const USHORT * pSource = reinterpret_cast<const USHORT *>(reinterpret_cast<const BYTE *>(m_pSource) + y * m_sourcePitch);
+        const USHORT * pTaps = pDepthTile + (row - radius) * SPATIAL_FILTER_TILE_STRIDE;
+        const BYTE * pLumaTaps = pLumaTile + (row - radius) * SPATIAL_FILTER_TILE_STRIDE + radius;
+        USHORT * pOut = m_pOutput + y * width;
+
+        for ( int x = 0; x < width; ++x )
+        {
+            UINT center = pTaps[radius * SPATIAL_FILTER_TILE_STRIDE + x];
+            UINT sum = 0;
+            UINT weightSum = 0;
+
+            for ( int tap = 0; tap < SPATIAL_FILTER_TAPS; ++tap )
+            {
+                UINT depth = pTaps[tap * SPATIAL_FILTER_TILE_STRIDE + x];
+                UINT weight = TapWeight( depth, center, m_depthWeight[tap] );
+                if ( bGuided )
+                {
+                    weight = (weight * m_colorWeight[abs( pLumaTaps[tap * SPATIAL_FILTER_TILE_STRIDE + x] - pLumaTaps[radius * SPATIAL_FILTER_TILE_STRIDE + x] )]) >> 8;
+                }
+
+                sum += weight * depth;
+                weightSum += weight;
+            }
+
+            UINT filtered = static_cast<UINT>(UInt32x32To64( sum + weightSum / 2, m_reciprocal[weightSum] ) >> 32);
+            pOut[x] = static_cast<USHORT>((filtered << NUI_IMAGE_PLAYER_INDEX_SHIFT) | (pSource[x] & NUI_IMAGE_PLAYER_INDEX_MASK));
+        }
+    }
+}
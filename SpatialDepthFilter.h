@@ -0,0 +1,110 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SpatialDepthFilter.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Smooths depth frames without blurring across edges.  A separable bilateral
+// filter averages each pixel with neighbors of similar depth, and optionally of
+// similar brightness in a registered color frame, so depth edges snap to the
+// edges seen by the color camera.  Weights are fixed point and looked up in
+// tables built once, and rows go through a small tile that stays in L1.
+
+#pragma once
+
+#include "NuiApi.h"
+#include "ParallelRows.h"
+
+// Taps on each side of a pixel, fixed so the taps unroll
+#define SPATIAL_FILTER_RADIUS               2
+#define SPATIAL_FILTER_TAPS                 (2 * SPATIAL_FILTER_RADIUS + 1)
+#define SPATIAL_FILTER_MAX_WIDTH            640
+
+// Rows filtered per tile; with the borders the tile is about 23 KB at 640 wide
+#define SPATIAL_FILTER_TILE_ROWS            8
+#define SPATIAL_FILTER_TILE_STRIDE          (SPATIAL_FILTER_MAX_WIDTH + 2 * SPATIAL_FILTER_RADIUS)
+
+// Depth differences are looked up in steps of 1 << shift millimeters
+#define SPATIAL_FILTER_DEPTH_STEP_SHIFT     2
+#define SPATIAL_FILTER_DEPTH_STEPS          256
+
+// Default spread of the weights in pixels, millimeters and brightness levels
+#define SPATIAL_FILTER_DEFAULT_SIGMA_SPACE  1.5f
+#define SPATIAL_FILTER_DEFAULT_SIGMA_DEPTH  40.0f
+#define SPATIAL_FILTER_DEFAULT_SIGMA_COLOR  16.0f
+
+class SpatialDepthFilter
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    SpatialDepthFilter();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~SpatialDepthFilter();
+
+    /// <summary>
+    /// Allocate the output for frames of the given resolution, keeping it if nothing changed
+    /// </summary>
+    /// <param name="resolution">resolution of depth frames</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Initialize( NUI_IMAGE_RESOLUTION resolution );
+
+    /// <summary>
+    /// Rebuild the weight tables
+    /// </summary>
+    /// <param name="sigmaSpace">spread (in pixels) of the distance weight</param>
+    /// <param name="sigmaDepth">spread (in millimeters) of the depth difference weight</param>
+    /// <param name="sigmaColor">spread (in brightness levels) of the color difference weight</param>
+    void SetWeights( float sigmaSpace, float sigmaDepth, float sigmaColor );
+
+    /// <summary>
+    /// Filter a depth frame
+    /// </summary>
+    /// <param name="pDepth">packed depth and player index of the frame</param>
+    /// <param name="pitch">length (in bytes) between the starts of two rows in pDepth</param>
+    /// <param name="pGuide">BGRX color of each depth pixel to guide the filter, NULL to use depth alone</param>
+    /// <param name="pRows">threads to split the frame over, NULL to filter on the caller's thread</param>
+    /// <returns>filtered frame with the player index of pDepth, valid until the next call</returns>
+    const USHORT * Filter( const USHORT * pDepth, UINT pitch, const BYTE * pGuide, ParallelRows * pRows );
+
+private:
+    /// <summary>
+    /// Filter a band of rows, one tile at a time, called through ParallelRows
+    /// </summary>
+    /// <param name="pContext">filter instance</param>
+    /// <param name="firstRow">first row of the band</param>
+    /// <param name="endRow">row after the band</param>
+    static void             FilterRows( void * pContext, UINT firstRow, UINT endRow );
+
+    /// <summary>
+    /// Filter rows firstRow to endRow through one tile
+    /// </summary>
+    /// <param name="firstRow">first row of the tile</param>
+    /// <param name="endRow">row after the tile</param>
+    /// <param name="pDepthTile">rows filtered across, SPATIAL_FILTER_TILE_STRIDE apart</param>
+    /// <param name="pLumaTile">brightness of the guide, SPATIAL_FILTER_TILE_STRIDE apart</param>
+    template <bool bGuided>
+    void                    FilterTile( UINT firstRow, UINT endRow, USHORT * pDepthTile, BYTE * pLumaTile );
+
+    NUI_IMAGE_RESOLUTION    m_resolution;
+    UINT                    m_width;
+    UINT                    m_height;
+
+    // Distance and depth difference weight of each tap, both folded into one byte
+    BYTE                    m_depthWeight[SPATIAL_FILTER_TAPS][SPATIAL_FILTER_DEPTH_STEPS];
+    BYTE                    m_colorWeight[256];
+
+    // 2^32 / sum of weights, the center tap keeps the sum from getting small
+    DWORD                   m_reciprocal[SPATIAL_FILTER_TAPS * 255 + 1];
+
+    USHORT *                m_pOutput;
+
+    // The frame being filtered, for FilterRows
+    const USHORT *          m_pSource;
+    UINT                    m_sourcePitch;
+    const BYTE *            m_pGuide;
+};
@@ -0,0 +1,393 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="TaskScheduler.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "TaskScheduler.h"
+
+// Times a worker looks for work before it goes to sleep; tasks of a frame come in quick succession
+static const UINT g_SpinCount = 200;
+
+/// <summary>
+/// Constructor
+/// </summary>
+TaskGraph::TaskGraph() :
+    m_cTasks(0),
+    m_cRemaining(0)
+{
+}
+
+/// <summary>
+/// Remove every task, the graph must not be running
+/// </summary>
+void TaskGraph::Clear( )
+{
+    m_cTasks = 0;
+    m_cRemaining = 0;
+}
+
+/// <summary>
+/// Add a task
+/// </summary>
+/// <param name="pfnProc">called to run the task</param>
+/// <param name="pContext">passed through to pfnProc</param>
+/// <returns>index of the task, -1 if the graph is full</returns>
+int TaskGraph::AddTask( TASK_PROC pfnProc, void * pContext )
+{
+    if ( m_cTasks >= TASK_GRAPH_MAX_TASKS )
+    {
+        return -1;
+    }
+
+    TASK & task = m_tasks[m_cTasks];
+    task.pGraph = this;
+    task.pfnProc = pfnProc;
+    task.pContext = pContext;
+    task.cDependencies = 0;
+    task.cPending = 0;
+    task.cDependents = 0;
+
+    return static_cast<int>(m_cTasks++);
+}
+
+/// <summary>
+/// Make one task wait for another; tasks can only wait for tasks added before them
+/// </summary>
+/// <param name="before">task to run first</param>
+/// <param name="after">task to run once before has finished</param>
+/// <returns>true if successful, false if the tasks are out of order or before releases too many</returns>
+bool TaskGraph::AddDependency( int before, int after )
+{
+    // Waiting only on earlier tasks keeps the graph free of cycles, and the order of adding a valid order to run in
+    if ( before < 0 || before >= after || after >= static_cast<int>(m_cTasks) )
+    {
+        return false;
+    }
+
+    TASK & first = m_tasks[before];
+    if ( first.cDependents >= TASK_MAX_DEPENDENTS )
+    {
+        return false;
+    }
+
+    first.dependents[first.cDependents++] = static_cast<BYTE>(after);
+    ++m_tasks[after].cDependencies;
+
+    return true;
+}
+
+/// <summary>
+/// Run every task on the calling thread, in the order they were added
+/// </summary>
+void TaskGraph::Run( )
+{
+    for ( UINT i = 0; i < m_cTasks; ++i )
+    {
+        m_tasks[i].pfnProc( m_tasks[i].pContext );
+    }
+
+    m_cRemaining = 0;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+TaskScheduler::TaskScheduler() :
+    m_cWorkers(0),
+    m_bStop(false),
+    m_cQueued(0),
+    m_cSleeping(0),
+    m_hWake(NULL),
+    m_hGraphDone(NULL),
+    m_cSteals(0)
+{
+    ZeroMemory( m_deques, sizeof(m_deques) );
+    ZeroMemory( m_workers, sizeof(m_workers) );
+}
+
+/// <summary>
+/// Destructor, stops the worker threads
+/// </summary>
+TaskScheduler::~TaskScheduler()
+{
+    m_bStop = true;
+
+    // One at a time, since wakes left over from queueing can leave too little room
+    // under the maximum for all of them at once, and a failed release wakes no one
+    for ( UINT i = 0; i < m_cWorkers; ++i )
+    {
+        ReleaseSemaphore( m_hWake, 1, NULL );
+    }
+
+    for ( UINT i = 0; i < m_cWorkers; ++i )
+    {
+        WaitForSingleObject( m_workers[i].hThread, INFINITE );
+        CloseHandle( m_workers[i].hThread );
+    }
+
+    if ( m_hWake )
+    {
+        CloseHandle( m_hWake );
+    }
+
+    if ( m_hGraphDone )
+    {
+        CloseHandle( m_hGraphDone );
+    }
+}
+
+/// <summary>
+/// Start the worker threads
+/// </summary>
+/// <param name="cThreads">threads to run tasks on, including the submitting one; 0 for one per processor</param>
+/// <returns>true if successful, false otherwise</returns>
+bool TaskScheduler::Start( UINT cThreads )
+{
+    if ( NULL == m_hWake )
+    {
+        m_hWake = CreateSemaphore( NULL, 0, TASK_MAX_THREADS, NULL );
+        m_hGraphDone = CreateEvent( NULL, FALSE, FALSE, NULL );
+        if ( NULL == m_hWake || NULL == m_hGraphDone )
+        {
+            return false;
+        }
+    }
+
+    if ( 0 == cThreads )
+    {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo( &systemInfo );
+        cThreads = systemInfo.dwNumberOfProcessors;
+    }
+    cThreads = max( 1, min( cThreads, TASK_MAX_THREADS ) );
+
+    while ( m_cWorkers + 1 < cThreads )
+    {
+        WORKER & worker = m_workers[m_cWorkers];
+        worker.pOwner = this;
+        worker.index = m_cWorkers + 1;
+        worker.hThread = CreateThread( NULL, 0, WorkerThread, &worker, 0, NULL );
+
+        if ( NULL == worker.hThread )
+        {
+            ZeroMemory( &worker, sizeof(worker) );
+
+            // Whatever threads did start are still used
+            return false;
+        }
+
+        ++m_cWorkers;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Start running a graph; returns once the tasks with nothing to wait for are queued
+/// </summary>
+/// <param name="graph">graph to run, left alone until Wait returns</param>
+void TaskScheduler::Submit( TaskGraph & graph )
+{
+    // Counts are set before any task is queued, the interlocked queueing publishes them
+    for ( UINT i = 0; i < graph.m_cTasks; ++i )
+    {
+        graph.m_tasks[i].cPending = graph.m_tasks[i].cDependencies;
+    }
+    graph.m_cRemaining = graph.m_cTasks;
+
+    // Queued newest last, so the submitting thread starts on the last root and thieves on the first
+    for ( UINT i = 0; i < graph.m_cTasks; ++i )
+    {
+        TaskGraph::TASK * pTask = &graph.m_tasks[i];
+        if ( 0 == pTask->cDependencies && !Push( 0, pTask ) )
+        {
+            Execute( 0, pTask );
+        }
+    }
+}
+
+/// <summary>
+/// Run tasks until every task of a graph has finished
+/// </summary>
+/// <param name="graph">graph passed to Submit</param>
+void TaskScheduler::Wait( TaskGraph & graph )
+{
+    while ( 0 != graph.m_cRemaining )
+    {
+        TaskGraph::TASK * pTask = FindTask( 0 );
+        if ( pTask )
+        {
+            Execute( 0, pTask );
+            continue;
+        }
+
+        // The rest are running elsewhere, and any task they release is queued where the thread that releases it will take it.
+        // A graph finishing sets the event, one that finished earlier only costs another look
+        WaitForSingleObject( m_hGraphDone, INFINITE );
+    }
+}
+
+/// <summary>
+/// Thread to run tasks, calls class instance thread processor
+/// </summary>
+/// <param name="pParam">worker the thread belongs to</param>
+/// <returns>always 0</returns>
+DWORD WINAPI TaskScheduler::WorkerThread( LPVOID pParam )
+{
+    WORKER * pWorker = static_cast<WORKER *>(pParam);
+    TaskScheduler * pThis = pWorker->pOwner;
+    UINT cSpins = 0;
+
+    while ( !pThis->m_bStop )
+    {
+        TaskGraph::TASK * pTask = pThis->FindTask( pWorker->index );
+        if ( pTask )
+        {
+            pThis->Execute( pWorker->index, pTask );
+            cSpins = 0;
+            continue;
+        }
+
+        if ( ++cSpins < g_SpinCount )
+        {
+            YieldProcessor( );
+            continue;
+        }
+
+        // Either this sees a task queued after it counted itself asleep, or the thread queueing it sees it asleep and wakes it
+        InterlockedIncrement( &pThis->m_cSleeping );
+        if ( 0 == pThis->m_cQueued && !pThis->m_bStop )
+        {
+            WaitForSingleObject( pThis->m_hWake, INFINITE );
+        }
+        InterlockedDecrement( &pThis->m_cSleeping );
+        cSpins = 0;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Queue a ready task on a thread's deque, waking a sleeping worker to steal it
+/// </summary>
+/// <param name="thread">thread queueing the task, 0 for the submitting thread</param>
+/// <param name="pTask">task to queue</param>
+/// <returns>true if queued, false if the deque is full</returns>
+bool TaskScheduler::Push( UINT thread, TaskGraph::TASK * pTask )
+{
+    DEQUE & deque = m_deques[thread];
+
+    while ( 0 != InterlockedExchange( &deque.lock, 1 ) )
+    {
+        YieldProcessor( );
+    }
+
+    bool bQueued = deque.bottom - deque.top < TASK_DEQUE_SIZE;
+    if ( bQueued )
+    {
+        deque.tasks[deque.bottom % TASK_DEQUE_SIZE] = pTask;
+        ++deque.bottom;
+    }
+
+    InterlockedExchange( &deque.lock, 0 );
+
+    if ( bQueued )
+    {
+        InterlockedIncrement( &m_cQueued );
+        if ( m_cSleeping > 0 )
+        {
+            ReleaseSemaphore( m_hWake, 1, NULL );
+        }
+    }
+
+    return bQueued;
+}
+
+/// <summary>
+/// Take the newest task of a thread's own deque, or failing that the oldest of another's
+/// </summary>
+/// <param name="thread">thread looking for work</param>
+/// <returns>task to run, NULL if there is none</returns>
+TaskGraph::TASK * TaskScheduler::FindTask( UINT thread )
+{
+    TaskGraph::TASK * pTask = NULL;
+    DEQUE & own = m_deques[thread];
+
+    if ( own.bottom != own.top )
+    {
+        while ( 0 != InterlockedExchange( &own.lock, 1 ) )
+        {
+            YieldProcessor( );
+        }
+
+        if ( own.bottom != own.top )
+        {
+            --own.bottom;
+            pTask = own.tasks[own.bottom % TASK_DEQUE_SIZE];
+        }
+
+        InterlockedExchange( &own.lock, 0 );
+
+        if ( pTask )
+        {
+            InterlockedDecrement( &m_cQueued );
+            return pTask;
+        }
+    }
+
+    // Thieves pass over a deque someone else holds rather than queue up on it
+    UINT cDeques = m_cWorkers + 1;
+    for ( UINT i = 1; i < cDeques && NULL == pTask; ++i )
+    {
+        DEQUE & victim = m_deques[(thread + i) % cDeques];
+        if ( victim.bottom == victim.top || 0 != InterlockedCompareExchange( &victim.lock, 1, 0 ) )
+        {
+            continue;
+        }
+
+        if ( victim.bottom != victim.top )
+        {
+            pTask = victim.tasks[victim.top % TASK_DEQUE_SIZE];
+            ++victim.top;
+        }
+
+        InterlockedExchange( &victim.lock, 0 );
+    }
+
+    if ( pTask )
+    {
+        InterlockedDecrement( &m_cQueued );
+        InterlockedIncrement( &m_cSteals );
+    }
+
+    return pTask;
+}
+
+/// <summary>
+/// Run a task and queue the tasks it releases
+/// </summary>
+/// <param name="thread">thread running the task</param>
+/// <param name="pTask">task to run</param>
+void TaskScheduler::Execute( UINT thread, TaskGraph::TASK * pTask )
+{
+    TaskGraph * pGraph = pTask->pGraph;
+
+    pTask->pfnProc( pTask->pContext );
+
+    for ( UINT i = 0; i < pTask->cDependents; ++i )
+    {
+        TaskGraph::TASK * pDependent = &pGraph->m_tasks[pTask->dependents[i]];
+        if ( 0 == InterlockedDecrement( &pDependent->cPending ) && !Push( thread, pDependent ) )
+        {
+            Execute( thread, pDependent );
+        }
+    }
+
+    // Released tasks are counted before this one stops being, so the graph can't look done early
+    if ( 0 == InterlockedDecrement( &pGraph->m_cRemaining ) )
+    {
+        SetEvent( m_hGraphDone );
+    }
+}
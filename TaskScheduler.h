@@ -0,0 +1,193 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="TaskScheduler.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Runs the stages of a frame, expressed as a small graph of tasks, on a fixed
+// set of worker threads.  Every thread has its own deque of ready tasks: it
+// takes the newest task from its own end, so a task released by the one just
+// finished runs while its data is still in cache, and when its deque is empty
+// it steals the oldest task from another thread's.  A finished task releases
+// the tasks that depend on it onto the deque of the thread that ran it.  The
+// submitting thread has a deque too, and runs tasks rather than just waiting.
+
+#pragma once
+
+#define TASK_MAX_THREADS            8
+
+// Tasks in one graph, and tasks one task can release
+#define TASK_GRAPH_MAX_TASKS        32
+#define TASK_MAX_DEPENDENTS         8
+
+// Ready tasks a thread can hold, a power of two
+#define TASK_DEQUE_SIZE             64
+
+// Runs one task
+typedef void (*TASK_PROC)( void * pContext );
+
+class TaskGraph
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    TaskGraph();
+
+    /// <summary>
+    /// Remove every task, the graph must not be running
+    /// </summary>
+    void Clear( );
+
+    /// <summary>
+    /// Add a task
+    /// </summary>
+    /// <param name="pfnProc">called to run the task</param>
+    /// <param name="pContext">passed through to pfnProc</param>
+    /// <returns>index of the task, -1 if the graph is full</returns>
+    int AddTask( TASK_PROC pfnProc, void * pContext );
+
+    /// <summary>
+    /// Make one task wait for another; tasks can only wait for tasks added before them
+    /// </summary>
+    /// <param name="before">task to run first</param>
+    /// <param name="after">task to run once before has finished</param>
+    /// <returns>true if successful, false if the tasks are out of order or before releases too many</returns>
+    bool AddDependency( int before, int after );
+
+    /// <summary>
+    /// Run every task on the calling thread, in the order they were added
+    /// </summary>
+    void Run( );
+
+    /// <summary>
+    /// Whether every task of the last submission has finished
+    /// </summary>
+    /// <returns>true if done, false otherwise</returns>
+    bool IsDone( ) const { return 0 == m_cRemaining; }
+
+private:
+    friend class TaskScheduler;
+
+    struct TASK
+    {
+        TaskGraph *     pGraph;
+        TASK_PROC       pfnProc;
+        void *          pContext;
+        UINT            cDependencies;
+        volatile LONG   cPending;       // dependencies still running
+        UINT            cDependents;
+        BYTE            dependents[TASK_MAX_DEPENDENTS];
+    };
+
+    TASK                    m_tasks[TASK_GRAPH_MAX_TASKS];
+    UINT                    m_cTasks;
+    volatile LONG           m_cRemaining;
+};
+
+class TaskScheduler
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    TaskScheduler();
+
+    /// <summary>
+    /// Destructor, stops the worker threads
+    /// </summary>
+    ~TaskScheduler();
+
+    /// <summary>
+    /// Start the worker threads
+    /// </summary>
+    /// <param name="cThreads">threads to run tasks on, including the submitting one; 0 for one per processor</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Start( UINT cThreads );
+
+    /// <summary>
+    /// Start running a graph; returns once the tasks with nothing to wait for are queued
+    /// </summary>
+    /// <param name="graph">graph to run, left alone until Wait returns</param>
+    void Submit( TaskGraph & graph );
+
+    /// <summary>
+    /// Run tasks until every task of a graph has finished
+    /// </summary>
+    /// <param name="graph">graph passed to Submit</param>
+    void Wait( TaskGraph & graph );
+
+    /// <summary>
+    /// Number of threads tasks run on, including the submitting one
+    /// </summary>
+    /// <returns>thread count</returns>
+    UINT GetThreadCount( ) const { return m_cWorkers + 1; }
+
+    /// <summary>
+    /// Number of tasks run by a thread other than the one that queued them
+    /// </summary>
+    /// <returns>steals since the scheduler started</returns>
+    LONG GetStealCount( ) const { return m_cSteals; }
+
+private:
+    // Ready tasks of one thread; the owner works at the bottom and thieves take from the top
+    struct DEQUE
+    {
+        volatile LONG       lock;
+        volatile UINT       top;
+        volatile UINT       bottom;
+        TaskGraph::TASK *   tasks[TASK_DEQUE_SIZE];
+    };
+
+    struct WORKER
+    {
+        TaskScheduler * pOwner;
+        UINT            index;
+        HANDLE          hThread;
+    };
+
+    /// <summary>
+    /// Thread to run tasks, calls class instance thread processor
+    /// </summary>
+    /// <param name="pParam">worker the thread belongs to</param>
+    /// <returns>always 0</returns>
+    static DWORD WINAPI     WorkerThread( LPVOID pParam );
+
+    /// <summary>
+    /// Queue a ready task on a thread's deque, waking a sleeping worker to steal it
+    /// </summary>
+    /// <param name="thread">thread queueing the task, 0 for the submitting thread</param>
+    /// <param name="pTask">task to queue</param>
+    /// <returns>true if queued, false if the deque is full</returns>
+    bool                    Push( UINT thread, TaskGraph::TASK * pTask );
+
+    /// <summary>
+    /// Take the newest task of a thread's own deque, or failing that the oldest of another's
+    /// </summary>
+    /// <param name="thread">thread looking for work</param>
+    /// <returns>task to run, NULL if there is none</returns>
+    TaskGraph::TASK *       FindTask( UINT thread );
+
+    /// <summary>
+    /// Run a task and queue the tasks it releases
+    /// </summary>
+    /// <param name="thread">thread running the task</param>
+    /// <param name="pTask">task to run</param>
+    void                    Execute( UINT thread, TaskGraph::TASK * pTask );
+
+    // Deque 0 belongs to the submitting thread, deque i to worker i
+    DEQUE                   m_deques[TASK_MAX_THREADS];
+    WORKER                  m_workers[TASK_MAX_THREADS - 1];
+    UINT                    m_cWorkers;
+    volatile bool           m_bStop;
+
+    // Ready tasks in all deques, and workers asleep on m_hWake until there are some
+    volatile LONG           m_cQueued;
+    volatile LONG           m_cSleeping;
+    HANDLE                  m_hWake;
+
+    // Set whenever a graph finishes, for Wait to check its graph
+    HANDLE                  m_hGraphDone;
+
+    volatile LONG           m_cSteals;
+};
@@ -0,0 +1,347 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="TemporalDepthFilter.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "TemporalDepthFilter.h"
+#include <emmintrin.h>
+
+// Sorts after every valid depth, so holes end up at the top of the median network
+static const SHORT g_HoleSortKey = 0x7FFF;
+
+/// <summary>
+/// Constructor
+/// </summary>
+TemporalDepthFilter::TemporalDepthFilter() :
+    m_resolution(NUI_IMAGE_RESOLUTION_INVALID),
+    m_width(0),
+    m_height(0),
+    m_cFrames(0),
+    m_mode(TEMPORAL_FILTER_MEDIAN),
+    m_bFillHoles(true),
+    m_blendShift(TEMPORAL_FILTER_DEFAULT_SHIFT),
+    m_blendThreshold(TEMPORAL_FILTER_DEFAULT_THRESHOLD),
+    m_newest(0),
+    m_pRunning(NULL),
+    m_pHoleAge(NULL),
+    m_pOutput(NULL),
+    m_pSource(NULL),
+    m_sourcePitch(0)
+{
+    ZeroMemory( m_pHistory, sizeof(m_pHistory) );
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+TemporalDepthFilter::~TemporalDepthFilter()
+{
+    Free( );
+}
+
+/// <summary>
+/// Free all buffers
+/// </summary>
+void TemporalDepthFilter::Free( )
+{
+    for ( UINT i = 0; i < TEMPORAL_FILTER_MAX_FRAMES; ++i )
+    {
+        _aligned_free( m_pHistory[i] );
+        m_pHistory[i] = NULL;
+    }
+
+    _aligned_free( m_pRunning );
+    m_pRunning = NULL;
+
+    _aligned_free( m_pHoleAge );
+    m_pHoleAge = NULL;
+
+    _aligned_free( m_pOutput );
+    m_pOutput = NULL;
+
+    m_resolution = NUI_IMAGE_RESOLUTION_INVALID;
+    m_cFrames = 0;
+}
+
+/// <summary>
+/// Allocate the history for frames of the given resolution, keeping it if nothing changed
+/// </summary>
+/// <param name="resolution">resolution of depth frames</param>
+/// <param name="cFrames">frames of history, 2 to TEMPORAL_FILTER_MAX_FRAMES</param>
+/// <returns>true if successful, false otherwise</returns>
+bool TemporalDepthFilter::Initialize( NUI_IMAGE_RESOLUTION resolution, UINT cFrames )
+{
+    if ( resolution == m_resolution && cFrames == m_cFrames )
+    {
+        return true;
+    }
+
+    if ( cFrames < 2 || cFrames > TEMPORAL_FILTER_MAX_FRAMES )
+    {
+        return false;
+    }
+
+    DWORD width, height;
+    NuiImageResolutionToSize( resolution, width, height );
+
+    // Filtered 8 pixels at a time
+    if ( 0 == width || 0 == height || 0 != width % 8 )
+    {
+        return false;
+    }
+
+    Free( );
+
+    UINT cbFrame = width * height * sizeof(USHORT);
+    bool allocated = true;
+    for ( UINT i = 0; i < cFrames; ++i )
+    {
+        m_pHistory[i] = static_cast<USHORT *>(_aligned_malloc( cbFrame, 16 ));
+        allocated = allocated && ( NULL != m_pHistory[i] );
+    }
+
+    m_pRunning = static_cast<USHORT *>(_aligned_malloc( cbFrame, 16 ));
+    m_pHoleAge = static_cast<USHORT *>(_aligned_malloc( cbFrame, 16 ));
+    m_pOutput = static_cast<USHORT *>(_aligned_malloc( cbFrame, 16 ));
+
+    if ( !allocated || NULL == m_pRunning || NULL == m_pHoleAge || NULL == m_pOutput )
+    {
+        Free( );
+        return false;
+    }
+
+    m_resolution = resolution;
+    m_width = width;
+    m_height = height;
+    m_cFrames = cFrames;
+
+    ClearHistory( );
+
+    return true;
+}
+
+/// <summary>
+/// Choose how depth is steadied
+/// </summary>
+/// <param name="mode">one of the TEMPORAL_FILTER_ values</param>
+/// <param name="bFillHoles">true to fill pixels with no depth from the history</param>
+void TemporalDepthFilter::SetMode( int mode, bool bFillHoles )
+{
+    // The other mode's history is stale, start over
+    if ( mode != m_mode )
+    {
+        ClearHistory( );
+    }
+
+    m_mode = mode;
+    m_bFillHoles = bFillHoles;
+}
+
+/// <summary>
+/// Tune the blend mode
+/// </summary>
+/// <param name="shift">new depth weighs 1/2^shift, 0 to only fill holes</param>
+/// <param name="threshold">change (in millimeters) above which depth is taken as is</param>
+void TemporalDepthFilter::SetBlend( UINT shift, USHORT threshold )
+{
+    // Running depth is kept in quarter millimeters, the threshold has to be as well
+    m_blendShift = min( shift, 8 );
+    m_blendThreshold = min( threshold, 8191 );
+}
+
+/// <summary>
+/// Forget the history
+/// </summary>
+void TemporalDepthFilter::ClearHistory( )
+{
+    if ( NULL == m_pOutput )
+    {
+        return;
+    }
+
+    UINT cbFrame = m_width * m_height * sizeof(USHORT);
+    for ( UINT i = 0; i < m_cFrames; ++i )
+    {
+        ZeroMemory( m_pHistory[i], cbFrame );
+    }
+
+    ZeroMemory( m_pRunning, cbFrame );
+    ZeroMemory( m_pHoleAge, cbFrame );
+    m_newest = 0;
+}
+
+/// <summary>
+/// Filter a depth frame
+/// </summary>
+/// <param name="pDepth">packed depth and player index of the frame</param>
+/// <param name="pitch">length (in bytes) between the starts of two rows in pDepth</param>
+/// <param name="pRows">threads to split the frame over, NULL to filter on the caller's thread</param>
+/// <returns>filtered frame with the player index of pDepth, valid until the next call</returns>
+const USHORT * TemporalDepthFilter::Filter( const USHORT * pDepth, UINT pitch, ParallelRows * pRows )
+{
+    m_pSource = pDepth;
+    m_sourcePitch = pitch;
+
+    if ( pRows )
+    {
+        pRows->Run( FilterRows, this, m_height );
+    }
+    else
+    {
+        FilterRows( this, 0, m_height );
+    }
+
+    m_newest = (m_newest + 1) % m_cFrames;
+
+    return m_pOutput;
+}
+
+/// <summary>
+/// Filter a band of rows, called through ParallelRows
+/// </summary>
+/// <param name="pContext">filter instance</param>
+/// <param name="firstRow">first row of the band</param>
+/// <param name="endRow">row after the band</param>
+void TemporalDepthFilter::FilterRows( void * pContext, UINT firstRow, UINT endRow )
+{
+    TemporalDepthFilter * pThis = static_cast<TemporalDepthFilter *>(pContext);
+
+    if ( TEMPORAL_FILTER_BLEND == pThis->m_mode )
+    {
+        pThis->BlendRows( firstRow, endRow );
+    }
+    else
+    {
+        pThis->MedianRows( firstRow, endRow );
+    }
+}
+
+/// <summary>
+/// Median filter a band of rows
+/// </summary>
+/// <param name="firstRow">first row of the band</param>
+/// <param name="endRow">row after the band</param>
+void TemporalDepthFilter::MedianRows( UINT firstRow, UINT endRow )
+{
+    const UINT cFrames = m_cFrames;
+    const __m128i zero = _mm_setzero_si128( );
+    const __m128i holeKey = _mm_set1_epi16( g_HoleSortKey );
+    const __m128i playerMask = _mm_set1_epi16( NUI_IMAGE_PLAYER_INDEX_MASK );
+    const __m128i frameCount = _mm_set1_epi16( static_cast<SHORT>(cFrames) );
+    const __m128i one = _mm_set1_epi16( 1 );
+    const __m128i keepHoles = m_bFillHoles ? zero : _mm_set1_epi16( -1 );
+
+    __m128i rank[TEMPORAL_FILTER_MAX_FRAMES];
+    for ( UINT i = 0; i < cFrames; ++i )
+    {
+        rank[i] = _mm_set1_epi16( static_cast<SHORT>(i) );
+    }
+
+    for ( UINT y = firstRow; y < endRow; ++y )
+    {
+        const __m128i * pSource = reinterpret_cast<const __m128i *>(reinterpret_cast<const BYTE *>(m_pSource) + y * m_sourcePitch);
+        __m128i * pNewest = reinterpret_cast<__m128i *>(m_pHistory[m_newest] + y * m_width);
+        __m128i * pOut = reinterpret_cast<__m128i *>(m_pOutput + y * m_width);
+        UINT rowOffset = y * m_width;
+
+        for ( UINT x = 0; x < m_width; x += 8 )
+        {
+            __m128i current = _mm_loadu_si128( pSource++ );
+            _mm_store_si128( pNewest++, current );
+
+            // Depth of each frame, with holes sorted last and counted
+            __m128i depth[TEMPORAL_FILTER_MAX_FRAMES];
+            __m128i cHoles = zero;
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                __m128i d = _mm_srli_epi16( _mm_load_si128( reinterpret_cast<const __m128i *>(m_pHistory[i] + rowOffset + x) ), NUI_IMAGE_PLAYER_INDEX_SHIFT );
+                __m128i isHole = _mm_cmpeq_epi16( d, zero );
+                cHoles = _mm_sub_epi16( cHoles, isHole );
+                depth[i] = _mm_or_si128( d, _mm_and_si128( isHole, holeKey ) );
+            }
+
+            // Odd-even transposition sort, depth is at most 13 bits so signed compares are fine
+            for ( UINT pass = 0; pass < cFrames; ++pass )
+            {
+                for ( UINT i = pass & 1; i + 1 < cFrames; i += 2 )
+                {
+                    __m128i lo = _mm_min_epi16( depth[i], depth[i + 1] );
+                    depth[i + 1] = _mm_max_epi16( depth[i], depth[i + 1] );
+                    depth[i] = lo;
+                }
+            }
+
+            // The median of the valid depths is at (valid - 1) / 2; with none valid nothing matches and it stays a hole
+            __m128i median = _mm_srai_epi16( _mm_sub_epi16( _mm_sub_epi16( frameCount, cHoles ), one ), 1 );
+            __m128i filtered = zero;
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                filtered = _mm_or_si128( filtered, _mm_and_si128( depth[i], _mm_cmpeq_epi16( median, rank[i] ) ) );
+            }
+
+            __m128i currentHole = _mm_and_si128( keepHoles, _mm_cmpeq_epi16( _mm_srli_epi16( current, NUI_IMAGE_PLAYER_INDEX_SHIFT ), zero ) );
+            filtered = _mm_andnot_si128( currentHole, filtered );
+
+            _mm_store_si128( pOut++, _mm_or_si128( _mm_slli_epi16( filtered, NUI_IMAGE_PLAYER_INDEX_SHIFT ), _mm_and_si128( current, playerMask ) ) );
+        }
+    }
+}
+
+/// <summary>
+/// Blend a band of rows into the running depth
+/// </summary>
+/// <param name="firstRow">first row of the band</param>
+/// <param name="endRow">row after the band</param>
+void TemporalDepthFilter::BlendRows( UINT firstRow, UINT endRow )
+{
+    const __m128i zero = _mm_setzero_si128( );
+    const __m128i one = _mm_set1_epi16( 1 );
+    const __m128i two = _mm_set1_epi16( 2 );
+    const __m128i playerMask = _mm_set1_epi16( NUI_IMAGE_PLAYER_INDEX_MASK );
+    const __m128i threshold = _mm_set1_epi16( static_cast<SHORT>(m_blendThreshold << 2) );
+    const __m128i maxAge = _mm_set1_epi16( static_cast<SHORT>(m_cFrames) );
+    const __m128i staleAge = _mm_set1_epi16( static_cast<SHORT>(m_cFrames - 1) );
+    const __m128i keepHoles = m_bFillHoles ? zero : _mm_set1_epi16( -1 );
+    const __m128i shift = _mm_cvtsi32_si128( m_blendShift );
+
+    for ( UINT y = firstRow; y < endRow; ++y )
+    {
+        const __m128i * pSource = reinterpret_cast<const __m128i *>(reinterpret_cast<const BYTE *>(m_pSource) + y * m_sourcePitch);
+        __m128i * pRunning = reinterpret_cast<__m128i *>(m_pRunning + y * m_width);
+        __m128i * pHoleAge = reinterpret_cast<__m128i *>(m_pHoleAge + y * m_width);
+        __m128i * pOut = reinterpret_cast<__m128i *>(m_pOutput + y * m_width);
+
+        for ( UINT x = 0; x < m_width; x += 8 )
+        {
+            __m128i current = _mm_loadu_si128( pSource++ );
+            __m128i depth = _mm_srli_epi16( current, NUI_IMAGE_PLAYER_INDEX_SHIFT );
+            __m128i isHole = _mm_cmpeq_epi16( depth, zero );
+            __m128i depth4 = _mm_slli_epi16( depth, 2 );
+
+            __m128i running = _mm_load_si128( pRunning );
+            __m128i age = _mm_load_si128( pHoleAge );
+
+            // Take big changes as they are, that's motion rather than noise
+            __m128i diff = _mm_sub_epi16( depth4, running );
+            __m128i absDiff = _mm_max_epi16( diff, _mm_sub_epi16( zero, diff ) );
+            __m128i snap = _mm_or_si128( _mm_cmpgt_epi16( absDiff, threshold ), _mm_cmpeq_epi16( running, zero ) );
+            __m128i blended = _mm_add_epi16( running, _mm_sra_epi16( diff, shift ) );
+            blended = _mm_or_si128( _mm_and_si128( snap, depth4 ), _mm_andnot_si128( snap, blended ) );
+
+            // Holes keep the running depth until it is as old as the history
+            age = _mm_and_si128( isHole, _mm_min_epi16( _mm_add_epi16( age, one ), maxAge ) );
+            __m128i stale = _mm_cmpgt_epi16( age, staleAge );
+            running = _mm_or_si128( _mm_andnot_si128( isHole, blended ), _mm_and_si128( isHole, _mm_andnot_si128( stale, running ) ) );
+
+            _mm_store_si128( pRunning++, running );
+            _mm_store_si128( pHoleAge++, age );
+
+            __m128i filtered = _mm_srli_epi16( _mm_add_epi16( running, two ), 2 );
+            filtered = _mm_andnot_si128( _mm_and_si128( keepHoles, isHole ), filtered );
+
+            _mm_store_si128( pOut++, _mm_or_si128( _mm_slli_epi16( filtered, NUI_IMAGE_PLAYER_INDEX_SHIFT ), _mm_and_si128( current, playerMask ) ) );
+        }
+    }
+}
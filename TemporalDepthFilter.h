@@ -0,0 +1,132 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="TemporalDepthFilter.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Steadies depth frames over time.  Each pixel is either the median of the last
+// few frames or a running blend that snaps to new depth when the scene moves,
+// and holes can be filled from the frames before.  Nothing older than the
+// configured number of frames is ever kept or used.
+
+#pragma once
+
+#include "NuiApi.h"
+#include "ParallelRows.h"
+
+// Frames of history the filter can be configured with
+#define TEMPORAL_FILTER_MAX_FRAMES          7
+#define TEMPORAL_FILTER_DEFAULT_FRAMES      5
+
+// Defaults for the blend: new depth weighs 1/2^shift, and a change of more
+// than the threshold (in millimeters) is taken as motion instead of noise
+#define TEMPORAL_FILTER_DEFAULT_SHIFT       2
+#define TEMPORAL_FILTER_DEFAULT_THRESHOLD   60
+
+enum _TEMPORAL_FILTER_MODE
+{
+    TEMPORAL_FILTER_MEDIAN = 0,     // median of the valid depths in the history
+    TEMPORAL_FILTER_BLEND,          // exponential blend gated by the change threshold
+};
+
+class TemporalDepthFilter
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    TemporalDepthFilter();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~TemporalDepthFilter();
+
+    /// <summary>
+    /// Allocate the history for frames of the given resolution, keeping it if nothing changed
+    /// </summary>
+    /// <param name="resolution">resolution of depth frames</param>
+    /// <param name="cFrames">frames of history, 2 to TEMPORAL_FILTER_MAX_FRAMES</param>
+    /// <returns>true if successful, false otherwise</returns>
+    bool Initialize( NUI_IMAGE_RESOLUTION resolution, UINT cFrames );
+
+    /// <summary>
+    /// Choose how depth is steadied
+    /// </summary>
+    /// <param name="mode">one of the TEMPORAL_FILTER_ values</param>
+    /// <param name="bFillHoles">true to fill pixels with no depth from the history</param>
+    void SetMode( int mode, bool bFillHoles );
+
+    /// <summary>
+    /// Tune the blend mode
+    /// </summary>
+    /// <param name="shift">new depth weighs 1/2^shift, 0 to only fill holes</param>
+    /// <param name="threshold">change (in millimeters) above which depth is taken as is</param>
+    void SetBlend( UINT shift, USHORT threshold );
+
+    /// <summary>
+    /// Filter a depth frame
+    /// </summary>
+    /// <param name="pDepth">packed depth and player index of the frame</param>
+    /// <param name="pitch">length (in bytes) between the starts of two rows in pDepth</param>
+    /// <param name="pRows">threads to split the frame over, NULL to filter on the caller's thread</param>
+    /// <returns>filtered frame with the player index of pDepth, valid until the next call</returns>
+    const USHORT * Filter( const USHORT * pDepth, UINT pitch, ParallelRows * pRows );
+
+private:
+    /// <summary>
+    /// Filter a band of rows, called through ParallelRows
+    /// </summary>
+    /// <param name="pContext">filter instance</param>
+    /// <param name="firstRow">first row of the band</param>
+    /// <param name="endRow">row after the band</param>
+    static void             FilterRows( void * pContext, UINT firstRow, UINT endRow );
+
+    /// <summary>
+    /// Median filter a band of rows
+    /// </summary>
+    /// <param name="firstRow">first row of the band</param>
+    /// <param name="endRow">row after the band</param>
+    void                    MedianRows( UINT firstRow, UINT endRow );
+
+    /// <summary>
+    /// Blend a band of rows into the running depth
+    /// </summary>
+    /// <param name="firstRow">first row of the band</param>
+    /// <param name="endRow">row after the band</param>
+    void                    BlendRows( UINT firstRow, UINT endRow );
+
+    /// <summary>
+    /// Forget the history
+    /// </summary>
+    void                    ClearHistory( );
+
+    /// <summary>
+    /// Free all buffers
+    /// </summary>
+    void                    Free( );
+
+    NUI_IMAGE_RESOLUTION    m_resolution;
+    UINT                    m_width;
+    UINT                    m_height;
+    UINT                    m_cFrames;
+
+    int                     m_mode;
+    bool                    m_bFillHoles;
+    UINT                    m_blendShift;
+    USHORT                  m_blendThreshold;
+
+    // The last m_cFrames frames, m_newest is where the current frame goes
+    USHORT *                m_pHistory[TEMPORAL_FILTER_MAX_FRAMES];
+    UINT                    m_newest;
+
+    // Blend mode: running depth in quarter millimeters, and frames each pixel has been a hole
+    USHORT *                m_pRunning;
+    USHORT *                m_pHoleAge;
+
+    USHORT *                m_pOutput;
+
+    // The frame being filtered, for FilterRows
+    const USHORT *          m_pSource;
+    UINT                    m_sourcePitch;
+};
@@ -0,0 +1,478 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthCodecTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Lossless round trips of the depth codec, recordings, and codec throughput
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "NuiApi.h"
+#include "DepthCodec.h"
+
+// Frames of the synthetic scene the benchmark cycles through
+static const UINT g_SceneFrames = 30;
+
+// Most frames of a recording the benchmark replays
+static const UINT g_MaxRecordingFrames = 300;
+
+// Kinds of frame the round trip is checked on
+enum _CODEC_PATTERN
+{
+    CODEC_PATTERN_EDGES = 0,        // the smallest and largest depths with every player index
+    CODEC_PATTERN_CHECKERBOARD,     // 0 next to 0xFFFF both ways, the largest residuals there are
+    CODEC_PATTERN_NOISE,            // any 16 bit value
+    CODEC_PATTERN_SCENE,            // what a sensor sees
+    CODEC_PATTERN_COUNT
+};
+
+/// <summary>
+/// Render a frame of a synthetic scene: a wall, a floor coming towards the
+/// sensor, and a player (index 1) swaying in front with a shadow to one side.
+/// Like a sensor's, depths come in steps that grow with the square of the
+/// distance, flicker by a step, and have the odd hole
+/// </summary>
+/// <param name="pDepth">receives width * height packed depth pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="frame">frame number, which moves the player</param>
+/// <param name="random">state of the noise</param>
+static void RenderScene( USHORT * pDepth, UINT width, UINT height, UINT frame, UINT & random )
+{
+    float centerX = width * (0.5f + 0.2f * sinf( frame * 0.1f ));
+    float centerY = height * 0.45f;
+    float radiusX = width * 0.12f;
+    float radiusY = height * 0.4f;
+    UINT floorTop = height * 6 / 10;
+
+    for ( UINT y = 0; y < height; ++y )
+    {
+        for ( UINT x = 0; x < width; ++x )
+        {
+            UINT depth = 3500;
+            UINT player = 0;
+
+            if ( y >= floorTop )
+            {
+                depth = 3500 - 2500 * (y - floorTop) / (height - floorTop);
+            }
+
+            float dx = (x - centerX) / radiusX;
+            float dy = (y - centerY) / radiusY;
+            float distance = dx * dx + dy * dy;
+
+            if ( distance < 1.0f )
+            {
+                depth = 2500;
+                player = 1;
+            }
+            else if ( dx < 0.0f && dx > -1.15f && dy * dy < 1.0f && distance < 1.3f )
+            {
+                // The player's shadow on the wall, which the sensor sees no depth in
+                depth = 0;
+            }
+
+            UINT noise = TestRandom( random );
+            if ( 0 != depth && 0 == noise % 97 )
+            {
+                depth = 0;
+                player = 0;
+            }
+            else if ( 0 != depth )
+            {
+                UINT step = max( 1, depth * depth / 350000 );
+                depth -= depth % step;
+                if ( 0 == noise % 8 )
+                {
+                    depth += step;
+                }
+            }
+
+            pDepth[y * width + x] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | player);
+        }
+    }
+}
+
+/// <summary>
+/// Fill a frame with a pattern
+/// </summary>
+/// <param name="pattern">CODEC_PATTERN_ value</param>
+/// <param name="pDepth">receives width * height packed depth pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+static void FillPattern( int pattern, USHORT * pDepth, UINT width, UINT height )
+{
+    static const USHORT edgeDepths[] = { 0, 4095, 8191 };
+    UINT random = 7;
+
+    switch ( pattern )
+    {
+    case CODEC_PATTERN_EDGES:
+        // Each depth with each player index in the first 24 pixels, then repeated
+        for ( UINT i = 0; i < width * height; ++i )
+        {
+            USHORT depth = edgeDepths[(i / 8) % _countof(edgeDepths)];
+            pDepth[i] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | (i % 8));
+        }
+        break;
+
+    case CODEC_PATTERN_CHECKERBOARD:
+        for ( UINT y = 0; y < height; ++y )
+        {
+            for ( UINT x = 0; x < width; ++x )
+            {
+                pDepth[y * width + x] = ( (x + y) & 1 ) ? 0xFFFF : 0;
+            }
+        }
+        break;
+
+    case CODEC_PATTERN_NOISE:
+        for ( UINT i = 0; i < width * height; ++i )
+        {
+            pDepth[i] = static_cast<USHORT>(TestRandom( random ) ^ (TestRandom( random ) << 15));
+        }
+        break;
+
+    case CODEC_PATTERN_SCENE:
+        RenderScene( pDepth, width, height, 0, random );
+        break;
+    }
+}
+
+/// <summary>
+/// Every pattern comes back bit for bit, at sizes with and without pixels left
+/// over from the SIMD steps, and damaged frames are refused
+/// </summary>
+void TestDepthCodecRoundTrip( )
+{
+    static const UINT sizes[][2] = { { 640, 480 }, { 320, 240 }, { 321, 7 }, { 1, 1 } };
+
+    for ( UINT size = 0; size < _countof(sizes); ++size )
+    {
+        UINT width = sizes[size][0];
+        UINT height = sizes[size][1];
+
+        DepthCodec codec;
+        TEST_CHECK( codec.Initialize( width, height ) );
+
+        USHORT * pDepth = new USHORT[width * height];
+        USHORT * pDecoded = new USHORT[width * height];
+        ULONG cbMaxEncoded = codec.GetMaxEncodedSize( );
+        BYTE * pEncoded = new BYTE[cbMaxEncoded];
+
+        for ( int pattern = 0; pattern < CODEC_PATTERN_COUNT; ++pattern )
+        {
+            FillPattern( pattern, pDepth, width, height );
+
+            ULONG cbEncoded = codec.Encode( pDepth, pEncoded, cbMaxEncoded );
+            TEST_CHECK( cbEncoded > sizeof(DEPTH_CODEC_HEADER) && cbEncoded <= cbMaxEncoded );
+
+            FillMemory( pDecoded, width * height * sizeof(USHORT), 0xA5 );
+            TEST_CHECK( codec.Decode( pEncoded, cbEncoded, pDecoded ) );
+            TEST_CHECK( 0 == memcmp( pDepth, pDecoded, width * height * sizeof(USHORT) ) );
+
+            // Cut short, or taken for a frame of another size
+            TEST_CHECK( !codec.Decode( pEncoded, cbEncoded - sizeof(DWORD), pDecoded ) );
+            TEST_CHECK( !codec.Decode( pEncoded, sizeof(DEPTH_CODEC_HEADER) - 1, pDecoded ) );
+
+            DepthCodec other;
+            TEST_CHECK( other.Initialize( width + 1, height ) );
+            TEST_CHECK( !other.Decode( pEncoded, cbEncoded, pDecoded ) );
+        }
+
+        // The edge depths must all be there to be checked
+        FillPattern( CODEC_PATTERN_EDGES, pDepth, width, height );
+        if ( width * height >= 24 )
+        {
+            TEST_CHECK( 0 == pDepth[0] );
+            TEST_CHECK( ((4095 << NUI_IMAGE_PLAYER_INDEX_SHIFT) | 4) == pDepth[12] );
+            TEST_CHECK( 0xFFFF == pDepth[23] );
+        }
+
+        delete [] pEncoded;
+        delete [] pDecoded;
+        delete [] pDepth;
+    }
+
+    DepthCodec codec;
+    TEST_CHECK( !codec.Initialize( 0, 480 ) );
+    TEST_CHECK( !codec.Initialize( 0x10000, 1 ) );
+}
+
+/// <summary>
+/// Replace a file with the given bytes
+/// </summary>
+/// <param name="szFileName">file to create or overwrite</param>
+/// <param name="pData">bytes to write</param>
+/// <param name="cbData">number of bytes</param>
+/// <returns>true if successful, false otherwise</returns>
+static bool WriteTestFile( LPCWSTR szFileName, const void * pData, DWORD cbData )
+{
+    HANDLE hFile = CreateFileW( szFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( INVALID_HANDLE_VALUE == hFile )
+    {
+        return false;
+    }
+
+    DWORD cbWritten = 0;
+    BOOL bWritten = WriteFile( hFile, pData, cbData, &cbWritten, NULL );
+    CloseHandle( hFile );
+
+    return bWritten && cbData == cbWritten;
+}
+
+/// <summary>
+/// Frames written by DepthRecorder come back from DepthPlayer with their
+/// numbers, timestamps and streams, across a change of resolution and with
+/// infrared frames between the depth ones.  Files without the recording
+/// header, and frames larger than the codec can produce, are refused
+/// </summary>
+void TestDepthCodecRecording( )
+{
+    WCHAR szFileName[MAX_PATH];
+    TEST_CHECK( 0 != GetTempPathW( _countof(szFileName), szFileName ) );
+    TEST_CHECK( SUCCEEDED( StringCchCatW( szFileName, _countof(szFileName), L"SkeletalViewerTests.depth" ) ) );
+
+    static const UINT cFrames = 6;
+    UINT widths[cFrames];
+    UINT heights[cFrames];
+    USHORT * pFrames[cFrames];
+    UINT random = 11;
+    ULONGLONG cbRaw = 0;
+
+    DepthRecorder recorder;
+    TEST_CHECK( SUCCEEDED( recorder.Create( szFileName ) ) );
+
+    for ( UINT i = 0; i < cFrames; ++i )
+    {
+        widths[i] = ( i < 4 ) ? 320 : 640;
+        heights[i] = ( i < 4 ) ? 240 : 480;
+        pFrames[i] = new USHORT[widths[i] * heights[i]];
+        RenderScene( pFrames[i], widths[i], heights[i], i, random );
+        cbRaw += widths[i] * heights[i] * sizeof(USHORT);
+
+        if ( 1 == i % 2 )
+        {
+            // Infrared samples are 10 bits at the top of each 16, brighter up close
+            for ( UINT k = 0; k < widths[i] * heights[i]; ++k )
+            {
+                UINT depth = NuiDepthPixelToDepth( pFrames[i][k] );
+                pFrames[i][k] = static_cast<USHORT>(( 0 == depth ) ? 0 : (1023 - min( depth / 4, 1023U )) << 6);
+            }
+            TEST_CHECK( recorder.WriteInfrared( pFrames[i], widths[i], heights[i], 100 + i, 5000 + 33 * i ) );
+        }
+        else
+        {
+            TEST_CHECK( recorder.Write( pFrames[i], widths[i], heights[i], 100 + i, 5000 + 33 * i ) );
+        }
+    }
+
+    const DEPTH_RECORDING_STATISTICS & statistics = recorder.GetStatistics( );
+    TEST_CHECK( cFrames == statistics.cFrames );
+    TEST_CHECK( cbRaw == statistics.cbRaw );
+    TEST_CHECK( statistics.cbWritten < statistics.cbRaw / 2 );
+    recorder.Close( );
+
+    // Nothing is written once the file is closed
+    TEST_CHECK( !recorder.Write( pFrames[0], widths[0], heights[0], 0, 0 ) );
+
+    DepthPlayer player;
+    TEST_CHECK( SUCCEEDED( player.Open( szFileName ) ) );
+
+    for ( UINT i = 0; i < cFrames; ++i )
+    {
+        DEPTH_RECORDING_FRAME frame;
+        UINT width = 0;
+        UINT height = 0;
+        const USHORT * pDepth = player.ReadFrame( frame, width, height );
+
+        TEST_CHECK( NULL != pDepth );
+        if ( NULL == pDepth )
+        {
+            break;
+        }
+
+        TEST_CHECK( widths[i] == width && heights[i] == height );
+        TEST_CHECK( 100 + i == frame.dwFrameNumber );
+        TEST_CHECK( 5000 + 33 * i == frame.liTimeStamp );
+        TEST_CHECK( ( 1 == i % 2 ? DEPTH_RECORDING_STREAM_INFRARED : DEPTH_RECORDING_STREAM_DEPTH ) == frame.dwStream );
+        TEST_CHECK( 0 == memcmp( pDepth, pFrames[i], width * height * sizeof(USHORT) ) );
+    }
+
+    DEPTH_RECORDING_FRAME frame;
+    UINT width, height;
+    TEST_CHECK( NULL == player.ReadFrame( frame, width, height ) );
+    player.Close( );
+
+    for ( UINT i = 0; i < cFrames; ++i )
+    {
+        delete [] pFrames[i];
+    }
+
+    // A frame claiming more bytes than any 320x240 frame encodes to
+    struct
+    {
+        DEPTH_RECORDING_HEADER recording;
+        DEPTH_RECORDING_FRAME frame;
+        DEPTH_CODEC_HEADER codec;
+    } corrupt;
+    ZeroMemory( &corrupt, sizeof(corrupt) );
+    corrupt.recording.dwMagic = DEPTH_RECORDING_MAGIC;
+    corrupt.recording.dwVersion = DEPTH_RECORDING_VERSION;
+    corrupt.frame.cbEncoded = 0xFFFFFFF0;
+    corrupt.codec.dwMagic = DEPTH_CODEC_MAGIC;
+    corrupt.codec.usWidth = 320;
+    corrupt.codec.usHeight = 240;
+    TEST_CHECK( WriteTestFile( szFileName, &corrupt, sizeof(corrupt) ) );
+    TEST_CHECK( SUCCEEDED( player.Open( szFileName ) ) );
+    TEST_CHECK( NULL == player.ReadFrame( frame, width, height ) );
+    player.Close( );
+
+    // Recordings of an earlier version, or anything else, don't open
+    corrupt.recording.dwVersion = DEPTH_RECORDING_VERSION - 1;
+    TEST_CHECK( WriteTestFile( szFileName, &corrupt, sizeof(corrupt) ) );
+    TEST_CHECK( HRESULT_FROM_WIN32( ERROR_BAD_FORMAT ) == player.Open( szFileName ) );
+    TEST_CHECK( WriteTestFile( szFileName, &corrupt.frame, sizeof(corrupt.frame) + sizeof(corrupt.codec) ) );
+    TEST_CHECK( HRESULT_FROM_WIN32( ERROR_BAD_FORMAT ) == player.Open( szFileName ) );
+
+    DeleteFileW( szFileName );
+}
+
+/// <summary>
+/// Time encoding and decoding a set of frames of one size, over several passes
+/// </summary>
+/// <param name="szName">what the frames are, for the report</param>
+/// <param name="pFrames">frames, one after the other</param>
+/// <param name="cFrames">number of frames</param>
+/// <param name="width">width (in pixels) of the frames</param>
+/// <param name="height">height (in pixels) of the frames</param>
+static void TimeCodec( const char * szName, const USHORT * pFrames, UINT cFrames, UINT width, UINT height )
+{
+    static const UINT cPasses = 7;
+
+    DepthCodec codec;
+    codec.Initialize( width, height );
+
+    UINT cPixels = width * height;
+    ULONG cbMaxEncoded = codec.GetMaxEncodedSize( );
+    BYTE * pEncoded = new BYTE[cbMaxEncoded * cFrames];
+    ULONG * pcbEncoded = new ULONG[cFrames];
+    USHORT * pDecoded = new USHORT[cPixels];
+
+    double encodeTimes[cPasses];
+    double decodeTimes[cPasses];
+    ULONGLONG cbTotal = 0;
+    bool bLossless = true;
+
+    for ( UINT pass = 0; pass < cPasses; ++pass )
+    {
+        double start = TestSeconds( );
+        for ( UINT i = 0; i < cFrames; ++i )
+        {
+            pcbEncoded[i] = codec.Encode( pFrames + i * cPixels, pEncoded + i * cbMaxEncoded, cbMaxEncoded );
+        }
+        encodeTimes[pass] = (TestSeconds( ) - start) / cFrames;
+
+        start = TestSeconds( );
+        for ( UINT i = 0; i < cFrames; ++i )
+        {
+            codec.Decode( pEncoded + i * cbMaxEncoded, pcbEncoded[i], pDecoded );
+        }
+        decodeTimes[pass] = (TestSeconds( ) - start) / cFrames;
+    }
+
+    for ( UINT i = 0; i < cFrames; ++i )
+    {
+        cbTotal += pcbEncoded[i];
+        codec.Decode( pEncoded + i * cbMaxEncoded, pcbEncoded[i], pDecoded );
+        bLossless = bLossless && 0 == memcmp( pDecoded, pFrames + i * cPixels, cPixels * sizeof(USHORT) );
+    }
+
+    double encode = TestMedian( encodeTimes, cPasses );
+    double decode = TestMedian( decodeTimes, cPasses );
+    double ratio = static_cast<double>(cPixels) * sizeof(USHORT) * cFrames / cbTotal;
+
+    printf( "    %s, %u frames of %ux%u: %.2f:1 (%.1f KB a frame), encode %.0f fps (%.3f ms), decode %.0f fps (%.3f ms)%s\n",
+        szName, cFrames, width, height, ratio, cbTotal / 1024.0 / cFrames,
+        1.0 / encode, encode * 1000.0, 1.0 / decode, decode * 1000.0, bLossless ? "" : ", NOT LOSSLESS" );
+
+    delete [] pDecoded;
+    delete [] pcbEncoded;
+    delete [] pEncoded;
+}
+
+/// <summary>
+/// Compression ratio and single thread encode and decode rates on the
+/// synthetic scene at both depth resolutions, and on a recording if one is given
+/// </summary>
+void BenchDepthCodec( )
+{
+    static const UINT sizes[][2] = { { 640, 480 }, { 320, 240 } };
+
+    for ( UINT size = 0; size < _countof(sizes); ++size )
+    {
+        UINT width = sizes[size][0];
+        UINT height = sizes[size][1];
+        USHORT * pFrames = new USHORT[width * height * g_SceneFrames];
+        UINT random = 3;
+
+        for ( UINT i = 0; i < g_SceneFrames; ++i )
+        {
+            RenderScene( pFrames + i * width * height, width, height, i, random );
+        }
+
+        TimeCodec( "synthetic scene", pFrames, g_SceneFrames, width, height );
+        delete [] pFrames;
+    }
+
+    if ( NULL == g_szTestRecording )
+    {
+        printf( "    no recording to replay, give one with -recording:file\n" );
+        return;
+    }
+
+    // Frames of the recording's first resolution, from its start
+    DepthPlayer player;
+    if ( FAILED( player.Open( g_szTestRecording ) ) )
+    {
+        printf( "    could not open the recording\n" );
+        return;
+    }
+
+    USHORT * pFrames = NULL;
+    UINT cFrames = 0;
+    UINT firstWidth = 0;
+    UINT firstHeight = 0;
+    DEPTH_RECORDING_FRAME frame;
+    UINT width, height;
+    const USHORT * pDepth;
+
+    while ( cFrames < g_MaxRecordingFrames && NULL != (pDepth = player.ReadFrame( frame, width, height )) )
+    {
+        if ( NULL == pFrames )
+        {
+            firstWidth = width;
+            firstHeight = height;
+            pFrames = new USHORT[width * height * g_MaxRecordingFrames];
+        }
+        else if ( width != firstWidth || height != firstHeight )
+        {
+            break;
+        }
+
+        CopyMemory( pFrames + cFrames * width * height, pDepth, width * height * sizeof(USHORT) );
+        ++cFrames;
+    }
+
+    if ( cFrames > 0 )
+    {
+        TimeCodec( "recording", pFrames, cFrames, firstWidth, firstHeight );
+    }
+    else
+    {
+        printf( "    the recording has no frames\n" );
+    }
+
+    delete [] pFrames;
+}
@@ -0,0 +1,188 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthHistogramTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// The auto-contrast table over scenes at a few distances, when it is rebuilt,
+// and what it adds to colorizing a frame
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "DepthHistogram.h"
+#include "DepthKernel.h"
+
+/// <summary>
+/// Fill a frame with two surfaces, the left half from near to near + 500 mm
+/// and the right half from far to far + 500 mm, with a hole every 17 pixels
+/// </summary>
+/// <param name="pDepth">receives packed depth, width * height pixels</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="nearDepth">depth (in millimeters) of the left surface's near edge</param>
+/// <param name="farDepth">depth (in millimeters) of the right surface's near edge</param>
+static void MakeDepth( USHORT * pDepth, UINT width, UINT height, UINT nearDepth, UINT farDepth )
+{
+    for ( UINT y = 0; y < height; ++y )
+    {
+        for ( UINT x = 0; x < width; ++x )
+        {
+            UINT i = y * width + x;
+            UINT depth = ( x < width / 2 ) ? nearDepth + 500 * y / height : farDepth + 500 * y / height;
+            depth = ( 0 == i % 17 ) ? 0 : depth;
+            pDepth[i] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | (x < width / 4 ? 1 : 0));
+        }
+    }
+}
+
+/// <summary>
+/// The table is black with no depth, brightest at the nearest depth of the
+/// scene and never brighter farther away, and spends most of its range on
+/// the depths the scene occupies; it is rebuilt when the scene moves but not
+/// for the same scene or for a few pixels changing, and not at all for a
+/// frame without depth; the kernel counting alongside colorizing gives the
+/// same table as sampling the grid
+/// </summary>
+void TestDepthHistogram( )
+{
+    const UINT width = 320;
+    const UINT height = 240;
+    USHORT * pDepth = new USHORT[width * height];
+
+    DepthHistogram histogram;
+
+    // Nothing to build a table from yet
+    ZeroMemory( pDepth, width * height * sizeof(USHORT) );
+    TEST_CHECK( !histogram.Update( pDepth, width, height ) );
+    TEST_CHECK( !histogram.HasTable( ) );
+
+    MakeDepth( pDepth, width, height, 1500, 3000 );
+    TEST_CHECK( histogram.Update( pDepth, width, height ) );
+    TEST_CHECK( histogram.HasTable( ) );
+
+    const BYTE * pIntensity = histogram.GetIntensityTable( );
+    UINT cBrighter = 0;
+    for ( UINT depth = 2; depth < DEPTH_HISTOGRAM_DEPTHS; ++depth )
+    {
+        cBrighter += ( pIntensity[depth] > pIntensity[depth - 1] ) ? 1 : 0;
+    }
+
+    TEST_CHECK( 0 == pIntensity[0] );
+    TEST_CHECK( 0 == cBrighter );
+    TEST_CHECK( pIntensity[1500] >= 250 );
+    TEST_CHECK( pIntensity[3500] <= DEPTH_HISTOGRAM_FAR_INTENSITY + 4 );
+
+    // The fixed shading spreads these depths over about half as much
+    TEST_CHECK( pIntensity[1500] - pIntensity[3500] >= 200 );
+    TEST_CHECK( static_cast<BYTE>(~(1500 >> 4)) - static_cast<BYTE>(~(3500 >> 4)) < 130 );
+
+    // The empty meter between the surfaces gets almost none of the range
+    TEST_CHECK( pIntensity[2000] - pIntensity[3000] <= 8 );
+
+    // The same scene, then a few pixels changing, then the scene moving
+    TEST_CHECK( !histogram.Update( pDepth, width, height ) );
+    for ( UINT i = 0; i < width * height; i += 50 )
+    {
+        pDepth[i] = static_cast<USHORT>(2500 << NUI_IMAGE_PLAYER_INDEX_SHIFT);
+    }
+    TEST_CHECK( !histogram.Update( pDepth, width, height ) );
+
+    MakeDepth( pDepth, width, height, 1000, 2200 );
+    TEST_CHECK( histogram.Update( pDepth, width, height ) );
+    TEST_CHECK( pIntensity[1000] >= 250 );
+
+    ZeroMemory( pDepth, width * height * sizeof(USHORT) );
+    TEST_CHECK( !histogram.Update( pDepth, width, height ) );
+    TEST_CHECK( histogram.HasTable( ) );
+
+    // Counted by the kernel, as the auto-contrast view does
+    MakeDepth( pDepth, width, height, 1500, 3000 );
+    DepthHistogram grid, counted;
+    TEST_CHECK( grid.Update( pDepth, width, height ) );
+
+    DepthKernel kernel;
+    TEST_CHECK( kernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, NUI_IMAGE_RESOLUTION_320x240 ) );
+    DEPTH_KERNEL_TARGETS targets;
+    ZeroMemory( &targets, sizeof(targets) );
+    targets.pHistogram = counted.BeginCount( );
+    kernel.Run( DEPTH_KERNEL_HISTOGRAM, pDepth, targets );
+    TEST_CHECK( counted.EndCount( ) );
+    TEST_CHECK( 0 == memcmp( grid.GetIntensityTable( ), counted.GetIntensityTable( ), DEPTH_HISTOGRAM_DEPTHS ) );
+
+    targets.pHistogram = counted.BeginCount( );
+    kernel.Run( DEPTH_KERNEL_HISTOGRAM | DEPTH_KERNEL_STATISTICS, pDepth, targets );
+    TEST_CHECK( !counted.EndCount( ) );
+
+    delete [] pDepth;
+}
+
+/// <summary>
+/// Time colorizing a frame with the fixed shading, with auto-contrast
+/// counting the grid in the same pass, and with auto-contrast sampling the
+/// grid in a pass before it, at both depth resolutions
+/// </summary>
+void BenchDepthHistogram( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    const UINT cRuns = 200;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+
+        USHORT * pDepth = new USHORT[width * height];
+        BYTE * pRGBX = new BYTE[width * height * 4];
+        MakeDepth( pDepth, width, height, 1500, 3000 );
+
+        DepthKernel kernel;
+        DepthHistogram histogram;
+        if ( !kernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolutions[r] ) )
+        {
+            printf( "    kernel failed to select\n" );
+            delete [] pDepth;
+            delete [] pRGBX;
+            return;
+        }
+
+        DEPTH_KERNEL_TARGETS targets;
+        ZeroMemory( &targets, sizeof(targets) );
+        targets.pRGBX = pRGBX;
+
+        double fixedTimes[cRuns], fusedTimes[cRuns], sampledTimes[cRuns];
+        UINT cRebuilt = 0;
+        for ( UINT run = 0; run < cRuns; ++run )
+        {
+            // The scene drifts a millimeter a frame, so the table is rebuilt now and then
+            MakeDepth( pDepth, width, height, 1500 + run, 3000 );
+
+            targets.pIntensity = NULL;
+            double start = TestSeconds( );
+            kernel.Run( DEPTH_KERNEL_COLORIZE, pDepth, targets );
+            fixedTimes[run] = TestSeconds( ) - start;
+
+            start = TestSeconds( );
+            targets.pIntensity = histogram.GetIntensityTable( );
+            targets.pHistogram = histogram.BeginCount( );
+            kernel.Run( DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_HISTOGRAM, pDepth, targets );
+            cRebuilt += histogram.EndCount( ) ? 1 : 0;
+            fusedTimes[run] = TestSeconds( ) - start;
+
+            start = TestSeconds( );
+            histogram.Update( pDepth, width, height );
+            targets.pIntensity = histogram.GetIntensityTable( );
+            kernel.Run( DEPTH_KERNEL_COLORIZE, pDepth, targets );
+            sampledTimes[run] = TestSeconds( ) - start;
+        }
+
+        double fixedMs = TestMedian( fixedTimes, cRuns ) * 1000.0;
+        double fusedMs = TestMedian( fusedTimes, cRuns ) * 1000.0;
+        double sampledMs = TestMedian( sampledTimes, cRuns ) * 1000.0;
+
+        printf( "    %ux%u: fixed %.3f ms, auto-contrast in the same pass %.3f ms (%+.1f%%), in a pass before %.3f ms (%+.1f%%), table rebuilt %u times in %u frames\n",
+            width, height, fixedMs, fusedMs, (fusedMs / fixedMs - 1.0) * 100.0, sampledMs, (sampledMs / fixedMs - 1.0) * 100.0, cRebuilt, cRuns );
+
+        delete [] pDepth;
+        delete [] pRGBX;
+    }
+}
@@ -0,0 +1,508 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="DepthKernelTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Every combination of outputs of the fused depth pass against each output
+// worked out on its own, for streams with and without a player index, and
+// what fusing them and specializing them for each stream saves
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "DepthKernel.h"
+
+// The tints of DepthKernel, repeated so colors are worked out independently
+static const int g_TintShiftR[] = { 1, 2, 0, 2, 0, 0, 2, 0 };
+static const int g_TintShiftG[] = { 1, 2, 2, 0, 2, 0, 0, 1 };
+static const int g_TintShiftB[] = { 1, 0, 2, 2, 0, 2, 0, 2 };
+
+// Names of the outputs for the benchmark, in the order of their flags
+static const char * g_OutputNames[] = { "colorize", "statistics", "masks", "histogram", "points" };
+
+/// <summary>
+/// Fill a frame with depth from 0.8 to 4 m in rows that step through it, a
+/// hole every 11 pixels and players standing in vertical bands
+/// </summary>
+/// <param name="pDepth">receives packed depth, width * height pixels</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="random">state of the depth sequence</param>
+static void MakeDepth( USHORT * pDepth, UINT width, UINT height, UINT & random )
+{
+    for ( UINT y = 0; y < height; ++y )
+    {
+        for ( UINT x = 0; x < width; ++x )
+        {
+            UINT i = y * width + x;
+            UINT depth = ( 0 == i % 11 ) ? 0 : 800 + (y * 13 + TestRandom( random ) % 200) % 3200;
+            UINT player = ( 0 == (x / 40) % 2 ) ? 0 : (x / 80) % 7 + 1;
+            pDepth[i] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | player);
+        }
+    }
+}
+
+/// <summary>
+/// Everything a pass over one frame can produce, with the buffers it writes to
+/// </summary>
+struct TEST_KERNEL_OUTPUTS
+{
+    BYTE *                  pRGBX;
+    PlayerSegmentation      segmentation;
+    DWORD                   histogram[DEPTH_HISTOGRAM_BINS];
+    PointCloud              pointCloud;
+    DEPTH_KERNEL_TARGETS    targets;
+};
+
+/// <summary>
+/// Point the targets of a pass at the buffers of its outputs, and start the
+/// outputs that need starting
+/// </summary>
+/// <param name="outputs">buffers of the pass</param>
+/// <param name="flags">DEPTH_KERNEL_ flags of the outputs of the pass</param>
+/// <param name="pIntensity">intensity of each depth, NULL for the fixed shading</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="bPlayerIndex">whether the frame carries a player index</param>
+static void BeginOutputs( TEST_KERNEL_OUTPUTS & outputs, DWORD flags, const BYTE * pIntensity, UINT width, UINT height, bool bPlayerIndex )
+{
+    DEPTH_KERNEL_TARGETS & targets = outputs.targets;
+    ZeroMemory( &targets, sizeof(targets) );
+    ZeroMemory( outputs.histogram, sizeof(outputs.histogram) );
+
+    targets.pRGBX = outputs.pRGBX;
+    targets.pIntensity = pIntensity;
+    targets.pHistogram = outputs.histogram;
+
+    if ( flags & DEPTH_KERNEL_PLAYER_MASKS )
+    {
+        outputs.segmentation.BeginFrame( width, height, 0 );
+        targets.pSegmentation = &outputs.segmentation;
+    }
+
+    if ( flags & DEPTH_KERNEL_POINT_CLOUD )
+    {
+        outputs.pointCloud.BeginFrame( bPlayerIndex, targets.pointCloud );
+    }
+}
+
+/// <summary>
+/// Run every combination of outputs over a frame and compare each output with
+/// the same output worked out on its own: colors, statistics and points pixel
+/// by pixel, masks by the class that otherwise produces them, and the
+/// histogram by counting the grid
+/// </summary>
+/// <param name="kernel">kernel selected for the frame's stream</param>
+/// <param name="pDepth">packed depth of the frame</param>
+/// <param name="resolution">resolution of the frame</param>
+/// <param name="bPlayerIndex">whether the frame carries a player index</param>
+static void CheckCombinations( DepthKernel & kernel, const USHORT * pDepth, NUI_IMAGE_RESOLUTION resolution, bool bPlayerIndex )
+{
+    DWORD width, height;
+    NuiImageResolutionToSize( resolution, width, height );
+    const UINT cPixels = width * height;
+
+    // A table unlike the fixed shading, so a pass ignoring it shows
+    BYTE intensity[DEPTH_HISTOGRAM_DEPTHS];
+    for ( UINT depth = 0; depth < DEPTH_HISTOGRAM_DEPTHS; ++depth )
+    {
+        intensity[depth] = static_cast<BYTE>(depth * 7);
+    }
+
+    // Colors, statistics and the histogram by hand
+    DWORD * pFixedColors = new DWORD[cPixels];
+    DWORD * pTableColors = new DWORD[cPixels];
+    DWORD histogram[DEPTH_HISTOGRAM_BINS];
+    ZeroMemory( histogram, sizeof(histogram) );
+    DEPTH_STATISTICS statistics = { 0, 0xFFFF, 0, 0.0f };
+    double sum = 0.0;
+
+    for ( UINT i = 0; i < cPixels; ++i )
+    {
+        UINT depth = NuiDepthPixelToDepth( pDepth[i] );
+        UINT player = bPlayerIndex ? NuiDepthPixelToPlayerIndex( pDepth[i] ) : 0;
+        BYTE fixed = static_cast<BYTE>(~(depth >> 4));
+
+        pFixedColors[i] = (fixed >> g_TintShiftB[player]) | ((fixed >> g_TintShiftG[player]) << 8) | ((fixed >> g_TintShiftR[player]) << 16);
+        pTableColors[i] = (intensity[depth] >> g_TintShiftB[player]) | ((intensity[depth] >> g_TintShiftG[player]) << 8) | ((intensity[depth] >> g_TintShiftR[player]) << 16);
+
+        UINT x = i % width;
+        UINT y = i / width;
+        if ( DEPTH_HISTOGRAM_GRID / 2 == x % DEPTH_HISTOGRAM_GRID && DEPTH_HISTOGRAM_GRID / 2 == y % DEPTH_HISTOGRAM_GRID )
+        {
+            ++histogram[depth >> DEPTH_HISTOGRAM_BIN_SHIFT];
+        }
+
+        if ( depth )
+        {
+            ++statistics.cValid;
+            statistics.minDepth = static_cast<USHORT>(min( statistics.minDepth, depth ));
+            statistics.maxDepth = static_cast<USHORT>(max( statistics.maxDepth, depth ));
+            sum += depth;
+        }
+    }
+    statistics.meanDepth = static_cast<float>(sum / statistics.cValid);
+
+    // Masks from the class that produces them without the kernel
+    PlayerSegmentation segmentation;
+    TEST_CHECK( segmentation.BeginFrame( width, height, 0 ) );
+    for ( UINT y = 0; y < height; ++y )
+    {
+        for ( UINT x = 0; x < width; ++x )
+        {
+            segmentation.AddPixel( x, bPlayerIndex ? NuiDepthPixelToPlayerIndex( pDepth[y * width + x] ) : 0 );
+        }
+        segmentation.EndRow( y );
+    }
+    segmentation.EndFrame( );
+
+    // Points by hand along the rays of the point cloud, since its Generate is
+    // the kernel's own pass
+    PointCloud rays;
+    POINT_CLOUD_TARGET rayTarget;
+    TEST_CHECK( rays.Initialize( resolution ) && rays.BeginFrame( false, rayTarget ) );
+    float * pPointX = new float[cPixels];
+    float * pPointY = new float[cPixels];
+    float * pPointZ = new float[cPixels];
+    BYTE * pPointPlayer = new BYTE[cPixels];
+    for ( UINT i = 0; i < cPixels; ++i )
+    {
+        float z = static_cast<float>(NuiDepthPixelToDepth( pDepth[i] )) * 0.001f;
+        pPointX[i] = rayTarget.pRayX[i] * z;
+        pPointY[i] = rayTarget.pRayY[i] * z;
+        pPointZ[i] = z;
+        pPointPlayer[i] = static_cast<BYTE>(NuiDepthPixelToPlayerIndex( pDepth[i] ));
+    }
+
+    TEST_KERNEL_OUTPUTS * pOutputs = new TEST_KERNEL_OUTPUTS;
+    pOutputs->pRGBX = new BYTE[cPixels * 4];
+    TEST_CHECK( pOutputs->pointCloud.Initialize( resolution ) );
+
+    UINT cWrong[_countof(g_OutputNames)] = { 0 };
+    for ( DWORD flags = 0; flags < DEPTH_KERNEL_COMBINATIONS; ++flags )
+    {
+        for ( int bTable = 0; bTable <= 1; ++bTable )
+        {
+            BeginOutputs( *pOutputs, flags, bTable ? intensity : NULL, width, height, bPlayerIndex );
+            kernel.Run( flags, pDepth, pOutputs->targets );
+
+            if ( flags & DEPTH_KERNEL_COLORIZE )
+            {
+                cWrong[0] += ( 0 == memcmp( pOutputs->pRGBX, bTable ? pTableColors : pFixedColors, cPixels * 4 ) ) ? 0 : 1;
+            }
+
+            if ( flags & DEPTH_KERNEL_STATISTICS )
+            {
+                const DEPTH_STATISTICS & s = pOutputs->targets.statistics;
+                bool bSame = s.cValid == statistics.cValid && s.minDepth == statistics.minDepth && s.maxDepth == statistics.maxDepth &&
+                    fabs( s.meanDepth - statistics.meanDepth ) < 0.01f;
+                cWrong[1] += bSame ? 0 : 1;
+            }
+
+            if ( flags & DEPTH_KERNEL_PLAYER_MASKS )
+            {
+                pOutputs->segmentation.EndFrame( );
+                bool bSame = pOutputs->segmentation.GetPackedSize( ) == segmentation.GetPackedSize( ) &&
+                    0 == memcmp( pOutputs->segmentation.GetPackedMasks( ), segmentation.GetPackedMasks( ), segmentation.GetPackedSize( ) ) &&
+                    0 == memcmp( pOutputs->segmentation.GetLabels( ), segmentation.GetLabels( ), cPixels );
+                cWrong[2] += bSame ? 0 : 1;
+            }
+
+            if ( flags & DEPTH_KERNEL_HISTOGRAM )
+            {
+                cWrong[3] += ( 0 == memcmp( pOutputs->histogram, histogram, sizeof(histogram) ) ) ? 0 : 1;
+            }
+
+            if ( flags & DEPTH_KERNEL_POINT_CLOUD )
+            {
+                const DEPTH_KERNEL_TARGETS & t = pOutputs->targets;
+                bool bSame = t.statistics.cValid == statistics.cValid &&
+                    0 == memcmp( t.pointCloud.pX, pPointX, cPixels * sizeof(float) ) &&
+                    0 == memcmp( t.pointCloud.pY, pPointY, cPixels * sizeof(float) ) &&
+                    0 == memcmp( t.pointCloud.pZ, pPointZ, cPixels * sizeof(float) ) &&
+                    ( !bPlayerIndex || 0 == memcmp( t.pointCloud.pPlayer, pPointPlayer, cPixels ) );
+                cWrong[4] += bSame ? 0 : 1;
+            }
+        }
+    }
+
+    for ( UINT output = 0; output < _countof(cWrong); ++output )
+    {
+        if ( cWrong[output] )
+        {
+            printf( "    %ux%u: %s wrong in %u passes\n", width, height, g_OutputNames[output], cWrong[output] );
+        }
+        TEST_CHECK( 0 == cWrong[output] );
+    }
+
+    delete [] pOutputs->pRGBX;
+    delete pOutputs;
+    delete [] pFixedColors;
+    delete [] pTableColors;
+    delete [] pPointX;
+    delete [] pPointY;
+    delete [] pPointZ;
+    delete [] pPointPlayer;
+}
+
+/// <summary>
+/// Each of the 32 combinations of outputs, with the fixed shading and with an
+/// intensity table, produces exactly what each output gives on its own, at
+/// both depth resolutions
+/// </summary>
+void TestDepthKernel( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    UINT random = 5;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+        USHORT * pDepth = new USHORT[width * height];
+        MakeDepth( pDepth, width, height, random );
+
+        DepthKernel kernel;
+        TEST_CHECK( kernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolutions[r] ) );
+        CheckCombinations( kernel, pDepth, resolutions[r], true );
+
+        delete [] pDepth;
+    }
+}
+
+/// <summary>
+/// Time one fused pass against a pass for each output, for the combinations
+/// the app runs, at both depth resolutions
+/// </summary>
+void BenchDepthKernel( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    static const DWORD combinations[] =
+    {
+        DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_HISTOGRAM,
+        DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_PLAYER_MASKS,
+        DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_POINT_CLOUD | DEPTH_KERNEL_STATISTICS,
+        DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_PLAYER_MASKS | DEPTH_KERNEL_POINT_CLOUD,
+        DEPTH_KERNEL_COMBINATIONS - 1,
+    };
+    const UINT cRuns = 100;
+    UINT random = 5;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+        USHORT * pDepth = new USHORT[width * height];
+        MakeDepth( pDepth, width, height, random );
+
+        DepthKernel kernel;
+        TEST_KERNEL_OUTPUTS * pOutputs = new TEST_KERNEL_OUTPUTS;
+        pOutputs->pRGBX = new BYTE[width * height * 4];
+        if ( !kernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolutions[r] ) || !pOutputs->pointCloud.Initialize( resolutions[r] ) )
+        {
+            printf( "    kernel failed to select\n" );
+            delete [] pOutputs->pRGBX;
+            delete pOutputs;
+            delete [] pDepth;
+            return;
+        }
+
+        for ( UINT c = 0; c < _countof(combinations); ++c )
+        {
+            double fusedTimes[cRuns], separateTimes[cRuns];
+            for ( UINT run = 0; run < cRuns; ++run )
+            {
+                double start = TestSeconds( );
+                BeginOutputs( *pOutputs, combinations[c], NULL, width, height, true );
+                kernel.Run( combinations[c], pDepth, pOutputs->targets );
+                fusedTimes[run] = TestSeconds( ) - start;
+
+                start = TestSeconds( );
+                for ( DWORD flag = 1; flag < DEPTH_KERNEL_COMBINATIONS; flag <<= 1 )
+                {
+                    if ( combinations[c] & flag )
+                    {
+                        BeginOutputs( *pOutputs, flag, NULL, width, height, true );
+                        kernel.Run( flag, pDepth, pOutputs->targets );
+                    }
+                }
+                separateTimes[run] = TestSeconds( ) - start;
+            }
+
+            char szNames[80] = "";
+            for ( UINT output = 0; output < _countof(g_OutputNames); ++output )
+            {
+                if ( combinations[c] & (1 << output) )
+                {
+                    StringCchCatA( szNames, _countof(szNames), szNames[0] ? "+" : "" );
+                    StringCchCatA( szNames, _countof(szNames), g_OutputNames[output] );
+                }
+            }
+
+            double fusedMs = TestMedian( fusedTimes, cRuns ) * 1000.0;
+            double separateMs = TestMedian( separateTimes, cRuns ) * 1000.0;
+            printf( "    %ux%u, %-44s fused %.3f ms, separate %.3f ms (%.2fx)\n",
+                width, height, szNames, fusedMs, separateMs, separateMs / fusedMs );
+        }
+
+        delete [] pOutputs->pRGBX;
+        delete pOutputs;
+        delete [] pDepth;
+    }
+}
+
+/// <summary>
+/// Kernels for a stream without a player index ignore whatever is in the
+/// low bits and match the player-index kernels on frames without players;
+/// only depth streams of widths the kernels take are selected, and selecting
+/// again switches the stream
+/// </summary>
+void TestDepthKernelStreams( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    UINT random = 9;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+        const UINT cPixels = width * height;
+        USHORT * pDepth = new USHORT[cPixels];
+        MakeDepth( pDepth, width, height, random );
+
+        DepthKernel kernel;
+        TEST_CHECK( kernel.Select( NUI_IMAGE_TYPE_DEPTH, resolutions[r] ) );
+        TEST_CHECK( !kernel.HasPlayerIndex( ) );
+        CheckCombinations( kernel, pDepth, resolutions[r], false );
+
+        // As a depth-only stream gives it, and through both kernels
+        for ( UINT i = 0; i < cPixels; ++i )
+        {
+            pDepth[i] &= ~NUI_IMAGE_PLAYER_INDEX_MASK;
+        }
+
+        DepthKernel withPlayers;
+        TEST_CHECK( withPlayers.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolutions[r] ) );
+
+        BYTE * pColors = new BYTE[cPixels * 4];
+        BYTE * pPlayerColors = new BYTE[cPixels * 4];
+        TEST_KERNEL_OUTPUTS * pOutputs = new TEST_KERNEL_OUTPUTS;
+        TEST_KERNEL_OUTPUTS * pPlayerOutputs = new TEST_KERNEL_OUTPUTS;
+        pOutputs->pRGBX = pColors;
+        pPlayerOutputs->pRGBX = pPlayerColors;
+        TEST_CHECK( pOutputs->pointCloud.Initialize( resolutions[r] ) );
+        TEST_CHECK( pPlayerOutputs->pointCloud.Initialize( resolutions[r] ) );
+
+        const DWORD all = DEPTH_KERNEL_COMBINATIONS - 1;
+        BeginOutputs( *pOutputs, all, NULL, width, height, false );
+        BeginOutputs( *pPlayerOutputs, all, NULL, width, height, false );
+        kernel.Run( all, pDepth, pOutputs->targets );
+        withPlayers.Run( all, pDepth, pPlayerOutputs->targets );
+        pOutputs->segmentation.EndFrame( );
+        pPlayerOutputs->segmentation.EndFrame( );
+
+        TEST_CHECK( 0 == memcmp( pColors, pPlayerColors, cPixels * 4 ) );
+        TEST_CHECK( 0 == memcmp( &pOutputs->targets.statistics, &pPlayerOutputs->targets.statistics, sizeof(DEPTH_STATISTICS) ) );
+        TEST_CHECK( 0 == memcmp( pOutputs->histogram, pPlayerOutputs->histogram, sizeof(pOutputs->histogram) ) );
+        TEST_CHECK( pOutputs->segmentation.GetPackedSize( ) == pPlayerOutputs->segmentation.GetPackedSize( ) );
+        TEST_CHECK( 0 == memcmp( pOutputs->segmentation.GetPackedMasks( ), pPlayerOutputs->segmentation.GetPackedMasks( ), pOutputs->segmentation.GetPackedSize( ) ) );
+        TEST_CHECK( 0 == memcmp( pOutputs->targets.pointCloud.pZ, pPlayerOutputs->targets.pointCloud.pZ, cPixels * sizeof(float) ) );
+
+        // Switching the stream switches the kernels
+        TEST_CHECK( kernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolutions[r] ) );
+        TEST_CHECK( kernel.HasPlayerIndex( ) );
+        TEST_CHECK( kernel.Select( NUI_IMAGE_TYPE_DEPTH, resolutions[r] ) );
+        TEST_CHECK( !kernel.HasPlayerIndex( ) );
+
+        delete pOutputs;
+        delete pPlayerOutputs;
+        delete [] pColors;
+        delete [] pPlayerColors;
+        delete [] pDepth;
+    }
+
+    DepthKernel kernel;
+    TEST_CHECK( !kernel.Select( NUI_IMAGE_TYPE_COLOR, NUI_IMAGE_RESOLUTION_640x480 ) );
+    TEST_CHECK( !kernel.Select( NUI_IMAGE_TYPE_DEPTH, NUI_IMAGE_RESOLUTION_INVALID ) );
+    TEST_CHECK( kernel.Select( NUI_IMAGE_TYPE_DEPTH, NUI_IMAGE_RESOLUTION_80x60 ) );
+}
+
+/// <summary>
+/// Time the kernels for each stream type on the same frame without players,
+/// for the combinations the app runs, at both depth resolutions
+/// </summary>
+void BenchDepthKernelStreams( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    static const DWORD combinations[] =
+    {
+        DEPTH_KERNEL_COLORIZE,
+        DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_PLAYER_MASKS,
+        DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_POINT_CLOUD,
+        DEPTH_KERNEL_COMBINATIONS - 1,
+    };
+    const UINT cRuns = 100;
+    UINT random = 9;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+        USHORT * pDepth = new USHORT[width * height];
+        MakeDepth( pDepth, width, height, random );
+        for ( UINT i = 0; i < width * height; ++i )
+        {
+            pDepth[i] &= ~NUI_IMAGE_PLAYER_INDEX_MASK;
+        }
+
+        DepthKernel depthOnly, withPlayers;
+        TEST_KERNEL_OUTPUTS * pOutputs = new TEST_KERNEL_OUTPUTS;
+        pOutputs->pRGBX = new BYTE[width * height * 4];
+        if ( !depthOnly.Select( NUI_IMAGE_TYPE_DEPTH, resolutions[r] ) ||
+             !withPlayers.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolutions[r] ) ||
+             !pOutputs->pointCloud.Initialize( resolutions[r] ) )
+        {
+            printf( "    kernel failed to select\n" );
+            delete [] pOutputs->pRGBX;
+            delete pOutputs;
+            delete [] pDepth;
+            return;
+        }
+
+        for ( UINT c = 0; c < _countof(combinations); ++c )
+        {
+            double depthTimes[cRuns], playerTimes[cRuns];
+            for ( UINT run = 0; run < cRuns; ++run )
+            {
+                double start = TestSeconds( );
+                BeginOutputs( *pOutputs, combinations[c], NULL, width, height, true );
+                withPlayers.Run( combinations[c], pDepth, pOutputs->targets );
+                playerTimes[run] = TestSeconds( ) - start;
+
+                start = TestSeconds( );
+                BeginOutputs( *pOutputs, combinations[c], NULL, width, height, false );
+                depthOnly.Run( combinations[c], pDepth, pOutputs->targets );
+                depthTimes[run] = TestSeconds( ) - start;
+            }
+
+            char szNames[80] = "";
+            for ( UINT output = 0; output < _countof(g_OutputNames); ++output )
+            {
+                if ( combinations[c] & (1 << output) )
+                {
+                    StringCchCatA( szNames, _countof(szNames), szNames[0] ? "+" : "" );
+                    StringCchCatA( szNames, _countof(szNames), g_OutputNames[output] );
+                }
+            }
+
+            double playerMs = TestMedian( playerTimes, cRuns ) * 1000.0;
+            double depthMs = TestMedian( depthTimes, cRuns ) * 1000.0;
+            printf( "    %ux%u, %-44s player index %.3f ms, depth only %.3f ms (%+.0f%%)\n",
+                width, height, szNames, playerMs, depthMs, (playerMs / depthMs - 1.0) * 100.0 );
+        }
+
+        delete [] pOutputs->pRGBX;
+        delete pOutputs;
+        delete [] pDepth;
+    }
+}
@@ -0,0 +1,288 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FloorEstimatorTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// The floor found in raycast rooms, and what finding it costs
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "FloorEstimator.h"
+
+static const float g_TestDegreesToRadians = 3.14159265f / 180.0f;
+
+static const UINT g_FloorWidth = 640;
+static const UINT g_FloorHeight = 480;
+
+// Height (in meters) of the sensor above the floor, and of the table top
+static const float g_SensorHeight = 0.8f;
+static const float g_TableHeight = 0.7f;
+
+/// <summary>
+/// Raycast a room seen by a sensor pitched down: a floor, a wall 4 m away, a
+/// table top, and a player standing to the right, with the depth noise of a
+/// sensor growing with the square of the distance
+/// </summary>
+/// <param name="pDepth">receives packed depth, g_FloorWidth * g_FloorHeight pixels</param>
+/// <param name="pitch">degrees the sensor looks down</param>
+/// <param name="bLargeTable">whether the table is large enough to cover much of the floor in view</param>
+/// <param name="random">state of the noise sequence</param>
+static void RenderRoom( USHORT * pDepth, float pitch, bool bLargeTable, UINT & random )
+{
+    float scale = NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / g_FloorWidth;
+    float c = cosf( pitch * g_TestDegreesToRadians );
+    float s = sinf( pitch * g_TestDegreesToRadians );
+
+    float tableLeft = bLargeTable ? -1.2f : -0.5f;
+    float tableRight = -tableLeft;
+    float tableNear = 1.3f;
+    float tableFar = bLargeTable ? 3.0f : 2.5f;
+
+    for ( UINT y = 0; y < g_FloorHeight; ++y )
+    {
+        for ( UINT x = 0; x < g_FloorWidth; ++x )
+        {
+            // Ray of the pixel in the room, y up and z level with the floor
+            float rayX = (static_cast<float>(x) - g_FloorWidth / 2.0f) * scale;
+            float rayY = -(static_cast<float>(y) - g_FloorHeight / 2.0f) * scale;
+            float dx = rayX;
+            float dy = rayY * c - s;
+            float dz = rayY * s + c;
+
+            float distance = 4.0f / dz;
+            USHORT player = 0;
+
+            if ( dy < 0.0f )
+            {
+                distance = min( distance, -g_SensorHeight / dy );
+
+                float t = (g_TableHeight - g_SensorHeight) / dy;
+                if ( t < distance && dx * t > tableLeft && dx * t < tableRight && dz * t > tableNear && dz * t < tableFar )
+                {
+                    distance = t;
+                }
+            }
+
+            float t = 2.0f / dz;
+            float playerY = g_SensorHeight + dy * t;
+            if ( t < distance && dx * t > 0.6f && dx * t < 1.0f && playerY > 0.0f && playerY < 1.8f )
+            {
+                distance = t;
+                player = 1;
+            }
+
+            // About 3 mm of noise at 1 m
+            distance += (TestRandom( random ) / 16383.5f - 1.0f) * 0.005f * distance * distance;
+
+            UINT depth = static_cast<UINT>(distance * 1000.0f);
+
+            // Out of the sensor's range
+            if ( depth < 800 || depth > 4000 )
+            {
+                depth = 0;
+                player = 0;
+            }
+
+            pDepth[y * g_FloorWidth + x] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | player);
+        }
+    }
+}
+
+/// <summary>
+/// Run the search started by Submit on the scheduler, as the depth stages do
+/// </summary>
+/// <param name="scheduler">scheduler to run the search tasks on</param>
+/// <param name="estimator">estimator searching</param>
+/// <param name="estimate">receives the result</param>
+/// <returns>true if a floor was found, false otherwise</returns>
+static bool RunSearch( TaskScheduler & scheduler, FloorEstimator & estimator, FLOOR_ESTIMATE & estimate )
+{
+    TaskGraph graph;
+    if ( estimator.AddSearch( graph, -1 ) < 0 )
+    {
+        return false;
+    }
+
+    scheduler.Submit( graph );
+    scheduler.Wait( graph );
+
+    return estimator.ReadEstimate( estimate );
+}
+
+/// <summary>
+/// Gravity as the accelerometer reads it on a sensor pitched down
+/// </summary>
+/// <param name="pitch">degrees the sensor looks down</param>
+/// <returns>reading in g</returns>
+static Vector4 GetGravity( float pitch )
+{
+    Vector4 gravity;
+    gravity.x = 0.0f;
+    gravity.y = -cosf( pitch * g_TestDegreesToRadians );
+    gravity.z = sinf( pitch * g_TestDegreesToRadians );
+    gravity.w = 0.0f;
+
+    return gravity;
+}
+
+/// <summary>
+/// The floor is found under small and large tables at several pitches, with and
+/// without gravity; no search starts until one is due, turning the sensor
+/// starts one straight away, and a frame with too little depth to search
+/// leaves the search due.  The same floor is found however many threads the
+/// search is split over
+/// </summary>
+void TestFloorEstimator( )
+{
+    static const float pitches[] = { 0.0f, 10.0f, 25.0f };
+
+    TaskScheduler single, split;
+    TEST_CHECK( single.Start( 1 ) );
+    TEST_CHECK( split.Start( 4 ) );
+
+    USHORT * pDepth = new USHORT[g_FloorWidth * g_FloorHeight];
+    USHORT * pEmpty = new USHORT[g_FloorWidth * g_FloorHeight];
+    ZeroMemory( pEmpty, g_FloorWidth * g_FloorHeight * sizeof(USHORT) );
+    UINT random = 5;
+
+    for ( UINT i = 0; i < _countof(pitches); ++i )
+    {
+        for ( UINT scene = 0; scene < 4; ++scene )
+        {
+            bool bLargeTable = 0 != (scene & 1);
+            bool bGravity = 0 != (scene & 2);
+            RenderRoom( pDepth, pitches[i], bLargeTable, random );
+
+            FloorEstimator estimator, splitEstimator;
+            if ( bGravity )
+            {
+                estimator.SetGravity( GetGravity( pitches[i] ) );
+                splitEstimator.SetGravity( GetGravity( pitches[i] ) );
+            }
+
+            TEST_CHECK( !estimator.Submit( pEmpty, g_FloorWidth, g_FloorHeight, true, 990 ) );
+            TEST_CHECK( estimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, 1000 ) );
+            TEST_CHECK( splitEstimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, 1000 ) );
+
+            FLOOR_ESTIMATE estimate, splitEstimate;
+            bool bFound = RunSearch( single, estimator, estimate );
+            TEST_CHECK( bFound );
+            TEST_CHECK( RunSearch( split, splitEstimator, splitEstimate ) );
+            if ( !bFound )
+            {
+                continue;
+            }
+
+            TEST_CHECK( 0 == memcmp( &estimate.plane, &splitEstimate.plane, sizeof(estimate.plane) ) );
+
+            // Up in sensor space, for a sensor pitched down, leans toward it
+            float c = cosf( pitches[i] * g_TestDegreesToRadians );
+            float s = sinf( pitches[i] * g_TestDegreesToRadians );
+            float level = estimate.plane.y * c - estimate.plane.z * s;
+            TEST_CHECK( level > cosf( 0.5f * g_TestDegreesToRadians ) );
+            TEST_CHECK( fabsf( estimate.plane.w - g_SensorHeight ) < 0.01f );
+            TEST_CHECK( estimate.cInliers >= FLOOR_MIN_INLIERS && estimate.cInliers <= estimate.cSamples );
+
+            // Nothing is due a frame later, until the sensor turns
+            TEST_CHECK( !estimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, 1033 ) );
+            if ( bGravity )
+            {
+                estimator.SetGravity( GetGravity( pitches[i] + 5.0f ) );
+                TEST_CHECK( !estimator.Submit( pEmpty, g_FloorWidth, g_FloorHeight, true, 1050 ) );
+                TEST_CHECK( estimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, 1066 ) );
+                TEST_CHECK( RunSearch( single, estimator, estimate ) );
+                TEST_CHECK( !estimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, 1100 ) );
+            }
+        }
+    }
+
+    delete [] pEmpty;
+    delete [] pDepth;
+}
+
+/// <summary>
+/// Time a search on one and on four threads, sampling a frame, and a Submit with no search due
+/// </summary>
+void BenchFloorEstimator( )
+{
+    static const UINT cSearches = 200;
+    static const UINT cIdle = 10000;
+
+    USHORT * pDepth = new USHORT[g_FloorWidth * g_FloorHeight];
+    USHORT * pEmpty = new USHORT[g_FloorWidth * g_FloorHeight];
+    ZeroMemory( pEmpty, g_FloorWidth * g_FloorHeight * sizeof(USHORT) );
+    UINT random = 5;
+    RenderRoom( pDepth, 10.0f, false, random );
+
+    static const UINT threadCounts[] = { 1, 4 };
+
+    double * pSearchTimes = new double[cSearches];
+    double * pWorkTimes = new double[cSearches];
+    double * pSampleTimes = new double[cSearches];
+
+    for ( UINT t = 0; t < _countof(threadCounts); ++t )
+    {
+        TaskScheduler scheduler;
+        if ( !scheduler.Start( threadCounts[t] ) )
+        {
+            printf( "    threads failed to start\n" );
+            break;
+        }
+
+        FloorEstimator estimator;
+        estimator.SetGravity( GetGravity( 10.0f ) );
+        UINT cFound = 0;
+
+        for ( UINT i = 0; i < cSearches; ++i )
+        {
+            double start = TestSeconds( );
+            estimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, 1000 + i * 2 * FLOOR_REFRESH_INTERVAL );
+            pSampleTimes[cFound] = TestSeconds( ) - start;
+
+            FLOOR_ESTIMATE estimate;
+            start = TestSeconds( );
+            if ( RunSearch( scheduler, estimator, estimate ) )
+            {
+                pSearchTimes[cFound] = TestSeconds( ) - start;
+                pWorkTimes[cFound++] = estimate.milliseconds * 0.001;
+            }
+        }
+
+        // A frame with no search due, as nearly every frame is
+        DWORD time = 1000 + cSearches * 2 * FLOOR_REFRESH_INTERVAL;
+        estimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, time );
+        FLOOR_ESTIMATE estimate;
+        RunSearch( scheduler, estimator, estimate );
+
+        double start = TestSeconds( );
+        for ( UINT i = 0; i < cIdle; ++i )
+        {
+            estimator.Submit( pDepth, g_FloorWidth, g_FloorHeight, true, time + 1 );
+        }
+        double idle = (TestSeconds( ) - start) / cIdle;
+
+        if ( cFound > 0 )
+        {
+            double search = TestMedian( pSearchTimes, cFound );
+            double work = TestMedian( pWorkTimes, cFound );
+            double sample = TestMedian( pSampleTimes, cFound );
+
+            printf( "    640x480, %u thread%s, %u searches: search %.3f ms (%.3f ms of work), sampling %.1f us, idle Submit %.3f us\n",
+                scheduler.GetThreadCount( ), ( 1 == scheduler.GetThreadCount( ) ) ? " " : "s", cFound,
+                search * 1000.0, work * 1000.0, sample * 1000000.0, idle * 1000000.0 );
+            printf( "    spread over the %u ms refresh at 30 fps: %.2f us a frame\n",
+                FLOOR_REFRESH_INTERVAL, (search + sample) * 1000000.0 / (FLOOR_REFRESH_INTERVAL * 30 / 1000) );
+        }
+        else
+        {
+            printf( "    no floor found\n" );
+        }
+    }
+
+    delete [] pSearchTimes;
+    delete [] pWorkTimes;
+    delete [] pSampleTimes;
+    delete [] pEmpty;
+    delete [] pDepth;
+}
@@ -0,0 +1,517 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="FrameSourceTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Frames handed to consumers waiting on fibers, synced sets, consumers that
+// fall behind or stop, and what 100 waiting consumers cost against a thread each
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "FrameSource.h"
+
+// Consumers taking part in the benchmark
+static const UINT g_BenchConsumers = 100;
+
+// What a test consumer saw
+struct TEST_CONSUMER
+{
+    HANDLE              hHold;              // waited on after the first frame, if not NULL
+    volatile LONG       cFrames;
+    volatile LONG       cWrong;             // frames whose pixels weren't the ones posted
+    DWORD               frameNumbers[16];   // of the first frames seen
+    volatile LONG       bReturned;
+};
+
+/// <summary>
+/// Fill a depth frame whose every pixel says which frame and where it is, with room past each row
+/// </summary>
+/// <param name="pDepth">receives the frame, pitch bytes a row</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="pitch">bytes from one row to the next</param>
+/// <param name="dwFrameNumber">frame number</param>
+static void MakeDepth( USHORT * pDepth, UINT width, UINT height, UINT pitch, DWORD dwFrameNumber )
+{
+    for ( UINT y = 0; y < height; ++y )
+    {
+        USHORT * pRow = reinterpret_cast<USHORT *>(reinterpret_cast<BYTE *>(pDepth) + y * pitch);
+        for ( UINT x = 0; x < pitch / sizeof(USHORT); ++x )
+        {
+            pRow[x] = static_cast<USHORT>(( x < width ) ? dwFrameNumber * 7 + y * width + x : 0xFFFF);
+        }
+    }
+}
+
+/// <summary>
+/// Record a frame a consumer was handed
+/// </summary>
+/// <param name="consumer">consumer handed the frame</param>
+/// <param name="dwFrameNumber">frame number</param>
+/// <param name="bRight">whether the frame was the one posted</param>
+static void Seen( TEST_CONSUMER & consumer, DWORD dwFrameNumber, bool bRight )
+{
+    if ( consumer.cFrames < static_cast<LONG>(_countof(consumer.frameNumbers)) )
+    {
+        consumer.frameNumbers[consumer.cFrames] = dwFrameNumber;
+    }
+
+    if ( !bRight )
+    {
+        InterlockedIncrement( &consumer.cWrong );
+    }
+
+    // Only now may the test post the next frame
+    InterlockedIncrement( &consumer.cFrames );
+}
+
+/// <summary>
+/// Whether a 16-bit frame handed out holds the pixels MakeDepth filled it with, packed
+/// </summary>
+/// <param name="pImage">frame handed out</param>
+/// <returns>true if every pixel is right, false otherwise</returns>
+static bool IsMadeFrame( const FRAME_IMAGE * pImage )
+{
+    const USHORT * pPixels = reinterpret_cast<const USHORT *>(pImage->pBits);
+    bool bRight = ( sizeof(USHORT) == pImage->bytesPerPixel );
+    for ( UINT i = 0; i < pImage->width * pImage->height && bRight; ++i )
+    {
+        bRight = ( pPixels[i] == static_cast<USHORT>(pImage->dwFrameNumber * 7 + i) );
+    }
+
+    return bRight;
+}
+
+/// <summary>
+/// Consumer of depth frames, checking every pixel
+/// </summary>
+/// <param name="source">source to wait on</param>
+/// <param name="pContext">TEST_CONSUMER to fill</param>
+static void ConsumeDepth( FrameSource & source, void * pContext )
+{
+    TEST_CONSUMER * pConsumer = static_cast<TEST_CONSUMER *>(pContext);
+
+    const FRAME_IMAGE * pImage;
+    while ( NULL != (pImage = source.NextDepth( )) )
+    {
+        Seen( *pConsumer, pImage->dwFrameNumber, IsMadeFrame( pImage ) );
+
+        if ( pConsumer->hHold && 1 == pConsumer->cFrames )
+        {
+            WaitForSingleObject( pConsumer->hHold, INFINITE );
+        }
+    }
+
+    InterlockedExchange( &pConsumer->bReturned, TRUE );
+}
+
+/// <summary>
+/// Consumer of infrared frames, checking every sample
+/// </summary>
+/// <param name="source">source to wait on</param>
+/// <param name="pContext">TEST_CONSUMER to fill</param>
+static void ConsumeInfrared( FrameSource & source, void * pContext )
+{
+    TEST_CONSUMER * pConsumer = static_cast<TEST_CONSUMER *>(pContext);
+
+    const FRAME_IMAGE * pImage;
+    while ( NULL != (pImage = source.NextInfrared( )) )
+    {
+        Seen( *pConsumer, pImage->dwFrameNumber, IsMadeFrame( pImage ) );
+    }
+
+    InterlockedExchange( &pConsumer->bReturned, TRUE );
+}
+
+/// <summary>
+/// Consumer of skeleton frames
+/// </summary>
+/// <param name="source">source to wait on</param>
+/// <param name="pContext">TEST_CONSUMER to fill</param>
+static void ConsumeSkeletons( FrameSource & source, void * pContext )
+{
+    TEST_CONSUMER * pConsumer = static_cast<TEST_CONSUMER *>(pContext);
+
+    const NUI_SKELETON_FRAME * pFrame;
+    while ( NULL != (pFrame = source.NextSkeleton( )) )
+    {
+        Seen( *pConsumer, pFrame->dwFrameNumber, pFrame->liTimeStamp.QuadPart == 1000 + pFrame->dwFrameNumber * 33 );
+    }
+
+    InterlockedExchange( &pConsumer->bReturned, TRUE );
+}
+
+/// <summary>
+/// Consumer of synced sets, checking the frames of each are close enough together
+/// </summary>
+/// <param name="source">source to wait on</param>
+/// <param name="pContext">TEST_CONSUMER to fill</param>
+static void ConsumeSets( FrameSource & source, void * pContext )
+{
+    TEST_CONSUMER * pConsumer = static_cast<TEST_CONSUMER *>(pContext);
+
+    FRAME_SET set;
+    while ( source.NextSyncedSet( set ) )
+    {
+        LONGLONG colorApart = set.pColor->timeStamp - set.pDepth->timeStamp;
+        LONGLONG skeletonApart = set.pSkeleton->liTimeStamp.QuadPart - set.pDepth->timeStamp;
+        Seen( *pConsumer, set.pDepth->dwFrameNumber,
+            colorApart >= -FRAME_SYNC_TOLERANCE && colorApart <= FRAME_SYNC_TOLERANCE &&
+            skeletonApart >= -FRAME_SYNC_TOLERANCE && skeletonApart <= FRAME_SYNC_TOLERANCE &&
+            4 == set.pColor->bytesPerPixel );
+    }
+
+    InterlockedExchange( &pConsumer->bReturned, TRUE );
+}
+
+/// <summary>
+/// Wait for consumers to be handed a number of frames
+/// </summary>
+/// <param name="pConsumers">consumers to wait for</param>
+/// <param name="cConsumers">number of consumers</param>
+/// <param name="cFrames">frames each must have been handed</param>
+/// <returns>true if they were within two seconds, false otherwise</returns>
+static bool WaitForConsumers( const TEST_CONSUMER * pConsumers, UINT cConsumers, LONG cFrames )
+{
+    for ( UINT waited = 0; waited < 2000; ++waited )
+    {
+        UINT cBehind = 0;
+        for ( UINT i = 0; i < cConsumers; ++i )
+        {
+            cBehind += ( pConsumers[i].cFrames < cFrames ) ? 1 : 0;
+        }
+
+        if ( 0 == cBehind )
+        {
+            return true;
+        }
+
+        Sleep( 1 );
+    }
+
+    return false;
+}
+
+/// <summary>
+/// Every consumer is handed every depth, infrared or skeleton frame posted, whole and
+/// packed from a padded pitch, whether it was added before or after Start;
+/// a consumer that falls behind is handed the newest frame, not a backlog;
+/// synced sets come only for depth with color and skeletons close enough to
+/// it; Next fails outside a consumer, and every consumer returns when the
+/// source goes
+/// </summary>
+void TestFrameSource( )
+{
+    const UINT width = 80;
+    const UINT height = 60;
+    const UINT pitch = width * sizeof(USHORT) + 32;
+    USHORT * pDepth = new USHORT[pitch / sizeof(USHORT) * height];
+    BYTE * pColor = new BYTE[width * height * 4];
+    ZeroMemory( pColor, width * height * 4 );
+
+    // Not on a consumer's fiber
+    {
+        FrameSource source;
+        FRAME_SET set;
+        TEST_CHECK( NULL == source.NextDepth( ) );
+        TEST_CHECK( NULL == source.NextInfrared( ) );
+        TEST_CHECK( NULL == source.NextSkeleton( ) );
+        TEST_CHECK( !source.NextSyncedSet( set ) );
+    }
+
+    // Eight depth consumers, four added before Start and four after, one of infrared and one of skeletons
+    TEST_CONSUMER depth[8], infrared, skeletons;
+    ZeroMemory( depth, sizeof(depth) );
+    ZeroMemory( &infrared, sizeof(infrared) );
+    ZeroMemory( &skeletons, sizeof(skeletons) );
+
+    FrameSource * pSource = new FrameSource( );
+    for ( UINT i = 0; i < 4; ++i )
+    {
+        TEST_CHECK( pSource->AddConsumer( ConsumeDepth, &depth[i] ) );
+    }
+    TEST_CHECK( pSource->Start( ) );
+    for ( UINT i = 4; i < 8; ++i )
+    {
+        TEST_CHECK( pSource->AddConsumer( ConsumeDepth, &depth[i] ) );
+    }
+    TEST_CHECK( pSource->AddConsumer( ConsumeInfrared, &infrared ) );
+    TEST_CHECK( pSource->AddConsumer( ConsumeSkeletons, &skeletons ) );
+
+    bool bAllHanded = true;
+    for ( DWORD number = 1; number <= 10; ++number )
+    {
+        // Two frames posted in one round would hand out only the second, so each waits for the last to be seen
+        MakeDepth( pDepth, width, height, pitch, number );
+        pSource->PostDepth( pDepth, width, height, pitch, number, 1000 + number * 33 );
+        bAllHanded = bAllHanded && WaitForConsumers( depth, _countof(depth), number );
+
+        pSource->PostInfrared( pDepth, width, height, pitch, number, 1000 + number * 33 );
+        bAllHanded = bAllHanded && WaitForConsumers( &infrared, 1, number );
+
+        NUI_SKELETON_FRAME frame;
+        ZeroMemory( &frame, sizeof(frame) );
+        frame.dwFrameNumber = number;
+        frame.liTimeStamp.QuadPart = 1000 + number * 33;
+        pSource->PostSkeleton( frame );
+        bAllHanded = bAllHanded && WaitForConsumers( &skeletons, 1, number );
+    }
+    TEST_CHECK( bAllHanded );
+
+    UINT cWrong = infrared.cWrong + skeletons.cWrong;
+    for ( UINT number = 1; number <= 10; ++number )
+    {
+        cWrong += ( infrared.frameNumbers[number - 1] == number ) ? 0 : 1;
+    }
+    for ( UINT i = 0; i < _countof(depth); ++i )
+    {
+        cWrong += depth[i].cWrong;
+        for ( UINT number = 1; number <= 10; ++number )
+        {
+            cWrong += ( depth[i].frameNumbers[number - 1] == number && skeletons.frameNumbers[number - 1] == number ) ? 0 : 1;
+        }
+    }
+    TEST_CHECK( 0 == cWrong );
+
+    delete pSource;
+    UINT cReturned = ( infrared.bReturned ? 1 : 0 ) + ( skeletons.bReturned ? 1 : 0 );
+    for ( UINT i = 0; i < _countof(depth); ++i )
+    {
+        cReturned += depth[i].bReturned ? 1 : 0;
+    }
+    TEST_CHECK( _countof(depth) + 2 == cReturned );
+
+    // The first consumer holds up the thread on frame 1 while frames 2 to 4 are posted
+    TEST_CONSUMER behind[2];
+    ZeroMemory( behind, sizeof(behind) );
+    behind[0].hHold = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+    pSource = new FrameSource( );
+    TEST_CHECK( pSource->Start( ) );
+    TEST_CHECK( pSource->AddConsumer( ConsumeDepth, &behind[0] ) );
+    TEST_CHECK( pSource->AddConsumer( ConsumeDepth, &behind[1] ) );
+
+    for ( DWORD number = 1; number <= 4; ++number )
+    {
+        MakeDepth( pDepth, width, height, pitch, number );
+        pSource->PostDepth( pDepth, width, height, pitch, number, 1000 + number * 33 );
+        if ( 1 == number )
+        {
+            TEST_CHECK( WaitForConsumers( behind, 1, 1 ) );
+        }
+    }
+    SetEvent( behind[0].hHold );
+
+    TEST_CHECK( WaitForConsumers( behind, 2, 2 ) );
+    Sleep( 10 );
+    TEST_CHECK( 2 == behind[0].cFrames && 2 == behind[1].cFrames );
+    TEST_CHECK( 1 == behind[0].frameNumbers[0] && 4 == behind[0].frameNumbers[1] );
+    TEST_CHECK( 1 == behind[1].frameNumbers[0] && 4 == behind[1].frameNumbers[1] );
+    TEST_CHECK( 0 == behind[0].cWrong + behind[1].cWrong );
+
+    delete pSource;
+    CloseHandle( behind[0].hHold );
+    TEST_CHECK( behind[0].bReturned && behind[1].bReturned );
+
+    // Synced sets: frames 1 to 6 in step, 7 and 8 with color late, 9 with skeletons early, 10 in step
+    TEST_CONSUMER sets;
+    ZeroMemory( &sets, sizeof(sets) );
+
+    pSource = new FrameSource( );
+    TEST_CHECK( pSource->Start( ) );
+    TEST_CHECK( pSource->AddConsumer( ConsumeSets, &sets ) );
+
+    LONG cInStep = 0;
+    for ( DWORD number = 1; number <= 10; ++number )
+    {
+        LONGLONG timeStamp = 1000 + number * 33;
+        LONGLONG colorTime = timeStamp + (( 7 == number || 8 == number ) ? FRAME_SYNC_TOLERANCE + 5 : 3);
+        LONGLONG skeletonTime = timeStamp - (( 9 == number ) ? FRAME_SYNC_TOLERANCE + 5 : 2);
+
+        NUI_SKELETON_FRAME frame;
+        ZeroMemory( &frame, sizeof(frame) );
+        frame.dwFrameNumber = number;
+        frame.liTimeStamp.QuadPart = skeletonTime;
+
+        pSource->PostColor( pColor, width, height, width * 4, number, colorTime );
+        pSource->PostSkeleton( frame );
+        MakeDepth( pDepth, width, height, pitch, number );
+        pSource->PostDepth( pDepth, width, height, pitch, number, timeStamp );
+
+        if ( number < 7 || 10 == number )
+        {
+            ++cInStep;
+            TEST_CHECK( WaitForConsumers( &sets, 1, cInStep ) );
+        }
+        else
+        {
+            Sleep( 10 );
+        }
+    }
+
+    delete pSource;
+    TEST_CHECK( 7 == sets.cFrames && 0 == sets.cWrong && sets.bReturned );
+    TEST_CHECK( 6 == sets.frameNumbers[5] && 10 == sets.frameNumbers[6] );
+
+    delete [] pColor;
+    delete [] pDepth;
+}
+
+// What the benchmark's consumers share
+struct BENCH_CONSUMERS
+{
+    volatile LONG       cWakes;
+    HANDLE              hRoundDone;         // set by the last consumer of a round
+    volatile LONG       bStop;
+    HANDLE              hWake[g_BenchConsumers];
+};
+
+/// <summary>
+/// Note a consumer woke for a frame, and end the round if it was the last
+/// </summary>
+/// <param name="consumers">consumers of the benchmark</param>
+static void BenchWake( BENCH_CONSUMERS & consumers )
+{
+    if ( 0 == InterlockedIncrement( &consumers.cWakes ) % g_BenchConsumers )
+    {
+        SetEvent( consumers.hRoundDone );
+    }
+}
+
+/// <summary>
+/// Benchmark consumer on a fiber
+/// </summary>
+/// <param name="source">source to wait on</param>
+/// <param name="pContext">BENCH_CONSUMERS</param>
+static void BenchFiberConsumer( FrameSource & source, void * pContext )
+{
+    while ( NULL != source.NextSkeleton( ) )
+    {
+        BenchWake( *static_cast<BENCH_CONSUMERS *>(pContext) );
+    }
+}
+
+// A benchmark consumer with a thread of its own
+struct BENCH_THREAD
+{
+    BENCH_CONSUMERS *   pConsumers;
+    UINT                index;
+};
+
+/// <summary>
+/// Benchmark consumer on a thread of its own, waiting on its own event for each frame
+/// </summary>
+/// <param name="pParam">BENCH_THREAD</param>
+/// <returns>always 0</returns>
+static DWORD WINAPI BenchThreadConsumer( LPVOID pParam )
+{
+    BENCH_THREAD * pThread = static_cast<BENCH_THREAD *>(pParam);
+    BENCH_CONSUMERS & consumers = *pThread->pConsumers;
+
+    for ( ;; )
+    {
+        WaitForSingleObject( consumers.hWake[pThread->index], INFINITE );
+        if ( consumers.bStop )
+        {
+            return 0;
+        }
+
+        BenchWake( consumers );
+    }
+}
+
+/// <summary>
+/// Time handing skeleton frames to 100 consumers waiting on fibers of one
+/// thread and to 100 consumers with a thread and event each, from posting a
+/// frame to the last consumer waking for it
+/// </summary>
+void BenchFrameSource( )
+{
+    const UINT cFrames = 2000;
+
+    NUI_SKELETON_FRAME frame;
+    ZeroMemory( &frame, sizeof(frame) );
+
+    BENCH_CONSUMERS consumers;
+    ZeroMemory( &consumers, sizeof(consumers) );
+    consumers.hRoundDone = CreateEvent( NULL, FALSE, FALSE, NULL );
+
+    // Fibers
+    FrameSource * pSource = new FrameSource( );
+    for ( UINT i = 0; i < g_BenchConsumers; ++i )
+    {
+        pSource->AddConsumer( BenchFiberConsumer, &consumers );
+    }
+    if ( !pSource->Start( ) )
+    {
+        printf( "    frame source failed to start\n" );
+        delete pSource;
+        CloseHandle( consumers.hRoundDone );
+        return;
+    }
+
+    // The first round makes the fibers, which isn't timed
+    pSource->PostSkeleton( frame );
+    WaitForSingleObject( consumers.hRoundDone, INFINITE );
+    consumers.cWakes = 0;
+
+    double start = TestSeconds( );
+    for ( UINT number = 1; number <= cFrames; ++number )
+    {
+        frame.dwFrameNumber = number;
+        pSource->PostSkeleton( frame );
+        WaitForSingleObject( consumers.hRoundDone, INFINITE );
+    }
+    double fiberSeconds = (TestSeconds( ) - start) / cFrames;
+    LONG cFiberWakes = consumers.cWakes;
+    delete pSource;
+
+    // A thread each
+    consumers.cWakes = 0;
+    BENCH_THREAD threads[g_BenchConsumers];
+    HANDLE hThreads[g_BenchConsumers];
+    UINT cThreads = 0;
+    for ( UINT i = 0; i < g_BenchConsumers; ++i )
+    {
+        consumers.hWake[i] = CreateEvent( NULL, FALSE, FALSE, NULL );
+        threads[i].pConsumers = &consumers;
+        threads[i].index = i;
+        hThreads[i] = CreateThread( NULL, 0, BenchThreadConsumer, &threads[i], 0, NULL );
+        cThreads += ( NULL != hThreads[i] ) ? 1 : 0;
+    }
+
+    NUI_SKELETON_FRAME shared;
+    start = TestSeconds( );
+    for ( UINT number = 1; number <= cFrames && g_BenchConsumers == cThreads; ++number )
+    {
+        // The same copy a post makes
+        frame.dwFrameNumber = number;
+        shared = frame;
+        for ( UINT i = 0; i < g_BenchConsumers; ++i )
+        {
+            SetEvent( consumers.hWake[i] );
+        }
+        WaitForSingleObject( consumers.hRoundDone, INFINITE );
+    }
+    double threadSeconds = (TestSeconds( ) - start) / cFrames;
+    LONG cThreadWakes = consumers.cWakes;
+
+    InterlockedExchange( &consumers.bStop, TRUE );
+    for ( UINT i = 0; i < g_BenchConsumers; ++i )
+    {
+        if ( hThreads[i] )
+        {
+            SetEvent( consumers.hWake[i] );
+            WaitForSingleObject( hThreads[i], INFINITE );
+            CloseHandle( hThreads[i] );
+        }
+        CloseHandle( consumers.hWake[i] );
+    }
+    CloseHandle( consumers.hRoundDone );
+
+    printf( "    %u consumers, %u frames: fibers %.1f us a frame (%.2f us a wake, %u KB of stacks), a thread each %.1f us a frame (%.2f us a wake, %u KB of stacks reserved)%s\n",
+        g_BenchConsumers, cFrames, fiberSeconds * 1e6, fiberSeconds * 1e6 / g_BenchConsumers, g_BenchConsumers * FRAME_CONSUMER_STACK_SIZE / 1024,
+        threadSeconds * 1e6, threadSeconds * 1e6 / g_BenchConsumers, g_BenchConsumers * 1024,
+        ( static_cast<LONG>(cFrames * g_BenchConsumers) == cFiberWakes && cFiberWakes == cThreadWakes && shared.dwFrameNumber == cFrames ) ? "" : ", wakes missed" );
+}
@@ -0,0 +1,371 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="GestureEngineTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Gestures made by a synthetic skeleton, and movements that must not count as
+// one.  Benchmark of a full scene against growing numbers of templates.
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "GestureEngine.h"
+
+// Indices of the built-in templates, in the order AddDefaultTemplates adds them
+enum _TEST_GESTURE
+{
+    TEST_GESTURE_SWIPE_LEFT = 0,
+    TEST_GESTURE_SWIPE_RIGHT,
+    TEST_GESTURE_PUSH_RIGHT,
+    TEST_GESTURE_PUSH_LEFT,
+    TEST_GESTURE_RAISE_RIGHT,
+    TEST_GESTURE_RAISE_LEFT,
+};
+
+static const DWORD g_TestTrackingID = 7;
+static const float g_TestPi = 3.14159265f;
+
+// Shoulder center of the synthetic skeleton, and its torso length, in meters
+static const float g_ShoulderX = 0.1f;
+static const float g_ShoulderY = 0.4f;
+static const float g_ShoulderZ = 2.5f;
+static const float g_Torso = 0.5f;
+
+// Hands at the sides, in torso lengths from the shoulders
+static const float g_RightHandRest[3] = {  0.45f, -1.0f, -0.1f };
+static const float g_LeftHandRest[3] =  { -0.45f, -1.0f, -0.1f };
+
+// A skeleton moving its right hand, and what the engine made of it
+struct GESTURE_PERFORMER
+{
+    GestureEngine *     pEngine;
+    NUI_SKELETON_FRAME  frame;
+    float               hand[3];        // right hand, in torso lengths from the shoulders
+    UINT                random;
+    UINT                cEvents;
+    GESTURE_EVENT       lastEvent;
+};
+
+/// <summary>
+/// Start a skeleton standing with its hands at its sides
+/// </summary>
+/// <param name="performer">performer to start</param>
+/// <param name="pEngine">engine to show it to</param>
+static void StartPerformer( GESTURE_PERFORMER & performer, GestureEngine * pEngine )
+{
+    ZeroMemory( &performer, sizeof(performer) );
+    performer.pEngine = pEngine;
+    performer.random = 17;
+    CopyMemory( performer.hand, g_RightHandRest, sizeof(performer.hand) );
+
+    NUI_SKELETON_DATA & skeleton = performer.frame.SkeletonData[2];
+    skeleton.eTrackingState = NUI_SKELETON_TRACKED;
+    skeleton.dwTrackingID = g_TestTrackingID;
+    for ( int joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+    {
+        skeleton.eSkeletonPositionTrackingState[joint] = NUI_SKELETON_POSITION_TRACKED;
+    }
+}
+
+/// <summary>
+/// Show the engine one frame of the skeleton, its joints a few millimeters
+/// off from where they are meant to be, as a sensor's are
+/// </summary>
+/// <param name="performer">performer to show</param>
+static void ShowFrame( GESTURE_PERFORMER & performer )
+{
+    NUI_SKELETON_DATA & skeleton = performer.frame.SkeletonData[2];
+    const float * pLeftHand = g_LeftHandRest;
+
+    for ( int joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+    {
+        float offset[3] = { 0.0f, -0.5f, 0.0f };
+
+        if ( NUI_SKELETON_POSITION_SHOULDER_CENTER == joint )
+        {
+            offset[1] = 0.0f;
+        }
+        else if ( NUI_SKELETON_POSITION_HIP_CENTER == joint )
+        {
+            offset[1] = -1.0f;
+        }
+        else if ( NUI_SKELETON_POSITION_HAND_RIGHT == joint )
+        {
+            CopyMemory( offset, performer.hand, sizeof(offset) );
+        }
+        else if ( NUI_SKELETON_POSITION_HAND_LEFT == joint )
+        {
+            CopyMemory( offset, pLeftHand, sizeof(offset) );
+        }
+
+        Vector4 & position = skeleton.SkeletonPositions[joint];
+        position.x = g_ShoulderX + offset[0] * g_Torso + (TestRandom( performer.random ) % 9 - 4.0f) * 0.001f;
+        position.y = g_ShoulderY + offset[1] * g_Torso + (TestRandom( performer.random ) % 9 - 4.0f) * 0.001f;
+        position.z = g_ShoulderZ + offset[2] * g_Torso + (TestRandom( performer.random ) % 9 - 4.0f) * 0.001f;
+        position.w = 1.0f;
+    }
+
+    ++performer.frame.dwFrameNumber;
+
+    GESTURE_EVENT events[4];
+    UINT cEvents = performer.pEngine->Update( performer.frame, events, _countof(events) );
+    if ( cEvents > 0 )
+    {
+        performer.lastEvent = events[cEvents - 1];
+        performer.cEvents += cEvents;
+    }
+}
+
+/// <summary>
+/// Move the right hand from where it is to a point, easing in and out
+/// </summary>
+/// <param name="performer">performer to move</param>
+/// <param name="to">where the hand ends, in torso lengths from the shoulders</param>
+/// <param name="cFrames">frames the move takes</param>
+static void MoveHand( GESTURE_PERFORMER & performer, const float * to, UINT cFrames )
+{
+    float from[3];
+    CopyMemory( from, performer.hand, sizeof(from) );
+
+    for ( UINT frame = 1; frame <= cFrames; ++frame )
+    {
+        float t = static_cast<float>(frame) / cFrames;
+        float eased = t * t * (3.0f - 2.0f * t);
+
+        for ( int axis = 0; axis < 3; ++axis )
+        {
+            performer.hand[axis] = from[axis] + (to[axis] - from[axis]) * eased;
+        }
+
+        ShowFrame( performer );
+    }
+}
+
+/// <summary>
+/// Keep the right hand where it is
+/// </summary>
+/// <param name="performer">performer to hold</param>
+/// <param name="cFrames">frames to hold it for</param>
+static void HoldHand( GESTURE_PERFORMER & performer, UINT cFrames )
+{
+    for ( UINT frame = 0; frame < cFrames; ++frame )
+    {
+        ShowFrame( performer );
+    }
+}
+
+/// <summary>
+/// Swipes and pushes are found once each, at normal and slow speed; a swipe
+/// stopped halfway, one made far above the template, and one made backwards are
+/// not; and a gesture repeated within the cooldown is not reported, then or later
+/// </summary>
+void TestGestureEngine( )
+{
+    static const float swipeStart[3] = {  0.60f, -0.15f, -0.45f };
+    static const float swipeEnd[3] =   { -0.30f, -0.15f, -0.45f };
+    static const float swipeHalf[3] =  {  0.15f, -0.15f, -0.45f };
+    static const float pushStart[3] =  {  0.30f, -0.10f, -0.20f };
+    static const float pushEnd[3] =    {  0.30f, -0.10f, -1.00f };
+    static const float highStart[3] =  {  0.60f,  0.55f, -0.45f };
+    static const float highEnd[3] =    { -0.30f,  0.55f, -0.45f };
+
+    GestureEngine * pEngine = new GestureEngine( );
+    pEngine->AddDefaultTemplates( );
+    TEST_CHECK( 6 == pEngine->GetTemplateCount( ) );
+    TEST_CHECK( 0 == wcscmp( L"Swipe left", pEngine->GetName( TEST_GESTURE_SWIPE_LEFT ) ) );
+
+    GESTURE_PERFORMER performer;
+    StartPerformer( performer, pEngine );
+    HoldHand( performer, 30 );
+    TEST_CHECK( 0 == performer.cEvents );
+
+    // A swipe at the template's speed, then half as fast again
+    static const UINT swipeFrames[] = { 16, 24 };
+    for ( UINT i = 0; i < _countof(swipeFrames); ++i )
+    {
+        MoveHand( performer, swipeStart, 12 );
+        HoldHand( performer, 3 );
+        performer.cEvents = 0;
+        MoveHand( performer, swipeEnd, swipeFrames[i] );
+        HoldHand( performer, 3 );
+
+        TEST_CHECK( 1 == performer.cEvents );
+        TEST_CHECK( TEST_GESTURE_SWIPE_LEFT == performer.lastEvent.gesture );
+        TEST_CHECK( g_TestTrackingID == performer.lastEvent.dwTrackingID );
+        TEST_CHECK( performer.lastEvent.cost < GESTURE_DEFAULT_THRESHOLD );
+        TEST_CHECK( 2 * performer.lastEvent.cFrames >= swipeFrames[i] && performer.lastEvent.cFrames <= swipeFrames[i] + 3 );
+
+        MoveHand( performer, g_RightHandRest, 15 );
+        HoldHand( performer, GESTURE_COOLDOWN_FRAMES );
+    }
+
+    // A push
+    MoveHand( performer, pushStart, 12 );
+    HoldHand( performer, 3 );
+    performer.cEvents = 0;
+    MoveHand( performer, pushEnd, 16 );
+    HoldHand( performer, 3 );
+    TEST_CHECK( 1 == performer.cEvents && TEST_GESTURE_PUSH_RIGHT == performer.lastEvent.gesture );
+    MoveHand( performer, g_RightHandRest, 15 );
+    HoldHand( performer, GESTURE_COOLDOWN_FRAMES );
+
+    // Near misses: a swipe stopped halfway, one at head height, and one from the end of the template back to its start
+    performer.cEvents = 0;
+    MoveHand( performer, swipeStart, 12 );
+    MoveHand( performer, swipeHalf, 8 );
+    HoldHand( performer, 10 );
+    MoveHand( performer, g_RightHandRest, 15 );
+
+    MoveHand( performer, highStart, 12 );
+    MoveHand( performer, highEnd, 16 );
+    HoldHand( performer, 10 );
+    MoveHand( performer, g_RightHandRest, 15 );
+
+    MoveHand( performer, swipeEnd, 12 );
+    HoldHand( performer, 3 );
+    MoveHand( performer, swipeStart, 16 );
+    HoldHand( performer, 10 );
+    MoveHand( performer, g_RightHandRest, 15 );
+    TEST_CHECK( 0 == performer.cEvents );
+
+    // Two swipes in quick succession: the second ends within the cooldown, and
+    // must not be reported when the cooldown runs out either
+    MoveHand( performer, swipeStart, 12 );
+    performer.cEvents = 0;
+    MoveHand( performer, swipeEnd, 10 );
+    TEST_CHECK( 1 == performer.cEvents );
+    MoveHand( performer, swipeStart, 2 );
+    MoveHand( performer, swipeEnd, 10 );
+    HoldHand( performer, 2 * GESTURE_COOLDOWN_FRAMES );
+    TEST_CHECK( 1 == performer.cEvents );
+
+    // Once the cooldown is over the gesture is found again
+    MoveHand( performer, swipeStart, 12 );
+    MoveHand( performer, swipeEnd, 16 );
+    TEST_CHECK( 2 == performer.cEvents && TEST_GESTURE_SWIPE_LEFT == performer.lastEvent.gesture );
+
+    delete pEngine;
+}
+
+/// <summary>
+/// Add arcs made by either hand until the engine has a number of templates
+/// </summary>
+/// <param name="engine">engine holding the built-in templates</param>
+/// <param name="cTemplates">templates it should end up with</param>
+static void AddArcTemplates( GestureEngine & engine, UINT cTemplates )
+{
+    for ( UINT i = engine.GetTemplateCount( ); i < cTemplates; ++i )
+    {
+        float side = ( i % 2 ) ? -1.0f : 1.0f;
+        float height = -0.6f + 0.05f * (i % 24);
+        float turn = 0.5f + 0.1f * (i % 7);
+        UINT cPoints = 16 + (i % 17);
+
+        Vector4 points[GESTURE_MAX_POINTS];
+        for ( UINT point = 0; point < cPoints; ++point )
+        {
+            float angle = turn * g_TestPi * point / (cPoints - 1);
+            points[point].x = side * (0.1f + 0.5f * cosf( angle ));
+            points[point].y = height + 0.4f * sinf( angle );
+            points[point].z = -0.2f - 0.02f * (i % 11);
+            points[point].w = 1.0f;
+        }
+
+        WCHAR szName[32];
+        StringCchPrintfW( szName, _countof(szName), L"Arc %u", i );
+        engine.AddTemplate( szName, ( i % 2 ) ? NUI_SKELETON_POSITION_HAND_LEFT : NUI_SKELETON_POSITION_HAND_RIGHT,
+            points, cPoints, GESTURE_DEFAULT_THRESHOLD );
+    }
+}
+
+/// <summary>
+/// Per-frame cost of Update with every skeleton tracked and moving both hands,
+/// against 8 to GESTURE_MAX_TEMPLATES templates
+/// </summary>
+void BenchGestureEngine( )
+{
+    const UINT cFrames = 600;
+    const UINT cPasses = 5;
+    NUI_SKELETON_FRAME * pFrames = new NUI_SKELETON_FRAME[cFrames];
+    UINT random = 29;
+
+    for ( UINT number = 0; number < cFrames; ++number )
+    {
+        NUI_SKELETON_FRAME & frame = pFrames[number];
+        ZeroMemory( &frame, sizeof(frame) );
+        frame.dwFrameNumber = number + 1;
+        frame.liTimeStamp.QuadPart = 1000 + number * 33;
+
+        for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+        {
+            NUI_SKELETON_DATA & skeleton = frame.SkeletonData[i];
+            skeleton.eTrackingState = NUI_SKELETON_TRACKED;
+            skeleton.dwTrackingID = i + 1;
+
+            // Each skeleton sweeps its hands at its own pace
+            float t = 2.0f * g_TestPi * number / (40.0f + 7.0f * i);
+            for ( int joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+            {
+                float offset[3] = { 0.0f, -0.5f, 0.0f };
+
+                if ( NUI_SKELETON_POSITION_SHOULDER_CENTER == joint )
+                {
+                    offset[1] = 0.0f;
+                }
+                else if ( NUI_SKELETON_POSITION_HIP_CENTER == joint )
+                {
+                    offset[1] = -1.0f;
+                }
+                else if ( NUI_SKELETON_POSITION_HAND_RIGHT == joint )
+                {
+                    offset[0] = 0.15f + 0.45f * cosf( t );
+                    offset[1] = -0.3f + 0.4f * sinf( 1.3f * t );
+                    offset[2] = -0.3f - 0.2f * sinf( 0.7f * t );
+                }
+                else if ( NUI_SKELETON_POSITION_HAND_LEFT == joint )
+                {
+                    offset[0] = -0.15f - 0.45f * sinf( 0.9f * t );
+                    offset[1] = -0.3f + 0.4f * cosf( 1.1f * t );
+                    offset[2] = -0.3f - 0.2f * cosf( 0.6f * t );
+                }
+
+                skeleton.eSkeletonPositionTrackingState[joint] = NUI_SKELETON_POSITION_TRACKED;
+                Vector4 & position = skeleton.SkeletonPositions[joint];
+                position.x = -1.2f + 0.5f * i + offset[0] * g_Torso + (TestRandom( random ) % 9 - 4.0f) * 0.001f;
+                position.y = g_ShoulderY + offset[1] * g_Torso + (TestRandom( random ) % 9 - 4.0f) * 0.001f;
+                position.z = g_ShoulderZ + offset[2] * g_Torso + (TestRandom( random ) % 9 - 4.0f) * 0.001f;
+                position.w = 1.0f;
+            }
+        }
+    }
+
+    static const UINT templateCounts[] = { 8, 16, 32, GESTURE_MAX_TEMPLATES };
+    for ( UINT count = 0; count < _countof(templateCounts); ++count )
+    {
+        GestureEngine * pEngine = new GestureEngine( );
+        pEngine->AddDefaultTemplates( );
+        AddArcTemplates( *pEngine, templateCounts[count] );
+
+        double passSeconds[cPasses];
+        UINT cEvents = 0;
+        for ( UINT pass = 0; pass < cPasses; ++pass )
+        {
+            pEngine->Reset( );
+
+            GESTURE_EVENT events[GESTURE_MAX_TEMPLATES];
+            double start = TestSeconds( );
+            for ( UINT number = 0; number < cFrames; ++number )
+            {
+                cEvents += pEngine->Update( pFrames[number], events, _countof(events) );
+            }
+            passSeconds[pass] = (TestSeconds( ) - start) / cFrames;
+        }
+
+        printf( "    %u skeletons, %2u templates: %.2f us a frame, %u gestures a pass\n",
+            NUI_SKELETON_COUNT, pEngine->GetTemplateCount( ), TestMedian( passSeconds, cPasses ) * 1e6, cEvents / cPasses );
+
+        delete pEngine;
+    }
+
+    delete [] pFrames;
+}
@@ -0,0 +1,314 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="GreenScreenTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// The green screen mask and composite against a scalar pass, and the cost of
+// building the mask and compositing a color frame
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "GreenScreen.h"
+
+static const DWORD g_DepthWidth = 320;
+static const DWORD g_DepthHeight = 240;
+static const DWORD g_ColorWidth = 640;
+static const DWORD g_ColorHeight = 480;
+
+// Frames of players moving that the benchmark cycles through
+static const UINT g_GreenScreenFrames = 30;
+
+/// <summary>
+/// Make the labels and color coordinates of a depth frame with two players
+/// walking across it.  Color coordinates are twice the depth ones, moved
+/// right as a sensor's are, and off the image at its right edge
+/// </summary>
+/// <param name="frame">frame number, which moves the players</param>
+/// <param name="pLabels">receives the player index of each depth pixel</param>
+/// <param name="pColorCoordinates">receives x, y color coordinates of each depth pixel</param>
+static void MakePlayers( UINT frame, BYTE * pLabels, LONG * pColorCoordinates )
+{
+    for ( DWORD y = 0; y < g_DepthHeight; ++y )
+    {
+        for ( DWORD x = 0; x < g_DepthWidth; ++x )
+        {
+            DWORD i = y * g_DepthWidth + x;
+            pLabels[i] = 0;
+
+            for ( int player = 0; player < 2; ++player )
+            {
+                float centerX = g_DepthWidth * (0.3f + 0.4f * player + 0.1f * sinf( frame * 0.2f + player ));
+                float dx = (x - centerX) / (g_DepthWidth * 0.1f);
+                float dy = (y - g_DepthHeight * 0.55f) / (g_DepthHeight * 0.42f);
+
+                if ( dx * dx + dy * dy < 1.0f )
+                {
+                    pLabels[i] = static_cast<BYTE>(player + 1);
+                }
+            }
+
+            pColorCoordinates[2 * i] = 2 * x + 12;
+            pColorCoordinates[2 * i + 1] = 2 * y + 6;
+        }
+    }
+}
+
+/// <summary>
+/// Work out the mask of a depth frame a pixel at a time: each player pixel
+/// covers a block of color pixels, and the box blur is a rows pass then a
+/// columns pass, each rounded down the way GreenScreen divides
+/// </summary>
+/// <param name="pColorCoordinates">x, y color coordinates of each depth pixel</param>
+/// <param name="pLabels">player index of each depth pixel</param>
+/// <param name="radius">feather radius, 0 for hard edges</param>
+/// <param name="pMask">receives the mask, g_ColorWidth * g_ColorHeight bytes</param>
+/// <param name="pScratch">scratch of the same size</param>
+static void ReferenceMask( const LONG * pColorCoordinates, const BYTE * pLabels, UINT radius, BYTE * pMask, BYTE * pScratch )
+{
+    const LONG width = g_ColorWidth;
+    const LONG height = g_ColorHeight;
+    const LONG scale = g_ColorWidth / g_DepthWidth;
+
+    ZeroMemory( pMask, width * height );
+    for ( DWORD i = 0; i < g_DepthWidth * g_DepthHeight; ++i )
+    {
+        LONG colorX = pColorCoordinates[2 * i];
+        LONG colorY = pColorCoordinates[2 * i + 1];
+        if ( 0 == pLabels[i] || colorX < 0 || colorY < 0 || colorX >= width || colorY >= height )
+        {
+            continue;
+        }
+
+        for ( LONG y = colorY; y < colorY + scale && y < height; ++y )
+        {
+            for ( LONG x = colorX; x < colorX + scale && x < width; ++x )
+            {
+                pMask[y * width + x] = 0xFF;
+            }
+        }
+    }
+
+    if ( 0 == radius )
+    {
+        return;
+    }
+
+    LONG r = static_cast<LONG>(radius);
+    UINT reciprocal = (65536 + 2 * radius) / (2 * radius + 1);
+
+    for ( LONG y = 0; y < height; ++y )
+    {
+        for ( LONG x = 0; x < width; ++x )
+        {
+            UINT sum = 0;
+            for ( LONG k = max( x - r, 0L ); k <= min( x + r, width - 1 ); ++k )
+            {
+                sum += pMask[y * width + k];
+            }
+            pScratch[y * width + x] = static_cast<BYTE>((sum * reciprocal) >> 16);
+        }
+    }
+
+    for ( LONG y = 0; y < height; ++y )
+    {
+        for ( LONG x = 0; x < width; ++x )
+        {
+            UINT sum = 0;
+            for ( LONG k = max( y - r, 0L ); k <= min( y + r, height - 1 ); ++k )
+            {
+                sum += pScratch[k * width + x];
+            }
+            pMask[y * width + x] = static_cast<BYTE>(min( (sum * reciprocal) >> 16, 255U ));
+        }
+    }
+}
+
+/// <summary>
+/// Masks with hard and feathered edges and their composites match the scalar
+/// pass exactly, frame after frame as players move, including depth pixels
+/// mapped off the image; runs of four pixels take the fully transparent, fully
+/// opaque and blended paths of the composite, and only feathered masks have
+/// alpha between the two
+/// </summary>
+void TestGreenScreen( )
+{
+    static const UINT radii[] = { 0, GREEN_SCREEN_DEFAULT_FEATHER, 6 };
+    static const UINT frames[] = { 0, 7, 16 };
+    const DWORD cPixels = g_ColorWidth * g_ColorHeight;
+
+    GreenScreen unusable;
+    TEST_CHECK( !unusable.Initialize( 0, g_ColorHeight ) );
+    TEST_CHECK( !unusable.Initialize( g_ColorWidth - 8, g_ColorHeight ) );
+
+    BYTE * pLabels = new BYTE[g_DepthWidth * g_DepthHeight];
+    LONG * pColorCoordinates = new LONG[2 * g_DepthWidth * g_DepthHeight];
+    BYTE * pMask = new BYTE[cPixels];
+    BYTE * pScratch = new BYTE[cPixels];
+    BYTE * pBackground = new BYTE[cPixels * 4];
+
+    // Alpha comes out in the unused channel: the background's is 0 and the
+    // camera's is 255, so each composited pixel carries the mask it was blended with
+    BYTE * pColor = new BYTE[cPixels * 4];
+    UINT random = 11;
+    for ( DWORD i = 0; i < cPixels * 4; ++i )
+    {
+        pColor[i] = ( 3 == i % 4 ) ? 0xFF : static_cast<BYTE>(TestRandom( random ));
+    }
+
+    for ( UINT r = 0; r < _countof(radii); ++r )
+    {
+        GreenScreen greenScreen;
+        TEST_CHECK( greenScreen.Initialize( g_ColorWidth, g_ColorHeight ) );
+        greenScreen.SetFeatherRadius( radii[r] );
+
+        // Nobody in view shows only the background
+        ZeroMemory( pLabels, g_DepthWidth * g_DepthHeight );
+        ZeroMemory( pColorCoordinates, 2 * g_DepthWidth * g_DepthHeight * sizeof(LONG) );
+        greenScreen.BuildMask( pColorCoordinates, pLabels, g_DepthWidth, g_DepthHeight );
+        CopyMemory( pBackground, greenScreen.Composite( pColor ), cPixels * 4 );
+
+        UINT cVisible = 0;
+        for ( DWORD i = 0; i < cPixels; ++i )
+        {
+            cVisible += pBackground[4 * i + 3];
+        }
+        TEST_CHECK( 0 == cVisible );
+
+        UINT cTransparent = 0, cOpaque = 0, cBlended = 0, cFeathered = 0;
+        for ( UINT f = 0; f <= _countof(frames); ++f )
+        {
+            if ( f < _countof(frames) )
+            {
+                MakePlayers( frames[f], pLabels, pColorCoordinates );
+            }
+            else
+            {
+                // Last, every depth pixel a player, so some land off the right and bottom
+                FillMemory( pLabels, g_DepthWidth * g_DepthHeight, 1 );
+            }
+
+            greenScreen.BuildMask( pColorCoordinates, pLabels, g_DepthWidth, g_DepthHeight );
+            const BYTE * pOutput = greenScreen.Composite( pColor );
+            ReferenceMask( pColorCoordinates, pLabels, radii[r], pMask, pScratch );
+
+            UINT cWrongMask = 0, cWrongColor = 0;
+            for ( DWORD i = 0; i < cPixels; ++i )
+            {
+                UINT alpha = pMask[i];
+                cWrongMask += ( pOutput[4 * i + 3] == alpha ) ? 0 : 1;
+                cFeathered += ( 0 != alpha && 0xFF != alpha ) ? 1 : 0;
+
+                for ( UINT c = 0; c < 3; ++c )
+                {
+                    UINT blend = (pColor[4 * i + c] * alpha + pBackground[4 * i + c] * (255 - alpha) + 127) / 255;
+                    cWrongColor += ( pOutput[4 * i + c] == blend ) ? 0 : 1;
+                }
+
+                if ( 3 == i % 4 )
+                {
+                    DWORD alpha4 = *reinterpret_cast<const DWORD *>(pMask + i - 3);
+                    cTransparent += ( 0 == alpha4 ) ? 1 : 0;
+                    cOpaque += ( 0xFFFFFFFF == alpha4 ) ? 1 : 0;
+                    cBlended += ( 0 != alpha4 && 0xFFFFFFFF != alpha4 ) ? 1 : 0;
+                }
+            }
+
+            if ( cWrongMask || cWrongColor )
+            {
+                printf( "    feather %u, frame %u: %u mask and %u color values wrong\n", radii[r], f, cWrongMask, cWrongColor );
+            }
+            TEST_CHECK( 0 == cWrongMask );
+            TEST_CHECK( 0 == cWrongColor );
+        }
+
+        // Hard edges still blend runs that straddle an edge, but only feathering softens it
+        TEST_CHECK( cTransparent > 0 && cOpaque > 0 && cBlended > 0 );
+        TEST_CHECK( ( 0 == radii[r] ) == ( 0 == cFeathered ) );
+    }
+
+    delete [] pColor;
+    delete [] pBackground;
+    delete [] pScratch;
+    delete [] pMask;
+    delete [] pColorCoordinates;
+    delete [] pLabels;
+}
+
+/// <summary>
+/// Time building the mask and compositing, with hard edges and feathered,
+/// on players that cover about a quarter of the frame
+/// </summary>
+void BenchGreenScreen( )
+{
+    static const UINT radii[] = { 0, GREEN_SCREEN_DEFAULT_FEATHER, 6 };
+    static const UINT cPasses = 7;
+
+    BYTE * pLabels = new BYTE[g_DepthWidth * g_DepthHeight * g_GreenScreenFrames];
+    LONG * pColorCoordinates = new LONG[2 * g_DepthWidth * g_DepthHeight * g_GreenScreenFrames];
+    for ( UINT i = 0; i < g_GreenScreenFrames; ++i )
+    {
+        MakePlayers( i, pLabels + i * g_DepthWidth * g_DepthHeight, pColorCoordinates + 2 * i * g_DepthWidth * g_DepthHeight );
+    }
+
+    BYTE * pColor = new BYTE[g_ColorWidth * g_ColorHeight * 4];
+    UINT random = 5;
+    for ( DWORD i = 0; i < g_ColorWidth * g_ColorHeight * 4; ++i )
+    {
+        pColor[i] = static_cast<BYTE>(TestRandom( random ));
+    }
+
+    for ( UINT r = 0; r < _countof(radii); ++r )
+    {
+        GreenScreen greenScreen;
+        if ( !greenScreen.Initialize( g_ColorWidth, g_ColorHeight ) )
+        {
+            printf( "    out of memory\n" );
+            break;
+        }
+        greenScreen.SetFeatherRadius( radii[r] );
+
+        double maskTimes[cPasses];
+        double compositeTimes[cPasses];
+        DWORD cShown = 0;
+
+        for ( UINT pass = 0; pass < cPasses; ++pass )
+        {
+            maskTimes[pass] = 0.0;
+            compositeTimes[pass] = 0.0;
+
+            for ( UINT i = 0; i < g_GreenScreenFrames; ++i )
+            {
+                double start = TestSeconds( );
+                greenScreen.BuildMask( pColorCoordinates + 2 * i * g_DepthWidth * g_DepthHeight, pLabels + i * g_DepthWidth * g_DepthHeight,
+                    g_DepthWidth, g_DepthHeight );
+                double built = TestSeconds( );
+                const BYTE * pOutput = greenScreen.Composite( pColor );
+                double composited = TestSeconds( );
+
+                maskTimes[pass] += built - start;
+                compositeTimes[pass] += composited - built;
+
+                // How much of the last frame shows the camera rather than the background
+                if ( cPasses - 1 == pass && g_GreenScreenFrames - 1 == i )
+                {
+                    for ( DWORD p = 0; p < g_ColorWidth * g_ColorHeight; ++p )
+                    {
+                        cShown += ( 0 == memcmp( pOutput + 4 * p, pColor + 4 * p, 3 ) ) ? 1 : 0;
+                    }
+                }
+            }
+        }
+
+        double mask = TestMedian( maskTimes, cPasses ) / g_GreenScreenFrames;
+        double composite = TestMedian( compositeTimes, cPasses ) / g_GreenScreenFrames;
+
+        printf( "    feather %u: mask %.3f ms, composite %.3f ms, %.3f ms a %ux%u frame, %.0f%% of it showing players\n",
+            radii[r], mask * 1000.0, composite * 1000.0, (mask + composite) * 1000.0, g_ColorWidth, g_ColorHeight,
+            100.0 * cShown / (g_ColorWidth * g_ColorHeight) );
+    }
+
+    delete [] pColor;
+    delete [] pColorCoordinates;
+    delete [] pLabels;
+}
@@ -0,0 +1,185 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="HandAnalyzerTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Open hands and fists drawn into a depth frame.  Benchmark of one hand at
+// several distances and resolutions.
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "HandAnalyzer.h"
+
+static const UINT g_HandFrameWidth = 640;
+static const UINT g_HandFrameHeight = 480;
+
+// Hand joint in the middle of the frame
+static const LONG g_HandX = g_HandFrameWidth / 2;
+static const LONG g_HandY = g_HandFrameHeight / 2;
+
+// Depth (in millimeters) of the wall behind the hand, out of the band of hands up to 3 m
+static const USHORT g_WallDepth = 4000;
+
+/// <summary>
+/// Draw a hand in the middle of a frame with its fingers pointing up, and its
+/// forearm down to the bottom of the frame, in front of a wall
+/// </summary>
+/// <param name="pDepth">receives packed depth, width * height pixels</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="handDepth">depth (in millimeters) of the hand</param>
+/// <param name="bOpen">whether the fingers are spread, rather than closed in a fist</param>
+/// <param name="random">state of the noise sequence</param>
+/// <returns>y (in pixels) of the wrist</returns>
+static LONG RenderHand( USHORT * pDepth, UINT width, UINT height, USHORT handDepth, bool bOpen, UINT & random )
+{
+    // Fingers spread from the palm, the thumb further out than the rest, in radians from straight up
+    static const float fingerAngles[5] = { -1.15f, -0.52f, -0.17f, 0.17f, 0.52f };
+
+    LONG handX = width / 2;
+    LONG handY = height / 2;
+    float pixelsPerMeter = 1000.0f / (NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width * handDepth);
+    float palmRadius = 0.04f * pixelsPerMeter;
+    float fistRadius = 0.05f * pixelsPerMeter;
+    float fingerLength = palmRadius + 0.07f * pixelsPerMeter;
+    float fingerHalfWidth = 0.009f * pixelsPerMeter;
+    float armHalfWidth = 0.03f * pixelsPerMeter;
+    LONG wristY = handY + static_cast<LONG>(0.08f * pixelsPerMeter);
+
+    for ( UINT y = 0; y < height; ++y )
+    {
+        for ( UINT x = 0; x < width; ++x )
+        {
+            float dx = static_cast<float>(x) - handX;
+            float dy = static_cast<float>(y) - handY;
+
+            bool bHand = fabsf( dx ) <= armHalfWidth && static_cast<LONG>(y) >= handY;
+            if ( !bOpen )
+            {
+                bHand = bHand || dx * dx + dy * dy <= fistRadius * fistRadius;
+            }
+            else
+            {
+                bHand = bHand || dx * dx + dy * dy <= palmRadius * palmRadius;
+
+                for ( int finger = 0; finger < 5 && !bHand; ++finger )
+                {
+                    // Along and across the finger, which points away from the wrist
+                    float alongX = sinf( fingerAngles[finger] );
+                    float alongY = -cosf( fingerAngles[finger] );
+                    float along = dx * alongX + dy * alongY;
+                    float across = dx * alongY - dy * alongX;
+                    bHand = along >= 0.0f && along <= fingerLength && fabsf( across ) <= fingerHalfWidth;
+                }
+            }
+
+            int depth = bHand ? handDepth : g_WallDepth;
+            depth += static_cast<int>(TestRandom( random ) % 5) - 2;
+            pDepth[y * width + x] = static_cast<USHORT>(depth << NUI_IMAGE_PLAYER_INDEX_SHIFT);
+        }
+    }
+
+    return wristY;
+}
+
+/// <summary>
+/// A spread hand is open with five fingertips and a fist is closed with none,
+/// near the sensor and further away; nothing is found where there is no hand
+/// </summary>
+void TestHandAnalyzer( )
+{
+    static const USHORT handDepths[] = { 1000, 1500 };
+
+    USHORT * pDepth = new USHORT[g_HandFrameWidth * g_HandFrameHeight];
+    HandAnalyzer * pAnalyzer = new HandAnalyzer( );
+    UINT random = 3;
+
+    for ( UINT i = 0; i < _countof(handDepths); ++i )
+    {
+        HAND_RESULT result;
+
+        LONG wristY = RenderHand( pDepth, g_HandFrameWidth, g_HandFrameHeight, handDepths[i], true, random );
+        TEST_CHECK( pAnalyzer->AnalyzeHand( pDepth, g_HandFrameWidth, g_HandFrameHeight, g_HandX, g_HandY, handDepths[i],
+            g_HandX, wristY, result ) );
+        TEST_CHECK( HAND_STATE_OPEN == result.state );
+        TEST_CHECK( 5 == result.cFingertips );
+
+        // Every fingertip is above the palm, at the depth of the hand
+        for ( UINT tip = 0; tip < result.cFingertips; ++tip )
+        {
+            TEST_CHECK( result.fingertips[tip].y < g_HandY );
+            TEST_CHECK( fabsf( result.fingertips[tip].z - handDepths[i] ) <= HAND_DEPTH_BAND );
+        }
+
+        wristY = RenderHand( pDepth, g_HandFrameWidth, g_HandFrameHeight, handDepths[i], false, random );
+        TEST_CHECK( pAnalyzer->AnalyzeHand( pDepth, g_HandFrameWidth, g_HandFrameHeight, g_HandX, g_HandY, handDepths[i],
+            g_HandX, wristY, result ) );
+        TEST_CHECK( HAND_STATE_CLOSED == result.state );
+        TEST_CHECK( 0 == result.cFingertips );
+        TEST_CHECK( result.solidity >= HAND_CLOSED_SOLIDITY );
+
+        // The wall is out of the hand's depth band
+        TEST_CHECK( !pAnalyzer->AnalyzeHand( pDepth, g_HandFrameWidth, g_HandFrameHeight, g_HandX, g_HandY, handDepths[i] + 500,
+            g_HandX, wristY, result ) );
+        TEST_CHECK( HAND_STATE_UNKNOWN == result.state );
+    }
+
+    delete pAnalyzer;
+    delete [] pDepth;
+}
+
+/// <summary>
+/// Time AnalyzeHand on the open hand and the fist, at 1 m, 1.5 m and 3 m, in
+/// 320x240 and 640x480 frames
+/// </summary>
+void BenchHandAnalyzer( )
+{
+    static const USHORT handDepths[] = { 1000, 1500, 3000 };
+    static const UINT widths[] = { 320, 640 };
+    const UINT cRepeats = 200;
+    const UINT cPasses = 5;
+
+    USHORT * pDepth = new USHORT[g_HandFrameWidth * g_HandFrameHeight];
+    HandAnalyzer * pAnalyzer = new HandAnalyzer( );
+    UINT random = 3;
+
+    for ( UINT size = 0; size < _countof(widths); ++size )
+    {
+        UINT width = widths[size];
+        UINT height = width * 3 / 4;
+
+        for ( UINT i = 0; i < _countof(handDepths); ++i )
+        {
+            double handSeconds[2];
+            UINT cFingertips[2];
+
+            for ( UINT hand = 0; hand < 2; ++hand )
+            {
+                bool bOpen = 0 == hand;
+                LONG wristY = RenderHand( pDepth, width, height, handDepths[i], bOpen, random );
+
+                HAND_RESULT result;
+                double passSeconds[cPasses];
+                for ( UINT pass = 0; pass < cPasses; ++pass )
+                {
+                    double start = TestSeconds( );
+                    for ( UINT repeat = 0; repeat < cRepeats; ++repeat )
+                    {
+                        pAnalyzer->AnalyzeHand( pDepth, width, height, width / 2, height / 2, handDepths[i], width / 2, wristY, result );
+                    }
+                    passSeconds[pass] = (TestSeconds( ) - start) / cRepeats;
+                }
+
+                handSeconds[hand] = TestMedian( passSeconds, cPasses );
+                cFingertips[hand] = result.cFingertips;
+            }
+
+            printf( "    %ux%u, hand at %.1f m: open %.2f us (%u fingertips), fist %.2f us (%u fingertips)\n",
+                width, height, handDepths[i] * 0.001f, handSeconds[0] * 1e6, cFingertips[0], handSeconds[1] * 1e6, cFingertips[1] );
+        }
+    }
+
+    delete pAnalyzer;
+    delete [] pDepth;
+}
@@ -0,0 +1,222 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ImageChannelTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Frames shared through image channels, as a reader in another process sees them
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "ImageChannel.h"
+
+// Channels of their own, so the tests can run beside a viewer that is sharing images
+#define TEST_CHANNEL_DEPTH_NAME     L"Local\\SkeletalViewerTestsDepth"
+#define TEST_CHANNEL_COLOR_NAME     L"Local\\SkeletalViewerTestsColor"
+#define TEST_CHANNEL_RING_NAME      L"Local\\SkeletalViewerTestsRing"
+
+/// <summary>
+/// Publish a frame whose rows are further apart than its pixels need, and
+/// check a reader gets its header and packed rows back
+/// </summary>
+/// <param name="szName">name of the channel</param>
+/// <param name="width">width (in pixels) of the frame</param>
+/// <param name="height">height (in pixels) of the frame</param>
+/// <param name="bytesPerPixel">size (in bytes) of one pixel</param>
+/// <param name="format">one of the IMAGE_CHANNEL_FORMAT_ values</param>
+static void CheckRoundTrip( LPCWSTR szName, DWORD width, DWORD height, DWORD bytesPerPixel, DWORD format )
+{
+    ImageChannelWriter writer;
+    TEST_CHECK( SUCCEEDED( writer.Create( szName, width * height * bytesPerPixel ) ) );
+
+    ImageChannelReader reader;
+    TEST_CHECK( SUCCEEDED( reader.Open( szName ) ) );
+    TEST_CHECK( NULL == reader.BeginRead( ) );
+
+    // Rows as a sensor hands them out, padded at the end
+    DWORD stride = width * bytesPerPixel;
+    DWORD sourcePitch = stride + 64;
+    BYTE * pSource = new BYTE[sourcePitch * height];
+    for ( DWORD i = 0; i < sourcePitch * height; ++i )
+    {
+        pSource[i] = static_cast<BYTE>(i * 7 + i / sourcePitch);
+    }
+
+    TEST_CHECK( writer.Publish( pSource, width, height, sourcePitch, bytesPerPixel, format, 42, 123456789 ) );
+
+    const IMAGE_CHANNEL_FRAME * pFrame = reader.BeginRead( );
+    TEST_CHECK( NULL != pFrame );
+    if ( NULL != pFrame )
+    {
+        TEST_CHECK( format == pFrame->dwFormat );
+        TEST_CHECK( width == pFrame->dwWidth && height == pFrame->dwHeight );
+        TEST_CHECK( stride == pFrame->dwStride );
+        TEST_CHECK( 42 == pFrame->dwFrameNumber && 123456789 == pFrame->liTimeStamp );
+
+        // The pixels follow the header, 16 byte aligned, with the padding gone
+        const BYTE * pPixels = reinterpret_cast<const BYTE *>(pFrame + 1);
+        TEST_CHECK( 0 == reinterpret_cast<ULONG_PTR>(pPixels) % 16 );
+
+        bool bRowsMatch = true;
+        for ( DWORD y = 0; y < height; ++y )
+        {
+            bRowsMatch = bRowsMatch && 0 == memcmp( pPixels + y * stride, pSource + y * sourcePitch, stride );
+        }
+        TEST_CHECK( bRowsMatch );
+        TEST_CHECK( reader.EndRead( ) );
+    }
+
+    TEST_CHECK( 0 == reader.GetDroppedFrames( ) );
+    TEST_CHECK( NULL == reader.BeginRead( ) );
+
+    // Too big for the channel
+    TEST_CHECK( !writer.Publish( pSource, width, height + 1, sourcePitch, bytesPerPixel, format, 43, 0 ) );
+
+    // A reader that falls behind gets the newest frame, and counts the rest as dropped
+    for ( DWORD frameNumber = 43; frameNumber < 46; ++frameNumber )
+    {
+        TEST_CHECK( writer.Publish( pSource, width, height, sourcePitch, bytesPerPixel, format, frameNumber, 0 ) );
+    }
+
+    pFrame = reader.BeginRead( );
+    TEST_CHECK( NULL != pFrame && 45 == pFrame->dwFrameNumber );
+    TEST_CHECK( reader.EndRead( ) );
+    TEST_CHECK( 2 == reader.GetDroppedFrames( ) );
+
+    delete [] pSource;
+}
+
+/// <summary>
+/// Depth and color come back with their format, stride, frame number and
+/// pixels, and the reader turns down headers it can't trust
+/// </summary>
+void TestImageChannelRoundTrip( )
+{
+    CheckRoundTrip( TEST_CHANNEL_DEPTH_NAME, 320, 240, sizeof(USHORT), IMAGE_CHANNEL_FORMAT_DEPTH16 );
+    CheckRoundTrip( TEST_CHANNEL_COLOR_NAME, 640, 480, 4, IMAGE_CHANNEL_FORMAT_BGRX32 );
+
+    ImageChannelWriter writer;
+    TEST_CHECK( SUCCEEDED( writer.Create( TEST_CHANNEL_COLOR_NAME, 640 * 480 * 4 ) ) );
+
+    ImageChannelReader reader;
+    TEST_CHECK( SUCCEEDED( reader.Open( TEST_CHANNEL_COLOR_NAME ) ) );
+
+    BYTE * pSource = new BYTE[640 * 480 * 4];
+    ZeroMemory( pSource, 640 * 480 * 4 );
+
+    // A format the reader doesn't know
+    TEST_CHECK( writer.Publish( pSource, 640, 480, 640 * 4, 4, IMAGE_CHANNEL_FORMAT_INFRARED16 + 1, 1, 0 ) );
+    TEST_CHECK( NULL != reader.BeginRead( ) );
+    TEST_CHECK( !reader.EndRead( ) );
+    TEST_CHECK( 1 == reader.GetDroppedFrames( ) );
+
+    // Rows too short for BGRX32 pixels
+    TEST_CHECK( writer.Publish( pSource, 640, 480, 640 * 4, sizeof(USHORT), IMAGE_CHANNEL_FORMAT_BGRX32, 2, 0 ) );
+    TEST_CHECK( NULL != reader.BeginRead( ) );
+    TEST_CHECK( !reader.EndRead( ) );
+    TEST_CHECK( 2 == reader.GetDroppedFrames( ) );
+
+    // Good frames are read again after bad ones
+    TEST_CHECK( writer.Publish( pSource, 640, 480, 640 * 4, 4, IMAGE_CHANNEL_FORMAT_BGRX32, 3, 0 ) );
+    TEST_CHECK( NULL != reader.BeginRead( ) );
+    TEST_CHECK( reader.EndRead( ) );
+    TEST_CHECK( 2 == reader.GetDroppedFrames( ) );
+
+    delete [] pSource;
+}
+
+/// <summary>
+/// Map a ring the way another process would, to write its header behind the ring's back
+/// </summary>
+/// <param name="szName">name of the file mapping</param>
+/// <param name="cbMapping">size (in bytes) of the mapping, if it is created here</param>
+/// <param name="phMapping">receives the mapping, to be closed by the caller</param>
+/// <returns>header of the ring, NULL on failure</returns>
+static SHARED_RING_HEADER * MapRingHeader( LPCWSTR szName, DWORD cbMapping, HANDLE * phMapping )
+{
+    *phMapping = CreateFileMappingW( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, cbMapping, szName );
+    if ( NULL == *phMapping )
+    {
+        return NULL;
+    }
+
+    return static_cast<SHARED_RING_HEADER *>(MapViewOfFile( *phMapping, FILE_MAP_WRITE, 0, 0, 0 ));
+}
+
+/// <summary>
+/// A mapping too small for the slots its header claims is refused, and
+/// frames keep coming, with none counted as dropped, as the write count wraps
+/// </summary>
+void TestImageChannelRingLimits( )
+{
+    // A header claiming a thousand slots in one page
+    HANDLE hMapping;
+    SHARED_RING_HEADER * pHeader = MapRingHeader( TEST_CHANNEL_RING_NAME, 4096, &hMapping );
+    TEST_CHECK( NULL != pHeader );
+    if ( NULL == pHeader )
+    {
+        return;
+    }
+
+    pHeader->cbSlot = sizeof(IMAGE_CHANNEL_FRAME) + 64;
+    pHeader->cbSlotStride = 16 + pHeader->cbSlot;
+    pHeader->cSlots = 1000;
+    pHeader->dwWriteCount = 0;
+    pHeader->dwMagic = SHARED_RING_MAGIC;
+
+    {
+        ImageChannelReader reader;
+        TEST_CHECK( FAILED( reader.Open( TEST_CHANNEL_RING_NAME ) ) );
+        TEST_CHECK( NULL == reader.BeginRead( ) );
+
+        // Slots that overlap, or too few of them
+        pHeader->cSlots = 2;
+        pHeader->cbSlotStride = pHeader->cbSlot;
+        TEST_CHECK( FAILED( reader.Open( TEST_CHANNEL_RING_NAME ) ) );
+        pHeader->cbSlotStride = 16 + pHeader->cbSlot;
+        pHeader->cSlots = 1;
+        TEST_CHECK( FAILED( reader.Open( TEST_CHANNEL_RING_NAME ) ) );
+
+        // A header that fits is taken
+        pHeader->cSlots = 2;
+        TEST_CHECK( SUCCEEDED( reader.Open( TEST_CHANNEL_RING_NAME ) ) );
+    }
+
+    UnmapViewOfFile( pHeader );
+    CloseHandle( hMapping );
+
+    // A writer that has been publishing for a very long time
+    static const DWORD width = 16;
+    static const DWORD height = 4;
+    ImageChannelWriter writer;
+    TEST_CHECK( SUCCEEDED( writer.Create( TEST_CHANNEL_RING_NAME, width * height * sizeof(USHORT) ) ) );
+
+    pHeader = MapRingHeader( TEST_CHANNEL_RING_NAME, 0, &hMapping );
+    TEST_CHECK( NULL != pHeader );
+    if ( NULL == pHeader )
+    {
+        return;
+    }
+    pHeader->dwWriteCount = MAXDWORD - 2;
+
+    ImageChannelReader reader;
+    TEST_CHECK( SUCCEEDED( reader.Open( TEST_CHANNEL_RING_NAME ) ) );
+
+    USHORT pixels[width * height];
+    ZeroMemory( pixels, sizeof(pixels) );
+
+    UINT cMissed = 0;
+    for ( DWORD frameNumber = 1; frameNumber <= 6; ++frameNumber )
+    {
+        writer.Publish( reinterpret_cast<const BYTE *>(pixels), width, height, width * sizeof(USHORT), sizeof(USHORT), IMAGE_CHANNEL_FORMAT_DEPTH16, frameNumber, 0 );
+        const IMAGE_CHANNEL_FRAME * pFrame = reader.BeginRead( );
+        cMissed += ( NULL != pFrame && frameNumber == pFrame->dwFrameNumber && reader.EndRead( ) ) ? 0 : 1;
+    }
+
+    TEST_CHECK( 0 == cMissed );
+    TEST_CHECK( 0 == reader.GetDroppedFrames( ) );
+    TEST_CHECK( 3 == pHeader->dwWriteCount );
+
+    UnmapViewOfFile( pHeader );
+    CloseHandle( hMapping );
+}
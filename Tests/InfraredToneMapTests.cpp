@@ -0,0 +1,198 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="InfraredToneMapTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Infrared converted through the tone table against the curve worked out per
+// pixel, and what converting a frame costs each way
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "InfraredToneMap.h"
+
+/// <summary>
+/// Fill a frame with infrared as the sensor gives it: bright in the middle
+/// and falling off with the square of the distance from it, with texture and
+/// noise, and only the top 10 bits of each sample set
+/// </summary>
+/// <param name="pInfrared">receives samples, width * height of them</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="random">state of the noise</param>
+static void MakeInfrared( USHORT * pInfrared, UINT width, UINT height, UINT & random )
+{
+    for ( UINT y = 0; y < height; ++y )
+    {
+        for ( UINT x = 0; x < width; ++x )
+        {
+            float dx = (static_cast<float>(x) - width / 2.0f) / width;
+            float dy = (static_cast<float>(y) - height / 2.0f) / height;
+            float level = 60000.0f / (1.0f + 40.0f * (dx * dx + dy * dy));
+            level *= ( 0 == (x / 16 + y / 16) % 2 ) ? 1.0f : 0.6f;
+            level += static_cast<float>(TestRandom( random ) % 2048) - 1024.0f;
+
+            UINT sample = static_cast<UINT>(min( max( level, 0.0f ), 65535.0f ));
+            pInfrared[y * width + x] = static_cast<USHORT>(sample & 0xFFC0);
+        }
+    }
+}
+
+/// <summary>
+/// Gray of one sample on a curve, worked out directly
+/// </summary>
+/// <param name="sample">infrared sample</param>
+/// <param name="black">samples at or below this are black</param>
+/// <param name="white">samples at or above this are white</param>
+/// <param name="gamma">exponent applied between black and white</param>
+/// <returns>gray level</returns>
+static BYTE CurveGray( USHORT sample, USHORT black, USHORT white, float gamma )
+{
+    float range = static_cast<float>(max( white - black, 1 ));
+    float level = min( max( (static_cast<int>(sample) - black) / range, 0.0f ), 1.0f );
+
+    return static_cast<BYTE>(255.0f * powf( level, gamma ) + 0.5f);
+}
+
+/// <summary>
+/// Frames come out as the curve worked out for every pixel, gray in all four
+/// bytes, with the default curve and with others; samples below black are
+/// black and above white are white; rows are read at the pitch given, and
+/// widths the conversion can't take are refused
+/// </summary>
+void TestInfraredToneMap( )
+{
+    const UINT width = 640;
+    const UINT height = 480;
+    const UINT cPixels = width * height;
+    UINT random = 3;
+
+    USHORT * pInfrared = new USHORT[cPixels];
+    USHORT * pPadded = new USHORT[cPixels * 2];
+    MakeInfrared( pInfrared, width, height, random );
+    ZeroMemory( pPadded, cPixels * 2 * sizeof(USHORT) );
+    for ( UINT y = 0; y < height; ++y )
+    {
+        CopyMemory( pPadded + y * width * 2, pInfrared + y * width, width * sizeof(USHORT) );
+    }
+
+    InfraredToneMap toneMap;
+    TEST_CHECK( toneMap.Initialize( NUI_IMAGE_RESOLUTION_640x480 ) );
+    TEST_CHECK( toneMap.GetOutputSize( ) == cPixels * 4 );
+
+    static const struct
+    {
+        USHORT  black;
+        USHORT  white;
+        float   gamma;
+    } curves[] =
+    {
+        { INFRARED_DEFAULT_BLACK, INFRARED_DEFAULT_WHITE, INFRARED_DEFAULT_GAMMA },
+        { 0x0000, 0xFFC0, 1.0f },
+        { 0x2000, 0x8000, 2.2f },
+    };
+
+    BYTE * pExpected = new BYTE[cPixels * 4];
+    for ( UINT c = 0; c < _countof(curves); ++c )
+    {
+        if ( c )
+        {
+            toneMap.SetCurve( curves[c].black, curves[c].white, curves[c].gamma );
+        }
+
+        for ( UINT i = 0; i < cPixels; ++i )
+        {
+            BYTE gray = CurveGray( pInfrared[i], curves[c].black, curves[c].white, curves[c].gamma );
+            pExpected[i * 4 + 0] = gray;
+            pExpected[i * 4 + 1] = gray;
+            pExpected[i * 4 + 2] = gray;
+            pExpected[i * 4 + 3] = gray;
+        }
+
+        TEST_CHECK( 0 == memcmp( toneMap.Convert( pInfrared, width * sizeof(USHORT) ), pExpected, cPixels * 4 ) );
+        TEST_CHECK( 0 == memcmp( toneMap.Convert( pPadded, width * 2 * sizeof(USHORT) ), pExpected, cPixels * 4 ) );
+    }
+
+    // Past either end of the curve
+    toneMap.SetCurve( 0x1000, 0x2000, 0.5f );
+    for ( UINT i = 0; i < cPixels; ++i )
+    {
+        pInfrared[i] = ( i % 2 ) ? 0x0FC0 : 0x2000;
+    }
+    const BYTE * pGray = toneMap.Convert( pInfrared, width * sizeof(USHORT) );
+    UINT cWrong = 0;
+    for ( UINT i = 0; i < cPixels; ++i )
+    {
+        cWrong += ( pGray[i * 4] == (( i % 2 ) ? 0 : 255) ) ? 0 : 1;
+    }
+    TEST_CHECK( 0 == cWrong );
+
+    delete [] pExpected;
+    delete [] pPadded;
+    delete [] pInfrared;
+
+    TEST_CHECK( !toneMap.Initialize( NUI_IMAGE_RESOLUTION_INVALID ) );
+    TEST_CHECK( toneMap.Initialize( NUI_IMAGE_RESOLUTION_320x240 ) );
+    TEST_CHECK( toneMap.GetOutputSize( ) == 320 * 240 * 4 );
+}
+
+/// <summary>
+/// Time converting a 640x480 frame with the curve worked out per pixel, with
+/// the table looked up one pixel at a time, and with InfraredToneMap
+/// </summary>
+void BenchInfraredToneMap( )
+{
+    const UINT width = 640;
+    const UINT height = 480;
+    const UINT cPixels = width * height;
+    const UINT cRuns = 50;
+    UINT random = 3;
+
+    USHORT * pInfrared = new USHORT[cPixels];
+    DWORD * pOutput = new DWORD[cPixels];
+    MakeInfrared( pInfrared, width, height, random );
+
+    InfraredToneMap toneMap;
+    if ( !toneMap.Initialize( NUI_IMAGE_RESOLUTION_640x480 ) )
+    {
+        printf( "    tone map failed to initialize\n" );
+        delete [] pOutput;
+        delete [] pInfrared;
+        return;
+    }
+
+    // The table the tone map builds, for the one pixel at a time lookup
+    DWORD table[INFRARED_TONE_MAP_ENTRIES];
+    for ( UINT entry = 0; entry < INFRARED_TONE_MAP_ENTRIES; ++entry )
+    {
+        table[entry] = CurveGray( static_cast<USHORT>(entry << INFRARED_TONE_MAP_SHIFT), INFRARED_DEFAULT_BLACK, INFRARED_DEFAULT_WHITE, INFRARED_DEFAULT_GAMMA ) * 0x01010101;
+    }
+
+    double curveTimes[cRuns], tableTimes[cRuns], toneMapTimes[cRuns];
+    for ( UINT run = 0; run < cRuns; ++run )
+    {
+        double start = TestSeconds( );
+        for ( UINT i = 0; i < cPixels; ++i )
+        {
+            pOutput[i] = CurveGray( pInfrared[i], INFRARED_DEFAULT_BLACK, INFRARED_DEFAULT_WHITE, INFRARED_DEFAULT_GAMMA ) * 0x01010101;
+        }
+        curveTimes[run] = TestSeconds( ) - start;
+
+        start = TestSeconds( );
+        for ( UINT i = 0; i < cPixels; ++i )
+        {
+            pOutput[i] = table[pInfrared[i] >> INFRARED_TONE_MAP_SHIFT];
+        }
+        tableTimes[run] = TestSeconds( ) - start;
+
+        start = TestSeconds( );
+        toneMap.Convert( pInfrared, width * sizeof(USHORT) );
+        toneMapTimes[run] = TestSeconds( ) - start;
+    }
+
+    printf( "    640x480: curve per pixel %.3f ms, table per pixel %.3f ms, InfraredToneMap %.3f ms\n",
+        TestMedian( curveTimes, cRuns ) * 1000.0, TestMedian( tableTimes, cRuns ) * 1000.0, TestMedian( toneMapTimes, cRuns ) * 1000.0 );
+
+    delete [] pOutput;
+    delete [] pInfrared;
+}
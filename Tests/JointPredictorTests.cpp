@@ -0,0 +1,175 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="JointPredictorTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// How far predicted joints are from where synthetic skeletons really go
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "JointPredictor.h"
+
+static const float g_TestPi = 3.14159265f;
+
+// Milliseconds between frames, as the sensor sends them
+static const UINT g_FrameInterval = 33;
+
+/// <summary>
+/// Where a joint of a synthetic skeleton really is: every joint swings at its
+/// own rate between 0.4 and 1.6 Hz, by up to a few tens of centimeters
+/// </summary>
+/// <param name="skeleton">skeleton index</param>
+/// <param name="joint">joint index</param>
+/// <param name="milliseconds">time since the skeleton started moving</param>
+/// <param name="position">receives the position</param>
+static void GetTruePosition( int skeleton, int joint, UINT milliseconds, Vector4 & position )
+{
+    float t = milliseconds * 0.001f;
+    float rate = 2.0f * g_TestPi * (0.4f + 0.04f * joint + 0.05f * skeleton);
+    float reach = 0.1f + 0.005f * joint;
+
+    position.x = 0.4f * skeleton + 0.02f * joint + reach * sinf( rate * t );
+    position.y = 0.1f * joint + reach * cosf( 0.7f * rate * t );
+    position.z = 2.5f + 0.5f * reach * sinf( 1.3f * rate * t + joint );
+    position.w = 1.0f;
+}
+
+/// <summary>
+/// Fill a frame with six skeletons where they really are, give or take the
+/// jitter of a sensor
+/// </summary>
+/// <param name="frame">frame to fill</param>
+/// <param name="number">frame number, from 0</param>
+/// <param name="jitter">largest error of each coordinate, in meters</param>
+/// <param name="random">state of the jitter sequence</param>
+static void MakeFrame( NUI_SKELETON_FRAME & frame, UINT number, float jitter, UINT & random )
+{
+    ZeroMemory( &frame, sizeof(frame) );
+    frame.liTimeStamp.QuadPart = 1000 + number * g_FrameInterval;
+    frame.dwFrameNumber = number + 1;
+
+    for ( int skeleton = 0; skeleton < NUI_SKELETON_COUNT; ++skeleton )
+    {
+        NUI_SKELETON_DATA & data = frame.SkeletonData[skeleton];
+        data.eTrackingState = NUI_SKELETON_TRACKED;
+        data.dwTrackingID = skeleton + 1;
+
+        for ( int joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+        {
+            Vector4 & position = data.SkeletonPositions[joint];
+            GetTruePosition( skeleton, joint, number * g_FrameInterval, position );
+            position.x += (TestRandom( random ) / 16383.5f - 1.0f) * jitter;
+            position.y += (TestRandom( random ) / 16383.5f - 1.0f) * jitter;
+            position.z += (TestRandom( random ) / 16383.5f - 1.0f) * jitter;
+            data.eSkeletonPositionTrackingState[joint] = NUI_SKELETON_POSITION_TRACKED;
+        }
+    }
+}
+
+/// <summary>
+/// Distance between two positions
+/// </summary>
+/// <param name="a">first position</param>
+/// <param name="b">second position</param>
+/// <returns>distance in meters</returns>
+static float Distance( const Vector4 & a, const Vector4 & b )
+{
+    float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return sqrtf( dx * dx + dy * dy + dz * dz );
+}
+
+/// <summary>
+/// Predicted joints are much closer to where the skeletons really go than the
+/// unpredicted ones, the live error measure agrees, the horizon is clamped,
+/// and a glitch of one frame moves a prediction no further than the limit
+/// </summary>
+void TestJointPredictor( )
+{
+    static const UINT horizons[] = { 66, 100 };
+
+    SkeletonKinematics * pKinematics = new SkeletonKinematics( );
+    JointPredictor * pPredictor = new JointPredictor( );
+    NUI_SKELETON_FRAME frame, predicted;
+
+    pPredictor->SetHorizon( 1000 );
+    TEST_CHECK( JOINT_PREDICTOR_MAX_HORIZON == pPredictor->GetHorizon( ) );
+
+    // Error against the true future position, with 2 mm of jitter
+    for ( UINT i = 0; i < _countof(horizons); ++i )
+    {
+        delete pKinematics;
+        delete pPredictor;
+        pKinematics = new SkeletonKinematics( );
+        pPredictor = new JointPredictor( );
+        pPredictor->SetHorizon( horizons[i] );
+
+        UINT random = 5;
+        double predictedSum = 0.0, unpredictedSum = 0.0;
+        UINT cJoints = 0;
+
+        for ( UINT number = 0; number < 300; ++number )
+        {
+            MakeFrame( frame, number, 0.002f, random );
+            const SKELETON_KINEMATICS_FRAME & kinematics = pKinematics->Update( frame );
+            pPredictor->Predict( frame, kinematics, predicted );
+
+            // Leave the first frames for the fit to fill its history
+            if ( number < 10 )
+            {
+                continue;
+            }
+
+            for ( int skeleton = 0; skeleton < NUI_SKELETON_COUNT; ++skeleton )
+            {
+                for ( int joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+                {
+                    Vector4 future;
+                    GetTruePosition( skeleton, joint, number * g_FrameInterval + horizons[i], future );
+                    predictedSum += Distance( predicted.SkeletonData[skeleton].SkeletonPositions[joint], future );
+                    unpredictedSum += Distance( frame.SkeletonData[skeleton].SkeletonPositions[joint], future );
+                    ++cJoints;
+                }
+            }
+        }
+
+        double predictedError = predictedSum / cJoints;
+        double unpredictedError = unpredictedSum / cJoints;
+        TEST_CHECK( predictedError < 0.6 * unpredictedError );
+
+        JOINT_PREDICTION_ERROR error;
+        TEST_CHECK( pPredictor->ReadError( error ) );
+        TEST_CHECK( error.cJoints > 0 && error.meanError < error.meanLag && error.maxError >= error.meanError );
+        TEST_CHECK( !pPredictor->ReadError( error ) && 0 == error.cJoints );
+    }
+
+    // A joint thrown a meter for one frame
+    delete pKinematics;
+    delete pPredictor;
+    pKinematics = new SkeletonKinematics( );
+    pPredictor = new JointPredictor( );
+    pPredictor->SetHorizon( 100 );
+
+    UINT random = 9;
+    float largestOffset = 0.0f;
+    for ( UINT number = 0; number < 60; ++number )
+    {
+        MakeFrame( frame, number, 0.0f, random );
+        if ( 30 == number )
+        {
+            frame.SkeletonData[0].SkeletonPositions[NUI_SKELETON_POSITION_HAND_RIGHT].x += 1.0f;
+        }
+
+        const SKELETON_KINEMATICS_FRAME & kinematics = pKinematics->Update( frame );
+        pPredictor->Predict( frame, kinematics, predicted );
+
+        float offset = Distance( predicted.SkeletonData[0].SkeletonPositions[NUI_SKELETON_POSITION_HAND_RIGHT],
+                                 frame.SkeletonData[0].SkeletonPositions[NUI_SKELETON_POSITION_HAND_RIGHT] );
+        largestOffset = max( largestOffset, offset );
+    }
+
+    TEST_CHECK( largestOffset > 0.0f && largestOffset <= JOINT_PREDICTOR_MAX_OFFSET + 0.001f );
+
+    delete pKinematics;
+    delete pPredictor;
+}
@@ -0,0 +1,247 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="PlayerSegmentationTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Player masks and statistics gathered while depth is colorized, against a
+// brute-force pass, and what gathering them costs
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "DepthKernel.h"
+
+/// <summary>
+/// Render three players standing side by side in front of a wall, with
+/// pixels dropping out of them along diagonal lines
+/// </summary>
+/// <param name="pDepth">receives packed depth and player index, width * height pixels</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+static void RenderPlayers( USHORT * pDepth, DWORD width, DWORD height )
+{
+    for ( DWORD y = 0; y < height; ++y )
+    {
+        for ( DWORD x = 0; x < width; ++x )
+        {
+            USHORT player = 0;
+            for ( int k = 0; k < 3; ++k )
+            {
+                float dx = (static_cast<float>(x) - width * (k + 1) / 4.0f) / (width / 10.0f);
+                float dy = (static_cast<float>(y) - height / 2.0f) / (height / 3.0f);
+                if ( dx * dx + dy * dy < 1.0f )
+                {
+                    player = static_cast<USHORT>(k + 1);
+                }
+            }
+
+            if ( 0 == (x * 7 + y * 13) % 97 )
+            {
+                player = 0;
+            }
+
+            USHORT depth = static_cast<USHORT>(player ? 1500 + 300 * player : 3500);
+            pDepth[y * width + x] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | player);
+        }
+    }
+}
+
+/// <summary>
+/// Check the statistics, labels and runs of a frame against the player index of every pixel
+/// </summary>
+/// <param name="segmentation">segmentation of the frame</param>
+/// <param name="pDepth">packed depth and player index of the frame</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="bPlayerIndex">whether the frame carries a player index</param>
+static void CheckSegmentation( const PlayerSegmentation & segmentation, const USHORT * pDepth, DWORD width, DWORD height, bool bPlayerIndex )
+{
+    UINT cWrongPlayers = 0;
+    for ( USHORT p = 1; p <= PLAYER_SEGMENT_COUNT; ++p )
+    {
+        DWORD cPixels = 0;
+        LONG left = MAXLONG, top = MAXLONG, right = -1, bottom = -1;
+        double sumX = 0.0, sumY = 0.0;
+
+        for ( DWORD y = 0; y < height; ++y )
+        {
+            for ( DWORD x = 0; x < width; ++x )
+            {
+                if ( bPlayerIndex && p == NuiDepthPixelToPlayerIndex( pDepth[y * width + x] ) )
+                {
+                    ++cPixels;
+                    left = min( left, static_cast<LONG>(x) );
+                    right = max( right, static_cast<LONG>(x) );
+                    top = min( top, static_cast<LONG>(y) );
+                    bottom = static_cast<LONG>(y);
+                    sumX += x;
+                    sumY += y;
+                }
+            }
+        }
+
+        const PLAYER_SEGMENT & player = segmentation.GetPlayers( )[p - 1];
+        bool bMatch = ( cPixels == player.cPixels );
+        if ( cPixels )
+        {
+            bMatch = bMatch && left == player.left && top == player.top && right == player.right && bottom == player.bottom &&
+                fabs( sumX / cPixels - player.centroidX ) < 0.01 && fabs( sumY / cPixels - player.centroidY ) < 0.01;
+        }
+        cWrongPlayers += bMatch ? 0 : 1;
+    }
+    TEST_CHECK( 0 == cWrongPlayers );
+
+    // Labels, and the runs decoded back to them
+    const PLAYER_MASK_HEADER * pHeader = reinterpret_cast<const PLAYER_MASK_HEADER *>(segmentation.GetPackedMasks( ));
+    TEST_CHECK( PLAYER_MASK_MAGIC == pHeader->dwMagic && width == pHeader->usWidth && height == pHeader->usHeight );
+    TEST_CHECK( sizeof(PLAYER_MASK_HEADER) + pHeader->cRuns * sizeof(USHORT) == segmentation.GetPackedSize( ) );
+
+    const USHORT * pRuns = reinterpret_cast<const USHORT *>(pHeader + 1);
+    const BYTE * pLabels = segmentation.GetLabels( );
+    DWORD i = 0;
+    UINT cWrongPixels = 0;
+    UINT cEmptyRuns = 0;
+    for ( DWORD r = 0; r < pHeader->cRuns; ++r )
+    {
+        DWORD length = pRuns[r] & PLAYER_MASK_MAX_RUN;
+        USHORT player = static_cast<USHORT>(pRuns[r] >> PLAYER_MASK_RUN_SHIFT);
+        cEmptyRuns += ( 0 == length ) ? 1 : 0;
+
+        for ( DWORD k = 0; k < length && i < width * height; ++k, ++i )
+        {
+            USHORT expected = bPlayerIndex ? NuiDepthPixelToPlayerIndex( pDepth[i] ) : 0;
+            cWrongPixels += ( expected == player && expected == pLabels[i] ) ? 0 : 1;
+        }
+    }
+
+    TEST_CHECK( width * height == i );
+    TEST_CHECK( 0 == cWrongPixels );
+    TEST_CHECK( 0 == cEmptyRuns );
+}
+
+/// <summary>
+/// Masks, counts, bounding boxes and centroids gathered in the colorizing
+/// pass match a brute-force pass over the player index; runs decode back to
+/// the labels, long ones split at the longest run, and a stream without a
+/// player index has no players
+/// </summary>
+void TestPlayerSegmentation( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+
+        USHORT * pDepth = new USHORT[width * height];
+        BYTE * pRGBX = new BYTE[width * height * 4];
+        RenderPlayers( pDepth, width, height );
+
+        for ( int bPlayerIndex = 1; bPlayerIndex >= 0; --bPlayerIndex )
+        {
+            DepthKernel kernel;
+            TEST_CHECK( kernel.Select( bPlayerIndex ? NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX : NUI_IMAGE_TYPE_DEPTH, resolutions[r] ) );
+
+            PlayerSegmentation segmentation;
+            TEST_CHECK( segmentation.BeginFrame( width, height, 7 ) );
+
+            DEPTH_KERNEL_TARGETS targets;
+            ZeroMemory( &targets, sizeof(targets) );
+            targets.pRGBX = pRGBX;
+            targets.pSegmentation = &segmentation;
+            kernel.Run( DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_PLAYER_MASKS, pDepth, targets );
+            segmentation.EndFrame( );
+
+            CheckSegmentation( segmentation, pDepth, width, height, 0 != bPlayerIndex );
+
+            if ( !bPlayerIndex )
+            {
+                // The whole frame is background, in runs as long as they get
+                const PLAYER_MASK_HEADER * pHeader = reinterpret_cast<const PLAYER_MASK_HEADER *>(segmentation.GetPackedMasks( ));
+                TEST_CHECK( (width * height + PLAYER_MASK_MAX_RUN - 1) / PLAYER_MASK_MAX_RUN == pHeader->cRuns );
+            }
+        }
+
+        delete [] pRGBX;
+        delete [] pDepth;
+    }
+
+    PlayerSegmentation segmentation;
+    TEST_CHECK( !segmentation.BeginFrame( 0, 240, 0 ) );
+    TEST_CHECK( !segmentation.BeginFrame( 0x10000, 1, 0 ) );
+    TEST_CHECK( 0 == segmentation.GetPlayers( )[0].cPixels );
+}
+
+/// <summary>
+/// Time colorizing alone, colorizing and segmenting in one pass, and
+/// segmenting in a pass of its own after colorizing
+/// </summary>
+void BenchPlayerSegmentation( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    static const UINT cPasses = 7;
+    static const UINT cFrames = 50;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+
+        USHORT * pDepth = new USHORT[width * height];
+        BYTE * pRGBX = new BYTE[width * height * 4];
+        RenderPlayers( pDepth, width, height );
+
+        DepthKernel kernel;
+        PlayerSegmentation segmentation;
+        if ( !kernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, resolutions[r] ) || !segmentation.BeginFrame( width, height, 0 ) )
+        {
+            printf( "    kernel or segmentation failed to start\n" );
+            return;
+        }
+
+        DEPTH_KERNEL_TARGETS targets;
+        ZeroMemory( &targets, sizeof(targets) );
+        targets.pRGBX = pRGBX;
+        targets.pSegmentation = &segmentation;
+
+        double colorizeTimes[cPasses];
+        double fusedTimes[cPasses];
+        double separateTimes[cPasses];
+        for ( UINT pass = 0; pass < cPasses; ++pass )
+        {
+            double start = TestSeconds( );
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                kernel.Run( DEPTH_KERNEL_COLORIZE, pDepth, targets );
+            }
+            double colorized = TestSeconds( );
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                segmentation.BeginFrame( width, height, i );
+                kernel.Run( DEPTH_KERNEL_COLORIZE | DEPTH_KERNEL_PLAYER_MASKS, pDepth, targets );
+                segmentation.EndFrame( );
+            }
+            double fused = TestSeconds( );
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                kernel.Run( DEPTH_KERNEL_COLORIZE, pDepth, targets );
+                segmentation.BeginFrame( width, height, i );
+                kernel.Run( DEPTH_KERNEL_PLAYER_MASKS, pDepth, targets );
+                segmentation.EndFrame( );
+            }
+            double separate = TestSeconds( );
+
+            colorizeTimes[pass] = (colorized - start) / cFrames;
+            fusedTimes[pass] = (fused - colorized) / cFrames;
+            separateTimes[pass] = (separate - fused) / cFrames;
+        }
+
+        printf( "    %ux%u: colorize %.3f ms, colorize and segment in one pass %.3f ms, in two passes %.3f ms, masks packed to %u bytes\n",
+            width, height, TestMedian( colorizeTimes, cPasses ) * 1000.0, TestMedian( fusedTimes, cPasses ) * 1000.0,
+            TestMedian( separateTimes, cPasses ) * 1000.0, segmentation.GetPackedSize( ) );
+
+        delete [] pRGBX;
+        delete [] pDepth;
+    }
+}
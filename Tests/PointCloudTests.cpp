@@ -0,0 +1,246 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="PointCloudTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Points converted through the ray table against the per-pixel transform, and
+// what converting a frame costs
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "PointCloud.h"
+
+/// <summary>
+/// Fill a frame with depth from 0.8 to 3.8 m, a hole every 13 pixels and
+/// player indices cycling through every value
+/// </summary>
+/// <param name="pDepth">receives packed depth, width * height pixels</param>
+/// <param name="pointCount">width * height</param>
+/// <param name="random">state of the depth sequence</param>
+/// <returns>number of pixels with depth</returns>
+static UINT MakeDepth( USHORT * pDepth, UINT pointCount, UINT & random )
+{
+    UINT validCount = 0;
+    for ( UINT i = 0; i < pointCount; ++i )
+    {
+        USHORT depth = ( 0 == i % 13 ) ? 0 : static_cast<USHORT>(800 + TestRandom( random ) % 3000);
+        pDepth[i] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | (i % 7));
+        validCount += ( 0 != depth ) ? 1 : 0;
+    }
+
+    return validCount;
+}
+
+/// <summary>
+/// Transform one pixel to skeleton space, as NuiTransformDepthImageToSkeleton does
+/// </summary>
+/// <param name="x">column of the pixel</param>
+/// <param name="y">row of the pixel</param>
+/// <param name="packed">packed depth of the pixel</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="point">receives x, y and z (in meters)</param>
+static void TransformPixel( UINT x, UINT y, USHORT packed, UINT width, UINT height, float point[3] )
+{
+    float z = (packed >> NUI_IMAGE_PLAYER_INDEX_SHIFT) / 1000.0f;
+    float scale = NUI_CAMERA_DEPTH_IMAGE_TO_SKELETON_MULTIPLIER_320x240 * 320.0f / width;
+
+    point[0] = (static_cast<float>(x) - width / 2.0f) * scale * z;
+    point[1] = -(static_cast<float>(y) - height / 2.0f) * scale * z;
+    point[2] = z;
+}
+
+/// <summary>
+/// Points of both depth resolutions match the per-pixel transform, with the
+/// player index of each and holes at the origin; a PLY export holds a vertex
+/// for each point with depth
+/// </summary>
+void TestPointCloud( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+
+    PointCloud pointCloud;
+    TEST_CHECK( !pointCloud.Initialize( NUI_IMAGE_RESOLUTION_1280x960 ) );
+    POINT_CLOUD_TARGET target;
+    TEST_CHECK( !pointCloud.BeginFrame( false, target ) );
+
+    UINT random = 13;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+
+        TEST_CHECK( pointCloud.Initialize( resolutions[r] ) );
+        TEST_CHECK( width * height == pointCloud.GetPointCount( ) );
+
+        USHORT * pDepth = new USHORT[width * height];
+        UINT validCount = MakeDepth( pDepth, width * height, random );
+
+        pointCloud.Generate( pDepth, true );
+        TEST_CHECK( validCount == pointCloud.GetValidPointCount( ) );
+        TEST_CHECK( NULL != pointCloud.GetPlayerIndex( ) );
+
+        float maxError = 0.0f;
+        UINT cWrongPlayer = 0;
+        for ( UINT y = 0; y < height; ++y )
+        {
+            for ( UINT x = 0; x < width; ++x )
+            {
+                UINT i = y * width + x;
+                float point[3];
+                TransformPixel( x, y, pDepth[i], width, height, point );
+
+                maxError = max( maxError, fabsf( point[0] - pointCloud.GetX( )[i] ) );
+                maxError = max( maxError, fabsf( point[1] - pointCloud.GetY( )[i] ) );
+                maxError = max( maxError, fabsf( point[2] - pointCloud.GetZ( )[i] ) );
+                cWrongPlayer += ( (pDepth[i] & NUI_IMAGE_PLAYER_INDEX_MASK) == pointCloud.GetPlayerIndex( )[i] ) ? 0 : 1;
+            }
+        }
+
+        TEST_CHECK( maxError < 1e-5f );
+        TEST_CHECK( 0 == cWrongPlayer );
+        TEST_CHECK( 0.0f == pointCloud.GetX( )[0] && 0.0f == pointCloud.GetZ( )[0] );
+
+        // Without the player index there is none to get
+        pointCloud.Generate( pDepth, false );
+        TEST_CHECK( NULL == pointCloud.GetPlayerIndex( ) );
+
+        // A pass of its own writes the same buffers, 16 byte aligned
+        TEST_CHECK( pointCloud.BeginFrame( true, target ) );
+        TEST_CHECK( target.pX == pointCloud.GetX( ) && target.pZ == pointCloud.GetZ( ) && NULL != target.pPlayer );
+        TEST_CHECK( 0 == reinterpret_cast<ULONG_PTR>(target.pRayX) % 16 && 0 == reinterpret_cast<ULONG_PTR>(target.pY) % 16 );
+        pointCloud.EndFrame( validCount );
+        TEST_CHECK( validCount == pointCloud.GetValidPointCount( ) );
+
+        delete [] pDepth;
+    }
+
+    // The last frame exported with colors and player indices
+    WCHAR szFileName[MAX_PATH];
+    TEST_CHECK( 0 != GetTempPathW( _countof(szFileName), szFileName ) );
+    TEST_CHECK( SUCCEEDED( StringCchCatW( szFileName, _countof(szFileName), L"SkeletalViewerTests.ply" ) ) );
+
+    UINT pointCount = pointCloud.GetPointCount( );
+    BYTE * pColors = new BYTE[pointCount * sizeof(DWORD)];
+    for ( UINT i = 0; i < pointCount * sizeof(DWORD); ++i )
+    {
+        pColors[i] = static_cast<BYTE>(i);
+    }
+
+    TEST_CHECK( SUCCEEDED( pointCloud.ExportPly( szFileName, pColors ) ) );
+
+    HANDLE hFile = CreateFileW( szFileName, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    TEST_CHECK( INVALID_HANDLE_VALUE != hFile );
+    if ( INVALID_HANDLE_VALUE != hFile )
+    {
+        // Header, then x, y, z, red, green, blue and player of each point with depth
+        static const UINT cbVertex = 3 * sizeof(float) + 4;
+        UINT cbFile = 1024 + pointCloud.GetValidPointCount( ) * cbVertex;
+        BYTE * pFile = new BYTE[cbFile];
+        DWORD cbRead = 0;
+        TEST_CHECK( ReadFile( hFile, pFile, cbFile, &cbRead, NULL ) );
+        CloseHandle( hFile );
+
+        char szExpected[64];
+        StringCchPrintfA( szExpected, _countof(szExpected), "element vertex %u\n", pointCloud.GetValidPointCount( ) );
+        const char * szEnd = "end_header\n";
+
+        const BYTE * pHeaderEnd = NULL;
+        for ( DWORD i = 0; i + strlen( szEnd ) <= cbRead && NULL == pHeaderEnd; ++i )
+        {
+            pHeaderEnd = ( 0 == memcmp( pFile + i, szEnd, strlen( szEnd ) ) ) ? pFile + i + strlen( szEnd ) : NULL;
+        }
+
+        TEST_CHECK( NULL != pHeaderEnd );
+        if ( NULL != pHeaderEnd )
+        {
+            UINT cbHeader = static_cast<UINT>(pHeaderEnd - pFile);
+            TEST_CHECK( NULL != strstr( reinterpret_cast<const char *>(pFile), szExpected ) );
+            TEST_CHECK( cbHeader + pointCloud.GetValidPointCount( ) * cbVertex == cbRead );
+
+            // Pixel 0 is a hole, so the first vertex is pixel 1
+            float x;
+            CopyMemory( &x, pHeaderEnd, sizeof(x) );
+            TEST_CHECK( x == pointCloud.GetX( )[1] );
+            TEST_CHECK( pColors[6] == pHeaderEnd[12] && pColors[4] == pHeaderEnd[14] && 1 == pHeaderEnd[15] );
+        }
+
+        delete [] pFile;
+    }
+
+    DeleteFileW( szFileName );
+    delete [] pColors;
+}
+
+/// <summary>
+/// Time converting a frame through the ray table, with and without the player
+/// index, against transforming each pixel on its own
+/// </summary>
+void BenchPointCloud( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    static const UINT cPasses = 7;
+    static const UINT cFrames = 100;
+
+    UINT random = 17;
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+
+        PointCloud pointCloud;
+        if ( !pointCloud.Initialize( resolutions[r] ) )
+        {
+            printf( "    out of memory\n" );
+            return;
+        }
+
+        USHORT * pDepth = new USHORT[width * height];
+        float * pPoints = new float[3 * width * height];
+        MakeDepth( pDepth, width * height, random );
+
+        double tableTimes[cPasses];
+        double playerTimes[cPasses];
+        double pixelTimes[cPasses];
+        for ( UINT pass = 0; pass < cPasses; ++pass )
+        {
+            double start = TestSeconds( );
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                pointCloud.Generate( pDepth, false );
+            }
+            double table = TestSeconds( );
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                pointCloud.Generate( pDepth, true );
+            }
+            double player = TestSeconds( );
+            for ( UINT i = 0; i < cFrames / 10; ++i )
+            {
+                for ( UINT y = 0; y < height; ++y )
+                {
+                    for ( UINT x = 0; x < width; ++x )
+                    {
+                        TransformPixel( x, y, pDepth[y * width + x], width, height, pPoints + 3 * (y * width + x) );
+                    }
+                }
+            }
+            double pixel = TestSeconds( );
+
+            tableTimes[pass] = (table - start) / cFrames;
+            playerTimes[pass] = (player - table) / cFrames;
+            pixelTimes[pass] = (pixel - player) / (cFrames / 10);
+        }
+
+        double table = TestMedian( tableTimes, cPasses );
+        printf( "    %ux%u: %.3f ms a frame, %.3f ms with the player index, %.3f ms transforming each pixel, %.0f million points a second\n",
+            width, height, table * 1000.0, TestMedian( playerTimes, cPasses ) * 1000.0, TestMedian( pixelTimes, cPasses ) * 1000.0,
+            width * height / table / 1000000.0 );
+
+        delete [] pPoints;
+        delete [] pDepth;
+    }
+}
@@ -0,0 +1,248 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="RegistrationMapTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Depth frames mapped to color through the cached tables, against a stand-in
+// calibration asked pixel by pixel, and what mapping a frame costs
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "RegistrationMap.h"
+
+// A color camera at twice the depth resolution, 25 mm to the side, with a
+// little barrel distortion
+class StandInCalibration : public IRegistrationCalibration
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    StandInCalibration() :
+        m_cCalls(0),
+        m_bFail(false)
+    {
+    }
+
+    HRESULT GetColorPixelCoordinates( NUI_IMAGE_RESOLUTION colorResolution, NUI_IMAGE_RESOLUTION depthResolution,
+        LONG depthX, LONG depthY, USHORT packedDepth, LONG * pColorX, LONG * pColorY )
+    {
+        ++m_cCalls;
+        if ( m_bFail )
+        {
+            return E_FAIL;
+        }
+
+        DWORD depthWidth, depthHeight, colorWidth, colorHeight;
+        NuiImageResolutionToSize( depthResolution, depthWidth, depthHeight );
+        NuiImageResolutionToSize( colorResolution, colorWidth, colorHeight );
+
+        float scale = static_cast<float>(colorWidth) / depthWidth;
+        float dx = depthX - depthWidth / 2.0f;
+        float dy = depthY - depthHeight / 2.0f;
+        float distortion = 1.0f + 0.05f * (dx * dx + dy * dy) / (depthWidth * depthWidth);
+
+        // 25 mm at a focal length of 525 color pixels at 640x480
+        float depth = max( static_cast<float>(packedDepth >> NUI_IMAGE_PLAYER_INDEX_SHIFT), 1.0f );
+        float parallax = 25.0f * 525.0f * colorWidth / 640.0f / depth;
+
+        *pColorX = static_cast<LONG>(floor( colorWidth / 2.0f + dx * scale * distortion + parallax + 0.5f ));
+        *pColorY = static_cast<LONG>(floor( colorHeight / 2.0f + dy * scale * distortion + 0.5f ));
+
+        return S_OK;
+    }
+
+    UINT    m_cCalls;
+    bool    m_bFail;
+};
+
+/// <summary>
+/// Fill a frame with depth from 0.8 to 4 m in patches, and a hole every 11 pixels
+/// </summary>
+/// <param name="pDepth">receives packed depth, width * height pixels</param>
+/// <param name="width">width of the frame</param>
+/// <param name="height">height of the frame</param>
+/// <param name="random">state of the depth sequence</param>
+static void MakeDepth( USHORT * pDepth, DWORD width, DWORD height, UINT & random )
+{
+    for ( DWORD y = 0; y < height; ++y )
+    {
+        for ( DWORD x = 0; x < width; ++x )
+        {
+            DWORD i = y * width + x;
+            USHORT depth = static_cast<USHORT>(800 + ((x / 16 + y / 16) * 397 + TestRandom( random ) % 64) % 3200);
+            pDepth[i] = ( 0 == i % 11 ) ? 0 : static_cast<USHORT>(depth << NUI_IMAGE_PLAYER_INDEX_SHIFT);
+        }
+    }
+}
+
+/// <summary>
+/// Coordinates mapped through the tables land within two color pixels of
+/// those the calibration gives for each pixel, at 320x240 and 640x480; the
+/// tables are only built again for new resolutions or once invalidated, and a
+/// calibration that fails leaves nothing to map with
+/// </summary>
+void TestRegistrationMap( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+
+    StandInCalibration calibration;
+    RegistrationMap registration;
+    TEST_CHECK( 0 == registration.GetTableSize( ) );
+    TEST_CHECK( !registration.Update( calibration, NUI_IMAGE_RESOLUTION_INVALID, NUI_IMAGE_RESOLUTION_640x480 ) );
+
+    UINT random = 19;
+    BYTE * pColor = new BYTE[640 * 480 * 4];
+    for ( UINT i = 0; i < 640 * 480 * 4; ++i )
+    {
+        pColor[i] = static_cast<BYTE>(TestRandom( random ));
+    }
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+
+        calibration.m_cCalls = 0;
+        TEST_CHECK( registration.Update( calibration, resolutions[r], NUI_IMAGE_RESOLUTION_640x480 ) );
+        TEST_CHECK( calibration.m_cCalls > 0 );
+        TEST_CHECK( registration.GetTableSize( ) > 0 && registration.GetTableSize( ) < width * height * 8 );
+
+        // Cached until invalidated
+        UINT cBuildCalls = calibration.m_cCalls;
+        TEST_CHECK( registration.Update( calibration, resolutions[r], NUI_IMAGE_RESOLUTION_640x480 ) );
+        TEST_CHECK( cBuildCalls == calibration.m_cCalls );
+        registration.Invalidate( );
+        TEST_CHECK( registration.Update( calibration, resolutions[r], NUI_IMAGE_RESOLUTION_640x480 ) );
+        TEST_CHECK( 2 * cBuildCalls == calibration.m_cCalls );
+
+        USHORT * pDepth = new USHORT[width * height];
+        MakeDepth( pDepth, width, height, random );
+        registration.MapFrame( pDepth );
+        registration.RegisterColor( pColor );
+
+        const LONG * pCoordinates = registration.GetColorCoordinates( );
+        const DWORD * pRegistered = reinterpret_cast<const DWORD *>(registration.GetRegisteredColor( ));
+        LONG maxError = 0;
+        UINT cWrongHoles = 0;
+        UINT cWrongColors = 0;
+
+        for ( DWORD y = 0; y < height; ++y )
+        {
+            for ( DWORD x = 0; x < width; ++x )
+            {
+                DWORD i = y * width + x;
+                LONG colorX = pCoordinates[2 * i];
+                LONG colorY = pCoordinates[2 * i + 1];
+
+                if ( 0 == pDepth[i] )
+                {
+                    cWrongHoles += ( -1 == colorX && -1 == colorY && 0 == pRegistered[i] ) ? 0 : 1;
+                    continue;
+                }
+
+                // A failed call leaves them off the color image, so the check below catches it
+                LONG expectedX = -1, expectedY = -1;
+                calibration.GetColorPixelCoordinates( NUI_IMAGE_RESOLUTION_640x480, resolutions[r], x, y, pDepth[i], &expectedX, &expectedY );
+                maxError = max( maxError, max( labs( colorX - expectedX ), labs( colorY - expectedY ) ) );
+
+                DWORD expectedColor = ( colorX >= 0 && colorX < 640 && colorY >= 0 && colorY < 480 ) ?
+                    reinterpret_cast<const DWORD *>(pColor)[colorY * 640 + colorX] : 0;
+                cWrongColors += ( expectedColor == pRegistered[i] ) ? 0 : 1;
+            }
+        }
+
+        TEST_CHECK( maxError <= 2 );
+        TEST_CHECK( 0 == cWrongHoles );
+        TEST_CHECK( 0 == cWrongColors );
+
+        delete [] pDepth;
+    }
+
+    // A calibration that can't be read leaves no table, and the next Update tries again
+    registration.Invalidate( );
+    calibration.m_bFail = true;
+    TEST_CHECK( !registration.Update( calibration, NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 ) );
+    TEST_CHECK( 0 == registration.GetTableSize( ) && NULL == registration.GetColorCoordinates( ) );
+    calibration.m_bFail = false;
+    TEST_CHECK( registration.Update( calibration, NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 ) );
+
+    delete [] pColor;
+}
+
+/// <summary>
+/// Time building the tables, mapping a frame and registering color through
+/// them, against asking the calibration for each pixel, and report their size
+/// </summary>
+void BenchRegistrationMap( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    static const UINT cPasses = 7;
+    static const UINT cFrames = 50;
+
+    UINT random = 23;
+    BYTE * pColor = new BYTE[640 * 480 * 4];
+    ZeroMemory( pColor, 640 * 480 * 4 );
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        DWORD width, height;
+        NuiImageResolutionToSize( resolutions[r], width, height );
+
+        StandInCalibration calibration;
+        RegistrationMap registration;
+
+        double start = TestSeconds( );
+        if ( !registration.Update( calibration, resolutions[r], NUI_IMAGE_RESOLUTION_640x480 ) )
+        {
+            printf( "    out of memory\n" );
+            break;
+        }
+        double build = TestSeconds( ) - start;
+
+        USHORT * pDepth = new USHORT[width * height];
+        LONG * pCoordinates = new LONG[2 * width * height];
+        MakeDepth( pDepth, width, height, random );
+
+        double mapTimes[cPasses];
+        double colorTimes[cPasses];
+        double pixelTimes[cPasses];
+        for ( UINT pass = 0; pass < cPasses; ++pass )
+        {
+            start = TestSeconds( );
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                registration.MapFrame( pDepth );
+            }
+            double mapped = TestSeconds( );
+            for ( UINT i = 0; i < cFrames; ++i )
+            {
+                registration.RegisterColor( pColor );
+            }
+            double registered = TestSeconds( );
+
+            // What each frame would cost asking for every pixel, through a virtual call as the sensor is reached
+            IRegistrationCalibration & perPixel = calibration;
+            for ( DWORD i = 0; i < width * height; ++i )
+            {
+                perPixel.GetColorPixelCoordinates( NUI_IMAGE_RESOLUTION_640x480, resolutions[r], i % width, i / width, pDepth[i],
+                    pCoordinates + 2 * i, pCoordinates + 2 * i + 1 );
+            }
+            double pixel = TestSeconds( );
+
+            mapTimes[pass] = (mapped - start) / cFrames;
+            colorTimes[pass] = (registered - mapped) / cFrames;
+            pixelTimes[pass] = pixel - registered;
+        }
+
+        printf( "    %ux%u: %u KB of tables built in %.1f ms, %.3f ms to map a frame, %.3f ms to register color, %.3f ms asking for each pixel\n",
+            width, height, registration.GetTableSize( ) / 1024, build * 1000.0, TestMedian( mapTimes, cPasses ) * 1000.0,
+            TestMedian( colorTimes, cPasses ) * 1000.0, TestMedian( pixelTimes, cPasses ) * 1000.0 );
+
+        delete [] pCoordinates;
+        delete [] pDepth;
+    }
+
+    delete [] pColor;
+}
@@ -0,0 +1,300 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SensorConnectionTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// A stand-in sensor unplugged and plugged back in under a running pipeline
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "SensorConnection.h"
+
+// Error string the stand-in reports when its streams fail to open
+static const UINT g_OpenErrorId = 1234;
+
+// A sensor that sends a frame every couple of milliseconds while it is
+// plugged in and its streams are open
+class StandInSensor : public ISensorDevice
+{
+public:
+    /// <summary>
+    /// Constructor, starts sending frames once plugged in
+    /// </summary>
+    StandInSensor() :
+        m_bPlugged(FALSE),
+        m_bHeld(false),
+        m_bOpen(false),
+        m_bFailOpen(false),
+        m_cAcquires(0),
+        m_cOpens(0),
+        m_bStop(FALSE)
+    {
+        m_hFrame = CreateEvent( NULL, FALSE, FALSE, NULL );
+        m_hThread = CreateThread( NULL, 0, SendThread, this, 0, NULL );
+    }
+
+    /// <summary>
+    /// Destructor, stops sending frames
+    /// </summary>
+    ~StandInSensor()
+    {
+        InterlockedExchange( &m_bStop, TRUE );
+        WaitForSingleObject( m_hThread, INFINITE );
+        CloseHandle( m_hThread );
+        CloseHandle( m_hFrame );
+    }
+
+    // ISensorDevice, only the sensor named "StandIn" is found, and only while plugged in
+    HRESULT AcquireSensor( const WCHAR * instanceName )
+    {
+        if ( !m_bPlugged || 0 != wcscmp( instanceName, L"StandIn" ) )
+        {
+            return E_FAIL;
+        }
+
+        m_bHeld = true;
+        ++m_cAcquires;
+        return S_OK;
+    }
+
+    HRESULT OpenSensorStreams( UINT & errorId )
+    {
+        // The USB round trips of opening streams
+        Sleep( 10 );
+
+        if ( m_bFailOpen )
+        {
+            errorId = g_OpenErrorId;
+            return E_FAIL;
+        }
+
+        m_bOpen = true;
+        ++m_cOpens;
+        return S_OK;
+    }
+
+    void ReleaseSensor( )
+    {
+        m_bOpen = false;
+        m_bHeld = false;
+    }
+
+    /// <summary>
+    /// Take the frame signalled, as the processing thread does with the sensor lock held
+    /// </summary>
+    /// <returns>true if the streams gave a frame, false otherwise</returns>
+    bool TakeFrame( )
+    {
+        return m_bOpen && m_bPlugged;
+    }
+
+    HANDLE          m_hFrame;
+    volatile LONG   m_bPlugged;
+
+    // Guarded by the sensor lock
+    bool            m_bHeld;
+    bool            m_bOpen;
+    bool            m_bFailOpen;
+    UINT            m_cAcquires;
+    UINT            m_cOpens;
+
+private:
+    /// <summary>
+    /// Thread to signal frames while plugged in
+    /// </summary>
+    /// <param name="pParam">StandInSensor to send frames of</param>
+    /// <returns>always 0</returns>
+    static DWORD WINAPI SendThread( LPVOID pParam )
+    {
+        StandInSensor * pThis = static_cast<StandInSensor *>(pParam);
+        while ( !pThis->m_bStop )
+        {
+            if ( pThis->m_bPlugged )
+            {
+                SetEvent( pThis->m_hFrame );
+            }
+            Sleep( 2 );
+        }
+
+        return 0;
+    }
+
+    HANDLE          m_hThread;
+    volatile LONG   m_bStop;
+};
+
+// The processing thread of a pipeline, started once and kept across reconnects
+struct TEST_PIPELINE
+{
+    StandInSensor *     pSensor;
+    SensorConnection *  pConnection;
+    CRITICAL_SECTION *  pcsSensor;
+    HANDLE              hStop;
+    volatile LONG       cFrames;
+    DWORD               reconnectTime;      // last time-to-first-frame reported
+};
+
+/// <summary>
+/// Take frames as they are signalled, until told to stop
+/// </summary>
+/// <param name="pParam">TEST_PIPELINE to run</param>
+/// <returns>always 0</returns>
+static DWORD WINAPI ProcessThread( LPVOID pParam )
+{
+    TEST_PIPELINE * pPipeline = static_cast<TEST_PIPELINE *>(pParam);
+    HANDLE hEvents[2] = { pPipeline->hStop, pPipeline->pSensor->m_hFrame };
+
+    while ( WAIT_OBJECT_0 != WaitForMultipleObjects( 2, hEvents, FALSE, 100 ) )
+    {
+        EnterCriticalSection( pPipeline->pcsSensor );
+
+        if ( pPipeline->pSensor->TakeFrame( ) )
+        {
+            InterlockedIncrement( &pPipeline->cFrames );
+
+            DWORD milliseconds;
+            if ( pPipeline->pConnection->FrameTaken( milliseconds ) )
+            {
+                pPipeline->reconnectTime = milliseconds;
+            }
+        }
+
+        LeaveCriticalSection( pPipeline->pcsSensor );
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Wait for the pipeline to take more frames, and for any reconnect to be completed by one
+/// </summary>
+/// <param name="pipeline">pipeline taking frames</param>
+/// <param name="cFrames">frames taken so far</param>
+/// <param name="cReconnects">reconnects to wait for</param>
+/// <returns>true if they were taken within two seconds, false otherwise</returns>
+static bool WaitForFrames( TEST_PIPELINE & pipeline, LONG cFrames, UINT cReconnects )
+{
+    for ( UINT waited = 0; waited < 2000; ++waited )
+    {
+        if ( pipeline.cFrames >= cFrames + 5 && pipeline.pConnection->GetReconnectCount( ) >= cReconnects )
+        {
+            return true;
+        }
+
+        Sleep( 1 );
+    }
+
+    return false;
+}
+
+/// <summary>
+/// A sensor unplugged and plugged back in many times under a running pipeline
+/// gives frames again after every reconnect, and none while it's away; each
+/// reconnect reports its time to the first frame once, and failures while the
+/// sensor is away or its streams won't open leave it released
+/// </summary>
+void TestSensorConnection( )
+{
+    static const UINT cCycles = 20;
+
+    CRITICAL_SECTION csSensor;
+    InitializeCriticalSection( &csSensor );
+
+    StandInSensor * pSensor = new StandInSensor( );
+    SensorConnection * pConnection = new SensorConnection( *pSensor, csSensor );
+
+    TEST_PIPELINE pipeline;
+    pipeline.pSensor = pSensor;
+    pipeline.pConnection = pConnection;
+    pipeline.pcsSensor = &csSensor;
+    pipeline.hStop = CreateEvent( NULL, TRUE, FALSE, NULL );
+    pipeline.cFrames = 0;
+    pipeline.reconnectTime = MAXDWORD;
+    HANDLE hThread = CreateThread( NULL, 0, ProcessThread, &pipeline, 0, NULL );
+
+    UINT errorId = 1;
+    TEST_CHECK( FAILED(pConnection->Reconnect( L"StandIn", errorId )) && 0 == errorId );
+
+    InterlockedExchange( &pSensor->m_bPlugged, TRUE );
+    TEST_CHECK( FAILED(pConnection->Reconnect( L"Other", errorId )) && 0 == errorId );
+    TEST_CHECK( SUCCEEDED(pConnection->Reconnect( L"StandIn", errorId )) );
+    TEST_CHECK( WaitForFrames( pipeline, 0, 1 ) );
+
+    UINT cMissing = 0;
+    UINT cWhileAway = 0;
+    UINT cStillHeld = 0;
+    UINT cUnreported = 0;
+    UINT cSlow = 0;
+
+    for ( UINT cycle = 0; cycle < cCycles; ++cycle )
+    {
+        // Unplugged, with the status callback telling us a little later, maybe twice
+        InterlockedExchange( &pSensor->m_bPlugged, FALSE );
+        Sleep( 1 );
+        pConnection->Disconnect( );
+        if ( 0 == cycle % 2 )
+        {
+            pConnection->Disconnect( );
+        }
+
+        LONG cFrames = pipeline.cFrames;
+        Sleep( 10 );
+        cWhileAway += ( cFrames == pipeline.cFrames ) ? 0 : 1;
+        cStillHeld += pSensor->m_bHeld ? 1 : 0;
+
+        // Not back yet
+        errorId = 1;
+        cStillHeld += ( FAILED(pConnection->Reconnect( L"StandIn", errorId )) && 0 == errorId && !pSensor->m_bHeld ) ? 0 : 1;
+
+        InterlockedExchange( &pSensor->m_bPlugged, TRUE );
+        pipeline.reconnectTime = MAXDWORD;
+        if ( FAILED(pConnection->Reconnect( L"StandIn", errorId )) || !WaitForFrames( pipeline, cFrames, 2 + cycle ) )
+        {
+            ++cMissing;
+            continue;
+        }
+
+        cUnreported += ( MAXDWORD != pipeline.reconnectTime ) ? 0 : 1;
+        cSlow += ( pipeline.reconnectTime < 1000 ) ? 0 : 1;
+    }
+
+    TEST_CHECK( 0 == cMissing );
+    TEST_CHECK( 0 == cWhileAway );
+    TEST_CHECK( 0 == cStillHeld );
+    TEST_CHECK( 0 == cUnreported );
+    TEST_CHECK( 0 == cSlow );
+    TEST_CHECK( 1 + cCycles == pConnection->GetReconnectCount( ) );
+    TEST_CHECK( 1 + cCycles == pSensor->m_cAcquires && 1 + cCycles == pSensor->m_cOpens );
+
+    // Streams that won't open are reported, and leave the sensor released for the next try
+    InterlockedExchange( &pSensor->m_bPlugged, FALSE );
+    pConnection->Disconnect( );
+    InterlockedExchange( &pSensor->m_bPlugged, TRUE );
+
+    EnterCriticalSection( &csSensor );
+    pSensor->m_bFailOpen = true;
+    LeaveCriticalSection( &csSensor );
+
+    LONG cFrames = pipeline.cFrames;
+    TEST_CHECK( FAILED(pConnection->Reconnect( L"StandIn", errorId )) && g_OpenErrorId == errorId );
+    TEST_CHECK( !pSensor->m_bHeld );
+    Sleep( 10 );
+    TEST_CHECK( cFrames == pipeline.cFrames );
+
+    EnterCriticalSection( &csSensor );
+    pSensor->m_bFailOpen = false;
+    LeaveCriticalSection( &csSensor );
+
+    TEST_CHECK( SUCCEEDED(pConnection->Reconnect( L"StandIn", errorId )) );
+    TEST_CHECK( WaitForFrames( pipeline, cFrames, 2 + cCycles ) );
+
+    SetEvent( pipeline.hStop );
+    WaitForSingleObject( hThread, INFINITE );
+    CloseHandle( hThread );
+    CloseHandle( pipeline.hStop );
+
+    delete pConnection;
+    delete pSensor;
+    DeleteCriticalSection( &csSensor );
+}
@@ -0,0 +1,214 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletalFramesTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// SkeletalFrames.dll used as a binding would use it, on the stand-in source
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "NuiApi.h"
+#include "DepthKernel.h"
+#include "SkeletonPublisher.h"
+#include "SkeletalFrames.h"
+#include <stddef.h>
+
+// What each stream of the stand-in hands out, as SkeletalFrames.h describes it
+struct SVF_EXPECTED_FORMAT
+{
+    DWORD   dwStream;
+    DWORD   dwFormat;
+    DWORD   dwWidth;
+    DWORD   dwHeight;
+    DWORD   dwBytesPerPixel;
+};
+
+static const SVF_EXPECTED_FORMAT g_ExpectedFormats[] =
+{
+    { SVF_STREAM_DEPTH,     SVF_FORMAT_DEPTH16,         320, 240, sizeof(USHORT) },
+    { SVF_STREAM_COLOR,     SVF_FORMAT_BGRX32,          640, 480, 4 },
+    { SVF_STREAM_SKELETON,  SVF_FORMAT_SKELETON_FRAME,  1,   1,   sizeof(NUI_SKELETON_FRAME) },
+};
+
+// A caller built against a later version, with a field this one doesn't know
+struct SVF_FRAME_INFO_LATER
+{
+    SVF_FRAME_INFO  info;
+    DWORD           dwLaterField;
+};
+
+/// <summary>
+/// Frames of every stream of the stand-in are described as SkeletalFrames.h
+/// says, hold what they claim to, and stay valid after their source is closed.
+/// Depth is colorized and skeletons are published as the viewer does it.  Bad
+/// arguments, short info structs and empty streams are refused
+/// </summary>
+void TestSkeletalFrames( )
+{
+    TEST_CHECK( SVF_VERSION == SvfGetVersion( ) );
+
+    SVF_SOURCE * pSource = NULL;
+    TEST_CHECK( E_INVALIDARG == SvfOpenStandIn( 0, &pSource ) );
+    TEST_CHECK( E_INVALIDARG == SvfOpenStandIn( SVF_STREAM_FLAG_ALL + 1, &pSource ) );
+    TEST_CHECK( E_INVALIDARG == SvfOpenStandIn( SVF_STREAM_FLAG_ALL, NULL ) );
+
+    HRESULT hr = SvfOpenStandIn( SVF_STREAM_FLAG_ALL, &pSource );
+    TEST_CHECK( SUCCEEDED(hr) && NULL != pSource );
+    if ( FAILED(hr) )
+    {
+        return;
+    }
+
+    // Published from the next skeleton frame on
+    TEST_CHECK( S_OK == SvfPublishSkeletons( pSource, 0 ) );
+
+    SVF_FRAME * pHeld = NULL;
+    USHORT heldPixel = 0;
+
+    for ( UINT i = 0; i < _countof(g_ExpectedFormats); ++i )
+    {
+        const SVF_EXPECTED_FORMAT & expected = g_ExpectedFormats[i];
+
+        SVF_FRAME * pFrame = NULL;
+        hr = SvfWaitFrame( pSource, expected.dwStream, 1000, &pFrame );
+        TEST_CHECK( SUCCEEDED(hr) && NULL != pFrame );
+        if ( FAILED(hr) )
+        {
+            continue;
+        }
+
+        SVF_FRAME_INFO info;
+        info.cbSize = sizeof(info);
+        TEST_CHECK( S_OK == SvfGetFrameInfo( pFrame, &info ) );
+        TEST_CHECK( sizeof(info) == info.cbSize );
+        TEST_CHECK( expected.dwStream == info.dwStream );
+        TEST_CHECK( expected.dwFormat == info.dwFormat );
+        TEST_CHECK( expected.dwWidth == info.dwWidth && expected.dwHeight == info.dwHeight );
+        TEST_CHECK( expected.dwBytesPerPixel == info.dwBytesPerPixel );
+        TEST_CHECK( info.dwWidth * info.dwBytesPerPixel == info.dwStride );
+        TEST_CHECK( info.dwStride * info.dwHeight == info.cbData );
+        TEST_CHECK( NULL != info.pData );
+
+        if ( SVF_STREAM_DEPTH == expected.dwStream )
+        {
+            // The player or the wall behind them fills the middle of the view
+            const USHORT * pRow = reinterpret_cast<const USHORT *>(static_cast<const BYTE *>(info.pData) + (info.dwHeight / 2) * info.dwStride);
+            USHORT depth = pRow[info.dwWidth / 2] >> NUI_IMAGE_PLAYER_INDEX_SHIFT;
+            TEST_CHECK( depth >= 2000 && depth <= 4000 );
+
+            // A caller of a later version gets these fields and the rest zeroed; too short a struct is refused
+            SVF_FRAME_INFO_LATER later;
+            FillMemory( &later, sizeof(later), 0xCC );
+            later.info.cbSize = sizeof(later);
+            TEST_CHECK( S_OK == SvfGetFrameInfo( pFrame, &later.info ) );
+            TEST_CHECK( sizeof(later) == later.info.cbSize && 0 == later.dwLaterField );
+            TEST_CHECK( info.dwFrameNumber == later.info.dwFrameNumber && info.pData == later.info.pData );
+
+            // Colorized as the viewer's own kernel colorizes it
+            DWORD cbBGRX = info.dwWidth * info.dwHeight * 4;
+            BYTE * pBGRX = new BYTE[cbBGRX];
+            BYTE * pExpected = new BYTE[cbBGRX];
+            TEST_CHECK( E_INVALIDARG == SvfColorizeDepth( pFrame, pBGRX, cbBGRX - 1 ) );
+            TEST_CHECK( S_OK == SvfColorizeDepth( pFrame, pBGRX, cbBGRX ) );
+
+            DepthKernel kernel;
+            DEPTH_KERNEL_TARGETS targets;
+            ZeroMemory( &targets, sizeof(targets) );
+            targets.pRGBX = pExpected;
+            TEST_CHECK( kernel.Select( NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, NUI_IMAGE_RESOLUTION_320x240 ) );
+            kernel.Run( DEPTH_KERNEL_COLORIZE, static_cast<const USHORT *>(info.pData), targets );
+            TEST_CHECK( 0 == memcmp( pBGRX, pExpected, cbBGRX ) );
+
+            // The player in the middle is tinted, so isn't gray
+            const BYTE * pCenter = pBGRX + ((info.dwHeight / 2) * info.dwWidth + info.dwWidth / 2) * 4;
+            TEST_CHECK( 0 != (pRow[info.dwWidth / 2] & NUI_IMAGE_PLAYER_INDEX_MASK) && (pCenter[0] != pCenter[1] || pCenter[1] != pCenter[2]) );
+            delete [] pBGRX;
+            delete [] pExpected;
+
+            info.cbSize = offsetof(SVF_FRAME_INFO, cbData);
+            TEST_CHECK( E_INVALIDARG == SvfGetFrameInfo( pFrame, &info ) );
+
+            // Kept past the close of the source
+            SvfAddRefFrame( pFrame );
+            pHeld = pFrame;
+            heldPixel = pRow[info.dwWidth / 2];
+
+            // The next frame follows it
+            SVF_FRAME * pNext = NULL;
+            hr = SvfWaitFrame( pSource, SVF_STREAM_DEPTH, 1000, &pNext );
+            TEST_CHECK( SUCCEEDED(hr) );
+            if ( SUCCEEDED(hr) )
+            {
+                SVF_FRAME_INFO nextInfo;
+                nextInfo.cbSize = sizeof(nextInfo);
+                TEST_CHECK( S_OK == SvfGetFrameInfo( pNext, &nextInfo ) );
+                TEST_CHECK( nextInfo.dwFrameNumber > later.info.dwFrameNumber && nextInfo.liTimeStamp > later.info.liTimeStamp );
+                TEST_CHECK( nextInfo.pData != later.info.pData );
+                SvfReleaseFrame( pNext );
+            }
+        }
+        else if ( SVF_STREAM_SKELETON == expected.dwStream )
+        {
+            const NUI_SKELETON_FRAME * pSkeletons = static_cast<const NUI_SKELETON_FRAME *>(info.pData);
+            TEST_CHECK( NUI_SKELETON_TRACKED == pSkeletons->SkeletonData[0].eTrackingState );
+
+            BYTE pixel[4];
+            TEST_CHECK( E_INVALIDARG == SvfColorizeDepth( pFrame, pixel, sizeof(pixel) ) );
+
+            // Other processes see the player too
+            SkeletonSubscriber subscriber;
+            SKELETON_PUBLISH_FRAME published;
+            bool bRead = false;
+            if ( SUCCEEDED(subscriber.Open( )) )
+            {
+                for ( int wait = 0; wait < 100 && !bRead; ++wait )
+                {
+                    bRead = subscriber.ReadLatest( &published );
+                    if ( !bRead )
+                    {
+                        Sleep( 10 );
+                    }
+                }
+            }
+            TEST_CHECK( bRead && 1 == published.cBodies && NUI_SKELETON_TRACKED == published.Bodies[0].eTrackingState );
+        }
+
+        SvfReleaseFrame( pFrame );
+    }
+
+    SVF_FRAME * pNone = NULL;
+    TEST_CHECK( E_INVALIDARG == SvfWaitFrame( pSource, SVF_STREAM_COUNT, 0, &pNone ) && NULL == pNone );
+
+    SvfCloseSource( pSource );
+
+    // The held frame still holds what it did, and releasing it lets the closed source go
+    if ( pHeld )
+    {
+        SVF_FRAME_INFO info;
+        info.cbSize = sizeof(info);
+        TEST_CHECK( S_OK == SvfGetFrameInfo( pHeld, &info ) );
+        const USHORT * pRow = reinterpret_cast<const USHORT *>(static_cast<const BYTE *>(info.pData) + (info.dwHeight / 2) * info.dwStride);
+        TEST_CHECK( heldPixel == pRow[info.dwWidth / 2] );
+        SvfReleaseFrame( pHeld );
+    }
+
+    // A source of only some streams refuses the others
+    hr = SvfOpenStandIn( SVF_STREAM_FLAG_SKELETON, &pSource );
+    TEST_CHECK( SUCCEEDED(hr) );
+    if ( SUCCEEDED(hr) )
+    {
+        SVF_FRAME * pFrame = NULL;
+        TEST_CHECK( E_INVALIDARG == SvfWaitFrame( pSource, SVF_STREAM_DEPTH, 0, &pFrame ) && NULL == pFrame );
+        SvfCloseSource( pSource );
+    }
+
+    // and skeletons can only be published from a source of them
+    hr = SvfOpenStandIn( SVF_STREAM_FLAG_DEPTH, &pSource );
+    TEST_CHECK( SUCCEEDED(hr) );
+    if ( SUCCEEDED(hr) )
+    {
+        TEST_CHECK( E_INVALIDARG == SvfPublishSkeletons( pSource, 0 ) );
+        SvfCloseSource( pSource );
+    }
+}
@@ -0,0 +1,404 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonPublisherTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Skeletons published to shared memory and UDP, as a subscriber and a
+// datagram listener see them, and the time they take to get there
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "SkeletonPublisher.h"
+
+// Frames the benchmark publishes, a millisecond apart
+static const UINT g_LatencyFrames = 500;
+
+// Milliseconds to wait for a datagram
+static const long g_DatagramTimeout = 1000;
+
+/// <summary>
+/// Make a skeleton frame with a tracked and a position-only skeleton, and one
+/// not tracked that must not be published.  Joint j of the skeleton with
+/// tracking ID t is at (t, j, frameNumber)
+/// </summary>
+/// <param name="frameNumber">frame number</param>
+/// <param name="frame">receives the frame</param>
+static void MakeSkeletonFrame( DWORD frameNumber, NUI_SKELETON_FRAME & frame )
+{
+    static const NUI_SKELETON_TRACKING_STATE states[] = { NUI_SKELETON_NOT_TRACKED, NUI_SKELETON_TRACKED, NUI_SKELETON_NOT_TRACKED, NUI_SKELETON_POSITION_ONLY };
+
+    ZeroMemory( &frame, sizeof(frame) );
+    frame.dwFrameNumber = frameNumber;
+    frame.liTimeStamp.QuadPart = 33 * frameNumber;
+
+    for ( UINT i = 0; i < _countof(states); ++i )
+    {
+        NUI_SKELETON_DATA & skel = frame.SkeletonData[i];
+        skel.eTrackingState = states[i];
+        skel.dwTrackingID = 10 + i;
+        skel.Position.x = static_cast<float>(skel.dwTrackingID);
+
+        for ( int j = 0; j < NUI_SKELETON_POSITION_COUNT; ++j )
+        {
+            skel.SkeletonPositions[j].x = static_cast<float>(skel.dwTrackingID);
+            skel.SkeletonPositions[j].y = static_cast<float>(j);
+            skel.SkeletonPositions[j].z = static_cast<float>(frameNumber);
+            skel.eSkeletonPositionTrackingState[j] = NUI_SKELETON_POSITION_TRACKED;
+        }
+    }
+}
+
+/// <summary>
+/// Whether a published joint is where MakeSkeletonFrame put it
+/// </summary>
+/// <param name="body">published skeleton</param>
+/// <param name="joint">NUI_SKELETON_POSITION_INDEX of the joint</param>
+/// <param name="frameNumber">frame number the skeleton was made for</param>
+/// <returns>true if the joint is as made, false otherwise</returns>
+static bool IsJointAsMade( const SKELETON_PUBLISH_BODY & body, int joint, DWORD frameNumber )
+{
+    return body.Joints[joint][0] == static_cast<float>(body.dwTrackingID) &&
+           body.Joints[joint][1] == static_cast<float>(joint) &&
+           body.Joints[joint][2] == static_cast<float>(frameNumber) &&
+           NUI_SKELETON_POSITION_TRACKED == body.JointStates[joint];
+}
+
+/// <summary>
+/// Open a UDP socket on a free localhost port
+/// </summary>
+/// <param name="port">receives the port</param>
+/// <returns>socket, INVALID_SOCKET if it couldn't be opened</returns>
+static SOCKET OpenListener( USHORT & port )
+{
+    SOCKET listener = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    if ( INVALID_SOCKET == listener )
+    {
+        return INVALID_SOCKET;
+    }
+
+    sockaddr_in address;
+    ZeroMemory( &address, sizeof(address) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    int cbAddress = sizeof(address);
+    if ( SOCKET_ERROR == bind( listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address) ) ||
+         SOCKET_ERROR == getsockname( listener, reinterpret_cast<sockaddr *>(&address), &cbAddress ) )
+    {
+        closesocket( listener );
+        return INVALID_SOCKET;
+    }
+
+    port = ntohs( address.sin_port );
+    return listener;
+}
+
+/// <summary>
+/// Wait for a datagram
+/// </summary>
+/// <param name="listener">socket to receive on</param>
+/// <param name="pDatagram">receives the datagram</param>
+/// <param name="cbDatagram">size (in bytes) of pDatagram</param>
+/// <returns>size (in bytes) of the datagram, 0 if none came in time</returns>
+static int ReceiveDatagram( SOCKET listener, BYTE * pDatagram, int cbDatagram )
+{
+    fd_set readable;
+    FD_ZERO( &readable );
+    FD_SET( listener, &readable );
+
+    timeval timeout = { g_DatagramTimeout / 1000, (g_DatagramTimeout % 1000) * 1000 };
+    if ( 1 != select( static_cast<int>(listener) + 1, &readable, NULL, NULL, &timeout ) )
+    {
+        return 0;
+    }
+
+    int cbReceived = recv( listener, reinterpret_cast<char *>(pDatagram), cbDatagram, 0 );
+    return ( cbReceived > 0 ) ? cbReceived : 0;
+}
+
+/// <summary>
+/// A subscriber reads each published frame once, with only the tracked and
+/// position-only skeletons, and only the skeleton and joints it filters for
+/// </summary>
+void TestSkeletonPublisherSharedMemory( )
+{
+    SkeletonPublisher publisher;
+    TEST_CHECK( SUCCEEDED( publisher.Initialize( ) ) );
+
+    SkeletonSubscriber subscriber;
+    TEST_CHECK( SUCCEEDED( subscriber.Open( ) ) );
+
+    SKELETON_PUBLISH_FRAME * pRead = new SKELETON_PUBLISH_FRAME;
+    NUI_SKELETON_FRAME frame;
+
+    // Nothing published yet
+    TEST_CHECK( !subscriber.ReadLatest( pRead ) );
+
+    MakeSkeletonFrame( 1, frame );
+    publisher.Publish( frame );
+
+    TEST_CHECK( subscriber.ReadLatest( pRead ) );
+    TEST_CHECK( 1 == pRead->dwFrameNumber && 33 == pRead->liTimeStamp );
+    TEST_CHECK( 2 == pRead->cBodies );
+    TEST_CHECK( 11 == pRead->Bodies[0].dwTrackingID && NUI_SKELETON_TRACKED == pRead->Bodies[0].eTrackingState );
+    TEST_CHECK( 13 == pRead->Bodies[1].dwTrackingID && NUI_SKELETON_POSITION_ONLY == pRead->Bodies[1].eTrackingState );
+    TEST_CHECK( IsJointAsMade( pRead->Bodies[1], NUI_SKELETON_POSITION_FOOT_RIGHT, 1 ) );
+    TEST_CHECK( subscriber.GetLastLatency( ) >= 0 );
+
+    // Each frame is read once
+    TEST_CHECK( !subscriber.ReadLatest( pRead ) );
+
+    // Only the right hand of the position-only skeleton; other joints are left alone
+    subscriber.SetFilter( 13, 1 << NUI_SKELETON_POSITION_HAND_RIGHT );
+    FillMemory( pRead, sizeof(*pRead), 0 );
+
+    MakeSkeletonFrame( 2, frame );
+    publisher.Publish( frame );
+
+    TEST_CHECK( subscriber.ReadLatest( pRead ) );
+    TEST_CHECK( 2 == pRead->dwFrameNumber );
+    TEST_CHECK( 1 == pRead->cBodies && 13 == pRead->Bodies[0].dwTrackingID );
+    TEST_CHECK( IsJointAsMade( pRead->Bodies[0], NUI_SKELETON_POSITION_HAND_RIGHT, 2 ) );
+    TEST_CHECK( 0.0f == pRead->Bodies[0].Joints[NUI_SKELETON_POSITION_HAND_LEFT][0] &&
+                NUI_SKELETON_POSITION_NOT_TRACKED == pRead->Bodies[0].JointStates[NUI_SKELETON_POSITION_HAND_LEFT] );
+
+    // A reader that falls behind gets the newest frame and skips the rest
+    subscriber.SetFilter( 0, SKELETON_ALL_JOINTS );
+    for ( DWORD frameNumber = 3; frameNumber < 3 + 2 * SKELETON_PUBLISH_RING_SLOTS; ++frameNumber )
+    {
+        MakeSkeletonFrame( frameNumber, frame );
+        publisher.Publish( frame );
+    }
+
+    TEST_CHECK( subscriber.ReadLatest( pRead ) );
+    TEST_CHECK( 2 + 2 * SKELETON_PUBLISH_RING_SLOTS == pRead->dwFrameNumber );
+
+    delete pRead;
+}
+
+/// <summary>
+/// Datagrams carry only the skeleton and joints of each subscriber's own
+/// filter, packed as SKELETON_DATAGRAM_HEADER describes, to subscribers
+/// listening side by side; subscribers without a port, or too many, are refused
+/// </summary>
+void TestSkeletonPublisherUdp( )
+{
+    WSADATA wsaData;
+    TEST_CHECK( 0 == WSAStartup( MAKEWORD(2, 2), &wsaData ) );
+
+    // Everything, both hands of skeleton 11, and a skeleton that isn't there
+    DWORD jointMask = (1 << NUI_SKELETON_POSITION_HAND_LEFT) | (1 << NUI_SKELETON_POSITION_HAND_RIGHT);
+    SKELETON_UDP_SUBSCRIBER subscribers[3] =
+    {
+        { 0, 0, SKELETON_ALL_JOINTS },
+        { 0, 11, jointMask },
+        { 0, 99, jointMask },
+    };
+    SOCKET listeners[3];
+
+    SkeletonPublisher * pPublisher = new SkeletonPublisher( );
+    TEST_CHECK( SUCCEEDED( pPublisher->Initialize( ) ) );
+
+    for ( UINT i = 0; i < _countof(subscribers); ++i )
+    {
+        listeners[i] = OpenListener( subscribers[i].port );
+        TEST_CHECK( INVALID_SOCKET != listeners[i] );
+        TEST_CHECK( SUCCEEDED( pPublisher->AddUdpSubscriber( subscribers[i] ) ) );
+    }
+
+    NUI_SKELETON_FRAME frame;
+    MakeSkeletonFrame( 7, frame );
+    pPublisher->Publish( frame );
+
+    BYTE datagram[4096];
+    const SKELETON_DATAGRAM_HEADER * pHeader = reinterpret_cast<const SKELETON_DATAGRAM_HEADER *>(datagram);
+
+    // Everything: both published skeletons with every joint
+    int cbDatagram = ReceiveDatagram( listeners[0], datagram, sizeof(datagram) );
+    TEST_CHECK( sizeof(SKELETON_DATAGRAM_HEADER) + 2 * (2 * sizeof(DWORD) + NUI_SKELETON_POSITION_COUNT * (3 * sizeof(float) + 1)) == cbDatagram );
+    TEST_CHECK( SKELETON_DATAGRAM_MAGIC == pHeader->dwMagic && 7 == pHeader->dwFrameNumber );
+    TEST_CHECK( SKELETON_ALL_JOINTS == pHeader->dwJointMask && 2 == pHeader->cBodies );
+
+    // Both hands of skeleton 11, of the same frame
+    cbDatagram = ReceiveDatagram( listeners[1], datagram, sizeof(datagram) );
+    TEST_CHECK( sizeof(SKELETON_DATAGRAM_HEADER) + 2 * sizeof(DWORD) + 2 * (3 * sizeof(float) + 1) == cbDatagram );
+    TEST_CHECK( 7 == pHeader->dwFrameNumber && jointMask == pHeader->dwJointMask && 1 == pHeader->cBodies );
+
+    const BYTE * pBody = datagram + sizeof(SKELETON_DATAGRAM_HEADER);
+    DWORD trackingID, trackingState;
+    float hand[3];
+    CopyMemory( &trackingID, pBody, sizeof(DWORD) );
+    CopyMemory( &trackingState, pBody + sizeof(DWORD), sizeof(DWORD) );
+    TEST_CHECK( 11 == trackingID && NUI_SKELETON_TRACKED == trackingState );
+
+    // The right hand comes second, after the left hand's position and state
+    CopyMemory( hand, pBody + 2 * sizeof(DWORD) + 3 * sizeof(float) + 1, sizeof(hand) );
+    TEST_CHECK( 11.0f == hand[0] && NUI_SKELETON_POSITION_HAND_RIGHT == hand[1] && 7.0f == hand[2] );
+
+    // A skeleton that isn't there leaves an empty frame, still sent so listeners see the frame go by
+    cbDatagram = ReceiveDatagram( listeners[2], datagram, sizeof(datagram) );
+    TEST_CHECK( sizeof(SKELETON_DATAGRAM_HEADER) == cbDatagram && 7 == pHeader->dwFrameNumber && 0 == pHeader->cBodies );
+
+    SKELETON_UDP_SUBSCRIBER noPort = { 0, 0, SKELETON_ALL_JOINTS };
+    TEST_CHECK( E_INVALIDARG == pPublisher->AddUdpSubscriber( noPort ) );
+
+    UINT cAdded = _countof(subscribers);
+    while ( cAdded < SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS && SUCCEEDED( pPublisher->AddUdpSubscriber( subscribers[0] ) ) )
+    {
+        ++cAdded;
+    }
+    TEST_CHECK( SKELETON_PUBLISH_MAX_UDP_SUBSCRIBERS == cAdded );
+    TEST_CHECK( E_OUTOFMEMORY == pPublisher->AddUdpSubscriber( subscribers[0] ) );
+
+    delete pPublisher;
+    for ( UINT i = 0; i < _countof(listeners); ++i )
+    {
+        closesocket( listeners[i] );
+    }
+    WSACleanup( );
+}
+
+// What the benchmark's reader threads share with it
+struct LATENCY_READERS
+{
+    SOCKET              listener;
+    volatile LONG       bStop;
+    double              sharedMemory[g_LatencyFrames];
+    UINT                cSharedMemory;
+    double              udp[g_LatencyFrames];
+    UINT                cUdp;
+};
+
+/// <summary>
+/// Poll the shared memory ring as a subscriber would, recording each frame's latency
+/// </summary>
+/// <param name="pParam">LATENCY_READERS</param>
+/// <returns>always 0</returns>
+static DWORD WINAPI SubscriberThread( LPVOID pParam )
+{
+    LATENCY_READERS * pReaders = static_cast<LATENCY_READERS *>(pParam);
+    SKELETON_PUBLISH_FRAME * pFrame = new SKELETON_PUBLISH_FRAME;
+
+    SkeletonSubscriber subscriber;
+    if ( SUCCEEDED( subscriber.Open( ) ) )
+    {
+        while ( !pReaders->bStop && pReaders->cSharedMemory < g_LatencyFrames )
+        {
+            if ( subscriber.ReadLatest( pFrame ) )
+            {
+                pReaders->sharedMemory[pReaders->cSharedMemory++] = static_cast<double>(subscriber.GetLastLatency( ));
+            }
+            else
+            {
+                YieldProcessor( );
+            }
+        }
+    }
+
+    delete pFrame;
+    return 0;
+}
+
+/// <summary>
+/// Receive datagrams, recording each one's latency
+/// </summary>
+/// <param name="pParam">LATENCY_READERS</param>
+/// <returns>always 0</returns>
+static DWORD WINAPI ListenerThread( LPVOID pParam )
+{
+    LATENCY_READERS * pReaders = static_cast<LATENCY_READERS *>(pParam);
+    BYTE datagram[4096];
+    const SKELETON_DATAGRAM_HEADER * pHeader = reinterpret_cast<const SKELETON_DATAGRAM_HEADER *>(datagram);
+
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceFrequency( &frequency );
+
+    while ( pReaders->cUdp < g_LatencyFrames && ReceiveDatagram( pReaders->listener, datagram, sizeof(datagram) ) > 0 )
+    {
+        QueryPerformanceCounter( &now );
+        pReaders->udp[pReaders->cUdp++] = (now.QuadPart - pHeader->liPublishTime) * 1000000.0 / frequency.QuadPart;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Report the median and 99th percentile of a set of latencies
+/// </summary>
+/// <param name="szName">what was measured</param>
+/// <param name="pLatencies">latencies in microseconds, sorted in place</param>
+/// <param name="cLatencies">number of latencies</param>
+static void ReportLatencies( const char * szName, double * pLatencies, UINT cLatencies )
+{
+    if ( 0 == cLatencies )
+    {
+        printf( "    %s: nothing received\n", szName );
+        return;
+    }
+
+    double median = TestMedian( pLatencies, cLatencies );
+    printf( "    %s: %u of %u frames, median %.1f us, 99th percentile %.1f us\n",
+        szName, cLatencies, g_LatencyFrames, median, pLatencies[cLatencies * 99 / 100] );
+}
+
+/// <summary>
+/// Publish-to-receive latency of both paths, with a subscriber polling the
+/// ring and a listener blocked on the socket, each on its own thread.  Both
+/// run in this process, so this leaves out only the cost of a process switch
+/// </summary>
+void BenchSkeletonPublisher( )
+{
+    WSADATA wsaData;
+    if ( 0 != WSAStartup( MAKEWORD(2, 2), &wsaData ) )
+    {
+        printf( "    Winsock unavailable\n" );
+        return;
+    }
+
+    LATENCY_READERS * pReaders = new LATENCY_READERS;
+    ZeroMemory( pReaders, sizeof(*pReaders) );
+
+    SKELETON_UDP_SUBSCRIBER subscriber = { 0, 0, SKELETON_ALL_JOINTS };
+    pReaders->listener = OpenListener( subscriber.port );
+
+    SkeletonPublisher * pPublisher = new SkeletonPublisher( );
+    if ( INVALID_SOCKET == pReaders->listener || FAILED( pPublisher->Initialize( ) ) || FAILED( pPublisher->AddUdpSubscriber( subscriber ) ) )
+    {
+        printf( "    could not publish to a local port\n" );
+    }
+    else
+    {
+        HANDLE hThreads[2];
+        hThreads[0] = CreateThread( NULL, 0, SubscriberThread, pReaders, 0, NULL );
+        hThreads[1] = CreateThread( NULL, 0, ListenerThread, pReaders, 0, NULL );
+
+        // Give the subscriber time to open the ring before the first frame
+        Sleep( 50 );
+
+        NUI_SKELETON_FRAME frame;
+        for ( DWORD i = 0; i < g_LatencyFrames; ++i )
+        {
+            MakeSkeletonFrame( i + 1, frame );
+            pPublisher->Publish( frame );
+            Sleep( 1 );
+        }
+
+        Sleep( 50 );
+        InterlockedExchange( &pReaders->bStop, TRUE );
+        WaitForMultipleObjects( _countof(hThreads), hThreads, TRUE, INFINITE );
+        CloseHandle( hThreads[0] );
+        CloseHandle( hThreads[1] );
+
+        ReportLatencies( "shared memory", pReaders->sharedMemory, pReaders->cSharedMemory );
+        ReportLatencies( "UDP", pReaders->udp, pReaders->cUdp );
+    }
+
+    delete pPublisher;
+    if ( INVALID_SOCKET != pReaders->listener )
+    {
+        closesocket( pReaders->listener );
+    }
+    delete pReaders;
+    WSACleanup( );
+}
@@ -0,0 +1,305 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SkeletonSelectorTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Who each policy picks, when a pick changes hands, how often the sensor is
+// told, and what picking costs against the per-frame loop it replaced
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "SkeletonSelector.h"
+
+static const float g_TestPi = 3.14159265f;
+
+// Milliseconds between frames, as the sensor sends them
+static const UINT g_FrameInterval = 33;
+
+/// <summary>
+/// Start a frame with no skeletons in view
+/// </summary>
+/// <param name="frame">frame to fill</param>
+/// <param name="number">frame number, from 0</param>
+static void BeginFrame( NUI_SKELETON_FRAME & frame, UINT number )
+{
+    ZeroMemory( &frame, sizeof(frame) );
+    frame.liTimeStamp.QuadPart = 1000 + number * g_FrameInterval;
+    frame.dwFrameNumber = number + 1;
+}
+
+/// <summary>
+/// Put a skeleton in a frame
+/// </summary>
+/// <param name="frame">frame to add to</param>
+/// <param name="index">index of the skeleton in the frame</param>
+/// <param name="dwTrackingID">tracking ID of the skeleton</param>
+/// <param name="x">x (in meters) of the skeleton</param>
+/// <param name="z">distance (in meters) of the skeleton from the sensor</param>
+static void AddSkeleton( NUI_SKELETON_FRAME & frame, UINT index, DWORD dwTrackingID, float x, float z )
+{
+    NUI_SKELETON_DATA & skeleton = frame.SkeletonData[index];
+    skeleton.eTrackingState = ( index % 2 ) ? NUI_SKELETON_POSITION_ONLY : NUI_SKELETON_TRACKED;
+    skeleton.dwTrackingID = dwTrackingID;
+    skeleton.Position.x = x;
+    skeleton.Position.y = 0.0f;
+    skeleton.Position.z = z;
+    skeleton.Position.w = 1.0f;
+}
+
+/// <summary>
+/// Whether a pick is the two IDs given, in either order
+/// </summary>
+/// <param name="trackedIDs">pick</param>
+/// <param name="id0">one ID expected</param>
+/// <param name="id1">other ID expected, 0 for none</param>
+/// <returns>true if the pick is those IDs</returns>
+static bool IsPick( const DWORD trackedIDs[NUI_SKELETON_MAX_TRACKED_COUNT], DWORD id0, DWORD id1 )
+{
+    return (trackedIDs[0] == id0 && trackedIDs[1] == id1) || (trackedIDs[0] == id1 && trackedIDs[1] == id0);
+}
+
+/// <summary>
+/// Depth of a skeleton's position the way the removed loop ranked it, through
+/// the projection NuiTransformSkeletonToDepthImage makes at 320x240
+/// </summary>
+/// <param name="position">position in skeleton space</param>
+/// <param name="pX">receives the column</param>
+/// <param name="pY">receives the row</param>
+/// <returns>packed depth</returns>
+static USHORT TransformToDepth( const Vector4 & position, LONG * pX, LONG * pY )
+{
+    if ( position.z <= 0.0f )
+    {
+        *pX = *pY = 0;
+        return 0;
+    }
+
+    *pX = static_cast<LONG>(0.5f + position.x * (285.63f / position.z) / 320.0f * 320.0f + 160.0f);
+    *pY = static_cast<LONG>(0.5f - position.y * (285.63f / position.z) / 240.0f * 240.0f + 120.0f);
+    return static_cast<USHORT>(static_cast<USHORT>(position.z * 1000.0f) << NUI_IMAGE_PLAYER_INDEX_SHIFT);
+}
+
+/// <summary>
+/// Nearest picks by distance and sticky keeps whoever it has; a picked
+/// skeleton only gives up its place to one nearer or closer to the zone
+/// center by the margin; most active picks the one moving, and longest
+/// present the first to arrive; the sensor is told only when the pick
+/// changes, and again after Invalidate or a new policy, and every frame is
+/// counted as a call made or avoided
+/// </summary>
+void TestSkeletonSelector( )
+{
+    NUI_SKELETON_FRAME frame;
+    DWORD trackedIDs[NUI_SKELETON_MAX_TRACKED_COUNT];
+    UINT number = 0;
+
+    // Nothing in view is still a pick to send, once
+    SkeletonSelector selector;
+    BeginFrame( frame, number++ );
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 0, 0 ) );
+    TEST_CHECK( !selector.Select( frame, trackedIDs ) );
+
+    // Nearest, one and two, ranked by Position.z
+    BeginFrame( frame, number++ );
+    AddSkeleton( frame, 0, 11, 0.0f, 3.0f );
+    AddSkeleton( frame, 2, 12, 0.5f, 2.0f );
+    AddSkeleton( frame, 3, 13, -0.5f, 2.5f );
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 0 ) );
+    TEST_CHECK( !selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 0 ) );
+
+    selector.SetPolicy( SKELETON_SELECT_NEAREST, 2 );
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 13 ) );
+
+    // The same two the other way round isn't a new pick
+    frame.SkeletonData[3].Position.z = 1.9f;
+    TEST_CHECK( !selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 13 ) );
+
+    // Less than the margin nearer keeps the pick, more takes it over
+    selector.SetPolicy( SKELETON_SELECT_NEAREST, 1 );
+    frame.SkeletonData[3].Position.z = 2.5f;
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 0 ) );
+    frame.SkeletonData[3].Position.z = 2.0f - SKELETON_SELECT_DISTANCE_MARGIN * 0.5f;
+    TEST_CHECK( !selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 0 ) );
+    frame.SkeletonData[3].Position.z = 2.0f - SKELETON_SELECT_DISTANCE_MARGIN * 1.5f;
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 13, 0 ) );
+
+    // The sensor refusing a pick, or tracking being enabled again, has the pick sent again
+    selector.Invalidate( );
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 13, 0 ) );
+    TEST_CHECK( !selector.Select( frame, trackedIDs ) );
+
+    // Sticky keeps the first found however near the others come, until they leave
+    selector.SetPolicy( SKELETON_SELECT_STICKY, 2 );
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 11, 12 ) );
+    BeginFrame( frame, number++ );
+    AddSkeleton( frame, 0, 11, 0.0f, 4.0f );
+    AddSkeleton( frame, 2, 12, 0.5f, 3.5f );
+    AddSkeleton( frame, 3, 13, -0.5f, 1.0f );
+    TEST_CHECK( !selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 11, 12 ) );
+    frame.SkeletonData[0].eTrackingState = NUI_SKELETON_NOT_TRACKED;
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 13 ) );
+
+    // Closest to the zone center, with the same margin
+    selector.SetPolicy( SKELETON_SELECT_ZONE_CENTER, 1 );
+    selector.SetZoneCenter( 1.0f, 3.0f );
+    BeginFrame( frame, number++ );
+    AddSkeleton( frame, 0, 11, 0.0f, 3.0f );
+    AddSkeleton( frame, 1, 12, 1.2f, 3.5f );
+    AddSkeleton( frame, 2, 13, 1.0f, 1.5f );
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 12, 0 ) );
+    frame.SkeletonData[0].Position.x = 1.0f - 0.5f;
+    TEST_CHECK( !selector.Select( frame, trackedIDs ) );
+    frame.SkeletonData[0].Position.x = 1.0f - 0.3f;
+    TEST_CHECK( selector.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 11, 0 ) );
+
+    // Most active: one of three standing still starts walking across the room
+    SkeletonSelector active;
+    active.SetPolicy( SKELETON_SELECT_MOST_ACTIVE, 1 );
+    UINT cPickedWalker = 0;
+    for ( UINT f = 0; f < 60; ++f )
+    {
+        BeginFrame( frame, number++ );
+        AddSkeleton( frame, 0, 21, -1.0f, 2.0f );
+        AddSkeleton( frame, 1, 22, f < 10 ? 0.0f : (f - 10) * 0.03f, 2.5f );
+        AddSkeleton( frame, 2, 23, 1.0f, 3.0f );
+        active.Select( frame, trackedIDs );
+        cPickedWalker += ( IsPick( trackedIDs, 22, 0 ) ) ? 1 : 0;
+    }
+    TEST_CHECK( IsPick( trackedIDs, 22, 0 ) );
+    TEST_CHECK( cPickedWalker > 30 );
+
+    // Stopping keeps the pick until the average drops below another's by the margin
+    for ( UINT f = 0; f < 5; ++f )
+    {
+        BeginFrame( frame, number++ );
+        AddSkeleton( frame, 0, 21, -1.0f, 2.0f );
+        AddSkeleton( frame, 1, 22, 1.5f, 2.5f );
+        AddSkeleton( frame, 2, 23, 1.0f, 3.0f );
+        TEST_CHECK( !active.Select( frame, trackedIDs ) );
+    }
+    TEST_CHECK( IsPick( trackedIDs, 22, 0 ) );
+
+    // Longest present: arrivals don't take over, and the next oldest follows a leaver
+    SkeletonSelector longest;
+    longest.SetPolicy( SKELETON_SELECT_LONGEST_PRESENT, 2 );
+    BeginFrame( frame, number++ );
+    AddSkeleton( frame, 4, 31, 0.0f, 3.0f );
+    TEST_CHECK( longest.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 31, 0 ) );
+    AddSkeleton( frame, 0, 32, 0.0f, 1.0f );
+    TEST_CHECK( longest.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 31, 32 ) );
+    AddSkeleton( frame, 1, 33, 0.0f, 0.8f );
+    TEST_CHECK( !longest.Select( frame, trackedIDs ) );
+    AddSkeleton( frame, 2, 34, 0.0f, 0.8f );
+    TEST_CHECK( !longest.Select( frame, trackedIDs ) );
+    frame.SkeletonData[4].eTrackingState = NUI_SKELETON_NOT_TRACKED;
+    TEST_CHECK( longest.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 32, 33 ) );
+
+    // A skeleton leaving and its place taken by someone new in the same slot
+    frame.SkeletonData[0].dwTrackingID = 35;
+    TEST_CHECK( longest.Select( frame, trackedIDs ) );
+    TEST_CHECK( IsPick( trackedIDs, 33, 34 ) );
+
+    // Every frame either told the sensor or didn't need to
+    TEST_CHECK( selector.GetCallsMade( ) + selector.GetCallsAvoided( ) == 17 );
+    TEST_CHECK( 60 + 5 == active.GetCallsMade( ) + active.GetCallsAvoided( ) );
+    TEST_CHECK( 6 == longest.GetCallsMade( ) + longest.GetCallsAvoided( ) );
+    TEST_CHECK( 4 == longest.GetCallsMade( ) );
+}
+
+/// <summary>
+/// Time picking the nearest two from six people milling about, with a
+/// centimeter of jitter, through SkeletonSelector and through the loop it
+/// replaced, and count how often each tells the sensor
+/// </summary>
+void BenchSkeletonSelector( )
+{
+    const UINT cFrames = 30000;
+    UINT random = 5;
+
+    NUI_SKELETON_FRAME * pFrames = new NUI_SKELETON_FRAME[cFrames];
+    for ( UINT number = 0; number < cFrames; ++number )
+    {
+        BeginFrame( pFrames[number], number );
+        float t = number * g_FrameInterval * 0.001f;
+        for ( UINT skeleton = 0; skeleton < NUI_SKELETON_COUNT; ++skeleton )
+        {
+            // Everyone drifts back and forth over a meter at their own pace
+            float z = 2.0f + 0.4f * skeleton + 0.5f * sinf( 2.0f * g_TestPi * (0.02f + 0.01f * skeleton) * t );
+            z += (TestRandom( random ) / 16383.5f - 1.0f) * 0.01f;
+            AddSkeleton( pFrames[number], skeleton, skeleton + 1, 0.3f * skeleton - 0.75f, z );
+        }
+    }
+
+    SkeletonSelector selector;
+    selector.SetPolicy( SKELETON_SELECT_NEAREST, 2 );
+    DWORD trackedIDs[NUI_SKELETON_MAX_TRACKED_COUNT];
+
+    double start = TestSeconds( );
+    for ( UINT number = 0; number < cFrames; ++number )
+    {
+        selector.Select( pFrames[number], trackedIDs );
+    }
+    double selectorSeconds = (TestSeconds( ) - start) / cFrames;
+
+    // The per-frame loop: every skeleton projected for its depth, every frame sent
+    UINT cLoopCalls = 0, cLoopChanges = 0;
+    DWORD previousIDs[2] = { 0, 0 };
+    start = TestSeconds( );
+    for ( UINT number = 0; number < cFrames; ++number )
+    {
+        DWORD nearestIDs[2] = { 0, 0 };
+        USHORT nearestDepths[2] = { NUI_IMAGE_DEPTH_MAXIMUM, NUI_IMAGE_DEPTH_MAXIMUM };
+
+        for ( int i = 0; i < NUI_SKELETON_COUNT; ++i )
+        {
+            const NUI_SKELETON_DATA & skeleton = pFrames[number].SkeletonData[i];
+            if ( NUI_SKELETON_TRACKED == skeleton.eTrackingState || NUI_SKELETON_POSITION_ONLY == skeleton.eTrackingState )
+            {
+                LONG x, y;
+                USHORT depth = TransformToDepth( skeleton.Position, &x, &y );
+                if ( depth < nearestDepths[0] )
+                {
+                    nearestDepths[1] = nearestDepths[0];
+                    nearestIDs[1] = nearestIDs[0];
+                    nearestDepths[0] = depth;
+                    nearestIDs[0] = skeleton.dwTrackingID;
+                }
+                else if ( depth < nearestDepths[1] )
+                {
+                    nearestDepths[1] = depth;
+                    nearestIDs[1] = skeleton.dwTrackingID;
+                }
+            }
+        }
+
+        cLoopChanges += IsPick( nearestIDs, previousIDs[0], previousIDs[1] ) ? 0 : 1;
+        previousIDs[0] = nearestIDs[0];
+        previousIDs[1] = nearestIDs[1];
+        ++cLoopCalls;
+    }
+    double loopSeconds = (TestSeconds( ) - start) / cFrames;
+
+    printf( "    nearest 2 of 6, %u frames: SkeletonSelector %.3f us a frame, %u sensor calls (%.2f%% avoided); per-frame loop %.3f us a frame, %u sensor calls, pick changed %u times\n",
+        cFrames, selectorSeconds * 1e6, selector.GetCallsMade( ), 100.0 * selector.GetCallsAvoided( ) / cFrames,
+        loopSeconds * 1e6, cLoopCalls, cLoopChanges );
+
+    delete [] pFrames;
+}
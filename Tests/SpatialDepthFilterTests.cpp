@@ -0,0 +1,338 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="SpatialDepthFilterTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// The bilateral filter on a noisy wall with a box and a shallow panel in front
+// of it, how well it keeps their edges, and what filtering a frame costs
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "SpatialDepthFilter.h"
+#include "ParallelRows.h"
+
+// A frame of a scene, with the color the guide sees at each depth pixel
+struct TEST_SPATIAL_SCENE
+{
+    DWORD       width;
+    DWORD       height;
+    USHORT *    pDepth;         // packed depth and player index as the sensor gives it, with noise and holes
+    USHORT *    pTruth;         // depth without noise or holes, in millimeters
+    BYTE *      pColor;         // BGRX color registered to depth
+    BYTE *      pEdge;          // 1 for pixels within two of a change in the truth, 0 elsewhere
+};
+
+// How close a filter kept to the truth
+struct TEST_SPATIAL_QUALITY
+{
+    double      flatError;      // RMS error, in millimeters, away from edges
+    double      edgeError;      // RMS error, in millimeters, next to edges
+    UINT        cPulled;        // pixels more than 100 mm off the truth
+    UINT        cHolesChanged;  // pixels with depth in only one of the source and the output
+    UINT        cWrongPlayers;  // pixels whose player index isn't the source's
+};
+
+/// <summary>
+/// Normally distributed noise
+/// </summary>
+/// <param name="random">state of the sequence</param>
+/// <returns>sample with a mean of 0 and a standard deviation of 1</returns>
+static double Gaussian( UINT & random )
+{
+    // Sum of four uniform samples, scaled to unit variance
+    double sum = 0.0;
+    for ( int i = 0; i < 4; ++i )
+    {
+        sum += TestRandom( random ) / 32767.0 - 0.5;
+    }
+    return sum * 1.7320508;
+}
+
+/// <summary>
+/// Render a slanted wall from 2.5 to 3.5 meters with a player-sized box at 1.5
+/// meters on the left, and a panel on the right standing only 24 mm off the
+/// wall, which depth alone can't tell from noise but which is much brighter
+/// than the wall; with the sensor's depth noise and 2% of pixels dropping out
+/// </summary>
+/// <param name="scene">scene to render, with its size set</param>
+static void RenderScene( TEST_SPATIAL_SCENE & scene )
+{
+    const DWORD cPixels = scene.width * scene.height;
+    scene.pDepth = new USHORT[cPixels];
+    scene.pTruth = new USHORT[cPixels];
+    scene.pColor = new BYTE[cPixels * 4];
+    scene.pEdge = new BYTE[cPixels];
+
+    UINT random = 11;
+    const DWORD top = scene.height / 4;
+    const DWORD bottom = top + scene.height / 2;
+    const DWORD boxLeft = scene.width / 8;
+    const DWORD boxRight = boxLeft + scene.width / 4;
+    const DWORD panelLeft = scene.width * 5 / 8;
+    const DWORD panelRight = panelLeft + scene.width / 4;
+
+    for ( DWORD y = 0; y < scene.height; ++y )
+    {
+        for ( DWORD x = 0; x < scene.width; ++x )
+        {
+            bool bRows = y >= top && y < bottom;
+            bool bBox = bRows && x >= boxLeft && x < boxRight;
+            bool bPanel = bRows && x >= panelLeft && x < panelRight;
+
+            USHORT wall = static_cast<USHORT>(2500 + 1000 * x / scene.width);
+            USHORT truth = bBox ? 1500 : bPanel ? static_cast<USHORT>(wall - 24) : wall;
+            double sigma = 1.5 * (truth / 1000.0) * (truth / 1000.0);
+            LONG depth = static_cast<LONG>(truth + sigma * Gaussian( random ) + 0.5);
+            if ( TestRandom( random ) % 100 < 2 )
+            {
+                depth = 0;
+            }
+
+            DWORD i = y * scene.width + x;
+            scene.pTruth[i] = truth;
+            scene.pDepth[i] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | (bBox ? 1 : 0));
+
+            BYTE brightness = static_cast<BYTE>(bPanel ? 220 : bBox ? 140 : 60);
+            scene.pColor[i * 4 + 0] = brightness;
+            scene.pColor[i * 4 + 1] = brightness;
+            scene.pColor[i * 4 + 2] = brightness;
+            scene.pColor[i * 4 + 3] = 0;
+        }
+    }
+
+    // Edges are where the truth steps by more than the slant of the wall
+    for ( DWORD y = 0; y < scene.height; ++y )
+    {
+        for ( DWORD x = 0; x < scene.width; ++x )
+        {
+            BYTE bEdge = 0;
+            for ( LONG dy = -2; dy <= 2 && !bEdge; ++dy )
+            {
+                for ( LONG dx = -2; dx <= 2 && !bEdge; ++dx )
+                {
+                    LONG nx = static_cast<LONG>(x) + dx;
+                    LONG ny = static_cast<LONG>(y) + dy;
+                    if ( nx < 0 || ny < 0 || nx >= static_cast<LONG>(scene.width) || ny >= static_cast<LONG>(scene.height) )
+                    {
+                        continue;
+                    }
+
+                    LONG step = static_cast<LONG>(scene.pTruth[ny * scene.width + nx]) - scene.pTruth[y * scene.width + x];
+                    bEdge = ( abs( step ) > 20 ) ? 1 : 0;
+                }
+            }
+            scene.pEdge[y * scene.width + x] = bEdge;
+        }
+    }
+}
+
+/// <summary>
+/// Free the buffers of a scene
+/// </summary>
+/// <param name="scene">scene to free</param>
+static void FreeScene( TEST_SPATIAL_SCENE & scene )
+{
+    delete [] scene.pDepth;
+    delete [] scene.pTruth;
+    delete [] scene.pColor;
+    delete [] scene.pEdge;
+    scene.pDepth = NULL;
+    scene.pTruth = NULL;
+    scene.pColor = NULL;
+    scene.pEdge = NULL;
+}
+
+/// <summary>
+/// Compare a frame with the truth of its scene
+/// </summary>
+/// <param name="scene">scene the frame was filtered from</param>
+/// <param name="pOutput">filtered frame, or the scene's own depth</param>
+/// <param name="quality">receives how close the frame is to the truth</param>
+static void MeasureFrame( const TEST_SPATIAL_SCENE & scene, const USHORT * pOutput, TEST_SPATIAL_QUALITY & quality )
+{
+    double flatSquares = 0.0, cFlat = 0.0;
+    double edgeSquares = 0.0, cEdge = 0.0;
+    quality.cPulled = 0;
+    quality.cHolesChanged = 0;
+    quality.cWrongPlayers = 0;
+
+    for ( DWORD i = 0; i < scene.width * scene.height; ++i )
+    {
+        USHORT source = NuiDepthPixelToDepth( scene.pDepth[i] );
+        USHORT depth = NuiDepthPixelToDepth( pOutput[i] );
+
+        quality.cHolesChanged += ( (0 == source) != (0 == depth) ) ? 1 : 0;
+        quality.cWrongPlayers += ( NuiDepthPixelToPlayerIndex( pOutput[i] ) == NuiDepthPixelToPlayerIndex( scene.pDepth[i] ) ) ? 0 : 1;
+        if ( 0 == depth )
+        {
+            continue;
+        }
+
+        double error = static_cast<double>(depth) - scene.pTruth[i];
+        quality.cPulled += ( fabs( error ) > 100.0 ) ? 1 : 0;
+        if ( scene.pEdge[i] )
+        {
+            edgeSquares += error * error;
+            cEdge += 1.0;
+        }
+        else
+        {
+            flatSquares += error * error;
+            cFlat += 1.0;
+        }
+    }
+
+    quality.flatError = cFlat ? sqrt( flatSquares / cFlat ) : 0.0;
+    quality.edgeError = cEdge ? sqrt( edgeSquares / cEdge ) : 0.0;
+}
+
+/// <summary>
+/// Noise away from edges drops to well under the sensor's without pulling any
+/// pixel across an edge, holes stay holes and every pixel keeps its player
+/// index; the color guide keeps the shallow panel's edges that depth alone
+/// blurs; flat depth comes back exactly, frames split over threads or read
+/// from padded rows come out the same, and frames too wide are refused
+/// </summary>
+void TestSpatialDepthFilter( )
+{
+    TEST_SPATIAL_SCENE scene;
+    scene.width = 320;
+    scene.height = 240;
+    RenderScene( scene );
+
+    const DWORD cPixels = scene.width * scene.height;
+
+    TEST_SPATIAL_QUALITY raw;
+    MeasureFrame( scene, scene.pDepth, raw );
+
+    SpatialDepthFilter filter;
+    TEST_CHECK( filter.Initialize( NUI_IMAGE_RESOLUTION_320x240 ) );
+
+    TEST_SPATIAL_QUALITY plain;
+    MeasureFrame( scene, filter.Filter( scene.pDepth, scene.width * sizeof(USHORT), NULL, NULL ), plain );
+
+    TEST_SPATIAL_QUALITY guided;
+    MeasureFrame( scene, filter.Filter( scene.pDepth, scene.width * sizeof(USHORT), scene.pColor, NULL ), guided );
+
+    TEST_CHECK( plain.flatError < raw.flatError * 0.5 );
+    TEST_CHECK( guided.flatError < raw.flatError * 0.5 );
+    TEST_CHECK( 0 == raw.cPulled );
+    TEST_CHECK( 0 == plain.cPulled );
+    TEST_CHECK( 0 == guided.cPulled );
+    TEST_CHECK( 0 == plain.cHolesChanged );
+    TEST_CHECK( 0 == guided.cHolesChanged );
+    TEST_CHECK( 0 == plain.cWrongPlayers );
+    TEST_CHECK( 0 == guided.cWrongPlayers );
+    TEST_CHECK( guided.edgeError < plain.edgeError );
+
+    // Split over two threads, and with the source read from rows twice as long as the frame's
+    TaskScheduler scheduler;
+    TEST_CHECK( scheduler.Start( 2 ) );
+    ParallelRows rows( scheduler );
+    USHORT * pPadded = new USHORT[cPixels * 2];
+    ZeroMemory( pPadded, cPixels * 2 * sizeof(USHORT) );
+    for ( DWORD y = 0; y < scene.height; ++y )
+    {
+        CopyMemory( pPadded + y * scene.width * 2, scene.pDepth + y * scene.width, scene.width * sizeof(USHORT) );
+    }
+
+    USHORT * pSingle = new USHORT[cPixels];
+    for ( int bGuided = 0; bGuided <= 1; ++bGuided )
+    {
+        const BYTE * pGuide = bGuided ? scene.pColor : NULL;
+        CopyMemory( pSingle, filter.Filter( scene.pDepth, scene.width * sizeof(USHORT), pGuide, NULL ), cPixels * sizeof(USHORT) );
+        TEST_CHECK( 0 == memcmp( pSingle, filter.Filter( scene.pDepth, scene.width * sizeof(USHORT), pGuide, &rows ), cPixels * sizeof(USHORT) ) );
+        TEST_CHECK( 0 == memcmp( pSingle, filter.Filter( pPadded, scene.width * 2 * sizeof(USHORT), pGuide, NULL ), cPixels * sizeof(USHORT) ) );
+    }
+
+    delete [] pSingle;
+    delete [] pPadded;
+
+    // Every depth the sensor gives, flat across the frame, divides back to itself
+    UINT cInexact = 0;
+    for ( USHORT depth = 400; depth <= 4000; depth += 100 )
+    {
+        for ( DWORD i = 0; i < cPixels; ++i )
+        {
+            scene.pDepth[i] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | (i % 7));
+        }
+
+        const USHORT * pOutput = filter.Filter( scene.pDepth, scene.width * sizeof(USHORT), NULL, NULL );
+        cInexact += ( 0 == memcmp( pOutput, scene.pDepth, cPixels * sizeof(USHORT) ) ) ? 0 : 1;
+    }
+    TEST_CHECK( 0 == cInexact );
+
+    FreeScene( scene );
+
+    TEST_CHECK( !filter.Initialize( NUI_IMAGE_RESOLUTION_INVALID ) );
+    TEST_CHECK( !filter.Initialize( NUI_IMAGE_RESOLUTION_1280x960 ) );
+    TEST_CHECK( filter.Initialize( NUI_IMAGE_RESOLUTION_80x60 ) );
+    TEST_CHECK( filter.Initialize( NUI_IMAGE_RESOLUTION_640x480 ) );
+}
+
+/// <summary>
+/// Time the filter with and without the color guide at both depth
+/// resolutions on one and two threads, against the 33 ms a frame of 30 fps,
+/// with how close each keeps to the truth against the frame as it comes
+/// </summary>
+void BenchSpatialDepthFilter( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    const UINT cRuns = 30;
+
+    TaskScheduler scheduler;
+    if ( !scheduler.Start( 2 ) )
+    {
+        printf( "    threads failed to start\n" );
+        return;
+    }
+    ParallelRows rows( scheduler );
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        TEST_SPATIAL_SCENE scene;
+        NuiImageResolutionToSize( resolutions[r], scene.width, scene.height );
+        RenderScene( scene );
+
+        SpatialDepthFilter filter;
+        if ( !filter.Initialize( resolutions[r] ) )
+        {
+            printf( "    filter failed to initialize\n" );
+            FreeScene( scene );
+            return;
+        }
+
+        TEST_SPATIAL_QUALITY raw;
+        MeasureFrame( scene, scene.pDepth, raw );
+        printf( "    %ux%u, raw:             off by %.1f mm flat, %.1f mm at edges\n",
+            scene.width, scene.height, raw.flatError, raw.edgeError );
+
+        for ( int bGuided = 0; bGuided <= 1; ++bGuided )
+        {
+            const BYTE * pGuide = bGuided ? scene.pColor : NULL;
+            for ( UINT cThreads = 1; cThreads <= 2; ++cThreads )
+            {
+                ParallelRows * pRows = ( 2 == cThreads ) ? &rows : NULL;
+                double times[cRuns];
+                const USHORT * pOutput = NULL;
+                for ( UINT run = 0; run < cRuns; ++run )
+                {
+                    double start = TestSeconds( );
+                    pOutput = filter.Filter( scene.pDepth, scene.width * sizeof(USHORT), pGuide, pRows );
+                    times[run] = TestSeconds( ) - start;
+                }
+
+                TEST_SPATIAL_QUALITY quality;
+                MeasureFrame( scene, pOutput, quality );
+                double ms = TestMedian( times, cRuns ) * 1000.0;
+
+                printf( "    %ux%u, %s, %u thread%s: %.2f ms a frame (%.0f fps), off by %.1f mm flat, %.1f mm at edges\n",
+                    scene.width, scene.height, bGuided ? "joint" : "depth", cThreads, ( 1 == cThreads ) ? " " : "s",
+                    ms, 1000.0 / ms, quality.flatError, quality.edgeError );
+            }
+        }
+
+        FreeScene( scene );
+    }
+}
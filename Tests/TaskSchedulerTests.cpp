@@ -0,0 +1,233 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="TaskSchedulerTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Random task graphs run on the scheduler, and what scheduling a task costs
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "TaskScheduler.h"
+
+// A task that records when it ran, after working for a while
+struct TEST_TASK
+{
+    volatile LONG *     pSequence;      // shared by every task of the graph
+    LONG                ranAt;          // position in the sequence, -1 until it runs
+    volatile LONG       cRuns;
+    double              seconds;        // time to keep busy for
+};
+
+/// <summary>
+/// Keep busy for a while, without sleeping, as a stage of the pipeline does
+/// </summary>
+/// <param name="seconds">time to keep busy for</param>
+static void Work( double seconds )
+{
+    if ( seconds > 0.0 )
+    {
+        double end = TestSeconds( ) + seconds;
+        while ( TestSeconds( ) < end )
+        {
+        }
+    }
+}
+
+/// <summary>
+/// Run a test task
+/// </summary>
+/// <param name="pContext">TEST_TASK to run</param>
+static void RunTestTask( void * pContext )
+{
+    TEST_TASK * pTask = static_cast<TEST_TASK *>(pContext);
+    Work( pTask->seconds );
+    pTask->ranAt = InterlockedIncrement( pTask->pSequence );
+    InterlockedIncrement( &pTask->cRuns );
+}
+
+/// <summary>
+/// A task that does nothing, to measure the scheduler alone
+/// </summary>
+/// <param name="pContext">unused</param>
+static void RunEmptyTask( void * pContext )
+{
+    UNREFERENCED_PARAMETER(pContext);
+}
+
+/// <summary>
+/// Every task of random graphs runs exactly once, after every task it depends
+/// on, on 1, 2, 4 and 8 threads; tasks are stolen once there is more than one
+/// </summary>
+void TestTaskScheduler( )
+{
+    static const UINT threadCounts[] = { 1, 2, 4, 8 };
+
+    TEST_TASK tasks[TASK_GRAPH_MAX_TASKS];
+    int dependencies[2 * TASK_GRAPH_MAX_TASKS][2];
+    UINT random = 3;
+
+    for ( UINT t = 0; t < _countof(threadCounts); ++t )
+    {
+        TaskScheduler * pScheduler = new TaskScheduler( );
+        TEST_CHECK( pScheduler->Start( threadCounts[t] ) );
+        TEST_CHECK( threadCounts[t] == pScheduler->GetThreadCount( ) );
+
+        UINT cMissed = 0;
+        UINT cOutOfOrder = 0;
+        UINT cNotDone = 0;
+
+        for ( UINT iteration = 0; iteration < 500; ++iteration )
+        {
+            TaskGraph graph;
+            volatile LONG sequence = 0;
+            UINT cTasks = 1 + TestRandom( random ) % TASK_GRAPH_MAX_TASKS;
+
+            for ( UINT i = 0; i < cTasks; ++i )
+            {
+                tasks[i].pSequence = &sequence;
+                tasks[i].ranAt = -1;
+                tasks[i].cRuns = 0;
+                tasks[i].seconds = ( 0 == TestRandom( random ) % 3 ) ? (TestRandom( random ) % 200) * 1e-6 : 0.0;
+                graph.AddTask( RunTestTask, &tasks[i] );
+            }
+
+            UINT cDependencies = 0;
+            for ( UINT k = 0; k < 2 * cTasks; ++k )
+            {
+                int before = TestRandom( random ) % cTasks;
+                int after = TestRandom( random ) % cTasks;
+                if ( before < after && graph.AddDependency( before, after ) )
+                {
+                    dependencies[cDependencies][0] = before;
+                    dependencies[cDependencies][1] = after;
+                    ++cDependencies;
+                }
+            }
+
+            pScheduler->Submit( graph );
+            pScheduler->Wait( graph );
+
+            for ( UINT i = 0; i < cTasks; ++i )
+            {
+                cMissed += ( 1 == tasks[i].cRuns ) ? 0 : 1;
+            }
+            for ( UINT k = 0; k < cDependencies; ++k )
+            {
+                cOutOfOrder += ( tasks[dependencies[k][0]].ranAt < tasks[dependencies[k][1]].ranAt ) ? 0 : 1;
+            }
+            cNotDone += graph.IsDone( ) ? 0 : 1;
+        }
+
+        TEST_CHECK( 0 == cMissed );
+        TEST_CHECK( 0 == cOutOfOrder );
+        TEST_CHECK( 0 == cNotDone );
+        TEST_CHECK( (1 == threadCounts[t]) == (0 == pScheduler->GetStealCount( )) );
+
+        delete pScheduler;
+    }
+
+    // Tasks may only wait for tasks added before them, and a graph holds so many
+    TaskGraph graph;
+    for ( UINT i = 0; i < TASK_GRAPH_MAX_TASKS; ++i )
+    {
+        TEST_CHECK( static_cast<int>(i) == graph.AddTask( RunEmptyTask, NULL ) );
+    }
+    TEST_CHECK( -1 == graph.AddTask( RunEmptyTask, NULL ) );
+    TEST_CHECK( !graph.AddDependency( 1, 0 ) );
+    TEST_CHECK( !graph.AddDependency( 2, 2 ) );
+}
+
+/// <summary>
+/// Time 32 empty tasks side by side and in a chain, scheduled and inline, and a
+/// graph shaped like the stages of a depth frame
+/// </summary>
+void BenchTaskScheduler( )
+{
+    static const UINT threadCounts[] = { 1, 2, 4 };
+    static const UINT cRuns = 20000;
+
+    // Microseconds each stage of a depth frame takes, and the two that wait for the kernel
+    static const UINT frameStages[] = { 1500, 300, 40, 100, 400, 300 };
+    static const UINT criticalPath = 1900;
+    static const UINT cFrames = 200;
+
+    for ( UINT t = 0; t < _countof(threadCounts); ++t )
+    {
+        TaskScheduler scheduler;
+        if ( !scheduler.Start( threadCounts[t] ) )
+        {
+            printf( "    threads failed to start\n" );
+            return;
+        }
+
+        for ( int bChain = 0; bChain < 2; ++bChain )
+        {
+            TaskGraph graph;
+            for ( UINT i = 0; i < TASK_GRAPH_MAX_TASKS; ++i )
+            {
+                graph.AddTask( RunEmptyTask, NULL );
+                if ( bChain && i > 0 )
+                {
+                    graph.AddDependency( i - 1, i );
+                }
+            }
+
+            double start = TestSeconds( );
+            for ( UINT i = 0; i < cRuns; ++i )
+            {
+                scheduler.Submit( graph );
+                scheduler.Wait( graph );
+            }
+            double scheduled = (TestSeconds( ) - start) / cRuns;
+
+            start = TestSeconds( );
+            for ( UINT i = 0; i < cRuns; ++i )
+            {
+                graph.Run( );
+            }
+            double inlined = (TestSeconds( ) - start) / cRuns;
+
+            printf( "    %u threads, %s: %.3f us a task scheduled, %.4f us inline, %.2f us a graph\n",
+                scheduler.GetThreadCount( ), bChain ? "chain " : "fan-out",
+                scheduled * 1000000.0 / TASK_GRAPH_MAX_TASKS, inlined * 1000000.0 / TASK_GRAPH_MAX_TASKS, scheduled * 1000000.0 );
+        }
+
+        // The kernel, publishing depth, sampling the floor and the hands side by side, then the outputs and RGBX after the kernel
+        TaskGraph graph;
+        TEST_TASK tasks[_countof(frameStages)];
+        volatile LONG sequence = 0;
+        for ( UINT i = 0; i < _countof(frameStages); ++i )
+        {
+            tasks[i].pSequence = &sequence;
+            tasks[i].ranAt = -1;
+            tasks[i].cRuns = 0;
+            tasks[i].seconds = frameStages[i] * 1e-6;
+            graph.AddTask( RunTestTask, &tasks[i] );
+        }
+        graph.AddDependency( 0, 4 );
+        graph.AddDependency( 0, 5 );
+
+        double * pTimes = new double[cFrames];
+        for ( UINT i = 0; i < cFrames; ++i )
+        {
+            double start = TestSeconds( );
+            scheduler.Submit( graph );
+            scheduler.Wait( graph );
+            pTimes[i] = TestSeconds( ) - start;
+
+            // The gap until the next frame, with the workers gone to sleep
+            Sleep( 2 );
+        }
+        double scheduled = TestMedian( pTimes, cFrames );
+
+        double start = TestSeconds( );
+        graph.Run( );
+        double inlined = TestSeconds( ) - start;
+
+        printf( "    %u threads, depth frame stages: %.0f us scheduled, %.0f us inline, critical path %u us\n",
+            scheduler.GetThreadCount( ), scheduled * 1000000.0, inlined * 1000000.0, criticalPath );
+
+        delete [] pTimes;
+    }
+}
@@ -0,0 +1,345 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="TemporalDepthFilterTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// The temporal filters on a noisy wall with a box moving in front of it, how
+// close to the truth they stay, and what filtering a frame costs
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "TemporalDepthFilter.h"
+#include "ParallelRows.h"
+
+// Frames of a scene, rendered up front so that filtering is timed alone
+struct TEST_SCENE
+{
+    DWORD       width;
+    DWORD       height;
+    UINT        cFrames;
+    USHORT *    pDepth;         // packed depth and player index as the sensor gives it, with noise and holes
+    USHORT *    pTruth;         // depth without noise or holes, in millimeters
+};
+
+// How close a filter kept to the truth over a scene
+struct TEST_FILTER_QUALITY
+{
+    double      staticError;    // RMS error, in millimeters, of pixels whose truth hasn't changed for the whole history
+    double      ghosts;         // fraction of those pixels more than 100 mm off
+    double      movingGhosts;   // fraction of the pixels whose truth just changed, and that the sensor saw, more than 100 mm off
+    double      holes;          // fraction of pixels with no depth
+    UINT        cWrongPlayers;  // pixels whose player index isn't the source's
+    double      seconds;        // time to filter a frame
+};
+
+/// <summary>
+/// Normally distributed noise
+/// </summary>
+/// <param name="random">state of the sequence</param>
+/// <returns>sample with a mean of 0 and a standard deviation of 1</returns>
+static double Gaussian( UINT & random )
+{
+    // Sum of four uniform samples, scaled to unit variance
+    double sum = 0.0;
+    for ( int i = 0; i < 4; ++i )
+    {
+        sum += TestRandom( random ) / 32767.0 - 0.5;
+    }
+    return sum * 1.7320508;
+}
+
+/// <summary>
+/// Render a slanted wall from 2.5 to 3.5 meters with a player-sized box at
+/// 1.5 meters sliding across it, with the sensor's depth noise, pixels
+/// dropping out, and more of them along the box's edges
+/// </summary>
+/// <param name="scene">scene to render, with its size and frame count set</param>
+static void RenderScene( TEST_SCENE & scene )
+{
+    const DWORD cPixels = scene.width * scene.height;
+    scene.pDepth = new USHORT[cPixels * scene.cFrames];
+    scene.pTruth = new USHORT[cPixels * scene.cFrames];
+
+    UINT random = 7;
+    const LONG boxWidth = scene.width / 4;
+    const LONG boxTop = scene.height / 4;
+    const LONG boxBottom = boxTop + scene.height / 2;
+
+    for ( UINT f = 0; f < scene.cFrames; ++f )
+    {
+        // Slides right a 64th of the width a frame, and wraps around
+        LONG boxLeft = static_cast<LONG>((f * scene.width / 64) % scene.width) - boxWidth;
+
+        for ( DWORD y = 0; y < scene.height; ++y )
+        {
+            for ( DWORD x = 0; x < scene.width; ++x )
+            {
+                LONG dx = static_cast<LONG>(x) - boxLeft;
+                LONG dy = static_cast<LONG>(y);
+                bool bBox = dx >= 0 && dx < boxWidth && dy >= boxTop && dy < boxBottom;
+                bool bEdge = bBox && ( dx < 2 || dx >= boxWidth - 2 );
+
+                USHORT truth = static_cast<USHORT>(bBox ? 1500 : 2500 + 1000 * x / scene.width);
+                double sigma = 1.5 * (truth / 1000.0) * (truth / 1000.0);
+                LONG depth = static_cast<LONG>(truth + sigma * Gaussian( random ) + 0.5);
+
+                UINT holeChance = bEdge ? 50 : 3;
+                if ( TestRandom( random ) % 100 < holeChance )
+                {
+                    depth = 0;
+                }
+
+                DWORD i = f * cPixels + y * scene.width + x;
+                scene.pTruth[i] = truth;
+                scene.pDepth[i] = static_cast<USHORT>((depth << NUI_IMAGE_PLAYER_INDEX_SHIFT) | (bBox ? 1 : 0));
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Free the frames of a scene
+/// </summary>
+/// <param name="scene">scene to free</param>
+static void FreeScene( TEST_SCENE & scene )
+{
+    delete [] scene.pDepth;
+    delete [] scene.pTruth;
+    scene.pDepth = NULL;
+    scene.pTruth = NULL;
+}
+
+/// <summary>
+/// Run every frame of a scene through a filter, or none, and compare what comes out with the truth
+/// </summary>
+/// <param name="scene">scene to filter</param>
+/// <param name="pFilter">filter, NULL to measure the frames as they are</param>
+/// <param name="pRows">threads to split frames over, NULL for the caller's thread</param>
+/// <param name="cHistory">frames of history of the filter</param>
+/// <param name="quality">receives how close the output kept to the truth</param>
+static void MeasureFilter( const TEST_SCENE & scene, TemporalDepthFilter * pFilter, ParallelRows * pRows, UINT cHistory, TEST_FILTER_QUALITY & quality )
+{
+    const DWORD cPixels = scene.width * scene.height;
+
+    double sumSquares = 0.0;
+    double cStatic = 0.0, cGhosts = 0.0;
+    double cMoving = 0.0, cMovingGhosts = 0.0;
+    double cHoles = 0.0, cMeasured = 0.0;
+    double seconds = 0.0;
+    quality.cWrongPlayers = 0;
+
+    for ( UINT f = 0; f < scene.cFrames; ++f )
+    {
+        const USHORT * pSource = scene.pDepth + f * cPixels;
+        const USHORT * pOutput = pSource;
+        if ( pFilter )
+        {
+            double start = TestSeconds( );
+            pOutput = pFilter->Filter( pSource, scene.width * sizeof(USHORT), pRows );
+            seconds += TestSeconds( ) - start;
+        }
+
+        // Once the history is full
+        if ( f < cHistory )
+        {
+            continue;
+        }
+
+        const USHORT * pTruth = scene.pTruth + f * cPixels;
+        for ( DWORD i = 0; i < cPixels; ++i )
+        {
+            quality.cWrongPlayers += ( NuiDepthPixelToPlayerIndex( pOutput[i] ) == NuiDepthPixelToPlayerIndex( pSource[i] ) ) ? 0 : 1;
+
+            USHORT depth = NuiDepthPixelToDepth( pOutput[i] );
+            cMeasured += 1.0;
+            if ( 0 == depth )
+            {
+                cHoles += 1.0;
+                continue;
+            }
+
+            double error = static_cast<double>(depth) - pTruth[i];
+            bool bGhost = fabs( error ) > 100.0;
+
+            bool bSettled = true;
+            for ( UINT k = 1; k < cHistory && bSettled; ++k )
+            {
+                bSettled = ( pTruth[i] == (pTruth - k * cPixels)[i] );
+            }
+
+            if ( bSettled )
+            {
+                sumSquares += error * error;
+                cStatic += 1.0;
+                cGhosts += bGhost ? 1.0 : 0.0;
+            }
+            else if ( pTruth[i] != (pTruth - cPixels)[i] && 0 != NuiDepthPixelToDepth( pSource[i] ) )
+            {
+                cMoving += 1.0;
+                cMovingGhosts += bGhost ? 1.0 : 0.0;
+            }
+        }
+    }
+
+    quality.staticError = cStatic ? sqrt( sumSquares / cStatic ) : 0.0;
+    quality.ghosts = cStatic ? cGhosts / cStatic : 0.0;
+    quality.movingGhosts = cMoving ? cMovingGhosts / cMoving : 0.0;
+    quality.holes = cMeasured ? cHoles / cMeasured : 0.0;
+    quality.seconds = seconds / scene.cFrames;
+}
+
+/// <summary>
+/// Both modes cut the noise of still depth to well under the sensor's, leave
+/// no ghosts behind once the history has caught up, fill holes only when
+/// asked to, and keep the player index of every pixel; the blend follows
+/// moving edges at once, frames split over threads or read from padded rows
+/// come out the same, and history lengths out of range are refused
+/// </summary>
+void TestTemporalDepthFilter( )
+{
+    TEST_SCENE scene;
+    scene.width = 320;
+    scene.height = 240;
+    scene.cFrames = 40;
+    RenderScene( scene );
+
+    const DWORD cPixels = scene.width * scene.height;
+    const UINT cHistory = TEMPORAL_FILTER_DEFAULT_FRAMES;
+
+    TEST_FILTER_QUALITY raw;
+    MeasureFilter( scene, NULL, NULL, cHistory, raw );
+
+    static const int modes[] = { TEMPORAL_FILTER_MEDIAN, TEMPORAL_FILTER_BLEND };
+    for ( UINT m = 0; m < _countof(modes); ++m )
+    {
+        for ( int bFillHoles = 1; bFillHoles >= 0; --bFillHoles )
+        {
+            TemporalDepthFilter filter;
+            TEST_CHECK( filter.Initialize( NUI_IMAGE_RESOLUTION_320x240, cHistory ) );
+            filter.SetMode( modes[m], 0 != bFillHoles );
+
+            TEST_FILTER_QUALITY quality;
+            MeasureFilter( scene, &filter, NULL, cHistory, quality );
+
+            TEST_CHECK( quality.staticError < raw.staticError * 0.75 );
+            TEST_CHECK( quality.ghosts < 0.001 );
+            TEST_CHECK( 0 == quality.cWrongPlayers );
+            if ( bFillHoles )
+            {
+                TEST_CHECK( quality.holes < raw.holes * 0.25 );
+            }
+            else
+            {
+                TEST_CHECK( fabs( quality.holes - raw.holes ) < 1e-9 );
+            }
+
+            if ( TEMPORAL_FILTER_BLEND == modes[m] )
+            {
+                TEST_CHECK( quality.movingGhosts < 0.01 );
+            }
+        }
+    }
+
+    // Split over two threads, and with the source read from rows twice as long as the frame's
+    TaskScheduler scheduler;
+    TEST_CHECK( scheduler.Start( 2 ) );
+    ParallelRows rows( scheduler );
+    USHORT * pPadded = new USHORT[cPixels * 2];
+    ZeroMemory( pPadded, cPixels * 2 * sizeof(USHORT) );
+
+    for ( UINT m = 0; m < _countof(modes); ++m )
+    {
+        TemporalDepthFilter single, split, padded;
+        TEST_CHECK( single.Initialize( NUI_IMAGE_RESOLUTION_320x240, cHistory ) );
+        TEST_CHECK( split.Initialize( NUI_IMAGE_RESOLUTION_320x240, cHistory ) );
+        TEST_CHECK( padded.Initialize( NUI_IMAGE_RESOLUTION_320x240, cHistory ) );
+        single.SetMode( modes[m], true );
+        split.SetMode( modes[m], true );
+        padded.SetMode( modes[m], true );
+
+        UINT cDiffering = 0;
+        for ( UINT f = 0; f < scene.cFrames; ++f )
+        {
+            const USHORT * pSource = scene.pDepth + f * cPixels;
+            for ( DWORD y = 0; y < scene.height; ++y )
+            {
+                CopyMemory( pPadded + y * scene.width * 2, pSource + y * scene.width, scene.width * sizeof(USHORT) );
+            }
+
+            const USHORT * pSingle = single.Filter( pSource, scene.width * sizeof(USHORT), NULL );
+            const USHORT * pSplit = split.Filter( pSource, scene.width * sizeof(USHORT), &rows );
+            const USHORT * pFromPadded = padded.Filter( pPadded, scene.width * 2 * sizeof(USHORT), NULL );
+            cDiffering += ( 0 == memcmp( pSingle, pSplit, cPixels * sizeof(USHORT) ) ) ? 0 : 1;
+            cDiffering += ( 0 == memcmp( pSingle, pFromPadded, cPixels * sizeof(USHORT) ) ) ? 0 : 1;
+        }
+        TEST_CHECK( 0 == cDiffering );
+    }
+
+    delete [] pPadded;
+    FreeScene( scene );
+
+    TemporalDepthFilter filter;
+    TEST_CHECK( !filter.Initialize( NUI_IMAGE_RESOLUTION_320x240, 1 ) );
+    TEST_CHECK( !filter.Initialize( NUI_IMAGE_RESOLUTION_320x240, TEMPORAL_FILTER_MAX_FRAMES + 1 ) );
+    TEST_CHECK( !filter.Initialize( NUI_IMAGE_RESOLUTION_INVALID, cHistory ) );
+    TEST_CHECK( filter.Initialize( NUI_IMAGE_RESOLUTION_640x480, 2 ) );
+    TEST_CHECK( filter.Initialize( NUI_IMAGE_RESOLUTION_640x480, TEMPORAL_FILTER_MAX_FRAMES ) );
+}
+
+/// <summary>
+/// Time both modes at both depth resolutions on one and two threads, with
+/// how close each keeps to the truth against the frames as they come
+/// </summary>
+void BenchTemporalDepthFilter( )
+{
+    static const NUI_IMAGE_RESOLUTION resolutions[] = { NUI_IMAGE_RESOLUTION_320x240, NUI_IMAGE_RESOLUTION_640x480 };
+    static const int modes[] = { TEMPORAL_FILTER_MEDIAN, TEMPORAL_FILTER_BLEND };
+    static const char * modeNames[] = { "median", "blend " };
+    const UINT cHistory = TEMPORAL_FILTER_DEFAULT_FRAMES;
+
+    TaskScheduler scheduler;
+    if ( !scheduler.Start( 2 ) )
+    {
+        printf( "    threads failed to start\n" );
+        return;
+    }
+    ParallelRows rows( scheduler );
+
+    for ( UINT r = 0; r < _countof(resolutions); ++r )
+    {
+        TEST_SCENE scene;
+        NuiImageResolutionToSize( resolutions[r], scene.width, scene.height );
+        scene.cFrames = 64;
+        RenderScene( scene );
+
+        TEST_FILTER_QUALITY raw;
+        MeasureFilter( scene, NULL, NULL, cHistory, raw );
+        printf( "    %ux%u, raw:    still depth off by %.1f mm, %.2f%% holes\n",
+            scene.width, scene.height, raw.staticError, raw.holes * 100.0 );
+
+        for ( UINT m = 0; m < _countof(modes); ++m )
+        {
+            for ( UINT cThreads = 1; cThreads <= 2; ++cThreads )
+            {
+                TemporalDepthFilter filter;
+                if ( !filter.Initialize( resolutions[r], cHistory ) )
+                {
+                    printf( "    filter failed to initialize\n" );
+                    FreeScene( scene );
+                    return;
+                }
+                filter.SetMode( modes[m], true );
+
+                TEST_FILTER_QUALITY quality;
+                MeasureFilter( scene, &filter, ( 2 == cThreads ) ? &rows : NULL, cHistory, quality );
+
+                printf( "    %ux%u, %s, %u thread%s: %.3f ms a frame, still depth off by %.1f mm, %.2f%% of moving edges behind, %.2f%% holes\n",
+                    scene.width, scene.height, modeNames[m], cThreads, ( 1 == cThreads ) ? " " : "s",
+                    quality.seconds * 1000.0, quality.staticError, quality.movingGhosts * 100.0, quality.holes * 100.0 );
+            }
+        }
+
+        FreeScene( scene );
+    }
+}
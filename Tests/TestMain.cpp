@@ -0,0 +1,253 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="TestMain.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Runs the headless tests, and the benchmarks when asked to
+//   SkeletalViewerTests [-bench] [-recording:file] [name ...]
+//   -bench            also run the benchmarks, which print their figures
+//   -recording:file   depth recording made with SkeletalViewer -record:file, for benchmarks to replay
+//   name              only run the tests and benchmarks whose names start with one of these
+// The exit code is the number of tests that failed.
+
+#include "stdafx.h"
+#include "Tests.h"
+
+struct TEST_ENTRY
+{
+    const char *    szName;
+    void            (*pfnRun)( );
+};
+
+static const TEST_ENTRY g_Tests[] =
+{
+    { "DepthCodecRoundTrip",              TestDepthCodecRoundTrip },
+    { "DepthCodecRecording",              TestDepthCodecRecording },
+    { "DepthHistogram",                   TestDepthHistogram },
+    { "DepthKernel",                      TestDepthKernel },
+    { "DepthKernelStreams",               TestDepthKernelStreams },
+    { "FloorEstimator",                   TestFloorEstimator },
+    { "FrameSource",                      TestFrameSource },
+    { "GestureEngine",                    TestGestureEngine },
+    { "GreenScreen",                      TestGreenScreen },
+    { "HandAnalyzer",                     TestHandAnalyzer },
+    { "ImageChannelRoundTrip",            TestImageChannelRoundTrip },
+    { "ImageChannelRingLimits",           TestImageChannelRingLimits },
+    { "InfraredToneMap",                  TestInfraredToneMap },
+    { "JointPredictor",                   TestJointPredictor },
+    { "PlayerSegmentation",               TestPlayerSegmentation },
+    { "PointCloud",                       TestPointCloud },
+    { "RegistrationMap",                  TestRegistrationMap },
+    { "SensorConnection",                 TestSensorConnection },
+    { "SkeletalFrames",                   TestSkeletalFrames },
+    { "SkeletonKinematics",               TestSkeletonKinematics },
+    { "SkeletonPublisherSharedMemory",    TestSkeletonPublisherSharedMemory },
+    { "SkeletonPublisherUdp",             TestSkeletonPublisherUdp },
+    { "SkeletonSelector",                 TestSkeletonSelector },
+    { "SpatialDepthFilter",               TestSpatialDepthFilter },
+    { "TaskScheduler",                    TestTaskScheduler },
+    { "TemporalDepthFilter",              TestTemporalDepthFilter },
+    { "ZoneEngine",                       TestZoneEngine },
+};
+
+static const TEST_ENTRY g_Benchmarks[] =
+{
+    { "DepthCodec",                       BenchDepthCodec },
+    { "DepthHistogram",                   BenchDepthHistogram },
+    { "DepthKernel",                      BenchDepthKernel },
+    { "DepthKernelStreams",               BenchDepthKernelStreams },
+    { "FloorEstimator",                   BenchFloorEstimator },
+    { "FrameSource",                      BenchFrameSource },
+    { "GestureEngine",                    BenchGestureEngine },
+    { "GreenScreen",                      BenchGreenScreen },
+    { "HandAnalyzer",                     BenchHandAnalyzer },
+    { "InfraredToneMap",                  BenchInfraredToneMap },
+    { "PlayerSegmentation",               BenchPlayerSegmentation },
+    { "PointCloud",                       BenchPointCloud },
+    { "RegistrationMap",                  BenchRegistrationMap },
+    { "SkeletonKinematics",               BenchSkeletonKinematics },
+    { "SkeletonPublisher",                BenchSkeletonPublisher },
+    { "SkeletonSelector",                 BenchSkeletonSelector },
+    { "SpatialDepthFilter",               BenchSpatialDepthFilter },
+    { "TaskScheduler",                    BenchTaskScheduler },
+    { "TemporalDepthFilter",              BenchTemporalDepthFilter },
+    { "ZoneEngine",                       BenchZoneEngine },
+};
+
+const WCHAR * g_szTestRecording = NULL;
+
+// Checks of the test running now
+static UINT g_cChecks;
+static UINT g_cFailedChecks;
+
+/// <summary>
+/// Count a check, and report it if it failed
+/// </summary>
+/// <param name="bPassed">whether the condition held</param>
+/// <param name="szCondition">text of the condition</param>
+/// <param name="szFile">source file of the check</param>
+/// <param name="line">line of the check</param>
+void TestCheck( bool bPassed, const char * szCondition, const char * szFile, int line )
+{
+    ++g_cChecks;
+
+    if ( !bPassed )
+    {
+        ++g_cFailedChecks;
+        printf( "    %s(%d): failed %s\n", szFile, line, szCondition );
+    }
+}
+
+/// <summary>
+/// Time to measure benchmarks with
+/// </summary>
+/// <returns>seconds since an arbitrary start</returns>
+double TestSeconds( )
+{
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter( &now );
+    QueryPerformanceFrequency( &frequency );
+
+    return static_cast<double>(now.QuadPart) / frequency.QuadPart;
+}
+
+/// <summary>
+/// Orders two doubles for qsort
+/// </summary>
+/// <param name="pA">first value</param>
+/// <param name="pB">second value</param>
+/// <returns>negative, zero or positive as the first is less, equal or greater</returns>
+static int __cdecl CompareDoubles( const void * pA, const void * pB )
+{
+    double a = *static_cast<const double *>(pA);
+    double b = *static_cast<const double *>(pB);
+
+    return ( a < b ) ? -1 : ( a > b ) ? 1 : 0;
+}
+
+/// <summary>
+/// Median of a set of values, which are sorted in place
+/// </summary>
+/// <param name="pValues">values</param>
+/// <param name="cValues">number of values, at least 1</param>
+/// <returns>median</returns>
+double TestMedian( double * pValues, UINT cValues )
+{
+    qsort( pValues, cValues, sizeof(double), CompareDoubles );
+
+    return pValues[cValues / 2];
+}
+
+/// <summary>
+/// Next number of a repeatable pseudo-random sequence
+/// </summary>
+/// <param name="state">state of the sequence, seeded by the caller</param>
+/// <returns>number from 0 to 32767</returns>
+UINT TestRandom( UINT & state )
+{
+    state = state * 214013 + 2531011;
+
+    return (state >> 16) & 0x7FFF;
+}
+
+/// <summary>
+/// Whether a test or benchmark was asked for on the command line
+/// </summary>
+/// <param name="szName">name of the test or benchmark</param>
+/// <param name="argc">number of arguments</param>
+/// <param name="argv">arguments</param>
+/// <returns>true if no names were given or one of them starts the name, false otherwise</returns>
+static bool IsSelected( const char * szName, int argc, char * argv[] )
+{
+    bool bAnyNames = false;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( '-' == argv[i][0] || '/' == argv[i][0] )
+        {
+            continue;
+        }
+
+        bAnyNames = true;
+        if ( 0 == _strnicmp( szName, argv[i], strlen(argv[i]) ) )
+        {
+            return true;
+        }
+    }
+
+    return !bAnyNames;
+}
+
+/// <summary>
+/// Entry point
+/// </summary>
+/// <param name="argc">number of arguments</param>
+/// <param name="argv">arguments</param>
+/// <returns>number of tests that failed</returns>
+int __cdecl main( int argc, char * argv[] )
+{
+    bool bBenchmarks = false;
+    WCHAR szRecording[MAX_PATH];
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( '-' != argv[i][0] && '/' != argv[i][0] )
+        {
+            continue;
+        }
+
+        const char * szSwitch = argv[i] + 1;
+
+        if ( 0 == _stricmp( szSwitch, "bench" ) )
+        {
+            bBenchmarks = true;
+        }
+        else if ( 0 == _strnicmp( szSwitch, "recording:", 10 ) &&
+                  0 != MultiByteToWideChar( CP_ACP, 0, szSwitch + 10, -1, szRecording, _countof(szRecording) ) )
+        {
+            g_szTestRecording = szRecording;
+        }
+    }
+
+    UINT cRun = 0;
+    UINT cFailed = 0;
+
+    for ( UINT i = 0; i < _countof(g_Tests); ++i )
+    {
+        if ( !IsSelected( g_Tests[i].szName, argc, argv ) )
+        {
+            continue;
+        }
+
+        g_cChecks = 0;
+        g_cFailedChecks = 0;
+
+        printf( "%s\n", g_Tests[i].szName );
+        g_Tests[i].pfnRun( );
+
+        ++cRun;
+        if ( g_cFailedChecks > 0 || 0 == g_cChecks )
+        {
+            ++cFailed;
+            printf( "    FAILED, %u of %u checks\n", g_cFailedChecks, g_cChecks );
+        }
+        else
+        {
+            printf( "    passed, %u checks\n", g_cChecks );
+        }
+    }
+
+    for ( UINT i = 0; bBenchmarks && i < _countof(g_Benchmarks); ++i )
+    {
+        if ( IsSelected( g_Benchmarks[i].szName, argc, argv ) )
+        {
+            printf( "%s benchmark\n", g_Benchmarks[i].szName );
+            g_Benchmarks[i].pfnRun( );
+        }
+    }
+
+    printf( "%u of %u tests passed\n", cRun - cFailed, cRun );
+
+    return static_cast<int>(cFailed);
+}
@@ -0,0 +1,140 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="Tests.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Headless tests and benchmarks of the pipeline stages, run without a sensor
+// or a window.  Each is a function listed in TestMain.cpp: a test reports
+// the checks that fail with TEST_CHECK, a benchmark prints its figures.
+
+#pragma once
+
+// Check a condition, reporting it and failing the test if it doesn't hold
+#define TEST_CHECK( condition )     TestCheck( (condition), #condition, __FILE__, __LINE__ )
+
+// Depth recording given with -recording:file, for benchmarks to replay; NULL if none
+extern const WCHAR * g_szTestRecording;
+
+/// <summary>
+/// Count a check, and report it if it failed
+/// </summary>
+/// <param name="bPassed">whether the condition held</param>
+/// <param name="szCondition">text of the condition</param>
+/// <param name="szFile">source file of the check</param>
+/// <param name="line">line of the check</param>
+void TestCheck( bool bPassed, const char * szCondition, const char * szFile, int line );
+
+/// <summary>
+/// Time to measure benchmarks with
+/// </summary>
+/// <returns>seconds since an arbitrary start</returns>
+double TestSeconds( );
+
+/// <summary>
+/// Median of a set of values, which are sorted in place
+/// </summary>
+/// <param name="pValues">values</param>
+/// <param name="cValues">number of values, at least 1</param>
+/// <returns>median</returns>
+double TestMedian( double * pValues, UINT cValues );
+
+/// <summary>
+/// Next number of a repeatable pseudo-random sequence
+/// </summary>
+/// <param name="state">state of the sequence, seeded by the caller</param>
+/// <returns>number from 0 to 32767</returns>
+UINT TestRandom( UINT & state );
+
+// DepthCodecTests.cpp
+void TestDepthCodecRoundTrip( );
+void TestDepthCodecRecording( );
+void BenchDepthCodec( );
+
+// DepthHistogramTests.cpp
+void TestDepthHistogram( );
+void BenchDepthHistogram( );
+
+// DepthKernelTests.cpp
+void TestDepthKernel( );
+void TestDepthKernelStreams( );
+void BenchDepthKernel( );
+void BenchDepthKernelStreams( );
+
+// FloorEstimatorTests.cpp
+void TestFloorEstimator( );
+void BenchFloorEstimator( );
+
+// FrameSourceTests.cpp
+void TestFrameSource( );
+void BenchFrameSource( );
+
+// GestureEngineTests.cpp
+void TestGestureEngine( );
+void BenchGestureEngine( );
+
+// GreenScreenTests.cpp
+void TestGreenScreen( );
+void BenchGreenScreen( );
+
+// HandAnalyzerTests.cpp
+void TestHandAnalyzer( );
+void BenchHandAnalyzer( );
+
+// ImageChannelTests.cpp
+void TestImageChannelRoundTrip( );
+void TestImageChannelRingLimits( );
+
+// InfraredToneMapTests.cpp
+void TestInfraredToneMap( );
+void BenchInfraredToneMap( );
+
+// JointPredictorTests.cpp
+void TestJointPredictor( );
+
+// PlayerSegmentationTests.cpp
+void TestPlayerSegmentation( );
+void BenchPlayerSegmentation( );
+
+// PointCloudTests.cpp
+void TestPointCloud( );
+void BenchPointCloud( );
+
+// RegistrationMapTests.cpp
+void TestRegistrationMap( );
+void BenchRegistrationMap( );
+
+// SensorConnectionTests.cpp
+void TestSensorConnection( );
+
+// SkeletalFramesTests.cpp
+void TestSkeletalFrames( );
+
+// SkeletonKinematicsTests.cpp
+void TestSkeletonKinematics( );
+void BenchSkeletonKinematics( );
+
+// SkeletonPublisherTests.cpp
+void TestSkeletonPublisherSharedMemory( );
+void TestSkeletonPublisherUdp( );
+void BenchSkeletonPublisher( );
+
+// SkeletonSelectorTests.cpp
+void TestSkeletonSelector( );
+void BenchSkeletonSelector( );
+
+// SpatialDepthFilterTests.cpp
+void TestSpatialDepthFilter( );
+void BenchSpatialDepthFilter( );
+
+// TaskSchedulerTests.cpp
+void TestTaskScheduler( );
+void BenchTaskScheduler( );
+
+// TemporalDepthFilterTests.cpp
+void TestTemporalDepthFilter( );
+void BenchTemporalDepthFilter( );
+
+// ZoneEngineTests.cpp
+void TestZoneEngine( );
+void BenchZoneEngine( );
@@ -0,0 +1,377 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ZoneEngineTests.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Zone events of six moving skeletons against every joint tested against
+// every zone, and what a frame costs each way as the zones grow to 1,000
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "ZoneEngine.h"
+
+static const float g_TestPi = 3.14159265f;
+
+// Milliseconds between frames, as the sensor sends them
+static const UINT g_FrameInterval = 33;
+
+/// <summary>
+/// Random number between two bounds
+/// </summary>
+/// <param name="random">state of the sequence</param>
+/// <param name="low">smallest number</param>
+/// <param name="high">largest number</param>
+/// <returns>random number</returns>
+static float RandomBetween( UINT & random, float low, float high )
+{
+    return low + (high - low) * (TestRandom( random ) / 32767.0f);
+}
+
+/// <summary>
+/// Add boxes from 0.2 to 0.8 meters on a side, scattered over the space
+/// skeletons move in
+/// </summary>
+/// <param name="zones">engine to add to</param>
+/// <param name="pMinimums">receives the corner of each box with the smallest coordinates</param>
+/// <param name="pMaximums">receives the corner with the largest coordinates</param>
+/// <param name="cZones">number of boxes</param>
+/// <param name="random">state of the sequence</param>
+static void AddRandomZones( ZoneEngine & zones, Vector4 * pMinimums, Vector4 * pMaximums, UINT cZones, UINT & random )
+{
+    for ( UINT zone = 0; zone < cZones; ++zone )
+    {
+        Vector4 & minimum = pMinimums[zone];
+        Vector4 & maximum = pMaximums[zone];
+        minimum.x = RandomBetween( random, -2.0f, 2.0f );
+        minimum.y = RandomBetween( random, -1.0f, 1.5f );
+        minimum.z = RandomBetween( random, 1.0f, 3.5f );
+        minimum.w = 1.0f;
+        maximum.x = minimum.x + RandomBetween( random, 0.2f, 0.8f );
+        maximum.y = minimum.y + RandomBetween( random, 0.2f, 0.8f );
+        maximum.z = minimum.z + RandomBetween( random, 0.2f, 0.8f );
+        maximum.w = 1.0f;
+
+        WCHAR szName[ZONE_MAX_NAME];
+        StringCchPrintfW( szName, _countof(szName), L"zone%u", zone );
+        zones.AddZone( szName, minimum, maximum );
+    }
+}
+
+/// <summary>
+/// Fill a frame with six skeletons walking about the room, every joint
+/// swinging at its own rate
+/// </summary>
+/// <param name="frame">frame to fill</param>
+/// <param name="number">frame number, from 0</param>
+static void MakeFrame( NUI_SKELETON_FRAME & frame, UINT number )
+{
+    ZeroMemory( &frame, sizeof(frame) );
+    frame.liTimeStamp.QuadPart = 1000 + number * g_FrameInterval;
+    frame.dwFrameNumber = number + 1;
+
+    float t = number * g_FrameInterval * 0.001f;
+    for ( int skeleton = 0; skeleton < NUI_SKELETON_COUNT; ++skeleton )
+    {
+        NUI_SKELETON_DATA & data = frame.SkeletonData[skeleton];
+        data.eTrackingState = NUI_SKELETON_TRACKED;
+        data.dwTrackingID = skeleton + 1;
+
+        float walk = 2.0f * g_TestPi * (0.05f + 0.02f * skeleton) * t;
+        float centerX = 1.5f * sinf( walk + skeleton );
+        float centerZ = 2.5f + 0.8f * cosf( 1.3f * walk );
+
+        for ( int joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+        {
+            float rate = 2.0f * g_TestPi * (0.4f + 0.04f * joint);
+            Vector4 & position = data.SkeletonPositions[joint];
+            position.x = centerX + 0.3f * sinf( rate * t + joint );
+            position.y = -0.9f + 0.1f * joint + 0.1f * cosf( rate * t );
+            position.z = centerZ + 0.2f * sinf( 0.7f * rate * t );
+            position.w = 1.0f;
+            data.eSkeletonPositionTrackingState[joint] = NUI_SKELETON_POSITION_TRACKED;
+        }
+    }
+}
+
+/// <summary>
+/// Order of events for comparing two lists of them
+/// </summary>
+/// <param name="pA">first event</param>
+/// <param name="pB">second event</param>
+/// <returns>negative, zero or positive as for qsort</returns>
+static int __cdecl CompareEvents( const void * pA, const void * pB )
+{
+    const ZONE_EVENT & a = *static_cast<const ZONE_EVENT *>(pA);
+    const ZONE_EVENT & b = *static_cast<const ZONE_EVENT *>(pB);
+
+    if ( a.dwTrackingID != b.dwTrackingID ) return ( a.dwTrackingID < b.dwTrackingID ) ? -1 : 1;
+    if ( a.joint != b.joint ) return ( a.joint < b.joint ) ? -1 : 1;
+    if ( a.zone != b.zone ) return ( a.zone < b.zone ) ? -1 : 1;
+    return static_cast<int>(a.bEnter) - static_cast<int>(b.bEnter);
+}
+
+/// <summary>
+/// Zones of every joint of six skeletons found by testing every zone, for
+/// checking the engine against and timing it against
+/// </summary>
+class BruteForceZones
+{
+public:
+    BruteForceZones( const Vector4 * pMinimums, const Vector4 * pMaximums, UINT cZones ) :
+        m_pMinimums(pMinimums), m_pMaximums(pMaximums), m_cZones(cZones)
+    {
+        m_pInside = new bool[NUI_SKELETON_COUNT * NUI_SKELETON_POSITION_COUNT * cZones];
+        ZeroMemory( m_pInside, NUI_SKELETON_COUNT * NUI_SKELETON_POSITION_COUNT * cZones * sizeof(bool) );
+        ZeroMemory( m_trackingIDs, sizeof(m_trackingIDs) );
+    }
+
+    ~BruteForceZones( )
+    {
+        delete [] m_pInside;
+    }
+
+    /// <summary>
+    /// Test every joint against every zone and report the changes, keeping
+    /// only the first ZONE_MAX_OCCUPIED zones of a joint as the engine does
+    /// </summary>
+    /// <param name="frame">skeleton frame</param>
+    /// <param name="pEvents">receives the events</param>
+    /// <param name="cMaxEvents">room in pEvents</param>
+    /// <returns>number of events</returns>
+    UINT Update( const NUI_SKELETON_FRAME & frame, ZONE_EVENT * pEvents, UINT cMaxEvents )
+    {
+        UINT cEvents = 0;
+        for ( UINT skeleton = 0; skeleton < NUI_SKELETON_COUNT; ++skeleton )
+        {
+            const NUI_SKELETON_DATA & data = frame.SkeletonData[skeleton];
+            bool bTracked = ( NUI_SKELETON_TRACKED == data.eTrackingState );
+            DWORD dwTrackingID = bTracked ? data.dwTrackingID : 0;
+
+            // Someone new in this place takes everyone who was here out of their zones
+            for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+            {
+                bool * pInside = m_pInside + (skeleton * NUI_SKELETON_POSITION_COUNT + joint) * m_cZones;
+                bool bKeep = bTracked && dwTrackingID == m_trackingIDs[skeleton] &&
+                             NUI_SKELETON_POSITION_NOT_TRACKED == data.eSkeletonPositionTrackingState[joint];
+                if ( bKeep )
+                {
+                    continue;
+                }
+
+                const Vector4 & point = data.SkeletonPositions[joint];
+                UINT cOccupied = 0;
+                for ( UINT zone = 0; zone < m_cZones; ++zone )
+                {
+                    bool bInside = bTracked && NUI_SKELETON_POSITION_NOT_TRACKED != data.eSkeletonPositionTrackingState[joint] &&
+                        cOccupied < ZONE_MAX_OCCUPIED &&
+                        point.x >= m_pMinimums[zone].x && point.x <= m_pMaximums[zone].x &&
+                        point.y >= m_pMinimums[zone].y && point.y <= m_pMaximums[zone].y &&
+                        point.z >= m_pMinimums[zone].z && point.z <= m_pMaximums[zone].z;
+                    cOccupied += bInside ? 1 : 0;
+
+                    if ( bInside != pInside[zone] || (pInside[zone] && dwTrackingID != m_trackingIDs[skeleton]) )
+                    {
+                        if ( pInside[zone] && cEvents < cMaxEvents )
+                        {
+                            ZONE_EVENT & event = pEvents[cEvents++];
+                            event.dwTrackingID = m_trackingIDs[skeleton];
+                            event.joint = static_cast<NUI_SKELETON_POSITION_INDEX>(joint);
+                            event.zone = zone;
+                            event.bEnter = false;
+                        }
+                        if ( bInside && cEvents < cMaxEvents )
+                        {
+                            ZONE_EVENT & event = pEvents[cEvents++];
+                            event.dwTrackingID = dwTrackingID;
+                            event.joint = static_cast<NUI_SKELETON_POSITION_INDEX>(joint);
+                            event.zone = zone;
+                            event.bEnter = true;
+                        }
+                        pInside[zone] = bInside;
+                    }
+                }
+            }
+
+            m_trackingIDs[skeleton] = dwTrackingID;
+        }
+
+        return cEvents;
+    }
+
+private:
+    const Vector4 * m_pMinimums;
+    const Vector4 * m_pMaximums;
+    UINT            m_cZones;
+    bool *          m_pInside;
+    DWORD           m_trackingIDs[NUI_SKELETON_COUNT];
+};
+
+/// <summary>
+/// Events match testing every joint against every zone, from 10 to 1,000
+/// zones, with skeletons leaving, joints lost for a frame and tracking IDs
+/// changing; nothing is reported while joints stay put; a full event list
+/// is cut short rather than overrun; empty boxes and unreadable files are
+/// refused
+/// </summary>
+void TestZoneEngine( )
+{
+    static const UINT zoneCounts[] = { 10, 100, 1000 };
+    const UINT cFrames = 300;
+    const UINT cMaxEvents = NUI_SKELETON_COUNT * NUI_SKELETON_POSITION_COUNT * ZONE_MAX_OCCUPIED * 2;
+
+    Vector4 * pMinimums = new Vector4[1000];
+    Vector4 * pMaximums = new Vector4[1000];
+    ZONE_EVENT * pEvents = new ZONE_EVENT[cMaxEvents];
+    ZONE_EVENT * pExpected = new ZONE_EVENT[cMaxEvents];
+
+    for ( UINT c = 0; c < _countof(zoneCounts); ++c )
+    {
+        UINT random = 7 + c;
+        ZoneEngine zones;
+        AddRandomZones( zones, pMinimums, pMaximums, zoneCounts[c], random );
+        TEST_CHECK( zoneCounts[c] == zones.GetZoneCount( ) );
+        BruteForceZones bruteForce( pMinimums, pMaximums, zoneCounts[c] );
+
+        UINT cWrong = 0, cTotal = 0;
+        NUI_SKELETON_FRAME frame;
+        for ( UINT number = 0; number < cFrames; ++number )
+        {
+            MakeFrame( frame, number );
+
+            // Skeleton 2 leaves for a while, 4 is replaced by someone new, 5 loses its hands now and then
+            if ( number >= 100 && number < 150 )
+            {
+                frame.SkeletonData[2].eTrackingState = NUI_SKELETON_POSITION_ONLY;
+            }
+            if ( number >= 200 )
+            {
+                frame.SkeletonData[4].dwTrackingID = 40;
+            }
+            if ( 0 == number % 7 )
+            {
+                frame.SkeletonData[5].eSkeletonPositionTrackingState[NUI_SKELETON_POSITION_HAND_LEFT] = NUI_SKELETON_POSITION_NOT_TRACKED;
+                frame.SkeletonData[5].eSkeletonPositionTrackingState[NUI_SKELETON_POSITION_HAND_RIGHT] = NUI_SKELETON_POSITION_NOT_TRACKED;
+            }
+
+            UINT cEvents = zones.Update( frame, pEvents, cMaxEvents );
+            UINT cExpected = bruteForce.Update( frame, pExpected, cMaxEvents );
+            qsort( pEvents, cEvents, sizeof(ZONE_EVENT), CompareEvents );
+            qsort( pExpected, cExpected, sizeof(ZONE_EVENT), CompareEvents );
+
+            cWrong += ( cEvents == cExpected ) ? 0 : 1;
+            for ( UINT i = 0; i < cEvents && i < cExpected; ++i )
+            {
+                cWrong += ( 0 == CompareEvents( &pEvents[i], &pExpected[i] ) ) ? 0 : 1;
+            }
+            cTotal += cEvents;
+        }
+        TEST_CHECK( 0 == cWrong );
+        TEST_CHECK( cTotal > 0 );
+
+        // Standing still
+        TEST_CHECK( 0 == zones.Update( frame, pEvents, cMaxEvents ) );
+
+        // Everyone leaving takes every joint out of every zone it was in
+        UINT cOccupied = 0;
+        for ( UINT skeleton = 0; skeleton < NUI_SKELETON_COUNT; ++skeleton )
+        {
+            for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+            {
+                const Vector4 & point = frame.SkeletonData[skeleton].SkeletonPositions[joint];
+                UINT cInside = 0;
+                for ( UINT zone = 0; zone < zoneCounts[c]; ++zone )
+                {
+                    cInside += ( point.x >= pMinimums[zone].x && point.x <= pMaximums[zone].x &&
+                                 point.y >= pMinimums[zone].y && point.y <= pMaximums[zone].y &&
+                                 point.z >= pMinimums[zone].z && point.z <= pMaximums[zone].z ) ? 1 : 0;
+                }
+                cOccupied += min( cInside, ZONE_MAX_OCCUPIED );
+            }
+        }
+
+        NUI_SKELETON_FRAME empty;
+        ZeroMemory( &empty, sizeof(empty) );
+        UINT cEvents = zones.Update( empty, pEvents, cMaxEvents );
+        UINT cLeft = 0;
+        for ( UINT i = 0; i < cEvents; ++i )
+        {
+            cLeft += pEvents[i].bEnter ? 0 : 1;
+        }
+        TEST_CHECK( cOccupied == cEvents && cOccupied == cLeft );
+
+        // Coming back with room for only a few events
+        UINT cCut = zones.Update( frame, pEvents, 3 );
+        TEST_CHECK( cOccupied >= 3 ? 3 == cCut : cOccupied == cCut );
+        TEST_CHECK( 0 == zones.Update( frame, pEvents, cMaxEvents ) );
+    }
+
+    // Boxes with no volume, and a file that isn't there
+    ZoneEngine zones;
+    Vector4 minimum = { 0.0f, 0.0f, 1.0f, 1.0f };
+    Vector4 maximum = { 1.0f, 1.0f, 1.0f, 1.0f };
+    TEST_CHECK( -1 == zones.AddZone( L"flat", minimum, maximum ) );
+    maximum.z = 2.0f;
+    TEST_CHECK( 0 == zones.AddZone( L"box", minimum, maximum ) );
+    TEST_CHECK( 0 == wcscmp( zones.GetName( 0 ), L"box" ) );
+    TEST_CHECK( -1 == zones.LoadZones( L"ZoneEngineTests-missing.txt" ) );
+    TEST_CHECK( 1 == zones.GetZoneCount( ) );
+
+    delete [] pExpected;
+    delete [] pEvents;
+    delete [] pMaximums;
+    delete [] pMinimums;
+}
+
+/// <summary>
+/// Time a frame of six skeletons through the grid and through testing every
+/// joint against every zone, from 10 to 1,000 zones
+/// </summary>
+void BenchZoneEngine( )
+{
+    static const UINT zoneCounts[] = { 10, 100, 500, 1000 };
+    const UINT cFrames = 2000;
+    const UINT cMaxEvents = NUI_SKELETON_COUNT * NUI_SKELETON_POSITION_COUNT * ZONE_MAX_OCCUPIED * 2;
+
+    NUI_SKELETON_FRAME * pFrames = new NUI_SKELETON_FRAME[cFrames];
+    for ( UINT number = 0; number < cFrames; ++number )
+    {
+        MakeFrame( pFrames[number], number );
+    }
+
+    Vector4 * pMinimums = new Vector4[1000];
+    Vector4 * pMaximums = new Vector4[1000];
+    ZONE_EVENT * pEvents = new ZONE_EVENT[cMaxEvents];
+
+    for ( UINT c = 0; c < _countof(zoneCounts); ++c )
+    {
+        UINT random = 11;
+        ZoneEngine zones;
+        AddRandomZones( zones, pMinimums, pMaximums, zoneCounts[c], random );
+        BruteForceZones bruteForce( pMinimums, pMaximums, zoneCounts[c] );
+
+        UINT cGridEvents = 0;
+        double start = TestSeconds( );
+        for ( UINT number = 0; number < cFrames; ++number )
+        {
+            cGridEvents += zones.Update( pFrames[number], pEvents, cMaxEvents );
+        }
+        double gridSeconds = (TestSeconds( ) - start) / cFrames;
+
+        UINT cBruteEvents = 0;
+        start = TestSeconds( );
+        for ( UINT number = 0; number < cFrames; ++number )
+        {
+            cBruteEvents += bruteForce.Update( pFrames[number], pEvents, cMaxEvents );
+        }
+        double bruteSeconds = (TestSeconds( ) - start) / cFrames;
+
+        printf( "    %4u zones: grid %.1f us a frame, every zone %.1f us a frame (%.1fx), %u and %u events\n",
+            zoneCounts[c], gridSeconds * 1e6, bruteSeconds * 1e6, bruteSeconds / gridSeconds, cGridEvents, cBruteEvents );
+    }
+
+    delete [] pEvents;
+    delete [] pMaximums;
+    delete [] pMinimums;
+    delete [] pFrames;
+}
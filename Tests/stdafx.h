@@ -0,0 +1,28 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="stdafx.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// include file for standard system and project includes
+
+#pragma once
+
+#include "../targetver.h"
+
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
+
+// Windows Header Files
+#include <windows.h>
+#include <ole2.h>
+
+// Winsock
+#include <winsock2.h>
+
+// C RunTime Header Files
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+#include <math.h>
+
+#include <strsafe.h>
@@ -0,0 +1,494 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ZoneEngine.cpp" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "ZoneEngine.h"
+#include <math.h>
+#include <stdio.h>
+#include <strsafe.h>
+
+// Largest zone file read
+static const DWORD g_MaxZoneFileSize = 1024 * 1024;
+
+/// <summary>
+/// Cell along one axis of the grid that a coordinate falls in, clamped to the grid
+/// </summary>
+/// <param name="value">coordinate</param>
+/// <param name="minimum">coordinate the grid starts at</param>
+/// <param name="scale">cells per meter</param>
+/// <param name="size">cells along the axis</param>
+/// <returns>cell index</returns>
+static inline UINT GridCell( float value, float minimum, float scale, UINT size )
+{
+    float cell = (value - minimum) * scale;
+    if ( cell <= 0.0f )
+    {
+        return 0;
+    }
+
+    return min( static_cast<UINT>(cell), size - 1 );
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+ZoneEngine::ZoneEngine() :
+    m_pZones(NULL),
+    m_cZones(0),
+    m_cZonesAllocated(0),
+    m_bIndexDirty(false),
+    m_pCellStart(NULL),
+    m_pCellZones(NULL)
+{
+    ZeroMemory( m_gridMinimum, sizeof(m_gridMinimum) );
+    ZeroMemory( m_gridScale, sizeof(m_gridScale) );
+    ZeroMemory( m_gridSize, sizeof(m_gridSize) );
+    ZeroMemory( m_slots, sizeof(m_slots) );
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+ZoneEngine::~ZoneEngine()
+{
+    delete [] m_pZones;
+    delete [] m_pCellStart;
+    delete [] m_pCellZones;
+}
+
+/// <summary>
+/// Add a zone
+/// </summary>
+/// <param name="szName">name to report the zone by</param>
+/// <param name="minimum">corner of the box with the smallest coordinates, in skeleton space</param>
+/// <param name="maximum">corner of the box with the largest coordinates</param>
+/// <returns>index of the zone, -1 if there are too many or the box is empty</returns>
+int ZoneEngine::AddZone( LPCWSTR szName, const Vector4 & minimum, const Vector4 & maximum )
+{
+    if ( m_cZones >= ZONE_MAX_ZONES || !(minimum.x < maximum.x && minimum.y < maximum.y && minimum.z < maximum.z) )
+    {
+        return -1;
+    }
+
+    if ( m_cZones == m_cZonesAllocated )
+    {
+        UINT cAllocated = max( 16, m_cZonesAllocated * 2 );
+        ZONE * pZones = new ZONE[cAllocated];
+        if ( m_cZones > 0 )
+        {
+            CopyMemory( pZones, m_pZones, m_cZones * sizeof(ZONE) );
+        }
+
+        delete [] m_pZones;
+        m_pZones = pZones;
+        m_cZonesAllocated = cAllocated;
+    }
+
+    ZONE & zone = m_pZones[m_cZones];
+    StringCchCopyW( zone.szName, _countof(zone.szName), szName );
+    zone.minimum[0] = minimum.x;
+    zone.minimum[1] = minimum.y;
+    zone.minimum[2] = minimum.z;
+    zone.maximum[0] = maximum.x;
+    zone.maximum[1] = maximum.y;
+    zone.maximum[2] = maximum.z;
+
+    m_bIndexDirty = true;
+
+    return m_cZones++;
+}
+
+/// <summary>
+/// Add the zones of a text file, one per line: name minX minY minZ maxX maxY maxZ
+/// </summary>
+/// <param name="szFileName">file to read, lines starting with # are ignored</param>
+/// <returns>number of zones added, -1 if the file could not be read</returns>
+int ZoneEngine::LoadZones( LPCWSTR szFileName )
+{
+    HANDLE hFile = CreateFileW( szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( INVALID_HANDLE_VALUE == hFile )
+    {
+        return -1;
+    }
+
+    DWORD cbFile = GetFileSize( hFile, NULL );
+    if ( INVALID_FILE_SIZE == cbFile || cbFile > g_MaxZoneFileSize )
+    {
+        CloseHandle( hFile );
+        return -1;
+    }
+
+    char * pText = new char[cbFile + 1];
+    DWORD cbRead = 0;
+    BOOL bRead = ReadFile( hFile, pText, cbFile, &cbRead, NULL );
+    CloseHandle( hFile );
+
+    if ( !bRead || cbRead != cbFile )
+    {
+        delete [] pText;
+        return -1;
+    }
+    pText[cbFile] = 0;
+
+    int cAdded = 0;
+    char * pLine = pText;
+    while ( 0 != *pLine )
+    {
+        char * pEnd = pLine;
+        while ( 0 != *pEnd && '\n' != *pEnd )
+        {
+            ++pEnd;
+        }
+
+        bool bLast = ( 0 == *pEnd );
+        *pEnd = 0;
+
+        char szName[ZONE_MAX_NAME];
+        Vector4 minimum = { 0.0f, 0.0f, 0.0f, 1.0f };
+        Vector4 maximum = { 0.0f, 0.0f, 0.0f, 1.0f };
+        if ( '#' != pLine[0] &&
+             7 == sscanf_s( pLine, "%31s %f %f %f %f %f %f", szName, static_cast<unsigned>(_countof(szName)),
+                &minimum.x, &minimum.y, &minimum.z, &maximum.x, &maximum.y, &maximum.z ) )
+        {
+            WCHAR szWideName[ZONE_MAX_NAME];
+            if ( 0 != MultiByteToWideChar( CP_UTF8, 0, szName, -1, szWideName, _countof(szWideName) ) &&
+                 AddZone( szWideName, minimum, maximum ) >= 0 )
+            {
+                ++cAdded;
+            }
+        }
+
+        if ( bLast )
+        {
+            break;
+        }
+        pLine = pEnd + 1;
+    }
+
+    delete [] pText;
+
+    return cAdded;
+}
+
+/// <summary>
+/// Lay the grid over the zones and list the zones of every cell
+/// </summary>
+void ZoneEngine::BuildIndex( )
+{
+    delete [] m_pCellStart;
+    m_pCellStart = NULL;
+    delete [] m_pCellZones;
+    m_pCellZones = NULL;
+    m_bIndexDirty = false;
+
+    if ( 0 == m_cZones )
+    {
+        return;
+    }
+
+    // Bounds of every zone, and their mean size
+    float gridMaximum[3];
+    float meanSize[3] = { 0.0f, 0.0f, 0.0f };
+    for ( UINT axis = 0; axis < 3; ++axis )
+    {
+        m_gridMinimum[axis] = m_pZones[0].minimum[axis];
+        gridMaximum[axis] = m_pZones[0].maximum[axis];
+    }
+
+    for ( UINT zone = 0; zone < m_cZones; ++zone )
+    {
+        for ( UINT axis = 0; axis < 3; ++axis )
+        {
+            m_gridMinimum[axis] = min( m_gridMinimum[axis], m_pZones[zone].minimum[axis] );
+            gridMaximum[axis] = max( gridMaximum[axis], m_pZones[zone].maximum[axis] );
+            meanSize[axis] += m_pZones[zone].maximum[axis] - m_pZones[zone].minimum[axis];
+        }
+    }
+
+    // Cells about as large as a zone touch a few zones each, and each zone a few cells
+    UINT cCells = 1;
+    for ( UINT axis = 0; axis < 3; ++axis )
+    {
+        float extent = gridMaximum[axis] - m_gridMinimum[axis];
+        float cellSize = max( meanSize[axis] / m_cZones, extent / ZONE_GRID_MAX_AXIS );
+        m_gridSize[axis] = min( static_cast<UINT>(ceilf( extent / cellSize )), ZONE_GRID_MAX_AXIS );
+        m_gridSize[axis] = max( m_gridSize[axis], 1 );
+        cCells *= m_gridSize[axis];
+    }
+
+    while ( cCells > ZONE_GRID_MAX_CELLS )
+    {
+        UINT largest = 0;
+        for ( UINT axis = 1; axis < 3; ++axis )
+        {
+            if ( m_gridSize[axis] > m_gridSize[largest] )
+            {
+                largest = axis;
+            }
+        }
+
+        cCells /= m_gridSize[largest];
+        m_gridSize[largest] = (m_gridSize[largest] + 1) / 2;
+        cCells *= m_gridSize[largest];
+    }
+
+    for ( UINT axis = 0; axis < 3; ++axis )
+    {
+        m_gridScale[axis] = m_gridSize[axis] / (gridMaximum[axis] - m_gridMinimum[axis]);
+    }
+
+    // Count the zones of each cell, one ahead, so summing the counts gives where each cell's list starts
+    m_pCellStart = new UINT[cCells + 1];
+    ZeroMemory( m_pCellStart, (cCells + 1) * sizeof(UINT) );
+
+    UINT first[3];
+    UINT last[3];
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        for ( UINT zone = 0; zone < m_cZones; ++zone )
+        {
+            for ( UINT axis = 0; axis < 3; ++axis )
+            {
+                first[axis] = GridCell( m_pZones[zone].minimum[axis], m_gridMinimum[axis], m_gridScale[axis], m_gridSize[axis] );
+                last[axis] = GridCell( m_pZones[zone].maximum[axis], m_gridMinimum[axis], m_gridScale[axis], m_gridSize[axis] );
+            }
+
+            for ( UINT z = first[2]; z <= last[2]; ++z )
+            {
+                for ( UINT y = first[1]; y <= last[1]; ++y )
+                {
+                    UINT cell = (z * m_gridSize[1] + y) * m_gridSize[0] + first[0];
+                    for ( UINT x = first[0]; x <= last[0]; ++x, ++cell )
+                    {
+                        if ( 0 == pass )
+                        {
+                            ++m_pCellStart[cell + 1];
+                        }
+                        else
+                        {
+                            // Zones are listed in order, so every cell's list is sorted
+                            m_pCellZones[m_pCellStart[cell]++] = static_cast<USHORT>(zone);
+                        }
+                    }
+                }
+            }
+        }
+
+        if ( 0 == pass )
+        {
+            for ( UINT cell = 0; cell < cCells; ++cell )
+            {
+                m_pCellStart[cell + 1] += m_pCellStart[cell];
+            }
+            m_pCellZones = new USHORT[max( m_pCellStart[cCells], 1 )];
+        }
+    }
+
+    // Filling moved every start to the next cell's, shift them back
+    for ( UINT cell = cCells; cell > 0; --cell )
+    {
+        m_pCellStart[cell] = m_pCellStart[cell - 1];
+    }
+    m_pCellStart[0] = 0;
+}
+
+/// <summary>
+/// Find the zones a point is in
+/// </summary>
+/// <param name="point">point in skeleton space</param>
+/// <param name="pZones">receives the zones, sorted</param>
+/// <returns>number of zones, at most ZONE_MAX_OCCUPIED</returns>
+UINT ZoneEngine::FindZones( const Vector4 & point, USHORT * pZones ) const
+{
+    if ( NULL == m_pCellStart )
+    {
+        return 0;
+    }
+
+    const float coordinates[3] = { point.x, point.y, point.z };
+    UINT cell = 0;
+    for ( int axis = 2; axis >= 0; --axis )
+    {
+        float offset = (coordinates[axis] - m_gridMinimum[axis]) * m_gridScale[axis];
+        if ( offset < 0.0f || offset > static_cast<float>(m_gridSize[axis]) )
+        {
+            return 0;
+        }
+
+        cell = cell * m_gridSize[axis] + min( static_cast<UINT>(offset), m_gridSize[axis] - 1 );
+    }
+
+    UINT cZones = 0;
+    for ( UINT i = m_pCellStart[cell]; i < m_pCellStart[cell + 1] && cZones < ZONE_MAX_OCCUPIED; ++i )
+    {
+        const ZONE & zone = m_pZones[m_pCellZones[i]];
+        if ( point.x >= zone.minimum[0] && point.x <= zone.maximum[0] &&
+             point.y >= zone.minimum[1] && point.y <= zone.maximum[1] &&
+             point.z >= zone.minimum[2] && point.z <= zone.maximum[2] )
+        {
+            pZones[cZones++] = m_pCellZones[i];
+        }
+    }
+
+    return cZones;
+}
+
+/// <summary>
+/// Find the slot of a skeleton, taking a free one for a new skeleton
+/// </summary>
+/// <param name="dwTrackingID">tracking ID of the skeleton</param>
+/// <returns>slot of the skeleton</returns>
+ZoneEngine::ZONE_SLOT * ZoneEngine::FindSlot( DWORD dwTrackingID )
+{
+    ZONE_SLOT * pFree = NULL;
+
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        if ( m_slots[i].dwTrackingID == dwTrackingID )
+        {
+            return &m_slots[i];
+        }
+
+        if ( 0 == m_slots[i].dwTrackingID && NULL == pFree )
+        {
+            pFree = &m_slots[i];
+        }
+    }
+
+    // Skeletons that left were freed first, so there is always a free slot
+    ZeroMemory( pFree, sizeof(*pFree) );
+    pFree->dwTrackingID = dwTrackingID;
+
+    return pFree;
+}
+
+/// <summary>
+/// Move a joint to the zones it is in now, reporting the zones entered and left
+/// </summary>
+/// <param name="slot">slot of the skeleton</param>
+/// <param name="joint">joint that moved</param>
+/// <param name="pZones">zones it is in now, sorted</param>
+/// <param name="cZones">number of zones</param>
+/// <param name="pEvents">receives the events</param>
+/// <param name="cMaxEvents">room in pEvents</param>
+/// <returns>number of events</returns>
+UINT ZoneEngine::MoveJoint( ZONE_SLOT & slot, UINT joint, const USHORT * pZones, UINT cZones, ZONE_EVENT * pEvents, UINT cMaxEvents )
+{
+    const USHORT * pOccupied = slot.occupied[joint];
+    const UINT cOccupied = slot.cOccupied[joint];
+
+    // Both lists are sorted, so a zone in only one of them was entered or left
+    UINT cEvents = 0;
+    UINT i = 0;
+    UINT j = 0;
+    while ( i < cOccupied || j < cZones )
+    {
+        UINT zone;
+        bool bEnter;
+        if ( j == cZones || (i < cOccupied && pOccupied[i] < pZones[j]) )
+        {
+            zone = pOccupied[i++];
+            bEnter = false;
+        }
+        else if ( i == cOccupied || pZones[j] < pOccupied[i] )
+        {
+            zone = pZones[j++];
+            bEnter = true;
+        }
+        else
+        {
+            ++i;
+            ++j;
+            continue;
+        }
+
+        if ( cEvents < cMaxEvents )
+        {
+            pEvents[cEvents].dwTrackingID = slot.dwTrackingID;
+            pEvents[cEvents].joint = static_cast<NUI_SKELETON_POSITION_INDEX>(joint);
+            pEvents[cEvents].zone = zone;
+            pEvents[cEvents].bEnter = bEnter;
+            ++cEvents;
+        }
+    }
+
+    if ( cZones > 0 )
+    {
+        CopyMemory( slot.occupied[joint], pZones, cZones * sizeof(USHORT) );
+    }
+    slot.cOccupied[joint] = static_cast<BYTE>(cZones);
+
+    return cEvents;
+}
+
+/// <summary>
+/// Find the zones every joint of a frame is in, and report the changes since the last frame
+/// </summary>
+/// <param name="frame">skeleton frame</param>
+/// <param name="pEvents">receives the joints that entered or left a zone</param>
+/// <param name="cMaxEvents">room in pEvents, further events are not reported</param>
+/// <returns>number of events</returns>
+UINT ZoneEngine::Update( const NUI_SKELETON_FRAME & frame, ZONE_EVENT * pEvents, UINT cMaxEvents )
+{
+    if ( m_bIndexDirty )
+    {
+        BuildIndex( );
+    }
+
+    UINT cEvents = 0;
+
+    // Every joint of a skeleton that left leaves its zones, and its slot is freed
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        ZONE_SLOT & slot = m_slots[i];
+        if ( 0 == slot.dwTrackingID )
+        {
+            continue;
+        }
+
+        bool bFound = false;
+        for ( UINT skeleton = 0; skeleton < NUI_SKELETON_COUNT && !bFound; ++skeleton )
+        {
+            bFound = ( NUI_SKELETON_TRACKED == frame.SkeletonData[skeleton].eTrackingState &&
+                       slot.dwTrackingID == frame.SkeletonData[skeleton].dwTrackingID );
+        }
+
+        if ( !bFound )
+        {
+            for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+            {
+                cEvents += MoveJoint( slot, joint, NULL, 0, pEvents + cEvents, cMaxEvents - cEvents );
+            }
+            slot.dwTrackingID = 0;
+        }
+    }
+
+    for ( UINT i = 0; i < NUI_SKELETON_COUNT; ++i )
+    {
+        const NUI_SKELETON_DATA & skeleton = frame.SkeletonData[i];
+        if ( NUI_SKELETON_TRACKED != skeleton.eTrackingState )
+        {
+            continue;
+        }
+
+        ZONE_SLOT * pSlot = FindSlot( skeleton.dwTrackingID );
+
+        for ( UINT joint = 0; joint < NUI_SKELETON_POSITION_COUNT; ++joint )
+        {
+            // A joint lost for a frame is taken to be where it was
+            if ( NUI_SKELETON_POSITION_NOT_TRACKED == skeleton.eSkeletonPositionTrackingState[joint] )
+            {
+                continue;
+            }
+
+            USHORT zones[ZONE_MAX_OCCUPIED];
+            UINT cZones = FindZones( skeleton.SkeletonPositions[joint], zones );
+            cEvents += MoveJoint( *pSlot, joint, zones, cZones, pEvents + cEvents, cMaxEvents - cEvents );
+        }
+    }
+
+    return cEvents;
+}
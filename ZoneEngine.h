@@ -0,0 +1,150 @@
+﻿//------------------------------------------------------------------------------
+// <copyright file="ZoneEngine.h" company="Microsoft">
+//     Copyright (c) Microsoft Corporation.  All rights reserved.
+// </copyright>
+//------------------------------------------------------------------------------
+
+// Reports every joint of every tracked skeleton entering and leaving 3D zones,
+// boxes in skeleton space.  Zones are indexed in a uniform grid over their
+// bounds, each cell listing the zones that touch it, so a joint is tested
+// against the few zones of its own cell rather than every zone.  Cell lists
+// keep zones in the order they were added, which keeps the zones a joint is in
+// sorted, so the zones it entered and left are found by merging the lists of
+// this frame and the last.  Events are only reported on a change.
+
+#pragma once
+
+#include "NuiApi.h"
+
+#define ZONE_MAX_ZONES          4096
+#define ZONE_MAX_NAME           32
+
+// Zones a single joint can be in at once, further overlapping zones are not reported
+#define ZONE_MAX_OCCUPIED       32
+
+// Largest number of cells along an axis and in all of the grid
+#define ZONE_GRID_MAX_AXIS      64
+#define ZONE_GRID_MAX_CELLS     32768
+
+// One joint entering or leaving a zone
+struct ZONE_EVENT
+{
+    DWORD                       dwTrackingID;   // skeleton the joint belongs to
+    NUI_SKELETON_POSITION_INDEX joint;
+    UINT                        zone;           // index from AddZone
+    bool                        bEnter;         // true when entering, false when leaving
+};
+
+class ZoneEngine
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    ZoneEngine();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~ZoneEngine();
+
+    /// <summary>
+    /// Add a zone
+    /// </summary>
+    /// <param name="szName">name to report the zone by</param>
+    /// <param name="minimum">corner of the box with the smallest coordinates, in skeleton space</param>
+    /// <param name="maximum">corner of the box with the largest coordinates</param>
+    /// <returns>index of the zone, -1 if there are too many or the box is empty</returns>
+    int AddZone( LPCWSTR szName, const Vector4 & minimum, const Vector4 & maximum );
+
+    /// <summary>
+    /// Add the zones of a text file, one per line: name minX minY minZ maxX maxY maxZ
+    /// </summary>
+    /// <param name="szFileName">file to read, lines starting with # are ignored</param>
+    /// <returns>number of zones added, -1 if the file could not be read</returns>
+    int LoadZones( LPCWSTR szFileName );
+
+    /// <summary>
+    /// Name of a zone
+    /// </summary>
+    /// <param name="zone">zone index</param>
+    /// <returns>name given to AddZone</returns>
+    LPCWSTR GetName( UINT zone ) const { return m_pZones[zone].szName; }
+
+    /// <summary>
+    /// Number of zones
+    /// </summary>
+    /// <returns>zones added so far</returns>
+    UINT GetZoneCount( ) const { return m_cZones; }
+
+    /// <summary>
+    /// Find the zones every joint of a frame is in, and report the changes since the last frame
+    /// </summary>
+    /// <param name="frame">skeleton frame</param>
+    /// <param name="pEvents">receives the joints that entered or left a zone</param>
+    /// <param name="cMaxEvents">room in pEvents, further events are not reported</param>
+    /// <returns>number of events</returns>
+    UINT Update( const NUI_SKELETON_FRAME & frame, ZONE_EVENT * pEvents, UINT cMaxEvents );
+
+private:
+    struct ZONE
+    {
+        WCHAR   szName[ZONE_MAX_NAME];
+        float   minimum[3];
+        float   maximum[3];
+    };
+
+    // The zones each joint of one skeleton is in, sorted
+    struct ZONE_SLOT
+    {
+        DWORD   dwTrackingID;       // 0 when free
+        BYTE    cOccupied[NUI_SKELETON_POSITION_COUNT];
+        USHORT  occupied[NUI_SKELETON_POSITION_COUNT][ZONE_MAX_OCCUPIED];
+    };
+
+    /// <summary>
+    /// Lay the grid over the zones and list the zones of every cell
+    /// </summary>
+    void BuildIndex( );
+
+    /// <summary>
+    /// Find the zones a point is in
+    /// </summary>
+    /// <param name="point">point in skeleton space</param>
+    /// <param name="pZones">receives the zones, sorted</param>
+    /// <returns>number of zones, at most ZONE_MAX_OCCUPIED</returns>
+    UINT FindZones( const Vector4 & point, USHORT * pZones ) const;
+
+    /// <summary>
+    /// Find the slot of a skeleton, taking a free one for a new skeleton
+    /// </summary>
+    /// <param name="dwTrackingID">tracking ID of the skeleton</param>
+    /// <returns>slot of the skeleton</returns>
+    ZONE_SLOT * FindSlot( DWORD dwTrackingID );
+
+    /// <summary>
+    /// Move a joint to the zones it is in now, reporting the zones entered and left
+    /// </summary>
+    /// <param name="slot">slot of the skeleton</param>
+    /// <param name="joint">joint that moved</param>
+    /// <param name="pZones">zones it is in now, sorted</param>
+    /// <param name="cZones">number of zones</param>
+    /// <param name="pEvents">receives the events</param>
+    /// <param name="cMaxEvents">room in pEvents</param>
+    /// <returns>number of events</returns>
+    UINT MoveJoint( ZONE_SLOT & slot, UINT joint, const USHORT * pZones, UINT cZones, ZONE_EVENT * pEvents, UINT cMaxEvents );
+
+    ZONE *                  m_pZones;
+    UINT                    m_cZones;
+    UINT                    m_cZonesAllocated;
+
+    // Grid over the bounds of every zone; the zones of cell c are m_pCellZones[m_pCellStart[c]] up to m_pCellStart[c + 1]
+    bool                    m_bIndexDirty;
+    float                   m_gridMinimum[3];
+    float                   m_gridScale[3];     // cells per meter
+    UINT                    m_gridSize[3];
+    UINT *                  m_pCellStart;
+    USHORT *                m_pCellZones;
+
+    ZONE_SLOT               m_slots[NUI_SKELETON_COUNT];
+};
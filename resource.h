@@ -22,6 +22,8 @@
 #define IDS_ERROR_SETTRACKED            136
 #define IDS_ERROR_IN_USE                140
 #define IDS_ERROR_IMAGESTREAMFLAGS      141
+#define IDS_ERROR_PUBLISH               142
+#define IDS_ERROR_IMAGECHANNEL          143
 #define IDS_ERROR_NUICREATE             150
 
 #define IDS_TRACKEDSKELETONS_DEFAULT    160
@@ -33,6 +35,17 @@
 #define IDS_TRACKINGMODE_SEATED         166
 #define IDS_RANGE_DEFAULT               167
 #define IDS_RANGE_NEAR                  168
+#define IDS_COLORVIEW_COLOR             169
+#define IDS_COLORVIEW_GREENSCREEN       170
+#define IDS_DEPTHVIEW_DEPTH             171
+#define IDS_DEPTHVIEW_AUTOCONTRAST      172
+#define IDS_COLORVIEW_INFRARED          173
+#define IDS_TRACKEDSKELETONS_ZONE1      174
+#define IDS_TRACKEDSKELETONS_ZONE2      175
+#define IDS_TRACKEDSKELETONS_ACTIVE1    176
+#define IDS_TRACKEDSKELETONS_ACTIVE2    177
+#define IDS_TRACKEDSKELETONS_LONGEST1   178
+#define IDS_TRACKEDSKELETONS_LONGEST2   179
 
 #define IDC_DEPTHVIEWER                 1001
 #define IDC_SKELETALVIEW                1002
@@ -44,6 +57,8 @@
 #define IDC_TRACKEDSKELETONS            1009
 #define IDC_TRACKINGMODE                1010
 #define IDC_RANGE                       1011
+#define IDC_COLORVIEW                   1012
+#define IDC_DEPTHVIEW                   1013
 #define IDC_STATIC                      -1
 
 // Next default values for new objects
@@ -51,9 +66,9 @@
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
-#define _APS_NEXT_RESOURCE_VALUE        169
+#define _APS_NEXT_RESOURCE_VALUE        180
 #define _APS_NEXT_COMMAND_VALUE         32771
-#define _APS_NEXT_CONTROL_VALUE         1012
+#define _APS_NEXT_CONTROL_VALUE         1014
 #define _APS_NEXT_SYMED_VALUE           111
 #endif
 #endif
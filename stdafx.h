@@ -16,6 +16,9 @@
 #include <windows.h>
 #include <ole2.h>
 
+// Winsock
+#include <winsock2.h>
+
 // C RunTime Header Files
 #include <stdlib.h>
 #include <malloc.h>
@@ -31,6 +34,7 @@
 
 #pragma comment ( lib, "winmm.lib" )
 #pragma comment ( lib, "d2d1.lib" )
+#pragma comment ( lib, "ws2_32.lib" )
 
 #ifdef _UNICODE
 #if defined _M_IX86